@@ -0,0 +1,818 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      atest.c
+ *
+ * Purpose:   	Decode recorded WAV files as fast as possible, for
+ *		comparing demodulators.
+ *
+ * Description:	Version 1.8.
+ *
+ *		This is the same receive chain as direwolf, from
+ *		multi_modem_process_block down through the demodulators,
+ *		HDLC and FX.25 decoding, without any of the audio device,
+ *		queue, or application parts.  The audio is all read into
+ *		memory first so only the decoding is timed.
+ *
+ *		Each profile in the -P list gets its own radio channel
+ *		and all of the files are decoded once for each.  The frame
+ *		counts and decoding speed for the profiles are then side by
+ *		side for comparing releases, options, or hardware.
+ *
+ * Usage:	atest  [ options ]  wav-file ...
+ *		atest  [ options ]  -S  [ wav-file ... ]
+ *
+ *		-B n	Bits per second.  300 or 1200 (default).
+ *		-P list	Comma separated profiles, e.g. A,A+,B.  Default A.
+ *		-D n	Divide audio sample rate by n.
+ *		-F n	FIX_BITS effort level.  0 (default) to 4.
+ *		-T n	Demodulator threads, like DEMODTHREADS.
+ *		-X n	Fix up threads, like FIXTHREADS.
+ *		-G ms	Skip demodulating quiet audio, like RXGATE.
+ *		-N n	Turn off demodulators and slicers which get no frames
+ *			of their own in n, like RXPRUNE.
+ *		-q	Quiet.  Don't print the frames.
+ *		-S	Also decode a generated corpus.  See make_corpus.
+ *		-M n	Fail if any generated case decodes less than n
+ *			percent of its frames with any profile.
+ *		-R n	Fail if any profile decodes fewer than n samples
+ *			per second.
+ *		-C	Print time spent, and frames only it got, for each
+ *			demodulator and slicer.  See metrics_print_demod.
+ *
+ *		Only the first channel of a stereo file is used.  Files
+ *		at a different sample rate than the first are resampled
+ *		to that rate.
+ *
+ *		For a regression check, e.g. before a release or in a
+ *		build script, -S with -M and -R gives an exit status of
+ *		1 if decoding got worse or slower than the thresholds:
+ *
+ *			atest -q -S -P A,A+,B -M 95 -R 2000000
+ *
+ *		The generated corpus is the same every time so frame counts
+ *		only change when decoding does.  Throughput depends on the
+ *		computer so -R must be set for the one running the check.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <time.h>
+#include <assert.h>
+
+#if __WIN32__
+#include <windows.h>
+#endif
+
+#include "audio.h"
+#include "ax25_pad.h"
+#include "multi_modem.h"
+#include "hdlc_rec.h"
+#include "dlq.h"
+#include "ptt.h"
+#include "tq.h"
+#include "fx25.h"
+#include "dsp_kernel.h"
+#include "resample.h"
+#include "metrics.h"
+#include "siggen.h"
+#include "rxgate.h"
+
+#define ATEST_BLOCK_SIZE 64 /* Same as RECV_BLOCK_SIZE in recv.c. */
+
+static struct audio_s my_audio_config;
+
+static int quiet = 0;
+static int min_percent = 0; /* -M */
+static double min_rate = 0; /* -R */
+static int cost_table = 0;
+static int num_prof = 0;
+static char *prof_name[MAX_CHANS];
+
+static int this_file;		/* Index of file being decoded, for counting frames. */
+static int *file_frames;	/* Frames for each file and profile, [file * MAX_CHANS + chan]. */
+static int total_frames[MAX_CHANS];
+static double decode_sec[MAX_CHANS];
+
+/* A WAV file, first channel only, at the decoding rate. */
+
+struct wav_s
+{
+	char *name;
+	int16_t *samples;
+	int n;
+	int rate; /* As recorded. */
+	int sent; /* Frames in a generated case.  0 for a file. */
+};
+
+#define NUM_CASES 6
+
+static void make_corpus(struct wav_s *w, int rate, int baud);
+
+static int wav_read(struct wav_s *w, int decode_rate);
+
+static int64_t atest_clock(void);
+
+static void usage(void);
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        main
+ *
+ * Purpose:     Decode the files with each profile and report.
+ *
+ *--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+	int baud = DEFAULT_BAUD;
+	char profiles[256] = "A";
+	int decimate = 0;
+	int fix_bits = RETRY_NONE;
+	int demod_threads = 0;
+	int fix_threads = 0;
+	int gate_ms = 0;
+	int prune_frames = 0;
+	struct wav_s *wav;
+	int num_wav;
+	int64_t samples = 0;
+	int rate = 0;
+	int synthetic = 0;
+	int failed = 0;
+	int c, f, chan;
+	char *p;
+
+	setlinebuf(stdout);
+
+	while ((c = getopt(argc, argv, "B:P:D:F:T:X:G:N:qCSM:R:h")) != -1)
+	{
+		switch (c)
+		{
+		case 'B':
+			baud = atoi(optarg);
+			if (baud < 100 || baud > 2400)
+			{
+				printf("Only AFSK up to 2400 bits per second is available.\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'P':
+			snprintf(profiles, sizeof(profiles), "%s", optarg);
+			break;
+		case 'D':
+			decimate = atoi(optarg);
+			if (decimate < 1 || decimate > 8)
+			{
+				printf("Divide by must be in range of 1 - 8.\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'F':
+			fix_bits = atoi(optarg);
+			if (fix_bits < RETRY_NONE || fix_bits >= RETRY_MAX)
+			{
+				printf("Invalid FIX_BITS level.\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'T':
+			demod_threads = atoi(optarg);
+			if (demod_threads < 0 || demod_threads > MAX_SUBCHANS)
+			{
+				printf("Number of demodulator threads must be in range of 0 - %d.\n", MAX_SUBCHANS);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'X':
+			fix_threads = atoi(optarg);
+			if (fix_threads < 0 || fix_threads > MAX_FIX_THREADS)
+			{
+				printf("Number of fix up threads must be in range of 0 - %d.\n", MAX_FIX_THREADS);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'G':
+			gate_ms = atoi(optarg);
+			if (gate_ms < 0 || gate_ms > MAX_RX_GATE_MS)
+			{
+				printf("RXGATE time must be in range of 0 - %d milliseconds.\n", MAX_RX_GATE_MS);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'N':
+			prune_frames = atoi(optarg);
+			if (prune_frames < 10 || prune_frames > 10000)
+			{
+				printf("RXPRUNE frames must be in range of 10 - 10000.\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'C':
+			cost_table = 1;
+			break;
+		case 'S':
+			synthetic = 1;
+			break;
+		case 'M':
+			min_percent = atoi(optarg);
+			break;
+		case 'R':
+			min_rate = atof(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	num_wav = argc - optind + (synthetic ? NUM_CASES : 0);
+	if (num_wav <= 0)
+	{
+		usage();
+	}
+
+	for (p = strtok(profiles, ","); p != NULL; p = strtok(NULL, ","))
+	{
+		if (num_prof >= MAX_CHANS)
+		{
+			printf("Only %d profiles can be compared at once.\n", MAX_CHANS);
+			exit(EXIT_FAILURE);
+		}
+		prof_name[num_prof++] = p;
+	}
+	if (num_prof == 0)
+	{
+		usage();
+	}
+
+	wav = calloc(num_wav, sizeof(struct wav_s));
+	file_frames = calloc(num_wav * MAX_CHANS, sizeof(int));
+	if (wav == NULL || file_frames == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/*
+	 * Read everything first.  The first file sets the rate.
+	 */
+
+	for (f = 0; f < argc - optind; f++)
+	{
+		wav[f].name = argv[optind + f];
+		if (wav_read(&wav[f], rate) < 0)
+		{
+			exit(EXIT_FAILURE);
+		}
+		if (rate == 0)
+		{
+			rate = wav[f].rate;
+		}
+		samples += wav[f].n;
+	}
+
+	fx25_init(0);
+
+	if (synthetic)
+	{
+		if (rate == 0)
+		{
+			rate = 48000;
+		}
+		make_corpus(&wav[argc - optind], rate, baud);
+		for (f = argc - optind; f < num_wav; f++)
+		{
+			samples += wav[f].n;
+		}
+	}
+
+	/*
+	 * One radio channel for each profile.  Same as config.c defaults otherwise.
+	 */
+
+	memset(&my_audio_config, 0, sizeof(my_audio_config));
+	my_audio_config.demod_threads = demod_threads;
+	my_audio_config.fix_threads = fix_threads;
+
+	for (chan = 0; chan < num_prof; chan++)
+	{
+		int a = ACHAN2ADEV(chan);
+
+		my_audio_config.adev[a].defined = 1;
+		my_audio_config.adev[a].num_channels = 2;
+		my_audio_config.adev[a].samples_per_sec = rate;
+		my_audio_config.adev[a].bits_per_sample = 16;
+
+		my_audio_config.chan_medium[chan] = MEDIUM_RADIO;
+		my_audio_config.achan[chan].modem_type = MODEM_AFSK;
+		my_audio_config.achan[chan].baud = baud;
+		my_audio_config.achan[chan].mark_freq = baud < 600 ? 1600 : DEFAULT_MARK_FREQ;
+		my_audio_config.achan[chan].space_freq = baud < 600 ? 1800 : DEFAULT_SPACE_FREQ;
+		snprintf(my_audio_config.achan[chan].profiles, sizeof(my_audio_config.achan[chan].profiles), "%s", prof_name[chan]);
+		my_audio_config.achan[chan].num_freq = 1;
+		my_audio_config.achan[chan].decimate = decimate;
+		my_audio_config.achan[chan].upsample = 1;
+		my_audio_config.achan[chan].fx25_rec = 1;
+		my_audio_config.achan[chan].fix_bits = fix_bits;
+		my_audio_config.achan[chan].sanity_test = SANITY_APRS;
+		my_audio_config.achan[chan].rx_gate_ms = gate_ms;
+		my_audio_config.achan[chan].rx_prune_frames = prune_frames;
+		my_audio_config.achan[chan].rx_prune_probe = DEFAULT_RX_PRUNE_PROBE;
+	}
+
+	dsp_kernel_init();
+	multi_modem_init(&my_audio_config);
+
+	printf("%d files, %.1f seconds of audio at %d samples per second, %d baud.\n",
+		   num_wav, (double)samples / rate, rate, baud);
+
+	/*
+	 * Decode.  Each profile goes over all of the audio by itself so
+	 * it can be timed.  Some silence at the end of each file pushes
+	 * out the last frame like recv.c does.
+	 */
+
+	for (chan = 0; chan < num_prof; chan++)
+	{
+		static const int16_t silence[ATEST_BLOCK_SIZE];
+
+		for (f = 0; f < num_wav; f++)
+		{
+			int64_t start = atest_clock();
+			int k;
+
+			this_file = f;
+			for (k = 0; k < wav[f].n; k += ATEST_BLOCK_SIZE)
+			{
+				int len = wav[f].n - k < ATEST_BLOCK_SIZE ? wav[f].n - k : ATEST_BLOCK_SIZE;
+
+				multi_modem_process_block(chan, wav[f].samples + k, len);
+			}
+			for (k = 0; k < rate / 2; k += ATEST_BLOCK_SIZE)
+			{
+				multi_modem_process_block(chan, silence, ATEST_BLOCK_SIZE);
+			}
+			decode_sec[chan] += (atest_clock() - start) / 1000000.;
+		}
+	}
+
+	/*
+	 * Report.
+	 */
+
+	printf("\n%-32s", "");
+	for (chan = 0; chan < num_prof; chan++)
+	{
+		printf(" %10s", prof_name[chan]);
+	}
+	printf("\n");
+
+	for (f = 0; f < num_wav; f++)
+	{
+		const char *base = strrchr(wav[f].name, '/');
+
+		printf("%-32.32s", base != NULL ? base + 1 : wav[f].name);
+		for (chan = 0; chan < num_prof; chan++)
+		{
+			printf(" %10d", file_frames[f * MAX_CHANS + chan]);
+		}
+		printf("\n");
+	}
+
+	printf("%-32s", "Frames decoded");
+	for (chan = 0; chan < num_prof; chan++)
+	{
+		printf(" %10d", total_frames[chan]);
+	}
+	printf("\n%-32s", "Decoding time, seconds");
+	for (chan = 0; chan < num_prof; chan++)
+	{
+		printf(" %10.2f", decode_sec[chan]);
+	}
+	printf("\n%-32s", "Samples per second");
+	for (chan = 0; chan < num_prof; chan++)
+	{
+		printf(" %10.0f", decode_sec[chan] > 0 ? samples / decode_sec[chan] : 0);
+	}
+	printf("\n%-32s", "Times real time");
+	for (chan = 0; chan < num_prof; chan++)
+	{
+		printf(" %10.1f", decode_sec[chan] > 0 ? samples / (double)rate / decode_sec[chan] : 0);
+	}
+	printf("\n");
+	if (gate_ms > 0)
+	{
+		printf("%-32s", "Skipped by RXGATE, percent");
+		for (chan = 0; chan < num_prof; chan++)
+		{
+			uint64_t busy, idle;
+
+			rxgate_stats(chan, &busy, &idle);
+			printf(" %10.1f", busy + idle > 0 ? 100. * idle / (busy + idle) : 0);
+		}
+		printf("\n");
+	}
+	if (prune_frames > 0)
+	{
+		printf("%-32s", "Running after RXPRUNE");
+		for (chan = 0; chan < num_prof; chan++)
+		{
+			int running = 0, all = 0;
+			char text[16];
+
+			for (int j = 0; j < my_audio_config.achan[chan].num_subchan; j++)
+			{
+				running += __builtin_popcount(multi_modem_active_slicers(chan, j));
+				all += my_audio_config.achan[chan].num_slicers;
+			}
+			snprintf(text, sizeof(text), "%d/%d", running, all);
+			printf(" %10s", text);
+		}
+		printf("\n");
+	}
+
+	/*
+	 * Check thresholds.
+	 */
+
+	for (f = 0; f < num_wav; f++)
+	{
+		for (chan = 0; chan < num_prof && wav[f].sent > 0; chan++)
+		{
+			if (file_frames[f * MAX_CHANS + chan] * 100 < min_percent * wav[f].sent)
+			{
+				printf("FAILED: %s decoded only %d of %d frames with %s.  Need %d%%.\n",
+					   wav[f].name, file_frames[f * MAX_CHANS + chan], wav[f].sent, prof_name[chan], min_percent);
+				failed = 1;
+			}
+		}
+	}
+	for (chan = 0; chan < num_prof; chan++)
+	{
+		double sps = decode_sec[chan] > 0 ? samples / decode_sec[chan] : 0;
+
+		if (sps < min_rate)
+		{
+			printf("FAILED: %s decoded only %.0f samples per second.  Need %.0f.\n", prof_name[chan], sps, min_rate);
+			failed = 1;
+		}
+	}
+
+	if (cost_table)
+	{
+		for (chan = 0; chan < num_prof; chan++)
+		{
+			printf("\nProfile %s:", prof_name[chan]);
+			metrics_print_demod(&my_audio_config, chan);
+		}
+	}
+
+	exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        make_corpus
+ *
+ * Purpose:     Generate test cases covering the usual troubles.
+ *
+ * Inputs:	rate	- Audio sample rate.
+ *		baud	- 300 or 1200, with the usual tones.
+ *
+ * Outputs:	w[0] thru w[NUM_CASES-1]
+ *
+ * Description:	Signals are made by siggen.c, the same every time.
+ *		The cases are:
+ *
+ *			clean		Nothing added.
+ *			noise		Noise, near where a single demodulator
+ *					starts losing frames.
+ *			twist		Higher tone weaker, as from a receiver's
+ *					speaker output, plus noise.
+ *			offset		Tones off by 5% of the shift and the
+ *					sender's clock off too, plus noise.
+ *			fx25		FX.25 with 16 check bytes, and more
+ *					noise than plain AX.25 gets through.
+ *			bursts		Frames back to back with only a
+ *					couple flags between, like a busy
+ *					digipeater, plus noise.
+ *
+ *--------------------------------------------------------------------*/
+
+static void make_corpus(struct wav_s *w, int rate, int baud)
+{
+	static const struct
+	{
+		char *name;
+		float snr_db;
+		int twist;	 /* De-emphasis, 6 dB per octave. */
+		int offset;	 /* Percent of the shift. */
+		float drift_ppm;
+		int fx25;	 /* Check bytes or 0. */
+		int density; /* Percent of time transmitting. */
+	} cases[NUM_CASES] = {
+		{"generated/clean", SIGGEN_NO_NOISE, 0, 0, 0, 0, 50},
+		{"generated/noise", -1, 0, 0, 0, 0, 50},
+		{"generated/twist", 4, 1, 0, 0, 0, 50},
+		{"generated/offset", 1, 0, 5, 300, 0, 50},
+		{"generated/fx25", -2, 0, 0, 0, 16, 50},
+		{"generated/bursts", -1, 0, 0, 0, 0, 100},
+	};
+
+	for (int c = 0; c < NUM_CASES; c++)
+	{
+		struct siggen_s g;
+
+		siggen_default(&g);
+		g.samples_per_sec = rate;
+		g.baud = baud;
+		g.mark_freq = baud < 600 ? 1600 : DEFAULT_MARK_FREQ;
+		g.space_freq = baud < 600 ? 1800 : DEFAULT_SPACE_FREQ;
+		g.layer2_xmit = cases[c].fx25 ? LAYER2_FX25 : LAYER2_AX25;
+		g.fx25_strength = cases[c].fx25;
+		g.density = cases[c].density;
+		g.snr_db = cases[c].snr_db;
+		if (cases[c].twist)
+		{
+			g.twist_db = 20.f * log10f((float)g.space_freq / g.mark_freq);
+		}
+		g.freq_offset = (g.space_freq - g.mark_freq) * cases[c].offset / 100;
+		g.drift_ppm = cases[c].drift_ppm;
+		g.seed = c + 1;
+
+		w[c].name = cases[c].name;
+		w[c].rate = rate;
+		w[c].sent = g.num_frames;
+		w[c].n = siggen_make(&g, &w[c].samples);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        wav_read
+ *
+ * Purpose:     Read a whole WAV file into memory.
+ *
+ * Inputs:	w->name		- File name.
+ *		decode_rate	- Resample to this rate.  0 to keep as is.
+ *
+ * Outputs:	w->samples, w->n, w->rate
+ *
+ * Returns:	0 for success, -1 for error.
+ *
+ * Description:	8 or 16 bit PCM only.  Chunks other than "fmt " and
+ *		"data" are skipped.
+ *
+ *--------------------------------------------------------------------*/
+
+static int wav_read(struct wav_s *w, int decode_rate)
+{
+	FILE *fp;
+	unsigned char hdr[12];
+	unsigned char chunk[8];
+	unsigned char fmt[16];
+	int have_fmt = 0;
+	int channels = 0, bits = 0;
+
+	fp = fopen(w->name, "rb");
+	if (fp == NULL)
+	{
+		printf("Could not open %s.\n", w->name);
+		return (-1);
+	}
+
+	if (fread(hdr, 1, 12, fp) != 12 || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0)
+	{
+		printf("%s is not a WAV file.\n", w->name);
+		fclose(fp);
+		return (-1);
+	}
+
+	while (fread(chunk, 1, 8, fp) == 8)
+	{
+		uint32_t len = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && len >= 16)
+		{
+			if (fread(fmt, 1, 16, fp) != 16)
+				break;
+			fseek(fp, len - 16 + (len & 1), SEEK_CUR);
+			channels = fmt[2] | (fmt[3] << 8);
+			w->rate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (fmt[7] << 24);
+			bits = fmt[14] | (fmt[15] << 8);
+			have_fmt = (fmt[0] | (fmt[1] << 8)) == 1 && channels >= 1 && (bits == 8 || bits == 16) &&
+					   w->rate >= MIN_SAMPLES_PER_SEC && w->rate <= MAX_IN_SAMPLES_PER_SEC;
+		}
+		else if (memcmp(chunk, "data", 4) == 0 && have_fmt)
+		{
+			int frame_bytes = channels * bits / 8;
+			unsigned char *raw = malloc(len);
+			int n, j;
+
+			if (raw == NULL)
+			{
+				printf("FATAL ERROR: Out of memory.\n");
+				exit(EXIT_FAILURE);
+			}
+			n = fread(raw, 1, len, fp) / frame_bytes;
+			fclose(fp);
+
+			w->samples = malloc((n + 1) * sizeof(int16_t));
+			if (w->samples == NULL)
+			{
+				printf("FATAL ERROR: Out of memory.\n");
+				exit(EXIT_FAILURE);
+			}
+			for (j = 0; j < n; j++)
+			{
+				unsigned char *s = raw + j * frame_bytes;
+				w->samples[j] = bits == 8 ? (s[0] - 128) * 256 : (int16_t)(s[0] | (s[1] << 8));
+			}
+			free(raw);
+			w->n = n;
+
+			if (decode_rate != 0 && w->rate != decode_rate)
+			{
+				struct resample_s *r = resample_create(w->rate, decode_rate);
+				int16_t *out;
+
+				if (r == NULL)
+				{
+					return (-1);
+				}
+				out = malloc(resample_max_out(r, n) * sizeof(int16_t));
+				if (out == NULL)
+				{
+					printf("FATAL ERROR: Out of memory.\n");
+					exit(EXIT_FAILURE);
+				}
+				w->n = resample_block(r, w->samples, n, out);
+				resample_delete(r);
+				free(w->samples);
+				w->samples = out;
+				printf("%s: Resampled from %d to %d samples per second.\n", w->name, w->rate, decode_rate);
+			}
+			return (0);
+		}
+		else
+		{
+			fseek(fp, len + (len & 1), SEEK_CUR);
+		}
+	}
+
+	printf("%s: Only 8 or 16 bit PCM WAV files can be used.\n", w->name);
+	fclose(fp);
+	return (-1);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dlq_rec_frame
+ *
+ * Purpose:     Take the place of the received frame queue.
+ *
+ * Description:	The channel tells us which profile decoded it.
+ *
+ *--------------------------------------------------------------------*/
+
+void dlq_rec_frame(int chan, int subchan, int slice, packet_t pp, alevel_t alevel, fec_type_t fec_type, retry_t retries, char *spectrum)
+{
+	(void)subchan;
+	(void)slice;
+	(void)alevel;
+	(void)retries;
+	(void)spectrum;
+
+	assert(chan >= 0 && chan < num_prof);
+
+	file_frames[this_file * MAX_CHANS + chan]++;
+	total_frames[chan]++;
+
+	if (!quiet)
+	{
+		char addrs[AX25_MAX_ADDRS * AX25_MAX_ADDR_LEN];
+		unsigned char *info;
+		int info_len;
+
+		ax25_format_addrs(pp, addrs);
+		info_len = ax25_get_info(pp, &info);
+		printf("[%s]%s %s", prof_name[chan], fec_type == fec_type_fx25 ? " FX.25" : "", addrs);
+		ax25_safe_print((char *)info, info_len, 0);
+		printf("\n");
+	}
+
+	ax25_delete(pp);
+}
+
+/* Nothing to do with audio, PTT, or the transmit queues here. */
+
+int audio_get(int a)
+{
+	(void)a;
+	return (-1);
+}
+
+void ptt_set(int ot, int chan, int ptt_signal)
+{
+	(void)ot;
+	(void)chan;
+	(void)ptt_signal;
+}
+
+int get_input(int it, int chan)
+{
+	(void)it;
+	(void)chan;
+	return (-1);
+}
+
+void tq_channel_busy_change(int chan)
+{
+	(void)chan;
+}
+
+/* Generated cases are rendered into memory, see siggen.c, so nothing comes here. */
+
+int audio_put_block(int a, const int16_t *frames, int n)
+{
+	(void)a;
+	(void)frames;
+	return (n);
+}
+
+int audio_flush(int a)
+{
+	(void)a;
+	return (0);
+}
+
+static int64_t atest_clock(void)
+{
+#if __WIN32__
+	LARGE_INTEGER freq, now;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return ((int64_t)(now.QuadPart / freq.QuadPart) * 1000000 +
+			(int64_t)(now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+}
+
+static void usage(void)
+{
+	printf("\n");
+	printf("atest is a test application which decodes AX.25 frames from WAV files\n");
+	printf("as fast as possible, for comparing demodulators.\n");
+	printf("\n");
+	printf("usage:\n");
+	printf("\n");
+	printf("        atest  [ options ]  wav-file ...\n");
+	printf("        atest  [ options ]  -S  [ wav-file ... ]\n");
+	printf("\n");
+	printf("        -B n   Bits per second.  300 or 1200 (default).\n");
+	printf("        -P list   Comma separated profiles, e.g. A,A+,B.  Default A.\n");
+	printf("        -D n   Divide audio sample rate by n.\n");
+	printf("        -F n   FIX_BITS effort level.  0 (default) to 4.\n");
+	printf("        -T n   Demodulator threads, like DEMODTHREADS.\n");
+	printf("        -X n   Fix up threads, like FIXTHREADS.\n");
+	printf("        -G ms  Skip demodulating quiet audio, like RXGATE.\n");
+	printf("        -N n   Turn off demodulators and slicers not needed in n frames, like RXPRUNE.\n");
+	printf("        -q     Quiet.  Don't print the frames.\n");
+	printf("        -C     Time spent, and frames only it got, for each demodulator.\n");
+	printf("        -S     Also decode generated test cases.\n");
+	printf("        -M n   Fail if a generated case gets under n percent of its frames.\n");
+	printf("        -R n   Fail if a profile decodes under n samples per second.\n");
+	printf("\n");
+	exit(EXIT_FAILURE);
+}
+
+/* end atest.c */
@@ -57,6 +57,19 @@
  *
  *		1.2 - Add ability to use more than one audio device.
  *
+ *		1.8 - Audio input from a ring buffer in shared memory,
+ *		      "shm:" followed by a file name.  See audioshm.h.
+ *
+ *		      Audio input from a recorded file, "file:" followed
+ *		      by the name, decoded as fast as possible.  Output
+ *		      can be "null" for none.
+ *
+ *		      APERIOD AUTO adjusts the ALSA input period and
+ *		      buffer size after overruns.
+ *
+ *		      "sdr" for channels split out of one wideband
+ *		      I/Q input by sdr.c.
+ *
  *---------------------------------------------------------------*/
 
 #include "direwolf.h"
@@ -75,6 +88,13 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <errno.h>
+#include <sys/mman.h>
+
+#if __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
 
 #if USE_ALSA
 #include <alsa/asoundlib.h>
@@ -87,6 +107,7 @@
 
 #include "audio.h"
 #include "audio_stats.h"
+#include "audioshm.h"
 #include "demod.h" /* for alevel_t & demod_get_audio_level() */
 
 /* Audio configuration. */
@@ -104,6 +125,18 @@ static struct adev_s
 
 	int bytes_per_frame; /* number of bytes for a sample from all channels. */
 						 /* e.g. 4 for stereo 16 bit. */
+						 /* Version 1.8: Output only.  Input can be different. */
+	int in_bytes_per_frame;
+
+	int in_mmap;					/* Input uses mmap access.  See audio_get_frames. */
+	snd_pcm_uframes_t mmap_offset; /* Frames taken by audio_get_frames, */
+	int mmap_frames;				/* not yet given back. */
+
+	int adapt_level;	 /* APERIOD AUTO.  Index into adapt_period_ms. */
+	int adapt_fails;	 /* Overruns so far, up to ADAPT_MAX_FAILS. */
+	int64_t adapt_start; /* Start of headroom measurement, microseconds. */
+	int64_t adapt_wait;	 /* Time spent waiting for input since then. */
+	int adapt_xruns;	 /* xruns_in at the start. */
 #elif USE_SNDIO
 	struct sio_hdl *sndio_in_handle;
 	struct sio_hdl *sndio_out_handle;
@@ -118,6 +151,14 @@ static struct adev_s
 	int inbuf_len;	/* number byte of actual data available. */
 	int inbuf_next; /* index of next to remove. */
 
+	int inbuf_taken; /* Bytes of inbuf given out by audio_get_frames. */
+
+	int16_t *in_conv; /* For audio_get_frames when samples need converting. */
+	int in_conv_size; /* Number of samples allocated. */
+
+	int xruns_in;  /* Input overruns. */
+	int xruns_out; /* Output underruns. */
+
 	int outbuf_size_in_bytes;
 	unsigned char *outbuf_ptr;
 	int outbuf_len;
@@ -126,12 +167,52 @@ static struct adev_s
 
 	int udp_sock; /* UDP socket for receiving data */
 
+	uint32_t udp_dropped; /* Last count of datagrams the system discarded. */
+
+	struct audioshm_header_s *shm; /* Shared memory input.  NULL if not used. */
+	unsigned char *shm_data;
+	uint64_t shm_pos; /* Our read position. */
+	int shm_taken;	  /* Bytes given out by audio_get_frames. */
+
+	const unsigned char *file_data; /* Recorded file input, mapped into memory. */
+	size_t file_len;				 /* Bytes of audio, after any WAV header. */
+	size_t file_pos;
+	int file_taken; /* Bytes given out by audio_get_frames. */
+
+	int out_null; /* No output device.  Transmit audio is discarded. */
+
 } adev[MAX_ADEVS];
 
 // Originally 40.  Version 1.2, try 10 for lower latency.
 
 #define ONE_BUF_TIME 10
 
+#if USE_ALSA
+
+/*
+ * Version 1.8: APERIOD AUTO.
+ *
+ * Input starts with the shortest period.  After an overrun we go to the
+ * next longer one.  After a while without an overrun, and with the
+ * receive thread waiting for audio at least half of the time, we try
+ * the next shorter one again.  The while is ADAPT_SHRINK_SEC, doubled
+ * for each overrun so far, so it settles down on a host that can't
+ * keep up with the shorter period.
+ *
+ * The ALSA buffer is ADAPT_PERIODS periods so the period also sets how
+ * long we can fall behind before losing audio.
+ */
+
+static const int adapt_period_ms[] = {5, 10, 20, 40, 80};
+
+#define ADAPT_LEVELS ((int)(sizeof(adapt_period_ms) / sizeof(adapt_period_ms[0])))
+#define ADAPT_PERIODS 4
+#define ADAPT_SHRINK_SEC 60
+#define ADAPT_MAX_FAILS 10
+
+static void alsa_in_adapt(int a, int xrun);
+#endif
+
 #if USE_ALSA
 static int set_alsa_params(int a, snd_pcm_t *handle, struct audio_s *pa, char *name, char *dir);
 // static void alsa_select_device (char *pick_dev, int direction, char *result);
@@ -142,6 +223,9 @@ static int poll_sndio(struct sio_hdl *hdl, int events);
 static int set_oss_params(int a, int fd, struct audio_s *pa);
 #endif
 
+static int shm_attach(int a, struct audio_s *pa, char *path);
+static int file_attach(int a, struct audio_s *pa, char *path);
+
 #define roundup1k(n) (((n) + 0x3ff) & ~0x3ff)
 
 static int calcbufsize(int rate, int chans, int bits)
@@ -247,6 +331,9 @@ int audio_open(struct audio_s *pa)
 		if (pa->adev[a].bits_per_sample == 0)
 			pa->adev[a].bits_per_sample = DEFAULT_BITS_PER_SAMPLE;
 
+		if (pa->adev[a].in_samples_per_sec == pa->adev[a].samples_per_sec)
+			pa->adev[a].in_samples_per_sec = 0;
+
 		for (chan = 0; chan < MAX_CHANS; chan++)
 		{
 			if (pa->achan[chan].mark_freq == 0)
@@ -303,6 +390,40 @@ int audio_open(struct audio_s *pa)
 					snprintf(pa->adev[a].adevice_in, sizeof(pa->adev[a].adevice_in), "udp:%d", DEFAULT_UDP_AUDIO_PORT);
 				}
 			}
+			if (strncasecmp(pa->adev[a].adevice_in, "shm:", 4) == 0)
+			{
+				adev[a].g_audio_in_type = AUDIO_IN_TYPE_SHM;
+			}
+			if (strncasecmp(pa->adev[a].adevice_in, "file:", 5) == 0)
+			{
+				adev[a].g_audio_in_type = AUDIO_IN_TYPE_FILE;
+			}
+			if (strcasecmp(pa->adev[a].adevice_in, "sdr") == 0)
+			{
+				adev[a].g_audio_in_type = AUDIO_IN_TYPE_SDR;
+			}
+
+			/* Version 1.8: No output device, e.g. when decoding recordings. */
+			/* A single ADEVICE name "file:..." is also used for output. */
+
+			adev[a].out_null = strcasecmp(pa->adev[a].adevice_out, "null") == 0 ||
+							   strncasecmp(pa->adev[a].adevice_out, "file:", 5) == 0;
+
+#if !USE_ALSA
+			/* Version 1.8: Wider input formats for stdin and UDP only. */
+
+			if (adev[a].g_audio_in_type == AUDIO_IN_TYPE_SOUNDCARD && pa->adev[a].in_format != AUDIO_IN_FORMAT_DEFAULT)
+			{
+				printf("Audio input format other than 8 or 16 bits is only for ALSA, stdin, or UDP.\n");
+				pa->adev[a].in_format = AUDIO_IN_FORMAT_DEFAULT;
+			}
+
+			if (adev[a].g_audio_in_type == AUDIO_IN_TYPE_SOUNDCARD && pa->adev[a].in_samples_per_sec != 0)
+			{
+				printf("Different audio input sample rate, AINRATE, is only for ALSA, stdin, or UDP.\n");
+				pa->adev[a].in_samples_per_sec = 0;
+			}
+#endif
 
 			/* Let user know what is going on. */
 
@@ -364,6 +485,11 @@ int audio_open(struct audio_s *pa)
 
 				adev[a].inbuf_size_in_bytes = set_alsa_params(a, adev[a].audio_in_handle, pa, audio_in_name, "input");
 
+				if (pa->adev[a].period_ms == APERIOD_AUTO)
+				{
+					adev[a].adapt_start = audio_stats_clock();
+				}
+
 #elif USE_SNDIO
 				adev[a].sndio_in_handle = sio_open(audio_in_name, SIO_REC, 0);
 				if (adev[a].sndio_in_handle == NULL)
@@ -436,8 +562,37 @@ int audio_open(struct audio_s *pa)
 						printf("Couldn't bind socket, errno %d\n", errno);
 						return -1;
 					}
+
+					// Version 1.8: Optionally a larger receive buffer.
+					// Linux limits this to net.core.rmem_max.
+
+					if (pa->adev[a].udp_rcvbuf > 0)
+					{
+						int want = pa->adev[a].udp_rcvbuf;
+						int got = 0;
+						socklen_t len = sizeof(got);
+
+						setsockopt(adev[a].udp_sock, SOL_SOCKET, SO_RCVBUF, &want, sizeof(want));
+						getsockopt(adev[a].udp_sock, SOL_SOCKET, SO_RCVBUF, &got, &len);
+						// Linux reports double the size set, for its overhead,
+						// so this only catches a lower system limit.
+						if (got < want)
+						{
+							printf("UDP audio receive buffer is %d bytes rather than %d requested.\n", got, want);
+							printf("The system limit might need to be raised.  e.g.  sysctl net.core.rmem_max\n");
+						}
+					}
+#ifdef SO_RXQ_OVFL
+					// Count of datagrams dropped comes with each one received.
+					int one = 1;
+					setsockopt(adev[a].udp_sock, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+#endif
 				}
+#if __linux__
+				adev[a].inbuf_size_in_bytes = SDR_UDP_BUF_MAXLEN * SDR_UDP_BATCH;
+#else
 				adev[a].inbuf_size_in_bytes = SDR_UDP_BUF_MAXLEN;
+#endif
 
 				break;
 
@@ -452,6 +607,61 @@ int audio_open(struct audio_s *pa)
 
 				break;
 
+				/*
+				 * Shared memory.
+				 */
+			case AUDIO_IN_TYPE_SHM:
+
+				if (shm_attach(a, pa, audio_in_name + 4) < 0)
+				{
+					return (-1);
+				}
+
+				/* Only for audio_get.  audio_get_frames takes it in place. */
+
+				adev[a].inbuf_size_in_bytes = 1024;
+
+				break;
+
+				/*
+				 * Recorded file.
+				 */
+			case AUDIO_IN_TYPE_FILE:
+
+				if (file_attach(a, pa, audio_in_name + 5) < 0)
+				{
+					return (-1);
+				}
+
+				/* Same as above. */
+
+				adev[a].inbuf_size_in_bytes = 1024;
+
+				/* Nothing is gained by waiting for one thread to */
+				/* do everything when the audio is all here now. */
+
+				if (pa->demod_threads == 0)
+				{
+					long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+					pa->demod_threads = ncpu / pa->adev[a].num_channels;
+					if (pa->demod_threads < 1)
+						pa->demod_threads = 1;
+					if (pa->demod_threads > MAX_SUBCHANS)
+						pa->demod_threads = MAX_SUBCHANS;
+					printf("Using %d demodulator threads for each channel.  DEMODTHREADS to override.\n", pa->demod_threads);
+				}
+
+				break;
+
+				/*
+				 * Channels split out of a wideband SDR input.
+				 * sdr.c reads that.  Nothing to open here.
+				 */
+			case AUDIO_IN_TYPE_SDR:
+
+				break;
+
 			default:
 
 				printf("Internal error, invalid audio_in_type\n");
@@ -460,56 +670,64 @@ int audio_open(struct audio_s *pa)
 
 			/*
 			 * Output device.  Only "soundcard" is supported at this time.
+			 * Version 1.8: Or "null" for none.
 			 */
 
-#if USE_ALSA
-			err = snd_pcm_open(&(adev[a].audio_out_handle), audio_out_name, SND_PCM_STREAM_PLAYBACK, 0);
-
-			if (err < 0)
+			if (adev[a].out_null)
 			{
+				adev[a].outbuf_size_in_bytes = 1024;
+			}
+			else
+			{
+#if USE_ALSA
+				err = snd_pcm_open(&(adev[a].audio_out_handle), audio_out_name, SND_PCM_STREAM_PLAYBACK, 0);
 
-				printf("Could not open audio device %s for output\n%s\n",
-					   audio_out_name, snd_strerror(err));
-				if (err == -EBUSY)
+				if (err < 0)
 				{
-					printf("This means that some other application is using that device.\n");
-					printf("The solution is to identify that other application and stop it.\n");
+
+					printf("Could not open audio device %s for output\n%s\n",
+						   audio_out_name, snd_strerror(err));
+					if (err == -EBUSY)
+					{
+						printf("This means that some other application is using that device.\n");
+						printf("The solution is to identify that other application and stop it.\n");
+					}
+					return (-1);
 				}
-				return (-1);
-			}
 
-			adev[a].outbuf_size_in_bytes = set_alsa_params(a, adev[a].audio_out_handle, pa, audio_out_name, "output");
+				adev[a].outbuf_size_in_bytes = set_alsa_params(a, adev[a].audio_out_handle, pa, audio_out_name, "output");
 
-			if (adev[a].inbuf_size_in_bytes <= 0 || adev[a].outbuf_size_in_bytes <= 0)
-			{
-				return (-1);
-			}
+				if (adev[a].inbuf_size_in_bytes <= 0 || adev[a].outbuf_size_in_bytes <= 0)
+				{
+					return (-1);
+				}
 
 #elif USE_SNDIO
-			adev[a].sndio_out_handle = sio_open(audio_out_name, SIO_PLAY, 0);
-			if (adev[a].sndio_out_handle == NULL)
-			{
+				adev[a].sndio_out_handle = sio_open(audio_out_name, SIO_PLAY, 0);
+				if (adev[a].sndio_out_handle == NULL)
+				{
 
-				printf("Could not open audio device %s for output\n",
-					   audio_out_name);
-				return (-1);
-			}
+					printf("Could not open audio device %s for output\n",
+						   audio_out_name);
+					return (-1);
+				}
 
-			adev[a].outbuf_size_in_bytes = set_sndio_params(a, adev[a].sndio_out_handle, pa, audio_out_name, "output");
+				adev[a].outbuf_size_in_bytes = set_sndio_params(a, adev[a].sndio_out_handle, pa, audio_out_name, "output");
 
-			if (adev[a].inbuf_size_in_bytes <= 0 || adev[a].outbuf_size_in_bytes <= 0)
-			{
-				return (-1);
-			}
+				if (adev[a].inbuf_size_in_bytes <= 0 || adev[a].outbuf_size_in_bytes <= 0)
+				{
+					return (-1);
+				}
 
-			if (!sio_start(adev[a].sndio_out_handle))
-			{
+				if (!sio_start(adev[a].sndio_out_handle))
+				{
 
-				printf("Could not start audio device %s for output\n",
-					   audio_out_name);
-				return (-1);
-			}
+					printf("Could not start audio device %s for output\n",
+						   audio_out_name);
+					return (-1);
+				}
 #endif
+			}
 
 			/*
 			 * Finally allocate buffer for each direction.
@@ -580,21 +798,68 @@ static int set_alsa_params(int a, snd_pcm_t *handle, struct audio_s *pa, char *d
 
 	/* Interleaved data: L, R, L, R, ... */
 
-	err = snd_pcm_hw_params_set_access(handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+	/* Version 1.8: Optionally mmap for input.  Fall back to read if not available. */
 
-	if (err < 0)
+	int mmap = *inout == 'i' && pa->adev[a].mmap_in;
+
+	if (mmap)
 	{
+		err = snd_pcm_hw_params_set_access(handle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+		if (err < 0)
+		{
+			printf("Could not use mmap access for %s %s.  Using read instead.\n%s\n",
+				   devname, inout, snd_strerror(err));
+			mmap = 0;
+		}
+	}
 
-		printf("Could not set interleaved mode.\n%s\n",
-			   snd_strerror(err));
-		printf("for %s %s.\n", devname, inout);
-		return (-1);
+	if (!mmap)
+	{
+		err = snd_pcm_hw_params_set_access(handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+
+		if (err < 0)
+		{
+
+			printf("Could not set interleaved mode.\n%s\n",
+				   snd_strerror(err));
+			printf("for %s %s.\n", devname, inout);
+			return (-1);
+		}
+	}
+
+	if (*inout == 'i')
+	{
+		adev[a].in_mmap = mmap;
 	}
 
 	/* Signed 16 bit little endian or unsigned 8 bit. */
+	/* Version 1.8: Input can also be 24 or 32 bit or float. */
+
+	int bits = pa->adev[a].bits_per_sample;
+	snd_pcm_format_t format = bits == 8 ? SND_PCM_FORMAT_U8 : SND_PCM_FORMAT_S16_LE;
+
+	if (*inout == 'i')
+	{
+		switch (pa->adev[a].in_format)
+		{
+		case AUDIO_IN_FORMAT_S24:
+			format = SND_PCM_FORMAT_S24_3LE;
+			bits = 24;
+			break;
+		case AUDIO_IN_FORMAT_S32:
+			format = SND_PCM_FORMAT_S32_LE;
+			bits = 32;
+			break;
+		case AUDIO_IN_FORMAT_FLOAT:
+			format = SND_PCM_FORMAT_FLOAT_LE;
+			bits = 32;
+			break;
+		default:
+			break;
+		}
+	}
 
-	err = snd_pcm_hw_params_set_format(handle, hw_params,
-									   pa->adev[a].bits_per_sample == 8 ? SND_PCM_FORMAT_U8 : SND_PCM_FORMAT_S16_LE);
+	err = snd_pcm_hw_params_set_format(handle, hw_params, format);
 	if (err < 0)
 	{
 
@@ -617,8 +882,15 @@ static int set_alsa_params(int a, snd_pcm_t *handle, struct audio_s *pa, char *d
 	}
 
 	/* Audio sample rate. */
+	/* Version 1.8: Input can be at a different rate, resampled later. */
 
-	val = pa->adev[a].samples_per_sec;
+	int *rate = &(pa->adev[a].samples_per_sec);
+	if (*inout == 'i' && pa->adev[a].in_samples_per_sec != 0)
+	{
+		rate = &(pa->adev[a].in_samples_per_sec);
+	}
+
+	val = *rate;
 
 	dir = 0;
 
@@ -632,15 +904,15 @@ static int set_alsa_params(int a, snd_pcm_t *handle, struct audio_s *pa, char *d
 		return (-1);
 	}
 
-	if (val != pa->adev[a].samples_per_sec)
+	if (val != *rate)
 	{
 
 		printf("Asked for %d samples/sec but got %d.\n",
 
-			   pa->adev[a].samples_per_sec, val);
+			   *rate, val);
 		printf("for %s %s.\n", devname, inout);
 
-		pa->adev[a].samples_per_sec = val;
+		*rate = val;
 	}
 
 	/* Original: */
@@ -662,19 +934,36 @@ static int set_alsa_params(int a, snd_pcm_t *handle, struct audio_s *pa, char *d
 	/* a buffer size of 882 and round it up to 1k.  This results in 512 frames per period. */
 	/* A period comes out to be about 80 periods per second or about 12.5 mSec each. */
 
-	buf_size_in_bytes = calcbufsize(pa->adev[a].samples_per_sec, pa->adev[a].num_channels, pa->adev[a].bits_per_sample);
+	/* Version 1.8: The period can be set with APERIOD. */
 
-#if __arm__
-	/* Ugly hack for RPi. */
-	/* Reducing buffer size is fine for input but not so good for output. */
+	/* Version 1.8: APERIOD AUTO picks it, for input only.  See alsa_in_adapt. */
 
-	if (*inout == 'o')
+	int adapt = *inout == 'i' && pa->adev[a].period_ms == APERIOD_AUTO;
+
+	if (adapt)
+	{
+		buf_size_in_bytes = (int)(((int64_t)*rate * pa->adev[a].num_channels * bits / 8 * adapt_period_ms[adev[a].adapt_level]) / 1000);
+	}
+	else if (pa->adev[a].period_ms > 0)
 	{
-		buf_size_in_bytes = buf_size_in_bytes * 4;
+		buf_size_in_bytes = (int)(((int64_t)*rate * pa->adev[a].num_channels * bits / 8 * pa->adev[a].period_ms) / 1000);
 	}
+	else
+	{
+		buf_size_in_bytes = calcbufsize(*rate, pa->adev[a].num_channels, bits);
+
+#if __arm__
+		/* Ugly hack for RPi. */
+		/* Reducing buffer size is fine for input but not so good for output. */
+
+		if (*inout == 'o')
+		{
+			buf_size_in_bytes = buf_size_in_bytes * 4;
+		}
 #endif
+	}
 
-	fpp = buf_size_in_bytes / (pa->adev[a].num_channels * pa->adev[a].bits_per_sample / 8);
+	fpp = buf_size_in_bytes / (pa->adev[a].num_channels * bits / 8);
 
 #if DEBUG
 
@@ -691,6 +980,19 @@ static int set_alsa_params(int a, snd_pcm_t *handle, struct audio_s *pa, char *d
 		return (-1);
 	}
 
+	if (adapt)
+	{
+		snd_pcm_uframes_t bsize = fpp * ADAPT_PERIODS;
+
+		err = snd_pcm_hw_params_set_buffer_size_near(handle, hw_params, &bsize);
+		if (err < 0)
+		{
+			printf("Could not set buffer size\n%s\n", snd_strerror(err));
+			printf("for %s %s.\n", devname, inout);
+			return (-1);
+		}
+	}
+
 	err = snd_pcm_hw_params(handle, hw_params);
 	if (err < 0)
 	{
@@ -712,21 +1014,38 @@ static int set_alsa_params(int a, snd_pcm_t *handle, struct audio_s *pa, char *d
 		return (-1);
 	}
 
+	if (*inout == 'i')
+	{
+		snd_pcm_uframes_t bsize = 0;
+
+		snd_pcm_hw_params_get_buffer_size(hw_params, &bsize);
+		audio_stats_buffer(a, *rate, (int)fpp, (int)bsize);
+	}
+
 	snd_pcm_hw_params_free(hw_params);
 
 	/* A "frame" is one sample for all channels. */
 
 	/* The read and write use units of frames, not bytes. */
 
-	adev[a].bytes_per_frame = snd_pcm_frames_to_bytes(handle, 1);
+	int bpf = snd_pcm_frames_to_bytes(handle, 1);
 
-	assert(adev[a].bytes_per_frame == pa->adev[a].num_channels * pa->adev[a].bits_per_sample / 8);
+	assert(bpf == pa->adev[a].num_channels * bits / 8);
+
+	if (*inout == 'i')
+	{
+		adev[a].in_bytes_per_frame = bpf;
+	}
+	else
+	{
+		adev[a].bytes_per_frame = bpf;
+	}
 
-	buf_size_in_bytes = fpp * adev[a].bytes_per_frame;
+	buf_size_in_bytes = fpp * bpf;
 
 #if DEBUG
 
-	printf("audio buffer size = %d (bytes per frame) x %d (frames per period) = %d \n", adev[a].bytes_per_frame, (int)fpp, buf_size_in_bytes);
+	printf("audio buffer size = %d (bytes per frame) x %d (frames per period) = %d \n", bpf, (int)fpp, buf_size_in_bytes);
 #endif
 
 	/* Version 1.3 - after a report of this situation for Mac OSX version. */
@@ -1005,300 +1324,1635 @@ static int set_oss_params(int a, int fd, struct audio_s *pa)
 
 /*------------------------------------------------------------------
  *
- * Name:        audio_get
+ * Name:        in_sample_size
  *
- * Purpose:     Get one byte from the audio device.
+ * Purpose:     Number of bytes for one input sample.
+ *
+ *----------------------------------------------------------------*/
+
+static int in_sample_size(int a)
+{
+	switch (save_audio_config_p->adev[a].in_format)
+	{
+	case AUDIO_IN_FORMAT_U8:
+		return (1);
+	case AUDIO_IN_FORMAT_S16:
+		return (2);
+	case AUDIO_IN_FORMAT_S24:
+		return (3);
+	case AUDIO_IN_FORMAT_S32:
+	case AUDIO_IN_FORMAT_FLOAT:
+		return (4);
+	default:
+		return (save_audio_config_p->adev[a].bits_per_sample / 8);
+	}
+}
+
+/* Input is already what the demodulators want, apart from byte order. */
+
+static int in_is_s16(int a)
+{
+	return (save_audio_config_p->adev[a].in_format == AUDIO_IN_FORMAT_S16 ||
+			(save_audio_config_p->adev[a].in_format == AUDIO_IN_FORMAT_DEFAULT &&
+			 save_audio_config_p->adev[a].bits_per_sample == 16));
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        convert_in
+ *
+ * Purpose:     Convert input samples to 16 bits for the demodulators.
  *
  * Inputs:	a	- Our number for audio device.
  *
- * Returns:     0 - 255 for a valid sample.
- *              -1 for any type of error.
+ *		in	- Samples in the input format, little endian.
  *
- * Description:	The caller must deal with the details of mono/stereo
- *		and number of bytes per sample.
+ *		nsam	- Number of samples, i.e. frames times channels.
  *
- *		This will wait if no data is currently available.
+ * Outputs:	out	- 16 bit signed samples.
+ *
+ * Description:	Version 1.8.  Each format has a simple loop, without
+ *		any branches except for clipping, so the compiler can use
+ *		vector instructions.  Wider samples are rounded rather
+ *		than truncated.
  *
  *----------------------------------------------------------------*/
 
-// Use hot attribute for all functions called for every audio sample.
-
-__attribute__((hot)) int audio_get(int a)
+static inline int16_t clip16(int32_t x)
 {
-	int n;
-#if USE_ALSA
-	int retries = 0;
-#endif
-
-#if STATISTICS
-	/* Gather numbers for read from audio device. */
-
-#define duration 100 /* report every 100 seconds. */
-	static time_t last_time[MAX_ADEVS];
-	time_t this_time[MAX_ADEVS];
-	static int sample_count[MAX_ADEVS];
-	static int error_count[MAX_ADEVS];
-#endif
-
-#if DEBUG
-
-	printf("audio_get():\n");
-
-#endif
+	return (x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+}
 
-	assert(adev[a].inbuf_size_in_bytes >= 100 && adev[a].inbuf_size_in_bytes <= 32768);
+__attribute__((hot)) static void convert_in(int a, const unsigned char *restrict in, int16_t *restrict out, int nsam)
+{
+	int i;
 
-	switch (adev[a].g_audio_in_type)
+	switch (save_audio_config_p->adev[a].in_format)
 	{
-
-		/*
-		 * Soundcard - ALSA
-		 */
-	case AUDIO_IN_TYPE_SOUNDCARD:
-
-#if USE_ALSA
-
-		while (adev[a].inbuf_next >= adev[a].inbuf_len)
+	case AUDIO_IN_FORMAT_S24:
+		for (i = 0; i < nsam; i++)
 		{
+			int32_t x = (int32_t)((uint32_t)in[3 * i] << 8 | (uint32_t)in[3 * i + 1] << 16 | (uint32_t)in[3 * i + 2] << 24) >> 8;
+			out[i] = clip16((x + 128) >> 8);
+		}
+		break;
 
-			assert(adev[a].audio_in_handle != NULL);
-#if DEBUG
+	case AUDIO_IN_FORMAT_S32:
+		for (i = 0; i < nsam; i++)
+		{
+			int32_t x = (int32_t)((uint32_t)in[4 * i] | (uint32_t)in[4 * i + 1] << 8 | (uint32_t)in[4 * i + 2] << 16 | (uint32_t)in[4 * i + 3] << 24);
+			out[i] = clip16((int32_t)(((int64_t)x + 32768) >> 16));
+		}
+		break;
 
-			printf("audio_get(): readi asking for %d frames\n", adev[a].inbuf_size_in_bytes / adev[a].bytes_per_frame);
-#endif
-			n = snd_pcm_readi(adev[a].audio_in_handle, adev[a].inbuf_ptr, adev[a].inbuf_size_in_bytes / adev[a].bytes_per_frame);
+	case AUDIO_IN_FORMAT_FLOAT:
+		for (i = 0; i < nsam; i++)
+		{
+			uint32_t u = (uint32_t)in[4 * i] | (uint32_t)in[4 * i + 1] << 8 | (uint32_t)in[4 * i + 2] << 16 | (uint32_t)in[4 * i + 3] << 24;
+			float f;
 
-#if DEBUG
+			memcpy(&f, &u, sizeof(f));
+			f = f * 32768.0f;
+			f = f > 32767.0f ? 32767.0f : f < -32768.0f ? -32768.0f : f;
+			out[i] = (int16_t)(f + (f >= 0 ? 0.5f : -0.5f));
+		}
+		break;
 
-			printf("audio_get(): readi asked for %d and got %d frames\n",
-				   adev[a].inbuf_size_in_bytes / adev[a].bytes_per_frame, n);
-#endif
-
-			if (n > 0)
+	default:
+		if (!in_is_s16(a))
+		{
+			for (i = 0; i < nsam; i++)
+			{
+				out[i] = (in[i] - 128) * 256;
+			}
+		}
+		else
+		{
+			for (i = 0; i < nsam; i++)
 			{
+				out[i] = (int16_t)(in[2 * i + 1] << 8 | in[2 * i]);
+			}
+		}
+		break;
+	}
+}
 
-				/* Success */
+#if __linux__
 
-				adev[a].inbuf_len = n * adev[a].bytes_per_frame; /* convert to number of bytes */
-				adev[a].inbuf_next = 0;
+/*------------------------------------------------------------------
+ *
+ * Name:        udp_recv_batch
+ *
+ * Purpose:     Read as many UDP audio datagrams as are waiting, up to
+ *		SDR_UDP_BATCH, with one system call.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *
+ * Returns:     Number of bytes now in inbuf or -1 for error.
+ *
+ * Description:	Version 1.8: This waits for the first datagram only.
+ *		They are received into separate parts of inbuf and then
+ *		moved together.
+ *
+ *		Raw audio from rtl_fm, GQRX, etc. has no sequence numbers
+ *		so we can't see a gap in the data itself.  Instead, the
+ *		system tells us how many datagrams it had to discard
+ *		because the receive buffer was full (SO_RXQ_OVFL).
+ *		That goes into the periodic audio statistics.
+ *
+ *----------------------------------------------------------------*/
 
-				audio_stats(a,
-							save_audio_config_p->adev[a].num_channels,
-							n,
-							save_audio_config_p->statistics_interval);
-			}
-			else if (n == 0)
-			{
+static int udp_recv_batch(int a)
+{
+	struct mmsghdr msgs[SDR_UDP_BATCH];
+	struct iovec iov[SDR_UDP_BATCH];
+	union
+	{
+		char buf[CMSG_SPACE(sizeof(uint32_t))];
+		struct cmsghdr align;
+	} control[SDR_UDP_BATCH];
+	int nmsg = adev[a].inbuf_size_in_bytes / SDR_UDP_BUF_MAXLEN;
+	int n, i;
+	int len;
 
-				/* Didn't expect this, but it's not a problem. */
-				/* Wait a little while and try again. */
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < nmsg; i++)
+	{
+		iov[i].iov_base = adev[a].inbuf_ptr + i * SDR_UDP_BUF_MAXLEN;
+		iov[i].iov_len = SDR_UDP_BUF_MAXLEN;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = control[i].buf;
+		msgs[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+	}
 
-				printf("Audio input got zero bytes: %s\n", snd_strerror(n));
-				SLEEP_MS(10);
+	n = recvmmsg(adev[a].udp_sock, msgs, nmsg, MSG_WAITFORONE, NULL);
+	if (n <= 0)
+	{
+		return (-1);
+	}
 
-				adev[a].inbuf_len = 0;
-				adev[a].inbuf_next = 0;
-			}
-			else
+	len = 0;
+	for (i = 0; i < n; i++)
+	{
+		if (i > 0 && msgs[i].msg_len > 0)
+		{
+			memmove(adev[a].inbuf_ptr + len, iov[i].iov_base, msgs[i].msg_len);
+		}
+		len += msgs[i].msg_len;
+	}
+
+#ifdef SO_RXQ_OVFL
+	struct cmsghdr *cm;
+
+	for (cm = CMSG_FIRSTHDR(&msgs[n - 1].msg_hdr); cm != NULL; cm = CMSG_NXTHDR(&msgs[n - 1].msg_hdr, cm))
+	{
+		if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL)
+		{
+			uint32_t dropped;
+
+			memcpy(&dropped, CMSG_DATA(cm), sizeof(dropped));
+			if (dropped != adev[a].udp_dropped)
 			{
-				/* Error */
-				// TODO: Needs more study and testing.
+				audio_stats_udp_lost(a, (int)(dropped - adev[a].udp_dropped));
+				adev[a].udp_dropped = dropped;
+			}
+		}
+	}
+#endif
+	return (len);
+}
 
-				// Only expected error conditions:
-				//    -EBADFD	PCM is not in the right state (SND_PCM_STATE_PREPARED or SND_PCM_STATE_RUNNING)
-				//    -EPIPE	an overrun occurred
-				//    -ESTRPIPE	a suspend event occurred (stream is suspended and waiting for an application recovery)
+#endif /* __linux__ */
 
-				// Data overrun is displayed as "broken pipe" which seems a little misleading.
-				// Add our own message which says something about CPU being too slow.
+/*------------------------------------------------------------------
+ *
+ * Name:        shm_attach
+ *
+ * Purpose:     Map the shared memory ring buffer for audio input.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *		pa	- Audio configuration.
+ *		path	- File name, after the "shm:" prefix.
+ *
+ * Returns:     0 for success, -1 for failure.
+ *
+ * Description:	Version 1.8.  The other application must already have
+ *		created the file.  The header tells us what kind of audio
+ *		is in it.  A different sample rate gets resampled, the same
+ *		as AINRATE, and the format takes the place of AINFORMAT.
+ *
+ *----------------------------------------------------------------*/
 
-				printf("Audio input device %d error code %d: %s\n", a, n, snd_strerror(n));
+static int shm_attach(int a, struct audio_s *pa, char *path)
+{
+	struct audioshm_header_s *h;
+	struct stat st;
+	void *p;
+	int fd;
 
-				if (n == (-EPIPE))
-				{
-					printf("This is most likely caused by the CPU being too slow to keep up with the audio stream.\n");
-					printf("Use the \"top\" command, in another command window, to look at CPU usage.\n");
-					printf("This might be a temporary condition so we will attempt to recover a few times before giving up.\n");
-					printf("If using a very slow CPU, try reducing the CPU load by using -P- command\n");
-					printf("line option for 9600 bps or -D3 for slower AFSK .\n");
-				}
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+	{
+		printf("Could not open shared memory audio input %s.\n", path);
+		printf("%s\n", strerror(errno));
+		printf("The application providing the audio must be started first.\n");
+		return (-1);
+	}
 
-				audio_stats(a,
-							save_audio_config_p->adev[a].num_channels,
-							0,
-							save_audio_config_p->statistics_interval);
+	if (fstat(fd, &st) != 0 || st.st_size < AUDIOSHM_HEADER_SIZE)
+	{
+		printf("Shared memory audio input %s is too small.\n", path);
+		close(fd);
+		return (-1);
+	}
 
-				/* Try to recover a few times and eventually give up. */
-				if (++retries > 10)
-				{
-					adev[a].inbuf_len = 0;
-					adev[a].inbuf_next = 0;
-					return (-1);
-				}
+	p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+	{
+		printf("Could not map shared memory audio input %s.\n", path);
+		printf("%s\n", strerror(errno));
+		return (-1);
+	}
 
-				if (n == -EPIPE)
-				{
+	h = p;
+	if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != AUDIOSHM_MAGIC ||
+		h->version != AUDIOSHM_VERSION ||
+		h->header_size != AUDIOSHM_HEADER_SIZE ||
+		h->data_size == 0 || (h->data_size & (h->data_size - 1)) != 0 ||
+		(off_t)h->header_size + h->data_size > st.st_size)
+	{
+		printf("Shared memory audio input %s does not have a valid header.\n", path);
+		munmap(p, st.st_size);
+		return (-1);
+	}
 
-					/* EPIPE means overrun */
+	if ((int)h->num_channels != pa->adev[a].num_channels)
+	{
+		printf("Shared memory audio input %s has %d channels but audio device %d is configured for %d.\n",
+			   path, h->num_channels, a, pa->adev[a].num_channels);
+		munmap(p, st.st_size);
+		return (-1);
+	}
 
-					snd_pcm_recover(adev[a].audio_in_handle, n, 1);
-				}
-				else
-				{
-					/* Could be some temporary condition. */
-					/* Wait a little then try again. */
-					/* Sometimes I get "Resource temporarily available" */
-					/* when the Update Manager decides to run. */
+	switch (h->format)
+	{
+	case AUDIOSHM_FORMAT_S16:
+		pa->adev[a].in_format = AUDIO_IN_FORMAT_S16;
+		break;
+	case AUDIOSHM_FORMAT_S24:
+		pa->adev[a].in_format = AUDIO_IN_FORMAT_S24;
+		break;
+	case AUDIOSHM_FORMAT_S32:
+		pa->adev[a].in_format = AUDIO_IN_FORMAT_S32;
+		break;
+	case AUDIOSHM_FORMAT_F32:
+		pa->adev[a].in_format = AUDIO_IN_FORMAT_FLOAT;
+		break;
+	default:
+		printf("Shared memory audio input %s has unknown sample format %d.\n", path, h->format);
+		munmap(p, st.st_size);
+		return (-1);
+	}
 
-					SLEEP_MS(250);
-					snd_pcm_recover(adev[a].audio_in_handle, n, 1);
-				}
+	if ((int)h->sample_rate < MIN_SAMPLES_PER_SEC || (int)h->sample_rate > MAX_IN_SAMPLES_PER_SEC)
+	{
+		printf("Shared memory audio input %s has unreasonable sample rate %d.\n", path, h->sample_rate);
+		munmap(p, st.st_size);
+		return (-1);
+	}
+	pa->adev[a].in_samples_per_sec = (int)h->sample_rate == pa->adev[a].samples_per_sec ? 0 : (int)h->sample_rate;
+
+	adev[a].shm = h;
+	adev[a].shm_data = (unsigned char *)p + h->header_size;
+	adev[a].shm_pos = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+	adev[a].shm_taken = 0;
+
+	printf("Audio input from shared memory %s, %d samples per second, %u bytes.\n", path, h->sample_rate, h->data_size);
+	return (0);
+
+} /* end shm_attach */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        shm_wait
+ *
+ * Purpose:     Wait for audio in the shared memory ring buffer.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *		need	- Number of bytes wanted, normally one frame.
+ *
+ * Returns:     Number of bytes available at shm_pos.
+ *		-1 when the writer has closed and all has been read.
+ *
+ * Description:	If we have fallen more than the size of the ring behind,
+ *		what we haven't read is gone.  Skip to the newest and count
+ *		it as an input overrun.
+ *
+ *		On Linux we sleep on the futex word in the header.  The
+ *		waiters count lets the writer skip the wake up system call
+ *		when nobody is sleeping.  Elsewhere we poll every millisecond.
+ *
+ *----------------------------------------------------------------*/
+
+static int64_t shm_wait(int a, int need)
+{
+	struct audioshm_header_s *h = adev[a].shm;
+
+	while (1)
+	{
+		uint64_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+		uint64_t avail = head - adev[a].shm_pos;
+
+		if (avail > h->data_size)
+		{
+			adev[a].xruns_in++;
+			audio_stats_xrun(a);
+			adev[a].shm_pos = head;
+			continue;
+		}
+		if (avail >= (uint64_t)need)
+		{
+			return ((int64_t)avail);
+		}
+		if (__atomic_load_n(&h->closed, __ATOMIC_ACQUIRE))
+		{
+			if (__atomic_load_n(&h->head, __ATOMIC_ACQUIRE) == head)
+			{
+				return (-1);
 			}
+			continue;
 		}
 
-#elif USE_SNDIO
+#if __linux__
+		uint32_t seq = __atomic_load_n(&h->futex, __ATOMIC_SEQ_CST);
+
+		__atomic_add_fetch(&h->waiters, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&h->head, __ATOMIC_SEQ_CST) == head && !__atomic_load_n(&h->closed, __ATOMIC_SEQ_CST))
+		{
+			struct timespec ts = {1, 0}; // In case the writer went away without closing.
+
+			syscall(SYS_futex, &h->futex, FUTEX_WAIT, seq, &ts, NULL, 0);
+		}
+		__atomic_sub_fetch(&h->waiters, 1, __ATOMIC_SEQ_CST);
+#else
+		usleep(1000);
+#endif
+	}
+
+} /* end shm_wait */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        shm_get_frames
+ *
+ * Purpose:     audio_get_frames for shared memory input.
+ *
+ * Description:	16 bit samples are used right where they are in the ring.
+ *		A frame that wraps around the end of the ring, only possible
+ *		with 24 bit stereo, is put together on its own.
+ *
+ *----------------------------------------------------------------*/
+
+static int16_t *conv_buf(int a, int n);
+
+static int shm_get_frames(int a, const int16_t **frames, int max)
+{
+	struct audioshm_header_s *h = adev[a].shm;
+	int nchan = save_audio_config_p->adev[a].num_channels;
+	int bpf = nchan * in_sample_size(a);
+	int64_t avail;
+	uint32_t off, contig;
+	int16_t *out;
+	int n;
+
+	avail = shm_wait(a, bpf);
+	if (avail < 0)
+	{
+		printf("End of audio from shared memory input.\n");
+		return (-1);
+	}
+
+	off = adev[a].shm_pos & (h->data_size - 1);
+	contig = h->data_size - off;
+	if (contig > avail)
+	{
+		contig = avail;
+	}
+	n = contig / bpf;
+
+	if (n == 0)
+	{
+		unsigned char one[2 * 4];
+
+		memcpy(one, adev[a].shm_data + off, contig);
+		memcpy(one + contig, adev[a].shm_data, bpf - contig);
+		out = conv_buf(a, 1);
+		convert_in(a, one, out, nchan);
+		*frames = out;
+		adev[a].shm_taken = bpf;
+		n = 1;
+	}
+	else
+	{
+		if (n > max)
+		{
+			n = max;
+		}
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		if (in_is_s16(a) && (off & 1) == 0)
+		{
+			*frames = (const int16_t *)(adev[a].shm_data + off);
+		}
+		else
+#endif
+		{
+			out = conv_buf(a, n);
+			convert_in(a, adev[a].shm_data + off, out, n * nchan);
+			*frames = out;
+		}
+		adev[a].shm_taken = n * bpf;
+	}
+
+	audio_stats(a, nchan, n, save_audio_config_p->statistics_interval);
+
+	return (n);
+
+} /* end shm_get_frames */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        file_attach
+ *
+ * Purpose:     Map a recorded audio file for input.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *		pa	- Audio configuration.
+ *		path	- File name, after the "file:" prefix.
+ *
+ * Returns:     0 for success, -1 for failure.
+ *
+ * Description:	Version 1.8.  For decoding recordings again, e.g. after
+ *		changing the configuration, much faster than real time.
+ *		The whole file is mapped into memory and samples are used
+ *		right from there.
+ *
+ *		A WAV file header tells us the sample rate, number of
+ *		channels, and sample format.  A different rate gets
+ *		resampled, the same as AINRATE.  Anything else is taken
+ *		as raw audio in the configured format.
+ *
+ *----------------------------------------------------------------*/
+
+static unsigned int rd16(const unsigned char *p)
+{
+	return (p[0] | p[1] << 8);
+}
+
+static uint32_t rd32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+static int file_attach(int a, struct audio_s *pa, char *path)
+{
+	struct stat st;
+	const unsigned char *p;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("Could not open audio input file %s.\n", path);
+		printf("%s\n", strerror(errno));
+		return (-1);
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		printf("Audio input file %s is empty.\n", path);
+		close(fd);
+		return (-1);
+	}
+
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+	{
+		printf("Could not map audio input file %s.\n", path);
+		printf("%s\n", strerror(errno));
+		return (-1);
+	}
+	madvise((void *)p, st.st_size, MADV_SEQUENTIAL);
+
+	adev[a].file_data = p;
+	adev[a].file_len = st.st_size;
+	adev[a].file_pos = 0;
+	adev[a].file_taken = 0;
+
+	if (st.st_size < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0)
+	{
+		printf("Audio input file %s, raw audio, %d samples per second.\n", path,
+			   pa->adev[a].in_samples_per_sec ? pa->adev[a].in_samples_per_sec : pa->adev[a].samples_per_sec);
+		return (0);
+	}
+
+	/* Find the "fmt " and "data" chunks. */
+
+	size_t pos = 12;
+	unsigned int tag = 0, nchan = 0, bits = 0;
+	uint32_t rate = 0;
+
+	while (pos + 8 <= (size_t)st.st_size)
+	{
+		uint32_t len = rd32(p + pos + 4);
+
+		if (memcmp(p + pos, "fmt ", 4) == 0 && len >= 16 && pos + 8 + len <= (size_t)st.st_size)
+		{
+			tag = rd16(p + pos + 8);
+			nchan = rd16(p + pos + 10);
+			rate = rd32(p + pos + 12);
+			bits = rd16(p + pos + 22);
+			if (tag == 0xfffe && len >= 26) /* WAVE_FORMAT_EXTENSIBLE */
+			{
+				tag = rd16(p + pos + 32);
+			}
+		}
+		else if (memcmp(p + pos, "data", 4) == 0)
+		{
+			adev[a].file_data = p + pos + 8;
+			adev[a].file_len = st.st_size - (pos + 8);
+
+			/* Some programs writing to a pipe leave this 0 or all ones. */
+
+			if (len != 0 && len < adev[a].file_len)
+			{
+				adev[a].file_len = len;
+			}
+			break;
+		}
+		pos += 8 + (size_t)len + (len & 1);
+	}
+
+	if (tag == 0 || adev[a].file_data == p)
+	{
+		printf("Audio input file %s is not a WAV file we understand.\n", path);
+		return (-1);
+	}
+
+	if (tag == 1 && bits == 8)
+		pa->adev[a].in_format = AUDIO_IN_FORMAT_U8;
+	else if (tag == 1 && bits == 16)
+		pa->adev[a].in_format = AUDIO_IN_FORMAT_S16;
+	else if (tag == 1 && bits == 24)
+		pa->adev[a].in_format = AUDIO_IN_FORMAT_S24;
+	else if (tag == 1 && bits == 32)
+		pa->adev[a].in_format = AUDIO_IN_FORMAT_S32;
+	else if (tag == 3 && bits == 32)
+		pa->adev[a].in_format = AUDIO_IN_FORMAT_FLOAT;
+	else
+	{
+		printf("Audio input file %s has unsupported sample format %d, %d bits.\n", path, tag, bits);
+		return (-1);
+	}
+
+	if ((int)nchan != pa->adev[a].num_channels)
+	{
+		printf("Audio input file %s has %d channels but audio device %d is configured for %d.\n",
+			   path, nchan, a, pa->adev[a].num_channels);
+		return (-1);
+	}
+
+	if ((int)rate < MIN_SAMPLES_PER_SEC || (int)rate > MAX_IN_SAMPLES_PER_SEC)
+	{
+		printf("Audio input file %s has unreasonable sample rate %d.\n", path, rate);
+		return (-1);
+	}
+	pa->adev[a].in_samples_per_sec = (int)rate == pa->adev[a].samples_per_sec ? 0 : (int)rate;
+
+	printf("Audio input file %s, %d samples per second, %d bits, %.1f seconds.\n", path, rate, bits,
+		   (double)adev[a].file_len / (nchan * (bits / 8)) / rate);
+	return (0);
+
+} /* end file_attach */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        file_get_frames
+ *
+ * Purpose:     audio_get_frames for a recorded file.
+ *
+ * Description:	Statistics are not collected.  The rate would only say
+ *		how fast we are going.  recv.c reports that at the end.
+ *
+ *----------------------------------------------------------------*/
+
+static int file_get_frames(int a, const int16_t **frames, int max)
+{
+	int nchan = save_audio_config_p->adev[a].num_channels;
+	int bpf = nchan * in_sample_size(a);
+	size_t n;
+
+	n = (adev[a].file_len - adev[a].file_pos) / bpf;
+	if (n == 0)
+	{
+		printf("End of audio input file.\n");
+		return (-1);
+	}
+	if (n > (size_t)max)
+	{
+		n = max;
+	}
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if (in_is_s16(a) && ((uintptr_t)(adev[a].file_data + adev[a].file_pos) & 1) == 0)
+	{
+		*frames = (const int16_t *)(adev[a].file_data + adev[a].file_pos);
+	}
+	else
+#endif
+	{
+		int16_t *out = conv_buf(a, n);
+
+		convert_in(a, adev[a].file_data + adev[a].file_pos, out, n * nchan);
+		*frames = out;
+	}
+	adev[a].file_taken = n * bpf;
+
+	return ((int)n);
+
+} /* end file_get_frames */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_fill
+ *
+ * Purpose:     Refill the input buffer, from whichever source, after
+ *		everything in it has been used.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *
+ * Returns:     0 for success.
+ *              -1 for any type of error.
+ *
+ * Description:	This will wait if no data is currently available.
+ *
+ *		Version 1.8: Pulled out of audio_get for audio_get_frames.
+ *
+ *----------------------------------------------------------------*/
+
+static int audio_fill(int a)
+{
+	int n;
+#if USE_ALSA
+	int retries = 0;
+#endif
+
+	adev[a].inbuf_taken = 0;
+
+	switch (adev[a].g_audio_in_type)
+	{
+
+		/*
+		 * Soundcard - ALSA
+		 */
+	case AUDIO_IN_TYPE_SOUNDCARD:
+
+#if USE_ALSA
+
+		while (adev[a].inbuf_next >= adev[a].inbuf_len)
+		{
+
+			assert(adev[a].audio_in_handle != NULL);
+#if DEBUG
+
+			printf("audio_get(): readi asking for %d frames\n", adev[a].inbuf_size_in_bytes / adev[a].in_bytes_per_frame);
+#endif
+			alsa_in_adapt(a, 0);
+
+			int64_t t0 = adev[a].adapt_start ? audio_stats_clock() : 0;
+
+			if (adev[a].in_mmap)
+			{
+				n = snd_pcm_mmap_readi(adev[a].audio_in_handle, adev[a].inbuf_ptr, adev[a].inbuf_size_in_bytes / adev[a].in_bytes_per_frame);
+			}
+			else
+			{
+				n = snd_pcm_readi(adev[a].audio_in_handle, adev[a].inbuf_ptr, adev[a].inbuf_size_in_bytes / adev[a].in_bytes_per_frame);
+			}
+
+			if (t0)
+			{
+				adev[a].adapt_wait += audio_stats_clock() - t0;
+			}
+
+#if DEBUG
+
+			printf("audio_get(): readi asked for %d and got %d frames\n",
+				   adev[a].inbuf_size_in_bytes / adev[a].in_bytes_per_frame, n);
+#endif
+
+			if (n > 0)
+			{
+
+				/* Success */
+
+				adev[a].inbuf_len = n * adev[a].in_bytes_per_frame; /* convert to number of bytes */
+				adev[a].inbuf_next = 0;
+
+				audio_stats(a,
+							save_audio_config_p->adev[a].num_channels,
+							n,
+							save_audio_config_p->statistics_interval);
+			}
+			else if (n == 0)
+			{
+
+				/* Didn't expect this, but it's not a problem. */
+				/* Wait a little while and try again. */
+
+				printf("Audio input got zero bytes: %s\n", snd_strerror(n));
+				SLEEP_MS(10);
+
+				adev[a].inbuf_len = 0;
+				adev[a].inbuf_next = 0;
+			}
+			else
+			{
+				/* Error */
+				// TODO: Needs more study and testing.
+
+				// Only expected error conditions:
+				//    -EBADFD	PCM is not in the right state (SND_PCM_STATE_PREPARED or SND_PCM_STATE_RUNNING)
+				//    -EPIPE	an overrun occurred
+				//    -ESTRPIPE	a suspend event occurred (stream is suspended and waiting for an application recovery)
+
+				// Data overrun is displayed as "broken pipe" which seems a little misleading.
+				// Add our own message which says something about CPU being too slow.
+
+				printf("Audio input device %d error code %d: %s\n", a, n, snd_strerror(n));
+
+				if (n == (-EPIPE))
+				{
+					adev[a].xruns_in++;
+					audio_stats_xrun(a);
+					printf("This is most likely caused by the CPU being too slow to keep up with the audio stream.\n");
+					printf("Use the \"top\" command, in another command window, to look at CPU usage.\n");
+					printf("This might be a temporary condition so we will attempt to recover a few times before giving up.\n");
+					printf("If using a very slow CPU, try reducing the CPU load by using -P- command\n");
+					printf("line option for 9600 bps or -D3 for slower AFSK .\n");
+				}
+
+				audio_stats(a,
+							save_audio_config_p->adev[a].num_channels,
+							0,
+							save_audio_config_p->statistics_interval);
+
+				/* Try to recover a few times and eventually give up. */
+				if (++retries > 10)
+				{
+					adev[a].inbuf_len = 0;
+					adev[a].inbuf_next = 0;
+					return (-1);
+				}
+
+				if (n == -EPIPE)
+				{
+
+					/* EPIPE means overrun */
+
+					alsa_in_adapt(a, 1);
+					snd_pcm_recover(adev[a].audio_in_handle, n, 1);
+				}
+				else
+				{
+					/* Could be some temporary condition. */
+					/* Wait a little then try again. */
+					/* Sometimes I get "Resource temporarily available" */
+					/* when the Update Manager decides to run. */
+
+					SLEEP_MS(250);
+					snd_pcm_recover(adev[a].audio_in_handle, n, 1);
+				}
+			}
+		}
+
+#elif USE_SNDIO
+
+		while (adev[a].inbuf_next >= adev[a].inbuf_len)
+		{
+
+			assert(adev[a].sndio_in_handle != NULL);
+			if (poll_sndio(adev[a].sndio_in_handle, POLLIN) < 0)
+			{
+				adev[a].inbuf_len = 0;
+				adev[a].inbuf_next = 0;
+				return (-1);
+			}
+
+			n = sio_read(adev[a].sndio_in_handle, adev[a].inbuf_ptr, adev[a].inbuf_size_in_bytes);
+			adev[a].inbuf_len = n;
+			adev[a].inbuf_next = 0;
+
+			audio_stats(a,
+						save_audio_config_p->adev[a].num_channels,
+						n / (save_audio_config_p->adev[a].num_channels * in_sample_size(a)),
+						save_audio_config_p->statistics_interval);
+		}
+
+#else /* begin OSS */
+
+		/* Fixed in 1.2.  This was formerly outside of the switch */
+		/* so the OSS version did not process stdin or UDP. */
+
+		while (adev[a].g_audio_in_type == AUDIO_IN_TYPE_SOUNDCARD && adev[a].inbuf_next >= adev[a].inbuf_len)
+		{
+			assert(adev[a].oss_audio_device_fd > 0);
+			n = read(adev[a].oss_audio_device_fd, adev[a].inbuf_ptr, adev[a].inbuf_size_in_bytes);
+			//
+			// printf ("audio_get(): read %d returns %d\n", adev[a].inbuf_size_in_bytes, n);
+			if (n < 0)
+			{
+
+				perror("Can't read from audio device");
+				adev[a].inbuf_len = 0;
+				adev[a].inbuf_next = 0;
+
+				audio_stats(a,
+							save_audio_config_p->adev[a].num_channels,
+							0,
+							save_audio_config_p->statistics_interval);
+
+				return (-1);
+			}
+			adev[a].inbuf_len = n;
+			adev[a].inbuf_next = 0;
+
+			audio_stats(a,
+						save_audio_config_p->adev[a].num_channels,
+						n / (save_audio_config_p->adev[a].num_channels * in_sample_size(a)),
+						save_audio_config_p->statistics_interval);
+		}
+
+#endif /* USE_ALSA */
+
+		break;
+
+		/*
+		 * UDP.
+		 */
+
+	case AUDIO_IN_TYPE_SDR_UDP:
+
+		while (adev[a].inbuf_next >= adev[a].inbuf_len)
+		{
+			int res;
+
+			assert(adev[a].udp_sock > 0);
+#if __linux__
+			res = udp_recv_batch(a);
+#else
+			res = recv(adev[a].udp_sock, adev[a].inbuf_ptr, adev[a].inbuf_size_in_bytes, 0);
+#endif
+			if (res < 0)
+			{
+
+				printf("Can't read from udp socket, res=%d", res);
+				adev[a].inbuf_len = 0;
+				adev[a].inbuf_next = 0;
+
+				audio_stats(a,
+							save_audio_config_p->adev[a].num_channels,
+							0,
+							save_audio_config_p->statistics_interval);
+
+				return (-1);
+			}
+
+			adev[a].inbuf_len = res;
+			adev[a].inbuf_next = 0;
+
+			audio_stats(a,
+						save_audio_config_p->adev[a].num_channels,
+						res / (save_audio_config_p->adev[a].num_channels * in_sample_size(a)),
+						save_audio_config_p->statistics_interval);
+		}
+		break;
+
+		/*
+		 * stdin.
+		 */
+	case AUDIO_IN_TYPE_STDIN:
+
+		while (adev[a].inbuf_next >= adev[a].inbuf_len)
+		{
+			// int ch, res,i;
+			int res;
+
+			res = read(STDIN_FILENO, adev[a].inbuf_ptr, (size_t)adev[a].inbuf_size_in_bytes);
+			if (res <= 0)
+			{
+
+				printf("\nEnd of file on stdin.  Exiting.\n");
+				exit(0);
+			}
+
+			audio_stats(a,
+						save_audio_config_p->adev[a].num_channels,
+						res / (save_audio_config_p->adev[a].num_channels * in_sample_size(a)),
+						save_audio_config_p->statistics_interval);
+
+			adev[a].inbuf_len = res;
+			adev[a].inbuf_next = 0;
+		}
+
+		break;
+
+		/*
+		 * Shared memory.  Only for audio_get.  audio_get_frames
+		 * normally takes the samples without copying.
+		 */
+	case AUDIO_IN_TYPE_SHM:
+
+		while (adev[a].inbuf_next >= adev[a].inbuf_len)
+		{
+			int64_t avail = shm_wait(a, 1);
+			uint32_t off, len;
+
+			if (avail < 0)
+			{
+				printf("End of audio from shared memory input.\n");
+				adev[a].inbuf_len = 0;
+				adev[a].inbuf_next = 0;
+				return (-1);
+			}
+
+			off = adev[a].shm_pos & (adev[a].shm->data_size - 1);
+			len = adev[a].shm->data_size - off;
+			if (len > avail)
+				len = avail;
+			if (len > (uint32_t)adev[a].inbuf_size_in_bytes)
+				len = adev[a].inbuf_size_in_bytes;
+
+			memcpy(adev[a].inbuf_ptr, adev[a].shm_data + off, len);
+			adev[a].shm_pos += len;
+
+			adev[a].inbuf_len = len;
+			adev[a].inbuf_next = 0;
+
+			audio_stats(a,
+						save_audio_config_p->adev[a].num_channels,
+						len / (save_audio_config_p->adev[a].num_channels * in_sample_size(a)),
+						save_audio_config_p->statistics_interval);
+		}
+
+		break;
+
+		/*
+		 * Recorded file.  Only for audio_get.
+		 */
+	case AUDIO_IN_TYPE_FILE:
+
+		if (adev[a].inbuf_next >= adev[a].inbuf_len)
+		{
+			size_t len = adev[a].file_len - adev[a].file_pos;
+
+			if (len == 0)
+			{
+				printf("End of audio input file.\n");
+				adev[a].inbuf_len = 0;
+				adev[a].inbuf_next = 0;
+				return (-1);
+			}
+			if (len > (size_t)adev[a].inbuf_size_in_bytes)
+				len = adev[a].inbuf_size_in_bytes;
+
+			memcpy(adev[a].inbuf_ptr, adev[a].file_data + adev[a].file_pos, len);
+			adev[a].file_pos += len;
+
+			adev[a].inbuf_len = len;
+			adev[a].inbuf_next = 0;
+		}
+
+		break;
+
+		/*
+		 * Audio for these channels doesn't come through here.  See sdr.c.
+		 */
+	case AUDIO_IN_TYPE_SDR:
+
+		return (-1);
+	}
+
+
+	return (0);
+
+} /* end audio_fill */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_get
+ *
+ * Purpose:     Get one byte from the audio device.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *
+ * Returns:     0 - 255 for a valid sample.
+ *              -1 for any type of error.
+ *
+ * Description:	The caller must deal with the details of mono/stereo
+ *		and number of bytes per sample.
+ *
+ *		This will wait if no data is currently available.
+ *
+ *----------------------------------------------------------------*/
+
+// Use hot attribute for all functions called for every audio sample.
+
+__attribute__((hot)) int audio_get(int a)
+{
+	int n;
+
+#if STATISTICS
+	/* Gather numbers for read from audio device. */
+
+#define duration 100 /* report every 100 seconds. */
+	static time_t last_time[MAX_ADEVS];
+	time_t this_time[MAX_ADEVS];
+	static int sample_count[MAX_ADEVS];
+	static int error_count[MAX_ADEVS];
+#endif
+
+#if DEBUG
+
+	printf("audio_get():\n");
+
+#endif
+
+	assert(adev[a].inbuf_size_in_bytes >= 100 && adev[a].inbuf_size_in_bytes <= 32768);
+
+	if (adev[a].inbuf_next >= adev[a].inbuf_len)
+	{
+		if (audio_fill(a) < 0)
+		{
+			return (-1);
+		}
+	}
+
+	if (adev[a].inbuf_next < adev[a].inbuf_len)
+		n = adev[a].inbuf_ptr[adev[a].inbuf_next++];
+	// No data to read, avoid reading outside buffer
+	else
+		n = 0;
+
+#if DEBUG
+
+	printf("audio_get(): returns %d\n", n);
+
+#endif
+
+	return (n);
+
+} /* end audio_get */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_get_frames
+ *
+ * Purpose:     Get a block of audio frames from the audio device.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *
+ *		max	- Most frames wanted.
+ *
+ * Outputs:	frames	- Address of 16 bit signed samples.  For stereo,
+ *			  left and right alternate, starting with left.
+ *
+ * Returns:     Number of frames, at least 1.
+ *              -1 for any type of error or end of file.
+ *
+ * Description:	Version 1.8: The receive thread uses this rather than
+ *		audio_get for each byte.
+ *
+ *		This will wait if no data is currently available.  After
+ *		that, only what is already here is returned so it could
+ *		be fewer than max.
+ *
+ *		The samples stay in place until audio_release_frames.
+ *		It should be called before asking for more.
+ *
+ *		For ALSA with mmap (AMMAP), this is the buffer shared with
+ *		the sound card.  For "shm:" input, it is the ring buffer
+ *		shared with the other application.  Otherwise, when the device gives us 16 bit
+ *		samples, it is our input buffer.  Other formats (AINFORMAT),
+ *		and everything on big endian hosts, are converted with
+ *		convert_in.  Partial frames from stdin or UDP are put
+ *		together a byte at a time.
+ *
+ *----------------------------------------------------------------*/
+
+#if USE_ALSA
+static int alsa_in_recover(int a, int err);
+static int mmap_get_frames(int a, const int16_t **frames, int max);
+#endif
+
+/* Make sure there is room for converting n frames. */
+
+static int16_t *conv_buf(int a, int n)
+{
+	int nsam = n * save_audio_config_p->adev[a].num_channels;
+
+	if (nsam > adev[a].in_conv_size)
+	{
+		adev[a].in_conv = realloc(adev[a].in_conv, nsam * sizeof(int16_t));
+		if (adev[a].in_conv == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		adev[a].in_conv_size = nsam;
+	}
+	return (adev[a].in_conv);
+}
+
+__attribute__((hot)) int audio_get_frames(int a, const int16_t **frames, int max)
+{
+	int nchan = save_audio_config_p->adev[a].num_channels;
+	int bpf = nchan * in_sample_size(a);
+	int16_t *out;
+	int n;
+
+	assert(max > 0);
+
+#if USE_ALSA
+	if (adev[a].g_audio_in_type == AUDIO_IN_TYPE_SOUNDCARD && adev[a].in_mmap)
+	{
+		return (mmap_get_frames(a, frames, max));
+	}
+#endif
+
+	if (adev[a].g_audio_in_type == AUDIO_IN_TYPE_SHM && adev[a].inbuf_next >= adev[a].inbuf_len)
+	{
+		return (shm_get_frames(a, frames, max));
+	}
+
+	if (adev[a].g_audio_in_type == AUDIO_IN_TYPE_FILE && adev[a].inbuf_next >= adev[a].inbuf_len)
+	{
+		return (file_get_frames(a, frames, max));
+	}
+
+	if (adev[a].inbuf_next >= adev[a].inbuf_len)
+	{
+		if (audio_fill(a) < 0)
+		{
+			return (-1);
+		}
+	}
+
+	n = (adev[a].inbuf_len - adev[a].inbuf_next) / bpf;
+	if (n > max)
+	{
+		n = max;
+	}
+
+	if (n > 0)
+	{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		if (in_is_s16(a) && (adev[a].inbuf_next & 1) == 0)
+		{
+			*frames = (const int16_t *)(adev[a].inbuf_ptr + adev[a].inbuf_next);
+			adev[a].inbuf_taken = n * bpf;
+			return (n);
+		}
+#endif
+		out = conv_buf(a, n);
+		convert_in(a, adev[a].inbuf_ptr + adev[a].inbuf_next, out, n * nchan);
+		adev[a].inbuf_taken = n * bpf;
+		*frames = out;
+		return (n);
+	}
+
+	/* Only part of a frame is left, from stdin or UDP. */
+	/* Put one together a byte at a time. */
+
+	unsigned char one[2 * 4];
+
+	for (int i = 0; i < bpf; i++)
+	{
+		int x = audio_get(a);
+
+		if (x < 0)
+		{
+			return (-1);
+		}
+		one[i] = x;
+	}
+
+	out = conv_buf(a, 1);
+	convert_in(a, one, out, nchan);
+	*frames = out;
+	return (1);
+
+} /* end audio_get_frames */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_release_frames
+ *
+ * Purpose:     Done with frames from audio_get_frames.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *
+ *		n	- Number of frames used.  Normally all of them.
+ *
+ *----------------------------------------------------------------*/
+
+void audio_release_frames(int a, int n)
+{
+#if USE_ALSA
+	if (adev[a].mmap_frames > 0)
+	{
+		snd_pcm_sframes_t k;
+
+		assert(n <= adev[a].mmap_frames);
+
+		k = snd_pcm_mmap_commit(adev[a].audio_in_handle, adev[a].mmap_offset, n);
+		adev[a].mmap_frames = 0;
+		if (k < 0 || k != n)
+		{
+			alsa_in_recover(a, k < 0 ? (int)k : -EPIPE);
+		}
+		return;
+	}
+#endif
+
+	if (adev[a].file_taken > 0)
+	{
+		int bpf = save_audio_config_p->adev[a].num_channels * in_sample_size(a);
+
+		assert(n * bpf <= adev[a].file_taken);
+
+		adev[a].file_pos += n * bpf;
+		adev[a].file_taken = 0;
+		return;
+	}
+
+	if (adev[a].shm_taken > 0)
+	{
+		int bpf = save_audio_config_p->adev[a].num_channels * in_sample_size(a);
+
+		assert(n * bpf <= adev[a].shm_taken);
+
+		// The writer doesn't wait for us.  Did it overwrite what we were using?
+
+		if (__atomic_load_n(&adev[a].shm->head, __ATOMIC_ACQUIRE) - adev[a].shm_pos > adev[a].shm->data_size)
+		{
+			adev[a].xruns_in++;
+			audio_stats_xrun(a);
+		}
+		adev[a].shm_pos += n * bpf;
+		adev[a].shm_taken = 0;
+		return;
+	}
+
+	if (adev[a].inbuf_taken > 0)
+	{
+		int bpf = save_audio_config_p->adev[a].num_channels * in_sample_size(a);
+
+		assert(n * bpf <= adev[a].inbuf_taken);
+
+		adev[a].inbuf_next += n * bpf;
+		adev[a].inbuf_taken = 0;
+	}
+
+} /* end audio_release_frames */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_get_block
+ *
+ * Purpose:     Get a block of audio, separated by channel.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *
+ *		max_frames - Most frames wanted.
+ *
+ * Outputs:	dst	- 16 bit signed samples.  The first channel is
+ *			  dst[0] .. dst[max_frames-1].  For stereo, the
+ *			  second starts at dst[max_frames].
+ *
+ * Returns:     Number of frames, at least 1.
+ *              -1 for any type of error or end of file.
+ *
+ * Description:	Version 1.8: For the receive thread, which passes a
+ *		block for each channel to the demodulators.
+ *
+ *----------------------------------------------------------------*/
+
+int audio_get_block(int a, int16_t *dst, int max_frames)
+{
+	int nchan = save_audio_config_p->adev[a].num_channels;
+	const int16_t *frames;
+	int n;
+
+	n = audio_get_frames(a, &frames, max_frames);
+	if (n <= 0)
+	{
+		return (-1);
+	}
+
+	if (nchan == 1)
+	{
+		memcpy(dst, frames, n * sizeof(int16_t));
+	}
+	else
+	{
+		for (int k = 0; k < n; k++)
+		{
+			dst[k] = frames[2 * k];
+			dst[max_frames + k] = frames[2 * k + 1];
+		}
+	}
+
+	audio_release_frames(a, n);
+	return (n);
+
+} /* end audio_get_block */
+
+#if USE_ALSA
+
+/*------------------------------------------------------------------
+ *
+ * Name:        mmap_get_frames
+ *
+ * Purpose:     audio_get_frames for ALSA with mmap access.
+ *
+ * Description:	Wait for at least one frame, start the device the
+ *		first time or after an overrun, and give out a pointer
+ *		to the samples in the mmap area.  This might be fewer
+ *		than available when the area wraps around the end.
+ *
+ *----------------------------------------------------------------*/
+
+static int mmap_get_frames(int a, const int16_t **frames, int max)
+{
+	snd_pcm_t *handle = adev[a].audio_in_handle;
+	int nchan = save_audio_config_p->adev[a].num_channels;
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, n;
+	snd_pcm_sframes_t avail;
+	const unsigned char *p;
+	int err;
+	int retries = 0;
+
+	assert(adev[a].mmap_frames == 0);
+
+	alsa_in_adapt(a, 0);
+
+	while (1)
+	{
+		if (snd_pcm_state(handle) == SND_PCM_STATE_PREPARED)
+		{
+			snd_pcm_start(handle);
+		}
+
+		avail = snd_pcm_avail_update(handle);
+		if (avail == 0)
+		{
+			int64_t t0 = adev[a].adapt_start ? audio_stats_clock() : 0;
+
+			err = snd_pcm_wait(handle, 1000);
+			if (t0)
+			{
+				adev[a].adapt_wait += audio_stats_clock() - t0;
+			}
+			if (err < 0)
+			{
+				avail = err;
+			}
+			else
+			{
+				continue;
+			}
+		}
 
-		while (adev[a].inbuf_next >= adev[a].inbuf_len)
+		if (avail > 0)
 		{
-
-			assert(adev[a].sndio_in_handle != NULL);
-			if (poll_sndio(adev[a].sndio_in_handle, POLLIN) < 0)
+			n = avail < max ? avail : max;
+			err = snd_pcm_mmap_begin(handle, &areas, &offset, &n);
+			if (err >= 0 && n > 0)
 			{
-				adev[a].inbuf_len = 0;
-				adev[a].inbuf_next = 0;
-				return (-1);
+				break;
 			}
+			avail = err < 0 ? err : -EPIPE;
+		}
 
-			n = sio_read(adev[a].sndio_in_handle, adev[a].inbuf_ptr, adev[a].inbuf_size_in_bytes);
-			adev[a].inbuf_len = n;
-			adev[a].inbuf_next = 0;
+		/* Try to recover a few times and eventually give up. */
 
-			audio_stats(a,
-						save_audio_config_p->adev[a].num_channels,
-						n / (save_audio_config_p->adev[a].num_channels * save_audio_config_p->adev[a].bits_per_sample / 8),
-						save_audio_config_p->statistics_interval);
+		if (++retries > 10 || alsa_in_recover(a, avail) < 0)
+		{
+			return (-1);
 		}
+	}
 
-#else /* begin OSS */
+	/* For interleaved, every channel area has the same start and step. */
 
-		/* Fixed in 1.2.  This was formerly outside of the switch */
-		/* so the OSS version did not process stdin or UDP. */
+	p = (const unsigned char *)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
 
-		while (adev[a].g_audio_in_type == AUDIO_IN_TYPE_SOUNDCARD && adev[a].inbuf_next >= adev[a].inbuf_len)
-		{
-			assert(adev[a].oss_audio_device_fd > 0);
-			n = read(adev[a].oss_audio_device_fd, adev[a].inbuf_ptr, adev[a].inbuf_size_in_bytes);
-			//
-			// printf ("audio_get(): read %d returns %d\n", adev[a].inbuf_size_in_bytes, n);
-			if (n < 0)
-			{
+	adev[a].mmap_offset = offset;
+	adev[a].mmap_frames = n;
 
-				perror("Can't read from audio device");
-				adev[a].inbuf_len = 0;
-				adev[a].inbuf_next = 0;
+	audio_stats(a, nchan, n, save_audio_config_p->statistics_interval);
 
-				audio_stats(a,
-							save_audio_config_p->adev[a].num_channels,
-							0,
-							save_audio_config_p->statistics_interval);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if (in_is_s16(a))
+	{
+		*frames = (const int16_t *)p;
+		return (n);
+	}
+#endif
 
-				return (-1);
-			}
-			adev[a].inbuf_len = n;
-			adev[a].inbuf_next = 0;
+	int16_t *out = conv_buf(a, n);
 
-			audio_stats(a,
-						save_audio_config_p->adev[a].num_channels,
-						n / (save_audio_config_p->adev[a].num_channels * save_audio_config_p->adev[a].bits_per_sample / 8),
-						save_audio_config_p->statistics_interval);
-		}
+	convert_in(a, p, out, n * nchan);
+	*frames = out;
+	return (n);
 
-#endif /* USE_ALSA */
+} /* end mmap_get_frames */
 
-		break;
+/*------------------------------------------------------------------
+ *
+ * Name:        alsa_in_recover
+ *
+ * Purpose:     Recover from an input error with mmap access.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *
+ *		err	- Negative error code from ALSA.
+ *
+ * Returns:	0 if the device is ready to try again, -1 if not.
+ *
+ * Description:	An overrun is counted but not explained at length each
+ *		time like it is for read.  The counts are available from
+ *		audio_xrun_stats.
+ *
+ *----------------------------------------------------------------*/
 
-		/*
-		 * UDP.
-		 */
+static int alsa_in_recover(int a, int err)
+{
+	if (err == -EPIPE)
+	{
+		adev[a].xruns_in++;
+		audio_stats_xrun(a);
+		printf("Audio input device %d overrun.  %d so far.\n", a, adev[a].xruns_in);
+		alsa_in_adapt(a, 1);
+	}
+	else
+	{
+		printf("Audio input device %d error code %d: %s\n", a, err, snd_strerror(err));
+		SLEEP_MS(250);
+	}
 
-	case AUDIO_IN_TYPE_SDR_UDP:
+	audio_stats(a, save_audio_config_p->adev[a].num_channels, 0, save_audio_config_p->statistics_interval);
 
-		while (adev[a].inbuf_next >= adev[a].inbuf_len)
-		{
-			int res;
+	err = snd_pcm_recover(adev[a].audio_in_handle, err, 1);
+	if (err < 0)
+	{
+		printf("Audio input device %d could not recover: %s\n", a, snd_strerror(err));
+		return (-1);
+	}
+	return (0);
+}
 
-			assert(adev[a].udp_sock > 0);
-			res = recv(adev[a].udp_sock, adev[a].inbuf_ptr, adev[a].inbuf_size_in_bytes, 0);
-			if (res < 0)
-			{
+/*------------------------------------------------------------------
+ *
+ * Name:        alsa_in_adapt
+ *
+ * Purpose:     Change the input period for APERIOD AUTO.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *
+ *		xrun	- 1 right after an overrun.
+ *			  0 before waiting for more input.
+ *
+ * Description:	The device must be set up again to change the period.
+ *		After an overrun the audio is already lost so that costs
+ *		nothing extra.  Going to a shorter period loses a few
+ *		milliseconds of audio so we don't try it very often.
+ *
+ *		Nothing can be taken with audio_get_frames at the time.
+ *
+ *----------------------------------------------------------------*/
 
-				printf("Can't read from udp socket, res=%d", res);
-				adev[a].inbuf_len = 0;
-				adev[a].inbuf_next = 0;
+static void alsa_in_adapt(int a, int xrun)
+{
+	struct audio_s *pa = save_audio_config_p;
+	int level = adev[a].adapt_level;
+	int64_t now;
 
-				audio_stats(a,
-							save_audio_config_p->adev[a].num_channels,
-							0,
-							save_audio_config_p->statistics_interval);
+	if (adev[a].adapt_start == 0)
+	{
+		return; /* Not APERIOD AUTO. */
+	}
 
-				return (-1);
-			}
+	now = audio_stats_clock();
 
-			adev[a].inbuf_len = res;
-			adev[a].inbuf_next = 0;
+	if (xrun)
+	{
+		int rate = pa->adev[a].in_samples_per_sec ? pa->adev[a].in_samples_per_sec : pa->adev[a].samples_per_sec;
 
-			audio_stats(a,
-						save_audio_config_p->adev[a].num_channels,
-						res / (save_audio_config_p->adev[a].num_channels * save_audio_config_p->adev[a].bits_per_sample / 8),
-						save_audio_config_p->statistics_interval);
+		if (adev[a].adapt_fails < ADAPT_MAX_FAILS)
+		{
+			adev[a].adapt_fails++;
 		}
-		break;
 
-		/*
-		 * stdin.
-		 */
-	case AUDIO_IN_TYPE_STDIN:
+		// set_alsa_params doesn't like more than 32k.
 
-		while (adev[a].inbuf_next >= adev[a].inbuf_len)
+		if (level + 1 < ADAPT_LEVELS &&
+			(int64_t)rate * adev[a].in_bytes_per_frame * adapt_period_ms[level + 1] / 1000 <= 32768)
 		{
-			// int ch, res,i;
-			int res;
+			level++;
+		}
+	}
+	else
+	{
+		int64_t elapsed = now - adev[a].adapt_start;
 
-			res = read(STDIN_FILENO, adev[a].inbuf_ptr, (size_t)adev[a].inbuf_size_in_bytes);
-			if (res <= 0)
-			{
+		if (elapsed < ((int64_t)ADAPT_SHRINK_SEC * 1000000) << adev[a].adapt_fails)
+		{
+			return;
+		}
 
-				printf("\nEnd of file on stdin.  Exiting.\n");
-				exit(0);
-			}
+		if (level > 0 && adev[a].xruns_in == adev[a].adapt_xruns && adev[a].adapt_wait * 2 >= elapsed)
+		{
+			level--;
+		}
+	}
 
-			audio_stats(a,
-						save_audio_config_p->adev[a].num_channels,
-						res / (save_audio_config_p->adev[a].num_channels * save_audio_config_p->adev[a].bits_per_sample / 8),
-						save_audio_config_p->statistics_interval);
+	adev[a].adapt_start = now;
+	adev[a].adapt_wait = 0;
+	adev[a].adapt_xruns = adev[a].xruns_in;
 
-			adev[a].inbuf_len = res;
-			adev[a].inbuf_next = 0;
-		}
+	if (level == adev[a].adapt_level)
+	{
+		return;
+	}
 
-		break;
+	adev[a].adapt_level = level;
+
+	snd_pcm_drop(adev[a].audio_in_handle);
+
+	int n = set_alsa_params(a, adev[a].audio_in_handle, pa, pa->adev[a].adevice_in, "input");
+	if (n <= 0)
+	{
+		printf("Audio input device %d could not change period to %d mS.\n", a, adapt_period_ms[level]);
+		return;
 	}
 
-	if (adev[a].inbuf_next < adev[a].inbuf_len)
-		n = adev[a].inbuf_ptr[adev[a].inbuf_next++];
-	// No data to read, avoid reading outside buffer
-	else
-		n = 0;
+	if (n > adev[a].inbuf_size_in_bytes)
+	{
+		adev[a].inbuf_ptr = realloc(adev[a].inbuf_ptr, n);
+		if (adev[a].inbuf_ptr == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	adev[a].inbuf_size_in_bytes = n;
+	adev[a].inbuf_len = 0;
+	adev[a].inbuf_next = 0;
 
-#if DEBUG
+	printf("Audio input device %d period is now %d mS.\n", a, adapt_period_ms[level]);
 
-	printf("audio_get(): returns %d\n", n);
+} /* end alsa_in_adapt */
 
-#endif
+#endif /* USE_ALSA */
 
-	return (n);
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_xrun_stats
+ *
+ * Purpose:     Number of overruns and underruns for an audio device.
+ *
+ * Inputs:	a	- Our number for audio device.
+ *
+ * Outputs:	in	- Input overruns, i.e. we didn't keep up.
+ *
+ *		out	- Output underruns, i.e. we didn't supply audio fast enough.
+ *
+ * Description:	Only ALSA reports these.  Others are always 0.
+ *
+ *----------------------------------------------------------------*/
 
-} /* end audio_get */
+void audio_xrun_stats(int a, int *in, int *out)
+{
+	assert(a >= 0 && a < MAX_ADEVS);
+
+	*in = adev[a].xruns_in;
+	*out = adev[a].xruns_out;
+}
 
 /*------------------------------------------------------------------
  *
@@ -1337,6 +2991,126 @@ int audio_put(int a, int c)
 
 } /* end audio_put */
 
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_put_bytes
+ *
+ * Purpose:     Send a block of bytes to the audio device.
+ *
+ * Inputs:	a
+ *
+ *		buf, len	- Same as calling audio_put for each byte.
+ *
+ * Returns:     Normally non-negative.
+ *              -1 for any type of error.
+ *
+ * Description:	Version 1.8: For tone generation from precomputed waveforms.
+ *		Copy into the output buffer rather than a byte at a time.
+ *
+ *----------------------------------------------------------------*/
+
+int audio_put_bytes(int a, const unsigned char *buf, int len)
+{
+	while (len > 0)
+	{
+		int n = adev[a].outbuf_size_in_bytes - adev[a].outbuf_len;
+		if (n > len)
+		{
+			n = len;
+		}
+
+		memcpy(adev[a].outbuf_ptr + adev[a].outbuf_len, buf, n);
+		adev[a].outbuf_len += n;
+		buf += n;
+		len -= n;
+
+		if (adev[a].outbuf_len == adev[a].outbuf_size_in_bytes)
+		{
+			if (audio_flush(a) < 0)
+			{
+				return (-1);
+			}
+		}
+	}
+
+	return (0);
+
+} /* end audio_put_bytes */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_put_block
+ *
+ * Purpose:     Send audio samples to the device.
+ *
+ * Inputs:	a
+ *
+ *		frames	- 16 bit signed samples.  For stereo, left and right
+ *			  alternate, starting with left.
+ *
+ *		n	- Number of frames, i.e. sample times.
+ *
+ * Returns:     Normally non-negative.
+ *              -1 for any type of error.
+ *
+ * Description:	Version 1.8: The tone generator uses this rather than
+ *		audio_put for each byte.  Conversion to 8 bit, if needed,
+ *		is done here.
+ *
+ *----------------------------------------------------------------*/
+
+int audio_put_block(int a, const int16_t *frames, int n)
+{
+	int nsam = n * save_audio_config_p->adev[a].num_channels;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if (save_audio_config_p->adev[a].bits_per_sample == 16)
+	{
+		/* Already in the device format. */
+		return (audio_put_bytes(a, (const unsigned char *)frames, nsam * 2));
+	}
+#endif
+
+	int bytes_per_sample = save_audio_config_p->adev[a].bits_per_sample / 8;
+	int i = 0;
+
+	while (i < nsam)
+	{
+		unsigned char *p = adev[a].outbuf_ptr + adev[a].outbuf_len;
+		int room = (adev[a].outbuf_size_in_bytes - adev[a].outbuf_len) / bytes_per_sample;
+		int end = i + room < nsam ? i + room : nsam;
+
+		adev[a].outbuf_len += (end - i) * bytes_per_sample;
+
+		if (bytes_per_sample == 1)
+		{
+			for (; i < end; i++)
+			{
+				*p++ = ((frames[i] + 32768) >> 8) & 0xff;
+			}
+		}
+		else
+		{
+			for (; i < end; i++)
+			{
+				*p++ = frames[i] & 0xff;
+				*p++ = (frames[i] >> 8) & 0xff;
+			}
+		}
+
+		if (adev[a].outbuf_len == adev[a].outbuf_size_in_bytes)
+		{
+			if (audio_flush(a) < 0)
+			{
+				return (-1);
+			}
+		}
+	}
+
+	return (0);
+
+} /* end audio_put_block */
+
 /*------------------------------------------------------------------
  *
  * Name:        audio_flush
@@ -1353,6 +3127,12 @@ int audio_put(int a, int c)
 
 int audio_flush(int a)
 {
+	if (adev[a].out_null)
+	{
+		adev[a].outbuf_len = 0;
+		return (0);
+	}
+
 #if USE_ALSA
 	int k;
 	unsigned char *psound;
@@ -1410,6 +3190,7 @@ int audio_flush(int a)
 		{
 
 			printf("Audio output data underrun.\n");
+			adev[a].xruns_out++;
 
 			/* No problemo.  Recover and go around again. */
 
@@ -1458,6 +3239,7 @@ int audio_flush(int a)
 		{
 			/* Success! */
 			adev[a].outbuf_len = 0;
+			audio_stats_write(a);
 			return (0);
 		}
 	}
@@ -1498,6 +3280,7 @@ int audio_flush(int a)
 	}
 
 	adev[a].outbuf_len = 0;
+	audio_stats_write(a);
 	return (0);
 
 #else /* OSS */
@@ -1535,6 +3318,7 @@ int audio_flush(int a)
 	}
 
 	adev[a].outbuf_len = 0;
+	audio_stats_write(a);
 	return (0);
 #endif
 
@@ -1581,6 +3365,11 @@ void audio_wait(int a)
 
 	audio_flush(a);
 
+	if (adev[a].out_null)
+	{
+		return;
+	}
+
 #if USE_ALSA
 
 	/* For playback, this should wait for all pending frames */
@@ -1690,6 +3479,10 @@ int audio_close(void)
 			adev[a].inbuf_len = 0;
 			adev[a].inbuf_next = 0;
 
+			free(adev[a].in_conv);
+			adev[a].in_conv = NULL;
+			adev[a].in_conv_size = 0;
+
 			adev[a].outbuf_size_in_bytes = 0;
 			adev[a].outbuf_ptr = NULL;
 			adev[a].outbuf_len = 0;
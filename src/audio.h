@@ -15,6 +15,8 @@
 #include <hamlib/rig.h>
 #endif
 
+#include <stdint.h>
+
 #include "direwolf.h" /* for MAX_CHANS used throughout the application. */
 #include "ax25_pad.h" /* for AX25_MAX_ADDR_LEN */
 #include "version.h"
@@ -30,8 +32,9 @@ enum ptt_method_e
 	PTT_METHOD_GPIO,   /* General purpose I/O, Linux only. */
 	PTT_METHOD_LPT,	   /* Parallel printer port, Linux only. */
 	PTT_METHOD_HAMLIB, /* HAMLib, Linux only. */
-	PTT_METHOD_CM108
-}; /* GPIO pin of CM108/CM119/etc.  Linux only. */
+	PTT_METHOD_CM108,  /* GPIO pin of CM108/CM119/etc.  Linux only. */
+	PTT_METHOD_GPIOD   /* GPIO character device, Linux only. */
+};
 
 typedef enum ptt_method_e ptt_method_t;
 
@@ -47,7 +50,32 @@ enum audio_in_type_e
 {
 	AUDIO_IN_TYPE_SOUNDCARD,
 	AUDIO_IN_TYPE_SDR_UDP,
-	AUDIO_IN_TYPE_STDIN
+	AUDIO_IN_TYPE_STDIN,
+	AUDIO_IN_TYPE_SHM, /* Version 1.8: Ring buffer in shared memory.  See audioshm.h. */
+	AUDIO_IN_TYPE_FILE, /* Version 1.8: Recorded WAV or raw file, as fast as possible. */
+	AUDIO_IN_TYPE_SDR	/* Version 1.8: Narrow channels from a wideband SDR.  See sdr.c. */
+};
+
+/* Version 1.8: Wider audio input formats, all little endian. */
+/* These are converted to 16 bits for the demodulators. */
+
+enum audio_in_format_e
+{
+	AUDIO_IN_FORMAT_DEFAULT = 0, /* Same as bits_per_sample, 8 or 16. */
+	AUDIO_IN_FORMAT_S24,		 /* Signed 24 bits in 3 bytes. */
+	AUDIO_IN_FORMAT_S32,		 /* Signed 32 bits. */
+	AUDIO_IN_FORMAT_FLOAT,		 /* 32 bit float, -1.0 to +1.0. */
+	AUDIO_IN_FORMAT_U8,			 /* Unsigned 8 bits, regardless of bits_per_sample. */
+	AUDIO_IN_FORMAT_S16			 /* Signed 16 bits, regardless of bits_per_sample. */
+};
+
+/* Version 1.8: I/Q sample formats for the SDR channelizer. */
+
+enum sdr_format_e
+{
+	SDR_FORMAT_CU8 = 0, /* Unsigned 8 bits, I then Q.  From rtl_sdr. */
+	SDR_FORMAT_CS16,	/* Signed 16 bits, little endian. */
+	SDR_FORMAT_CF32		/* 32 bit float, -1.0 to +1.0. */
 };
 
 /* For option to try fixing frames with bad CRC. */
@@ -78,6 +106,23 @@ typedef enum sanity_e
 	SANITY_NONE
 } sanity_t;
 
+// Version 1.8: Threads that can have their own priority and CPUs.
+
+enum thread_role_e
+{
+	THREAD_AUDIO = 0, // Audio capture, one for each device.
+	THREAD_DEMOD,	  // Demodulator workers for DEMODTHREADS.
+	THREAD_XMIT,	  // Transmit, one for each channel.
+	THREAD_ROLES
+};
+
+#define THREAD_SCHED_DEFAULT 0
+#define THREAD_SCHED_OTHER 1
+#define THREAD_SCHED_FIFO 2
+#define THREAD_SCHED_RR 3
+
+#define MAX_THREAD_CPUS 64 /* Bits in thread_sched cpus. */
+
 struct audio_s
 {
 
@@ -102,6 +147,19 @@ struct audio_s
 		int samples_per_sec; /* Audio sampling rate.  Typically 11025, 22050, or 44100. */
 		int bits_per_sample; /* 8 (unsigned char) or 16 (signed short). */
 
+		int period_ms; /* ALSA period, for both directions.  0 for the usual. */
+					   /* APERIOD_AUTO to adjust input as we go. */
+
+		int mmap_in; /* Use ALSA mmap access for input, rather than read. */
+
+		int udp_rcvbuf; /* Socket receive buffer size for UDP audio.  0 for system default. */
+
+		enum audio_in_format_e in_format; /* Input only.  Output is still bits_per_sample. */
+
+		int in_samples_per_sec; /* Input rate when different than samples_per_sec. */
+		/* Resampled to samples_per_sec before the demodulators. */
+		/* 0 means same. */
+
 	} adev[MAX_ADEVS];
 
 	/* Common to all channels. */
@@ -122,6 +180,88 @@ struct audio_s
 	float recv_ber; /* Receive Bit Error Rate (BER). */
 	/* Probability of inverting a bit coming out of the modem. */
 
+	int demod_threads; /* Demodulator worker threads for each radio channel. */
+	/* 0 runs everything in the audio capture thread, as before. */
+	/* 1 gives each channel its own thread, fed through a ring buffer. */
+	/* More splits the channel's demodulators into that many groups. */
+
+	int recv_threads; /* Version 1.8: RECVTHREADS.  Received frames from each */
+	/* audio device are processed by a thread of its own rather */
+	/* than all of them by the main thread. */
+
+	int fix_threads; /* Background threads for FIX_BITS attempts. */
+	/* 0 does them right away, holding up the audio. */
+
+#define MAX_FIX_THREADS 8
+
+	/* Version 1.8: Scheduling for threads that must keep up with the audio. */
+	/* See dwthread.c. */
+
+	struct thread_sched_s
+	{
+		int policy;	  /* THREAD_SCHED_DEFAULT leaves it alone. */
+		int priority; /* 1 - 99 for FIFO and RR. */
+		uint64_t cpus; /* Bit for each CPU it can run on.  0 for any. */
+	} thread_sched[THREAD_ROLES];
+
+	int mlockall; /* Lock all memory so we never wait for paging. */
+
+	int lock_stats; /* Version 1.8: Count waiting for each lock.  See dwthread.c. */
+
+	int rx_latency; /* Version 1.8: Time received frames through each stage.  See rxlat.c. */
+
+	int cpu_budget; /* Version 1.8: Percent of a CPU for each demodulator thread. */
+	/* Demodulators are cut back at startup to fit.  0 for no limit. */
+	/* See autotune.c. */
+
+	/* Version 1.8: One wideband I/Q stream split into narrow FM channels. */
+	/* Each feeds its own radio channel.  See sdr.c. */
+
+	struct sdr_s
+	{
+		char input[80];			/* "stdin", a file or pipe name, or "file:" */
+								/* followed by a recording.  Empty if not used. */
+		int rate;				/* I/Q sample pairs per second. */
+		int64_t center_hz;		/* Frequency at the middle of the stream. */
+		enum sdr_format_e format;
+		int64_t chan_hz[MAX_CHANS]; /* Frequency for each radio channel. */
+									/* 0 if not from the SDR. */
+	} sdr;
+
+	/* Version 1.8: Limits on queued frames.  0 means no limit. */
+
+	int rxq_max_frames; /* Received frames waiting for the application. */
+	int rxq_max_bytes;
+	int rxq_drop; /* QDROP_NEWEST or QDROP_OLDEST when full. */
+
+	int rx_dedupe_sec;	/* Version 1.8: Drop received frames already heard on another */
+	int rx_dedupe_size; /* channel within this many seconds.  0 for off.  Most frames */
+						/* remembered.  See rxdedupe.c. */
+
+	int rx_raw; /* Version 1.8: RXRAW.  Received frames only go to the KISS */
+	/* clients.  No monitoring display so the addresses are */
+	/* never taken apart unless RXDEDUPE needs them. */
+
+	int txq_max_frames; /* Each transmit queue, for frames from client applications. */
+	int txq_max_bytes;
+	int txq_drop; /* QDROP_NEWEST, QDROP_OLDEST, or QDROP_REJECT when full. */
+
+#define QDROP_NEWEST 0 /* Discard what is being added. */
+#define QDROP_OLDEST 1 /* Discard the oldest waiting to make room. */
+#define QDROP_REJECT 2 /* Like QDROP_NEWEST but tell the client application. */
+
+#define DEFAULT_RXQ_MAX_FRAMES 1000
+
+#define DEFAULT_RX_GATE_MS 500
+#define MAX_RX_GATE_MS 10000
+
+#define DEFAULT_RX_PRUNE_FRAMES 50
+#define DEFAULT_RX_PRUNE_PROBE 10
+
+#define DEFAULT_RX_DEDUPE_SIZE 1024
+#define MAX_RX_DEDUPE_SEC 60
+#define DEFAULT_TXQ_MAX_FRAMES 1000
+
 	// Properties for all channels.
 
 	enum medium_e chan_medium[MAX_TOTAL_CHANS];
@@ -175,6 +315,9 @@ struct audio_s
 						   // 16, 23, 64 for specific number of parity symbols.
 						   // 1 for automatic selection based on frame size.
 
+		int fx25_rec; // Listen for FX.25.  Default on.
+					  // Off skips looking for the correlation tag on every bit.
+
 		int decimate; /* Reduce AFSK sample rate by this factor to */
 		/* decrease computational requirements. */
 
@@ -216,6 +359,22 @@ struct audio_s
 
 		int passall; /* Allow thru even with bad CRC. */
 
+		int fix_max_us; /* Give up fixing a frame after this many */
+		/* microseconds.  0 for no limit. */
+
+		int fix_max_percent; /* Fix up time allowed for the channel, as a */
+		/* percentage of real time.  0 for no limit. */
+		/* When used up, only single bits are tried. */
+
+		int rx_gate_ms; /* Version 1.8: Skip demodulating while the channel is quiet */
+		/* and for this long after.  0 to always demodulate. */
+		/* See rxgate.c. */
+
+		int rx_prune_frames; /* Version 1.8: Turn off demodulators and slicers which */
+		/* got no frames of their own in this many.  0 to always run all. */
+		int rx_prune_probe; /* Turn everything back on for a while after this */
+		/* many rounds, to see if conditions changed.  See multi_modem.c. */
+
 		/* Additional properties for transmit. */
 
 		/* Originally we had control outputs only for PTT. */
@@ -330,6 +489,12 @@ struct audio_s
 
 		int fulldup; /* Full Duplex. */
 
+		int prerender; /* Generate all audio for a transmission */
+		/* before turning on the transmitter. */
+
+		int pipeline; /* Generate audio for the next frame while */
+		/* another thread sends the previous one to the device. */
+
 	} achan[MAX_CHANS];
 
 #ifdef USE_HAMLIB
@@ -362,6 +527,10 @@ struct audio_s
 
 #define SDR_UDP_BUF_MAXLEN 2000
 
+// Version 1.8: Where available, take up to this many datagrams with one system call.
+
+#define SDR_UDP_BATCH 16
+
 #define DEFAULT_NUM_CHANNELS 1
 #define DEFAULT_SAMPLES_PER_SEC 44100 /* Very early observations.  Might no longer be valid. */
 									  /* 22050 works a lot better than 11025. */
@@ -375,8 +544,12 @@ struct audio_s
 								   /* The "soundcard" in my desktop PC can do 96kHz or even 192kHz. */
 								   /* We will probably need to increase the sample rate to go much above 9600 baud. */
 
+#define MAX_IN_SAMPLES_PER_SEC 3072000 /* Version 1.8: Input resampled to the above.  SDR programs go higher. */
+
 #define DEFAULT_BITS_PER_SAMPLE 16
 
+#define APERIOD_AUTO (-1) /* Version 1.8: ALSA input period picked from overruns as we go. */
+
 #define DEFAULT_FIX_BITS RETRY_NONE // Interesting research project but even a single bit fix up
 									// will occasionally let corrupted packets through.
 
@@ -422,8 +595,20 @@ int audio_open(struct audio_s *pa);
 
 int audio_get(int a); /* a = audio device, 0 for first */
 
+int audio_get_frames(int a, const int16_t **frames, int max);
+
+void audio_release_frames(int a, int n);
+
+int audio_get_block(int a, int16_t *dst, int max_frames);
+
+void audio_xrun_stats(int a, int *in, int *out);
+
 int audio_put(int a, int c);
 
+int audio_put_bytes(int a, const unsigned char *buf, int len);
+
+int audio_put_block(int a, const int16_t *frames, int n);
+
 int audio_flush(int a);
 
 void audio_wait(int a);
@@ -46,6 +46,12 @@
  *
  * Revisions: 	This is new in version 1.3.
  *
+ *		Version 1.8: Also keep the time of audio output writes
+ *		for transmit latency measurements.
+ *
+ *		Version 1.8: Report input overruns and the ALSA input
+ *		period and buffer sizes, which can change with APERIOD AUTO.
+ *
  *---------------------------------------------------------------*/
 
 #include "direwolf.h"
@@ -58,6 +64,7 @@
 #include <sys/stat.h>
 #include <assert.h>
 #include <time.h>
+#include <stdint.h>
 
 #include "audio_stats.h"
 #include "demod.h" /* for alevel_t & demod_get_audio_level() */
@@ -84,6 +91,12 @@
  *
  *----------------------------------------------------------------*/
 
+static int udp_lost[MAX_ADEVS];
+static int xruns[MAX_ADEVS];
+static int buf_rate[MAX_ADEVS]; /* 0 if sizes not known. */
+static int buf_period[MAX_ADEVS];
+static int buf_size[MAX_ADEVS];
+
 void audio_stats(int adev, int nchan, int nsamp, int interval)
 {
 
@@ -94,6 +107,7 @@ void audio_stats(int adev, int nchan, int nsamp, int interval)
 	static int sample_count[MAX_ADEVS];
 	static int error_count[MAX_ADEVS];
 	static int suppress_first[MAX_ADEVS];
+	int lost;
 
 	if (interval <= 0)
 	{
@@ -150,6 +164,25 @@ void audio_stats(int adev, int nchan, int nsamp, int interval)
 			{
 				float ave_rate = (sample_count[adev] / 1000.0) / interval;
 
+				lost = udp_lost[adev];
+				udp_lost[adev] = 0;
+				if (lost > 0)
+				{
+					printf("\nADEVICE%d: %d UDP audio datagrams lost.\n", adev, lost);
+				}
+
+				if (buf_rate[adev] > 0)
+				{
+					printf("\nADEVICE%d: Input period %d frames (%.1f mS), buffer %d frames (%.1f mS), %d overruns.\n",
+						   adev, buf_period[adev], buf_period[adev] * 1000.0 / buf_rate[adev],
+						   buf_size[adev], buf_size[adev] * 1000.0 / buf_rate[adev], xruns[adev]);
+				}
+				else if (xruns[adev] > 0)
+				{
+					printf("\nADEVICE%d: %d input overruns.\n", adev, xruns[adev]);
+				}
+				xruns[adev] = 0;
+
 				if (nchan > 1)
 				{
 					int ch0 = ADEVFIRSTCHAN(adev);
@@ -175,4 +208,158 @@ void audio_stats(int adev, int nchan, int nsamp, int interval)
 		}
 	}
 
-} /* end audio_stats.c */
+} /* end audio_stats */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_stats_udp_lost
+ *
+ * Purpose:     Count UDP audio datagrams lost before we could read them.
+ *
+ * Inputs:	adev	- Audio device number.
+ *
+ *		n	- Number lost since the last call.
+ *
+ * Description:	Version 1.8.  Included in the next periodic report.
+ *		Called from the same thread as audio_stats.
+ *
+ *----------------------------------------------------------------*/
+
+void audio_stats_udp_lost(int adev, int n)
+{
+	assert(adev >= 0 && adev < MAX_ADEVS);
+
+	udp_lost[adev] += n;
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_stats_xrun
+ *
+ * Purpose:     Count an input overrun, i.e. audio lost because we
+ *		didn't keep up.
+ *
+ * Inputs:	adev	- Audio device number.
+ *
+ * Description:	Version 1.8.  Included in the next periodic report.
+ *		Called from the same thread as audio_stats.
+ *
+ *----------------------------------------------------------------*/
+
+void audio_stats_xrun(int adev)
+{
+	assert(adev >= 0 && adev < MAX_ADEVS);
+
+	xruns[adev]++;
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_stats_buffer
+ *
+ * Purpose:     Note the current input period and buffer sizes.
+ *
+ * Inputs:	adev	- Audio device number.
+ *
+ *		rate	- Input samples per second.
+ *
+ *		period	- Frames per period.
+ *
+ *		size	- Frames in the buffer.
+ *
+ * Description:	Version 1.8.  For ALSA, when the device is set up.
+ *		With APERIOD AUTO, also each time they are changed.
+ *
+ *----------------------------------------------------------------*/
+
+void audio_stats_buffer(int adev, int rate, int period, int size)
+{
+	assert(adev >= 0 && adev < MAX_ADEVS);
+
+	buf_period[adev] = period;
+	buf_size[adev] = size;
+	buf_rate[adev] = rate;
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_stats_clock
+ *
+ * Purpose:     Monotonic clock in microseconds.
+ *
+ * Description:	Used for the audio write times below and by the
+ *		transmit side so they can be compared.
+ *
+ *----------------------------------------------------------------*/
+
+int64_t audio_stats_clock(void)
+{
+#if __WIN32__
+	LARGE_INTEGER freq, now;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return ((int64_t)(now.QuadPart / freq.QuadPart) * 1000000 +
+			(int64_t)(now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_stats_write
+ *
+ * Purpose:     Note that audio output was handed to the device.
+ *
+ * Inputs:	adev	- Audio device number.
+ *
+ * Description:	Called by audio_flush, for each platform, after a
+ *		successful write.  The transmit thread calls
+ *		audio_stats_write_reset before the first audio of a
+ *		transmission and audio_stats_write_times after audio_wait
+ *		to find out when the first and last audio actually went out.
+ *
+ *		Only one thread writes to a device at a time and the
+ *		transmit thread waits for it so no lock is needed.
+ *
+ *----------------------------------------------------------------*/
+
+static int64_t write_first[MAX_ADEVS];
+static int64_t write_last[MAX_ADEVS];
+
+void audio_stats_write(int adev)
+{
+	int64_t now = audio_stats_clock();
+
+	assert(adev >= 0 && adev < MAX_ADEVS);
+
+	if (write_first[adev] == 0)
+	{
+		write_first[adev] = now;
+	}
+	write_last[adev] = now;
+}
+
+void audio_stats_write_reset(int adev)
+{
+	assert(adev >= 0 && adev < MAX_ADEVS);
+
+	write_first[adev] = 0;
+	write_last[adev] = 0;
+}
+
+/* 0 for both if nothing was written since the reset. */
+
+void audio_stats_write_times(int adev, int64_t *first, int64_t *last)
+{
+	assert(adev >= 0 && adev < MAX_ADEVS);
+
+	*first = write_first[adev];
+	*last = write_last[adev];
+}
+
+/* end audio_stats.c */
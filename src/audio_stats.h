@@ -2,4 +2,20 @@
 
 /* audio_stats.h */
 
+#include <stdint.h>
+
 extern void audio_stats(int adev, int nchan, int nsamp, int interval);
+
+void audio_stats_udp_lost(int adev, int n);
+
+void audio_stats_xrun(int adev);
+
+void audio_stats_buffer(int adev, int rate, int period, int size);
+
+int64_t audio_stats_clock(void);
+
+void audio_stats_write(int adev);
+
+void audio_stats_write_reset(int adev);
+
+void audio_stats_write_times(int adev, int64_t *first, int64_t *last);
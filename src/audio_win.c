@@ -41,6 +41,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <ctype.h>
 #include <io.h>
@@ -252,6 +253,17 @@ int audio_open(struct audio_s *pa)
 			if (pa->adev[a].bits_per_sample == 0)
 				pa->adev[a].bits_per_sample = DEFAULT_BITS_PER_SAMPLE;
 
+			if (pa->adev[a].in_samples_per_sec == pa->adev[a].samples_per_sec)
+				pa->adev[a].in_samples_per_sec = 0;
+
+			/* Version 1.8: Wider input formats are only in the Linux version. */
+
+			if (pa->adev[a].in_format != AUDIO_IN_FORMAT_DEFAULT)
+			{
+				printf("Audio input format other than 8 or 16 bits is not available here.\n");
+				pa->adev[a].in_format = AUDIO_IN_FORMAT_DEFAULT;
+			}
+
 			A->g_audio_in_type = AUDIO_IN_TYPE_SOUNDCARD;
 
 			for (chan = 0; chan < MAX_CHANS; chan++)
@@ -299,6 +311,14 @@ int audio_open(struct audio_s *pa)
 			{
 				A->g_audio_in_type = AUDIO_IN_TYPE_SOUNDCARD;
 
+				/* Version 1.8: Resampling the input is only for stdin or UDP here. */
+
+				if (pa->adev[a].in_samples_per_sec != 0)
+				{
+					printf("Different audio input sample rate, AINRATE, is only for stdin or UDP here.\n");
+					pa->adev[a].in_samples_per_sec = 0;
+				}
+
 				/* Does config file have a number?  */
 				/* If so, it is an index into list of devices. */
 				/* Originally only a single digit was recognized.  */
@@ -941,12 +961,157 @@ __attribute__((hot)) int audio_get(int a)
 		}
 		return (A->stream_data[A->stream_next++] & 0xff);
 		break;
+
+	case AUDIO_IN_TYPE_SHM: /* Linux only.  Never set here. */
+		break;
 	}
 
 	return (-1);
 
 } /* end audio_get */
 
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_get_frames
+ *
+ * Purpose:     Get a block of audio frames from the audio device.
+ *
+ * Inputs:	a	- Audio soundcard number.
+ *
+ *		max	- Number of frames wanted.
+ *
+ * Outputs:	frames	- Address of 16 bit signed samples.  For stereo,
+ *			  left and right alternate, starting with left.
+ *
+ * Returns:     Number of frames.  Fewer than max only at end of file.
+ *              -1 for any type of error or end of file.
+ *
+ * Description:	Version 1.8: Same as audio.c but here we simply
+ *		collect the samples with audio_get.
+ *
+ *----------------------------------------------------------------*/
+
+static int16_t *get_frames_buf[MAX_ADEVS];
+static int get_frames_size[MAX_ADEVS];
+
+int audio_get_frames(int a, const int16_t **frames, int max)
+{
+	int nchan = save_audio_config_p->adev[a].num_channels;
+	int n;
+
+	if (max * nchan > get_frames_size[a])
+	{
+		get_frames_buf[a] = realloc(get_frames_buf[a], max * nchan * sizeof(int16_t));
+		if (get_frames_buf[a] == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		get_frames_size[a] = max * nchan;
+	}
+
+	for (n = 0; n < max; n++)
+	{
+		for (int c = 0; c < nchan; c++)
+		{
+			int x1, x2;
+
+			x1 = audio_get(a);
+			if (x1 < 0)
+			{
+				return (n > 0 ? n : -1);
+			}
+
+			if (save_audio_config_p->adev[a].bits_per_sample == 8)
+			{
+				get_frames_buf[a][n * nchan + c] = (x1 - 128) * 256;
+			}
+			else
+			{
+				x2 = audio_get(a);
+				if (x2 < 0)
+				{
+					return (n > 0 ? n : -1);
+				}
+				get_frames_buf[a][n * nchan + c] = (int16_t)((x2 << 8) | x1);
+			}
+		}
+	}
+
+	*frames = get_frames_buf[a];
+	return (n);
+
+} /* end audio_get_frames */
+
+/* Nothing to do here.  The samples were already copied. */
+
+void audio_release_frames(int a, int n)
+{
+	(void)a;
+	(void)n;
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_get_block
+ *
+ * Purpose:     Get a block of audio, separated by channel.
+ *
+ * Inputs:	a	- Audio soundcard number.
+ *
+ *		max_frames - Most frames wanted.
+ *
+ * Outputs:	dst	- 16 bit signed samples.  The first channel is
+ *			  dst[0] .. dst[max_frames-1].  For stereo, the
+ *			  second starts at dst[max_frames].
+ *
+ * Returns:     Number of frames, at least 1.
+ *              -1 for any type of error or end of file.
+ *
+ * Description:	Version 1.8: For the receive thread, which passes a
+ *		block for each channel to the demodulators.
+ *
+ *----------------------------------------------------------------*/
+
+int audio_get_block(int a, int16_t *dst, int max_frames)
+{
+	int nchan = save_audio_config_p->adev[a].num_channels;
+	const int16_t *frames;
+	int n;
+
+	n = audio_get_frames(a, &frames, max_frames);
+	if (n <= 0)
+	{
+		return (-1);
+	}
+
+	if (nchan == 1)
+	{
+		memcpy(dst, frames, n * sizeof(int16_t));
+	}
+	else
+	{
+		for (int k = 0; k < n; k++)
+		{
+			dst[k] = frames[2 * k];
+			dst[max_frames + k] = frames[2 * k + 1];
+		}
+	}
+
+	audio_release_frames(a, n);
+	return (n);
+
+} /* end audio_get_block */
+
+/* Not available here. */
+
+void audio_xrun_stats(int a, int *in, int *out)
+{
+	(void)a;
+	*in = 0;
+	*out = 0;
+}
+
 /*------------------------------------------------------------------
  *
  * Name:        audio_put
@@ -1029,6 +1194,87 @@ int audio_put(int a, int c)
 
 } /* end audio_put */
 
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_put_bytes
+ *
+ * Purpose:     Send a block of bytes to the audio device.
+ *
+ * Inputs:	a
+ *
+ *		buf, len	- Same as calling audio_put for each byte.
+ *
+ * Returns:     Normally non-negative.
+ *              -1 for any type of error.
+ *
+ * Description:	Version 1.8: For tone generation from precomputed waveforms.
+ *
+ *----------------------------------------------------------------*/
+
+int audio_put_bytes(int a, const unsigned char *buf, int len)
+{
+	for (int i = 0; i < len; i++)
+	{
+		if (audio_put(a, buf[i]) < 0)
+		{
+			return (-1);
+		}
+	}
+
+	return (0);
+
+} /* end audio_put_bytes */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        audio_put_block
+ *
+ * Purpose:     Send audio samples to the device.
+ *
+ * Inputs:	a
+ *
+ *		frames	- 16 bit signed samples.  For stereo, left and right
+ *			  alternate, starting with left.
+ *
+ *		n	- Number of frames, i.e. sample times.
+ *
+ * Returns:     Normally non-negative.
+ *              -1 for any type of error.
+ *
+ * Description:	Version 1.8: The tone generator uses this rather than
+ *		audio_put for each byte.  Conversion to 8 bit, if needed,
+ *		is done here.
+ *
+ *----------------------------------------------------------------*/
+
+int audio_put_block(int a, const int16_t *frames, int n)
+{
+	int nsam = n * save_audio_config_p->adev[a].num_channels;
+
+	for (int i = 0; i < nsam; i++)
+	{
+		int sam = frames[i];
+		int e;
+
+		if (save_audio_config_p->adev[a].bits_per_sample == 8)
+		{
+			e = audio_put(a, ((sam + 32768) >> 8) & 0xff);
+		}
+		else
+		{
+			audio_put(a, sam & 0xff);
+			e = audio_put(a, (sam >> 8) & 0xff);
+		}
+		if (e < 0)
+		{
+			return (-1);
+		}
+	}
+
+	return (0);
+
+} /* end audio_put_block */
+
 /*------------------------------------------------------------------
  *
  * Name:        audio_flush
@@ -1074,6 +1320,7 @@ int audio_flush(int a)
 			return (-1);
 		}
 		A->out_current = (A->out_current + 1) % NUM_OUT_BUF;
+		audio_stats_write(a);
 	}
 	return (0);
 
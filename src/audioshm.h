@@ -0,0 +1,86 @@
+
+/*
+ * Name:	audioshm.h
+ *
+ * This is for receiving audio from another application on the same host,
+ * typically SDR software, through a ring buffer in shared memory.
+ *
+ * The other application creates the file, usually under /dev/shm, fills
+ * in the header, and then writes audio into it.  Direwolf maps the file
+ * and takes the samples directly from there.  There is no system call
+ * or copy for each chunk of audio.
+ *
+ *	ADEVICE  shm:/dev/shm/sdr-audio  default
+ *
+ * The layout is a fixed format.  All numbers are in the byte order of the
+ * host and the audio samples are little endian.
+ *
+ *	Offset 0	struct audioshm_header_s, AUDIOSHM_HEADER_SIZE bytes.
+ *
+ *	Offset AUDIOSHM_HEADER_SIZE
+ *			Data area of data_size bytes, a power of 2.
+ *
+ * Positions are counts of bytes ever written so they only increase.
+ * The byte for position p is at offset (p & (data_size - 1)) in the
+ * data area.  Audio is written as whole frames, a sample for each
+ * channel, and continues at the beginning after the end.
+ *
+ * The sample rate, number of channels, and format in the header are
+ * what the writer provides.  The number of channels must match the
+ * audio device configuration.  A different rate is resampled to the
+ * ARATE rate, like AINRATE.
+ *
+ * Writer:	(1) Fill in the header and then store magic (release).
+ *		(2) Write audio at head.  Don't get more than data_size
+ *		    ahead of the slowest reader you care about.
+ *		(3) Store the new head (release).
+ *		(4) Increment futex.  If waiters is not zero, FUTEX_WAKE
+ *		    all on futex.  (Not FUTEX_PRIVATE.)
+ *		(5) At the end of the stream, set closed and do (4).
+ *
+ * Reader:	Starts at head to get only new audio.  When there is
+ *		nothing new, it increments waiters, loads futex, checks
+ *		head once more, FUTEX_WAITs on futex for that value, and
+ *		decrements waiters.
+ *
+ * There is no flow control.  The writer never waits for us.  If we fall
+ * more than data_size behind, the old audio is skipped and counted as
+ * an input overrun.
+ */
+
+#ifndef AUDIOSHM_H
+#define AUDIOSHM_H 1
+
+#include <stdint.h>
+
+#define AUDIOSHM_MAGIC 0x41535744 /* "DWSA" in memory on little endian. */
+#define AUDIOSHM_VERSION 1
+
+#define AUDIOSHM_HEADER_SIZE 64
+
+#define AUDIOSHM_FORMAT_S16 1 /* Signed 16 bit. */
+#define AUDIOSHM_FORMAT_S24 2 /* Signed 24 bit, packed in 3 bytes. */
+#define AUDIOSHM_FORMAT_S32 3 /* Signed 32 bit. */
+#define AUDIOSHM_FORMAT_F32 4 /* 32 bit float, -1.0 to +1.0. */
+
+struct audioshm_header_s
+{
+	uint32_t magic;		  /* AUDIOSHM_MAGIC once ready for use. */
+	uint32_t version;	  /* AUDIOSHM_VERSION */
+	uint32_t header_size; /* AUDIOSHM_HEADER_SIZE */
+	uint32_t data_size;	  /* Size of data area.  Power of 2. */
+
+	uint32_t sample_rate;  /* Frames per second. */
+	uint32_t num_channels; /* 1 or 2. */
+	uint32_t format;	   /* AUDIOSHM_FORMAT_... */
+
+	uint32_t futex;	  /* Incremented by writer after each write. */
+	uint32_t waiters; /* Number of readers waiting on futex. */
+	uint32_t closed;  /* Set by writer at end of stream. */
+
+	uint64_t head; /* Position after last complete write. */
+};
+
+#endif
+
+/* end audioshm.h */
@@ -0,0 +1,465 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      autotune.c
+ *
+ * Purpose:   	Cut back the demodulators to fit the CPU we have.
+ *
+ * Description:	Version 1.8.
+ *
+ *		Multiple demodulators and slicers decode a few more frames
+ *		but the cost goes up quickly.  The right choice depends on
+ *		the computer.  A Pi Zero can't keep up with what a desktop
+ *		does easily, and when the receive thread falls behind the
+ *		audio, everything is lost, not just the marginal frames.
+ *
+ *		With CPUBUDGET in the configuration, each radio channel's
+ *		demodulators are timed at startup on a test signal of a few
+ *		seconds made by siggen.c.  If the time, as a percentage of
+ *		real time, is over the budget, the channel is cut back one
+ *		step at a time, most expensive channel first:
+ *
+ *			1. Drop the + for multiple slicers.
+ *			2. Drop the last demodulator, from a multi letter
+ *			   profile or multiple frequencies.
+ *			3. Divide the sample rate by a larger number, which
+ *			   means fewer filter taps for each second of audio.
+ *
+ *		The budget is for each thread doing the demodulating.  That
+ *		is each audio device, or each channel with DEMODTHREADS.
+ *		Each decision is printed.
+ *
+ *		Each trial needs the demodulators set up from scratch, and
+ *		the initialization is only meant to be done once, so it is
+ *		done in a child process which reports back through a pipe.
+ *		Not available for Windows.
+ *
+ *		Configuration:
+ *
+ *			CPUBUDGET  percent
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !__WIN32__
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "audio.h"
+#include "autotune.h"
+#include "ax25_pad.h"
+#include "multi_modem.h"
+#include "fx25.h"
+#include "siggen.h"
+#include "metrics.h"
+
+#define AUTOTUNE_SECONDS 4 /* Length of test signal. */
+#define AUTOTUNE_PASSES 3  /* Take the fastest of this many times over it. */
+#define AUTOTUNE_BLOCK 64  /* Same as RECV_BLOCK_SIZE in recv.c. */
+#define MAX_DECIMATE 3	   /* Most demod.c ever picks by itself. */
+
+#if !__WIN32__
+
+/* What a trial sends back. */
+
+struct trial_s
+{
+	double percent;	   /* Time to demodulate as percent of real time. */
+	int decimate;	   /* What demod_init chose, if it was left at 0. */
+	char profiles[16]; /* Normalized by demod_init, e.g. "" becomes "A+". */
+	int frames;		   /* Test frames decoded.  A sanity check. */
+	int sent;		   /* Test frames sent. */
+};
+
+static int measure(struct audio_s *pa, int chan, struct trial_s *result);
+
+static void run_trial(struct audio_s *pa, int chan, struct trial_s *result);
+
+static int cut_back(struct audio_s *pa, int chan, int decimate, int apply);
+
+/* Channels sharing a thread have the same group number. */
+
+static int group_of(struct audio_s *pa, int chan)
+{
+	return (pa->demod_threads > 0 ? chan : ACHAN2ADEV(chan));
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        autotune
+ *
+ * Purpose:     Fit the demodulators to the CPU budget.
+ *
+ * Inputs:	pa	- Configuration.  pa->cpu_budget is the percent
+ *			  of one CPU allowed for each demodulator thread.
+ *			  0 to leave everything as it is.
+ *
+ * Outputs:	pa->achan[].profiles, num_freq, decimate - Reduced as needed.
+ *
+ * Description:	Call after the audio devices are opened, so the sample
+ *		rates are final, and before multi_modem_init.
+ *
+ *--------------------------------------------------------------------*/
+
+void autotune(struct audio_s *pa)
+{
+	static struct trial_s t[MAX_CHANS];
+	int chan, g;
+
+	if (pa->cpu_budget <= 0)
+	{
+		return;
+	}
+
+	printf("Timing the demodulators for a CPU budget of %d%% ...\n", pa->cpu_budget);
+
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		memset(&t[chan], 0, sizeof(t[chan]));
+
+		if (pa->chan_medium[chan] == MEDIUM_RADIO && pa->achan[chan].modem_type != MODEM_OFF)
+		{
+			if (measure(pa, chan, &t[chan]) < 0)
+			{
+				printf("Could not time the demodulators.  Leaving them as configured.\n");
+				return;
+			}
+			printf("Channel %d: Demodulators %s use %.1f%% of a CPU.  %d of %d test frames decoded.\n",
+				   chan, t[chan].profiles, t[chan].percent, t[chan].frames, t[chan].sent);
+		}
+	}
+
+	for (g = 0; g < MAX_CHANS; g++)
+	{
+		while (1)
+		{
+			double total = 0;
+			int worst = -1;
+
+			for (chan = 0; chan < MAX_CHANS; chan++)
+			{
+				if (group_of(pa, chan) == g && t[chan].percent > 0)
+				{
+					total += t[chan].percent;
+
+					if ((worst < 0 || t[chan].percent > t[worst].percent) && cut_back(pa, chan, t[chan].decimate, 0))
+					{
+						worst = chan;
+					}
+				}
+			}
+
+			if (total <= pa->cpu_budget)
+			{
+				break;
+			}
+
+			if (worst < 0)
+			{
+				printf("Can't cut back the demodulators enough for a budget of %d%%.  %.1f%% is the best we can do",
+					   pa->cpu_budget, total);
+				if (pa->demod_threads > 0)
+					printf(" for channel %d.\n", g);
+				else
+					printf(" for audio device %d.\n", g);
+				break;
+			}
+
+			cut_back(pa, worst, t[worst].decimate, 1);
+
+			if (measure(pa, worst, &t[worst]) < 0)
+			{
+				printf("Could not time the demodulators.\n");
+				return;
+			}
+			printf("Channel %d: Demodulators %s", worst, t[worst].profiles);
+			if (t[worst].decimate > 1)
+				printf(" at sample rate / %d", t[worst].decimate);
+			printf(" use %.1f%% of a CPU.  %d of %d test frames decoded.\n", t[worst].percent, t[worst].frames, t[worst].sent);
+		}
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        cut_back
+ *
+ * Purpose:     Take the next step down in demodulator cost for a channel.
+ *
+ * Inputs:	pa	- Configuration.  Profile must be normalized.
+ *		chan	- Radio channel.
+ *		decimate - What the channel is using now.
+ *		apply	- False to only find out if there is another step.
+ *
+ * Returns:	1 if there was a step to take.  0 if nothing left to cut.
+ *
+ *--------------------------------------------------------------------*/
+
+static int cut_back(struct audio_s *pa, int chan, int decimate, int apply)
+{
+	char *profiles = pa->achan[chan].profiles;
+	int len = strlen(profiles);
+	int rate = pa->adev[ACHAN2ADEV(chan)].samples_per_sec;
+	int top = pa->achan[chan].mark_freq > pa->achan[chan].space_freq ? pa->achan[chan].mark_freq : pa->achan[chan].space_freq;
+
+	if (pa->achan[chan].modem_type != MODEM_AFSK)
+	{
+		return (0);
+	}
+
+	if (len > 0 && profiles[len - 1] == '+')
+	{
+		if (apply)
+		{
+			printf("Channel %d: Over the CPU budget.  Dropping the + for multiple slicers.\n", chan);
+			profiles[len - 1] = '\0';
+		}
+		return (1);
+	}
+
+	if (len > 1)
+	{
+		if (apply)
+		{
+			printf("Channel %d: Over the CPU budget.  Dropping demodulator %c.\n", chan, profiles[len - 1]);
+			profiles[len - 1] = '\0';
+		}
+		return (1);
+	}
+
+	if (pa->achan[chan].num_freq > 1)
+	{
+		if (apply)
+		{
+			printf("Channel %d: Over the CPU budget.  Using %d frequency pairs rather than %d.\n",
+				   chan, pa->achan[chan].num_freq - 1, pa->achan[chan].num_freq);
+			pa->achan[chan].num_freq--;
+		}
+		return (1);
+	}
+
+	// Keep at least 4 samples for each cycle of the higher tone.
+
+	if (decimate < MAX_DECIMATE && rate / (decimate + 1) >= 4 * top)
+	{
+		if (apply)
+		{
+			printf("Channel %d: Over the CPU budget.  Dividing the sample rate by %d.\n", chan, decimate + 1);
+			pa->achan[chan].decimate = decimate + 1;
+		}
+		return (1);
+	}
+
+	return (0);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        measure
+ *
+ * Purpose:     Time a channel's demodulators in a child process.
+ *
+ * Inputs:	pa	- Configuration.
+ *		chan	- Radio channel.
+ *
+ * Outputs:	result	- Time and what demod_init did with the profile.
+ *			  The normalized profile is copied back into pa
+ *			  so cut_back can take it apart.
+ *
+ * Returns:	0 for success, -1 for failure.
+ *
+ *--------------------------------------------------------------------*/
+
+static int measure(struct audio_s *pa, int chan, struct trial_s *result)
+{
+	int fd[2];
+	pid_t pid;
+	int status;
+	ssize_t n;
+
+	if (pipe(fd) != 0)
+	{
+		perror("autotune pipe");
+		return (-1);
+	}
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+	{
+		perror("autotune fork");
+		close(fd[0]);
+		close(fd[1]);
+		return (-1);
+	}
+
+	if (pid == 0)
+	{
+		// Child.  Don't let the demodulator setup messages through.
+
+		struct trial_s r;
+
+		close(fd[0]);
+		if (freopen("/dev/null", "w", stdout) == NULL)
+		{
+			_exit(1);
+		}
+		memset(&r, 0, sizeof(r));
+		run_trial(pa, chan, &r);
+		_exit(write(fd[1], &r, sizeof(r)) == (ssize_t)sizeof(r) ? 0 : 1);
+	}
+
+	close(fd[1]);
+	n = read(fd[0], result, sizeof(*result));
+	close(fd[0]);
+	waitpid(pid, &status, 0);
+
+	if (n != (ssize_t)sizeof(*result) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		return (-1);
+	}
+
+	snprintf(pa->achan[chan].profiles, sizeof(pa->achan[chan].profiles), "%s", result->profiles);
+	return (0);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        run_trial
+ *
+ * Purpose:     Set up only this channel and time its demodulators.
+ *
+ * Inputs:	pa	- Configuration.  A copy is changed here.
+ *		chan	- Radio channel.
+ *
+ * Outputs:	result
+ *
+ * Description:	This is in the child process so initializing everything
+ *		again, and starting threads, is no problem.  The audio
+ *		is only rendered into memory and never reaches the device.
+ *
+ *		The test signal, from siggen.c, is a series of APRS size
+ *		frames with some silence between, and noise added.
+ *
+ *--------------------------------------------------------------------*/
+
+static void run_trial(struct audio_s *pa, int chan, struct trial_s *result)
+{
+	static struct audio_s trial;
+	int a = ACHAN2ADEV(chan);
+	int rate = pa->adev[a].samples_per_sec;
+	int16_t *samples;
+	int nframes, n, k, pass;
+	int64_t best = 0;
+
+	memcpy(&trial, pa, sizeof(trial));
+	for (n = 0; n < MAX_CHANS; n++)
+	{
+		if (n != chan)
+		{
+			trial.chan_medium[n] = MEDIUM_NONE;
+		}
+	}
+	trial.recv_error_rate = 0;
+
+	multi_modem_init(&trial);
+	fx25_init(0);
+
+	snprintf(result->profiles, sizeof(result->profiles), "%s", trial.achan[chan].profiles);
+	result->decimate = trial.achan[chan].decimate > 0 ? trial.achan[chan].decimate : 1;
+
+	/*
+	 * Make the test signal.  APRS size frames, mostly back to back,
+	 * with a good signal to noise ratio.
+	 */
+
+	struct siggen_s g;
+
+	siggen_default(&g);
+	g.samples_per_sec = rate;
+	g.modem_type = trial.achan[chan].modem_type;
+	g.baud = trial.achan[chan].baud;
+	g.mark_freq = trial.achan[chan].mark_freq;
+	g.space_freq = trial.achan[chan].space_freq;
+	g.info_min = 60;
+	g.info_max = 60;
+	g.txdelay_ms = 200;
+	g.density = 80;
+	g.snr_db = 20;
+
+	// Each transmission is the TXDELAY and about 80 bytes.
+
+	g.num_frames = (int)(AUTOTUNE_SECONDS * g.density / 100. / (g.txdelay_ms / 1000. + 80. * 8 / g.baud)) + 1;
+	result->sent = g.num_frames;
+
+	nframes = siggen_make(&g, &samples);
+
+	/*
+	 * Time it.  Frames decoded are counted by metrics.c.
+	 */
+
+	for (pass = 0; pass < AUTOTUNE_PASSES; pass++)
+	{
+		int64_t start = metrics_clock_ns();
+
+		for (k = 0; k < nframes; k += AUTOTUNE_BLOCK)
+		{
+			multi_modem_process_block(chan, samples + k, nframes - k < AUTOTUNE_BLOCK ? nframes - k : AUTOTUNE_BLOCK);
+		}
+
+		int64_t elapsed = metrics_clock_ns() - start;
+		if (pass == 0 || elapsed < best)
+		{
+			best = elapsed;
+		}
+	}
+
+	struct metrics_chan_s m;
+	metrics_get(chan, &m);
+	for (n = 0; n < MAX_SUBCHANS; n++)
+	{
+		for (k = 0; k < MAX_SLICERS; k++)
+		{
+			result->frames += m.picked[n][k];
+		}
+	}
+	result->frames /= AUTOTUNE_PASSES;
+	result->percent = 100. * best / (1e9 * nframes / rate);
+}
+
+#else /* __WIN32__ */
+
+void autotune(struct audio_s *pa)
+{
+	if (pa->cpu_budget > 0)
+	{
+		printf("CPUBUDGET is not available for Windows.\n");
+	}
+}
+
+#endif
+
+/* end autotune.c */
@@ -0,0 +1,18 @@
+
+/*
+ * Name:	autotune.h
+ *
+ * This is for cutting back the demodulators to fit a CPU budget.
+ * See autotune.c.
+ */
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H 1
+
+#include "audio.h"
+
+void autotune(struct audio_s *pa);
+
+#endif
+
+/* end autotune.h */
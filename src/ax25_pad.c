@@ -168,6 +168,7 @@
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <ctype.h>
 
 #include "regex.h"
@@ -189,6 +190,36 @@ static volatile int new_count = 0;
 static volatile int delete_count = 0;
 static volatile int last_seq_num = 0;
 
+/*
+ * Version 1.8: Deleted packet objects are kept for reuse rather
+ * than going back to free() and calloc() each time.  Every
+ * decoded candidate gets one and most of the duplicates from
+ * other slicers are deleted almost right away, by the same thread.
+ *
+ * Each thread has its own list so no locking is needed.  Objects
+ * deleted by a different thread than created them simply end up
+ * in the other thread's list.  Anything beyond POOL_MAX is freed.
+ *
+ * magic1 and magic2 are set to MAGIC_FREE while an object is in
+ * the pool so use after delete still fails the usual assertions
+ * and a stomped free object is noticed when it is taken out again.
+ *
+ * Frames up to AX25_SMALL_FRAME_LEN, which is most APRS traffic,
+ * are kept in the object itself.  Anything longer gets a separate
+ * maximum size buffer, which is freed when the object is deleted.
+ */
+
+#define POOL_MAX 32
+#define MAGIC_FREE 0x46524545
+
+static __thread struct packet_s *pool_head = NULL;
+static __thread int pool_count = 0;
+
+static volatile int pool_hits = 0;	 /* ax25_new served from a pool. */
+static volatile int pool_misses = 0; /* ax25_new needed calloc. */
+static volatile int pool_frees = 0;	 /* ax25_delete found the pool full. */
+static volatile int max_frame_len = 0; /* Largest frame seen at delete. */
+
 #define CLEAR_LAST_ADDR_FLAG this_p->frame_data[this_p->num_addr * 7 - 1] &= ~SSID_LAST_MASK
 #define SET_LAST_ADDR_FLAG this_p->frame_data[this_p->num_addr * 7 - 1] |= SSID_LAST_MASK
 
@@ -203,7 +234,19 @@ static volatile int last_seq_num = 0;
  *
  *------------------------------------------------------------------------------*/
 
-packet_t ax25_new(void)
+/*------------------------------------------------------------------------------
+ *
+ * Name:	packet_alloc
+ *
+ * Purpose:	Get a packet object, from this thread's pool if possible.
+ *
+ * Inputs:	zero	- True to clear the whole thing.
+ *			  False to clear only the fields before frame_data,
+ *			  for callers about to fill in the frame themselves.
+ *
+ *------------------------------------------------------------------------------*/
+
+static struct packet_s *packet_alloc(int zero)
 {
 	struct packet_s *this_p;
 
@@ -225,32 +268,114 @@ packet_t ax25_new(void)
 	if (new_count > delete_count + 256)
 	{
 		printf("Report to WB2OSZ - Memory leak for packet objects.  new=%d, delete=%d\n", new_count, delete_count);
+		printf("Packet pool: reused=%d, allocated=%d, freed=%d, largest frame=%d\n", pool_hits, pool_misses, pool_frees, max_frame_len);
 	}
 
-	this_p = calloc(sizeof(struct packet_s), (size_t)1);
-
-	if (this_p == NULL)
+	this_p = pool_head;
+	if (this_p != NULL)
 	{
+		assert(this_p->magic1 == MAGIC_FREE);
+		assert(this_p->magic2 == MAGIC_FREE);
 
-		printf("ERROR - can't allocate memory in ax25_new.\n");
+		pool_head = this_p->nextp;
+		pool_count--;
+		pool_hits++;
+
+		if (zero)
+		{
+			memset(this_p, 0, sizeof(struct packet_s));
+		}
+		else
+		{
+			memset(this_p, 0, offsetof(struct packet_s, frame_small));
+		}
 	}
+	else
+	{
+		this_p = calloc(sizeof(struct packet_s), (size_t)1);
 
-	assert(this_p != NULL);
+		if (this_p == NULL)
+		{
+
+			printf("ERROR - can't allocate memory in ax25_new.\n");
+		}
+
+		assert(this_p != NULL);
+		pool_misses++;
+	}
 
 	this_p->magic1 = MAGIC;
 	this_p->seq = last_seq_num;
 	this_p->magic2 = MAGIC;
 	this_p->num_addr = (-1);
+	this_p->frame_data = this_p->frame_small;
+	this_p->frame_size = AX25_SMALL_FRAME_LEN;
 
 	return (this_p);
 }
 
+/*------------------------------------------------------------------------------
+ *
+ * Name:	frame_reserve
+ *
+ * Purpose:	Make sure frame_data can hold a frame of the given length.
+ *
+ * Inputs:	len	- Frame length about to be stored, not counting the CRC.
+ *
+ * Description:	The first time a frame outgrows the small buffer it moves
+ *		to a separate buffer large enough for any frame.
+ *
+ *------------------------------------------------------------------------------*/
+
+static void frame_reserve(struct packet_s *this_p, int len)
+{
+	unsigned char *large;
+
+	assert(len >= 0 && len <= AX25_MAX_PACKET_LEN);
+
+	if (len <= this_p->frame_size)
+	{
+		return;
+	}
+
+	large = malloc(AX25_MAX_PACKET_LEN + 1);
+	if (large == NULL)
+	{
+
+		printf("ERROR - can't allocate memory in frame_reserve.\n");
+	}
+	assert(large != NULL);
+
+	memcpy(large, this_p->frame_small, this_p->frame_len);
+	large[this_p->frame_len] = 0;
+	this_p->frame_data = large;
+	this_p->frame_size = AX25_MAX_PACKET_LEN;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ * Name:	ax25_new
+ *
+ * Purpose:	Allocate memory for a new packet object.
+ *
+ * Returns:	Identifier for a new packet object.
+ *		In the current implementation this happens to be a pointer.
+ *
+ *------------------------------------------------------------------------------*/
+
+packet_t ax25_new(void)
+{
+	return (packet_alloc(1));
+}
+
 /*------------------------------------------------------------------------------
  *
  * Name:	ax25_delete
  *
  * Purpose:	Destroy a packet object, freeing up memory it was using.
  *
+ * Description:	The object is kept in this thread's pool for reuse.
+ *
  *------------------------------------------------------------------------------*/
 void ax25_delete(packet_t this_p)
 {
@@ -271,11 +396,31 @@ void ax25_delete(packet_t this_p)
 	assert(this_p->magic1 == MAGIC);
 	assert(this_p->magic2 == MAGIC);
 
-	this_p->magic1 = 0;
-	this_p->magic1 = 0;
+	if (this_p->frame_len > max_frame_len)
+	{
+		max_frame_len = this_p->frame_len;
+	}
+
+	if (this_p->frame_data != this_p->frame_small)
+	{
+		free(this_p->frame_data);
+		this_p->frame_data = NULL;
+	}
 
-	// memset (this_p, 0, sizeof (struct packet_s));
-	free(this_p);
+	if (pool_count >= POOL_MAX)
+	{
+		this_p->magic1 = 0;
+		this_p->magic2 = 0;
+		pool_frees++;
+		free(this_p);
+		return;
+	}
+
+	this_p->magic1 = MAGIC_FREE;
+	this_p->magic2 = MAGIC_FREE;
+	this_p->nextp = pool_head;
+	pool_head = this_p;
+	pool_count++;
 }
 
 /*------------------------------------------------------------------------------
@@ -536,6 +681,7 @@ packet_t ax25_from_text(char *monitor, int strict)
 	/*
 	 * Append the info part.
 	 */
+	frame_reserve(this_p, this_p->frame_len + info_len);
 	memcpy((char *)(this_p->frame_data + this_p->frame_len), info_part, info_len);
 	this_p->frame_len += info_len;
 
@@ -589,10 +735,13 @@ packet_t ax25_from_frame(unsigned char *fbuf, int flen)
 		return (NULL);
 	}
 
-	this_p = ax25_new();
+	/* Everything in frame_data that matters is about to be replaced. */
+
+	this_p = packet_alloc(0);
 
 	/* Copy the whole thing intact. */
 
+	frame_reserve(this_p, flen);
 	memcpy(this_p->frame_data, fbuf, flen);
 	this_p->frame_data[flen] = 0;
 	this_p->frame_len = flen;
@@ -621,14 +770,23 @@ packet_t ax25_dup(packet_t copy_from)
 {
 	int save_seq;
 	packet_t this_p;
+	unsigned char *frame_data;
+	int frame_size;
 
-	this_p = ax25_new();
+	this_p = packet_alloc(0); /* Whole thing gets replaced. */
 	assert(this_p != NULL);
 
 	save_seq = this_p->seq;
 
-	memcpy(this_p, copy_from, sizeof(struct packet_s));
+	frame_reserve(this_p, copy_from->frame_len);
+	frame_data = this_p->frame_data;
+	frame_size = this_p->frame_size;
+
+	memcpy(this_p, copy_from, offsetof(struct packet_s, frame_small));
 	this_p->seq = save_seq;
+	this_p->frame_data = frame_data;
+	this_p->frame_size = frame_size;
+	memcpy(this_p->frame_data, copy_from->frame_data, copy_from->frame_len + 1);
 
 	return (this_p);
 }
@@ -1051,6 +1209,7 @@ void ax25_insert_addr(packet_t this_p, int n, char *ad)
 
 	this_p->num_addr++;
 
+	frame_reserve(this_p, this_p->frame_len + 7);
 	memmove(this_p->frame_data + (n + 1) * 7, this_p->frame_data + n * 7, this_p->frame_len - (n * 7));
 	memset(this_p->frame_data + n * 7, ' ' << 1, 6);
 	this_p->frame_len += 7;
@@ -1684,6 +1843,12 @@ void ax25_set_info(packet_t this_p, unsigned char *new_info_ptr, int new_info_le
 		new_info_len = 0;
 	if (new_info_len > AX25_MAX_INFO_LEN)
 		new_info_len = AX25_MAX_INFO_LEN;
+	if (this_p->frame_len + new_info_len > this_p->frame_size)
+	{
+		int offset = old_info_ptr - this_p->frame_data;
+		frame_reserve(this_p, this_p->frame_len + new_info_len);
+		old_info_ptr = this_p->frame_data + offset;
+	}
 	memcpy(old_info_ptr, new_info_ptr, new_info_len);
 	this_p->frame_len += new_info_len;
 }
@@ -1792,6 +1957,47 @@ double ax25_get_release_time(packet_t this_p)
 	return (this_p->release_time);
 }
 
+/*------------------------------------------------------------------------------
+ *
+ * Name:	ax25_set_rx_times
+ *
+ * Purpose:	Set times for receive latency measurement.  See rxlat.c.
+ *
+ * Inputs:	this_p		- Current packet object.
+ *
+ *		end_time	- When the frame ended on the air.
+ *
+ *		stage_time	- When it passed the latest stage.
+ *
+ *------------------------------------------------------------------------------*/
+
+void ax25_set_rx_times(packet_t this_p, int64_t end_time, int64_t stage_time)
+{
+	assert(this_p->magic1 == MAGIC);
+	assert(this_p->magic2 == MAGIC);
+
+	this_p->rx_end_time = end_time;
+	this_p->rx_stage_time = stage_time;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ * Name:	ax25_get_rx_times
+ *
+ * Purpose:	Get times for receive latency measurement.  Both 0 if
+ *		the packet isn't being timed.
+ *
+ *------------------------------------------------------------------------------*/
+
+void ax25_get_rx_times(packet_t this_p, int64_t *end_time, int64_t *stage_time)
+{
+	assert(this_p->magic1 == MAGIC);
+	assert(this_p->magic2 == MAGIC);
+
+	*end_time = this_p->rx_end_time;
+	*stage_time = this_p->rx_stage_time;
+}
+
 /*------------------------------------------------------------------------------
  *
  * Name:	ax25_set_modulo
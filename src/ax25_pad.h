@@ -9,6 +9,8 @@
 #ifndef AX25_PAD_H
 #define AX25_PAD_H 1
 
+#include <stdint.h>
+
 #define AX25_MAX_REPEATERS 8
 #define AX25_MIN_ADDRS 2  /* Destination & Source. */
 #define AX25_MAX_ADDRS 10 /* Destination, Source, 8 digipeaters. */
@@ -79,6 +81,10 @@ struct packet_s
 	double release_time; /* Time stamp in format returned by dtime_now(). */
 	/* When to release from the SATgate mode delay queue. */
 
+	int64_t rx_end_time;   /* Version 1.8: For receive latency, from rxlat_now */
+	int64_t rx_stage_time; /* when the frame ended and when it passed the */
+						   /* last stage.  0 if not being timed.  See rxlat.c. */
+
 #define MAGIC 0x41583235
 
 	struct packet_s *nextp; /* Pointer to next in queue. */
@@ -131,8 +137,17 @@ struct packet_s
 	/* For U frames:   	set to 0 - not applicable */
 	/* For I & S frames:	8 or 128 if known.  0 if unknown. */
 
-	unsigned char frame_data[AX25_MAX_PACKET_LEN + 1];
-	/* Raw frame contents, without the CRC. */
+	unsigned char *frame_data; /* Raw frame contents, without the CRC. */
+							   /* Points to frame_small or, for frames longer */
+							   /* than AX25_SMALL_FRAME_LEN, a separate buffer of */
+							   /* AX25_MAX_PACKET_LEN + 1 bytes. */
+
+	int frame_size; /* Most frame_data can hold, not counting the */
+					/* extra byte for a nul terminator. */
+
+#define AX25_SMALL_FRAME_LEN 128
+
+	unsigned char frame_small[AX25_SMALL_FRAME_LEN + 1];
 
 	int magic2; /* Will get stomped on if above overflows. */
 };
@@ -369,6 +384,9 @@ extern packet_t ax25_get_nextp(packet_t this_p);
 extern void ax25_set_release_time(packet_t this_p, double release_time);
 extern double ax25_get_release_time(packet_t this_p);
 
+extern void ax25_set_rx_times(packet_t this_p, int64_t end_time, int64_t stage_time);
+extern void ax25_get_rx_times(packet_t this_p, int64_t *end_time, int64_t *stage_time);
+
 extern void ax25_set_modulo(packet_t this_p, int modulo);
 extern int ax25_get_modulo(packet_t this_p);
 
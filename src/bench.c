@@ -0,0 +1,653 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      bench.c
+ *
+ * Purpose:   	Time the small functions where most of the CPU goes.
+ *
+ * Description:	Version 1.8.
+ *
+ *		Each benchmark runs an operation in batches.  The batch
+ *		size is first doubled until a batch takes about a
+ *		millisecond, which also serves as the warmup, then a number
+ *		of batches are timed.  Time per operation is reported as the
+ *		median and 99th percentile over the batches, so an occasional
+ *		interruption doesn't throw off the result.
+ *
+ *		On x86 the time stamp counter is read too.  It runs at a
+ *		constant rate on anything recent, so it is only the same as
+ *		core clock cycles when the CPU isn't changing speed.
+ *
+ *		Results go to stdout as JSON, to keep as a baseline and
+ *		compare with later.  The DIREWOLF_CONVOLVE and DIREWOLF_FCS
+ *		environment variables select other implementations, the
+ *		same as for direwolf.
+ *
+ * Usage:	bench  [ -r reps ]  [ name ... ]
+ *
+ *		-r n	Number of timed batches.  Default 101.
+ *		name	Run only the benchmarks with names containing
+ *			one of these.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#if __WIN32__
+#include <windows.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "audio.h"
+#include "ax25_pad.h"
+#include "fcs_calc.h"
+#include "fx25.h"
+#include "kiss_frame.h"
+#include "gen_tone.h"
+#include "dsp_kernel.h"
+#include "fsk_demod_state.h" /* for MAX_FILTER_SIZE */
+
+#define BATCH_NS 1000000 /* Aim for this much time per batch. */
+
+static volatile unsigned int sink; /* Keep results from being optimized away. */
+
+static unsigned int rand_state = 12345;
+
+static unsigned int bench_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 8);
+}
+
+/*
+ * Operations.  Each does "iters" of the same thing.
+ * arg is whatever varies between entries of the same operation.
+ */
+
+/* dsp_convolve.  48000 / 1200 is 40 samples per symbol, so these are */
+/* about what demod_afsk uses for 1 to 4.5 symbols. */
+
+static float conv_data[4 * MAX_FILTER_SIZE + 32];
+static float conv_filter[MAX_FILTER_SIZE];
+
+static void run_convolve(int taps, long iters)
+{
+	float sum = 0;
+
+	for (long i = 0; i < iters; i++)
+	{
+		sum += dsp_convolve(conv_data + (i & 7), conv_filter, taps);
+	}
+	sink += (unsigned int)sum;
+}
+
+static void run_convolve4(int taps, long iters)
+{
+	float out[4], sum = 0;
+
+	for (long i = 0; i < iters; i++)
+	{
+		dsp_convolve4(conv_data + (i & 7) * 4, conv_filter, taps, out);
+		sum += out[0];
+	}
+	sink += (unsigned int)sum;
+}
+
+/* Same with the version built for that many taps, if there is one. */
+
+static void run_convolve_for(int taps, long iters)
+{
+	dsp_convolve_fn_t fn = dsp_convolve_for(taps);
+	float sum = 0;
+
+	for (long i = 0; i < iters; i++)
+	{
+		sum += fn(conv_data + (i & 7), conv_filter, taps);
+	}
+	sink += (unsigned int)sum;
+}
+
+static void run_convolve4_for(int taps, long iters)
+{
+	dsp_convolve4_fn_t fn = dsp_convolve4_for(taps);
+	float out[4], sum = 0;
+
+	for (long i = 0; i < iters; i++)
+	{
+		fn(conv_data + (i & 7) * 4, conv_filter, taps, out);
+		sum += out[0];
+	}
+	sink += (unsigned int)sum;
+}
+
+/* FCS over a frame of arg bytes. */
+
+static unsigned char frame_data[AX25_MAX_PACKET_LEN];
+
+static void run_fcs_calc(int len, long iters)
+{
+	unsigned int s = 0;
+
+	for (long i = 0; i < iters; i++)
+	{
+		frame_data[0] = i;
+		s += fcs_calc(frame_data, len);
+	}
+	sink += s;
+}
+
+static void run_crc16(int len, long iters)
+{
+	unsigned int s = 0;
+
+	for (long i = 0; i < iters; i++)
+	{
+		frame_data[0] = i;
+		s += crc16(frame_data, len, 0xffff);
+	}
+	sink += s;
+}
+
+/* FX.25 correlation tag search, once per received bit. */
+/* Random bits, so almost never a match, like the receiver sees. */
+
+static unsigned char tag_bits[4096];
+
+static void run_tag_find_match(int notused, long iters)
+{
+	uint64_t t = 0;
+	int found = 0;
+
+	(void)notused;
+	for (long i = 0; i < iters; i++)
+	{
+		t = (t >> 1) | ((uint64_t)tag_bits[i & 4095] << 63);
+		found += fx25_tag_find_match(t) >= 0;
+	}
+	sink += found;
+}
+
+/* Reed-Solomon decode of RS(255,223) with arg byte errors.  It can correct up to 16. */
+
+#define RS_CTAG 5
+
+static unsigned char rs_block[3][FX25_BLOCK_SIZE];
+
+static void run_decode_rs(int errors, long iters)
+{
+	struct rs *rs = fx25_get_rs(RS_CTAG);
+	unsigned char work[FX25_BLOCK_SIZE];
+	int n = 0;
+
+	for (long i = 0; i < iters; i++)
+	{
+		memcpy(work, rs_block[errors / 8], FX25_BLOCK_SIZE);
+		n += DECODE_RS(rs, work, NULL, 0);
+	}
+	sink += n;
+}
+
+/* KISS, both ways. */
+
+static unsigned char kiss_raw[AX25_MAX_PACKET_LEN];
+static int kiss_raw_len;
+static unsigned char kiss_enc[2 * AX25_MAX_PACKET_LEN + 2];
+static int kiss_enc_len;
+
+static void run_kiss_encapsulate(int notused, long iters)
+{
+	unsigned char out[2 * AX25_MAX_PACKET_LEN + 2];
+	int n = 0;
+
+	(void)notused;
+	for (long i = 0; i < iters; i++)
+	{
+		n += kiss_encapsulate(kiss_raw, kiss_raw_len, out);
+	}
+	sink += n;
+}
+
+static void run_kiss_unwrap(int notused, long iters)
+{
+	unsigned char out[2 * AX25_MAX_PACKET_LEN + 2];
+	int n = 0;
+
+	(void)notused;
+	for (long i = 0; i < iters; i++)
+	{
+		n += kiss_unwrap(kiss_enc, kiss_enc_len, out);
+	}
+	sink += n;
+}
+
+/* AX.25 frame to packet object and back.  Allocation is part of it. */
+
+static packet_t ax25_pp;
+static unsigned char ax25_frame[AX25_MAX_PACKET_LEN];
+static int ax25_frame_len;
+
+static void run_ax25_from_frame(int notused, long iters)
+{
+	(void)notused;
+	for (long i = 0; i < iters; i++)
+	{
+		packet_t pp = ax25_from_frame(ax25_frame, ax25_frame_len);
+
+		ax25_delete(pp);
+	}
+}
+
+static void run_ax25_pack(int notused, long iters)
+{
+	unsigned char out[AX25_MAX_PACKET_LEN];
+	int n = 0;
+
+	(void)notused;
+	for (long i = 0; i < iters; i++)
+	{
+		n += ax25_pack(ax25_pp, out);
+	}
+	sink += n;
+}
+
+/* AFSK tone generation, one bit at a time.  arg is the channel. */
+/* Channel 0 is 48000 samples per second, a whole number per bit. */
+/* Channel 2 is 44100, which isn't. */
+
+static struct audio_s tone_config;
+
+static void run_tone_gen_put_bit(int chan, long iters)
+{
+	for (long i = 0; i < iters; i++)
+	{
+		tone_gen_put_bit(chan, tag_bits[i & 4095]);
+	}
+}
+
+/* Tone generator output goes nowhere. */
+
+int audio_put_block(int a, const int16_t *frames, int nframes)
+{
+	(void)a;
+	sink += frames[0] + nframes;
+	return (0);
+}
+
+int audio_flush(int a)
+{
+	(void)a;
+	return (0);
+}
+
+/* kiss_frame.c wants these for received KISS commands, which we don't use. */
+
+int tq_append_batch(int chan, int prio, packet_t pp)
+{
+	(void)chan;
+	(void)prio;
+	ax25_delete(pp);
+	return (0);
+}
+
+int tq_count(int chan, int prio, char *source, char *dest, int bytes)
+{
+	(void)chan;
+	(void)prio;
+	(void)source;
+	(void)dest;
+	(void)bytes;
+	return (0);
+}
+
+void xmit_set_txdelay(int channel, int value) { (void)channel; (void)value; }
+void xmit_set_persist(int channel, int value) { (void)channel; (void)value; }
+void xmit_set_slottime(int channel, int value) { (void)channel; (void)value; }
+void xmit_set_txtail(int channel, int value) { (void)channel; (void)value; }
+void xmit_set_fulldup(int channel, int value) { (void)channel; (void)value; }
+
+void kissnet_copy(unsigned char *kiss_msg, int kiss_len, int chan, int cmd, struct kissport_status_s *from_kps, int from_client)
+{
+	(void)kiss_msg;
+	(void)kiss_len;
+	(void)chan;
+	(void)cmd;
+	(void)from_kps;
+	(void)from_client;
+}
+
+static struct bench_s
+{
+	const char *name;
+	void (*run)(int arg, long iters);
+	int arg;
+} bench[] = {
+	{"dsp_convolve 41 taps", run_convolve, 41},
+	{"dsp_convolve 113 taps", run_convolve, 113},
+	{"dsp_convolve 181 taps", run_convolve, 181},
+	{"dsp_convolve4 113 taps", run_convolve4, 113},
+	{"dsp_convolve_for 113 taps", run_convolve_for, 113},
+	{"dsp_convolve4_for 113 taps", run_convolve4_for, 113},
+	{"dsp_convolve 417 taps", run_convolve, 417},
+	{"dsp_convolve_for 417 taps", run_convolve_for, 417},
+	{"fcs_calc 64 bytes", run_fcs_calc, 64},
+	{"fcs_calc 256 bytes", run_fcs_calc, 256},
+	{"crc16 64 bytes", run_crc16, 64},
+	{"fx25_tag_find_match", run_tag_find_match, 0},
+	{"DECODE_RS 255,223 0 errors", run_decode_rs, 0},
+	{"DECODE_RS 255,223 8 errors", run_decode_rs, 8},
+	{"DECODE_RS 255,223 16 errors", run_decode_rs, 16},
+	{"kiss_encapsulate", run_kiss_encapsulate, 0},
+	{"kiss_unwrap", run_kiss_unwrap, 0},
+	{"ax25_from_frame", run_ax25_from_frame, 0},
+	{"ax25_pack", run_ax25_pack, 0},
+	{"tone_gen_put_bit 48000", run_tone_gen_put_bit, 0},
+	{"tone_gen_put_bit 44100", run_tone_gen_put_bit, 2},
+};
+
+#define NUM_BENCH ((int)(sizeof(bench) / sizeof(bench[0])))
+
+static void bench_init(void);
+
+static int64_t bench_clock_ns(void);
+
+static uint64_t bench_tsc(void);
+
+static int compare_double(const void *a, const void *b);
+
+static void usage(void);
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        main
+ *
+ * Purpose:     Run the benchmarks and print the results.
+ *
+ *--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+	int reps = 101;
+	int c, b;
+	int first = 1;
+	double *ns, *ticks;
+
+	while ((c = getopt(argc, argv, "r:h")) != -1)
+	{
+		switch (c)
+		{
+		case 'r':
+			reps = atoi(optarg);
+			if (reps < 1)
+			{
+				usage();
+			}
+			break;
+		default:
+			usage();
+		}
+	}
+
+	ns = malloc(reps * sizeof(double));
+	ticks = malloc(reps * sizeof(double));
+	if (ns == NULL || ticks == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	bench_init();
+
+	printf("{\n");
+	printf("  \"version\": \"%d.%d\",\n", MAJOR_VERSION, MINOR_VERSION);
+	printf("  \"dsp_kernel\": \"%s\",\n", dsp_kernel_name());
+	printf("  \"fcs_calc\": \"%s\",\n", fcs_calc_name());
+	printf("  \"rs_simd\": %s,\n", rs_simd_supported() ? "true" : "false");
+	printf("  \"reps\": %d,\n", reps);
+	printf("  \"benchmarks\": [");
+
+	for (b = 0; b < NUM_BENCH; b++)
+	{
+		long iters = 1;
+		int64_t t;
+		int r;
+
+		if (optind < argc)
+		{
+			int k;
+
+			for (k = optind; k < argc; k++)
+			{
+				if (strstr(bench[b].name, argv[k]) != NULL)
+					break;
+			}
+			if (k == argc)
+				continue;
+		}
+
+		// Find batch size.  This is the warmup too.
+
+		do
+		{
+			iters *= 2;
+			t = bench_clock_ns();
+			bench[b].run(bench[b].arg, iters);
+			t = bench_clock_ns() - t;
+		} while (t < BATCH_NS && iters < (1L << 30));
+
+		for (r = 0; r < reps; r++)
+		{
+			uint64_t tsc = bench_tsc();
+
+			t = bench_clock_ns();
+			bench[b].run(bench[b].arg, iters);
+			t = bench_clock_ns() - t;
+			ticks[r] = (double)(bench_tsc() - tsc) / iters;
+			ns[r] = (double)t / iters;
+		}
+
+		qsort(ns, reps, sizeof(double), compare_double);
+		qsort(ticks, reps, sizeof(double), compare_double);
+
+		printf("%s\n    {\"name\": \"%s\", \"iters\": %ld, \"ns_per_op_median\": %.3f, \"ns_per_op_p99\": %.3f",
+			   first ? "" : ",", bench[b].name, iters, ns[reps / 2], ns[(reps * 99 + 99) / 100 - 1]);
+#if HAVE_TSC
+		printf(", \"cycles_per_op_median\": %.2f", ticks[reps / 2]);
+#endif
+		printf("}");
+		first = 0;
+	}
+
+	printf("\n  ]\n}\n");
+
+	exit(EXIT_SUCCESS);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        bench_init
+ *
+ * Purpose:     Set up the test data and the modules being timed.
+ *
+ * Description:	The Reed-Solomon blocks and KISS round trip are checked
+ *		here so we don't time something that isn't working.
+ *
+ *--------------------------------------------------------------------*/
+
+static void bench_init(void)
+{
+	int j, e;
+
+	dsp_kernel_init();
+	fcs_calc_init();
+	fx25_init(0);
+
+	for (j = 0; j < 4 * MAX_FILTER_SIZE; j++)
+	{
+		conv_data[j] = (float)(bench_rand() % 2000) / 1000.0f - 1.0f;
+	}
+	for (j = 0; j < MAX_FILTER_SIZE; j++)
+	{
+		conv_filter[j] = (float)(bench_rand() % 2000) / 100000.0f;
+	}
+
+	for (j = 0; j < AX25_MAX_PACKET_LEN; j++)
+	{
+		frame_data[j] = bench_rand();
+	}
+	for (j = 0; j < 4096; j++)
+	{
+		tag_bits[j] = bench_rand() & 1;
+	}
+
+	// Reed-Solomon blocks with 0, 8, and 16 errors.
+
+	struct rs *rs = fx25_get_rs(RS_CTAG);
+	int k = fx25_get_k_data_rs(RS_CTAG);
+
+	for (j = 0; j < k; j++)
+	{
+		rs_block[0][j] = bench_rand();
+	}
+	ENCODE_RS(rs, rs_block[0], rs_block[0] + k);
+	for (e = 1; e < 3; e++)
+	{
+		unsigned char work[FX25_BLOCK_SIZE];
+
+		memcpy(rs_block[e], rs_block[0], FX25_BLOCK_SIZE);
+		for (j = 0; j < e * 8; j++)
+		{
+			rs_block[e][j * 15 + 3] ^= 1 + bench_rand() % 255;
+		}
+		memcpy(work, rs_block[e], FX25_BLOCK_SIZE);
+		if (DECODE_RS(rs, work, NULL, 0) != e * 8 || memcmp(work, rs_block[0], FX25_BLOCK_SIZE) != 0)
+		{
+			printf("Reed-Solomon decode of %d errors failed.\n", e * 8);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// A typical APRS position report.
+
+	ax25_pp = ax25_from_text("WB2OSZ-15>APDW18,WIDE1-1,WIDE2-1:!4237.14NS07120.83W#PHG7140 Dire Wolf digipeater", 1);
+	if (ax25_pp == NULL)
+	{
+		printf("Could not make test packet.\n");
+		exit(EXIT_FAILURE);
+	}
+	ax25_frame_len = ax25_pack(ax25_pp, ax25_frame);
+
+	// KISS frame with type byte and a few bytes that need escaping.
+
+	kiss_raw[0] = KISS_CMD_DATA_FRAME;
+	memcpy(kiss_raw + 1, ax25_frame, ax25_frame_len);
+	kiss_raw_len = 1 + ax25_frame_len;
+	kiss_raw[10] = FEND;
+	kiss_raw[30] = FESC;
+	kiss_raw[50] = FEND;
+	kiss_enc_len = kiss_encapsulate(kiss_raw, kiss_raw_len, kiss_enc);
+	{
+		unsigned char out[2 * AX25_MAX_PACKET_LEN + 2];
+
+		if (kiss_unwrap(kiss_enc, kiss_enc_len, out) != kiss_raw_len || memcmp(out, kiss_raw, kiss_raw_len) != 0)
+		{
+			printf("KISS round trip failed.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// 1200 baud AFSK on channel 0 at 48000 and channel 2 at 44100.
+
+	for (j = 0; j < 2; j++)
+	{
+		int chan = ADEVFIRSTCHAN(j);
+
+		tone_config.adev[j].defined = 1;
+		tone_config.adev[j].num_channels = 1;
+		tone_config.adev[j].samples_per_sec = j == 0 ? 48000 : 44100;
+		tone_config.adev[j].bits_per_sample = 16;
+		tone_config.chan_medium[chan] = MEDIUM_RADIO;
+		tone_config.achan[chan].modem_type = MODEM_AFSK;
+		tone_config.achan[chan].baud = DEFAULT_BAUD;
+		tone_config.achan[chan].mark_freq = DEFAULT_MARK_FREQ;
+		tone_config.achan[chan].space_freq = DEFAULT_SPACE_FREQ;
+	}
+	gen_tone_init(&tone_config, 50);
+}
+
+static int64_t bench_clock_ns(void)
+{
+#if __WIN32__
+	LARGE_INTEGER freq, now;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return ((int64_t)(now.QuadPart / freq.QuadPart) * 1000000000 +
+			(int64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+}
+
+static uint64_t bench_tsc(void)
+{
+#if HAVE_TSC
+	return (__rdtsc());
+#else
+	return (0);
+#endif
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return ((x > y) - (x < y));
+}
+
+static void usage(void)
+{
+	printf("\n");
+	printf("bench times the functions where direwolf spends most of its CPU.\n");
+	printf("Results are written to stdout as JSON.\n");
+	printf("\n");
+	printf("usage:\n");
+	printf("\n");
+	printf("        bench  [ -r reps ]  [ name ... ]\n");
+	printf("\n");
+	printf("        -r n   Number of timed batches.  Default 101.\n");
+	printf("        name   Run only benchmarks with names containing one of these.\n");
+	printf("\n");
+	exit(EXIT_FAILURE);
+}
+
+/* end bench.c */
@@ -145,6 +145,7 @@ int main(void)
 #endif
 
 #include "cm108.h"
+#include "dwthread.h"
 
 static int cm108_write(char *name, int iomask, int iodata);
 
@@ -931,69 +932,94 @@ int cm108_set_gpio_pin(char *name, int num, int state)
 
 /*-------------------------------------------------------------------
  *
- * Name:	cm108_write
- *
- * Purpose:	Set the GPIO pins of the CM108 or similar.
- *
- * Inputs:	name		- Name of device such as /dev/hidraw2.
- *
- *		iomask		- Bit mask for I/O direction.
- *				  LSB is GPIO1, bit 1 is GPIO2, etc.
- *				  1 for output, 0 for input.
- *
- *		iodata		- Output data, same bit order as iomask.
+ * Name:	dev_find, dev_open, dev_close
  *
- * Returns:	0 for success.  -1 for error.
+ * Purpose:	Keep the devices open between writes.
  *
- * Errors:	A descriptive error message will be printed for any problem.
+ * Description:	Version 1.8.  Opening the device, and on Windows finding
+ *		it, took a few milliseconds for every change of PTT.
+ *		Now it is opened once, by ptt_init thru cm108_open_device,
+ *		and stays open.  If the adapter is unplugged, the write
+ *		fails and we try opening it again.
  *
- * Description:	This is the lowest level function.
- *		An application probably wants to use cm108_set_gpio_pin.
+ *		The table is filled in by ptt_init before anything else
+ *		runs so finding a device needs no lock.  PTT, DCD, and
+ *		CON can share one device and are set from different
+ *		threads, so each device has a lock held for the write
+ *		and for opening it again.
  *
  *------------------------------------------------------------------*/
 
-static int cm108_write(char *name, int iomask, int iodata)
-{
+#define MAX_OPEN_DEVICES 8
 
+static struct open_device_s
+{
+	char name[128];
 #if __WIN32__
+	hid_device *handle; // NULL when not open.
+#else
+	int fd; // -1 when not open.
+#endif
+	dw_mutex_t lock; // For using or reopening the handle or fd.
+} open_device[MAX_OPEN_DEVICES];
 
-	//
-	// printf ("TEMP DEBUG cm108_write:  %s %d %d\n", name, iomask, iodata);
+static int num_open_devices = 0;
+
+static struct open_device_s *dev_find(char *name)
+{
+	int i;
 
-	hid_device *handle = hid_open_path(name);
-	if (handle == NULL)
+	for (i = 0; i < num_open_devices; i++)
+	{
+		if (strcmp(open_device[i].name, name) == 0)
+		{
+			return (&open_device[i]);
+		}
+	}
+	if (num_open_devices >= MAX_OPEN_DEVICES)
 	{
 
-		printf("Could not open %s for write\n", name);
-		return (-1);
+		printf("Too many USB Audio Adapters for GPIO.  Maximum is %d.\n", MAX_OPEN_DEVICES);
+		return (NULL);
 	}
 
-	unsigned char io[5];
-	io[0] = 0;
-	io[1] = 0;
-	io[2] = iodata;
-	io[3] = iomask;
-	io[4] = 0;
+	struct open_device_s *d = &open_device[num_open_devices++];
+	snprintf(d->name, sizeof(d->name), "%s", name);
+#if __WIN32__
+	d->handle = NULL;
+#else
+	d->fd = -1;
+#endif
+	dw_mutex_init(&d->lock);
+	return (d);
+}
+
+#if !__WIN32__
+static void explain_access(char *name)
+{
+	printf("Type \"ls -l %s\" and verify that it has audio group rw similar to this:\n", name);
+	printf("    crw-rw---- 1 root audio 247, 0 Oct  6 19:24 %s\n", name);
+	printf("rather than root-only access like this:\n");
+	printf("    crw------- 1 root root 247, 0 Sep 24 09:40 %s\n", name);
+}
+#endif
 
-	int res = hid_write(handle, io, sizeof(io));
-	if (res < 0)
+static int dev_open(struct open_device_s *d)
+{
+#if __WIN32__
+
+	d->handle = hid_open_path(d->name);
+	if (d->handle == NULL)
 	{
 
-		printf("Write failed to %s\n", name);
+		printf("Could not open %s for write\n", d->name);
 		return (-1);
 	}
 
-	hid_close(handle);
-
 #else
-	int fd;
 	struct hidraw_devinfo info;
-	char io[5];
 	int n;
 
-	//
-	// printf ("TEMP DEBUG cm108_write:  %s %d %d\n", name, iomask, iodata);
-
 	/*
 	 * By default, the USB HID are accessible only by root:
 	 *
@@ -1027,39 +1053,147 @@ static int cm108_write(char *name, int iomask, int iodata)
 	 * audio group to use the USB Audio adapter for sound.
 	 */
 
-	fd = open(name, O_WRONLY);
-	if (fd == -1)
+	d->fd = open(d->name, O_WRONLY | O_CLOEXEC);
+	if (d->fd == -1)
 	{
 
-		printf("Could not open %s for write, errno=%d\n", name, errno);
+		printf("Could not open %s for write, errno=%d\n", d->name, errno);
 		if (errno == EACCES)
 		{ // 13
-			printf("Type \"ls -l %s\" and verify that it has audio group rw similar to this:\n", name);
-			printf("    crw-rw---- 1 root audio 247, 0 Oct  6 19:24 %s\n", name);
-			printf("rather than root-only access like this:\n");
-			printf("    crw------- 1 root root 247, 0 Sep 24 09:40 %s\n", name);
+			explain_access(d->name);
 		}
 		return (-1);
 	}
 
 	// Just for fun, let's get the device information.
+	// Only once now, rather than for every write.
 
-#if 1
-	n = ioctl(fd, HIDIOCGRAWINFO, &info);
+	n = ioctl(d->fd, HIDIOCGRAWINFO, &info);
 	if (n == 0)
 	{
 		if (!GOOD_DEVICE(info.vendor, info.product))
 		{
 
-			printf("ioctl HIDIOCGRAWINFO failed for %s. errno = %d.\n", name, errno);
+			printf("%s is not a supported device type.  Proceed at your own risk.  vid=%04x pid=%04x\n", d->name, info.vendor, info.product);
 		}
 	}
 	else
 	{
 
-		printf("%s is not a supported device type.  Proceed at your own risk.  vid=%04x pid=%04x\n", name, info.vendor, info.product);
+		printf("ioctl HIDIOCGRAWINFO failed for %s. errno = %d.\n", d->name, errno);
+	}
+#endif
+	return (0);
+}
+
+static void dev_close(struct open_device_s *d)
+{
+#if __WIN32__
+	if (d->handle != NULL)
+	{
+		hid_close(d->handle);
+		d->handle = NULL;
+	}
+#else
+	if (d->fd != -1)
+	{
+		close(d->fd);
+		d->fd = -1;
 	}
 #endif
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:	cm108_open_device
+ *
+ * Purpose:	Open a device ahead of time so the first PTT isn't slow.
+ *
+ * Inputs:	name		- Name of device such as /dev/hidraw2.
+ *
+ * Returns:	0 for success.  -1 for error.
+ *
+ *------------------------------------------------------------------*/
+
+int cm108_open_device(char *name)
+{
+	struct open_device_s *d = dev_find(name);
+
+	if (d == NULL)
+	{
+		return (-1);
+	}
+	dw_mutex_lock(&d->lock);
+	dev_close(d);
+	int err = dev_open(d);
+	dw_mutex_unlock(&d->lock);
+	return (err);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:	cm108_close_all
+ *
+ * Purpose:	Close the devices when we exit.
+ *
+ *------------------------------------------------------------------*/
+
+void cm108_close_all(void)
+{
+	int i;
+
+	for (i = 0; i < num_open_devices; i++)
+	{
+		dw_mutex_lock(&open_device[i].lock);
+		dev_close(&open_device[i]);
+		dw_mutex_unlock(&open_device[i].lock);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:	cm108_write
+ *
+ * Purpose:	Set the GPIO pins of the CM108 or similar.
+ *
+ * Inputs:	name		- Name of device such as /dev/hidraw2.
+ *
+ *		iomask		- Bit mask for I/O direction.
+ *				  LSB is GPIO1, bit 1 is GPIO2, etc.
+ *				  1 for output, 0 for input.
+ *
+ *		iodata		- Output data, same bit order as iomask.
+ *
+ * Returns:	0 for success.  -1 for error.
+ *
+ * Errors:	A descriptive error message will be printed for any problem.
+ *
+ * Description:	This is the lowest level function.
+ *		An application probably wants to use cm108_set_gpio_pin.
+ *
+ *		Version 1.8: The device stays open.  A failed write, e.g.
+ *		the adapter was unplugged and plugged back in, is tried
+ *		once more after opening it again.  The device lock is
+ *		held throughout so another output on the same device
+ *		can't have it closed underneath.
+ *
+ *------------------------------------------------------------------*/
+
+static int cm108_write(char *name, int iomask, int iodata)
+{
+	struct open_device_s *d;
+	unsigned char io[5];
+	int attempt;
+
+	//
+	// printf ("TEMP DEBUG cm108_write:  %s %d %d\n", name, iomask, iodata);
+
+	d = dev_find(name);
+	if (d == NULL)
+	{
+		return (-1);
+	}
+
 	// To make a long story short, I think we need 0 for the first two bytes.
 
 	io[0] = 0;
@@ -1074,31 +1208,61 @@ static int cm108_write(char *name, int iomask, int iodata)
 	// Writing 5 bytes works.
 	// I have no idea why.  From the CMedia datasheet it looks like we need 4.
 
-	n = write(fd, io, sizeof(io));
-	if (n != sizeof(io))
+	dw_mutex_lock(&d->lock);
+
+	for (attempt = 0; attempt < 2; attempt++)
 	{
-		//  Errors observed during development.
-		//  as pi		EACCES          13      /* Permission denied */
-		//  as root		EPIPE           32      /* Broken pipe - Happens if we send 4 bytes */
+#if __WIN32__
+		if (d->handle == NULL && dev_open(d) != 0)
+		{
+			break;
+		}
+
+		if (hid_write(d->handle, io, sizeof(io)) >= 0)
+		{
+			dw_mutex_unlock(&d->lock);
+			return (0);
+		}
 
-		printf("Write to %s failed, n=%d, errno=%d\n", name, n, errno);
+		if (attempt > 0)
+		{
 
-		if (errno == EACCES)
+			printf("Write failed to %s\n", name);
+		}
+#else
+		int n;
+
+		if (d->fd == -1 && dev_open(d) != 0)
 		{
-			printf("Type \"ls -l %s\" and verify that it has audio group rw similar to this:\n", name);
-			printf("    crw-rw---- 1 root audio 247, 0 Oct  6 19:24 %s\n", name);
-			printf("rather than root-only access like this:\n");
-			printf("    crw------- 1 root root 247, 0 Sep 24 09:40 %s\n", name);
+			break;
 		}
 
-		close(fd);
-		return (-1);
-	}
+		n = write(d->fd, io, sizeof(io));
+		if (n == sizeof(io))
+		{
+			dw_mutex_unlock(&d->lock);
+			return (0);
+		}
+
+		if (attempt > 0)
+		{
+			//  Errors observed during development.
+			//  as pi		EACCES          13      /* Permission denied */
+			//  as root		EPIPE           32      /* Broken pipe - Happens if we send 4 bytes */
 
-	close(fd);
+			printf("Write to %s failed, n=%d, errno=%d\n", name, n, errno);
 
+			if (errno == EACCES)
+			{
+				explain_access(name);
+			}
+		}
 #endif
-	return (0);
+		dev_close(d);
+	}
+
+	dw_mutex_unlock(&d->lock);
+	return (-1);
 
 } /* end cm108_write */
 
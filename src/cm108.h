@@ -2,4 +2,8 @@
 
 extern void cm108_find_ptt(char *output_audio_device, char *ptt_device, int ptt_device_size);
 
-extern int cm108_set_gpio_pin(char *name, int num, int state);
\ No newline at end of file
+extern int cm108_set_gpio_pin(char *name, int num, int state);
+
+extern int cm108_open_device(char *name);
+
+extern void cm108_close_all(void);
\ No newline at end of file
@@ -47,6 +47,7 @@
 #include "audio.h"
 #include "config.h"
 #include "xmit.h"
+#include "dwthread.h"
 
 #if USE_CM108 // Current Linux or Windows only
 #include "cm108.h"
@@ -399,6 +400,15 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 
 	p_audio_config->adev[0].defined = 1;
 
+	p_audio_config->rxq_max_frames = DEFAULT_RXQ_MAX_FRAMES;
+	p_audio_config->rxq_max_bytes = 0;
+	p_audio_config->rxq_drop = QDROP_OLDEST;
+	p_audio_config->rx_dedupe_sec = 0;
+	p_audio_config->rx_dedupe_size = DEFAULT_RX_DEDUPE_SIZE;
+	p_audio_config->txq_max_frames = DEFAULT_TXQ_MAX_FRAMES;
+	p_audio_config->txq_max_bytes = 0;
+	p_audio_config->txq_drop = QDROP_NEWEST;
+
 	for (channel = 0; channel < MAX_CHANS; channel++)
 	{
 		int ot, it;
@@ -418,10 +428,16 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 		p_audio_config->achan[channel].offset = 0;
 
 		p_audio_config->achan[channel].layer2_xmit = LAYER2_AX25;
+		p_audio_config->achan[channel].fx25_rec = 1;
 
 		p_audio_config->achan[channel].fix_bits = DEFAULT_FIX_BITS;
 		p_audio_config->achan[channel].sanity_test = SANITY_APRS;
 		p_audio_config->achan[channel].passall = 0;
+		p_audio_config->achan[channel].fix_max_us = 0;
+		p_audio_config->achan[channel].fix_max_percent = 0;
+		p_audio_config->achan[channel].rx_gate_ms = 0;
+		p_audio_config->achan[channel].rx_prune_frames = 0;
+		p_audio_config->achan[channel].rx_prune_probe = DEFAULT_RX_PRUNE_PROBE;
 
 		for (ot = 0; ot < NUM_OCTYPES; ot++)
 		{
@@ -448,6 +464,8 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 		p_audio_config->achan[channel].txdelay = DEFAULT_TXDELAY;
 		p_audio_config->achan[channel].txtail = DEFAULT_TXTAIL;
 		p_audio_config->achan[channel].fulldup = DEFAULT_FULLDUP;
+		p_audio_config->achan[channel].prerender = 0;
+		p_audio_config->achan[channel].pipeline = 0;
 	}
 
 	/* First channel should always be valid. */
@@ -467,6 +485,16 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 
 	p_misc_config->enable_kiss_pt = 0; /* -p option */
 	p_misc_config->kiss_copy = 0;
+	p_misc_config->kiss_max_clients = DEFAULT_NET_CLIENTS;
+	p_misc_config->kiss_out_max = DEFAULT_KISS_OUT_MAX;
+	p_misc_config->kiss_unix_chan = -1;
+	p_misc_config->kiss_shm_size = DEFAULT_KISS_SHM_SIZE;
+	p_misc_config->kiss_udp_port = 0;
+	p_misc_config->kiss_udp_chan = -1;
+	p_misc_config->kiss_udp_rx_port = 0;
+	p_misc_config->metrics_port = 0;
+	p_misc_config->kiss_out_drop = KISSOUT_DROP;
+	p_misc_config->kiss_flush_ms = 0;
 
 	strncpy(p_misc_config->kiss_serial_port, "", sizeof(p_misc_config->kiss_serial_port));
 	p_misc_config->kiss_serial_speed = 0;
@@ -747,183 +775,873 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 		}
 
 		/*
-		 * ==================== Radio channel parameters ====================
-		 */
-
-		/*
-		 * CHANNEL n		- Set channel for channel-specific commands.
+		 * APERIOD ms 		- ALSA period for current device.
+		 * APERIOD AUTO
+		 *
+		 * Version 1.8:	Normally about 10 mS.  Longer means fewer wakeups
+		 *		for each second of audio but more delay.
+		 *		AUTO starts short for input and makes it longer
+		 *		after overruns.  Output keeps the usual.
 		 */
 
-		else if (strcasecmp(t, "CHANNEL") == 0)
+		else if (strcasecmp(t, "APERIOD") == 0)
 		{
 			int n;
 			t = split(NULL, 0);
 			if (t == NULL)
 			{
 
-				printf("Line %d: Missing channel number for CHANNEL command.\n", line);
+				printf("Line %d: Missing number of milliseconds for APERIOD command.\n", line);
+				continue;
+			}
+			if (strcasecmp(t, "AUTO") == 0)
+			{
+				p_audio_config->adev[adevice].period_ms = APERIOD_AUTO;
 				continue;
 			}
 			n = atoi(t);
-			if (n >= 0 && n < MAX_CHANS)
+			if (n >= 1 && n <= 100)
+			{
+				p_audio_config->adev[adevice].period_ms = n;
+			}
+			else
 			{
 
-				channel = n;
-
-				if (p_audio_config->chan_medium[n] != MEDIUM_RADIO)
-				{
+				printf("Line %d: APERIOD must be AUTO or in range of 1 - 100 milliseconds.\n", line);
+			}
+		}
 
-					if (!p_audio_config->adev[ACHAN2ADEV(n)].defined)
-					{
+		/*
+		 * AMMAP  {on|off} 	- ALSA mmap access for current device input.
+		 *
+		 * Version 1.8:	The demodulators take samples directly from the
+		 *		buffer shared with the sound card rather than copying
+		 *		them with a read.  Ignored for other audio systems.
+		 */
 
-						printf("Line %d: Channel number %d is not valid because audio device %d is not defined.\n",
-							   line, n, ACHAN2ADEV(n));
-					}
-					else
-					{
+		else if (strcasecmp(t, "AMMAP") == 0)
+		{
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
 
-						printf("Line %d: Channel number %d is not valid because audio device %d is not in stereo.\n",
-							   line, n, ACHAN2ADEV(n));
-					}
-				}
+				printf("Line %d: Missing parameter for AMMAP command.  Expecting ON or OFF.\n", line);
+				continue;
+			}
+			if (strcasecmp(t, "ON") == 0)
+			{
+				p_audio_config->adev[adevice].mmap_in = 1;
+			}
+			else if (strcasecmp(t, "OFF") == 0)
+			{
+				p_audio_config->adev[adevice].mmap_in = 0;
 			}
 			else
 			{
 
-				printf("Line %d: Channel number must in range of 0 to %d.\n", line, MAX_CHANS - 1);
+				printf("Line %d: Expected ON or OFF for AMMAP.\n", line);
 			}
 		}
 
 		/*
-		 * MODEM	- Set modem properties for current channel.
-		 *
+		 * AINFORMAT  {S16|S24|S32|F32} - Audio input sample format for current device.
 		 *
-		 * Old style:
-		 * 	MODEM  baud [ mark  space  [A][B][C][+]  [  num-decoders spacing ] ]
+		 * Version 1.8:	SDR programs and some audio interfaces supply
+		 *		wider samples.  Take them directly rather than
+		 *		converting with another program.  Not for output.
+		 *		S16 means the usual, from ARATE / -b.
+		 */
+
+		else if (strcasecmp(t, "AINFORMAT") == 0)
+		{
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing format for AINFORMAT command.\n", line);
+				continue;
+			}
+			if (strcasecmp(t, "S16") == 0)
+			{
+				p_audio_config->adev[adevice].in_format = AUDIO_IN_FORMAT_DEFAULT;
+			}
+			else if (strcasecmp(t, "S24") == 0)
+			{
+				p_audio_config->adev[adevice].in_format = AUDIO_IN_FORMAT_S24;
+			}
+			else if (strcasecmp(t, "S32") == 0)
+			{
+				p_audio_config->adev[adevice].in_format = AUDIO_IN_FORMAT_S32;
+			}
+			else if (strcasecmp(t, "F32") == 0 || strcasecmp(t, "FLOAT") == 0)
+			{
+				p_audio_config->adev[adevice].in_format = AUDIO_IN_FORMAT_FLOAT;
+			}
+			else
+			{
+
+				printf("Line %d: AINFORMAT must be S16, S24, S32, or F32.\n", line);
+			}
+		}
+
+		/*
+		 * AINRATE n 		- Audio input samples per second for current device.
 		 *
-		 * New style, version 1.2:
-		 *	MODEM  speed [ option ] ...
+		 * Version 1.8:	SDR programs often produce rates like 96000 or
+		 *		240000.  Input at that rate is resampled to the
+		 *		ARATE rate which is used by everything else.
+		 */
+
+		else if (strcasecmp(t, "AINRATE") == 0)
+		{
+			int n;
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing audio sample rate for AINRATE command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= MIN_SAMPLES_PER_SEC && n <= MAX_IN_SAMPLES_PER_SEC)
+			{
+				p_audio_config->adev[adevice].in_samples_per_sec = n;
+			}
+			else
+			{
+
+				printf("Line %d: Use a more reasonable audio input sample rate in range of %d - %d.\n",
+					   line, MIN_SAMPLES_PER_SEC, MAX_IN_SAMPLES_PER_SEC);
+			}
+		}
+
+		/*
+		 * UDPRCVBUF bytes 	- Socket receive buffer for current device with "udp:" input.
 		 *
-		 * Options:
-		 *	mark:space	- AFSK tones.  Defaults based on speed.
-		 *	num@offset	- Multiple decoders on different frequencies.
-		 *	/9		- Divide sample rate by specified number.
-		 *	*9		- Upsample ratio for G3RUH.
-		 *	[A-Z+-]+	- Letters, plus, minus for the demodulator "profile."
+		 * Version 1.8:	The default is often too small for a high sample
+		 *		rate from an SDR and datagrams get lost when we
+		 *		fall behind for a moment.
 		 */
 
-		else if (strcasecmp(t, "MODEM") == 0)
+		else if (strcasecmp(t, "UDPRCVBUF") == 0)
 		{
 			int n;
 			t = split(NULL, 0);
 			if (t == NULL)
 			{
 
-				printf("Line %d: Missing data transmission speed for MODEM command.\n", line);
+				printf("Line %d: Missing number of bytes for UDPRCVBUF command.\n", line);
 				continue;
 			}
+			n = atoi(t);
+			if (n >= 4096 && n <= 64 * 1024 * 1024)
+			{
+				p_audio_config->adev[adevice].udp_rcvbuf = n;
+			}
+			else
+			{
+
+				printf("Line %d: UDPRCVBUF must be in range of 4096 - %d bytes.\n", line, 64 * 1024 * 1024);
+			}
+		}
+
+		/*
+		 * DEMODTHREADS n 	- Demodulator threads for each radio channel.
+		 *			  0 (default) does everything in the audio capture thread.
+		 */
+
+		else if (strcasecmp(t, "DEMODTHREADS") == 0)
+		{
+			int n;
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
 
+				printf("Line %d: Missing number for DEMODTHREADS command.\n", line);
+				continue;
+			}
 			n = atoi(t);
-			if (n >= MIN_BAUD && n <= MAX_BAUD)
+			if (n >= 0 && n <= MAX_SUBCHANS)
+			{
+				p_audio_config->demod_threads = n;
+			}
+			else
 			{
-				p_audio_config->achan[channel].baud = n;
-				if (n != 300 && n != 1200 && n != 2400 && n != 4800 && n != 9600 && n != 19200 && n != MAX_BAUD - 1 && n != MAX_BAUD - 2)
-				{
 
-					printf("Line %d: Warning: Non-standard data rate of %d bits per second.  Are you sure?\n", line, n);
-				}
+				printf("Line %d: Number of demodulator threads must be in range of 0 - %d.\n", line, MAX_SUBCHANS);
+			}
+		}
+
+		/*
+		 * RECVTHREADS ON|OFF	- Version 1.8: Process received frames from each
+		 *			  audio device in a thread of its own.
+		 *			  OFF (default) does all of them in the main thread.
+		 */
+
+		else if (strcasecmp(t, "RECVTHREADS") == 0)
+		{
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing ON or OFF for RECVTHREADS command.\n", line);
+				continue;
+			}
+			if (strcasecmp(t, "ON") == 0)
+			{
+				p_audio_config->recv_threads = 1;
+			}
+			else if (strcasecmp(t, "OFF") == 0)
+			{
+				p_audio_config->recv_threads = 0;
 			}
 			else
 			{
-				p_audio_config->achan[channel].baud = DEFAULT_BAUD;
 
-				printf("Line %d: Unreasonable data rate. Using %d bits per second.\n",
-					   line, p_audio_config->achan[channel].baud);
+				printf("Line %d: Expected ON or OFF for RECVTHREADS command, not \"%s\".\n", line, t);
 			}
+		}
 
-			/* Set defaults based on speed. */
-			/* Should be same as -B command line option in direwolf.c. */
+		/*
+		 * FIXTHREADS n 	- Background threads for the FIX_BITS attempts.
+		 *			  0 (default) does them in the demodulator thread.
+		 *			  When not 0, there is also one for FX.25 decoding.
+		 */
 
-			/* We have similar logic in direwolf.c, config.c, gen_packets.c, and atest.c, */
-			/* that need to be kept in sync.  Maybe it could be a common function someday. */
+		else if (strcasecmp(t, "FIXTHREADS") == 0)
+		{
+			int n;
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
 
-			if (p_audio_config->achan[channel].baud < 600)
+				printf("Line %d: Missing number for FIXTHREADS command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= 0 && n <= MAX_FIX_THREADS)
 			{
-				p_audio_config->achan[channel].modem_type = MODEM_AFSK;
-				p_audio_config->achan[channel].mark_freq = 1600;
-				p_audio_config->achan[channel].space_freq = 1800;
+				p_audio_config->fix_threads = n;
 			}
-			else if (p_audio_config->achan[channel].baud < 1800)
+			else
 			{
-				p_audio_config->achan[channel].modem_type = MODEM_AFSK;
-				p_audio_config->achan[channel].mark_freq = DEFAULT_MARK_FREQ;
-				p_audio_config->achan[channel].space_freq = DEFAULT_SPACE_FREQ;
+
+				printf("Line %d: Number of fix up threads must be in range of 0 - %d.\n", line, MAX_FIX_THREADS);
 			}
+		}
 
-			/* Get any options. */
+		/*
+		 * THREADPRIO  role  { FIFO | RR | OTHER }  [ priority ]
+		 * THREADCPUS  role  cpu-list
+		 *
+		 *			- Version 1.8: Scheduling for the AUDIO capture,
+		 *			  DEMOD worker, or XMIT threads.  See dwthread.c.
+		 *			  Priority is 1 - 99 for FIFO and RR.
+		 *			  cpu-list is like "2" or "0,2-3".
+		 */
+
+		else if (strcasecmp(t, "THREADPRIO") == 0 || strcasecmp(t, "THREADCPUS") == 0)
+		{
+			int cpus = strcasecmp(t, "THREADCPUS") == 0;
+			int role;
 
 			t = split(NULL, 0);
 			if (t == NULL)
 			{
-				/* all done. */
+
+				printf("Line %d: Missing thread type for %s command.\n", line, cpus ? "THREADCPUS" : "THREADPRIO");
 				continue;
 			}
+			if (strcasecmp(t, "AUDIO") == 0)
+				role = THREAD_AUDIO;
+			else if (strcasecmp(t, "DEMOD") == 0)
+				role = THREAD_DEMOD;
+			else if (strcasecmp(t, "XMIT") == 0)
+				role = THREAD_XMIT;
+			else
+			{
 
-			if (alldigits(t))
+				printf("Line %d: Thread type must be AUDIO, DEMOD, or XMIT, not \"%s\".\n", line, t);
+				continue;
+			}
+
+			struct thread_sched_s *ts = &p_audio_config->thread_sched[role];
+
+			t = split(NULL, 0);
+			if (t == NULL)
 			{
 
-				/* old style */
+				printf("Line %d: Missing %s for %s command.\n", line, cpus ? "CPU list" : "scheduling policy", cpus ? "THREADCPUS" : "THREADPRIO");
+				continue;
+			}
 
-				printf("Line %d: Old style (pre version 1.2) format will no longer be supported in next version.\n", line);
+			if (cpus)
+			{
+				uint64_t mask;
 
-				n = atoi(t);
-				/* Originally the upper limit was 3000. */
-				/* Version 1.0 increased to 5000 because someone */
-				/* wanted to use 2400/4800 Hz AFSK. */
-				/* Of course the MIC and SPKR connections won't */
-				/* have enough bandwidth so radios must be modified. */
-				if (n >= 300 && n <= 5000)
+				if (dw_thread_parse_cpus(t, &mask) == 0)
 				{
-					p_audio_config->achan[channel].mark_freq = n;
+					ts->cpus = mask;
 				}
 				else
 				{
-					p_audio_config->achan[channel].mark_freq = DEFAULT_MARK_FREQ;
 
-					printf("Line %d: Unreasonable mark tone frequency. Using %d.\n",
-						   line, p_audio_config->achan[channel].mark_freq);
+					printf("Line %d: Invalid CPU list \"%s\".  Use numbers 0 - %d like \"2\" or \"0,2-3\".\n", line, t, MAX_THREAD_CPUS - 1);
 				}
+				continue;
+			}
 
-				/* Get space frequency */
+			if (strcasecmp(t, "OTHER") == 0)
+			{
+				ts->policy = THREAD_SCHED_OTHER;
+				ts->priority = 0;
+				continue;
+			}
+			else if (strcasecmp(t, "FIFO") == 0)
+			{
+				ts->policy = THREAD_SCHED_FIFO;
+			}
+			else if (strcasecmp(t, "RR") == 0)
+			{
+				ts->policy = THREAD_SCHED_RR;
+			}
+			else
+			{
 
-				t = split(NULL, 0);
-				if (t == NULL)
-				{
+				printf("Line %d: Scheduling policy must be FIFO, RR, or OTHER, not \"%s\".\n", line, t);
+				continue;
+			}
 
-					printf("Line %d: Missing tone frequency for space.\n", line);
-					continue;
-				}
-				n = atoi(t);
-				if (n >= 300 && n <= 5000)
+			// Leave room above for the kernel's own threads.
+
+			ts->priority = 50;
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				int n = atoi(t);
+				if (n >= 1 && n <= 99)
 				{
-					p_audio_config->achan[channel].space_freq = n;
+					ts->priority = n;
 				}
 				else
 				{
-					p_audio_config->achan[channel].space_freq = DEFAULT_SPACE_FREQ;
 
-					printf("Line %d: Unreasonable space tone frequency. Using %d.\n",
-						   line, p_audio_config->achan[channel].space_freq);
+					printf("Line %d: Priority must be in range of 1 - 99.  Using %d.\n", line, ts->priority);
 				}
+			}
+		}
 
-				/* Gently guide users toward new format. */
+		/*
+		 * MLOCKALL		- Version 1.8: Lock all memory so audio
+		 *			  processing never waits for paging.
+		 */
 
-				if (p_audio_config->achan[channel].baud == 1200 &&
-					p_audio_config->achan[channel].mark_freq == 1200 &&
-					p_audio_config->achan[channel].space_freq == 2200)
-				{
+		else if (strcasecmp(t, "MLOCKALL") == 0)
+		{
+			p_audio_config->mlockall = 1;
+		}
 
-					printf("Line %d: The AFSK frequencies can be omitted when using the 1200 baud default 1200:2200.\n", line);
+		/*
+		 * LOCKSTATS		- Version 1.8: Count how often each lock is
+		 *			  taken, how often it had to wait, and for how
+		 *			  long.  Reported with METRICSPORT.
+		 */
+
+		else if (strcasecmp(t, "LOCKSTATS") == 0)
+		{
+			p_audio_config->lock_stats = 1;
+		}
+
+		/*
+		 * RXLATENCY		- Version 1.8: Measure the time from the end of
+		 *			  each received frame through decoding, picking
+		 *			  the best candidate, and the queue, until it is
+		 *			  written to KISS network clients.  Reported for
+		 *			  "kill -USR1" and when stopped.  See rxlat.c.
+		 */
+
+		else if (strcasecmp(t, "RXLATENCY") == 0)
+		{
+			p_audio_config->rx_latency = 1;
+		}
+
+		/*
+		 * CPUBUDGET  percent	- Version 1.8: Time the demodulators at startup
+		 *			  and cut them back, if necessary, so each
+		 *			  demodulator thread uses no more than this
+		 *			  percent of a CPU.  See autotune.c.
+		 */
+
+		else if (strcasecmp(t, "CPUBUDGET") == 0)
+		{
+			int n;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing percent for CPUBUDGET command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= 1 && n <= 100)
+			{
+				p_audio_config->cpu_budget = n;
+			}
+			else
+			{
+
+				printf("Line %d: Invalid percent for CPUBUDGET command.  Use 1 to 100.\n", line);
+			}
+		}
+
+		/*
+		 * SDR  input  rate  center-MHz  [ CU8 | CS16 | CF32 ]
+		 * SDRCHAN  chan  MHz
+		 *
+		 *			- Version 1.8: Split one wideband I/Q stream
+		 *			  into narrow FM channels.  See sdr.c.
+		 *			  Input is "stdin", a file or pipe name, or
+		 *			  "file:" followed by a recording.
+		 *			  Each SDRCHAN takes the place of the audio
+		 *			  device for that radio channel.
+		 */
+
+		else if (strcasecmp(t, "SDR") == 0)
+		{
+			int n;
+
+#if __WIN32__
+			printf("Line %d: SDR is only for Linux at this time.\n", line);
+			continue;
+#endif
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing input name for SDR command.\n", line);
+				continue;
+			}
+			strncpy(p_audio_config->sdr.input, t, sizeof(p_audio_config->sdr.input) - 1);
+
+			t = split(NULL, 0);
+			n = t != NULL ? atoi(t) : 0;
+			if (n < 100000 || n > 100000000)
+			{
+
+				printf("Line %d: SDR sample rate must be in range of 100000 - 100000000.\n", line);
+				p_audio_config->sdr.input[0] = '\0';
+				continue;
+			}
+			p_audio_config->sdr.rate = n;
+
+			t = split(NULL, 0);
+			if (t == NULL || atof(t) <= 0)
+			{
+
+				printf("Line %d: Missing center frequency, in MHz, for SDR command.\n", line);
+				p_audio_config->sdr.input[0] = '\0';
+				continue;
+			}
+			p_audio_config->sdr.center_hz = llround(atof(t) * 1000000.);
+
+			p_audio_config->sdr.format = SDR_FORMAT_CU8;
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				if (strcasecmp(t, "CU8") == 0)
+				{
+					p_audio_config->sdr.format = SDR_FORMAT_CU8;
+				}
+				else if (strcasecmp(t, "CS16") == 0)
+				{
+					p_audio_config->sdr.format = SDR_FORMAT_CS16;
+				}
+				else if (strcasecmp(t, "CF32") == 0)
+				{
+					p_audio_config->sdr.format = SDR_FORMAT_CF32;
+				}
+				else
+				{
+
+					printf("Line %d: SDR format must be CU8, CS16, or CF32.\n", line);
+				}
+			}
+		}
+
+		else if (strcasecmp(t, "SDRCHAN") == 0)
+		{
+			int n, a;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing channel number for SDRCHAN command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n < 0 || n >= MAX_CHANS)
+			{
+
+				printf("Line %d: Channel number must be in range of 0 to %d.\n", line, MAX_CHANS - 1);
+				continue;
+			}
+
+			t = split(NULL, 0);
+			if (t == NULL || atof(t) <= 0)
+			{
+
+				printf("Line %d: Missing frequency, in MHz, for SDRCHAN command.\n", line);
+				continue;
+			}
+			p_audio_config->sdr.chan_hz[n] = llround(atof(t) * 1000000.);
+
+			a = ACHAN2ADEV(n);
+			if (p_audio_config->adev[a].defined && strcmp(p_audio_config->adev[a].adevice_in, DEFAULT_ADEVICE) != 0 &&
+				strcasecmp(p_audio_config->adev[a].adevice_in, "sdr") != 0)
+			{
+
+				printf("Line %d: SDRCHAN %d replaces audio device %d, %s.\n", line, n, a, p_audio_config->adev[a].adevice_in);
+			}
+			p_audio_config->adev[a].defined = 1;
+			strncpy(p_audio_config->adev[a].adevice_in, "sdr", sizeof(p_audio_config->adev[a].adevice_in));
+			strncpy(p_audio_config->adev[a].adevice_out, "null", sizeof(p_audio_config->adev[a].adevice_out));
+			if (n != ADEVFIRSTCHAN(a))
+			{
+				p_audio_config->adev[a].num_channels = 2;
+			}
+			p_audio_config->chan_medium[n] = MEDIUM_RADIO;
+		}
+
+		/*
+		 * RXQUEUE frames [ bytes ] [ NEWEST | OLDEST ]
+		 * TXQUEUE frames [ bytes ] [ NEWEST | OLDEST | REJECT ]
+		 *
+		 *			- Version 1.8: Limit received frames waiting for the
+		 *			  application, or frames from client applications waiting
+		 *			  in each transmit queue.  0 for no limit.
+		 *			  When full, discard the NEWEST being added or the OLDEST
+		 *			  waiting.  REJECT is like NEWEST but also tells the KISS
+		 *			  client application.
+		 */
+
+		else if (strcasecmp(t, "RXQUEUE") == 0 || strcasecmp(t, "TXQUEUE") == 0)
+		{
+			int tx = strcasecmp(t, "TXQUEUE") == 0;
+			int max_frames, max_bytes = 0, drop = tx ? QDROP_NEWEST : QDROP_OLDEST;
+			char *cmd = tx ? "TXQUEUE" : "RXQUEUE";
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing number of frames for %s command.\n", line, cmd);
+				continue;
+			}
+			max_frames = atoi(t);
+			if (max_frames < 0)
+			{
+
+				printf("Line %d: Number of frames for %s can't be negative.\n", line, cmd);
+				continue;
+			}
+
+			while ((t = split(NULL, 0)) != NULL)
+			{
+				if (isdigit(*t))
+				{
+					max_bytes = atoi(t);
+				}
+				else if (strcasecmp(t, "NEWEST") == 0)
+				{
+					drop = QDROP_NEWEST;
+				}
+				else if (strcasecmp(t, "OLDEST") == 0)
+				{
+					drop = QDROP_OLDEST;
+				}
+				else if (tx && strcasecmp(t, "REJECT") == 0)
+				{
+					drop = QDROP_REJECT;
+				}
+				else
+				{
+
+					printf("Line %d: Unexpected \"%s\" for %s command.\n", line, t, cmd);
+				}
+			}
+
+			if (tx)
+			{
+				p_audio_config->txq_max_frames = max_frames;
+				p_audio_config->txq_max_bytes = max_bytes;
+				p_audio_config->txq_drop = drop;
+			}
+			else
+			{
+				p_audio_config->rxq_max_frames = max_frames;
+				p_audio_config->rxq_max_bytes = max_bytes;
+				p_audio_config->rxq_drop = drop;
+			}
+		}
+
+		/*
+		 * RXDEDUPE seconds [ frames ]
+		 *
+		 *			- Version 1.8: Drop a received frame if the same one was
+		 *			  heard on another channel within this many seconds.
+		 *			  For sites with several receivers hearing the same
+		 *			  stations.  The digipeaters are ignored when comparing.
+		 *			  Remember up to this many frames, default 1024.
+		 *			  0 seconds, the default, turns it off.
+		 */
+
+		else if (strcasecmp(t, "RXDEDUPE") == 0)
+		{
+			int n;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing number of seconds for RXDEDUPE command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n < 0 || n > MAX_RX_DEDUPE_SEC)
+			{
+
+				printf("Line %d: RXDEDUPE must be in range of 0 to %d seconds.\n", line, MAX_RX_DEDUPE_SEC);
+				continue;
+			}
+			p_audio_config->rx_dedupe_sec = n;
+
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				n = atoi(t);
+				if (n >= 16 && n <= 1000000)
+				{
+					p_audio_config->rx_dedupe_size = n;
+				}
+				else
+				{
+
+					printf("Line %d: Number of frames for RXDEDUPE must be in range of 16 to 1000000.\n", line);
+				}
+			}
+		}
+
+		/*
+		 * RXRAW ON|OFF		- Version 1.8: Received frames go straight to the
+		 *			  KISS clients without the monitoring display.
+		 *			  For gateways where nobody watches the output.
+		 *			  OFF (default) displays them as usual.
+		 */
+
+		else if (strcasecmp(t, "RXRAW") == 0)
+		{
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing ON or OFF for RXRAW command.\n", line);
+				continue;
+			}
+			if (strcasecmp(t, "ON") == 0)
+			{
+				p_audio_config->rx_raw = 1;
+			}
+			else if (strcasecmp(t, "OFF") == 0)
+			{
+				p_audio_config->rx_raw = 0;
+			}
+			else
+			{
+
+				printf("Line %d: Expected ON or OFF for RXRAW command, not \"%s\".\n", line, t);
+			}
+		}
+
+		/*
+		 * ==================== Radio channel parameters ====================
+		 */
+
+		/*
+		 * CHANNEL n		- Set channel for channel-specific commands.
+		 */
+
+		else if (strcasecmp(t, "CHANNEL") == 0)
+		{
+			int n;
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing channel number for CHANNEL command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= 0 && n < MAX_CHANS)
+			{
+
+				channel = n;
+
+				if (p_audio_config->chan_medium[n] != MEDIUM_RADIO)
+				{
+
+					if (!p_audio_config->adev[ACHAN2ADEV(n)].defined)
+					{
+
+						printf("Line %d: Channel number %d is not valid because audio device %d is not defined.\n",
+							   line, n, ACHAN2ADEV(n));
+					}
+					else
+					{
+
+						printf("Line %d: Channel number %d is not valid because audio device %d is not in stereo.\n",
+							   line, n, ACHAN2ADEV(n));
+					}
+				}
+			}
+			else
+			{
+
+				printf("Line %d: Channel number must in range of 0 to %d.\n", line, MAX_CHANS - 1);
+			}
+		}
+
+		/*
+		 * MODEM	- Set modem properties for current channel.
+		 *
+		 *
+		 * Old style:
+		 * 	MODEM  baud [ mark  space  [A][B][C][+]  [  num-decoders spacing ] ]
+		 *
+		 * New style, version 1.2:
+		 *	MODEM  speed [ option ] ...
+		 *
+		 * Options:
+		 *	mark:space	- AFSK tones.  Defaults based on speed.
+		 *	num@offset	- Multiple decoders on different frequencies.
+		 *	/9		- Divide sample rate by specified number.
+		 *	*9		- Upsample ratio for G3RUH.
+		 *	[A-Z+-]+	- Letters, plus, minus for the demodulator "profile."
+		 */
+
+		else if (strcasecmp(t, "MODEM") == 0)
+		{
+			int n;
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing data transmission speed for MODEM command.\n", line);
+				continue;
+			}
+
+			n = atoi(t);
+			if (n >= MIN_BAUD && n <= MAX_BAUD)
+			{
+				p_audio_config->achan[channel].baud = n;
+				if (n != 300 && n != 1200 && n != 2400 && n != 4800 && n != 9600 && n != 19200 && n != MAX_BAUD - 1 && n != MAX_BAUD - 2)
+				{
+
+					printf("Line %d: Warning: Non-standard data rate of %d bits per second.  Are you sure?\n", line, n);
+				}
+			}
+			else
+			{
+				p_audio_config->achan[channel].baud = DEFAULT_BAUD;
+
+				printf("Line %d: Unreasonable data rate. Using %d bits per second.\n",
+					   line, p_audio_config->achan[channel].baud);
+			}
+
+			/* Set defaults based on speed. */
+			/* Should be same as -B command line option in direwolf.c. */
+
+			/* We have similar logic in direwolf.c, config.c, gen_packets.c, and atest.c, */
+			/* that need to be kept in sync.  Maybe it could be a common function someday. */
+
+			if (p_audio_config->achan[channel].baud < 600)
+			{
+				p_audio_config->achan[channel].modem_type = MODEM_AFSK;
+				p_audio_config->achan[channel].mark_freq = 1600;
+				p_audio_config->achan[channel].space_freq = 1800;
+			}
+			else if (p_audio_config->achan[channel].baud < 1800)
+			{
+				p_audio_config->achan[channel].modem_type = MODEM_AFSK;
+				p_audio_config->achan[channel].mark_freq = DEFAULT_MARK_FREQ;
+				p_audio_config->achan[channel].space_freq = DEFAULT_SPACE_FREQ;
+			}
+
+			/* Get any options. */
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+				/* all done. */
+				continue;
+			}
+
+			if (alldigits(t))
+			{
+
+				/* old style */
+
+				printf("Line %d: Old style (pre version 1.2) format will no longer be supported in next version.\n", line);
+
+				n = atoi(t);
+				/* Originally the upper limit was 3000. */
+				/* Version 1.0 increased to 5000 because someone */
+				/* wanted to use 2400/4800 Hz AFSK. */
+				/* Of course the MIC and SPKR connections won't */
+				/* have enough bandwidth so radios must be modified. */
+				if (n >= 300 && n <= 5000)
+				{
+					p_audio_config->achan[channel].mark_freq = n;
+				}
+				else
+				{
+					p_audio_config->achan[channel].mark_freq = DEFAULT_MARK_FREQ;
+
+					printf("Line %d: Unreasonable mark tone frequency. Using %d.\n",
+						   line, p_audio_config->achan[channel].mark_freq);
+				}
+
+				/* Get space frequency */
+
+				t = split(NULL, 0);
+				if (t == NULL)
+				{
+
+					printf("Line %d: Missing tone frequency for space.\n", line);
+					continue;
+				}
+				n = atoi(t);
+				if (n >= 300 && n <= 5000)
+				{
+					p_audio_config->achan[channel].space_freq = n;
+				}
+				else
+				{
+					p_audio_config->achan[channel].space_freq = DEFAULT_SPACE_FREQ;
+
+					printf("Line %d: Unreasonable space tone frequency. Using %d.\n",
+						   line, p_audio_config->achan[channel].space_freq);
+				}
+
+				/* Gently guide users toward new format. */
+
+				if (p_audio_config->achan[channel].baud == 1200 &&
+					p_audio_config->achan[channel].mark_freq == 1200 &&
+					p_audio_config->achan[channel].space_freq == 2200)
+				{
+
+					printf("Line %d: The AFSK frequencies can be omitted when using the 1200 baud default 1200:2200.\n", line);
 				}
 				if (p_audio_config->achan[channel].baud == 300 &&
 					p_audio_config->achan[channel].mark_freq == 1600 &&
@@ -1189,6 +1907,136 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 			}
 		}
 
+		/*
+		 * FIX_BUDGET  ms  [ percent ]
+		 *
+		 *	- Limit the time spent on FIX_BITS attempts.
+		 *	- ms is the most for any one frame.  0 for no limit.
+		 *	- percent is the most for the channel over time.
+		 *	  When used up, only single bits are tried until it recovers.
+		 */
+
+		else if (strcasecmp(t, "FIX_BUDGET") == 0)
+		{
+			float ms;
+			int pct;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing time for FIX_BUDGET command.\n", line);
+				continue;
+			}
+			ms = atof(t);
+			if (ms >= 0 && ms <= 1000)
+			{
+				p_audio_config->achan[channel].fix_max_us = (int)(ms * 1000);
+			}
+			else
+			{
+
+				printf("Line %d: Time for FIX_BUDGET must be in range of 0 - 1000 milliseconds.\n", line);
+			}
+
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				pct = atoi(t);
+				if (pct >= 0 && pct <= 100)
+				{
+					p_audio_config->achan[channel].fix_max_percent = pct;
+				}
+				else
+				{
+
+					printf("Line %d: Percentage for FIX_BUDGET must be in range of 0 - 100.\n", line);
+				}
+			}
+		}
+
+		/*
+		 * RXGATE  [ ms | OFF ]
+		 *
+		 *	- Version 1.8: Skip the demodulators while the channel is quiet,
+		 *	  i.e. no sign of the mark and space tones, to save CPU time.
+		 *	  Keep going for ms milliseconds, default 500, after the tones go away.
+		 *	  A short recording is kept so the start of a transmission isn't lost.
+		 */
+
+		else if (strcasecmp(t, "RXGATE") == 0)
+		{
+			int ms = DEFAULT_RX_GATE_MS;
+
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				if (strcasecmp(t, "OFF") == 0)
+				{
+					ms = 0;
+				}
+				else
+				{
+					ms = atoi(t);
+					if (ms < 0 || ms > MAX_RX_GATE_MS)
+					{
+
+						printf("Line %d: Time for RXGATE must be in range of 0 - %d milliseconds.\n", line, MAX_RX_GATE_MS);
+						continue;
+					}
+				}
+			}
+			p_audio_config->achan[channel].rx_gate_ms = ms;
+		}
+
+		/*
+		 * RXPRUNE  [ frames [ probe ] | OFF ]
+		 *
+		 *	- Version 1.8: With several demodulators or slicers, e.g. "MODEM 1200 A+",
+		 *	  keep track of which ones get frames nobody else got.  After each
+		 *	  frames decoded, default 50, turn off one that got none of its own.
+		 *	  Every probe rounds, default 10, turn everything back on for a round
+		 *	  and keep whichever turn out to be needed again.
+		 */
+
+		else if (strcasecmp(t, "RXPRUNE") == 0)
+		{
+			int frames = DEFAULT_RX_PRUNE_FRAMES;
+			int probe = DEFAULT_RX_PRUNE_PROBE;
+
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				if (strcasecmp(t, "OFF") == 0)
+				{
+					frames = 0;
+				}
+				else
+				{
+					frames = atoi(t);
+					if (frames < 10 || frames > 10000)
+					{
+
+						printf("Line %d: Number of frames for RXPRUNE must be in range of 10 - 10000.\n", line);
+						continue;
+					}
+					t = split(NULL, 0);
+					if (t != NULL)
+					{
+						probe = atoi(t);
+						if (probe < 1 || probe > 1000)
+						{
+
+							printf("Line %d: Probe interval for RXPRUNE must be in range of 1 - 1000.\n", line);
+							continue;
+						}
+					}
+				}
+			}
+			p_audio_config->achan[channel].rx_prune_frames = frames;
+			p_audio_config->achan[channel].rx_prune_probe = probe;
+		}
+
 		/*
 		 * PTT 		- Push To Talk signal line.
 		 * DCD		- Data Carrier Detect indicator.
@@ -1196,6 +2044,7 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 		 *
 		 * xxx  serial-port [-]rts-or-dtr [ [-]rts-or-dtr ]
 		 * xxx  GPIO  [-]gpio-num
+		 * xxx  GPIOD  chip  [-]line-num
 		 * xxx  LPT  [-]bit-num
 		 * PTT  RIG  model  port [ rate ]
 		 * PTT  RIG  AUTO  port [ rate ]
@@ -1266,6 +2115,44 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 					p_audio_config->achan[channel].octrl[ot].ptt_invert = 0;
 				}
 				p_audio_config->achan[channel].octrl[ot].ptt_method = PTT_METHOD_GPIO;
+#endif
+			}
+			else if (strcasecmp(t, "GPIOD") == 0)
+			{
+
+				/* Version 1.8: GPIO character device, e.g. gpiochip0 or /dev/gpiochip0, Linux only. */
+
+#ifdef USE_GPIOD
+				t = split(NULL, 0);
+				if (t == NULL)
+				{
+
+					printf("Config file line %d: Missing GPIO chip name for %s.\n", line, otname);
+					continue;
+				}
+				snprintf(p_audio_config->achan[channel].octrl[ot].ptt_device, sizeof(p_audio_config->achan[channel].octrl[ot].ptt_device), "%s", t);
+
+				t = split(NULL, 0);
+				if (t == NULL)
+				{
+
+					printf("Config file line %d: Missing GPIO line number for %s.\n", line, otname);
+					continue;
+				}
+
+				if (*t == '-')
+				{
+					p_audio_config->achan[channel].octrl[ot].out_gpio_num = atoi(t + 1);
+					p_audio_config->achan[channel].octrl[ot].ptt_invert = 1;
+				}
+				else
+				{
+					p_audio_config->achan[channel].octrl[ot].out_gpio_num = atoi(t);
+					p_audio_config->achan[channel].octrl[ot].ptt_invert = 0;
+				}
+				p_audio_config->achan[channel].octrl[ot].ptt_method = PTT_METHOD_GPIOD;
+#else
+				printf("Config file line %d: %s with GPIOD is only available on Linux with the GPIO character device.\n", line, otname);
 #endif
 			}
 			else if (strcasecmp(t, "LPT") == 0)
@@ -1727,74 +2614,174 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 				printf("Line %d: Missing time for TXDELAY command.\n", line);
 				continue;
 			}
-			n = atoi(t);
-			if (n >= 0 && n <= 255)
+			n = atoi(t);
+			if (n >= 0 && n <= 255)
+			{
+				p_audio_config->achan[channel].txdelay = n;
+			}
+			else
+			{
+				p_audio_config->achan[channel].txdelay = DEFAULT_TXDELAY;
+
+				printf("Line %d: Invalid time for transmit delay. Using %d.\n",
+					   line, p_audio_config->achan[channel].txdelay);
+			}
+		}
+
+		/*
+		 * TXTAIL n		- For transmit timing. n = 10 mS units.
+		 */
+
+		else if (strcasecmp(t, "TXTAIL") == 0)
+		{
+			int n;
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing time for TXTAIL command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= 0 && n <= 255)
+			{
+				p_audio_config->achan[channel].txtail = n;
+			}
+			else
+			{
+				p_audio_config->achan[channel].txtail = DEFAULT_TXTAIL;
+
+				printf("Line %d: Invalid time for transmit timing. Using %d.\n",
+					   line, p_audio_config->achan[channel].txtail);
+			}
+		}
+
+		/*
+		 * FULLDUP  {on|off} 		- Full Duplex
+		 */
+		else if (strcasecmp(t, "FULLDUP") == 0)
+		{
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing parameter for FULLDUP command.  Expecting ON or OFF.\n", line);
+				continue;
+			}
+			if (strcasecmp(t, "ON") == 0)
+			{
+				p_audio_config->achan[channel].fulldup = 1;
+			}
+			else if (strcasecmp(t, "OFF") == 0)
+			{
+				p_audio_config->achan[channel].fulldup = 0;
+			}
+			else
+			{
+				p_audio_config->achan[channel].fulldup = 0;
+
+				printf("Line %d: Expected ON or OFF for FULLDUP.\n", line);
+			}
+		}
+
+		/*
+		 * TXPRERENDER  {on|off} 	- Generate the whole transmission before PTT.
+		 *
+		 * Version 1.8:	The audio for preamble, frames, and postamble goes
+		 *		into memory first and then to the device all at once.
+		 *		A busy CPU can't cause an underrun in the middle of a
+		 *		transmission.  Costs a little delay before keying up.
+		 */
+		else if (strcasecmp(t, "TXPRERENDER") == 0)
+		{
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing parameter for TXPRERENDER command.  Expecting ON or OFF.\n", line);
+				continue;
+			}
+			if (strcasecmp(t, "ON") == 0)
+			{
+				p_audio_config->achan[channel].prerender = 1;
+			}
+			else if (strcasecmp(t, "OFF") == 0)
 			{
-				p_audio_config->achan[channel].txdelay = n;
+				p_audio_config->achan[channel].prerender = 0;
 			}
 			else
 			{
-				p_audio_config->achan[channel].txdelay = DEFAULT_TXDELAY;
+				p_audio_config->achan[channel].prerender = 0;
 
-				printf("Line %d: Invalid time for transmit delay. Using %d.\n",
-					   line, p_audio_config->achan[channel].txdelay);
+				printf("Line %d: Expected ON or OFF for TXPRERENDER.\n", line);
 			}
 		}
 
 		/*
-		 * TXTAIL n		- For transmit timing. n = 10 mS units.
+		 * TXPIPELINE  {on|off} 	- Generate audio ahead while sending.
+		 *
+		 * Version 1.8:	A separate thread writes the audio to the device so
+		 *		the next bundled frame is generated while the previous
+		 *		one is being sent.  Unlike TXPRERENDER, the transmitter
+		 *		is turned on right away.  Ignored if TXPRERENDER is on.
 		 */
-
-		else if (strcasecmp(t, "TXTAIL") == 0)
+		else if (strcasecmp(t, "TXPIPELINE") == 0)
 		{
-			int n;
+
 			t = split(NULL, 0);
 			if (t == NULL)
 			{
 
-				printf("Line %d: Missing time for TXTAIL command.\n", line);
+				printf("Line %d: Missing parameter for TXPIPELINE command.  Expecting ON or OFF.\n", line);
 				continue;
 			}
-			n = atoi(t);
-			if (n >= 0 && n <= 255)
+			if (strcasecmp(t, "ON") == 0)
 			{
-				p_audio_config->achan[channel].txtail = n;
+				p_audio_config->achan[channel].pipeline = 1;
+			}
+			else if (strcasecmp(t, "OFF") == 0)
+			{
+				p_audio_config->achan[channel].pipeline = 0;
 			}
 			else
 			{
-				p_audio_config->achan[channel].txtail = DEFAULT_TXTAIL;
+				p_audio_config->achan[channel].pipeline = 0;
 
-				printf("Line %d: Invalid time for transmit timing. Using %d.\n",
-					   line, p_audio_config->achan[channel].txtail);
+				printf("Line %d: Expected ON or OFF for TXPIPELINE.\n", line);
 			}
 		}
 
 		/*
-		 * FULLDUP  {on|off} 		- Full Duplex
+		 * FX25RX ON|OFF	- Listen for FX.25.  Default on.
+		 *			  Version 1.8: Can be turned off to save the
+		 *			  correlation tag search on every bit.
 		 */
-		else if (strcasecmp(t, "FULLDUP") == 0)
-		{
 
+		else if (strcasecmp(t, "FX25RX") == 0)
+		{
 			t = split(NULL, 0);
 			if (t == NULL)
 			{
 
-				printf("Line %d: Missing parameter for FULLDUP command.  Expecting ON or OFF.\n", line);
+				printf("Line %d: Missing parameter for FX25RX command.  Expecting ON or OFF.\n", line);
 				continue;
 			}
+
 			if (strcasecmp(t, "ON") == 0)
 			{
-				p_audio_config->achan[channel].fulldup = 1;
+				p_audio_config->achan[channel].fx25_rec = 1;
 			}
 			else if (strcasecmp(t, "OFF") == 0)
 			{
-				p_audio_config->achan[channel].fulldup = 0;
+				p_audio_config->achan[channel].fx25_rec = 0;
 			}
 			else
 			{
-				p_audio_config->achan[channel].fulldup = 0;
+				p_audio_config->achan[channel].fx25_rec = 1;
 
-				printf("Line %d: Expected ON or OFF for FULLDUP.\n", line);
+				printf("Line %d: Expected ON or OFF for FX25RX.\n", line);
 			}
 		}
 
@@ -2011,6 +2998,309 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 			p_misc_config->kiss_copy = 1;
 		}
 
+		/*
+		 * KISSFLUSH ms		- Version 1.8: Hold received frames for network
+		 *			  KISS clients for about this many milliseconds
+		 *			  so a burst goes out in fewer, larger, writes.
+		 *			  Default 0 sends as soon as the frames that
+		 *			  arrived together have been processed.
+		 */
+
+		else if (strcasecmp(t, "KISSFLUSH") == 0)
+		{
+			int n;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing number of milliseconds for KISSFLUSH command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= 0 && n <= 1000)
+			{
+				p_misc_config->kiss_flush_ms = n;
+			}
+			else
+			{
+
+				printf("Line %d: KISSFLUSH must be in range of 0 to 1000 milliseconds.\n", line);
+			}
+		}
+
+		/*
+		 * KISSUNIX path [ chan ]
+		 *
+		 *			- Version 1.8: KISS for client applications on the
+		 *			  same host over a Unix domain socket rather than
+		 *			  TCP loopback.  The optional channel works like
+		 *			  KISSPORT.
+		 */
+
+		else if (strcasecmp(t, "KISSUNIX") == 0)
+		{
+			int n;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing socket path for KISSUNIX command.\n", line);
+				continue;
+			}
+#if __WIN32__
+			printf("Line %d: KISSUNIX is not available for Windows.\n", line);
+			continue;
+#endif
+			if (strlen(t) >= sizeof(p_misc_config->kiss_unix_path))
+			{
+
+				printf("Line %d: Socket path for KISSUNIX is too long.\n", line);
+				continue;
+			}
+			strncpy(p_misc_config->kiss_unix_path, t, sizeof(p_misc_config->kiss_unix_path) - 1);
+
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				n = atoi(t);
+				if (n < 0 || n >= MAX_CHANS)
+				{
+
+					printf("Line %d: Invalid channel %d for KISSUNIX command.  Must be in range 0 thru %d.\n", line, n, MAX_CHANS - 1);
+					continue;
+				}
+				p_misc_config->kiss_unix_chan = n;
+			}
+		}
+
+		/*
+		 * KISSSHM path [ bytes ]
+		 *
+		 *			- Version 1.8: Put received frames in a ring buffer
+		 *			  in this file, usually under /dev/shm, for
+		 *			  applications on the same host to map.
+		 *			  The size is rounded up to a power of 2.
+		 */
+
+		else if (strcasecmp(t, "KISSSHM") == 0)
+		{
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing file name for KISSSHM command.\n", line);
+				continue;
+			}
+			strncpy(p_misc_config->kiss_shm_path, t, sizeof(p_misc_config->kiss_shm_path) - 1);
+
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				int n = atoi(t);
+				if (n < MIN_KISS_SHM_SIZE || n > 256 * 1024 * 1024)
+				{
+
+					printf("Line %d: KISSSHM size must be in range of %d to %d bytes.\n", line, MIN_KISS_SHM_SIZE, 256 * 1024 * 1024);
+					continue;
+				}
+				p_misc_config->kiss_shm_size = n;
+			}
+		}
+
+		/*
+		 * KISSUDP address port [ chan ]
+		 *
+		 *			- Version 1.8: Send each received frame as a KISS
+		 *			  frame in a single UDP datagram.  The address can
+		 *			  be unicast, broadcast, or multicast.
+		 *			  The optional channel works like KISSPORT.
+		 */
+
+		else if (strcasecmp(t, "KISSUDP") == 0)
+		{
+			int n;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing address for KISSUDP command.\n", line);
+				continue;
+			}
+			strncpy(p_misc_config->kiss_udp_addr, t, sizeof(p_misc_config->kiss_udp_addr) - 1);
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing UDP port number for KISSUDP command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= MIN_IP_PORT_NUMBER && n <= MAX_IP_PORT_NUMBER)
+			{
+				p_misc_config->kiss_udp_port = n;
+			}
+			else
+			{
+
+				printf("Line %d: Invalid UDP port number for KISSUDP command.\n", line);
+				printf("Use something in the range of %d to %d.\n", MIN_IP_PORT_NUMBER, MAX_IP_PORT_NUMBER);
+				continue;
+			}
+
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				n = atoi(t);
+				if (n < 0 || n >= MAX_CHANS)
+				{
+
+					printf("Line %d: Invalid channel %d for KISSUDP command.  Must be in range 0 thru %d.\n", line, n, MAX_CHANS - 1);
+					continue;
+				}
+				p_misc_config->kiss_udp_chan = n;
+			}
+		}
+
+		/*
+		 * KISSUDPRX port	- Version 1.8: Accept KISS frames to transmit,
+		 *			  one per UDP datagram, on this port.
+		 */
+
+		else if (strcasecmp(t, "KISSUDPRX") == 0)
+		{
+			int n;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing UDP port number for KISSUDPRX command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= MIN_IP_PORT_NUMBER && n <= MAX_IP_PORT_NUMBER)
+			{
+				p_misc_config->kiss_udp_rx_port = n;
+			}
+			else
+			{
+
+				printf("Line %d: Invalid UDP port number for KISSUDPRX command.\n", line);
+				printf("Use something in the range of %d to %d.\n", MIN_IP_PORT_NUMBER, MAX_IP_PORT_NUMBER);
+			}
+		}
+
+		/*
+		 * METRICSPORT port	- Version 1.8: Answer HTTP requests for /metrics
+		 *			  in Prometheus text format on this TCP port.
+		 */
+
+		else if (strcasecmp(t, "METRICSPORT") == 0)
+		{
+			int n;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing TCP port number for METRICSPORT command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= MIN_IP_PORT_NUMBER && n <= MAX_IP_PORT_NUMBER)
+			{
+				p_misc_config->metrics_port = n;
+			}
+			else
+			{
+
+				printf("Line %d: Invalid TCP port number for METRICSPORT command.\n", line);
+				printf("Use something in the range of %d to %d.\n", MIN_IP_PORT_NUMBER, MAX_IP_PORT_NUMBER);
+			}
+		}
+
+		/*
+		 * KISSCLIENTS n	- Version 1.8: Most client applications at the same
+		 *			  time on each KISS TCP port.  Default 3.
+		 */
+
+		else if (strcasecmp(t, "KISSCLIENTS") == 0)
+		{
+			int n;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing number for KISSCLIENTS command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n >= 1 && n <= MAX_NET_CLIENTS)
+			{
+				p_misc_config->kiss_max_clients = n;
+			}
+			else
+			{
+
+				printf("Line %d: KISSCLIENTS must be in range of 1 to %d.\n", line, MAX_NET_CLIENTS);
+			}
+		}
+
+		/*
+		 * KISSOUTPUT bytes [ DROP | DISCONNECT ]
+		 *
+		 *			- Version 1.8: Most bytes waiting to be sent to a
+		 *			  network KISS client that is slow to read.
+		 *			  Beyond that, DROP new frames for it until it
+		 *			  catches up, or DISCONNECT it.
+		 *			  Also the size for the pseudo terminal, which
+		 *			  always drops the oldest frames instead.
+		 */
+
+		else if (strcasecmp(t, "KISSOUTPUT") == 0)
+		{
+			int n;
+
+			t = split(NULL, 0);
+			if (t == NULL)
+			{
+
+				printf("Line %d: Missing number of bytes for KISSOUTPUT command.\n", line);
+				continue;
+			}
+			n = atoi(t);
+			if (n < MIN_KISS_OUT_MAX)
+			{
+
+				printf("Line %d: KISSOUTPUT must be at least %d bytes.\n", line, MIN_KISS_OUT_MAX);
+				n = MIN_KISS_OUT_MAX;
+			}
+			p_misc_config->kiss_out_max = n;
+
+			t = split(NULL, 0);
+			if (t != NULL)
+			{
+				if (strcasecmp(t, "DROP") == 0)
+				{
+					p_misc_config->kiss_out_drop = KISSOUT_DROP;
+				}
+				else if (strcasecmp(t, "DISCONNECT") == 0)
+				{
+					p_misc_config->kiss_out_drop = KISSOUT_DISCONNECT;
+				}
+				else
+				{
+
+					printf("Line %d: Expected DROP or DISCONNECT for KISSOUTPUT command, not \"%s\".\n", line, t);
+				}
+			}
+		}
+
 		/*
 		 * Invalid command.
 		 */
@@ -2022,6 +3312,20 @@ void config_init(char *fname, struct audio_s *p_audio_config,
 	}
 
 	fclose(fp);
+
+	/*
+	 * Version 1.8: KISS has only 4 bits for the channel.
+	 */
+
+	for (int ch = MAX_KISS_CHANS; ch < MAX_CHANS; ch++)
+	{
+		if (p_audio_config->chan_medium[ch] == MEDIUM_RADIO)
+		{
+
+			printf("Warning: Radio channel %d can't be carried in the KISS channel field.\n", ch);
+			printf("Its frames only go to a KISSPORT or UDP port configured for that one channel.\n");
+		}
+	}
 } /* end config_init */
 
 /* end config.c */
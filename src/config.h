@@ -50,6 +50,30 @@ struct misc_config_s
 	int kiss_chan[MAX_KISS_TCP_PORTS]; /* Radio Channel number for this port or -1 for all.  */
 
 	int kiss_copy;		/* Data from network KISS client is copied to all others. */
+
+	int kiss_max_clients; /* Version 1.8: Most client applications at the same time on each KISS TCP port. */
+
+	int kiss_out_max;  /* Version 1.8: Most bytes waiting to be sent to a slow KISS TCP client. */
+	int kiss_out_drop; /* What to do when that is exceeded.  KISSOUT_DROP the frame */
+					   /* or KISSOUT_DISCONNECT the client. */
+
+	int kiss_flush_ms; /* Version 1.8: Hold received frames for KISS network clients */
+					   /* this long to send more at once.  0 to send each */
+					   /* batch from the received frame queue right away. */
+	char kiss_unix_path[108]; /* Version 1.8: Unix domain socket for KISS clients on the */
+							  /* same host.  Empty if not used.  Not for Windows. */
+	int kiss_unix_chan;		  /* Radio channel for it or -1 for all. */
+
+	char kiss_shm_path[80]; /* Version 1.8: File for shared memory ring of received */
+	int kiss_shm_size;		/* frames and size of its data area. */
+
+	char kiss_udp_addr[80]; /* Version 1.8: Send received frames as KISS over UDP to this */
+	int kiss_udp_port;	/* address and port.  Port 0 if not used. */
+	int kiss_udp_chan;	/* Radio channel for KISS over UDP or -1 for all. */
+	int kiss_udp_rx_port; /* UDP port to accept KISS frames for transmit.  0 if not used. */
+
+	int metrics_port; /* Version 1.8: TCP port for HTTP requests of /metrics.  0 if not used. */
+
 	int enable_kiss_pt; /* Enable pseudo terminal for KISS. */
 						/* Want this to be off by default because it hangs */
 						/* after a while if nothing is reading from other end. */
@@ -78,6 +102,18 @@ struct misc_config_s
 
 #define DEFAULT_KISS_PORT 8001 /* Above plus 1. */
 
+#define DEFAULT_NET_CLIENTS 3	/* Client applications on each KISS TCP port. */
+#define MAX_NET_CLIENTS 1000	/* Most allowed by KISSCLIENTS. */
+
+#define DEFAULT_KISS_OUT_MAX (16 * 1024)
+#define MIN_KISS_OUT_MAX (4 * 1024) /* Room for largest encoded frame. */
+
+#define KISSOUT_DROP 0
+#define KISSOUT_DISCONNECT 1
+
+#define DEFAULT_KISS_SHM_SIZE (1024 * 1024)
+#define MIN_KISS_SHM_SIZE (64 * 1024) /* Must be a power of 2. */
+
 #define DEFAULT_NULLMODEM "COM3" /* should be equiv. to /dev/ttyS2 on Cygwin */
 
 extern void config_init(char *fname, struct audio_s *p_modem,
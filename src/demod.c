@@ -25,7 +25,8 @@
  *
  * Input:	Audio samples from either a file or the "sound card."
  *
- * Outputs:	Calls hdlc_rec_bit() for each bit demodulated.
+ * Outputs:	Calls hdlc_rec_bit() for each bit demodulated, or hdlc_rec_bits()
+ *		for a group of them with multiple slicers.
  *
  *---------------------------------------------------------------*/
 
@@ -46,17 +47,67 @@
 #include "fsk_gen_filter.h"
 #include "hdlc_rec.h"
 #include "demod_afsk.h"
+#include "dsp.h"
+#include "dsp_kernel.h"
 
 // Properties of the radio channels.
 
 static struct audio_s *save_audio_config_p;
 
 // Current state of all the decoders.
+// Version 1.8: Allocated in demod_init, [num_subchan] for each radio
+// channel, rather than the worst case for every possible channel.
 
-static struct demodulator_state_s demodulator_state[MAX_CHANS][MAX_SUBCHANS];
+static struct demodulator_state_s *demodulator_state[MAX_CHANS];
 
-static int sample_sum[MAX_CHANS][MAX_SUBCHANS];
-static int sample_count[MAX_CHANS][MAX_SUBCHANS];
+/*
+ * Optional reduction of the AFSK sample rate, the "-D" command line option
+ * or "/n" on the MODEM configuration line.
+ *
+ * Originally we simply averaged each group of n samples.  That is cheap but a
+ * poor low pass filter so higher frequency noise was folded back into the
+ * range of interest.  Now we use a proper FIR anti-aliasing filter but only
+ * calculate every n'th output, the only ones used.  That is the same amount
+ * of work as the polyphase form and much less than running the demodulator
+ * at the original rate.
+ *
+ * Every subchannel gets the same input so the filter runs once for the
+ * channel.  demod_decimate_block fills decim_out before the subchannels
+ * get the block, even with DEMODTHREADS, and they all read it.  For one
+ * sample at a time, subchannel 0 does it and the others pick up the result.
+ */
+
+#define DECIM_TAPS_PER_PHASE 12 // Filter length is this times the decimation factor, plus one.
+
+static const float *decim_filter[MAX_CHANS]; /* Shared, see dsp_cached_lowpass. */
+static int decim_filter_taps[MAX_CHANS];
+
+static delay_line_t decim_in[MAX_CHANS]; /* Filter history. */
+static int sample_count[MAX_CHANS];
+
+static float *decim_out[MAX_CHANS]; /* [DEMOD_BLOCK_MAX] when decimating, else NULL. */
+static int decim_nout[MAX_CHANS];	/* Number in decim_out. */
+
+static int decim_ready[MAX_CHANS]; /* For demod_process_sample. */
+static int decim_sample[MAX_CHANS];
+
+static void decimator_init(int chan, int decimate);
+
+/*
+ * Subchannels of a channel all see the same audio.  When several of them have
+ * identical prefilters, e.g. "MODEM 1200 AA", only the first one, the "owner,"
+ * actually runs it.  The others pick up its output for the same block.
+ * This relies on multi_modem_process_block feeding the subchannels in order.
+ * With DEMODTHREADS, only subchannels in the same group can share because
+ * the groups run at the same time in different threads.
+ */
+
+static int prefilter_owner[MAX_CHANS][MAX_SUBCHANS];
+static float (*prefilter_out[MAX_CHANS])[DEMOD_BLOCK_MAX]; /* [num_subchan] */
+
+static void prefilter_share_init(int chan);
+
+static void envelope_init(struct demodulator_state_s *D);
 
 /*------------------------------------------------------------------
  *
@@ -97,6 +148,14 @@ int demod_init(struct audio_s *pa)
 			int num_letters;
 			int have_plus;
 
+			/*
+			 * The number of demodulators isn't known until we get
+			 * thru the switch below.  Start with the most possible
+			 * and keep only those used afterward.
+			 */
+
+			demodulator_state[chan] = dsp_aligned_alloc(MAX_SUBCHANS * sizeof(struct demodulator_state_s));
+
 			/*
 			 * These are derived from config file parameters.
 			 *
@@ -288,6 +347,8 @@ int demod_init(struct audio_s *pa)
 					}
 				}
 
+				decimator_init(chan, save_audio_config_p->achan[chan].decimate);
+
 				printf("Channel %d: %d baud, AFSK %d & %d Hz, %s, %d sample rate",
 					   chan, save_audio_config_p->achan[chan].baud,
 					   save_audio_config_p->achan[chan].mark_freq, save_audio_config_p->achan[chan].space_freq,
@@ -368,11 +429,7 @@ int demod_init(struct audio_s *pa)
 							D->num_slicers = MAX_SLICERS;
 						}
 
-						/* For signal level reporting, we want a longer term view. */
-						// TODO: Should probably move this into the init functions.
-
-						D->quick_attack = D->agc_fast_attack * 0.2f;
-						D->sluggish_decay = D->agc_slow_decay * 0.2f;
+						envelope_init(D);
 					}
 				}
 				else if (have_plus)
@@ -429,10 +486,7 @@ int demod_init(struct audio_s *pa)
 						D->num_slicers = MAX_SLICERS;
 					}
 
-					/* For signal level reporting, we want a longer term view. */
-
-					D->quick_attack = D->agc_fast_attack * 0.2f;
-					D->sluggish_decay = D->agc_slow_decay * 0.2f;
+					envelope_init(D);
 				}
 				else
 				{
@@ -487,13 +541,12 @@ int demod_init(struct audio_s *pa)
 							D->num_slicers = MAX_SLICERS;
 						}
 
-						/* For signal level reporting, we want a longer term view. */
-
-						D->quick_attack = D->agc_fast_attack * 0.2f;
-						D->sluggish_decay = D->agc_slow_decay * 0.2f;
+						envelope_init(D);
 
 					} /* for each freq pair */
 				}
+
+				prefilter_share_init(chan);
 				break;
 
 			default: /* Not AFSK */
@@ -638,15 +691,26 @@ int demod_init(struct audio_s *pa)
 					D->num_slicers = MAX_SLICERS;
 				}
 
-				/* For signal level reporting, we want a longer term view. */
-
-				D->quick_attack = D->agc_fast_attack * 0.2f;
-				D->sluggish_decay = D->agc_slow_decay * 0.2f;
+				envelope_init(D);
 			}
 			break;
 
 			} /* switch on modulation type. */
 
+			int n = save_audio_config_p->achan[chan].num_subchan;
+			struct demodulator_state_s *keep = dsp_aligned_alloc(n * sizeof(struct demodulator_state_s));
+
+			assert(n >= 1 && n <= MAX_SUBCHANS);
+			memcpy(keep, demodulator_state[chan], n * sizeof(struct demodulator_state_s));
+			for (int d = 0; d < n; d++)
+			{
+				keep[d].active_slicers = (1u << (keep[d].num_slicers > 1 ? keep[d].num_slicers : 1)) - 1;
+			}
+			dsp_aligned_free(demodulator_state[chan]);
+			demodulator_state[chan] = keep;
+
+			prefilter_out[chan] = dsp_aligned_alloc(n * sizeof(*prefilter_out[chan]));
+
 		} /* if channel medium is radio */
 
 		// FIXME printf ("-------- end of loop for chn %d \n", chan);
@@ -665,6 +729,173 @@ int demod_init(struct audio_s *pa)
 
 } /* end demod_init */
 
+/*------------------------------------------------------------------
+ *
+ * Name:        demod_subchan_group
+ *
+ * Purpose:     Which group of demodulators a subchannel belongs to.
+ *
+ * Inputs:	chan	- Radio channel.
+ *		subchan	- Demodulator number within the channel.
+ *
+ * Returns:     0 thru number of groups - 1.
+ *
+ * Description:	With DEMODTHREADS n greater than 1, the subchannels of
+ *		a channel are split into min(n, num_subchan) contiguous
+ *		groups, each run by its own thread.  Otherwise everything
+ *		is in group 0.
+ *
+ *----------------------------------------------------------------*/
+
+int demod_subchan_num_groups(int chan)
+{
+	int n = save_audio_config_p->demod_threads;
+	int num_subchan = save_audio_config_p->achan[chan].num_subchan;
+
+	if (n <= 1 || num_subchan <= 1)
+		return (1);
+	return (n < num_subchan ? n : num_subchan);
+}
+
+int demod_subchan_group(int chan, int subchan)
+{
+	int groups = demod_subchan_num_groups(chan);
+
+	return (subchan * groups / save_audio_config_p->achan[chan].num_subchan);
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        envelope_init
+ *
+ * Purpose:     Attack and decay for each of the envelope trackers.
+ *
+ * Inputs:	D	- Demodulator, after the agc_fast_attack and
+ *			  agc_slow_decay have been set up.
+ *
+ * Description:	For signal level reporting, we want a longer term view.
+ *		See env_track in demod_afsk.c for the others.
+ *
+ *----------------------------------------------------------------*/
+
+static void envelope_init(struct demodulator_state_s *D)
+{
+	D->quick_attack = D->agc_fast_attack * 0.2f;
+	D->sluggish_decay = D->agc_slow_decay * 0.2f;
+
+	for (int k = 0; k < ENV_LANES; k++)
+	{
+		D->env_attack[k] = k <= ENV_S_VALLEY ? D->agc_fast_attack : k <= ENV_SPACE_LEVEL ? D->quick_attack : 0.0f;
+		D->env_decay[k] = k <= ENV_S_VALLEY ? D->agc_slow_decay : k <= ENV_SPACE_LEVEL ? D->sluggish_decay : 0.0f;
+	}
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        prefilter_share_init
+ *
+ * Purpose:     Find subchannels which can share the same prefilter output.
+ *
+ * Inputs:	chan	- Audio channel, after its demodulators have been set up.
+ *
+ * Outputs:	prefilter_owner[chan][] - For each subchannel, the lowest numbered
+ *			subchannel with exactly the same prefilter.  That is
+ *			itself if there is no other match.
+ *
+ *----------------------------------------------------------------*/
+
+static void prefilter_share_init(int chan)
+{
+	int d, e;
+	int shared = 0;
+
+	for (d = 0; d < MAX_SUBCHANS; d++)
+	{
+		prefilter_owner[chan][d] = d;
+	}
+
+	for (d = 1; d < save_audio_config_p->achan[chan].num_subchan; d++)
+	{
+		struct demodulator_state_s *D = &demodulator_state[chan][d];
+
+		if (!D->use_prefilter || D->profile == 'F') // "F" has its own fixed point version.
+			continue;
+
+		for (e = 0; e < d; e++)
+		{
+			struct demodulator_state_s *E = &demodulator_state[chan][e];
+
+			if (demod_subchan_group(chan, e) != demod_subchan_group(chan, d))
+				continue;
+
+			if (prefilter_owner[chan][e] == e && E->use_prefilter && E->profile != 'F' &&
+				E->pre_filter_taps == D->pre_filter_taps && E->pre_filter == D->pre_filter)
+			{
+				prefilter_owner[chan][d] = e;
+				shared++;
+				break;
+			}
+		}
+	}
+
+	if (shared > 0)
+	{
+		printf("        %d subchannel%s of channel %d share a prefilter with another.\n", shared, shared == 1 ? "" : "s", chan);
+	}
+
+} /* end prefilter_share_init */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        decimator_init
+ *
+ * Purpose:     Set up the anti-aliasing filter used for reducing
+ *		the AFSK demodulator sample rate.
+ *
+ * Inputs:      chan		- Radio channel.
+ *		decimate	- Keep one out of this many samples.
+ *				  1 means no change.
+ *
+ * Description:	Cutoff is a little below half of the reduced sample rate.
+ *		Anything above the original 1/2 rate, which would fold back
+ *		into the range we care about, is attenuated.
+ *
+ *----------------------------------------------------------------*/
+
+static void decimator_init(int chan, int decimate)
+{
+	assert(chan >= 0 && chan < MAX_CHANS);
+
+	decim_filter_taps[chan] = 0;
+	if (decimate <= 1)
+	{
+		return;
+	}
+
+	decim_filter_taps[chan] = (DECIM_TAPS_PER_PHASE * decimate) | 1;
+	if (decim_filter_taps[chan] > MAX_FILTER_SIZE)
+	{
+		decim_filter_taps[chan] = (MAX_FILTER_SIZE - 1) | 1;
+	}
+
+	decim_filter[chan] = dsp_cached_lowpass(0.4f / decimate, decim_filter_taps[chan], BP_WINDOW_BLACKMAN);
+
+	if (decim_out[chan] == NULL)
+	{
+		decim_out[chan] = dsp_aligned_alloc(DEMOD_BLOCK_MAX * sizeof(float));
+	}
+
+	if (decim_in[chan].buf != NULL)
+	{
+		delay_line_free(&decim_in[chan]);
+	}
+	delay_line_init(&decim_in[chan], decim_filter_taps[chan]);
+	sample_count[chan] = 0;
+	decim_nout[chan] = 0;
+	decim_ready[chan] = 0;
+
+} /* end decimator_init */
+
 /*------------------------------------------------------------------
  *
  * Name:        demod_get_sample
@@ -781,6 +1012,63 @@ void demod_mute_input(int chan, int mute_during_xmit)
 	mute_input[chan] = mute_during_xmit;
 }
 
+__attribute__((hot)) __attribute__((always_inline)) static inline void track_rec_level(struct demodulator_state_s *D, float fsam)
+{
+	if (fsam >= D->alevel_rec_peak)
+	{
+		D->alevel_rec_peak = fsam * D->quick_attack + D->alevel_rec_peak * (1.0f - D->quick_attack);
+	}
+	else
+	{
+		D->alevel_rec_peak = fsam * D->sluggish_decay + D->alevel_rec_peak * (1.0f - D->sluggish_decay);
+	}
+
+	if (fsam <= D->alevel_rec_valley)
+	{
+		D->alevel_rec_valley = fsam * D->quick_attack + D->alevel_rec_valley * (1.0f - D->quick_attack);
+	}
+	else
+	{
+		D->alevel_rec_valley = fsam * D->sluggish_decay + D->alevel_rec_valley * (1.0f - D->sluggish_decay);
+	}
+}
+
+/*
+ * Version 1.8: Publish the audio level for demod_get_audio_level.
+ * Only from the thread running the demodulator.
+ */
+
+static void publish_audio_level(int chan, struct demodulator_state_s *D)
+{
+	int rec, mark, space;
+
+	// Take half of peak-to-peak for received audio level.
+
+	rec = (int)((D->alevel_rec_peak - D->alevel_rec_valley) * 50.0f + 0.5f);
+
+	if (save_audio_config_p->achan[chan].modem_type == MODEM_AFSK)
+	{
+
+		/* For AFSK, we have mark and space amplitudes. */
+
+		mark = (int)((D->env[ENV_MARK_LEVEL]) * 100.0f + 0.5f);
+		space = (int)((D->env[ENV_SPACE_LEVEL]) * 100.0f + 0.5f);
+	}
+	else
+	{
+		/* Display the + and - peaks.  */
+		/* Normally we'd expect them to be about the same. */
+		/* However, with SDR, or other DC coupling, we could have an offset. */
+
+		mark = (int)((D->env[ENV_MARK_LEVEL]) * 200.0f + 0.5f);
+		space = (int)((D->env[ENV_SPACE_LEVEL]) * 200.0f - 0.5f);
+	}
+
+	__atomic_store_n(&D->alevel_snap_rec, rec, __ATOMIC_RELAXED);
+	__atomic_store_n(&D->alevel_snap_mark, mark, __ATOMIC_RELAXED);
+	__atomic_store_n(&D->alevel_snap_space, space, __ATOMIC_RELAXED);
+}
+
 __attribute__((hot)) void demod_process_sample(int chan, int subchan, int sam)
 {
 	float fsam;
@@ -813,23 +1101,7 @@ __attribute__((hot)) void demod_process_sample(int chan, int subchan, int sam)
 	 * range idea of the received audio.
 	 */
 
-	if (fsam >= D->alevel_rec_peak)
-	{
-		D->alevel_rec_peak = fsam * D->quick_attack + D->alevel_rec_peak * (1.0f - D->quick_attack);
-	}
-	else
-	{
-		D->alevel_rec_peak = fsam * D->sluggish_decay + D->alevel_rec_peak * (1.0f - D->sluggish_decay);
-	}
-
-	if (fsam <= D->alevel_rec_valley)
-	{
-		D->alevel_rec_valley = fsam * D->quick_attack + D->alevel_rec_valley * (1.0f - D->quick_attack);
-	}
-	else
-	{
-		D->alevel_rec_valley = fsam * D->sluggish_decay + D->alevel_rec_valley * (1.0f - D->sluggish_decay);
-	}
+	track_rec_level(D, fsam);
 
 	/*
 	 * Select decoder based on modulation type.
@@ -842,16 +1114,28 @@ __attribute__((hot)) void demod_process_sample(int chan, int subchan, int sam)
 		break;
 
 	case MODEM_AFSK:
-		if (save_audio_config_p->achan[chan].decimate > 1)
+		if (save_audio_config_p->achan[chan].decimate > 1 && subchan == 0)
 		{
+			// For all the subchannels, even if this one is turned off.
 
-			sample_sum[chan][subchan] += sam;
-			sample_count[chan][subchan]++;
-			if (sample_count[chan][subchan] >= save_audio_config_p->achan[chan].decimate)
+			delay_line_push(&decim_in[chan], (float)sam);
+			decim_ready[chan] = ++sample_count[chan] >= save_audio_config_p->achan[chan].decimate;
+			if (decim_ready[chan])
 			{
-				demod_afsk_process_sample(chan, subchan, sample_sum[chan][subchan] / save_audio_config_p->achan[chan].decimate, D);
-				sample_sum[chan][subchan] = 0;
-				sample_count[chan][subchan] = 0;
+				float fout = dsp_convolve(delay_line_window(&decim_in[chan]), decim_filter[chan], decim_filter_taps[chan]);
+				decim_sample[chan] = (int)lrintf(fout);
+				sample_count[chan] = 0;
+			}
+		}
+		if (D->active_slicers == 0)
+		{
+			break;
+		}
+		if (save_audio_config_p->achan[chan].decimate > 1)
+		{
+			if (decim_ready[chan])
+			{
+				demod_afsk_process_sample(chan, subchan, decim_sample[chan], D);
 			}
 		}
 		else
@@ -864,10 +1148,224 @@ __attribute__((hot)) void demod_process_sample(int chan, int subchan, int sam)
 		break;
 
 	} /* switch modem_type */
+
+	publish_audio_level(chan, D);
+	demod_afsk_flush(chan, subchan, D);
+	hdlc_rec_flush(chan, subchan);
 	return;
 
 } /* end demod_process_sample */
 
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        demod_decimate_block
+ *
+ * Purpose:     Reduce the sample rate of a block, once for all the
+ *		subchannels of the channel.
+ *
+ * Inputs:	chan	- Audio channel.
+ *		samples	- Audio samples, oldest first.
+ *		n	- Number of samples, up to DEMOD_BLOCK_MAX.
+ *
+ * Description:	Call before demod_process_block for any subchannel of
+ *		the same block.  Nothing happens if the channel is not
+ *		AFSK with decimation.
+ *
+ *--------------------------------------------------------------------*/
+
+__attribute__((hot)) void demod_decimate_block(int chan, const int16_t *samples, int n)
+{
+	int decimate = save_audio_config_p->achan[chan].decimate;
+	int mute = mute_input[chan];
+	int i;
+
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(n >= 0 && n <= DEMOD_BLOCK_MAX);
+
+	if (decimate <= 1 || save_audio_config_p->achan[chan].modem_type != MODEM_AFSK)
+	{
+		return;
+	}
+
+	decim_nout[chan] = 0;
+	for (i = 0; i < n; i++)
+	{
+		delay_line_push(&decim_in[chan], mute ? 0.0f : (float)samples[i]);
+		if (++sample_count[chan] >= decimate)
+		{
+			float fout = dsp_convolve(delay_line_window(&decim_in[chan]), decim_filter[chan], decim_filter_taps[chan]);
+			decim_out[chan][decim_nout[chan]++] = (float)lrintf(fout);
+			sample_count[chan] = 0;
+		}
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        demod_process_block
+ *
+ * Purpose:     Same as demod_process_sample for a block of samples.
+ *
+ * Inputs:	chan	- Audio channel.  0 for left, 1 for right.
+ *		subchan - modem of the channel.
+ *		samples	- Audio samples, oldest first.
+ *		n	- Number of samples, up to DEMOD_BLOCK_MAX.
+ *
+ * Description:	The checks, muting, and modem type are handled once per
+ *		block, then the demodulator runs over the whole block in
+ *		one call.  Decimation was already done for the channel
+ *		by demod_decimate_block.
+ *
+ *--------------------------------------------------------------------*/
+
+__attribute__((hot)) void demod_process_block(int chan, int subchan, const int16_t *samples, int n)
+{
+	struct demodulator_state_s *D;
+	float buf[DEMOD_BLOCK_MAX];
+	int i;
+
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+
+	D = &demodulator_state[chan][subchan];
+
+	int mute = mute_input[chan];
+	int decimate = save_audio_config_p->achan[chan].decimate;
+
+	assert(n >= 0 && n <= DEMOD_BLOCK_MAX);
+
+	for (i = 0; i < n; i++)
+	{
+		buf[i] = mute ? 0.0f : (float)samples[i];
+		track_rec_level(D, buf[i] * (1.0f / 16384.0f));
+	}
+
+	switch (save_audio_config_p->achan[chan].modem_type)
+	{
+
+	case MODEM_OFF:
+		break;
+
+	case MODEM_AFSK:
+	{
+		int nout = n;
+
+		if (decimate > 1)
+		{
+			// Already filtered for the channel by demod_decimate_block.
+
+			nout = decim_nout[chan];
+			memcpy(buf, decim_out[chan], nout * sizeof(float));
+		}
+
+		// Version 1.8: Turned off by RXPRUNE.  Still make the shared prefilter
+		// output if another subchannel uses it.
+
+		if (D->active_slicers == 0)
+		{
+			if (D->use_prefilter && D->profile != 'F' && prefilter_owner[chan][subchan] == subchan)
+			{
+				for (i = 0; i < nout; i++)
+				{
+					buf[i] *= (1.0f / 16384.0f);
+				}
+				demod_afsk_prefilter_block(D, buf, prefilter_out[chan][subchan], nout);
+			}
+			break;
+		}
+
+		if (D->profile == 'F')
+		{
+			// Fixed point.  Back to integers.
+			// Often these are just the original samples.
+
+			int16_t ibuf[DEMOD_BLOCK_MAX];
+			for (i = 0; i < nout; i++)
+			{
+				ibuf[i] = buf[i] > 32767.0f ? 32767 : buf[i] < -32768.0f ? -32768 : (int16_t)buf[i];
+			}
+			demod_afsk_process_block_fixed(chan, subchan, ibuf, nout, D);
+			break;
+		}
+
+		for (i = 0; i < nout; i++)
+		{
+			buf[i] *= (1.0f / 16384.0f);
+		}
+
+		if (D->use_prefilter)
+		{
+			int owner = prefilter_owner[chan][subchan];
+
+			if (owner == subchan)
+			{
+				demod_afsk_prefilter_block(D, buf, prefilter_out[chan][subchan], nout);
+			}
+			demod_afsk_process_block(chan, subchan, prefilter_out[chan][owner], nout, D);
+		}
+		else
+		{
+			demod_afsk_process_block(chan, subchan, buf, nout, D);
+		}
+	}
+	break;
+
+	default:
+		break;
+
+	} /* switch modem_type */
+
+	publish_audio_level(chan, D);
+	demod_afsk_flush(chan, subchan, D);
+	hdlc_rec_flush(chan, subchan);
+
+} /* end demod_process_block */
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        demod_set_active
+ *
+ * Purpose:     Turn a demodulator, or some of its slicers, off or on.
+ *
+ * Inputs:	chan	- Audio channel.
+ *		subchan - Modem of the channel.
+ *		slicers	- Bit mask of slicers to run.  0 to skip the
+ *			  demodulator entirely.
+ *
+ * Description:	Called from multi_modem.c for RXPRUNE, between blocks,
+ *		from the thread feeding the channel.
+ *
+ *		A slicer turned off stops getting its DPLL checked so
+ *		clear its DCD here, and let demod_afsk_flush pass it along.  Otherwise the channel could look
+ *		busy forever.  The HDLC decoder resynchronizes on the
+ *		next flag when it is turned back on.
+ *
+ *--------------------------------------------------------------------*/
+
+void demod_set_active(int chan, int subchan, unsigned int slicers)
+{
+	struct demodulator_state_s *D;
+	int slice;
+
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+
+	D = &demodulator_state[chan][subchan];
+
+	for (slice = 0; slice < MAX_SLICERS; slice++)
+	{
+		if ((slicers & (1u << slice)) == 0)
+		{
+			D->slicer[slice].data_detect = 0;
+		}
+	}
+	demod_afsk_flush(chan, subchan, D);
+
+	D->active_slicers = slicers;
+
+} /* end demod_set_active */
+
 /* Doesn't seem right.  Need to revisit this. */
 /* Resulting scale is 0 to almost 100. */
 /* Cranking up the input level produces no more than 97 or 98. */
@@ -881,6 +1379,12 @@ alevel_t demod_get_audio_level(int chan, int subchan)
 	assert(chan >= 0 && chan < MAX_CHANS);
 	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
 
+	if (demodulator_state[chan] == NULL || subchan >= save_audio_config_p->achan[chan].num_subchan)
+	{
+		memset(&alevel, 0, sizeof(alevel));
+		return (alevel);
+	}
+
 	/* We have to consider two different cases here. */
 	/* N demodulators, each with own slicer and HDLC decoder. */
 	/* Single demodulator, multiple slicers each with own HDLC decoder. */
@@ -892,40 +1396,13 @@ alevel_t demod_get_audio_level(int chan, int subchan)
 
 	D = &demodulator_state[chan][subchan];
 
-	// Take half of peak-to-peak for received audio level.
-
-	alevel.rec = (int)((D->alevel_rec_peak - D->alevel_rec_valley) * 50.0f + 0.5f);
-
-	if (save_audio_config_p->achan[chan].modem_type == MODEM_AFSK)
-	{
-
-		/* For AFSK, we have mark and space amplitudes. */
-
-		alevel.mark = (int)((D->alevel_mark_peak) * 100.0f + 0.5f);
-		alevel.space = (int)((D->alevel_space_peak) * 100.0f + 0.5f);
-	}
-
-	else
-	{
-
-#if 1
-		/* Display the + and - peaks.  */
-		/* Normally we'd expect them to be about the same. */
-		/* However, with SDR, or other DC coupling, we could have an offset. */
-
-		alevel.mark = (int)((D->alevel_mark_peak) * 200.0f + 0.5f);
-		alevel.space = (int)((D->alevel_space_peak) * 200.0f - 0.5f);
+	// Version 1.8: This can be another DEMODTHREADS group than the one
+	// running the demodulator so use what it published after its last block.
 
-#else
-		/* Here we have + and - peaks after filtering. */
-		/* Take half of the peak to peak. */
-		/* The "5/6" factor worked out right for the current low pass filter. */
-		/* Will it need to be different if the filter is tweaked? */
+	alevel.rec = __atomic_load_n(&D->alevel_snap_rec, __ATOMIC_RELAXED);
+	alevel.mark = __atomic_load_n(&D->alevel_snap_mark, __ATOMIC_RELAXED);
+	alevel.space = __atomic_load_n(&D->alevel_snap_space, __ATOMIC_RELAXED);
 
-		alevel.mark = (int)((D->alevel_mark_peak - D->alevel_space_peak) * 100.0f * 5.0f / 6.0f + 0.5f);
-		alevel.space = -1; /* to print one number inside of ( ) */
-#endif
-	}
 	return (alevel);
 }
 
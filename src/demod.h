@@ -2,6 +2,8 @@
 
 /* demod.h */
 
+#include <stdint.h>   /* for int16_t */
+
 #include "audio.h"    /* for struct audio_s */
 #include "ax25_pad.h" /* for alevel_t */
 
@@ -13,6 +15,18 @@ int demod_get_sample(int a);
 
 void demod_process_sample(int chan, int subchan, int sam);
 
+#define DEMOD_BLOCK_MAX 256 /* Most samples for one call to demod_process_block. */
+
+void demod_decimate_block(int chan, const int16_t *samples, int n);
+
+void demod_process_block(int chan, int subchan, const int16_t *samples, int n);
+
+void demod_set_active(int chan, int subchan, unsigned int slicers);
+
+int demod_subchan_num_groups(int chan);
+
+int demod_subchan_group(int chan, int subchan);
+
 void demod_print_agc(int chan, int subchan);
 
 alevel_t demod_get_audio_level(int chan, int subchan);
@@ -25,7 +25,8 @@
  *
  * Input:	Audio samples from either a file or the "sound card."
  *
- * Outputs:	Calls hdlc_rec_bit() for each bit demodulated.
+ * Outputs:	Calls hdlc_rec_bit() for each bit demodulated, or hdlc_rec_bits()
+ *		for a group of them with multiple slicers.
  *
  *---------------------------------------------------------------*/
 
@@ -46,6 +47,7 @@
 #include "hdlc_rec.h"
 #include "demod_afsk.h"
 #include "dsp.h"
+#include "dsp_kernel.h"
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -66,8 +68,16 @@ static float fcos256_table[256];
 #define fcos256(x) (fcos256_table[((x) >> 24) & 0xff])
 #define fsin256(x) (fcos256_table[(((x) >> 24) - 64) & 0xff])
 
+// Same scaled by 32767 for profile "F".
+static int16_t icos256_table[256];
+
+#define icos256(x) (icos256_table[((x) >> 24) & 0xff])
+#define isin256(x) (icos256_table[(((x) >> 24) - 64) & 0xff])
+
 static void nudge_pll(int chan, int subchan, int slice, float demod_out, struct demodulator_state_s *D, float amplitude);
 
+static void slicer_bank(int chan, int subchan, const float *demod_out, struct demodulator_state_s *D);
+
 /* Quick approximation to sqrt(x*x + y*y) */
 /* No benefit for regular PC. */
 /* Might help with microcomputer platform??? */
@@ -77,29 +87,65 @@ __attribute__((hot)) __attribute__((always_inline)) static inline float fast_hyp
 	return (hypotf(x, y));
 }
 
-/* Add sample to buffer and shift the rest down. */
+/*
+ * FIR filter kernel.  Best version for this CPU is picked by dsp_kernel_init.
+ * Version 1.8: Each filter has its own, possibly built for its size.
+ */
 
-__attribute__((hot)) __attribute__((always_inline)) static inline void push_sample(float val, float *buff, int size)
+__attribute__((hot)) __attribute__((always_inline)) static inline float convolve(dsp_convolve_fn_t fn, const float *__restrict__ data, const float *__restrict__ filter, int filter_taps)
 {
-	memmove(buff + 1, buff, (size - 1) * sizeof(float));
-	buff[0] = val;
+	return (fn(data, filter, filter_taps));
 }
 
-/* FIR filter kernel. */
+/*
+ * Fixed point versions for profile "F".
+ *
+ * Taps come from gen_q15 which keeps the sum of products within 32 bits.
+ * The compiler can vectorize the simple loop for SSE2 or NEON.
+ * ARMv6 has no NEON but it can do two 16 bit multiplies and adds at once.
+ */
 
-__attribute__((hot)) __attribute__((always_inline)) static inline float convolve(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps)
+__attribute__((hot)) __attribute__((always_inline)) static inline int32_t convolve_q15(const int16_t *__restrict__ data, const int16_t *__restrict__ filter, int filter_taps)
 {
-	float sum = 0.0f;
-	int j;
+	int32_t sum = 0;
+	int j = 0;
 
-	for (j = 0; j < filter_taps; j++)
+#if __ARM_FEATURE_SIMD32 && !__ARM_NEON && defined(__GNUC__)
+	// Older compilers don't have the ACLE __smlad intrinsic.
+	for (; j + 2 <= filter_taps; j += 2)
 	{
-		sum += filter[j] * data[j];
+		int32_t d, f;
+		memcpy(&d, data + j, sizeof(d)); // Might not be aligned.
+		memcpy(&f, filter + j, sizeof(f));
+		__asm__("smlad %0, %1, %2, %0" : "+r"(sum) : "r"(d), "r"(f));
+	}
+#endif
+	for (; j < filter_taps; j++)
+	{
+		sum += (int32_t)filter[j] * data[j];
 	}
-
 	return (sum);
 }
 
+__attribute__((always_inline)) static inline int16_t sat16(int32_t x)
+{
+	return (x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+}
+
+/* Magnitude without square root.  Alpha max plus beta min, within about 3%. */
+
+__attribute__((hot)) __attribute__((always_inline)) static inline int32_t fixed_hypot(int32_t x, int32_t y)
+{
+	x = x < 0 ? -x : x;
+	y = y < 0 ? -y : y;
+
+	int32_t hi = MAX(x, y);
+	int32_t lo = MIN(x, y);
+	int32_t a = hi - (hi >> 3) + (lo >> 1);
+
+	return (MAX(hi, a));
+}
+
 // Automatic Gain control - used when we have a single slicer.
 //
 // The first step is to create an envelope for the peak and valley
@@ -110,43 +156,56 @@ __attribute__((hot)) __attribute__((always_inline)) static inline float convolve
 // We use an IIR filter with fast attack and slow decay which only considers the past.
 // Perhaps an improvement could be obtained by looking in the future as well.
 //
+// Version 1.8: The envelopes are updated by env_track, below, along with
+// the display levels.  This is what is left, scaling by them.
+//
 
 // Result should settle down to 1 unit peak to peak.  i.e. -0.5 to +0.5
 
-__attribute__((hot)) __attribute__((always_inline)) static inline float agc(float in, float fast_attack, float slow_decay, float *ppeak, float *pvalley)
+__attribute__((hot)) __attribute__((always_inline)) static inline float agc(float in, float peak, float valley)
 {
-	if (in >= *ppeak)
-	{
-		*ppeak = in * fast_attack + *ppeak * (1.0f - fast_attack);
-	}
-	else
-	{
-		*ppeak = in * slow_decay + *ppeak * (1.0f - slow_decay);
-	}
+	float x = fmaxf(fminf(in, peak), valley); // experiment: clip to envelope?
+	float range = peak - valley;
 
-	if (in <= *pvalley)
-	{
-		*pvalley = in * fast_attack + *pvalley * (1.0f - fast_attack);
-	}
-	else
-	{
-		*pvalley = in * slow_decay + *pvalley * (1.0f - slow_decay);
-	}
+	return (range > 0.0f ? (x - 0.5f * (peak + valley)) / range : 0.0f);
+}
+
+// Integer version of the above for profile "F".
+// Envelopes have FIXED_AGC_FRAC fraction bits so the slow decay doesn't stall.
+// Division is slow, or not even available in hardware, for the processors
+// where this would be used so the result is left as a fraction:
+//
+//	normalized = *pnum / *pden	where *pden is 0 if no signal.
+//
+// *pnum is twice what the float version calculates so *pden is the full range.
 
-	float x = in;
+#define FIXED_AGC_FRAC 12
+
+__attribute__((hot)) __attribute__((always_inline)) static inline void agc_fixed(int32_t amp, int32_t fast_attack, int32_t slow_decay, int32_t *ppeak, int32_t *pvalley, int32_t *pnum, int32_t *pden)
+{
+	int32_t in = amp << FIXED_AGC_FRAC;
+
+	*ppeak += (int32_t)(((int64_t)(in - *ppeak) * (in >= *ppeak ? fast_attack : slow_decay)) >> 24);
+	*pvalley += (int32_t)(((int64_t)(in - *pvalley) * (in <= *pvalley ? fast_attack : slow_decay)) >> 24);
+
+	int32_t x = in;
 
 	if (x > *ppeak)
-		x = *ppeak; // experiment: clip to envelope?
+		x = *ppeak;
 
 	if (x < *pvalley)
 		x = *pvalley;
 
 	if (*ppeak > *pvalley)
 	{
-		return ((x - 0.5f * (*ppeak + *pvalley)) / (*ppeak - *pvalley));
+		*pnum = (x - *pvalley) - (*ppeak - x);
+		*pden = *ppeak - *pvalley;
+	}
+	else
+	{
+		*pnum = 0;
+		*pden = 0;
 	}
-
-	return (0.0f);
 }
 
 // K6JQ  pointed me to this wonderful article:
@@ -179,7 +238,9 @@ __attribute__((hot)) __attribute__((always_inline)) static inline float agc(floa
 #define MIN_G 0.5f
 #define MAX_G 4.0f
 
-/* TODO: static */ float space_gain[MAX_SUBCHANS];
+/* TODO: static */ float space_gain[SLICER_BANK_SIZE]; // Extra entries, beyond MAX_SLICERS, left at 0.
+
+static int32_t space_gain_q12[SLICER_BANK_SIZE]; // Same scaled by 4096 for profile "F".
 
 /*------------------------------------------------------------------
  *
@@ -213,6 +274,7 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 	for (j = 0; j < 256; j++)
 	{
 		fcos256_table[j] = cosf((float)j * 2.0f * (float)M_PI / 256.0f);
+		icos256_table[j] = (int16_t)lrintf(32767.0f * fcos256_table[j]);
 	}
 
 	memset(D, 0, sizeof(struct demodulator_state_s));
@@ -229,8 +291,9 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 
 	case 'A': // Official name
 	case 'E': // For compatibility during transition
+	case 'F': // Same as A with integer arithmetic.
 
-		D->profile = 'A';
+		D->profile = (profile == 'F') ? 'F' : 'A';
 
 		/* New in version 1.7 */
 		/* This is a simpler version of what has been used all along. */
@@ -291,6 +354,49 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 		D->pll_searching_inertia = 0.50;
 		break;
 
+	case 'G': // Sliding DFT.
+
+		// For very low power processors.  Instead of long FIR filters,
+		// mix with local oscillators, as in 'A', and simply add up the
+		// last symbol's worth (or so) of mixer outputs.  That is the DFT
+		// of the most recent audio at the mark and space frequencies.
+		// No prefilter.  That would cost more than everything else.
+
+		D->use_prefilter = 0;
+
+		D->afsk.m_osc_phase = 0;
+		D->afsk.m_osc_delta = round(pow(2., 32.) * (double)mark_freq / (double)samples_per_sec);
+
+		D->afsk.s_osc_phase = 0;
+		D->afsk.s_osc_delta = round(pow(2., 32.) * (double)space_freq / (double)samples_per_sec);
+
+		// A window of exactly one symbol would be the matched filter but
+		// a little longer works better.  It narrows the bins, cutting
+		// down on noise and on the other tone leaking in.  Beyond
+		// about 1.5 symbols, intersymbol interference takes over.
+
+		D->sdft.width_sym = 1.40;
+		TUNE("TUNE_SDFT_WIDTH_SYM", D->sdft.width_sym, "sdft_width_sym", "%.2f")
+
+		D->sdft.window = (int)round(D->sdft.width_sym * (double)samples_per_sec / (double)baud);
+		TUNE("TUNE_SDFT_WINDOW", D->sdft.window, "sdft_window", "%d")
+
+		if (D->sdft.window < 2 || D->sdft.window > MAX_FILTER_SIZE)
+		{
+			printf("Calculated sliding DFT window of %d samples is out of range.\n", D->sdft.window);
+			printf("Decrease the audio sample rate or increase the decimation factor.\n");
+			D->sdft.window = D->sdft.window < 2 ? 2 : MAX_FILTER_SIZE;
+		}
+
+		D->sdft.scale = 1.0f / D->sdft.window;
+
+		D->agc_fast_attack = 0.70;
+		D->agc_slow_decay = 0.000090;
+
+		D->pll_locked_inertia = 0.74;
+		D->pll_searching_inertia = 0.50;
+		break;
+
 	case 'B': // official name
 	case 'D': // backward compatibility
 
@@ -356,8 +462,8 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 		D->pll_locked_inertia = 0.74;
 		D->pll_searching_inertia = 0.50;
 
-		D->alevel_mark_peak = -1; // Disable received signal (m/s) display.
-		D->alevel_space_peak = -1;
+		D->env[ENV_MARK_LEVEL] = -1; // Disable received signal (m/s) display.
+		D->env[ENV_SPACE_LEVEL] = -1;
 		break;
 
 	default:
@@ -425,7 +531,7 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 		f1 = f1 / (float)samples_per_sec;
 		f2 = f2 / (float)samples_per_sec;
 
-		gen_bandpass(f1, f2, D->pre_filter, D->pre_filter_taps, D->pre_window);
+		D->pre_filter = dsp_cached_bandpass(f1, f2, D->pre_filter_taps, D->pre_window);
 	}
 
 	/*
@@ -435,7 +541,13 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 	 * In both cases, lp_filter and lp_filter_taps are used but the
 	 * contents will be generated differently.  Later code does not care.
 	 */
-	if (D->afsk.use_rrc)
+	if (D->profile == 'G')
+	{
+		// No low pass filter.  The sliding DFT takes its place.
+
+		D->lp_filter_taps = 0;
+	}
+	else if (D->afsk.use_rrc)
 	{
 
 		assert(D->afsk.rrc_width_sym >= 1 && D->afsk.rrc_width_sym <= 16);
@@ -455,7 +567,7 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 		}
 
 		assert(D->lp_filter_taps > 8 && D->lp_filter_taps <= MAX_FILTER_SIZE);
-		(void)gen_rrc_lowpass(D->lp_filter, D->lp_filter_taps, D->afsk.rrc_rolloff, (float)samples_per_sec / baud);
+		D->lp_filter = dsp_cached_rrc_lowpass(D->lp_filter_taps, D->afsk.rrc_rolloff, (float)samples_per_sec / baud);
 	}
 	else
 	{
@@ -474,7 +586,36 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 		assert(D->lp_filter_taps > 8 && D->lp_filter_taps <= MAX_FILTER_SIZE);
 
 		float fc = baud * D->lpf_baud / (float)samples_per_sec;
-		gen_lowpass(fc, D->lp_filter, D->lp_filter_taps, D->lp_window);
+		D->lp_filter = dsp_cached_lowpass(fc, D->lp_filter_taps, D->lp_window);
+	}
+
+	/*
+	 * Delay lines must match the filter lengths.
+	 * Version 1.8: So do the kernels, which might be built for that size.
+	 * Delay lines are allocated only for the profile in use.
+	 */
+	if (D->use_prefilter && D->profile != 'F')
+	{
+		delay_line_init(&D->raw_cb, D->pre_filter_taps);
+		D->pre_convolve = dsp_convolve_for(D->pre_filter_taps);
+	}
+	if (D->lp_filter_taps > 0)
+	{
+		if (D->profile == 'A')
+		{
+			delay_line4_init(&D->afsk.ms_IQ_raw, D->lp_filter_taps);
+		}
+		else if (D->profile == 'B')
+		{
+			delay_line_init(&D->afsk.c_I_raw, D->lp_filter_taps);
+			delay_line_init(&D->afsk.c_Q_raw, D->lp_filter_taps);
+		}
+		D->lp_convolve = dsp_convolve_for(D->lp_filter_taps);
+		D->lp_convolve4 = dsp_convolve4_for(D->lp_filter_taps);
+	}
+	if (D->profile == 'G')
+	{
+		D->sdft.ring = dsp_aligned_alloc(D->sdft.window * sizeof(D->sdft.ring[0]));
 	}
 
 	/*
@@ -487,6 +628,36 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 	{
 		space_gain[j] = space_gain[j - 1] * step;
 	}
+	for (j = 0; j < SLICER_BANK_SIZE; j++)
+	{
+		space_gain_q12[j] = lrintf(space_gain[j] * 4096.0f);
+	}
+
+	/*
+	 * Integer copies of everything for profile "F".
+	 */
+	if (D->profile == 'F')
+	{
+		int16_t *q15;
+
+		if (D->use_prefilter)
+		{
+			q15 = dsp_aligned_alloc(D->pre_filter_taps * sizeof(int16_t));
+			D->fixed.pre_shift = gen_q15(D->pre_filter, D->pre_filter_taps, q15);
+			D->fixed.pre_filter = q15;
+			delay_line16_init(&D->fixed.raw_cb, D->pre_filter_taps);
+		}
+		q15 = dsp_aligned_alloc(D->lp_filter_taps * sizeof(int16_t));
+		D->fixed.lp_shift = gen_q15(D->lp_filter, D->lp_filter_taps, q15);
+		D->fixed.lp_filter = q15;
+		delay_line16_init(&D->fixed.m_I_raw, D->lp_filter_taps);
+		delay_line16_init(&D->fixed.m_Q_raw, D->lp_filter_taps);
+		delay_line16_init(&D->fixed.s_I_raw, D->lp_filter_taps);
+		delay_line16_init(&D->fixed.s_Q_raw, D->lp_filter_taps);
+
+		D->fixed.agc_fast_attack = lrint(D->agc_fast_attack * 16777216.0);
+		D->fixed.agc_slow_decay = lrint(D->agc_slow_decay * 16777216.0);
+	}
 
 } /* demod_afsk_init */
 
@@ -569,216 +740,376 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
  * The amplitude ratio varies from 1.48 to 3.41 with a median of 2.70.
  */
 
-__attribute__((hot)) void demod_afsk_process_sample(int chan, int subchan, int sam, struct demodulator_state_s *D)
-{
-#if DEBUG
-	static FILE *demod_log_fp = NULL;
-	static int seq = 0; /* for log file name */
-#endif
+/*
+ * The per-sample work for each profile, after the optional prefilter.
+ * These are always inlined so the single sample and block versions below
+ * compile into tight loops with the profile selection pulled out.
+ */
 
-	assert(chan >= 0 && chan < MAX_CHANS);
-	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+/*
+ * Update the AGC envelopes, and capture the mark and space peak amplitudes
+ * for display.  All use fast attack and slow decay, the display with a
+ * longer term view.
+ *
+ * Version 1.8: Used to be separate tests and branches for each.  Now they
+ * are lanes of D->env, see fsk_demod_state.h, and this loop compiles into
+ * a few SIMD instructions with a blend in place of the branches.
+ */
 
-	/*
-	 * Filters use last 'filter_taps' samples.
-	 *
-	 * First push the older samples down.
-	 *
-	 * Finally, put the most recent at the beginning.
-	 *
-	 * Future project?  Can we do better than shifting each time?
-	 */
+__attribute__((hot)) __attribute__((always_inline)) static inline void env_track(struct demodulator_state_s *D, float m_amp, float s_amp)
+{
+	float in[ENV_LANES] __attribute__((aligned(16))) = {m_amp, s_amp, -m_amp, -s_amp, m_amp, s_amp, 0.0f, 0.0f};
 
-	/* Scale to nice number. */
+	for (int k = 0; k < ENV_LANES; k++)
+	{
+		float e = D->env[k];
+		float rate = in[k] >= e ? D->env_attack[k] : D->env_decay[k];
+		D->env[k] = e + (in[k] - e) * rate;
+	}
+}
 
-	float fsam = (float)sam / 16384.0f;
+/*
+ * Compare the mark and space amplitudes and feed the PLL(s).
+ * Used by profiles "A" and "G" which differ only in how the amplitudes are found.
+ */
 
-	switch (D->profile)
+__attribute__((hot)) __attribute__((always_inline)) static inline void mark_space_decide(int chan, int subchan, float m_amp, float s_amp, struct demodulator_state_s *D)
+{
+	if (D->num_slicers <= 1)
 	{
 
-	case 'E':
-	default:
-	case 'A':
+		// Which tone is stonger?  That's simple with an ideal signal.
+		// However, we don't see too many ideal signals.
+		// Due to mismatching pre-emphasis and de-emphasis, the two
+		// tones will often have greatly different amplitudes so we use
+		// automatic gain control (AGC) to scale each to the same range
+		// before comparing.
+		// This is probably over complicated and could be combined with
+		// the signal amplitude measurement, above.
+		// It works so let's move along to other topics.
+
+		float m_norm = agc(m_amp, D->env[ENV_M_PEAK], -D->env[ENV_M_VALLEY]);
+		float s_norm = agc(s_amp, D->env[ENV_S_PEAK], -D->env[ENV_S_VALLEY]);
+
+		// The normalized values should be around -0.5 to +0.5 so the difference
+		// should work out to be around -1 to +1.
+		// This is important because nudge_pll uses the demod_out amplitude to assign
+		// a quality or confidence score to the symbol.
+
+		float demod_out = m_norm - s_norm;
+
+		// Tested and it looks good.  Range of about -1 to +1.
+		// printf ("JWL DEBUG demod A with agc = %6.2f\n", demod_out);
+
+		nudge_pll(chan, subchan, 0, demod_out, D, 1.0);
+	}
+	else
 	{
-		/* ========== New in Version 1.7 ========== */
+		// Multiple slice case.
+		// Rather than trying to find the best threshold location, use multiple
+		// slicer thresholds in parallel.
+		// The best slicing point will vary from packet to packet but should
+		// remain about the same for a given packet.
 
-		//	Cleaner & simpler than earlier 'A' thru 'E'
+		// We are not performing the AGC step here.  The envelopes were
+		// updated anyway by env_track, in the same pass as the display.
 
-		if (D->use_prefilter)
+		// Evaluate all of the slicers at once.  See slicer_bank below.
+		// Fixed length loop without branches so the compiler can vectorize it.
+
+		float demod_out[SLICER_BANK_SIZE] __attribute__((aligned(16)));
+		for (int slice = 0; slice < SLICER_BANK_SIZE; slice++)
 		{
-			push_sample(fsam, D->raw_cb, D->pre_filter_taps);
-			fsam = convolve(D->raw_cb, D->pre_filter, D->pre_filter_taps);
+			demod_out[slice] = m_amp - s_amp * space_gain[slice];
 		}
 
-		push_sample(fsam * fcos256(D->afsk.m_osc_phase), D->afsk.m_I_raw, D->lp_filter_taps);
-		push_sample(fsam * fsin256(D->afsk.m_osc_phase), D->afsk.m_Q_raw, D->lp_filter_taps);
-		D->afsk.m_osc_phase += D->afsk.m_osc_delta;
+		slicer_bank(chan, subchan, demod_out, D);
+	}
+}
 
-		push_sample(fsam * fcos256(D->afsk.s_osc_phase), D->afsk.s_I_raw, D->lp_filter_taps);
-		push_sample(fsam * fsin256(D->afsk.s_osc_phase), D->afsk.s_Q_raw, D->lp_filter_taps);
-		D->afsk.s_osc_phase += D->afsk.s_osc_delta;
+__attribute__((hot)) __attribute__((always_inline)) static inline void process_profile_a(int chan, int subchan, float fsam, struct demodulator_state_s *D)
+{
+	/* ========== New in Version 1.7 ========== */
 
-		float m_I = convolve(D->afsk.m_I_raw, D->lp_filter, D->lp_filter_taps);
-		float m_Q = convolve(D->afsk.m_Q_raw, D->lp_filter, D->lp_filter_taps);
-		float m_amp = fast_hypot(m_I, m_Q);
+	//	Cleaner & simpler than earlier 'A' thru 'E'
 
-		float s_I = convolve(D->afsk.s_I_raw, D->lp_filter, D->lp_filter_taps);
-		float s_Q = convolve(D->afsk.s_Q_raw, D->lp_filter, D->lp_filter_taps);
-		float s_amp = fast_hypot(s_I, s_Q);
+	// Mix with both local oscillators.  Mark I, mark Q, space I, space Q
+	// go into one interleaved delay line, then a single pass over the
+	// low pass filter produces all four.
 
-		/*
-		 * Capture the mark and space peak amplitudes for display.
-		 * It uses fast attack and slow decay to get an idea of the
-		 * overall amplitude.
-		 */
-		if (m_amp >= D->alevel_mark_peak)
-		{
-			D->alevel_mark_peak = m_amp * D->quick_attack + D->alevel_mark_peak * (1.0f - D->quick_attack);
-		}
-		else
-		{
-			D->alevel_mark_peak = m_amp * D->sluggish_decay + D->alevel_mark_peak * (1.0f - D->sluggish_decay);
-		}
+	float lo[4] __attribute__((aligned(16))) = {
+		fcos256(D->afsk.m_osc_phase), fsin256(D->afsk.m_osc_phase),
+		fcos256(D->afsk.s_osc_phase), fsin256(D->afsk.s_osc_phase)};
+	float mixed[4] __attribute__((aligned(16)));
+	for (int k = 0; k < 4; k++)
+	{
+		mixed[k] = fsam * lo[k];
+	}
+	delay_line4_push(&D->afsk.ms_IQ_raw, mixed);
+	D->afsk.m_osc_phase += D->afsk.m_osc_delta;
+	D->afsk.s_osc_phase += D->afsk.s_osc_delta;
+
+	float iq[4] __attribute__((aligned(16)));
+	D->lp_convolve4(delay_line4_window(&D->afsk.ms_IQ_raw), D->lp_filter, D->lp_filter_taps, iq);
+
+	float m_amp = fast_hypot(iq[0], iq[1]);
+	float s_amp = fast_hypot(iq[2], iq[3]);
+
+	env_track(D, m_amp, s_amp);
+
+	mark_space_decide(chan, subchan, m_amp, s_amp, D);
+}
+
+/*
+ * Profile "G" - Sliding DFT.
+ *
+ * Same mixers as "A" but the four outputs go into a running sum over
+ * about the last symbol time rather than thru a low pass filter.  Per sample, that
+ * is 5 multiplies and 8 adds plus the magnitudes, instead of a few hundred
+ * multiply-adds.  Rounding errors would slowly build up in the sums so
+ * they are recalculated from scratch each time around the ring.
+ */
+
+__attribute__((hot)) __attribute__((always_inline)) static inline void process_profile_g(int chan, int subchan, float fsam, struct demodulator_state_s *D)
+{
+	struct afsk_sdft_s *G = &D->sdft;
+
+	float x = fsam * G->scale;
+	float mixed[4] __attribute__((aligned(16))) = {
+		x * fcos256(D->afsk.m_osc_phase), x * fsin256(D->afsk.m_osc_phase),
+		x * fcos256(D->afsk.s_osc_phase), x * fsin256(D->afsk.s_osc_phase)};
+	D->afsk.m_osc_phase += D->afsk.m_osc_delta;
+	D->afsk.s_osc_phase += D->afsk.s_osc_delta;
 
-		if (s_amp >= D->alevel_space_peak)
+	float *oldest = G->ring[G->next];
+	for (int k = 0; k < 4; k++)
+	{
+		G->sum[k] += mixed[k] - oldest[k];
+		oldest[k] = mixed[k];
+	}
+
+	G->next++;
+	if (G->next >= G->window)
+	{
+		G->next = 0;
+
+		float sum[4] __attribute__((aligned(16))) = {0, 0, 0, 0};
+		for (int j = 0; j < G->window; j++)
 		{
-			D->alevel_space_peak = s_amp * D->quick_attack + D->alevel_space_peak * (1.0f - D->quick_attack);
+			for (int k = 0; k < 4; k++)
+			{
+				sum[k] += G->ring[j][k];
+			}
 		}
-		else
+		for (int k = 0; k < 4; k++)
 		{
-			D->alevel_space_peak = s_amp * D->sluggish_decay + D->alevel_space_peak * (1.0f - D->sluggish_decay);
+			G->sum[k] = sum[k];
 		}
+	}
 
-		if (D->num_slicers <= 1)
-		{
-
-			// Which tone is stonger?  That's simple with an ideal signal.
-			// However, we don't see too many ideal signals.
-			// Due to mismatching pre-emphasis and de-emphasis, the two
-			// tones will often have greatly different amplitudes so we use
-			// automatic gain control (AGC) to scale each to the same range
-			// before comparing.
-			// This is probably over complicated and could be combined with
-			// the signal amplitude measurement, above.
-			// It works so let's move along to other topics.
+	float m_amp = fast_hypot(G->sum[0], G->sum[1]);
+	float s_amp = fast_hypot(G->sum[2], G->sum[3]);
 
-			float m_norm = agc(m_amp, D->agc_fast_attack, D->agc_slow_decay, &(D->m_peak), &(D->m_valley));
-			float s_norm = agc(s_amp, D->agc_fast_attack, D->agc_slow_decay, &(D->s_peak), &(D->s_valley));
+	env_track(D, m_amp, s_amp);
 
-			// The normalized values should be around -0.5 to +0.5 so the difference
-			// should work out to be around -1 to +1.
-			// This is important because nudge_pll uses the demod_out amplitude to assign
-			// a quality or confidence score to the symbol.
+	mark_space_decide(chan, subchan, m_amp, s_amp, D);
+}
 
-			float demod_out = m_norm - s_norm;
+__attribute__((hot)) __attribute__((always_inline)) static inline void process_profile_b(int chan, int subchan, float fsam, struct demodulator_state_s *D)
+{
+	/* ========== Version 1.7 Experiment ========== */
 
-			// Tested and it looks good.  Range of about -1 to +1.
-			// printf ("JWL DEBUG demod A with agc = %6.2f\n", demod_out);
+	// New - Convert frequency to a value proportional to frequency.
 
-			nudge_pll(chan, subchan, 0, demod_out, D, 1.0);
-		}
-		else
-		{
-			// Multiple slice case.
-			// Rather than trying to find the best threshold location, use multiple
-			// slicer thresholds in parallel.
-			// The best slicing point will vary from packet to packet but should
-			// remain about the same for a given packet.
+	delay_line_push(&D->afsk.c_I_raw, fsam * fcos256(D->afsk.c_osc_phase));
+	delay_line_push(&D->afsk.c_Q_raw, fsam * fsin256(D->afsk.c_osc_phase));
+	D->afsk.c_osc_phase += D->afsk.c_osc_delta;
 
-			// We are not performing the AGC step here but still want the envelope
-			// for caluculating the confidence level (or quality) of the sample.
+	float c_I = convolve(D->lp_convolve, delay_line_window(&D->afsk.c_I_raw), D->lp_filter, D->lp_filter_taps);
+	float c_Q = convolve(D->lp_convolve, delay_line_window(&D->afsk.c_Q_raw), D->lp_filter, D->lp_filter_taps);
 
-			(void)agc(m_amp, D->agc_fast_attack, D->agc_slow_decay, &(D->m_peak), &(D->m_valley));
-			(void)agc(s_amp, D->agc_fast_attack, D->agc_slow_decay, &(D->s_peak), &(D->s_valley));
+	float phase = atan2f(c_Q, c_I);
+	float rate = phase - D->afsk.prev_phase;
+	if (rate > M_PI)
+		rate -= 2 * M_PI;
+	else if (rate < -M_PI)
+		rate += 2 * M_PI;
+	D->afsk.prev_phase = phase;
 
-			for (int slice = 0; slice < D->num_slicers; slice++)
-			{
-				float demod_out = m_amp - s_amp * space_gain[slice];
-				float amp = 0.5f * (D->m_peak - D->m_valley + (D->s_peak - D->s_valley) * space_gain[slice]);
-				if (amp < 0.0000001f)
-					amp = 1; // avoid divide by zero with no signal.
+	// Rate is radians per audio sample interval or something like that.
+	// Scale scale that into -1 to +1 for expected tones.
 
-				// Tested and it looks good.  Range of about -1 to +1 relative to amp.
-				// Biased one way or the other depending on the space gain.
-				// printf ("JWL DEBUG demod A with slicer %d: %6.2f / %6.2f = %6.2f\n", slice, demod_out, amp, demod_out/amp);
+	float norm_rate = rate * D->afsk.normalize_rpsam;
 
-				nudge_pll(chan, subchan, slice, demod_out, D, amp);
-			}
-		}
-	}
-	break;
+	// We really don't have mark and space amplitudes available in this case.
 
-	case 'D':
-	case 'B':
+	if (D->num_slicers <= 1)
 	{
-		/* ========== Version 1.7 Experiment ========== */
 
-		// New - Convert frequency to a value proportional to frequency.
+		float demod_out = norm_rate;
+		// Tested and it looks good.  Range roughly -1 to +1.
+		// printf ("JWL DEBUG demod B single = %6.2f\n", demod_out);
 
-		if (D->use_prefilter)
+		nudge_pll(chan, subchan, 0, demod_out, D, 1.0);
+	}
+	else
+	{
+
+		// This would be useful for HF SSB where a tuning error
+		// would shift the frequency.  Multiple slicing points would
+		// then compensate for differences in transmit/receive frequencies.
+		//
+		// Where should we set the thresholds?
+		// I'm thinking something like:
+		// 	-.5	-.375	-.25	-.125	0	.125	.25	.375	.5
+		//
+		// Assuming a 300 Hz shift, this would put slicing thresholds up
+		// to +-75 Hz from the center.
+
+		float step = 1.0f / (D->num_slicers - 1);
+		float demod_out[SLICER_BANK_SIZE] __attribute__((aligned(16)));
+		for (int slice = 0; slice < SLICER_BANK_SIZE; slice++)
 		{
-			push_sample(fsam, D->raw_cb, D->pre_filter_taps);
-			fsam = convolve(D->raw_cb, D->pre_filter, D->pre_filter_taps);
+			float offset = -0.5f + slice * step;
+			demod_out[slice] = norm_rate + offset;
+
+			// printf ("JWL DEBUG demod B slice %d, offset = %6.3f, demod_out = %6.2f\n", slice, offset, demod_out[slice]);
 		}
 
-		push_sample(fsam * fcos256(D->afsk.c_osc_phase), D->afsk.c_I_raw, D->lp_filter_taps);
-		push_sample(fsam * fsin256(D->afsk.c_osc_phase), D->afsk.c_Q_raw, D->lp_filter_taps);
-		D->afsk.c_osc_phase += D->afsk.c_osc_delta;
+		slicer_bank(chan, subchan, demod_out, D);
+	}
+}
+
+/*
+ * Profile "F" - Same as "A" but with integers.
+ *
+ * Samples stay in the original range of -32768 .. 32767 thru the prefilter,
+ * mixers, and low pass filters.  The peak display and the PLL still use
+ * float but that is only a few operations per sample.
+ */
+
+__attribute__((hot)) __attribute__((always_inline)) static inline void process_profile_f(int chan, int subchan, int sam, struct demodulator_state_s *D)
+{
+	struct afsk_fixed_s *F = &D->fixed;
+	int16_t x = sat16(sam);
+
+	if (D->use_prefilter)
+	{
+		delay_line16_push(&F->raw_cb, x);
+		x = sat16(convolve_q15(delay_line16_window(&F->raw_cb), F->pre_filter, D->pre_filter_taps) >> F->pre_shift);
+	}
 
-		float c_I = convolve(D->afsk.c_I_raw, D->lp_filter, D->lp_filter_taps);
-		float c_Q = convolve(D->afsk.c_Q_raw, D->lp_filter, D->lp_filter_taps);
+	delay_line16_push(&F->m_I_raw, (x * icos256(D->afsk.m_osc_phase)) >> 15);
+	delay_line16_push(&F->m_Q_raw, (x * isin256(D->afsk.m_osc_phase)) >> 15);
+	D->afsk.m_osc_phase += D->afsk.m_osc_delta;
 
-		float phase = atan2f(c_Q, c_I);
-		float rate = phase - D->afsk.prev_phase;
-		if (rate > M_PI)
-			rate -= 2 * M_PI;
-		else if (rate < -M_PI)
-			rate += 2 * M_PI;
-		D->afsk.prev_phase = phase;
+	delay_line16_push(&F->s_I_raw, (x * icos256(D->afsk.s_osc_phase)) >> 15);
+	delay_line16_push(&F->s_Q_raw, (x * isin256(D->afsk.s_osc_phase)) >> 15);
+	D->afsk.s_osc_phase += D->afsk.s_osc_delta;
 
-		// Rate is radians per audio sample interval or something like that.
-		// Scale scale that into -1 to +1 for expected tones.
+	int32_t m_I = convolve_q15(delay_line16_window(&F->m_I_raw), F->lp_filter, D->lp_filter_taps) >> F->lp_shift;
+	int32_t m_Q = convolve_q15(delay_line16_window(&F->m_Q_raw), F->lp_filter, D->lp_filter_taps) >> F->lp_shift;
+	int32_t m_amp = fixed_hypot(m_I, m_Q);
 
-		float norm_rate = rate * D->afsk.normalize_rpsam;
+	int32_t s_I = convolve_q15(delay_line16_window(&F->s_I_raw), F->lp_filter, D->lp_filter_taps) >> F->lp_shift;
+	int32_t s_Q = convolve_q15(delay_line16_window(&F->s_Q_raw), F->lp_filter, D->lp_filter_taps) >> F->lp_shift;
+	int32_t s_amp = fixed_hypot(s_I, s_Q);
 
-		// We really don't have mark and space amplitudes available in this case.
+	// Same scale as profile "A" for the display.
 
-		if (D->num_slicers <= 1)
-		{
+	env_track(D, m_amp * (1.0f / 16384.0f), s_amp * (1.0f / 16384.0f));
 
-			float demod_out = norm_rate;
-			// Tested and it looks good.  Range roughly -1 to +1.
-			// printf ("JWL DEBUG demod B single = %6.2f\n", demod_out);
+	if (D->num_slicers <= 1)
+	{
+		// Same as "A."  Compare the normalized mark and space amplitudes:
+		//
+		//	m_num / m_den  -  s_num / s_den
+		//
+		// Only the sign matters for the PLL so cross multiply rather than divide.
 
-			nudge_pll(chan, subchan, 0, demod_out, D, 1.0);
-		}
+		int32_t m_num, m_den, s_num, s_den;
+
+		agc_fixed(m_amp, F->agc_fast_attack, F->agc_slow_decay, &(F->m_peak), &(F->m_valley), &m_num, &m_den);
+		agc_fixed(s_amp, F->agc_fast_attack, F->agc_slow_decay, &(F->s_peak), &(F->s_valley), &s_num, &s_den);
+
+		int64_t diff;
+		if (m_den > 0 && s_den > 0)
+			diff = (int64_t)m_num * s_den - (int64_t)s_num * m_den;
 		else
+			diff = (int64_t)m_num - s_num; // At least one is 0.
+
+		float demod_out = diff > 0 ? 1.0f : diff < 0 ? -1.0f : 0.0f;
+
+		nudge_pll(chan, subchan, 0, demod_out, D, 1.0);
+	}
+	else
+	{
+		// Multiple slicers.  The AGC envelopes are only needed for the
+		// quality, which slicer_bank doesn't calculate, so skip them.
+		// Amplitudes are less than 2 ** 16 and gains less than 4,
+		// scaled by 2 ** 12, so this fits in 31 bits.
+
+		float demod_out[SLICER_BANK_SIZE] __attribute__((aligned(16)));
+		for (int slice = 0; slice < SLICER_BANK_SIZE; slice++)
 		{
+			demod_out[slice] = (float)(m_amp * 4096 - s_amp * space_gain_q12[slice]);
+		}
 
-			// This would be useful for HF SSB where a tuning error
-			// would shift the frequency.  Multiple slicing points would
-			// then compensate for differences in transmit/receive frequencies.
-			//
-			// Where should we set the thresholds?
-			// I'm thinking something like:
-			// 	-.5	-.375	-.25	-.125	0	.125	.25	.375	.5
-			//
-			// Assuming a 300 Hz shift, this would put slicing thresholds up
-			// to +-75 Hz from the center.
+		slicer_bank(chan, subchan, demod_out, D);
+	}
+}
 
-			for (int slice = 0; slice < D->num_slicers; slice++)
-			{
+__attribute__((hot)) void demod_afsk_process_sample(int chan, int subchan, int sam, struct demodulator_state_s *D)
+{
+#if DEBUG
+	static FILE *demod_log_fp = NULL;
+	static int seq = 0; /* for log file name */
+#endif
 
-				float offset = -0.5 + slice * (1. / (D->num_slicers - 1));
-				float demod_out = norm_rate + offset;
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+
+	/*
+	 * Filters use last 'filter_taps' samples.
+	 *
+	 * These are kept in delay lines, see fsk_demod_state.h, which always
+	 * present the most recent samples as one contiguous span, newest first,
+	 * without shifting the older samples down each time.
+	 */
 
-				// printf ("JWL DEBUG demod B slice %d, offset = %6.3f, demod_out = %6.2f\n", slice, offset, demod_out);
+	if (D->profile == 'F')
+	{
+		process_profile_f(chan, subchan, sam, D);
+		return;
+	}
 
-				nudge_pll(chan, subchan, slice, demod_out, D, 1.0);
-			}
-		}
+	/* Scale to nice number. */
+
+	float fsam = (float)sam / 16384.0f;
+
+	if (D->use_prefilter)
+	{
+		delay_line_push(&D->raw_cb, fsam);
+		fsam = convolve(D->pre_convolve, delay_line_window(&D->raw_cb), D->pre_filter, D->pre_filter_taps);
 	}
-	break;
+
+	switch (D->profile)
+	{
+
+	case 'E':
+	default:
+	case 'A':
+		process_profile_a(chan, subchan, fsam, D);
+		break;
+
+	case 'D':
+	case 'B':
+		process_profile_b(chan, subchan, fsam, D);
+		break;
+
+	case 'G':
+		process_profile_g(chan, subchan, fsam, D);
+		break;
 	}
 
 #if DEBUG
@@ -804,7 +1135,7 @@ __attribute__((hot)) void demod_afsk_process_sample(int chan, int subchan, int s
 			fprintf(demod_log_fp, "%.3f, %.3f, %.3f, %.3f, %.2f, %.2f\n", fsam + 3.5, m_norm + 2, s_norm + 2,
 					(m_norm - s_norm) / 2 + 1.5,
 					demod_data ? .9 : .55,
-					(D->data_clock_pll & 0x80000000) ? .1 : .45);
+					(D->data_clock_pll[0] & 0x80000000) ? .1 : .45);
 		}
 		else
 		{
@@ -820,6 +1151,124 @@ __attribute__((hot)) void demod_afsk_process_sample(int chan, int subchan, int s
 
 } /* end demod_afsk_process_sample */
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        demod_afsk_prefilter_block
+ *
+ * Purpose:     Apply the optional prefilter to a block of samples.
+ *
+ * Inputs:	D	- Demodulator with use_prefilter set.
+ *		in	- Samples scaled as in demod_afsk_process_sample,
+ *			  i.e. divided by 16384.
+ *		n	- Number of samples.
+ *
+ * Outputs:	out	- Filtered samples.  Can be the same as in.
+ *
+ * Description:	This is separate from demod_afsk_process_block so that
+ *		subchannels with identical prefilters can share one.
+ *		See demod.c.
+ *
+ *--------------------------------------------------------------------*/
+
+__attribute__((hot)) void demod_afsk_prefilter_block(struct demodulator_state_s *D, const float *in, float *out, int n)
+{
+	int i;
+
+	assert(D->use_prefilter);
+
+	for (i = 0; i < n; i++)
+	{
+		delay_line_push(&D->raw_cb, in[i]);
+		out[i] = convolve(D->pre_convolve, delay_line_window(&D->raw_cb), D->pre_filter, D->pre_filter_taps);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        demod_afsk_process_block
+ *
+ * Purpose:     Same as demod_afsk_process_sample for a block of samples.
+ *
+ * Inputs:	chan	- Audio channel.  0 for left, 1 for right.
+ *		subchan - modem of the channel.
+ *		fsam	- Audio samples, oldest first, scaled as in
+ *			  demod_afsk_process_sample, i.e. divided by 16384.
+ *			  If D->use_prefilter is set, these must already have
+ *			  gone thru demod_afsk_prefilter_block.
+ *		n	- Number of samples.
+ *
+ * Description:	Checks and the profile selection are done once for
+ *		the whole block rather than for every sample.
+ *
+ *--------------------------------------------------------------------*/
+
+__attribute__((hot)) void demod_afsk_process_block(int chan, int subchan, const float *fsam, int n, struct demodulator_state_s *D)
+{
+	int i;
+
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+
+	switch (D->profile)
+	{
+
+	case 'E':
+	default:
+	case 'A':
+		for (i = 0; i < n; i++)
+		{
+			process_profile_a(chan, subchan, fsam[i], D);
+		}
+		break;
+
+	case 'D':
+	case 'B':
+		for (i = 0; i < n; i++)
+		{
+			process_profile_b(chan, subchan, fsam[i], D);
+		}
+		break;
+
+	case 'G':
+		for (i = 0; i < n; i++)
+		{
+			process_profile_g(chan, subchan, fsam[i], D);
+		}
+		break;
+	}
+
+} /* end demod_afsk_process_block */
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        demod_afsk_process_block_fixed
+ *
+ * Purpose:     Same as demod_afsk_process_sample for a block of
+ *		samples with profile "F."
+ *
+ * Inputs:	chan	- Audio channel.  0 for left, 1 for right.
+ *		subchan - modem of the channel.
+ *		samples	- Audio samples, oldest first, not scaled.
+ *			  Any prefilter is applied here.
+ *		n	- Number of samples.
+ *
+ *--------------------------------------------------------------------*/
+
+__attribute__((hot)) void demod_afsk_process_block_fixed(int chan, int subchan, const int16_t *samples, int n, struct demodulator_state_s *D)
+{
+	int i;
+
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+	assert(D->profile == 'F');
+
+	for (i = 0; i < n; i++)
+	{
+		process_profile_f(chan, subchan, samples[i], D);
+	}
+
+} /* end demod_afsk_process_block_fixed */
+
 /*
  * Finally, a PLL is used to sample near the centers of the data bits.
  *
@@ -852,15 +1301,15 @@ __attribute__((hot)) void demod_afsk_process_sample(int chan, int subchan, int s
 
 __attribute__((hot)) static void nudge_pll(int chan, int subchan, int slice, float demod_out, struct demodulator_state_s *D, float amplitude)
 {
-	D->slicer[slice].prev_d_c_pll = D->slicer[slice].data_clock_pll;
+	signed int prev_d_c_pll = D->data_clock_pll[slice];
 
 	// Perform the add as unsigned to avoid signed overflow error.
-	D->slicer[slice].data_clock_pll = (signed)((unsigned)(D->slicer[slice].data_clock_pll) + (unsigned)(D->pll_step_per_sample));
+	D->data_clock_pll[slice] = (signed)((unsigned)(D->data_clock_pll[slice]) + (unsigned)(D->pll_step_per_sample));
 
 	//
-	// printf ("prev = %lx, new data clock pll = %lx\n" D->prev_d_c_pll, D->data_clock_pll);
+	// printf ("prev = %lx, new data clock pll = %lx\n" prev_d_c_pll, D->data_clock_pll[slice]);
 
-	if (D->slicer[slice].data_clock_pll < 0 && D->slicer[slice].prev_d_c_pll > 0)
+	if (D->data_clock_pll[slice] < 0 && prev_d_c_pll > 0)
 	{
 
 		/* Overflow - this is where we sample. */
@@ -892,36 +1341,190 @@ __attribute__((hot)) static void nudge_pll(int chan, int subchan, int slice, flo
 
 #endif
 
-		hdlc_rec_bit(chan, subchan, slice, demod_out > 0, 0);
+		hdlc_rec_bit(chan, subchan, slice, demod_out > 0, 0, quality);
 
-		pll_dcd_each_symbol2(D, chan, subchan, slice);
+		pll_dcd_each_symbol2(D, slice);
 	}
 
 	// Transitions nudge the DPLL phase toward the incoming signal.
 
 	int demod_data = demod_out > 0;
-	if (demod_data != D->slicer[slice].prev_demod_data)
+	if (demod_data != D->prev_demod_data[slice])
 	{
 
-		pll_dcd_signal_transition2(D, slice, D->slicer[slice].data_clock_pll);
+		pll_dcd_signal_transition2(D, slice, D->data_clock_pll[slice]);
 
-		// TODO:	  signed int before = (signed int)(D->slicer[slice].data_clock_pll);	// Treat as signed.
+		// TODO:	  signed int before = (signed int)(D->data_clock_pll[slice]);	// Treat as signed.
 		if (D->slicer[slice].data_detect)
 		{
-			D->slicer[slice].data_clock_pll = (int)(D->slicer[slice].data_clock_pll * D->pll_locked_inertia);
+			D->data_clock_pll[slice] = (int)(D->data_clock_pll[slice] * D->pll_locked_inertia);
 		}
 		else
 		{
-			D->slicer[slice].data_clock_pll = (int)(D->slicer[slice].data_clock_pll * D->pll_searching_inertia);
+			D->data_clock_pll[slice] = (int)(D->data_clock_pll[slice] * D->pll_searching_inertia);
 		}
-		// TODO:	  D->slicer[slice].pll_nudge_total += (int64_t)((signed int)(D->slicer[slice].data_clock_pll)) - (int64_t)before;
+		// TODO:	  D->slicer[slice].pll_nudge_total += (int64_t)((signed int)(D->data_clock_pll[slice])) - (int64_t)before;
 	}
 
 	/*
 	 * Remember demodulator output so we can compare next time.
 	 */
-	D->slicer[slice].prev_demod_data = demod_data;
+	D->prev_demod_data[slice] = demod_data;
 
 } /* end nudge_pll */
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        slicer_bank
+ *
+ * Purpose:     Same as nudge_pll for all of the slicers at once.
+ *
+ * Inputs:	demod_out	- Demodulator output for each slicer.
+ *				  SLICER_BANK_SIZE entries, only the first
+ *				  D->num_slicers are used.
+ *
+ * Description:	The common case, every slicer advancing its PLL and
+ *		comparing with its previous output, is done for all of them
+ *		in one fixed length loop without branches, over the separate
+ *		arrays in D.  The compiler turns this into vector instructions.
+ *
+ *		That produces bit masks of which slicers reached a sampling
+ *		point, the data values, and which saw a transition.
+ *		The sampled bits go to HDLC in a single call.  Only the
+ *		relatively rare sampling points and transitions need to be
+ *		handled one slicer at a time after that.
+ *
+ *		The amplitude based quality is not calculated here because
+ *		nothing uses it yet.
+ *
+ *--------------------------------------------------------------------*/
+
+__attribute__((hot)) static void slicer_bank(int chan, int subchan, const float *demod_out, struct demodulator_state_s *D)
+{
+	signed int sampled[SLICER_BANK_SIZE] __attribute__((aligned(16)));
+	signed int changed[SLICER_BANK_SIZE] __attribute__((aligned(16)));
+	signed int data[SLICER_BANK_SIZE] __attribute__((aligned(16)));
+	int slice;
+
+	for (slice = 0; slice < SLICER_BANK_SIZE; slice++)
+	{
+		signed int prev = D->data_clock_pll[slice];
+		// Perform the add as unsigned to avoid signed overflow error.
+		signed int next = (signed)((unsigned)prev + (unsigned)(D->pll_step_per_sample));
+
+		data[slice] = demod_out[slice] > 0;
+		sampled[slice] = (next < 0) & (prev > 0);
+		changed[slice] = data[slice] != D->prev_demod_data[slice];
+
+		D->data_clock_pll[slice] = next;
+		D->prev_demod_data[slice] = data[slice];
+	}
+
+	unsigned int sample_mask = 0;
+	unsigned int change_mask = 0;
+	unsigned int data_mask = 0;
+	for (slice = 0; slice < D->num_slicers; slice++)
+	{
+		sample_mask |= (unsigned)sampled[slice] << slice;
+		change_mask |= (unsigned)changed[slice] << slice;
+		data_mask |= (unsigned)data[slice] << slice;
+	}
+
+	/* Version 1.8: Slicers turned off by RXPRUNE only keep counting, nothing more. */
+
+	sample_mask &= D->active_slicers;
+	change_mask &= D->active_slicers;
+
+	if (sample_mask)
+	{
+		/* Overflow - this is where we sample. */
+
+		// Version 1.8: Gathered for hdlc_rec_bits, in demod_afsk_flush,
+		// rather than going to HDLC one at a time.
+
+		for (unsigned int m = sample_mask; m != 0; m &= m - 1)
+		{
+			slice = __builtin_ctz(m);
+
+			D->rec_bits[slice] |= (uint64_t)((data_mask >> slice) & 1) << D->rec_nbits[slice];
+			if (++D->rec_nbits[slice] == 64)
+			{
+				hdlc_rec_bits(chan, subchan, slice, D->rec_bits[slice], 64, 0);
+				D->rec_bits[slice] = 0;
+				D->rec_nbits[slice] = 0;
+			}
+
+			pll_dcd_each_symbol2(D, slice);
+		}
+	}
+
+	// Transitions nudge the DPLL phase toward the incoming signal.
+
+	for (unsigned int m = change_mask; m != 0; m &= m - 1)
+	{
+		slice = __builtin_ctz(m);
+
+		pll_dcd_signal_transition2(D, slice, D->data_clock_pll[slice]);
+
+		if (D->slicer[slice].data_detect)
+		{
+			D->data_clock_pll[slice] = (int)(D->data_clock_pll[slice] * D->pll_locked_inertia);
+		}
+		else
+		{
+			D->data_clock_pll[slice] = (int)(D->data_clock_pll[slice] * D->pll_searching_inertia);
+		}
+	}
+
+} /* end slicer_bank */
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        demod_afsk_flush
+ *
+ * Purpose:     Pass along what was gathered while processing a block
+ *		of audio.
+ *
+ * Inputs:	chan, subchan	- Which demodulator.
+ *		D		- Its state.
+ *
+ * Description:	Called at the end of each block, before hdlc_rec_flush.
+ *
+ *		Bits sampled by slicer_bank go to HDLC with one call
+ *		for each slicer.
+ *
+ *		DCD is worked out for each symbol, because the DPLL
+ *		inertia depends on it, but dcd_change is only called here
+ *		for the slicers which are different than last time.
+ *		A change that goes away again within one block is never
+ *		seen.  That is only a few milliseconds, much less than
+ *		the time needed to lock on to a signal.
+ *
+ *--------------------------------------------------------------------*/
+
+void demod_afsk_flush(int chan, int subchan, struct demodulator_state_s *D)
+{
+	unsigned int dcd = 0;
+	int slice;
+
+	for (slice = 0; slice < D->num_slicers; slice++)
+	{
+		if (D->rec_nbits[slice] > 0)
+		{
+			hdlc_rec_bits(chan, subchan, slice, D->rec_bits[slice], D->rec_nbits[slice], 0);
+			D->rec_bits[slice] = 0;
+			D->rec_nbits[slice] = 0;
+		}
+		dcd |= (unsigned)(D->slicer[slice].data_detect != 0) << slice;
+	}
+
+	for (unsigned int m = dcd ^ D->dcd_reported; m != 0; m &= m - 1)
+	{
+		slice = __builtin_ctz(m);
+		dcd_change(chan, subchan, slice, (dcd >> slice) & 1);
+	}
+	D->dcd_reported = dcd;
+
+} /* end demod_afsk_flush */
+
 /* end demod_afsk.c */
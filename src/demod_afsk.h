@@ -5,3 +5,11 @@ void demod_afsk_init(int samples_per_sec, int baud, int mark_freq,
 					 int space_freq, char profile, struct demodulator_state_s *D);
 
 void demod_afsk_process_sample(int chan, int subchan, int sam, struct demodulator_state_s *D);
+
+void demod_afsk_prefilter_block(struct demodulator_state_s *D, const float *in, float *out, int n);
+
+void demod_afsk_process_block(int chan, int subchan, const float *fsam, int n, struct demodulator_state_s *D);
+
+void demod_afsk_process_block_fixed(int chan, int subchan, const int16_t *samples, int n, struct demodulator_state_s *D);
+
+void demod_afsk_flush(int chan, int subchan, struct demodulator_state_s *D);
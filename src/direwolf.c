@@ -91,6 +91,8 @@
 #include "ax25_pad.h"
 #include "kiss.h"
 #include "kissnet.h"
+#include "kissudp.h"
+#include "kissshm.h"
 #include "kiss_frame.h"
 #include "gen_tone.h"
 #include "tq.h"
@@ -100,6 +102,14 @@
 #include "fx25.h"
 #include "dwsock.h"
 #include "dlq.h" // for fec_type_t definition.
+#include "dsp_kernel.h"
+#include "fcs_calc.h"
+#include "dwthread.h"
+#include "rxlat.h"
+#include "rxdedupe.h"
+#include "metrics.h"
+#include "autotune.h"
+#include "audio_stats.h"
 
 // static int idx_decoded = 0;
 
@@ -111,18 +121,9 @@ static void cleanup_linux(int);
 
 static void usage();
 
-#if defined(__SSE__) && !defined(__APPLE__)
-
-static void __cpuid(int cpuinfo[4], int infotype)
-{
-	__asm__ __volatile__(
-		"cpuid" : "=a"(cpuinfo[0]),
-				  "=b"(cpuinfo[1]),
-				  "=c"(cpuinfo[2]),
-				  "=d"(cpuinfo[3]) : "a"(infotype));
-}
-
-#endif
+static void rxlog_init(void);
+static void startup_time(const char *what);
+static void print_rec_packet(int chan, int subchan, int slice, packet_t pp, alevel_t alevel, fec_type_t fec_type, retry_t retries, char *spectrum);
 
 /*-------------------------------------------------------------------
  *
@@ -149,6 +150,7 @@ static const int audio_amplitude = 100; /* % of audio sample range. */
 
 static int d_u_opt = 0; /* "-d u" command line option to print UTF-8 also in hexadecimal. */
 static int d_p_opt = 0; /* "-d p" option for dumping packets over radio. */
+static int d_t_opt = 0; /* "-d t" option for time taken by each step of starting up. */
 
 static int q_h_opt = 0; /* "-q h" Quiet, suppress the "heard" line with audio level. */
 static int q_d_opt = 0; /* "-q d" Quiet, suppress the printing of decoded of APRS packets. */
@@ -161,6 +163,7 @@ int main(int argc, char *argv[])
 	char config_file[100];
 	int enable_pseudo_terminal = 0;
 	int r_opt = 0, n_opt = 0, b_opt = 0, B_opt = 0, D_opt = 0, U_opt = 0; /* Command line options. */
+	enum audio_in_format_e b_format = AUDIO_IN_FORMAT_DEFAULT;
 	char P_opt[16];
 	char l_opt_logdir[80];
 	char L_opt_logfile[80];
@@ -283,6 +286,15 @@ int main(int argc, char *argv[])
 
 #endif
 
+	/*
+	 * Pick the fastest FIR filter kernels this CPU can run.
+	 * Must happen before audio is processed.
+	 */
+	dsp_kernel_init();
+
+	/* Same for the FCS calculation. */
+	fcs_calc_init();
+
 	// I've seen many references to people running this as root.
 	// There is no reason to do that.
 	// Ordinary users can access audio, gpio, etc. if they are in the correct groups.
@@ -502,12 +514,28 @@ int main(int argc, char *argv[])
 			break;
 
 		case 'b': /* -b bits per sample.  8 or 16. */
+				  /* Version 1.8: Also 24, 32, or f32 for input only. */
 
 			b_opt = atoi(optarg);
-			if (b_opt != 8 && b_opt != 16)
+			if (b_opt == 24)
+			{
+				b_format = AUDIO_IN_FORMAT_S24;
+				b_opt = 0;
+			}
+			else if (b_opt == 32)
+			{
+				b_format = AUDIO_IN_FORMAT_S32;
+				b_opt = 0;
+			}
+			else if (strcasecmp(optarg, "f32") == 0)
+			{
+				b_format = AUDIO_IN_FORMAT_FLOAT;
+				b_opt = 0;
+			}
+			else if (b_opt != 8 && b_opt != 16)
 			{
 
-				printf("-b option, bits per sample, must be 8 or 16.\n");
+				printf("-b option, bits per sample, must be 8, 16, 24, 32, or f32.\n");
 				b_opt = 0;
 			}
 			break;
@@ -530,6 +558,7 @@ int main(int argc, char *argv[])
 				case 'n':
 					d_n_opt++;
 					kiss_net_set_debug(d_n_opt);
+					kissudp_set_debug(d_n_opt);
 					break;
 
 				case 'u':
@@ -551,6 +580,9 @@ int main(int argc, char *argv[])
 				case 'x':
 					d_x_opt++;
 					break; // FX.25
+				case 't':
+					d_t_opt = 1;
+					break; // Startup timing.
 				default:
 					break;
 				}
@@ -675,6 +707,8 @@ int main(int argc, char *argv[])
 	rig_set_debug(d_h_opt);
 #endif
 
+	startup_time(NULL);
+
 	(void)dwsock_init();
 
 	config_init(config_file, &audio_config, &misc_config);
@@ -698,6 +732,11 @@ int main(int argc, char *argv[])
 		audio_config.adev[0].bits_per_sample = b_opt;
 	}
 
+	if (b_format != AUDIO_IN_FORMAT_DEFAULT)
+	{
+		audio_config.adev[0].in_format = b_format;
+	}
+
 	if (B_opt != 0)
 	{
 		audio_config.achan[0].baud = B_opt;
@@ -781,6 +820,8 @@ int main(int argc, char *argv[])
 		audio_config.achan[0].layer2_xmit = LAYER2_FX25;
 	}
 
+	startup_time("Configuration");
+
 	/*
 	 * Open the audio source
 	 *	- soundcard
@@ -798,11 +839,45 @@ int main(int argc, char *argv[])
 		usage();
 		exit(1);
 	}
+	startup_time("Open audio devices");
+
+	/*
+	 * Version 1.8: Lock memory and keep the configured thread
+	 * priorities and CPUs for the threads started below.
+	 */
+	dw_thread_init(&audio_config);
+
+	/*
+	 * Version 1.8: Optionally time received frames through each stage.
+	 */
+	rxlat_init(audio_config.rx_latency);
+
+	/*
+	 * Version 1.8: Optionally drop frames already heard on another channel.
+	 */
+	rxdedupe_init(audio_config.rx_dedupe_sec, audio_config.rx_dedupe_size);
+
+	/*
+	 * Version 1.8: Optionally cut back the demodulators to fit the CPU.
+	 */
+	autotune(&audio_config);
+	startup_time("Threads and tuning");
+
+	/*
+	 * Version 1.8: Set up PTT in the background.  GPIO and hamlib can
+	 * take a while.  Not before autotune, which forks a trial run and
+	 * changes the profiles.  The steps from here to xmit_init, which
+	 * waits for it to finish, don't use the PTT settings.
+	 */
+	ptt_init_begin(&audio_config);
 
 	/*
 	 * Initialize the demodulator(s) and layer 2 decoder (HDLC, IL2P).
 	 */
 	multi_modem_init(&audio_config);
+	dlq_set_limits(&audio_config);
+	startup_time("Demodulators");
+
 	fx25_init(d_x_opt);
 
 	gen_tone_init(&audio_config, audio_amplitude);
@@ -816,6 +891,7 @@ int main(int argc, char *argv[])
 	 */
 
 	xmit_init(&audio_config, d_p_opt);
+	startup_time("Transmit and PTT");
 
 	/*
 	 * If -x N option specified, transmit calibration tones for transmitter
@@ -900,23 +976,278 @@ int main(int argc, char *argv[])
 	 * Provide KISS socket interface for use by a client application.
 	 */
 	kissnet_init(&misc_config);
+	kissudp_init(&misc_config);
+	kissshm_init(&misc_config);
+	metrics_server_init(&audio_config, &misc_config);
 
 	/*
 	 * Create a pseudo terminal and KISS TNC emulator.
 	 */
 	kisspt_init(&misc_config);
 	kiss_frame_init(&audio_config);
+	startup_time("KISS and network");
+
+	/*
+	 * Received frames are printed by a separate thread so a slow
+	 * terminal doesn't hold up the KISS clients.
+	 * Not when decoding recorded files.  Then nothing should be
+	 * dropped and the printing sets the pace.
+	 * Not with RXRAW either, when nothing is printed.
+	 */
+	if (!recv_offline(&audio_config) && !audio_config.rx_raw)
+	{
+		rxlog_init();
+	}
 
 	/*
 	 * Get sound samples and decode them.
 	 * Use hot attribute for all functions called for every audio sample.
 	 */
 	recv_init(&audio_config);
+	startup_time("Receive threads");
+	startup_time("");
 	recv_process();
 
 	exit(EXIT_SUCCESS);
 }
 
+/*-------------------------------------------------------------------
+ *
+ * Received frame display.
+ *
+ * Version 1.8:	Formatting and printing a received frame used to happen
+ *		on the recv_process thread, ahead of sending it to the
+ *		KISS clients.  A slow terminal or a journald pipe added
+ *		that much latency to every client.
+ *
+ *		Now the frame goes to the clients first.  A copy is put
+ *		in a ring and the rxlog thread does the printing.
+ *
+ *		There is only one producer (recv_process) and one
+ *		consumer so the ring needs no lock.  If it is full the
+ *		copy is dropped and counted rather than waiting.
+ *
+ *		With RECVTHREADS there is a producer for each received
+ *		frame queue so they take turns with rxlog_put_mutex.
+ *		The consumer still doesn't need it.
+ *
+ *--------------------------------------------------------------------*/
+
+#define RXLOG_RING_SIZE 256 /* Must be a power of 2. */
+
+struct rxlog_entry_s
+{
+	int chan;
+	int subchan;
+	int slice;
+	packet_t pp; /* Our own copy, deleted after printing. */
+	alevel_t alevel;
+	fec_type_t fec_type;
+	retry_t retries;
+	char spectrum[MAX_SUBCHANS * MAX_SLICERS + 1];
+};
+
+static struct rxlog_entry_s rxlog_ring[RXLOG_RING_SIZE];
+
+static volatile unsigned int rxlog_head = 0; /* Next to put.  Written only by producer holding rxlog_put_mutex. */
+static volatile unsigned int rxlog_tail = 0; /* Next to take.  Written only by consumer. */
+
+static volatile int rxlog_running = 0;
+static volatile int rxlog_is_waiting = 0;
+static volatile unsigned int rxlog_dropped = 0;
+
+static dw_mutex_t rxlog_put_mutex;
+
+#if __WIN32__
+static HANDLE rxlog_wake_event;
+#else
+static dw_mutex_t rxlog_wake_mutex;
+static pthread_cond_t rxlog_wake_cond;
+#endif
+
+#if __WIN32__
+static unsigned __stdcall rxlog_thread(void *arg)
+#else
+static void *rxlog_thread(void *arg)
+#endif
+{
+	unsigned int reported = 0;
+
+	while (1)
+	{
+		unsigned int tail = __atomic_load_n(&rxlog_tail, __ATOMIC_RELAXED);
+
+		/* Sleep until the producer puts something in the ring. */
+
+#if __WIN32__
+		__atomic_store_n(&rxlog_is_waiting, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&rxlog_head, __ATOMIC_SEQ_CST) == tail)
+		{
+			WaitForSingleObject(rxlog_wake_event, INFINITE);
+		}
+		__atomic_store_n(&rxlog_is_waiting, 0, __ATOMIC_SEQ_CST);
+#else
+		dw_mutex_lock(&rxlog_wake_mutex);
+		__atomic_store_n(&rxlog_is_waiting, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&rxlog_head, __ATOMIC_SEQ_CST) == tail)
+		{
+			pthread_cond_wait(&rxlog_wake_cond, &rxlog_wake_mutex);
+		}
+		__atomic_store_n(&rxlog_is_waiting, 0, __ATOMIC_SEQ_CST);
+		dw_mutex_unlock(&rxlog_wake_mutex);
+#endif
+
+		unsigned int head = __atomic_load_n(&rxlog_head, __ATOMIC_ACQUIRE);
+
+		while (tail != head)
+		{
+			struct rxlog_entry_s *E = &rxlog_ring[tail & (RXLOG_RING_SIZE - 1)];
+
+			print_rec_packet(E->chan, E->subchan, E->slice, E->pp, E->alevel, E->fec_type, E->retries, E->spectrum);
+			ax25_delete(E->pp);
+			E->pp = NULL;
+
+			tail++;
+			__atomic_store_n(&rxlog_tail, tail, __ATOMIC_RELEASE);
+		}
+
+		unsigned int dropped = __atomic_load_n(&rxlog_dropped, __ATOMIC_RELAXED);
+		if (dropped != reported)
+		{
+			printf("\n%u received frame(s) not displayed because output could not keep up.\n", dropped - reported);
+			reported = dropped;
+		}
+	}
+#if __WIN32__
+	return (0);
+#else
+	return (NULL);
+#endif
+}
+
+static void rxlog_init(void)
+{
+	if (rxlog_running)
+		return;
+
+	dw_mutex_init(&rxlog_put_mutex);
+
+#if __WIN32__
+	rxlog_wake_event = CreateEvent(NULL, 0, 0, NULL);
+	if (rxlog_wake_event == NULL)
+	{
+		printf("FATAL: Could not create received frame display event.\n");
+		exit(1);
+	}
+	if (_beginthreadex(NULL, 0, rxlog_thread, NULL, 0, NULL) == 0)
+	{
+		printf("FATAL: Could not create received frame display thread.\n");
+		exit(1);
+	}
+#else
+	dw_mutex_init(&rxlog_wake_mutex);
+	pthread_cond_init(&rxlog_wake_cond, NULL);
+
+	pthread_t tid;
+	int e = pthread_create(&tid, NULL, rxlog_thread, NULL);
+	if (e != 0)
+	{
+		printf("FATAL: Could not create received frame display thread.\n");
+		exit(1);
+	}
+	pthread_detach(tid);
+#endif
+	rxlog_running = 1;
+}
+
+/* Put a copy of the frame in the ring for printing.  Returns 0 if it was dropped. */
+
+static int rxlog_put(int chan, int subchan, int slice, packet_t pp, alevel_t alevel, fec_type_t fec_type, retry_t retries, char *spectrum)
+{
+	dw_mutex_lock(&rxlog_put_mutex);
+
+	unsigned int head = __atomic_load_n(&rxlog_head, __ATOMIC_RELAXED);
+
+	if (head - __atomic_load_n(&rxlog_tail, __ATOMIC_ACQUIRE) >= RXLOG_RING_SIZE)
+	{
+		dw_mutex_unlock(&rxlog_put_mutex);
+		__atomic_add_fetch(&rxlog_dropped, 1, __ATOMIC_RELAXED);
+		return (0);
+	}
+
+	struct rxlog_entry_s *E = &rxlog_ring[head & (RXLOG_RING_SIZE - 1)];
+
+	E->pp = ax25_dup(pp);
+	if (E->pp == NULL)
+	{
+		dw_mutex_unlock(&rxlog_put_mutex);
+		__atomic_add_fetch(&rxlog_dropped, 1, __ATOMIC_RELAXED);
+		return (0);
+	}
+	E->chan = chan;
+	E->subchan = subchan;
+	E->slice = slice;
+	E->alevel = alevel;
+	E->fec_type = fec_type;
+	E->retries = retries;
+	if (spectrum == NULL)
+		strncpy(E->spectrum, "", sizeof(E->spectrum));
+	else
+		strncpy(E->spectrum, spectrum, sizeof(E->spectrum) - 1);
+
+	__atomic_store_n(&rxlog_head, head + 1, __ATOMIC_SEQ_CST);
+	dw_mutex_unlock(&rxlog_put_mutex);
+
+	if (__atomic_load_n(&rxlog_is_waiting, __ATOMIC_SEQ_CST))
+	{
+#if __WIN32__
+		SetEvent(rxlog_wake_event);
+#else
+		dw_mutex_lock(&rxlog_wake_mutex);
+		pthread_cond_signal(&rxlog_wake_cond);
+		dw_mutex_unlock(&rxlog_wake_mutex);
+#endif
+	}
+	return (1);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        startup_time
+ *
+ * Purpose:     Version 1.8: Show how long each step of starting up took,
+ *		with the "-d t" option.
+ *
+ * Inputs:	what	- Step just completed.
+ *			  NULL to start the clock.
+ *			  Empty string for the total.
+ *
+ *--------------------------------------------------------------------*/
+
+static void startup_time(const char *what)
+{
+	static int64_t begin, prev;
+	int64_t now = audio_stats_clock();
+
+	if (what == NULL)
+	{
+		begin = prev = now;
+		return;
+	}
+	if (d_t_opt)
+	{
+		if (*what == '\0')
+		{
+			printf("Startup: %-20s %8.1f ms total\n", "", (now - begin) / 1000.);
+		}
+		else
+		{
+			printf("Startup: %-20s %8.1f ms\n", what, (now - prev) / 1000.);
+		}
+	}
+	prev = now;
+}
+
 /*-------------------------------------------------------------------
  *
  * Name:        app_process_rec_frame
@@ -937,14 +1268,77 @@ int main(int argc, char *argv[])
  *		spectrum - Display of how well multiple decoders did.
  *
  *
- * Description:	Print decoded packet.
- *		Optionally send to another application.
+ * Description:	Send to other applications first, then print the
+ *		decoded packet.  Printing is handed to the rxlog thread
+ *		when it is running.
+ *
+ *		Version 1.8: A frame already heard on another channel is
+ *		dropped here, before either, when RXDEDUPE is configured.
+ *		With RXRAW, the frame only goes to the KISS clients.
+ *
+ *--------------------------------------------------------------------*/
+
+void app_process_rec_packet(int chan, int subchan, int slice, packet_t pp, alevel_t alevel, fec_type_t fec_type, retry_t retries, char *spectrum)
+{
+	assert(chan >= 0 && chan < MAX_TOTAL_CHANS); // TOTAL for virtual channels
+	assert(subchan >= -2 && subchan < MAX_SUBCHANS);
+	assert(slice >= 0 && slice < MAX_SLICERS);
+	assert(pp != NULL); // 1.1J+
+
+	/* Version 1.8: Already heard on another channel?  See RXDEDUPE. */
+
+	if (rxdedupe_check(chan, pp))
+	{
+		return;
+	}
+
+	/* Send to another application if connected. */
+	// TODO:  Put a wrapper around this so we only call one function to send by all methods.
+	// We see the same sequence in tt_user.c.
+
+	// Use the frame where it is rather than making a copy with ax25_pack.
+	// It is the same bytes, without the FCS.
+
+	int flen = ax25_get_frame_len(pp);
+	unsigned char *fbuf = ax25_get_frame_data_ptr(pp);
+
+	kissnet_send_rec_packet(chan, KISS_CMD_DATA_FRAME, fbuf, flen, NULL, -1); // KISS TCP
+	kissudp_send_rec_packet(chan, KISS_CMD_DATA_FRAME, fbuf, flen, NULL, -1); // KISS UDP
+	kissshm_send_rec_packet(chan, KISS_CMD_DATA_FRAME, fbuf, flen, NULL, -1); // KISS shared memory
+	kisspt_send_rec_packet(chan, KISS_CMD_DATA_FRAME, fbuf, flen, NULL, -1);  // KISS pseudo terminal
+
+	/* Version 1.8: That is all for RXRAW.  Skip taking apart the */
+	/* addresses and formatting them for display. */
+
+	if (audio_config.rx_raw)
+	{
+		return;
+	}
+
+	if (rxlog_running)
+	{
+		rxlog_put(chan, subchan, slice, pp, alevel, fec_type, retries, spectrum);
+	}
+	else
+	{
+		print_rec_packet(chan, subchan, slice, pp, alevel, fec_type, retries, spectrum);
+	}
+
+} /* end app_process_rec_packet */
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        print_rec_packet
+ *
+ * Purpose:     Print decoded packet in the standard monitoring format.
+ *
+ * Inputs:	Same as app_process_rec_packet.
  *
  *--------------------------------------------------------------------*/
 
 // TODO:  Use only one printf per line so output doesn't get jumbled up with stuff from other threads.
 
-void app_process_rec_packet(int chan, int subchan, int slice, packet_t pp, alevel_t alevel, fec_type_t fec_type, retry_t retries, char *spectrum)
+static void print_rec_packet(int chan, int subchan, int slice, packet_t pp, alevel_t alevel, fec_type_t fec_type, retry_t retries, char *spectrum)
 {
 
 	char stemp[500];
@@ -1121,19 +1515,7 @@ void app_process_rec_packet(int chan, int subchan, int slice, packet_t pp, aleve
 		printf("------\n");
 	}
 
-	/* Send to another application if connected. */
-	// TODO:  Put a wrapper around this so we only call one function to send by all methods.
-	// We see the same sequence in tt_user.c.
-
-	int flen;
-	unsigned char fbuf[AX25_MAX_PACKET_LEN];
-
-	flen = ax25_pack(pp, fbuf);
-
-	kissnet_send_rec_packet(chan, KISS_CMD_DATA_FRAME, fbuf, flen, NULL, -1); // KISS TCP
-	kisspt_send_rec_packet(chan, KISS_CMD_DATA_FRAME, fbuf, flen, NULL, -1);  // KISS pseudo terminal
-
-} /* end app_process_rec_packet */
+} /* end print_rec_packet */
 
 /* Process control C and window close events. */
 
@@ -1144,6 +1526,7 @@ static void cleanup_win(int ctrltype)
 	if (ctrltype == CTRL_C_EVENT || ctrltype == CTRL_CLOSE_EVENT)
 	{
 
+		rxlat_print();
 		printf("\nQRT\n");
 		ptt_term();
 		ExitProcess(0);
@@ -1154,6 +1537,7 @@ static void cleanup_win(int ctrltype)
 
 static void cleanup_linux()
 {
+	rxlat_print();
 	printf("\nQRT\n");
 	ptt_term();
 	exit(0);
@@ -1174,6 +1558,7 @@ static void usage()
 	printf("    -r n           Audio sample rate, per sec.\n");
 	printf("    -n n           Number of audio channels, 1 or 2.\n");
 	printf("    -b n           Bits per audio sample, 8 or 16.\n");
+	printf("                     Input can also be 24, 32, or f32 for float.\n");
 	printf("    -B n           Data rate in bits/sec for channel 0.  Standard values are 300 are 1200.\n");
 	printf("                     300 bps defaults to AFSK tones of 1600 & 1800.\n");
 	printf("                     1200 bps uses AFSK tones of 1200 & 2200.\n");
@@ -1190,6 +1575,7 @@ static void usage()
 	printf("       h             h = hamlib increase verbose level.\n");
 #endif
 	printf("       x             x = FX.25 increase verbose level.\n");
+	printf("       t             t = Time taken by each step of starting up.\n");
 	printf("    -q             Quiet (suppress output) options:\n");
 	printf("       h             h = Heard line with the audio level.\n");
 	printf("       d             d = Decoding of APRS packets.\n");
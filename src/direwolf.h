@@ -22,9 +22,15 @@
  * Larger reasonable numbers should also be fine.
  *
  * For example, if you wanted to use 4 audio devices at once, change this to 4.
+ *
+ * Version 1.8: Or define it when building, e.g. -DMAX_ADEVS=16 for many
+ * channels from a wideband SDR.  The large demodulator and HDLC state is
+ * allocated only for the channels configured so this costs very little.
  */
 
+#ifndef MAX_ADEVS
 #define MAX_ADEVS 3
+#endif
 
 /*
  * Maximum number of radio channels.
@@ -44,11 +50,24 @@
 
 #define MAX_CHANS MAX_RADIO_CHANS // TODO: Replace all former  with latter to avoid confusion with following.
 
+/*
+ * KISS has only 4 bits for the channel.  Version 1.8: Radio channels above
+ * 15 are possible with a larger MAX_ADEVS.  Their frames are not sent on
+ * KISS outputs carrying all channels, only on a KISSPORT or UDP port
+ * configured for that one channel, where the application sees 0.
+ */
+
+#define MAX_KISS_CHANS 16
+
+#if MAX_RADIO_CHANS > 16
+#define MAX_TOTAL_CHANS MAX_RADIO_CHANS
+#else
 #define MAX_TOTAL_CHANS 16 // v1.7 allows additional virtual channels which are connected
 						   // to something other than radio modems.
 						   // Total maximum channels is based on the 4 bit KISS field.
 						   // Someone with very unusual requirements could increase this and
 						   // use only the AGW network protocol.
+#endif
 
 /*
  * Maximum number of rigs.
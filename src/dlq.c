@@ -34,6 +34,18 @@
  *		In version 1.4, other types of events also go into this
  *		queue and we use it to drive the data link state machine.
  *
+ *		In version 1.8, adding to the queue no longer takes a lock.
+ *		Items are pushed onto a list, newest first, with compare
+ *		and swap.  The one thread taking them out grabs the whole
+ *		list at once and reverses it into arrival order.  The
+ *		receive thread is woken only when the queue goes from
+ *		empty to not empty.
+ *
+ *		Also in version 1.8, RECVTHREADS can split it into a
+ *		queue for each audio device, each with its own thread
+ *		taking frames out.  A channel always goes to the same
+ *		one so its frames stay in order.
+ *
  *---------------------------------------------------------------*/
 
 
@@ -44,36 +56,62 @@
 #include <string.h>
 #if !__WIN32__
 #include <errno.h>
+#include <time.h>
 #endif
 
 #include "dwthread.h"
 #include "ax25_pad.h"
 #include "audio.h"
 #include "dlq.h"
+#include "rxlat.h"
 
-/* The queue is a linked list of these. */
+/*
+ * Each queue is a linked list of these.
+ * Normally there is just the one, shard 0.  See dlq_set_shards.
+ */
+
+static struct dlq_shard_s
+{
+	struct dlq_item_s *queue_top; /* Pushed by any thread, newest first. */
 
-static struct dlq_item_s *queue_head = NULL; /* Head of linked list for queue. */
+	struct dlq_item_s *taken; /* Already taken by its receive thread, oldest first. */
 
-static dw_mutex_t dlq_mutex;
+	volatile int length; /* Both of those together. */
 
 #if __WIN32__
+	HANDLE wake_up_event; /* Notify received packet processing thread when queue not empty. */
+#else
+	pthread_cond_t wake_up_cond; /* Notify received packet processing thread when queue not empty. */
 
-static HANDLE wake_up_event; /* Notify received packet processing thread when queue not empty. */
+	dw_mutex_t wake_up_mutex; /* Required by cond_wait. */
 
-#else
+	volatile int recv_thread_is_waiting;
+#endif
+} shard[MAX_DLQ_SHARDS];
 
-static pthread_cond_t wake_up_cond; /* Notify received packet processing thread when queue not empty. */
+static int chan_shard[MAX_TOTAL_CHANS]; /* Which one for each channel. */
 
-static dw_mutex_t wake_up_mutex; /* Required by cond_wait. */
+static volatile int queue_length = 0; /* Everything in all of them. */
 
-static volatile int recv_thread_is_waiting = 0;
+static volatile int queue_bytes = 0; /* Frame bytes in all of those. */
 
-#endif
+/*
+ * Version 1.8: Limits on received frames waiting.  0 means no limit.
+ * For QDROP_NEWEST, dlq_rec_frame discards frames when full.
+ * For QDROP_OLDEST, the receive thread discards the oldest when it
+ * takes them out.  Adding still stops at twice the limit so memory
+ * stays bounded if the receive thread is stuck.
+ */
+
+static int rxq_max_frames = 0;
+static int rxq_max_bytes = 0;
+static int rxq_drop = QDROP_NEWEST;
+
+static volatile int rxq_dropped = 0;
 
 static int was_init = 0; /* was initialization performed? */
 
-static void append_to_queue(struct dlq_item_s *pnew);
+static void append_to_queue(struct dlq_shard_s *q, struct dlq_item_s *pnew);
 
 static volatile int s_new_count = 0;	/* To detect memory leak for queue items. */
 static volatile int s_delete_count = 0; // TODO:  need to test.
@@ -81,6 +119,27 @@ static volatile int s_delete_count = 0; // TODO:  need to test.
 static volatile int s_cdata_new_count = 0;	  /* To detect memory leak for connected mode data. */
 static volatile int s_cdata_delete_count = 0; // TODO:  need to test.
 
+/*
+ * Version 1.8: Connected mode data blocks come in a few sizes
+ * and freed ones are kept on a list for each size to be used again.
+ * Anything larger than the biggest class goes straight to malloc.
+ */
+
+#define CDATA_NUM_CLASSES 5 /* 128, 256, 512, 1024, 2048 */
+#define CDATA_MIN_SIZE 128
+#define CDATA_POOL_MAX 64 /* Most kept on each free list. */
+
+static struct cdata_class_s
+{
+	cdata_t *free_list;
+	int free_count;
+	int in_use;
+	int high_water; /* Most in use at the same time. */
+	int mallocs;	/* How many times the free list was empty. */
+} cdata_class[CDATA_NUM_CLASSES];
+
+static dw_mutex_t cdata_mutex;
+
 /*-------------------------------------------------------------------
  *
  * Name:        dlq_init
@@ -103,66 +162,154 @@ void dlq_init(void)
 	printf("dlq_init ( )\n");
 #endif
 
-	queue_head = NULL;
+	queue_length = 0;
+	queue_bytes = 0;
 
-#if DEBUG
-
-	printf("dlq_init: pthread_mutex_init...\n");
-#endif
-
-	dw_mutex_init(&dlq_mutex);
+	dw_mutex_init(&cdata_mutex);
 
-#if !__WIN32__
-	int err;
-	err = pthread_mutex_init(&wake_up_mutex, NULL);
-	if (err != 0)
+	for (int n = 0; n < MAX_DLQ_SHARDS; n++)
 	{
+		struct dlq_shard_s *q = &shard[n];
 
-		printf("dlq_init: pthread_mutex_init err=%d", err);
-		perror("");
-		exit(EXIT_FAILURE);
-	}
-#endif
-
-#if DEBUG
-
-	printf("dlq_init: pthread_cond_init...\n");
-#endif
+		q->queue_top = NULL;
+		q->taken = NULL;
+		q->length = 0;
 
 #if __WIN32__
 
-	wake_up_event = CreateEvent(NULL, 0, 0, NULL);
+		q->wake_up_event = CreateEvent(NULL, 0, 0, NULL);
 
-	if (wake_up_event == NULL)
-	{
+		if (q->wake_up_event == NULL)
+		{
 
-		printf("dlq_init: pthread_cond_init: can't create receive wake up event");
-		exit(1);
-	}
+			printf("dlq_init: pthread_cond_init: can't create receive wake up event");
+			exit(1);
+		}
 
 #else
-	err = pthread_cond_init(&wake_up_cond, NULL);
+		int err;
+		err = pthread_mutex_init(&q->wake_up_mutex, NULL);
+		if (err != 0)
+		{
+
+			printf("dlq_init: pthread_mutex_init err=%d", err);
+			perror("");
+			exit(EXIT_FAILURE);
+		}
+
+		err = pthread_cond_init(&q->wake_up_cond, NULL);
 
 #if DEBUG
 
-	printf("dlq_init: pthread_cond_init returns %d\n", err);
+		printf("dlq_init: pthread_cond_init returns %d\n", err);
 #endif
 
-	if (err != 0)
-	{
+		if (err != 0)
+		{
 
-		printf("dlq_init: pthread_cond_init err=%d", err);
-		perror("");
-		exit(1);
-	}
+			printf("dlq_init: pthread_cond_init err=%d", err);
+			perror("");
+			exit(1);
+		}
 
-	recv_thread_is_waiting = 0;
+		q->recv_thread_is_waiting = 0;
 #endif
+	}
 
 	was_init = 1;
 
 } /* end dlq_init */
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        dlq_set_limits
+ *
+ * Purpose:     Set limits on received frames waiting in the queue.
+ *
+ * Inputs:	pa		- Configuration: rxq_max_frames, rxq_max_bytes, rxq_drop.
+ *
+ *--------------------------------------------------------------------*/
+
+void dlq_set_limits(struct audio_s *pa)
+{
+	rxq_max_frames = pa->rxq_max_frames;
+	rxq_max_bytes = pa->rxq_max_bytes;
+	rxq_drop = pa->rxq_drop;
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dlq_set_shards
+ *
+ * Purpose:     Split the received frame queue for RECVTHREADS.
+ *
+ * Inputs:	n		- Number of queues, 1 thru MAX_DLQ_SHARDS.
+ *
+ *		shard_of	- Queue for each radio channel, 0 thru n-1.
+ *				  Others, such as virtual channels, use 0.
+ *
+ * Description:	Call before anything is added.  Each queue must have
+ *		one thread taking items out with dlq_wait_while_empty
+ *		and dlq_remove_all.  The limits still apply to all of
+ *		them together.
+ *
+ *--------------------------------------------------------------------*/
+
+void dlq_set_shards(int n, const int shard_of[MAX_CHANS])
+{
+	assert(n >= 1 && n <= MAX_DLQ_SHARDS);
+
+	for (int chan = 0; chan < MAX_TOTAL_CHANS; chan++)
+	{
+		chan_shard[chan] = chan < MAX_CHANS ? shard_of[chan] : 0;
+		assert(chan_shard[chan] >= 0 && chan_shard[chan] < n);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dlq_drop_stats
+ *
+ * Purpose:     Number of received frames discarded because the queue was full.
+ *
+ *--------------------------------------------------------------------*/
+
+void dlq_drop_stats(int *dropped)
+{
+	*dropped = __atomic_load_n(&rxq_dropped, __ATOMIC_SEQ_CST);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dlq_queue_stats
+ *
+ * Purpose:     Current depth of the received frame queue.
+ *
+ * Outputs:	frames	- Number of items waiting.
+ *		bytes	- Total frame bytes of those.
+ *
+ *--------------------------------------------------------------------*/
+
+void dlq_queue_stats(int *frames, int *bytes)
+{
+	*frames = __atomic_load_n(&queue_length, __ATOMIC_SEQ_CST);
+	*bytes = __atomic_load_n(&queue_bytes, __ATOMIC_SEQ_CST);
+}
+
+static int item_bytes(struct dlq_item_s *pitem)
+{
+	return (pitem->pp != NULL ? ax25_get_frame_len(pitem->pp) : 0);
+}
+
+/* True if the queue would be over the limits after adding frames totalling flen bytes. */
+/* scale is 2 for the hard limit with QDROP_OLDEST. */
+
+static int rxq_full(int frames, int flen, int scale)
+{
+	return ((rxq_max_frames > 0 && queue_length + frames > rxq_max_frames * scale) ||
+			(rxq_max_bytes > 0 && queue_bytes + flen > rxq_max_bytes * scale));
+}
+
 /*-------------------------------------------------------------------
  *
  * Name:        dlq_rec_frame
@@ -222,6 +369,13 @@ void dlq_rec_frame(int chan, int subchan, int slice, packet_t pp, alevel_t aleve
 		return;
 	}
 
+	if (rxq_full(1, ax25_get_frame_len(pp), rxq_drop == QDROP_OLDEST ? 2 : 1))
+	{
+		__atomic_fetch_add(&rxq_dropped, 1, __ATOMIC_SEQ_CST);
+		ax25_delete(pp);
+		return;
+	}
+
 	/* Allocate a new queue item. */
 
 	pnew = (struct dlq_item_s *)calloc(sizeof(struct dlq_item_s), 1);
@@ -254,7 +408,8 @@ void dlq_rec_frame(int chan, int subchan, int slice, packet_t pp, alevel_t aleve
 
 	/* Put it into queue. */
 
-	append_to_queue(pnew);
+	rxlat_stage(pp, RXLAT_ACCEPT);
+	append_to_queue(&shard[chan_shard[chan]], pnew);
 
 } /* end dlq_rec_frame */
 
@@ -268,7 +423,9 @@ void dlq_rec_frame(int chan, int subchan, int slice, packet_t pp, alevel_t aleve
  *		from the frame transmission process.
  *
  *
- * Inputs:	pnew		- Pointer to queue element structure.
+ * Inputs:	q		- Which queue.
+ *
+ *		pnew		- Pointer to queue element structure.
  *
  * Outputs:	Information is appended to queue.
  *
@@ -277,45 +434,33 @@ void dlq_rec_frame(int chan, int subchan, int slice, packet_t pp, alevel_t aleve
  *
  *--------------------------------------------------------------------*/
 
-static void append_to_queue(struct dlq_item_s *pnew)
+static void append_to_queue(struct dlq_shard_s *q, struct dlq_item_s *pnew)
 {
-	struct dlq_item_s *plast;
-	int queue_length = 0;
+	struct dlq_item_s *old_top;
+	int queue_was_empty;
 
 	if (!was_init)
 	{
 		dlq_init();
 	}
 
-	pnew->nextp = NULL;
-
 #if DEBUG
-	printf("dlq append_to_queue: enter critical section\n");
+	printf("dlq append_to_queue: push\n");
 #endif
 
-	dw_mutex_lock(&dlq_mutex);
+	// Count it first so the length is never less than what is there.
 
-	if (queue_head == NULL)
-	{
-		queue_head = pnew;
-		queue_length = 1;
-	}
-	else
-	{
-		queue_length = 2; /* head + new one */
-		plast = queue_head;
-		while (plast->nextp != NULL)
-		{
-			plast = plast->nextp;
-			queue_length++;
-		}
-		plast->nextp = pnew;
-	}
+	queue_was_empty = __atomic_fetch_add(&q->length, 1, __ATOMIC_SEQ_CST) == 0;
+	__atomic_fetch_add(&queue_length, 1, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&queue_bytes, item_bytes(pnew), __ATOMIC_SEQ_CST);
 
-	dw_mutex_unlock(&dlq_mutex);
+	old_top = __atomic_load_n(&q->queue_top, __ATOMIC_RELAXED);
+	do
+	{
+		pnew->nextp = old_top;
+	} while (!__atomic_compare_exchange_n(&q->queue_top, &old_top, pnew, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 
 #if DEBUG
-	printf("dlq append_to_queue: left critical section\n");
 	printf("dlq append_to_queue (): about to wake up recv processing thread.\n");
 #endif
 
@@ -362,22 +507,30 @@ static void append_to_queue(struct dlq_item_s *pnew)
 	 * and blocking on a write.
 	 */
 
-	if (queue_length > 10)
+	if (!queue_was_empty && q->length > 10)
 	{
-		printf("Received frame queue is out of control. Length=%d.\n", queue_length);
+		printf("Received frame queue is out of control. Length=%d.\n", q->length);
 		printf("Reader thread is probably frozen.\n");
 		printf("This can be caused by using a pseudo terminal (direwolf -p) where another\n");
 		printf("application is not reading the frames from the other side.\n");
 	}
 
+	// Only when it was empty.  Otherwise, the receive thread
+	// hasn't got to the end of what it already has.
+
+	if (!queue_was_empty)
+	{
+		return;
+	}
+
 #if __WIN32__
-	SetEvent(wake_up_event);
+	SetEvent(q->wake_up_event);
 #else
-	if (recv_thread_is_waiting)
+	if (q->recv_thread_is_waiting)
 	{
-		dw_mutex_lock(&wake_up_mutex);
+		dw_mutex_lock(&q->wake_up_mutex);
 
-		int err = pthread_cond_signal(&wake_up_cond);
+		int err = pthread_cond_signal(&q->wake_up_cond);
 		if (err != 0)
 		{
 
@@ -386,7 +539,7 @@ static void append_to_queue(struct dlq_item_s *pnew)
 			exit(1);
 		}
 
-		dw_mutex_unlock(&wake_up_mutex);
+		dw_mutex_unlock(&q->wake_up_mutex);
 	}
 #endif
 
@@ -399,7 +552,9 @@ static void append_to_queue(struct dlq_item_s *pnew)
  * Purpose:     Sleep while the received data queue is empty rather than
  *		polling periodically.
  *
- * Inputs:	timeout		- Return at this time even if queue is empty.
+ * Inputs:	s		- Which queue, 0 unless dlq_set_shards was used.
+ *
+ *		timeout		- Return at this time even if queue is empty.
  *				  Zero for no timeout.
  *
  * Returns:	True if timed out before any event arrived.
@@ -409,9 +564,10 @@ static void append_to_queue(struct dlq_item_s *pnew)
  *
  *--------------------------------------------------------------------*/
 
-int dlq_wait_while_empty(double timeout)
+int dlq_wait_while_empty(int s, double timeout)
 {
 	int timed_out_result = 0;
+	struct dlq_shard_s *q = &shard[s];
 
 #if DEBUG1
 
@@ -423,7 +579,7 @@ int dlq_wait_while_empty(double timeout)
 		dlq_init();
 	}
 
-	if (queue_head == NULL)
+	if (__atomic_load_n(&q->length, __ATOMIC_SEQ_CST) == 0)
 	{
 
 #if DEBUG
@@ -439,30 +595,46 @@ int dlq_wait_while_empty(double timeout)
 #if DEBUG
 			printf("WaitForSingleObject: timeout after %d ms\n", ms);
 #endif
-			if (WaitForSingleObject(wake_up_event, ms) == WAIT_TIMEOUT)
+			if (WaitForSingleObject(q->wake_up_event, ms) == WAIT_TIMEOUT)
 			{
 				timed_out_result = 1;
 			}
 		}
 		else
 		{
-			WaitForSingleObject(wake_up_event, INFINITE);
+			WaitForSingleObject(q->wake_up_event, INFINITE);
 		}
 
 #else
 		int err;
 
-		dw_mutex_lock(&wake_up_mutex);
+		dw_mutex_lock(&q->wake_up_mutex);
 
-		recv_thread_is_waiting = 1;
-		if (timeout != 0.0)
+		// Look again while holding the lock.  Anything added after this
+		// will signal after we are waiting, not before.
+
+		q->recv_thread_is_waiting = 1;
+		if (__atomic_load_n(&q->length, __ATOMIC_SEQ_CST) != 0)
+		{
+			err = 0;
+		}
+		else if (timeout != 0.0)
 		{
 			struct timespec abstime;
 
-			abstime.tv_sec = (time_t)(long)timeout;
-			abstime.tv_nsec = (long)((timeout - (long)abstime.tv_sec) * 1000000000.0);
+			// Version 1.8: This is an absolute time, not how long to wait.
+			// Previously it was always in the past and returned at once.
+
+			clock_gettime(CLOCK_REALTIME, &abstime);
+			abstime.tv_sec += (time_t)(long)timeout;
+			abstime.tv_nsec += (long)((timeout - (long)timeout) * 1000000000.0);
+			if (abstime.tv_nsec >= 1000000000)
+			{
+				abstime.tv_sec++;
+				abstime.tv_nsec -= 1000000000;
+			}
 
-			err = pthread_cond_timedwait(&wake_up_cond, &wake_up_mutex, &abstime);
+			err = pthread_cond_timedwait(&q->wake_up_cond, &q->wake_up_mutex, &abstime);
 			if (err == ETIMEDOUT)
 			{
 				timed_out_result = 1;
@@ -470,11 +642,11 @@ int dlq_wait_while_empty(double timeout)
 		}
 		else
 		{
-			err = pthread_cond_wait(&wake_up_cond, &wake_up_mutex);
+			err = pthread_cond_wait(&q->wake_up_cond, &q->wake_up_mutex);
 		}
-		recv_thread_is_waiting = 0;
+		q->recv_thread_is_waiting = 0;
 
-		dw_mutex_unlock(&wake_up_mutex);
+		dw_mutex_unlock(&q->wake_up_mutex);
 #endif
 	}
 
@@ -488,42 +660,138 @@ int dlq_wait_while_empty(double timeout)
 
 /*-------------------------------------------------------------------
  *
- * Name:        dlq_remove
+ * Name:        take_pushed
  *
- * Purpose:     Remove an item from the head of the queue.
+ * Purpose:     Move everything pushed so far to the end of the taken list.
  *
- * Inputs:	None.
+ * Description:	Newest is first so reversing it puts it in the order added.
+ *		Only the receive thread for this queue calls this.
  *
- * Returns:	Pointer to a queue item.  Caller is responsible for deleting it.
+ *--------------------------------------------------------------------*/
+
+static void take_pushed(struct dlq_shard_s *q)
+{
+	struct dlq_item_s *p, *next, *list, **tail;
+
+	p = __atomic_exchange_n(&q->queue_top, NULL, __ATOMIC_ACQUIRE);
+	list = NULL;
+	for (; p != NULL; p = next)
+	{
+		next = p->nextp;
+		p->nextp = list;
+		list = p;
+	}
+
+	for (tail = &q->taken; *tail != NULL; tail = &(*tail)->nextp)
+		;
+	*tail = list;
+
+	// Over the limit?  Discard the oldest.
+
+	if (rxq_drop == QDROP_OLDEST)
+	{
+		while (q->taken != NULL && rxq_full(0, 0, 1))
+		{
+			p = q->taken;
+			q->taken = p->nextp;
+			__atomic_sub_fetch(&q->length, 1, __ATOMIC_SEQ_CST);
+			__atomic_sub_fetch(&queue_length, 1, __ATOMIC_SEQ_CST);
+			__atomic_sub_fetch(&queue_bytes, item_bytes(p), __ATOMIC_SEQ_CST);
+			__atomic_fetch_add(&rxq_dropped, 1, __ATOMIC_SEQ_CST);
+			dlq_delete(p);
+		}
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dlq_remove_all
+ *
+ * Purpose:     Remove everything in the queue at once.
+ *
+ * Inputs:	s	- Which queue, 0 unless dlq_set_shards was used.
+ *
+ * Returns:	Linked list, thru nextp, of queue items in the order
+ *		they were added.  Caller is responsible for deleting them.
  *		NULL if queue is empty.
  *
+ * Description:	Only one thread may take items out of each queue.
+ *
  *--------------------------------------------------------------------*/
 
-struct dlq_item_s *dlq_remove(void)
+struct dlq_item_s *dlq_remove_all(int s)
 {
+	struct dlq_shard_s *q = &shard[s];
+	struct dlq_item_s *p, *result;
+	int n = 0;
+	int bytes = 0;
 
-	struct dlq_item_s *result = NULL;
-	// int err;
+	if (!was_init)
+	{
+		dlq_init();
+	}
 
-#if DEBUG1
+	take_pushed(q);
+	result = q->taken;
+	q->taken = NULL;
+
+	for (p = result; p != NULL; p = p->nextp)
+	{
+		n++;
+		bytes += item_bytes(p);
+	}
+	__atomic_sub_fetch(&q->length, n, __ATOMIC_SEQ_CST);
+	__atomic_sub_fetch(&queue_length, n, __ATOMIC_SEQ_CST);
+	__atomic_sub_fetch(&queue_bytes, bytes, __ATOMIC_SEQ_CST);
 
-	printf("dlq_remove() enter critical section\n");
+#if DEBUG
+	printf("dlq_remove_all()  returns %d items\n", n);
 #endif
 
+	return (result);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dlq_remove
+ *
+ * Purpose:     Remove an item from the head of the queue.
+ *
+ * Inputs:	s	- Which queue, 0 unless dlq_set_shards was used.
+ *
+ * Returns:	Pointer to a queue item.  Caller is responsible for deleting it.
+ *		NULL if queue is empty.
+ *
+ * Description:	Takes everything in the queue when it runs out, then
+ *		hands them out one at a time.  Only one thread may take
+ *		items out of each queue.
+ *
+ *--------------------------------------------------------------------*/
+
+struct dlq_item_s *dlq_remove(int s)
+{
+	struct dlq_shard_s *q = &shard[s];
+	struct dlq_item_s *result;
+
 	if (!was_init)
 	{
 		dlq_init();
 	}
 
-	dw_mutex_lock(&dlq_mutex);
-
-	if (queue_head != NULL)
+	if (q->taken == NULL)
 	{
-		result = queue_head;
-		queue_head = queue_head->nextp;
+		take_pushed(q);
 	}
 
-	dw_mutex_unlock(&dlq_mutex);
+	result = q->taken;
+	if (result != NULL)
+	{
+		q->taken = result->nextp;
+		result->nextp = NULL;
+		__atomic_sub_fetch(&q->length, 1, __ATOMIC_SEQ_CST);
+		__atomic_sub_fetch(&queue_length, 1, __ATOMIC_SEQ_CST);
+		__atomic_sub_fetch(&queue_bytes, item_bytes(result), __ATOMIC_SEQ_CST);
+	}
 
 #if DEBUG
 	printf("dlq_remove()  returns \n");
@@ -596,22 +864,70 @@ void dlq_delete(struct dlq_item_s *pitem)
 cdata_t *cdata_new(int pid, char *data, int len)
 {
 	int size;
-	cdata_t *cdata;
+	int k;
+	cdata_t *cdata = NULL;
+
+	if (!was_init)
+	{
+		dlq_init();
+	}
 
 	s_cdata_new_count++;
 
-	/* Round up the size to the next 128 bytes. */
+	/* Round up the size to the next size class. */
 	/* The theory is that a smaller number of unique sizes might be */
 	/* beneficial for memory fragmentation and garbage collection. */
+	/* Now they are also reused rather than going back to malloc. */
 
-	size = (len + 127) & ~0x7f;
+	size = CDATA_MIN_SIZE;
+	for (k = 0; k < CDATA_NUM_CLASSES - 1 && size < len; k++)
+	{
+		size <<= 1;
+	}
+
+	if (len > size)
+	{
+		// Bigger than any class.  Round up to the next 128 bytes as before.
+
+		size = (len + 127) & ~0x7f;
+		k = -1;
+	}
+	else
+	{
+		struct cdata_class_s *c = &cdata_class[k];
+
+		dw_mutex_lock(&cdata_mutex);
+		cdata = c->free_list;
+		if (cdata != NULL)
+		{
+			c->free_list = cdata->next;
+			c->free_count--;
+		}
+		else
+		{
+			c->mallocs++;
+		}
+		c->in_use++;
+		if (c->in_use > c->high_water)
+		{
+			c->high_water = c->in_use;
+		}
+		dw_mutex_unlock(&cdata_mutex);
+	}
 
-	cdata = malloc(sizeof(cdata_t) + size);
 	if (cdata == NULL)
 	{
+		cdata = malloc(sizeof(cdata_t) + size);
+		if (cdata == NULL)
+		{
 
-		printf("FATAL ERROR: Out of memory.\n");
-		exit(EXIT_FAILURE);
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	else
+	{
+		assert(cdata->magic == 0 && cdata->size == size);
 	}
 
 	cdata->magic = TXDATA_MAGIC;
@@ -641,10 +957,16 @@ cdata_t *cdata_new(int pid, char *data, int len)
  *
  * Inputs:	cdata		- Pointer to a data block.
  *
+ * Description:	Blocks of one of the class sizes go back on the free list
+ *		for that size unless it is already full.
+ *
  *--------------------------------------------------------------------*/
 
 void cdata_delete(cdata_t *cdata)
 {
+	int k;
+	int size;
+
 	if (cdata == NULL)
 	{
 
@@ -663,7 +985,30 @@ void cdata_delete(cdata_t *cdata)
 
 	cdata->magic = 0;
 
-	free(cdata);
+	for (k = 0, size = CDATA_MIN_SIZE; k < CDATA_NUM_CLASSES; k++, size <<= 1)
+	{
+		if (cdata->size == size)
+		{
+			struct cdata_class_s *c = &cdata_class[k];
+
+			dw_mutex_lock(&cdata_mutex);
+			c->in_use--;
+			if (c->free_count < CDATA_POOL_MAX)
+			{
+				cdata->next = c->free_list;
+				c->free_list = cdata;
+				c->free_count++;
+				cdata = NULL;
+			}
+			dw_mutex_unlock(&cdata_mutex);
+			break;
+		}
+	}
+
+	if (cdata != NULL)
+	{
+		free(cdata);
+	}
 
 } /* end cdata_delete */
 
@@ -679,10 +1024,22 @@ void cdata_delete(cdata_t *cdata)
 
 void cdata_check_leak(void)
 {
+	int k;
+
 	if (s_cdata_delete_count != s_cdata_new_count)
 	{
 
 		printf("Internal Error, %s, new=%d, delete=%d\n", __func__, s_cdata_new_count, s_cdata_delete_count);
+
+		dw_mutex_lock(&cdata_mutex);
+		for (k = 0; k < CDATA_NUM_CLASSES; k++)
+		{
+			struct cdata_class_s *c = &cdata_class[k];
+
+			printf("  %4d byte blocks: in use=%d, most in use=%d, malloc=%d, free list=%d\n",
+				   CDATA_MIN_SIZE << k, c->in_use, c->high_water, c->mallocs, c->free_count);
+		}
+		dw_mutex_unlock(&cdata_mutex);
 	}
 
 } /* end cdata_check_leak */
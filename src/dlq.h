@@ -98,11 +98,25 @@ typedef struct dlq_item_s
 
 void dlq_init(void);
 
+void dlq_set_limits(struct audio_s *pa);
+
+/* Version 1.8: Separate queue for each audio device, and one for SDR, with RECVTHREADS. */
+
+#define MAX_DLQ_SHARDS (MAX_ADEVS + 1)
+
+void dlq_set_shards(int n, const int shard_of[MAX_CHANS]);
+
+void dlq_drop_stats(int *dropped);
+
+void dlq_queue_stats(int *frames, int *bytes);
+
 void dlq_rec_frame(int chan, int subchan, int slice, packet_t pp, alevel_t alevel, fec_type_t fec_type, retry_t retries, char *spectrum);
 
-int dlq_wait_while_empty(double timeout_val);
+int dlq_wait_while_empty(int s, double timeout_val);
+
+struct dlq_item_s *dlq_remove(int s);
 
-struct dlq_item_s *dlq_remove(void);
+struct dlq_item_s *dlq_remove_all(int s);
 
 void dlq_delete(struct dlq_item_s *pitem);
 
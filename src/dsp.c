@@ -126,7 +126,10 @@ void gen_lowpass(float fc, float *lp_filter, int filter_size, bp_window_t wtype)
 	printf("   j     shape   sinc   final\n");
 #endif
 
-	assert(filter_size >= 3 && filter_size <= MAX_FILTER_SIZE);
+	// Version 1.8: Callers check against the size of their own arrays.
+	// The resampler prototype filter is much longer than MAX_FILTER_SIZE.
+
+	assert(filter_size >= 3);
 
 	for (j = 0; j < filter_size; j++)
 	{
@@ -395,4 +398,267 @@ void gen_rrc_lowpass(float *pfilter, int filter_taps, float rolloff, float sampl
 	}
 }
 
+/*------------------------------------------------------------------
+ *
+ * Name:        gen_q15
+ *
+ * Purpose:     Convert filter taps to fixed point for the integer
+ *		demodulator.
+ *
+ * Inputs:   	filter		- Taps from one of the functions above.
+ *		filter_size	- Number of filter taps.
+ *
+ * Outputs:     q15		- Same as 16 bit integers scaled by 2 ** shift.
+ *
+ * Returns:	shift - Right shift to apply to the sum of products to get
+ *		back to the original gain.
+ *
+ * Description:	The taps are made as large as possible, for precision, while
+ *		keeping the sum of 16 bit samples times taps within 32 bits.
+ *		That is about 15 significant bits for the largest tap.
+ *
+ *----------------------------------------------------------------*/
+
+int gen_q15(const float *filter, int filter_size, int16_t *q15)
+{
+	float sum_abs = 0;
+	float max_abs = 0;
+	int shift;
+	int j;
+
+	for (j = 0; j < filter_size; j++)
+	{
+		sum_abs += fabsf(filter[j]);
+		if (fabsf(filter[j]) > max_abs)
+			max_abs = fabsf(filter[j]);
+	}
+
+	assert(max_abs > 0);
+
+	// Sum of |tap| times 32768 must stay below 2**31.
+
+	shift = 0;
+	while (shift < 30 &&
+		   sum_abs * (float)(1 << (shift + 1)) < 65535.0f &&
+		   max_abs * (float)(1 << (shift + 1)) < 32767.0f)
+	{
+		shift++;
+	}
+
+	for (j = 0; j < filter_size; j++)
+	{
+		q15[j] = (int16_t)lrintf(filter[j] * (float)(1 << shift));
+	}
+
+	return (shift);
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        dsp_cached_lowpass, dsp_cached_bandpass, dsp_cached_rrc_lowpass
+ *
+ * Purpose:     Version 1.8: Same filters as above, made once and shared.
+ *
+ * Inputs:   	Same as gen_lowpass, gen_bandpass, and gen_rrc_lowpass.
+ *
+ * Returns:	Taps.  Not to be changed or freed.
+ *
+ * Description:	Each demodulator used to have its own copy of its filters
+ *		even though many are the same, e.g. "MODEM 1200 AAA" or
+ *		several channels at the same sample rate.  Now the first
+ *		one asking makes them and the rest share them.  That is
+ *		less to compute at start up and, more importantly, fewer
+ *		different taps competing for the CPU cache when many
+ *		demodulators are running on the same core.
+ *
+ *		Taps are aligned to a cache line.  Filters are matched
+ *		exactly, by kind, parameters, size, and window.
+ *
+ *		Only for initialization, from one thread.  Nothing is
+ *		ever freed.
+ *
+ *----------------------------------------------------------------*/
+
+enum filter_kind_e
+{
+	FILTER_LOWPASS,
+	FILTER_BANDPASS,
+	FILTER_RRC
+};
+
+struct filter_key_s
+{
+	enum filter_kind_e kind;
+	float a, b; /* Cutoff, or rolloff and samples per symbol. */
+	int taps;
+	bp_window_t window;
+};
+
+struct cached_filter_s
+{
+	struct cached_filter_s *next;
+	struct filter_key_s key;
+	float *taps;
+};
+
+static struct cached_filter_s *filter_cache = NULL;
+
+static const float *cached_filter(enum filter_kind_e kind, float a, float b, int taps, bp_window_t window)
+{
+	struct filter_key_s key;
+	struct cached_filter_s *c;
+
+	memset(&key, 0, sizeof(key)); /* Padding too, for memcmp. */
+	key.kind = kind;
+	key.a = a;
+	key.b = b;
+	key.taps = taps;
+	key.window = window;
+
+	for (c = filter_cache; c != NULL; c = c->next)
+	{
+		if (memcmp(&c->key, &key, sizeof(key)) == 0)
+		{
+			return (c->taps);
+		}
+	}
+
+	c = calloc(1, sizeof(*c));
+	if (c == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	c->key = key;
+	c->taps = dsp_aligned_alloc(taps * sizeof(float));
+
+	switch (kind)
+	{
+	case FILTER_LOWPASS:
+		gen_lowpass(a, c->taps, taps, window);
+		break;
+	case FILTER_BANDPASS:
+		gen_bandpass(a, b, c->taps, taps, window);
+		break;
+	case FILTER_RRC:
+		gen_rrc_lowpass(c->taps, taps, a, b);
+		break;
+	}
+
+	c->next = filter_cache;
+	filter_cache = c;
+	return (c->taps);
+}
+
+const float *dsp_cached_lowpass(float fc, int filter_size, bp_window_t wtype)
+{
+	return (cached_filter(FILTER_LOWPASS, fc, 0, filter_size, wtype));
+}
+
+const float *dsp_cached_bandpass(float f1, float f2, int filter_size, bp_window_t wtype)
+{
+	return (cached_filter(FILTER_BANDPASS, f1, f2, filter_size, wtype));
+}
+
+const float *dsp_cached_rrc_lowpass(int filter_taps, float rolloff, float samples_per_symbol)
+{
+	return (cached_filter(FILTER_RRC, rolloff, samples_per_symbol, filter_taps, 0));
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        dsp_aligned_alloc, dsp_aligned_free
+ *
+ * Purpose:     Version 1.8: Allocate zeroed memory starting on a cache line.
+ *
+ * Inputs:	size	- Number of bytes.
+ *
+ * Returns:	Pointer to memory.  Running out is fatal.
+ *
+ * Description:	Filter taps, delay lines, and demodulator state must be
+ *		aligned for SIMD loads, which is more than malloc promises
+ *		on some 32 bit systems.  Starting on a cache line also means
+ *		a short buffer doesn't straddle one more line than it needs.
+ *		Free with dsp_aligned_free, not free.
+ *
+ *----------------------------------------------------------------*/
+
+void *dsp_aligned_alloc(size_t size)
+{
+	void *p;
+
+#if __WIN32__
+	p = _aligned_malloc(size, 64);
+#else
+	if (posix_memalign(&p, 64, size) != 0)
+	{
+		p = NULL;
+	}
+#endif
+	if (p == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	memset(p, 0, size);
+	return (p);
+}
+
+void dsp_aligned_free(void *p)
+{
+#if __WIN32__
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        delay_line_init, delay_line4_init, delay_line16_init
+ *
+ * Purpose:     Version 1.8: Allocate a delay line for a filter.
+ *
+ * Inputs:	dl	- Delay line.  Must be zeroed or freed with
+ *			  delay_line_free, etc., beforehand.
+ *		len	- Number of samples in the window.
+ *			  Normally same as the filter taps.
+ *
+ * Description:	The buffers used to be part of the structure, large enough
+ *		for MAX_FILTER_SIZE, even when the filter was much shorter
+ *		or that delay line wasn't used at all by the selected profile.
+ *		Now they are just big enough.  See fsk_demod_state.h.
+ *
+ *----------------------------------------------------------------*/
+
+void delay_line_init(delay_line_t *dl, int len)
+{
+	assert(len >= 1 && len <= MAX_FILTER_SIZE);
+	dl->buf = dsp_aligned_alloc(2 * len * sizeof(float));
+	dl->len = len;
+	dl->head = 0;
+}
+
+void delay_line_free(delay_line_t *dl)
+{
+	dsp_aligned_free(dl->buf);
+	dl->buf = NULL;
+}
+
+void delay_line4_init(delay_line4_t *dl, int len)
+{
+	assert(len >= 1 && len <= MAX_FILTER_SIZE);
+	dl->buf = dsp_aligned_alloc(2 * len * 4 * sizeof(float));
+	dl->len = len;
+	dl->head = 0;
+}
+
+void delay_line16_init(delay_line16_t *dl, int len)
+{
+	assert(len >= 1 && len <= MAX_FILTER_SIZE);
+	dl->buf = dsp_aligned_alloc(2 * len * sizeof(int16_t));
+	dl->len = len;
+	dl->head = 0;
+}
+
 /* end dsp.c */
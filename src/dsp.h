@@ -14,3 +14,29 @@ void gen_ms(int fc, int samples_per_sec, float *sin_table, float *cos_table, int
 __attribute__((const)) float rrc(float t, float a);
 
 void gen_rrc_lowpass(float *pfilter, int filter_taps, float rolloff, float samples_per_symbol);
+
+int gen_q15(const float *filter, int filter_size, int16_t *q15);
+
+/* Version 1.8: Shared copies, made on first use.  Don't change or free. */
+
+const float *dsp_cached_lowpass(float fc, int filter_size, bp_window_t wtype);
+
+const float *dsp_cached_bandpass(float f1, float f2, int filter_size, bp_window_t wtype);
+
+const float *dsp_cached_rrc_lowpass(int filter_taps, float rolloff, float samples_per_symbol);
+
+/* Version 1.8: Zeroed, aligned to a cache line.  Free with dsp_aligned_free. */
+
+void *dsp_aligned_alloc(size_t size);
+
+void dsp_aligned_free(void *p);
+
+/* Version 1.8: Delay line buffers are allocated to fit.  See fsk_demod_state.h. */
+
+void delay_line_init(delay_line_t *dl, int len);
+
+void delay_line_free(delay_line_t *dl);
+
+void delay_line4_init(delay_line4_t *dl, int len);
+
+void delay_line16_init(delay_line16_t *dl, int len);
@@ -0,0 +1,681 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Name:        dsp_kernel.c
+ *
+ * Purpose:     FIR filter kernels used by the demodulators, with the
+ *		best version picked at run time.
+ *
+ * Description:	convolve() is where the demodulators spend most of their time.
+ *		Previously the only way to get SIMD instructions was to
+ *		select them at compile time, with FORCE_SSE, etc., and the
+ *		result would not run on an older CPU.  See FindCPUflags.cmake
+ *		for the history.
+ *
+ *		Here we build several versions of the same dot product, each
+ *		with the instruction set enabled just for that function, then
+ *		pick the best one the CPU actually supports.  A single binary
+ *		can then run at full speed on a new desktop and still work
+ *		on an old one.
+ *
+ *		Each uses multiple accumulators so consecutive multiply-adds
+ *		don't have to wait for each other.  Order of additions is
+ *		different than the plain loop so results can differ in the
+ *		last bit or so.  That makes no difference for demodulation.
+ *
+ *		The environment variable DIREWOLF_CONVOLVE can be set to
+ *		scalar, sse, avx2, avx512, or neon to override the choice,
+ *		e.g. for comparing performance.  An unsupported choice is ignored.
+ *
+ *		Version 1.8: The number of taps is only known at run time,
+ *		so there are loops for the remainder and the compiler can't
+ *		unroll completely.  For the filter sizes of profile A, at
+ *		the usual sample rates, each kernel is also built with the
+ *		size as a constant.  dsp_convolve_for picks one of those,
+ *		when the size matches, for each filter when the demodulator
+ *		is set up.  Setting DIREWOLF_CONVOLVE_FIXED=0 turns that off.
+ *
+ *----------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "dsp_kernel.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__SSE__) && !defined(__APPLE__)
+#define DSP_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * NEON is always there for 64 bit ARM.  For 32 bit ARM the usual
+ * armhf build doesn't assume it, so the NEON functions are built
+ * with it enabled just for them and used only if getauxval says
+ * the CPU has it.  That needs the hard or softfp float ABI and
+ * gcc 8 or later, where arm_neon.h can be used this way.
+ */
+
+#if defined(__aarch64__) && defined(__GNUC__)
+#define DSP_KERNEL_NEON 1
+#define DSP_NEON_TARGET
+#include <arm_neon.h>
+#elif defined(__arm__) && !defined(__SOFTFP__) && (defined(__clang__) || __GNUC__ >= 8)
+#define DSP_KERNEL_NEON 1
+#if defined(__clang__)
+#define DSP_NEON_TARGET __attribute__((target("neon")))
+#include <arm_neon.h>
+#else
+#define DSP_NEON_TARGET __attribute__((target("fpu=neon")))
+#pragma GCC push_options
+#pragma GCC target("fpu=neon")
+#include <arm_neon.h>
+#pragma GCC pop_options
+#endif
+#if __linux__
+#include <sys/auxv.h>
+#endif
+#endif
+
+/*
+ * Kernels are always inlined so each fixed size version below gets
+ * its own copy with the size as a constant.  The generic version is
+ * still there for the table because its address is taken.
+ */
+
+#define DSP_KERNEL_INLINE __attribute__((hot)) __attribute__((always_inline)) inline
+
+/*
+ * Filter sizes of profile A, from demod_afsk_init, for:
+ *
+ *			pre	low pass
+ *	1200 baud, 44100	383	103
+ *	1200 baud, 48000	417	113
+ *	300 baud, 44100 / 3	91	137
+ *	300 baud, 48000 / 3	99	149
+ *
+ * Both kernels are made for all of them.  Keep this short because
+ * each size adds a copy of each kernel for each instruction set.
+ */
+
+#define DSP_FIXED_TAPS(X, isa, target) \
+	X(isa, target, 91)                 \
+	X(isa, target, 99)                 \
+	X(isa, target, 103)                \
+	X(isa, target, 113)                \
+	X(isa, target, 137)                \
+	X(isa, target, 149)                \
+	X(isa, target, 383)                \
+	X(isa, target, 417)
+
+#define DSP_FIXED_FUNCTIONS(isa, target, n)                                                        \
+	__attribute__((hot)) target static float convolve_##isa##_##n(                                 \
+		const float *__restrict__ data, const float *__restrict__ filter, int filter_taps)         \
+	{                                                                                              \
+		(void)filter_taps;                                                                         \
+		return (convolve_##isa(data, filter, n));                                                  \
+	}                                                                                              \
+	__attribute__((hot)) target static void convolve4_##isa##_##n(                                 \
+		const float *__restrict__ data, const float *__restrict__ filter, int filter_taps,         \
+		float *__restrict__ out)                                                                   \
+	{                                                                                              \
+		(void)filter_taps;                                                                         \
+		convolve4_##isa(data, filter, n, out);                                                     \
+	}
+
+#define DSP_FIXED_ENTRY(isa, target, n) {n, convolve_##isa##_##n, convolve4_##isa##_##n},
+
+struct dsp_fixed_s
+{
+	int filter_taps;
+	dsp_convolve_fn_t convolve;
+	dsp_convolve4_fn_t convolve4;
+};
+
+/* All the fixed size versions for one instruction set, and a table of them ending with 0 taps. */
+
+#define DSP_FIXED_KERNELS(isa, target)                  \
+	DSP_FIXED_TAPS(DSP_FIXED_FUNCTIONS, isa, target)    \
+	static const struct dsp_fixed_s fixed_##isa[] = {   \
+		DSP_FIXED_TAPS(DSP_FIXED_ENTRY, isa, target){0, NULL, NULL}};
+
+/* Plain C.  The compiler might vectorize this on its own with -ffast-math. */
+
+DSP_KERNEL_INLINE static float convolve_scalar(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps)
+{
+	float sum = 0.0f;
+	int j;
+
+	for (j = 0; j < filter_taps; j++)
+	{
+		sum += filter[j] * data[j];
+	}
+
+	return (sum);
+}
+
+DSP_KERNEL_INLINE static void convolve4_scalar(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps, float *__restrict__ out)
+{
+	float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+	int j;
+
+	for (j = 0; j < filter_taps; j++)
+	{
+		sum0 += filter[j] * data[4 * j];
+		sum1 += filter[j] * data[4 * j + 1];
+		sum2 += filter[j] * data[4 * j + 2];
+		sum3 += filter[j] * data[4 * j + 3];
+	}
+
+	out[0] = sum0;
+	out[1] = sum1;
+	out[2] = sum2;
+	out[3] = sum3;
+}
+
+DSP_FIXED_KERNELS(scalar, )
+
+#if DSP_KERNEL_X86
+
+DSP_KERNEL_INLINE __attribute__((target("sse"))) static float convolve_sse(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps)
+{
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	__m128 acc2 = _mm_setzero_ps();
+	__m128 acc3 = _mm_setzero_ps();
+	int j = 0;
+
+	for (; j + 16 <= filter_taps; j += 16)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(filter + j), _mm_loadu_ps(data + j)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(filter + j + 4), _mm_loadu_ps(data + j + 4)));
+		acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(filter + j + 8), _mm_loadu_ps(data + j + 8)));
+		acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(filter + j + 12), _mm_loadu_ps(data + j + 12)));
+	}
+	for (; j + 4 <= filter_taps; j += 4)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(filter + j), _mm_loadu_ps(data + j)));
+	}
+
+	acc0 = _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+
+	float part[4];
+	_mm_storeu_ps(part, acc0);
+	float sum = (part[0] + part[1]) + (part[2] + part[3]);
+
+	for (; j < filter_taps; j++)
+	{
+		sum += filter[j] * data[j];
+	}
+	return (sum);
+}
+
+/* 4 interleaved signals fill a register so there is no horizontal sum at the end. */
+
+DSP_KERNEL_INLINE __attribute__((target("sse"))) static void convolve4_sse(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps, float *__restrict__ out)
+{
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	__m128 acc2 = _mm_setzero_ps();
+	__m128 acc3 = _mm_setzero_ps();
+	int j = 0;
+
+	for (; j + 4 <= filter_taps; j += 4)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_set1_ps(filter[j]), _mm_loadu_ps(data + 4 * j)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_set1_ps(filter[j + 1]), _mm_loadu_ps(data + 4 * j + 4)));
+		acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_set1_ps(filter[j + 2]), _mm_loadu_ps(data + 4 * j + 8)));
+		acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_set1_ps(filter[j + 3]), _mm_loadu_ps(data + 4 * j + 12)));
+	}
+	for (; j < filter_taps; j++)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_set1_ps(filter[j]), _mm_loadu_ps(data + 4 * j)));
+	}
+
+	_mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3)));
+}
+
+DSP_FIXED_KERNELS(sse, __attribute__((target("sse"))))
+
+DSP_KERNEL_INLINE __attribute__((target("avx2,fma"))) static float convolve_avx2(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps)
+{
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+	__m256 acc2 = _mm256_setzero_ps();
+	__m256 acc3 = _mm256_setzero_ps();
+	int j = 0;
+
+	for (; j + 32 <= filter_taps; j += 32)
+	{
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(filter + j), _mm256_loadu_ps(data + j), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(filter + j + 8), _mm256_loadu_ps(data + j + 8), acc1);
+		acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(filter + j + 16), _mm256_loadu_ps(data + j + 16), acc2);
+		acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(filter + j + 24), _mm256_loadu_ps(data + j + 24), acc3);
+	}
+	for (; j + 8 <= filter_taps; j += 8)
+	{
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(filter + j), _mm256_loadu_ps(data + j), acc0);
+	}
+
+	acc0 = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	float sum = _mm_cvtss_f32(s);
+
+	for (; j < filter_taps; j++)
+	{
+		sum += filter[j] * data[j];
+	}
+	return (sum);
+}
+
+/*
+ * Each 256 bit register holds 2 sample positions of the 4 signals.
+ * Load 8 taps at once and spread each pair across the matching lanes.
+ */
+
+DSP_KERNEL_INLINE __attribute__((target("avx2,fma"))) static void convolve4_avx2(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps, float *__restrict__ out)
+{
+	const __m256i spread0 = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+	const __m256i spread1 = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+	const __m256i spread2 = _mm256_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5);
+	const __m256i spread3 = _mm256_setr_epi32(6, 6, 6, 6, 7, 7, 7, 7);
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+	__m256 acc2 = _mm256_setzero_ps();
+	__m256 acc3 = _mm256_setzero_ps();
+	int j = 0;
+
+	for (; j + 8 <= filter_taps; j += 8)
+	{
+		__m256 f = _mm256_loadu_ps(filter + j);
+		acc0 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(f, spread0), _mm256_loadu_ps(data + 4 * j), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(f, spread1), _mm256_loadu_ps(data + 4 * j + 8), acc1);
+		acc2 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(f, spread2), _mm256_loadu_ps(data + 4 * j + 16), acc2);
+		acc3 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(f, spread3), _mm256_loadu_ps(data + 4 * j + 24), acc3);
+	}
+
+	acc0 = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+
+	for (; j < filter_taps; j++)
+	{
+		s = _mm_fmadd_ps(_mm_set1_ps(filter[j]), _mm_loadu_ps(data + 4 * j), s);
+	}
+
+	_mm_storeu_ps(out, s);
+}
+
+DSP_FIXED_KERNELS(avx2, __attribute__((target("avx2,fma"))))
+
+#if __GNUC__ >= 5 || defined(__clang__)
+#define DSP_KERNEL_AVX512 1
+
+DSP_KERNEL_INLINE __attribute__((target("avx512f"))) static float convolve_avx512(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps)
+{
+	__m512 acc0 = _mm512_setzero_ps();
+	__m512 acc1 = _mm512_setzero_ps();
+	int j = 0;
+
+	for (; j + 32 <= filter_taps; j += 32)
+	{
+		acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(filter + j), _mm512_loadu_ps(data + j), acc0);
+		acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(filter + j + 16), _mm512_loadu_ps(data + j + 16), acc1);
+	}
+	for (; j + 16 <= filter_taps; j += 16)
+	{
+		acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(filter + j), _mm512_loadu_ps(data + j), acc0);
+	}
+
+	// Masked loads take care of the remainder without reading past the end.
+
+	if (j < filter_taps)
+	{
+		__mmask16 m = (__mmask16)((1u << (filter_taps - j)) - 1);
+		acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, filter + j), _mm512_maskz_loadu_ps(m, data + j), acc1);
+	}
+
+	return (_mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1)));
+}
+
+/* Same idea as convolve4_avx2 with 4 sample positions per register. */
+
+DSP_KERNEL_INLINE __attribute__((target("avx512f"))) static void convolve4_avx512(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps, float *__restrict__ out)
+{
+	const __m512i spread0 = _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+	const __m512i spread1 = _mm512_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+	const __m512i spread2 = _mm512_setr_epi32(8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11);
+	const __m512i spread3 = _mm512_setr_epi32(12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15);
+	__m512 acc0 = _mm512_setzero_ps();
+	__m512 acc1 = _mm512_setzero_ps();
+	__m512 acc2 = _mm512_setzero_ps();
+	__m512 acc3 = _mm512_setzero_ps();
+	int j = 0;
+
+	for (; j + 16 <= filter_taps; j += 16)
+	{
+		__m512 f = _mm512_loadu_ps(filter + j);
+		acc0 = _mm512_fmadd_ps(_mm512_permutexvar_ps(spread0, f), _mm512_loadu_ps(data + 4 * j), acc0);
+		acc1 = _mm512_fmadd_ps(_mm512_permutexvar_ps(spread1, f), _mm512_loadu_ps(data + 4 * j + 16), acc1);
+		acc2 = _mm512_fmadd_ps(_mm512_permutexvar_ps(spread2, f), _mm512_loadu_ps(data + 4 * j + 32), acc2);
+		acc3 = _mm512_fmadd_ps(_mm512_permutexvar_ps(spread3, f), _mm512_loadu_ps(data + 4 * j + 48), acc3);
+	}
+
+	// Remainder, up to 4 sample positions at a time, masked to stay inside the arrays.
+
+	for (; j < filter_taps; j += 4)
+	{
+		int n = filter_taps - j < 4 ? filter_taps - j : 4;
+		__m512 f = _mm512_maskz_loadu_ps((__mmask16)((1u << n) - 1), filter + j);
+		__m512 d = _mm512_maskz_loadu_ps((__mmask16)((1u << (4 * n)) - 1), data + 4 * j);
+		acc0 = _mm512_fmadd_ps(_mm512_permutexvar_ps(spread0, f), d, acc0);
+	}
+
+	acc0 = _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3));
+
+	float part[16];
+	_mm512_storeu_ps(part, acc0);
+	for (int k = 0; k < 4; k++)
+	{
+		out[k] = (part[k] + part[k + 4]) + (part[k + 8] + part[k + 12]);
+	}
+}
+
+DSP_FIXED_KERNELS(avx512, __attribute__((target("avx512f"))))
+
+#endif
+
+/* Check that the OS saves the wider registers on context switch. */
+
+static unsigned long long xgetbv0(void)
+{
+	unsigned int eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (((unsigned long long)edx << 32) | eax);
+}
+
+#endif /* DSP_KERNEL_X86 */
+
+#if DSP_KERNEL_NEON
+
+DSP_KERNEL_INLINE DSP_NEON_TARGET static float convolve_neon(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps)
+{
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+	float32x4_t acc2 = vdupq_n_f32(0.0f);
+	float32x4_t acc3 = vdupq_n_f32(0.0f);
+	int j = 0;
+
+	for (; j + 16 <= filter_taps; j += 16)
+	{
+		acc0 = vmlaq_f32(acc0, vld1q_f32(filter + j), vld1q_f32(data + j));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(filter + j + 4), vld1q_f32(data + j + 4));
+		acc2 = vmlaq_f32(acc2, vld1q_f32(filter + j + 8), vld1q_f32(data + j + 8));
+		acc3 = vmlaq_f32(acc3, vld1q_f32(filter + j + 12), vld1q_f32(data + j + 12));
+	}
+	for (; j + 4 <= filter_taps; j += 4)
+	{
+		acc0 = vmlaq_f32(acc0, vld1q_f32(filter + j), vld1q_f32(data + j));
+	}
+
+	acc0 = vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3));
+	float32x2_t s = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+	float sum = vget_lane_f32(vpadd_f32(s, s), 0);
+
+	for (; j < filter_taps; j++)
+	{
+		sum += filter[j] * data[j];
+	}
+	return (sum);
+}
+
+DSP_KERNEL_INLINE DSP_NEON_TARGET static void convolve4_neon(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps, float *__restrict__ out)
+{
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+	float32x4_t acc2 = vdupq_n_f32(0.0f);
+	float32x4_t acc3 = vdupq_n_f32(0.0f);
+	int j = 0;
+
+	for (; j + 4 <= filter_taps; j += 4)
+	{
+		acc0 = vmlaq_n_f32(acc0, vld1q_f32(data + 4 * j), filter[j]);
+		acc1 = vmlaq_n_f32(acc1, vld1q_f32(data + 4 * j + 4), filter[j + 1]);
+		acc2 = vmlaq_n_f32(acc2, vld1q_f32(data + 4 * j + 8), filter[j + 2]);
+		acc3 = vmlaq_n_f32(acc3, vld1q_f32(data + 4 * j + 12), filter[j + 3]);
+	}
+	for (; j < filter_taps; j++)
+	{
+		acc0 = vmlaq_n_f32(acc0, vld1q_f32(data + 4 * j), filter[j]);
+	}
+
+	vst1q_f32(out, vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3)));
+}
+
+DSP_FIXED_KERNELS(neon, DSP_NEON_TARGET)
+
+#endif /* DSP_KERNEL_NEON */
+
+/*
+ * Table of what we have, best last.
+ * Don't change order without looking at dsp_kernel_init.
+ */
+
+static const struct
+{
+	const char *name;
+	dsp_convolve_fn_t convolve;
+	dsp_convolve4_fn_t convolve4;
+	const struct dsp_fixed_s *fixed;
+} kernels[] = {
+	{"scalar", convolve_scalar, convolve4_scalar, fixed_scalar},
+#if DSP_KERNEL_X86
+	{"sse", convolve_sse, convolve4_sse, fixed_sse},
+	{"avx2", convolve_avx2, convolve4_avx2, fixed_avx2},
+#if DSP_KERNEL_AVX512
+	{"avx512", convolve_avx512, convolve4_avx512, fixed_avx512},
+#endif
+#endif
+#if DSP_KERNEL_NEON
+	{"neon", convolve_neon, convolve4_neon, fixed_neon},
+#endif
+};
+
+#define NUM_KERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+// Safe default if called before dsp_kernel_init.
+
+dsp_convolve_fn_t dsp_convolve = convolve_scalar;
+dsp_convolve4_fn_t dsp_convolve4 = convolve4_scalar;
+
+static int selected = 0;
+static int use_fixed = 1;
+
+/*------------------------------------------------------------------
+ *
+ * Name:        kernel_supported
+ *
+ * Purpose:     Find out whether the CPU can run the kernels[] entry.
+ *
+ *----------------------------------------------------------------*/
+
+static int kernel_supported(const char *name)
+{
+	if (strcmp(name, "scalar") == 0)
+		return (1);
+
+#if DSP_KERNEL_X86
+	int cpuinfo[4]; // EAX, EBX, ECX, EDX
+	__cpuid(cpuinfo, 0);
+	int max_leaf = cpuinfo[0];
+	if (max_leaf < 1)
+		return (0);
+
+	__cpuid(cpuinfo, 1);
+	int has_sse = (cpuinfo[3] >> 25) & 1;
+	int has_fma = (cpuinfo[2] >> 12) & 1;
+	int has_osxsave = (cpuinfo[2] >> 27) & 1;
+	int has_avx = (cpuinfo[2] >> 28) & 1;
+
+	if (strcmp(name, "sse") == 0)
+		return (has_sse);
+
+	if (!has_osxsave || !has_avx || max_leaf < 7)
+		return (0);
+
+	unsigned long long xcr0 = xgetbv0();
+	__cpuid(cpuinfo, 7);
+	int has_avx2 = (cpuinfo[1] >> 5) & 1;
+	int has_avx512f = (cpuinfo[1] >> 16) & 1;
+
+	if (strcmp(name, "avx2") == 0)
+		return (has_avx2 && has_fma && (xcr0 & 0x6) == 0x6); // XMM and YMM state.
+
+	if (strcmp(name, "avx512") == 0)
+		return (has_avx512f && (xcr0 & 0xe6) == 0xe6); // Also opmask and ZMM state.
+#endif
+
+#if DSP_KERNEL_NEON
+	if (strcmp(name, "neon") == 0)
+	{
+#if defined(__aarch64__)
+		return (1); // Advanced SIMD is mandatory for AArch64.
+#elif __linux__
+		return ((getauxval(AT_HWCAP) & (1 << 12)) != 0); // HWCAP_NEON
+#elif defined(__ARM_NEON)
+		return (1); // Compiled with -mfpu=neon so assume it's there.
+#else
+		return (0); // No way to ask.
+#endif
+	}
+#endif
+
+	return (0);
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        dsp_kernel_init
+ *
+ * Purpose:     Pick the fastest kernels supported by this CPU.
+ *
+ * Description:	Should be called once at application start up,
+ *		before the demodulators begin processing audio.
+ *
+ *----------------------------------------------------------------*/
+
+void dsp_kernel_init(void)
+{
+	int k;
+
+	selected = 0;
+	for (k = 0; k < NUM_KERNELS; k++)
+	{
+		if (kernel_supported(kernels[k].name))
+		{
+			selected = k;
+		}
+	}
+
+	char *e = getenv("DIREWOLF_CONVOLVE");
+	if (e != NULL)
+	{
+		for (k = 0; k < NUM_KERNELS; k++)
+		{
+			if (strcasecmp(e, kernels[k].name) == 0)
+			{
+				if (kernel_supported(kernels[k].name))
+				{
+					selected = k;
+				}
+				else
+				{
+					printf("DIREWOLF_CONVOLVE=%s is not supported by this CPU.  Using %s.\n", e, kernels[selected].name);
+				}
+				break;
+			}
+		}
+		if (k == NUM_KERNELS)
+		{
+			printf("DIREWOLF_CONVOLVE=%s is not recognized.  Using %s.\n", e, kernels[selected].name);
+		}
+	}
+
+	dsp_convolve = kernels[selected].convolve;
+	dsp_convolve4 = kernels[selected].convolve4;
+
+	e = getenv("DIREWOLF_CONVOLVE_FIXED");
+	use_fixed = (e == NULL || atoi(e) != 0);
+
+} /* end dsp_kernel_init */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        dsp_convolve_for, dsp_convolve4_for
+ *
+ * Purpose:     Version 1.8: Pick the kernel for one filter.
+ *
+ * Inputs:	filter_taps	- Number of taps it will always be used with.
+ *
+ * Returns:	A version built for exactly that many taps, if there is
+ *		one, otherwise the same as dsp_convolve or dsp_convolve4.
+ *
+ * Description:	Call after dsp_kernel_init, when setting up the filter.
+ *
+ *----------------------------------------------------------------*/
+
+dsp_convolve_fn_t dsp_convolve_for(int filter_taps)
+{
+	const struct dsp_fixed_s *f;
+
+	for (f = kernels[selected].fixed; use_fixed && f->filter_taps != 0; f++)
+	{
+		if (f->filter_taps == filter_taps)
+		{
+			return (f->convolve);
+		}
+	}
+	return (dsp_convolve);
+}
+
+dsp_convolve4_fn_t dsp_convolve4_for(int filter_taps)
+{
+	const struct dsp_fixed_s *f;
+
+	for (f = kernels[selected].fixed; use_fixed && f->filter_taps != 0; f++)
+	{
+		if (f->filter_taps == filter_taps)
+		{
+			return (f->convolve4);
+		}
+	}
+	return (dsp_convolve4);
+}
+
+const char *dsp_kernel_name(void)
+{
+	return (kernels[selected].name);
+}
+
+/* end dsp_kernel.c */
@@ -0,0 +1,61 @@
+
+/* dsp_kernel.h */
+
+#ifndef DSP_KERNEL_H
+#define DSP_KERNEL_H 1
+
+/*
+ * FIR filter dot product kernels, selected at run time for the CPU we are on.
+ *
+ * data		- Most recent sample first.  No alignment required.
+ * filter	- Filter taps.  No alignment required.
+ * filter_taps	- Number of taps.  Any positive value.
+ *
+ * dsp_convolve is a plain dot product.
+ */
+
+typedef float (*dsp_convolve_fn_t)(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps);
+
+extern dsp_convolve_fn_t dsp_convolve;
+
+/*
+ * Same filter applied to 4 interleaved signals at once.
+ * Each tap is loaded once and used for all 4.
+ *
+ * data		- 4 values for each sample position, most recent first.
+ * out		- The 4 results, in the same order as the interleaved data.
+ */
+
+typedef void (*dsp_convolve4_fn_t)(const float *__restrict__ data, const float *__restrict__ filter, int filter_taps, float *__restrict__ out);
+
+extern dsp_convolve4_fn_t dsp_convolve4;
+
+void dsp_kernel_init(void);
+
+/*
+ * Version 1.8: Same but built for one number of taps, if it is one we
+ * have, so the compiler could unroll everything.  Otherwise the above.
+ */
+
+dsp_convolve_fn_t dsp_convolve_for(int filter_taps);
+
+dsp_convolve4_fn_t dsp_convolve4_for(int filter_taps);
+
+const char *dsp_kernel_name(void);
+
+#if defined(__SSE__) && !defined(__APPLE__)
+
+// Formerly in direwolf.c.  Sub-leaf (ECX) is set to 0, needed for leaf 7.
+
+static inline void __cpuid(int cpuinfo[4], int infotype)
+{
+	__asm__ __volatile__(
+		"cpuid" : "=a"(cpuinfo[0]),
+				  "=b"(cpuinfo[1]),
+				  "=c"(cpuinfo[2]),
+				  "=d"(cpuinfo[3]) : "a"(infotype), "c"(0));
+}
+
+#endif
+
+#endif
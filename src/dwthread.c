@@ -0,0 +1,502 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      dwthread.c
+ *
+ * Purpose:   	Scheduling priority and CPU placement for the threads
+ *		that must keep up with the audio.
+ *
+ * Description:	Version 1.8.
+ *
+ *		Threads are normally created with the default priority and
+ *		can run on any CPU.  The audio capture thread then competes
+ *		with KISS clients, logging and everything else on the host,
+ *		and it is the one that loses audio when it falls behind.
+ *
+ *		Each of these threads calls dw_thread_sched when it starts
+ *		to apply the configuration for its role and print what it
+ *		actually got.
+ *
+ *		Configuration:
+ *
+ *			THREADPRIO  role  { FIFO | RR | OTHER }  [ priority ]
+ *			THREADCPUS  role  cpu-list
+ *			MLOCKALL
+ *			LOCKSTATS
+ *
+ *		role is AUDIO for audio capture, DEMOD for the demodulator
+ *		threads (DEMODTHREADS), or XMIT for transmit.  cpu-list is
+ *		like "2" or "0,2-3".
+ *
+ *		Real time priority needs root, CAP_SYS_NICE, or an "rtprio"
+ *		limit in /etc/security/limits.conf.  MLOCKALL needs enough
+ *		of a "memlock" limit.
+ *
+ *		LOCKSTATS counts, for each lock, how often it was taken,
+ *		how often it was already held by another thread, and the
+ *		time spent waiting.  dw_mutex_lock tries first and only
+ *		reads the clock when it has to wait, so the usual case
+ *		costs little.  Locks are identified by source file and
+ *		the name used with dw_mutex_lock, so all the channels of
+ *		something like wake_up_mutex[chan] are counted together.
+ *		Results are on the METRICSPORT page.  Not for Windows.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if !__WIN32__
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#endif
+
+#include "audio.h"
+#include "dwthread.h"
+
+static struct audio_s *save_pa = NULL;
+
+static const char *role_name[THREAD_ROLES] = {"Audio input", "Demodulator", "Transmit"};
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dw_thread_parse_cpus
+ *
+ * Purpose:     Convert a list of CPU numbers, as in THREADCPUS, to a mask.
+ *
+ * Inputs:	str	- Something like "3" or "0,2-3".
+ *
+ * Outputs:	mask	- Bit for each CPU.
+ *
+ * Returns:	0 for success, -1 for an error.
+ *
+ *--------------------------------------------------------------------*/
+
+int dw_thread_parse_cpus(const char *str, uint64_t *mask)
+{
+	const char *p = str;
+
+	*mask = 0;
+
+	while (*p != '\0')
+	{
+		char *end;
+		long first = strtol(p, &end, 10);
+		long last = first;
+
+		if (end == p)
+			return (-1);
+		p = end;
+
+		if (*p == '-')
+		{
+			p++;
+			last = strtol(p, &end, 10);
+			if (end == p)
+				return (-1);
+			p = end;
+		}
+
+		if (first < 0 || last < first || last >= MAX_THREAD_CPUS)
+			return (-1);
+
+		for (long n = first; n <= last; n++)
+		{
+			*mask |= 1ULL << n;
+		}
+
+		if (*p == ',')
+			p++;
+		else if (*p != '\0')
+			return (-1);
+	}
+
+	return (*mask != 0 ? 0 : -1);
+}
+
+/* The opposite, for printing. */
+
+static void cpu_list(uint64_t mask, char *buf, size_t size)
+{
+	int n = 0;
+
+	buf[0] = '\0';
+
+	while (n < MAX_THREAD_CPUS)
+	{
+		if (!(mask & (1ULL << n)))
+		{
+			n++;
+			continue;
+		}
+
+		int first = n;
+
+		while (n + 1 < MAX_THREAD_CPUS && (mask & (1ULL << (n + 1))))
+			n++;
+
+		size_t len = strlen(buf);
+		if (first == n)
+			snprintf(buf + len, size - len, "%s%d", len ? "," : "", first);
+		else
+			snprintf(buf + len, size - len, "%s%d-%d", len ? "," : "", first, n);
+		n++;
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dw_thread_init
+ *
+ * Purpose:     Save the configuration for dw_thread_sched and lock memory
+ *		if asked.
+ *
+ * Inputs:	pa	- Audio configuration, including thread_sched, mlockall,
+ *			  and lock_stats.
+ *
+ * Description:	Call before starting the threads.  MCL_FUTURE also covers
+ *		their stacks and anything allocated later.
+ *
+ *--------------------------------------------------------------------*/
+
+void dw_thread_init(struct audio_s *pa)
+{
+	save_pa = pa;
+
+#if !__WIN32__
+	dw_lock_stats_enabled = pa->lock_stats;
+#endif
+
+	if (!pa->mlockall)
+	{
+		return;
+	}
+
+#if __WIN32__
+	printf("MLOCKALL is not available for Windows.\n");
+#else
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+	{
+		printf("Memory is locked so audio processing won't wait for paging.\n");
+	}
+	else
+	{
+		printf("Could not lock memory: %s\n", strerror(errno));
+		printf("The \"memlock\" limit might need to be raised.  See \"ulimit -l\".\n");
+	}
+#endif
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dw_thread_sched
+ *
+ * Purpose:     Apply the configured priority and CPU affinity to the
+ *		calling thread.
+ *
+ * Inputs:	role	- THREAD_AUDIO, THREAD_DEMOD, or THREAD_XMIT.
+ *
+ *		n	- Audio device or channel number, for the message.
+ *
+ * Description:	Nothing happens, and nothing is printed, if neither
+ *		was configured for this role.  Otherwise we print the
+ *		settings in effect afterward, which might not be what was
+ *		asked for.
+ *
+ *		For Windows, FIFO or RR with priority 50 or more gives
+ *		time critical priority.  Anything less gives highest.
+ *
+ *--------------------------------------------------------------------*/
+
+void dw_thread_sched(int role, int n)
+{
+	struct thread_sched_s *ts;
+	char cpus[3 * MAX_THREAD_CPUS];
+
+	if (save_pa == NULL)
+	{
+		return;
+	}
+
+	ts = &save_pa->thread_sched[role];
+
+	if (ts->policy == THREAD_SCHED_DEFAULT && ts->cpus == 0)
+	{
+		return;
+	}
+
+#if __WIN32__
+	HANDLE th = GetCurrentThread();
+
+	if (ts->policy == THREAD_SCHED_FIFO || ts->policy == THREAD_SCHED_RR)
+	{
+		if (!SetThreadPriority(th, ts->priority >= 50 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST))
+		{
+			printf("%s thread %d: Could not set priority, error %d.\n", role_name[role], n, (int)GetLastError());
+		}
+	}
+
+	if (ts->cpus != 0)
+	{
+		if (SetThreadAffinityMask(th, (DWORD_PTR)ts->cpus) == 0)
+		{
+			printf("%s thread %d: Could not set CPU affinity, error %d.\n", role_name[role], n, (int)GetLastError());
+		}
+		cpu_list(ts->cpus, cpus, sizeof(cpus));
+	}
+	else
+	{
+		snprintf(cpus, sizeof(cpus), "any");
+	}
+
+	printf("%s thread %d: Windows priority %d, CPUs %s.\n", role_name[role], n, GetThreadPriority(th), cpus);
+#else
+	struct sched_param sp;
+	int policy;
+	int e;
+
+	if (ts->policy != THREAD_SCHED_DEFAULT)
+	{
+		memset(&sp, 0, sizeof(sp));
+		sp.sched_priority = ts->policy == THREAD_SCHED_OTHER ? 0 : ts->priority;
+		policy = ts->policy == THREAD_SCHED_FIFO ? SCHED_FIFO : ts->policy == THREAD_SCHED_RR ? SCHED_RR : SCHED_OTHER;
+
+		e = pthread_setschedparam(pthread_self(), policy, &sp);
+		if (e != 0)
+		{
+			printf("%s thread %d: Could not set scheduling policy: %s\n", role_name[role], n, strerror(e));
+			if (e == EPERM)
+			{
+				printf("This needs root, CAP_SYS_NICE, or an \"rtprio\" limit in /etc/security/limits.conf.\n");
+			}
+		}
+	}
+
+#if __linux__
+	if (ts->cpus != 0)
+	{
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		for (int c = 0; c < MAX_THREAD_CPUS; c++)
+		{
+			if (ts->cpus & (1ULL << c))
+				CPU_SET(c, &set);
+		}
+
+		e = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (e != 0)
+		{
+			printf("%s thread %d: Could not set CPU affinity: %s\n", role_name[role], n, strerror(e));
+		}
+	}
+
+	// What we actually have now.
+
+	cpu_set_t got;
+	uint64_t mask = 0;
+
+	CPU_ZERO(&got);
+	if (pthread_getaffinity_np(pthread_self(), sizeof(got), &got) == 0)
+	{
+		for (int c = 0; c < MAX_THREAD_CPUS; c++)
+		{
+			if (CPU_ISSET(c, &got))
+				mask |= 1ULL << c;
+		}
+	}
+	cpu_list(mask, cpus, sizeof(cpus));
+#else
+	if (ts->cpus != 0)
+	{
+		printf("%s thread %d: CPU affinity is not available for this operating system.\n", role_name[role], n);
+	}
+	snprintf(cpus, sizeof(cpus), "any");
+#endif
+
+	pthread_getschedparam(pthread_self(), &policy, &sp);
+
+	printf("%s thread %d: %s priority %d, CPUs %s.\n", role_name[role], n,
+		   policy == SCHED_FIFO ? "SCHED_FIFO" : policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER",
+		   sp.sched_priority, cpus);
+#endif
+}
+
+#if !__WIN32__
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dw_lock_stats_slot
+ *
+ * Purpose:     Find or add the statistics for a lock.
+ *
+ * Inputs:	file	- __FILE__ where it is locked.
+ *		name	- What was given to dw_mutex_lock, e.g. "&(Q->mutex)".
+ *
+ * Returns:	Index for dw_mutex_lock_timed.  The last one, "other",
+ *		is shared by everything after the table is full.
+ *
+ *--------------------------------------------------------------------*/
+
+int dw_lock_stats_enabled = 0;
+
+static struct dw_lock_stats_s lock_stats[DW_LOCK_STATS_MAX];
+static int num_lock_stats = 0;
+static pthread_mutex_t lock_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int dw_lock_stats_slot(const char *file, const char *name)
+{
+	char clean[64];
+	char full[160];
+	int size = sizeof(lock_stats[0].name);
+	const char *p;
+	int n = 0;
+	int depth = 0;
+	int slot;
+
+	// Just the file name, not the directory.
+
+	p = strrchr(file, '/');
+	if (p == NULL)
+		p = strrchr(file, '\\');
+	file = p != NULL ? p + 1 : file;
+
+	// Leave out the & and parentheses, and array subscripts.
+
+	for (p = name; *p != '\0' && n < (int)sizeof(clean) - 1; p++)
+	{
+		if (*p == '[')
+			depth++;
+		else if (*p == ']')
+			depth--;
+		else if (depth == 0 && *p != '&' && *p != '(' && *p != ')' && *p != ' ')
+			clean[n++] = *p;
+	}
+	clean[n] = '\0';
+	snprintf(full, sizeof(full), "%s %s", file, clean);
+
+	pthread_mutex_lock(&lock_stats_mutex);
+	for (slot = 0; slot < num_lock_stats; slot++)
+	{
+		if (strncmp(lock_stats[slot].name, full, size - 1) == 0)
+			break;
+	}
+	if (slot == num_lock_stats)
+	{
+		if (num_lock_stats < DW_LOCK_STATS_MAX - 1)
+		{
+			snprintf(lock_stats[slot].name, size, "%.*s", size - 1, full);
+		}
+		else
+		{
+			slot = DW_LOCK_STATS_MAX - 1;
+			snprintf(lock_stats[slot].name, size, "other");
+		}
+		__atomic_store_n(&num_lock_stats, slot + 1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&lock_stats_mutex);
+	return (slot);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dw_mutex_lock_timed
+ *
+ * Purpose:     Lock, counting and timing any wait.
+ *
+ * Inputs:	m	- Mutex.
+ *		slot	- From dw_lock_stats_slot.
+ *
+ * Returns:	0 for success, like pthread_mutex_lock.
+ *
+ *--------------------------------------------------------------------*/
+
+static uint64_t lock_clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+int dw_mutex_lock_timed(pthread_mutex_t *m, int slot)
+{
+	struct dw_lock_stats_s *s = &lock_stats[slot];
+	uint64_t start, wait, max;
+	int err;
+
+	__atomic_fetch_add(&s->count, 1, __ATOMIC_RELAXED);
+
+	err = pthread_mutex_trylock(m);
+	if (err != EBUSY)
+	{
+		return (err);
+	}
+
+	start = lock_clock_ns();
+	err = pthread_mutex_lock(m);
+	wait = lock_clock_ns() - start;
+
+	__atomic_fetch_add(&s->contended, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&s->wait_ns, wait, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&s->max_wait_ns, __ATOMIC_RELAXED);
+	while (wait > max && !__atomic_compare_exchange_n(&s->max_wait_ns, &max, wait, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+	return (err);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        dw_lock_stats_get
+ *
+ * Purpose:     Get the statistics for one lock.
+ *
+ * Inputs:	n	- 0 and up.
+ *
+ * Outputs:	out
+ *
+ * Returns:	1 if there is one by that number, 0 when past the end.
+ *
+ *--------------------------------------------------------------------*/
+
+int dw_lock_stats_get(int n, struct dw_lock_stats_s *out)
+{
+	struct dw_lock_stats_s *s;
+
+	if (n < 0 || n >= __atomic_load_n(&num_lock_stats, __ATOMIC_ACQUIRE))
+	{
+		return (0);
+	}
+	s = &lock_stats[n];
+	memcpy(out->name, s->name, sizeof(out->name));
+	out->count = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+	out->contended = __atomic_load_n(&s->contended, __ATOMIC_RELAXED);
+	out->wait_ns = __atomic_load_n(&s->wait_ns, __ATOMIC_RELAXED);
+	out->max_wait_ns = __atomic_load_n(&s->max_wait_ns, __ATOMIC_RELAXED);
+	return (1);
+}
+
+#endif /* !__WIN32__ */
+
+/* end dwthread.c */
@@ -75,14 +75,37 @@ typedef HANDLE dw_cond_t;
 
 typedef pthread_mutex_t dw_mutex_t;
 
+extern int dw_lock_stats_enabled;
+
+int dw_lock_stats_slot(const char *file, const char *name);
+
+int dw_mutex_lock_timed(pthread_mutex_t *m, int slot);
+
 #define dw_mutex_init(x) pthread_mutex_init(x, NULL)
 
 /* this one will wait. */
 
+/* Version 1.8: With LOCKSTATS, each place taking a lock has its */
+/* statistics slot, found the first time from the file and name. */
+
 #define dw_mutex_lock(x)                                                                            \
 	{                                                                                               \
 		int err;                                                                                    \
-		err = pthread_mutex_lock(x);                                                                \
+		if (dw_lock_stats_enabled)                                                                  \
+		{                                                                                           \
+			static int lock_slot = -1;                                                              \
+			int slot = __atomic_load_n(&lock_slot, __ATOMIC_RELAXED);                               \
+			if (slot < 0)                                                                           \
+			{                                                                                       \
+				slot = dw_lock_stats_slot(__FILE__, #x);                                            \
+				__atomic_store_n(&lock_slot, slot, __ATOMIC_RELAXED);                               \
+			}                                                                                       \
+			err = dw_mutex_lock_timed(x, slot);                                                     \
+		}                                                                                           \
+		else                                                                                        \
+		{                                                                                           \
+			err = pthread_mutex_lock(x);                                                            \
+		}                                                                                           \
 		if (err != 0)                                                                               \
 		{                                                                                           \
 			printf("INTERNAL ERROR %s %d pthread_mutex_lock returned %d", __FILE__, __LINE__, err); \
@@ -118,4 +141,31 @@ typedef pthread_mutex_t dw_mutex_t;
 
 #endif
 
+/* Version 1.8: Priority and CPU placement.  See dwthread.c. */
+
+#include <stdint.h>
+
+struct audio_s;
+
+void dw_thread_init(struct audio_s *pa);
+
+void dw_thread_sched(int role, int n); /* role is enum thread_role_e. */
+
+int dw_thread_parse_cpus(const char *str, uint64_t *mask);
+
+/* Version 1.8: Lock contention, with LOCKSTATS.  Not for Windows. */
+
+#define DW_LOCK_STATS_MAX 64
+
+struct dw_lock_stats_s
+{
+	char name[48];		  /* Like "tq.c tq_mutex". */
+	uint64_t count;		  /* Times locked. */
+	uint64_t contended;	  /* Times it had to wait. */
+	uint64_t wait_ns;	  /* Total time waiting. */
+	uint64_t max_wait_ns; /* Longest wait. */
+};
+
+int dw_lock_stats_get(int n, struct dw_lock_stats_s *out);
+
 #endif // DWTHREAD_H
\ No newline at end of file
@@ -17,16 +17,56 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+/*------------------------------------------------------------------
+ *
+ * Name:        fcs_calc.c
+ *
+ * Purpose:     Calculate the FCS for an AX.25 frame.
+ *
+ * Description:	This gets called for every decode attempt, including every
+ *		one of the FIX_BITS attempts, and for duplicate checking.
+ *
+ *		Version 1.8:  Besides the original byte at a time table,
+ *		there are now faster versions and the best one for the CPU
+ *		is picked at run time by fcs_calc_init, the same way as the
+ *		FIR filter kernels in dsp_kernel.c.
+ *
+ *		slice8	- Eight tables so 8 bytes can be looked up at once
+ *			  rather than one after the other.
+ *
+ *		clmul	- Carry-less multiply (PCLMULQDQ on x86, PMULL on ARM)
+ *			  folds 16 bytes at a time into the next 16.
+ *			  What's left goes thru the table.
+ *
+ *		The environment variable DIREWOLF_FCS can be set to
+ *		table, slice8, or clmul to override the choice.
+ *
+ *----------------------------------------------------------------*/
+
 #include "direwolf.h"
 
 #include <stdio.h>
-
-/*
- * Calculate the FCS for an AX.25 frame.
- */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
 
 #include "fcs_calc.h"
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(__APPLE__)
+#define FCS_CLMUL_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+#if defined(__aarch64__) && defined(__GNUC__)
+#define FCS_CLMUL_ARM 1
+#include <arm_neon.h>
+#if __linux__
+#include <sys/auxv.h>
+#endif
+#endif
+
 static const unsigned short ccitt_table[256] = {
 
     // from http://www.ietf.org/rfc/rfc1549.txt
@@ -67,12 +107,18 @@ static const unsigned short ccitt_table[256] = {
 };
 
 /*
- * Use this for an AX.25 frame.
+ * Tables for slice8.  slice_table[k][b] is the effect of byte b
+ * followed by k bytes of zero.  slice_table[0] is ccitt_table.
  */
 
-unsigned short fcs_calc(unsigned char *data, int len)
+static unsigned short slice_table[8][256];
+
+/*
+ * Original byte at a time version.
+ */
+
+static unsigned short update_table(unsigned short crc, const unsigned char *data, int len)
 {
-   unsigned short crc = 0xffff;
    int j;
 
    for (j = 0; j < len; j++)
@@ -80,8 +126,293 @@ unsigned short fcs_calc(unsigned char *data, int len)
 
       crc = ((crc) >> 8) ^ ccitt_table[((crc) ^ data[j]) & 0xff];
    }
+   return (crc);
+}
+
+/*
+ * The 16 bit CRC only overlaps the first 2 of each group of 8 bytes.
+ */
+
+static unsigned short update_slice8(unsigned short crc, const unsigned char *data, int len)
+{
+   while (len >= 8)
+   {
+      unsigned int x = crc ^ (data[0] | (data[1] << 8));
 
-   return (crc ^ 0xffff);
+      crc = slice_table[7][x & 0xff] ^ slice_table[6][x >> 8] ^
+            slice_table[5][data[2]] ^ slice_table[4][data[3]] ^
+            slice_table[3][data[4]] ^ slice_table[2][data[5]] ^
+            slice_table[1][data[6]] ^ slice_table[0][data[7]];
+      data += 8;
+      len -= 8;
+   }
+   return (update_table(crc, data, len));
+}
+
+/*
+ * Carry-less multiply version.
+ *
+ * Start with the CRC shift register as 0 by putting what was in it into
+ * the first 2 data bytes instead.  What we then have is the remainder of
+ * the message, as a polynomial, divided by the CRC polynomial P.
+ *
+ * Bits are sent LSB first so, loading 16 bytes, bit j of the 128 is the
+ * term for x**(127-j).  The first 8 bytes, H, are the higher half.
+ * Moving 16 bytes further along multiplies by x**128 so
+ *
+ *	H * x**192 + L * x**128
+ *
+ * gets added to the next 16 bytes.  Only the remainder matters, so the
+ * multipliers can be x**192 mod P and x**128 mod P, which are small.
+ * Multiplying bit reversed values gives a result one bit short, so
+ * use x**191 and x**127 to make up for it.
+ */
+
+#define FCS_POLY 0x1021 /* x**16 + x**12 + x**5 + 1 */
+
+/* x**n mod P, bit reversed in 64 bits, as carry-less multiply wants. */
+
+static uint64_t fold_const(int n)
+{
+   unsigned int r = 1;
+   uint64_t c = 0;
+   int d;
+
+   for (d = 0; d < n; d++)
+   {
+      r <<= 1;
+      if (r & 0x10000)
+      {
+         r ^= 0x10000 | FCS_POLY;
+      }
+   }
+   for (d = 0; d < 16; d++)
+   {
+      if ((r >> d) & 1)
+      {
+         c |= (uint64_t)1 << (63 - d);
+      }
+   }
+   return (c);
+}
+
+static uint64_t k191, k127;
+
+#if FCS_CLMUL_X86
+
+__attribute__((target("sse2,pclmul"))) static unsigned short update_clmul(unsigned short crc, const unsigned char *data, int len)
+{
+   unsigned char first[16];
+   unsigned char rest[16];
+
+   if (len < 32)
+   {
+      return (update_slice8(crc, data, len));
+   }
+
+   memcpy(first, data, 16);
+   first[0] ^= crc & 0xff;
+   first[1] ^= crc >> 8;
+
+   __m128i k = _mm_set_epi64x((long long)k127, (long long)k191);
+   __m128i a = _mm_loadu_si128((const __m128i *)first);
+
+   data += 16;
+   len -= 16;
+
+   while (len >= 16)
+   {
+      __m128i b = _mm_loadu_si128((const __m128i *)data);
+
+      a = _mm_xor_si128(b, _mm_xor_si128(_mm_clmulepi64_si128(a, k, 0x00), _mm_clmulepi64_si128(a, k, 0x11)));
+      data += 16;
+      len -= 16;
+   }
+
+   _mm_storeu_si128((__m128i *)rest, a);
+   return (update_table(update_slice8(0, rest, 16), data, len));
+}
+
+#endif
+
+#if FCS_CLMUL_ARM
+
+__attribute__((target("+crypto"))) static unsigned short update_clmul(unsigned short crc, const unsigned char *data, int len)
+{
+   unsigned char first[16];
+   unsigned char rest[16];
+
+   if (len < 32)
+   {
+      return (update_slice8(crc, data, len));
+   }
+
+   memcpy(first, data, 16);
+   first[0] ^= crc & 0xff;
+   first[1] ^= crc >> 8;
+
+   uint64x2_t a = vreinterpretq_u64_u8(vld1q_u8(first));
+
+   data += 16;
+   len -= 16;
+
+   while (len >= 16)
+   {
+      uint64x2_t b = vreinterpretq_u64_u8(vld1q_u8(data));
+      poly128_t h = vmull_p64((poly64_t)vgetq_lane_u64(a, 0), (poly64_t)k191);
+      poly128_t l = vmull_p64((poly64_t)vgetq_lane_u64(a, 1), (poly64_t)k127);
+
+      a = veorq_u64(b, veorq_u64(vreinterpretq_u64_p128(h), vreinterpretq_u64_p128(l)));
+      data += 16;
+      len -= 16;
+   }
+
+   vst1q_u8(rest, vreinterpretq_u8_u64(a));
+   return (update_table(update_slice8(0, rest, 16), data, len));
+}
+
+#endif
+
+/*
+ * Table of what we have, best last.
+ */
+
+static const struct
+{
+   const char *name;
+   fcs_update_fn_t update;
+} engines[] = {
+    {"table", update_table},
+    {"slice8", update_slice8},
+#if FCS_CLMUL_X86 || FCS_CLMUL_ARM
+    {"clmul", update_clmul},
+#endif
+};
+
+#define NUM_ENGINES ((int)(sizeof(engines) / sizeof(engines[0])))
+
+// Safe default if called before fcs_calc_init.
+
+fcs_update_fn_t fcs_update = update_table;
+
+static int selected = 0;
+
+/*
+ * Can the CPU run it, and does it get the same answers as the table?
+ */
+
+static int engine_supported(int e)
+{
+   unsigned char test[300];
+   int len, j;
+
+   if (strcmp(engines[e].name, "clmul") == 0)
+   {
+#if FCS_CLMUL_X86
+      unsigned int eax, ebx, ecx, edx;
+
+      if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_PCLMUL) || !(edx & bit_SSE2))
+         return (0);
+#elif FCS_CLMUL_ARM && __linux__
+      if (!(getauxval(AT_HWCAP) & (1 << 4))) // HWCAP_PMULL
+         return (0);
+#endif
+   }
+
+   for (j = 0; j < (int)sizeof(test); j++)
+   {
+      test[j] = (j * 167 + 13) ^ (j >> 3);
+   }
+   for (len = 0; len <= (int)sizeof(test); len += 7)
+   {
+      if (engines[e].update(0x1234, test, len) != update_table(0x1234, test, len))
+      {
+         return (0);
+      }
+   }
+   return (1);
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        fcs_calc_init
+ *
+ * Purpose:     Pick the fastest CRC calculation supported by this CPU.
+ *
+ * Description:	Should be called once at application start up,
+ *		before any frames are sent or received.
+ *
+ *----------------------------------------------------------------*/
+
+void fcs_calc_init(void)
+{
+   int b, k;
+
+   for (b = 0; b < 256; b++)
+   {
+      slice_table[0][b] = ccitt_table[b];
+   }
+   for (k = 1; k < 8; k++)
+   {
+      for (b = 0; b < 256; b++)
+      {
+         unsigned short t = slice_table[k - 1][b];
+
+         slice_table[k][b] = (t >> 8) ^ ccitt_table[t & 0xff];
+      }
+   }
+   k191 = fold_const(191);
+   k127 = fold_const(127);
+
+   selected = 0;
+   for (k = 0; k < NUM_ENGINES; k++)
+   {
+      if (engine_supported(k))
+      {
+         selected = k;
+      }
+   }
+
+   char *e = getenv("DIREWOLF_FCS");
+   if (e != NULL)
+   {
+      for (k = 0; k < NUM_ENGINES; k++)
+      {
+         if (strcasecmp(e, engines[k].name) == 0)
+         {
+            if (engine_supported(k))
+            {
+               selected = k;
+            }
+            else
+            {
+               printf("DIREWOLF_FCS=%s is not supported by this CPU.  Using %s.\n", e, engines[selected].name);
+            }
+            break;
+         }
+      }
+      if (k == NUM_ENGINES)
+      {
+         printf("DIREWOLF_FCS=%s is not recognized.  Using %s.\n", e, engines[selected].name);
+      }
+   }
+
+   fcs_update = engines[selected].update;
+
+} /* end fcs_calc_init */
+
+const char *fcs_calc_name(void)
+{
+   return (engines[selected].name);
+}
+
+/*
+ * Use this for an AX.25 frame.
+ */
+
+unsigned short fcs_calc(unsigned char *data, int len)
+{
+   return (fcs_update(0xffff, data, len) ^ 0xffff);
 }
 
 /*
@@ -110,14 +441,5 @@ unsigned short fcs_calc(unsigned char *data, int len)
 
 unsigned short crc16(unsigned char *data, int len, unsigned short seed)
 {
-   unsigned short crc = seed;
-   int j;
-
-   for (j = 0; j < len; j++)
-   {
-
-      crc = ((crc) >> 8) ^ ccitt_table[((crc) ^ data[j]) & 0xff];
-   }
-
-   return (crc ^ 0xffff);
+   return (fcs_update(seed, data, len) ^ 0xffff);
 }
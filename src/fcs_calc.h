@@ -1,8 +1,25 @@
 
 /* fcs_calc.h */
 
+void fcs_calc_init(void);
+
+const char *fcs_calc_name(void);
+
 unsigned short fcs_calc(unsigned char *data, int len);
 
 unsigned short crc16(unsigned char *data, int len, unsigned short seed);
 
+/*
+ * Carry the CRC shift register along without the initial value or
+ * final inversion, for building it up a piece at a time.
+ *
+ *	fcs_calc (data, len) == fcs_update (0xffff, data, len) ^ 0xffff
+ *
+ * Best version for this CPU is picked by fcs_calc_init.
+ */
+
+typedef unsigned short (*fcs_update_fn_t)(unsigned short crc, const unsigned char *data, int len);
+
+extern fcs_update_fn_t fcs_update;
+
 /* end fcs_calc.h */
@@ -3,10 +3,13 @@
 #ifndef FSK_DEMOD_STATE_H
 
 #include <stdint.h> // int64_t
+#include <string.h> // memset
+#include <assert.h>
 
 #include "rpack.h"
 
 #include "audio.h" // for enum modem_t
+#include "dsp_kernel.h"
 
 /*
  * Demodulator state.
@@ -25,94 +28,177 @@ typedef enum bp_window_e
 	BP_WINDOW_FLATTOP
 } bp_window_t;
 
-// Experimental low pass filter to detect DC bias or low frequency changes.
-// IIR behaves like an analog R-C filter.
-// Intuitively, it seems like FIR would be better because it is based on a finite history.
-// However, it would require MANY taps and a LOT of computation for a low frequency.
-// We can use a little trick here to keep a running average.
-// This would be equivalent to convolving with an array of all 1 values.
-// That would eliminate the need to multiply.
-// We can also eliminate the need to add them all up each time by keeping a running total.
-// Add a sample to the total when putting it in our array of recent samples.
-// Subtract it from the total when it gets pushed off the end.
-// We can also eliminate the need to shift them all down by using a circular buffer.
-
-#define CIC_LEN_MAX 4000
-
-typedef struct cic_s
-{
-	int len;			   // Number of elements used.
-						   // Might want to dynamically allocate.
-	short in[CIC_LEN_MAX]; // Samples coming in.
-	int sum;			   // Running sum.
-	int inext;			   // Next position to fill.
-} cic_t;
-
 #define MAX_FILTER_SIZE 480 /* 401 is needed for profile A, 300 baud & 44100. Revisit someday. */
 							// Size comes out to 417 for 1200 bps with 48000 sample rate
 							// v1.7 - Was 404.  Bump up to 480.
 
-struct demodulator_state_s
+// Delay line for the FIR filters.
+// Originally each new sample was added at the beginning and all older samples
+// were shifted down with memmove.  That is a lot of copying for long filters.
+// Now we use a circular buffer twice the filter length.  Each sample is stored
+// twice, len apart, so the most recent len samples are always contiguous,
+// newest first, starting at buf + head.  The filter code doesn't need to know.
+// Version 1.8: The buffer is allocated, just big enough, by delay_line_init in dsp.c.
+
+typedef struct delay_line_s
 {
-	/*
-	 * These are set once during initialization.
-	 */
-	enum modem_t modem_type; // MODEM_AFSK, MODEM_8PSK, etc.
+	float *buf; // 2 * len, aligned to a cache line.
+	int len;	// Number of samples in the window.  Normally same as filter taps.
+	int head;	// Position of most recent sample.
+} delay_line_t;
 
-	char profile; // 'A', 'B', etc.	Upper case.
-				  // Only needed to see if we are using 'F' to take fast path.
+/* Add sample to the delay line.  Replaces push_sample which shifted the whole buffer. */
 
-#define TICKS_PER_PLL_CYCLE (256.0 * 256.0 * 256.0 * 256.0)
+__attribute__((hot)) __attribute__((always_inline)) static inline void delay_line_push(delay_line_t *dl, float val)
+{
+	dl->head = (dl->head == 0) ? dl->len - 1 : dl->head - 1;
+	dl->buf[dl->head] = val;
+	dl->buf[dl->head + dl->len] = val;
+}
 
-	int pll_step_per_sample; // PLL is advanced by this much each audio sample.
-							 // Data is sampled when it overflows.
+/* Most recent len samples, newest first. */
 
-	/*
-	 * Window type for the various filters.
-	 */
+__attribute__((hot)) __attribute__((always_inline)) static inline const float *delay_line_window(const delay_line_t *dl)
+{
+	return (dl->buf + dl->head);
+}
 
-	bp_window_t lp_window;
+// Same idea with 4 values per sample position, interleaved.
+// Used for the mark and space I & Q mixer outputs of profile A so one pass
+// over the low pass filter produces all four results.
 
-	/*
-	 * Alternate Low pass filters.
-	 * First is arbitrary number for quick IIR.
-	 * Second is frequency as ratio to baud rate for FIR.
-	 */
-	int lpf_use_fir; /* 0 for IIR, 1 for FIR. */
+typedef struct delay_line4_s
+{
+	float *buf; // 2 * len * 4.
+	int len;	// Number of sample positions in the window.
+	int head;	// Position of most recent set of samples.
+} delay_line4_t;
 
-	float lpf_iir; /* Only if using IIR. */
+__attribute__((hot)) __attribute__((always_inline)) static inline void delay_line4_push(delay_line4_t *dl, const float val[4])
+{
+	dl->head = (dl->head == 0) ? dl->len - 1 : dl->head - 1;
+	float *p = dl->buf + 4 * dl->head;
+	float *q = p + 4 * dl->len;
+	for (int k = 0; k < 4; k++)
+	{
+		p[k] = val[k];
+		q[k] = val[k];
+	}
+}
 
-	float lpf_baud; /* Cutoff frequency as fraction of baud. */
-	/* Intuitively we'd expect this to be somewhere */
-	/* in the range of 0.5 to 1. */
-	/* In practice, it turned out a little larger */
-	/* for profiles B, C, D. */
+/* Most recent len positions, newest first, 4 values each. */
 
-	float lp_filter_width_sym; /* Length in number of symbol times. */
+__attribute__((hot)) __attribute__((always_inline)) static inline const float *delay_line4_window(const delay_line4_t *dl)
+{
+	return (dl->buf + 4 * dl->head);
+}
 
-#define lp_filter_len_bits lp_filter_width_sym // FIXME: temp hack
+// 16 bit integer version for the fixed point profile "F".
 
-	int lp_filter_taps; /* Size of Low Pass filter, in audio samples. */
+typedef struct delay_line16_s
+{
+	int16_t *buf; // 2 * len.
+	int len;	  // Number of samples in the window.  Normally same as filter taps.
+	int head;	  // Position of most recent sample.
+} delay_line16_t;
 
-#define lp_filter_size lp_filter_taps // FIXME: temp hack
+__attribute__((hot)) __attribute__((always_inline)) static inline void delay_line16_push(delay_line16_t *dl, int16_t val)
+{
+	dl->head = (dl->head == 0) ? dl->len - 1 : dl->head - 1;
+	dl->buf[dl->head] = val;
+	dl->buf[dl->head + dl->len] = val;
+}
+
+__attribute__((hot)) __attribute__((always_inline)) static inline const int16_t *delay_line16_window(const delay_line16_t *dl)
+{
+	return (dl->buf + dl->head);
+}
+
+/*
+ * Number of slicers rounded up to a multiple of 4 so loops over
+ * all of them have a fixed length which fits the vector registers.
+ * The extra ones are computed and ignored.
+ */
+
+#define SLICER_BANK_SIZE ((MAX_SLICERS + 3) & ~3)
 
+struct demodulator_state_s
+{
 	/*
-	 * Automatic gain control.  Fast attack and slow decay factors.
+	 * Version 1.8: Reorganized.  Everything used for each audio sample
+	 * comes first, packed together, starting on a cache line.  Settings
+	 * only needed during initialization are at the end.
+	 *
+	 * Delay lines and filter taps are only pointers here.  The buffers
+	 * used to be in this structure, sized for the worst case, for every
+	 * profile whether used or not.  That was about 46 KB per demodulator
+	 * and, with several of them on one core, they kept pushing each other
+	 * out of the cache.  Now the buffers are allocated during
+	 * initialization, just big enough, only for the profile in use.
+	 *
+	 * A few fields which were never used were dropped along the way.
 	 */
-	float agc_fast_attack;
-	float agc_slow_decay;
 
 	/*
-	 * Use a longer term view for reporting signal levels.
+	 * For the PLL and data bit timing.
+	 * starting in version 1.2 we can have multiple slicers for one demodulator.
+	 * Each slicer has its own PLL and HDLC decoder.
 	 */
-	float quick_attack;
-	float sluggish_decay;
 
 	/*
-	 * Hysteresis before final demodulator 0 / 1 decision.
+	 * Version 1.3: Clean up subchan vs. slicer.
+	 *
+	 * Originally some number of CHANNELS (originally 2, later 6)
+	 * which can have multiple parallel demodulators called SUB-CHANNELS.
+	 * This was originally for staggered frequencies for HF SSB.
+	 * It can also be used for multiple demodulators with the same
+	 * frequency but other differing parameters.
+	 * Each subchannel has its own demodulator and HDLC decoder.
+	 *
+	 * In version 1.2 we added multiple SLICERS.
+	 * The data structure, here, has multiple slicers per
+	 * demodulator (subchannel).  Due to fuzzy thinking or
+	 * expediency, the multiple slicers got mapped into subchannels.
+	 * This means we can't use both multiple decoders and
+	 * multiple slicers at the same time.
+	 *
+	 * Clean this up in 1.3 and keep the concepts separate.
+	 * This means adding a third variable many places
+	 * we are passing around the origin.
+	 *
 	 */
-	float hysteresis;
-	int num_slicers; /* >1 for multiple slicers. */
+
+	/*
+	 * The DPLL for each slicer is kept here, as separate arrays, rather than
+	 * in the slicer structure below.  That way the compiler can update all
+	 * of the slicers together with vector instructions.
+	 * See slicer_bank in demod_afsk.c.
+	 */
+
+	signed int data_clock_pll[SLICER_BANK_SIZE] __attribute__((aligned(64)));
+	// PLL for data clock recovery.
+	// It is incremented by pll_step_per_sample
+	// for each audio sample.
+	// Must be 32 bits!!!
+	// So far, this is the case for every compiler used.
+
+	signed int prev_demod_data[SLICER_BANK_SIZE] __attribute__((aligned(16)));
+	// Previous data bit detected.
+	// Used to look for transitions.
+
+	/*
+	 * Version 1.8: Bits sampled by each slicer of slicer_bank, oldest in
+	 * the LSB, waiting to go to hdlc_rec_bits in one call.
+	 * See demod_afsk_flush.
+	 */
+
+	uint64_t rec_bits[MAX_SLICERS];
+	int rec_nbits[MAX_SLICERS];
+
+#define TICKS_PER_PLL_CYCLE (256.0 * 256.0 * 256.0 * 256.0)
+
+	int pll_step_per_sample; // PLL is advanced by this much each audio sample.
+							 // Data is sampled when it overflows.
 
 	/*
 	 * Phase Locked Loop (PLL) inertia.
@@ -122,36 +208,58 @@ struct demodulator_state_s
 	float pll_locked_inertia;
 	float pll_searching_inertia;
 
+	int num_slicers; /* >1 for multiple slicers. */
+
+	unsigned int active_slicers; /* Bit mask of slicers to run.  0 to skip this demodulator. */
+								 /* Version 1.8: Changed by RXPRUNE, see multi_modem.c. */
+
+	unsigned int dcd_reported; /* Version 1.8: data_detect of each slicer, as a bit mask, */
+							   /* last passed to dcd_change.  See demod_afsk_flush. */
+
+	char profile; // 'A', 'B', etc.	Upper case.
+				  // Only needed to see if we are using 'F' to take fast path.
+
 	/*
 	 * Optional band pass pre-filter before mark/space detector.
 	 */
 	int use_prefilter; /* True to enable it. */
 
-	float prefilter_baud; /* Cutoff frequencies, as fraction of */
-						  /* baud rate, beyond tones used.  */
-						  /* Example, if we used 1600/1800 tones at */
-						  /* 300 baud, and this was 0.5, the cutoff */
-						  /* frequencies would be: */
-						  /* lower = min(1600,1800) - 0.5 * 300 = 1450 */
-						  /* upper = max(1600,1800) + 0.5 * 300 = 1950 */
+	int pre_filter_taps;				// Calculated number of filter taps.
+#define pre_filter_size pre_filter_taps // temp until all references changed.
 
-	float pre_filter_len_sym;				   // Length in number of symbol times.
-#define pre_filter_len_bits pre_filter_len_sym // temp until all references changed.
+	const float *pre_filter; /* Version 1.8: Shared with others the same.  See dsp_cached_bandpass. */
 
-	bp_window_t pre_window; // Window type for filter shaping.
+	dsp_convolve_fn_t pre_convolve; /* Version 1.8: Kernel for that size. */
 
-	int pre_filter_taps;				// Calculated number of filter taps.
-#define pre_filter_size pre_filter_taps // temp until all references changed.
+	delay_line_t raw_cb; // audio in,  need better name.
+
+	/*
+	 * Outputs from the mark and space amplitude detection,
+	 * used as inputs to the FIR lowpass filters.
+	 * Kernel for the lowpass filters.
+	 * Version 1.8: Shared with others the same.  See dsp_cached_lowpass.
+	 */
+
+	const float *lp_filter;
 
-	float pre_filter[MAX_FILTER_SIZE] __attribute__((aligned(16)));
+	int lp_filter_taps; /* Size of Low Pass filter, in audio samples. */
+
+#define lp_filter_size lp_filter_taps // FIXME: temp hack
 
-	float raw_cb[MAX_FILTER_SIZE] __attribute__((aligned(16))); // audio in,  need better name.
+	dsp_convolve_fn_t lp_convolve;	 /* Version 1.8: Kernels for that size.  See dsp_convolve_for. */
+	dsp_convolve4_fn_t lp_convolve4;
 
 	/*
-	 * The rest are continuously updated.
+	 * Automatic gain control.  Fast attack and slow decay factors.
 	 */
+	float agc_fast_attack;
+	float agc_slow_decay;
 
-	unsigned int lo_phase; /* Local oscillator for PSK. */
+	/*
+	 * Use a longer term view for reporting signal levels.
+	 */
+	float quick_attack;
+	float sluggish_decay;
 
 	/*
 	 * Use half of the AGC code to get a measure of input audio amplitude.
@@ -161,74 +269,40 @@ struct demodulator_state_s
 
 	float alevel_rec_peak;
 	float alevel_rec_valley;
-	float alevel_mark_peak;
-	float alevel_space_peak;
 
 	/*
-	 * Outputs from the mark and space amplitude detection,
-	 * used as inputs to the FIR lowpass filters.
-	 * Kernel for the lowpass filters.
+	 * Version 1.8: The audio level for demod_get_audio_level, from the
+	 * above and the mark and space levels.  The thread running this
+	 * demodulator stores it, atomically, after each block.  Frames can
+	 * be finished by other DEMODTHREADS groups, which only read this.
 	 */
 
-	float lp_filter[MAX_FILTER_SIZE] __attribute__((aligned(16)));
-
-	float m_peak, s_peak;
-	float m_valley, s_valley;
-	float m_amp_prev, s_amp_prev;
+	int alevel_snap_rec;
+	int alevel_snap_mark;
+	int alevel_snap_space;
 
 	/*
-	 * For the PLL and data bit timing.
-	 * starting in version 1.2 we can have multiple slicers for one demodulator.
-	 * Each slicer has its own PLL and HDLC decoder.
-	 */
-
-	/*
-	 * Version 1.3: Clean up subchan vs. slicer.
-	 *
-	 * Originally some number of CHANNELS (originally 2, later 6)
-	 * which can have multiple parallel demodulators called SUB-CHANNELS.
-	 * This was originally for staggered frequencies for HF SSB.
-	 * It can also be used for multiple demodulators with the same
-	 * frequency but other differing parameters.
-	 * Each subchannel has its own demodulator and HDLC decoder.
-	 *
-	 * In version 1.2 we added multiple SLICERS.
-	 * The data structure, here, has multiple slicers per
-	 * demodulator (subchannel).  Due to fuzzy thinking or
-	 * expediency, the multiple slicers got mapped into subchannels.
-	 * This means we can't use both multiple decoders and
-	 * multiple slicers at the same time.
-	 *
-	 * Clean this up in 1.3 and keep the concepts separate.
-	 * This means adding a third variable many places
-	 * we are passing around the origin.
-	 *
+	 * Version 1.8: The AGC envelopes and the mark and space levels for
+	 * display, side by side, with the attack and decay for each.  One
+	 * pass without branches updates all of them.  Valleys are negated
+	 * so the same rule works for every one:  attack when the input is
+	 * beyond it, otherwise decay.  See env_track in demod_afsk.c.
 	 */
-	struct
-	{
-
-		signed int data_clock_pll; // PLL for data clock recovery.
-								   // It is incremented by pll_step_per_sample
-								   // for each audio sample.
-								   // Must be 32 bits!!!
-								   // So far, this is the case for every compiler used.
-
-		signed int prev_d_c_pll; // Previous value of above, before
-								 // incrementing, to detect overflows.
 
-		int pll_symbol_count;	 // Number symbols during time nudge_total is accumulated.
-		int64_t pll_nudge_total; // Sum of DPLL nudge amounts.
-								 // Both of these are cleared at start of frame.
-								 // At end of frame, we can see if incoming
-								 // baud rate is a little off.
+#define ENV_M_PEAK 0
+#define ENV_S_PEAK 1
+#define ENV_M_VALLEY 2	  /* Negated. */
+#define ENV_S_VALLEY 3	  /* Negated. */
+#define ENV_MARK_LEVEL 4  /* For display.  -1 if not available. */
+#define ENV_SPACE_LEVEL 5 /* For display. */
+#define ENV_LANES 8		  /* Rounded up for SIMD.  Extras stay 0. */
 
-		int prev_demod_data; // Previous data bit detected.
-							 // Used to look for transitions.
-		float prev_demod_out_f;
+	float env[ENV_LANES] __attribute__((aligned(16)));
+	float env_attack[ENV_LANES] __attribute__((aligned(16)));
+	float env_decay[ENV_LANES] __attribute__((aligned(16)));
 
-		/* This is used only for "9600" baud data. */
-
-		int lfsr; // Descrambler shift register.
+	struct
+	{
 
 		// This is for detecting phase lock to incoming signal.
 
@@ -267,19 +341,20 @@ struct demodulator_state_s
 		unsigned int c_osc_delta; // How much to change for each audio sample.
 
 		// Need two mixers for profile "A".
+		// Mark I, mark Q, space I, space Q are interleaved so
+		// they can all be filtered in a single pass.
 
-		float m_I_raw[MAX_FILTER_SIZE] __attribute__((aligned(16)));
-		float m_Q_raw[MAX_FILTER_SIZE] __attribute__((aligned(16)));
+		delay_line4_t ms_IQ_raw;
 
-		float s_I_raw[MAX_FILTER_SIZE] __attribute__((aligned(16)));
-		float s_Q_raw[MAX_FILTER_SIZE] __attribute__((aligned(16)));
+		// Only need one mixer for profile "B".
+		// Version 1.8: Each profile allocates only the ones it uses.
 
-		// Only need one mixer for profile "B".  Reuse the same storage?
+		delay_line_t c_I_raw;
+		delay_line_t c_Q_raw;
 
-		// #define c_I_raw m_I_raw
-		// #define c_Q_raw m_Q_raw
-		float c_I_raw[MAX_FILTER_SIZE] __attribute__((aligned(16)));
-		float c_Q_raw[MAX_FILTER_SIZE] __attribute__((aligned(16)));
+		float prev_phase; // To see phase shift between samples for FM demod.
+
+		float normalize_rpsam; // Normalize to -1 to +1 for expected tones.
 
 		int use_rrc; // Use RRC rather than generic low pass.
 
@@ -287,11 +362,100 @@ struct demodulator_state_s
 
 		float rrc_rolloff; /* Rolloff factor for RRC.  Between 0 and 1. */
 
-		float prev_phase; // To see phase shift between samples for FM demod.
+	} afsk;
 
-		float normalize_rpsam; // Normalize to -1 to +1 for expected tones.
+	/*
+	 * Profile "F" is the same as "A" but done entirely with integers
+	 * for processors with slow floating point, such as ARMv6.
+	 * Demodulator output goes thru the same PLL as the others.
+	 */
 
-	} afsk;
+	struct afsk_fixed_s
+	{
+
+		const int16_t *pre_filter; // Same as above scaled by 2 ** pre_shift.
+		int pre_shift;
+
+		const int16_t *lp_filter; // Same as above scaled by 2 ** lp_shift.
+		int lp_shift;
+
+		delay_line16_t raw_cb; // Audio samples, for the prefilter.
+
+		delay_line16_t m_I_raw; // Mixer outputs, for the low pass filter.
+		delay_line16_t m_Q_raw;
+		delay_line16_t s_I_raw;
+		delay_line16_t s_Q_raw;
+
+		// AGC envelopes, in units of the tone amplitude scaled by 2 ** FIXED_AGC_FRAC.
+
+		int32_t m_peak, m_valley;
+		int32_t s_peak, s_valley;
+
+		int32_t agc_fast_attack; // Same as agc_fast_attack and agc_slow_decay
+		int32_t agc_slow_decay;	 // scaled by 2 ** 24.
+
+	} fixed;
+
+	/*
+	 * Profile "G" uses a sliding DFT, one bin each for mark and space,
+	 * rather than the low pass filters.  The DFT over a window of one
+	 * symbol is a running sum of the most recent mixer outputs so it
+	 * costs a few additions per sample no matter how long the window.
+	 * The same local oscillators as profile "A" are used.
+	 */
+
+	struct afsk_sdft_s
+	{
+
+		float sum[4] __attribute__((aligned(16))); // Sum of everything in ring.
+
+		float (*ring)[4]; // [window] Mark I, mark Q, space I, space Q.
+		int window;		  // Window length in audio samples, rounded.
+		int next;		  // Oldest entry in ring, replaced next.
+
+		float scale; // 1 / window so the amplitude is about the same as "A".
+
+		float width_sym; // Window length in symbol times.
+
+	} sdft;
+
+	/*
+	 * The rest are set once during initialization and only used to
+	 * calculate the filters and such above.
+	 */
+
+	/*
+	 * Window type for the various filters.
+	 */
+
+	bp_window_t lp_window;
+
+	/*
+	 * Low pass filter.  Frequency as ratio to baud rate for FIR.
+	 */
+
+	float lpf_baud; /* Cutoff frequency as fraction of baud. */
+	/* Intuitively we'd expect this to be somewhere */
+	/* in the range of 0.5 to 1. */
+	/* In practice, it turned out a little larger */
+	/* for profiles B, C, D. */
+
+	float lp_filter_width_sym; /* Length in number of symbol times. */
+
+#define lp_filter_len_bits lp_filter_width_sym // FIXME: temp hack
+
+	float prefilter_baud; /* Cutoff frequencies, as fraction of */
+						  /* baud rate, beyond tones used.  */
+						  /* Example, if we used 1600/1800 tones at */
+						  /* 300 baud, and this was 0.5, the cutoff */
+						  /* frequencies would be: */
+						  /* lower = min(1600,1800) - 0.5 * 300 = 1450 */
+						  /* upper = max(1600,1800) + 0.5 * 300 = 1950 */
+
+	float pre_filter_len_sym;				   // Length in number of symbol times.
+#define pre_filter_len_bits pre_filter_len_sym // temp until all references changed.
+
+	bp_window_t pre_window; // Window type for filter shaping.
 };
 
 /*-------------------------------------------------------------------
@@ -303,10 +467,6 @@ struct demodulator_state_s
  *
  * Inputs:	D		Pointer to demodulator state.
  *
- *		chan		Radio channel: 0 to MAX_CHANS - 1
- *
- *		subchan		Which of multiple demodulators: 0 to MAX_SUBCHANS - 1
- *
  *		slice		Slicer number: 0 to MAX_SLICERS - 1.
  *
  *		dpll_phase	Signed 32 bit counter for DPLL phase.
@@ -315,6 +475,10 @@ struct demodulator_state_s
  *
  * Output:	D->slicer[slice].data_detect - true when PLL is locked to incoming signal.
  *
+ *		Version 1.8: dcd_change is no longer called from here for each
+ *		symbol.  Changes are passed along once for each block of
+ *		audio by demod_afsk_flush.
+ *
  * Description:	From the beginning, DCD was based on finding several flag octets
  *		in a row and dropping when eight bits with no transitions.
  *		It was less than ideal but we limped along with it all these years.
@@ -326,8 +490,6 @@ struct demodulator_state_s
  *
  *--------------------------------------------------------------------*/
 
-#include "hdlc_rec.h" // for dcd_change
-
 // These are good for 1200 bps AFSK.
 // Might want to override for other modems.
 
@@ -357,7 +519,7 @@ __attribute__((always_inline)) inline static void pll_dcd_signal_transition2(str
 	}
 }
 
-__attribute__((always_inline)) inline static void pll_dcd_each_symbol2(struct demodulator_state_s *D, int chan, int subchan, int slice)
+__attribute__((always_inline)) inline static void pll_dcd_each_symbol2(struct demodulator_state_s *D, int slice)
 {
 	D->slicer[slice].good_hist <<= 1;
 	D->slicer[slice].good_hist |= D->slicer[slice].good_flag;
@@ -374,19 +536,11 @@ __attribute__((always_inline)) inline static void pll_dcd_each_symbol2(struct de
 	int s = __builtin_popcount(D->slicer[slice].score);
 	if (s >= DCD_THRESH_ON)
 	{
-		if (D->slicer[slice].data_detect == 0)
-		{
-			D->slicer[slice].data_detect = 1;
-			dcd_change(chan, subchan, slice, D->slicer[slice].data_detect);
-		}
+		D->slicer[slice].data_detect = 1;
 	}
 	else if (s <= DCD_THRESH_OFF)
 	{
-		if (D->slicer[slice].data_detect != 0)
-		{
-			D->slicer[slice].data_detect = 0;
-			dcd_change(chan, subchan, slice, D->slicer[slice].data_detect);
-		}
+		D->slicer[slice].data_detect = 0;
 	}
 }
 
@@ -15,6 +15,9 @@ struct rs
   unsigned char fcr;       /* First consecutive root, index form */
   unsigned char prim;      /* Primitive element, index form */
   unsigned char iprim;     /* prim-th root of 1, index form */
+  unsigned char *mul_tab;  /* For each alpha**i, products with low and high nibbles */
+                           /* (16 bytes each) for vector multiply.  NULL if not used. */
+  unsigned char *enc_tab;  /* For each feedback value, what it adds to each check byte. */
 };
 
 #define MM (rs->mm)
@@ -56,13 +59,26 @@ struct rs *INIT_RS(unsigned int symsize, unsigned int gfpoly,
 
 void FREE_RS(struct rs *rs);
 
+int rs_simd_supported(void);
+
 // These 3 are the external interface.
 // Maybe these should be in a different file, separated from the internal stuff.
 
 void fx25_init(int debug_level);
 int fx25_send_frame(int chan, unsigned char *fbuf, int flen, int fx_mode);
+int fx25_encode_frame(int chan, unsigned char *fbuf, int flen, int fx_mode, unsigned char *out);
 void fx25_rec_bit(int chan, int subchan, int slice, int dbit);
-int fx25_rec_busy(int chan);
+int fx25_rec_busy(int chan, unsigned int *since);
+
+struct audio_s;
+void fx25_rec_init(struct audio_s *pa);
+
+// Receive context for one slicer, NULL if FX.25 reception is off.
+// Bits can be given directly to it, without looking it up every time.
+
+typedef struct fx_context_s *fx25_rec_t;
+fx25_rec_t fx25_rec_context(int chan, int subchan, int slice);
+void fx25_rec_bits(fx25_rec_t F, unsigned int data, int n);
 
 // Other functions in fx25_init.c.
 
@@ -84,6 +100,7 @@ void fx_hex_dump(unsigned char *x, int len);
 
 #define FX25_MAX_DATA 239   // i.e. RS(255,239)
 #define FX25_MAX_CHECK 64   // e.g. RS(255, 191)
+#define FX25_MAX_BLOCK (8 + FX25_MAX_DATA + FX25_MAX_CHECK) // Tag, data, and check bytes.
 #define FX25_BLOCK_SIZE 255 // Block size always 255 for 8 bit symbols.
 
 #endif // FX25_H
\ No newline at end of file
@@ -59,24 +59,19 @@ void ENCODE_RS(struct rs *restrict rs, DTYPE *restrict data, DTYPE *restrict bb)
 {
 
   int i, j;
-  DTYPE feedback;
 
   memset(bb, 0, NROOTS * sizeof(DTYPE)); // clear out the FEC data area
 
+  // Version 1.8: Shift and add the precomputed row for the feedback value.
+  // rs->enc_tab[f*NROOTS + j] is f times GENPOLY[NROOTS-1-j], in poly form.
+
   for (i = 0; i < NN - NROOTS; i++)
   {
-    feedback = INDEX_OF[data[i] ^ bb[0]];
-    if (feedback != A0)
-    { /* feedback term is non-zero */
-      for (j = 1; j < NROOTS; j++)
-        bb[j] ^= ALPHA_TO[MODNN(feedback + GENPOLY[NROOTS - j])];
-    }
-    /* Shift */
-    memmove(&bb[0], &bb[1], sizeof(DTYPE) * (NROOTS - 1));
-    if (feedback != A0)
-      bb[NROOTS - 1] = ALPHA_TO[MODNN(feedback + GENPOLY[0])];
-    else
-      bb[NROOTS - 1] = 0;
+    const DTYPE *row = rs->enc_tab + (data[i] ^ bb[0]) * NROOTS;
+
+    for (j = 0; j < NROOTS - 1; j++)
+      bb[j] = bb[j + 1] ^ row[j];
+    bb[NROOTS - 1] = row[NROOTS - 1];
   }
 }
 
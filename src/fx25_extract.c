@@ -82,6 +82,160 @@
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+//-----------------------------------------------------------------------
+// Version 1.8:  Vector versions of the syndrome calculation and
+// Chien search, the parts which go thru all 255 symbols.
+//
+// Multiplying by a constant, in GF(256), is linear so the product of
+// each nibble can be looked up separately and combined with xor.
+// A 16 entry table fits in a register so 16 symbols can be multiplied
+// by the same constant with two table lookup instructions, PSHUFB on
+// x86 (SSSE3) or TBL on ARM (NEON).  rs->mul_tab has the two tables for
+// each power of alpha.  It is not allocated if the CPU can't do this.
+//-----------------------------------------------------------------------
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(__APPLE__)
+
+#define RS_SIMD_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+
+#define RS_SIMD_TARGET __attribute__((target("ssse3")))
+typedef __m128i vsym_t;
+#define V_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define V_ZERO() _mm_setzero_si128()
+#define V_SET1(x) _mm_set1_epi8((char)(x))
+#define V_XOR(a, b) _mm_xor_si128((a), (b))
+#define V_MUL(v, tab) _mm_xor_si128(                                                         \
+  _mm_shuffle_epi8(V_LOAD(tab), _mm_and_si128((v), _mm_set1_epi8(0x0f))),                 \
+  _mm_shuffle_epi8(V_LOAD((tab) + 16), _mm_and_si128(_mm_srli_epi16((v), 4), _mm_set1_epi8(0x0f))))
+#define V_ZERO_MASK(v) _mm_movemask_epi8(_mm_cmpeq_epi8((v), _mm_setzero_si128()))
+
+#elif defined(__aarch64__) && defined(__GNUC__)
+
+#define RS_SIMD_ARM 1
+#include <arm_neon.h>
+
+#define RS_SIMD_TARGET
+typedef uint8x16_t vsym_t;
+#define V_LOAD(p) vld1q_u8(p)
+#define V_STORE(p, v) vst1q_u8((p), (v))
+#define V_ZERO() vdupq_n_u8(0)
+#define V_SET1(x) vdupq_n_u8(x)
+#define V_XOR(a, b) veorq_u8((a), (b))
+#define V_MUL(v, tab) veorq_u8(vqtbl1q_u8(V_LOAD(tab), vandq_u8((v), vdupq_n_u8(0x0f))), \
+                 vqtbl1q_u8(V_LOAD((tab) + 16), vshrq_n_u8((v), 4)))
+
+#endif
+
+#if RS_SIMD_X86 || RS_SIMD_ARM
+
+#define MUL_TAB(e) (rs->mul_tab + (e) * 32)
+
+/*
+ * Syndromes, in poly form.  Rather than Horner's rule one symbol at a time,
+ * lane k accumulates symbols k, k+16, k+32, ... multiplied by alpha**(16*root)
+ * at each step.  Then the lanes are combined with their own powers.
+ * A zero in front makes 256 symbols, which doesn't change the result.
+ */
+
+RS_SIMD_TARGET static void syndromes_simd(struct rs *restrict rs, const DTYPE *restrict data, DTYPE *s)
+{
+  DTYPE buf[256], lanes[16];
+  int i, k, m;
+
+  buf[0] = 0;
+  memcpy(buf + 1, data, 255);
+
+  for (i = 0; i < NROOTS; i++)
+  {
+    int e = MODNN((FCR + i) * PRIM);
+    const DTYPE *tab = MUL_TAB(MODNN(16 * e));
+    vsym_t acc = V_LOAD(buf);
+
+    for (m = 1; m < 16; m++)
+    {
+      acc = V_XOR(V_MUL(acc, tab), V_LOAD(buf + m * 16));
+    }
+    V_STORE(lanes, acc);
+
+    s[i] = lanes[15];
+    for (k = 0; k < 15; k++)
+    {
+      if (lanes[k] != 0)
+        s[i] ^= ALPHA_TO[MODNN(INDEX_OF[lanes[k]] + e * (15 - k))];
+    }
+  }
+}
+
+/*
+ * Chien search, 16 points at once.  Lane k of term[j] holds
+ * lambda[j] * alpha**(j*i) for point i of the current group.
+ * For the next group, multiply all lanes by alpha**(16*j).
+ * Same roots, in the same order, as the original.
+ */
+
+RS_SIMD_TARGET static int chien_simd(struct rs *restrict rs, const DTYPE *lambda, int deg_lambda, DTYPE *root, DTYPE *loc)
+{
+  vsym_t term[FX25_MAX_CHECK + 1];
+  DTYPE init[16], q[16];
+  int i, j, k, count = 0;
+
+  for (j = 1; j <= deg_lambda; j++)
+  {
+    for (k = 0; k < 16; k++)
+    {
+      init[k] = lambda[j] == A0 ? 0 : ALPHA_TO[MODNN(lambda[j] + j * (k + 1))];
+    }
+    term[j] = V_LOAD(init);
+  }
+
+  for (i = 1; i <= NN; i += 16)
+  {
+    vsym_t sum = V_SET1(1); /* lambda[0] is always 0 */
+
+    for (j = 1; j <= deg_lambda; j++)
+    {
+      sum = V_XOR(sum, term[j]);
+      term[j] = V_MUL(term[j], MUL_TAB(MODNN(16 * j)));
+    }
+
+#if RS_SIMD_X86
+    if (V_ZERO_MASK(sum) == 0)
+      continue;
+#endif
+    V_STORE(q, sum);
+    for (k = 0; k < 16 && i + k <= NN; k++)
+    {
+      if (q[k] != 0)
+        continue;
+      root[count] = i + k;
+      loc[count] = MODNN(IPRIM - 1 + (i + k - 1) * IPRIM);
+      if (++count == deg_lambda)
+        return (count);
+    }
+  }
+  return (count);
+}
+
+#endif
+
+/* Can this CPU do the vector versions? */
+
+int rs_simd_supported(void)
+{
+#if RS_SIMD_X86
+  unsigned int eax, ebx, ecx, edx;
+
+  return (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3));
+#elif RS_SIMD_ARM
+  return (1);
+#else
+  return (0);
+#endif
+}
+
 int DECODE_RS(struct rs *restrict rs, DTYPE *restrict data, int *eras_pos, int no_eras)
 {
 
@@ -97,20 +251,29 @@ int DECODE_RS(struct rs *restrict rs, DTYPE *restrict data, int *eras_pos, int n
   int syn_error, count;
 
   /* form the syndromes; i.e., evaluate data(x) at roots of g(x) */
-  for (i = 0; i < NROOTS; i++)
-    s[i] = data[0];
-
-  for (j = 1; j < NN; j++)
+#if RS_SIMD_X86 || RS_SIMD_ARM
+  if (rs->mul_tab != NULL)
+  {
+    syndromes_simd(rs, data, s);
+  }
+  else
+#endif
   {
     for (i = 0; i < NROOTS; i++)
+      s[i] = data[0];
+
+    for (j = 1; j < NN; j++)
     {
-      if (s[i] == 0)
-      {
-        s[i] = data[j];
-      }
-      else
+      for (i = 0; i < NROOTS; i++)
       {
-        s[i] = data[j] ^ ALPHA_TO[MODNN(INDEX_OF[s[i]] + (FCR + i) * PRIM)];
+        if (s[i] == 0)
+        {
+          s[i] = data[j];
+        }
+        else
+        {
+          s[i] = data[j] ^ ALPHA_TO[MODNN(INDEX_OF[s[i]] + (FCR + i) * PRIM)];
+        }
       }
     }
   }
@@ -256,32 +419,41 @@ int DECODE_RS(struct rs *restrict rs, DTYPE *restrict data, int *eras_pos, int n
       deg_lambda = i;
   }
   /* Find roots of the error+erasure locator polynomial by Chien search */
-  memcpy(&reg[1], &lambda[1], NROOTS * sizeof(reg[0]));
-  count = 0; /* Number of roots of lambda(x) */
-  for (i = 1, k = IPRIM - 1; i <= NN; i++, k = MODNN(k + IPRIM))
+#if RS_SIMD_X86 || RS_SIMD_ARM
+  if (rs->mul_tab != NULL)
   {
-    q = 1; /* lambda[0] is always 0 */
-    for (j = deg_lambda; j > 0; j--)
+    count = chien_simd(rs, lambda, deg_lambda, root, loc);
+  }
+  else
+#endif
+  {
+    memcpy(&reg[1], &lambda[1], NROOTS * sizeof(reg[0]));
+    count = 0; /* Number of roots of lambda(x) */
+    for (i = 1, k = IPRIM - 1; i <= NN; i++, k = MODNN(k + IPRIM))
     {
-      if (reg[j] != A0)
+      q = 1; /* lambda[0] is always 0 */
+      for (j = deg_lambda; j > 0; j--)
       {
-        reg[j] = MODNN(reg[j] + j);
-        q ^= ALPHA_TO[reg[j]];
+        if (reg[j] != A0)
+        {
+          reg[j] = MODNN(reg[j] + j);
+          q ^= ALPHA_TO[reg[j]];
+        }
       }
-    }
-    if (q != 0)
-      continue; /* Not a root */
-                /* store root (index-form) and error location number */
+      if (q != 0)
+        continue; /* Not a root */
+                  /* store root (index-form) and error location number */
 #if DEBUG >= 2
-    fprintf(stderr, "count %d root %d loc %d\n", count, i, k);
+      fprintf(stderr, "count %d root %d loc %d\n", count, i, k);
 #endif
-    root[count] = i;
-    loc[count] = k;
-    /* If we've already found max possible roots,
-     * abort the search to save time
-     */
-    if (++count == deg_lambda)
-      break;
+      root[count] = i;
+      loc[count] = k;
+      /* If we've already found max possible roots,
+       * abort the search to save time
+       */
+      if (++count == deg_lambda)
+        break;
+    }
   }
   if (deg_lambda != count)
   {
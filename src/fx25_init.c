@@ -59,6 +59,7 @@
 #include <assert.h>
 
 #include "fx25.h"
+#include "dwthread.h"
 
 #define NTAB 3
 
@@ -70,7 +71,7 @@ static struct
 	int prim;	   // Primitive element to generate polynomial roots.
 	int nroots;	   // RS code generator polynomial degree (number of roots).
 				   // Same as number of check bytes added.
-	struct rs *rs; // Pointer to RS codec control block.  Filled in at init time.
+	struct rs *rs; // Pointer to RS codec control block.  Filled in on first use.
 } Tab[NTAB] = {
 	{8, 0x11d, 1, 1, 16, NULL}, // RS(255,239)
 	{8, 0x11d, 1, 1, 32, NULL}, // RS(255,223)
@@ -139,10 +140,49 @@ static const struct correlation_tag_s tags[16] = {
 // in an integer.  This can result in a single machine instruction.  You might need
 // to supply your own popcount function if using a different compiler.
 
-int fx25_tag_find_match(uint64_t t)
+// Version 1.8: This is called for every bit, for every subchannel and slicer,
+// so comparing with all of the tags each time adds up.
+// If no more than CLOSE_ENOUGH bits are wrong, and the value is split into
+// CLOSE_ENOUGH+1 pieces, at least one of the pieces must be exactly right.
+// For each piece, keep a bit mask of the tags having each possible value.
+// Only tags which have at least one piece exactly right need the full check.
+// For random noise, that is less than one tag per bit on average.
+
+#define PIECE_BITS 7
+#define NUM_PIECES (CLOSE_ENOUGH + 1)
+
+#if NUM_PIECES * PIECE_BITS > 64
+#error "Correlation tag pieces don't fit in 64 bits."
+#endif
+
+static uint16_t piece_tags[NUM_PIECES][1 << PIECE_BITS];
+
+static void piece_tags_init(void)
 {
+	memset(piece_tags, 0, sizeof(piece_tags));
+
 	for (int c = CTAG_MIN; c <= CTAG_MAX; c++)
 	{
+		for (int p = 0; p < NUM_PIECES; p++)
+		{
+			piece_tags[p][(tags[c].value >> (p * PIECE_BITS)) & ((1 << PIECE_BITS) - 1)] |= 1 << c;
+		}
+	}
+}
+
+int fx25_tag_find_match(uint64_t t)
+{
+	unsigned int maybe = 0;
+
+	for (int p = 0; p < NUM_PIECES; p++)
+	{
+		maybe |= piece_tags[p][(t >> (p * PIECE_BITS)) & ((1 << PIECE_BITS) - 1)];
+	}
+
+	while (maybe != 0)
+	{
+		int c = __builtin_ctz(maybe); // Lowest first, same as checking them in order.
+
 		if (__builtin_popcountll(t ^ tags[c].value) <= CLOSE_ENOUGH)
 		{
 			// printf ("%016" PRIx64 " received\n", t);
@@ -150,15 +190,16 @@ int fx25_tag_find_match(uint64_t t)
 			// printf ("%016" PRIx64 " xor, popcount = %d\n", t ^ tags[c].value, __builtin_popcountll(t ^ tags[c].value));
 			return (c);
 		}
+		maybe &= maybe - 1;
 	}
 	return (-1);
 }
 
 void free_rs_char(struct rs *rs)
 {
-	free(rs->alpha_to);
-	free(rs->index_of);
+	// Galois field tables are shared.  See INIT_RS.
 	free(rs->genpoly);
+	free(rs->enc_tab);
 	free(rs);
 }
 
@@ -177,26 +218,22 @@ void free_rs_char(struct rs *rs)
  *
  *			Use command line -dx to increase level or -qx for quiet.
  *
- * Description:	Initialize 3 Reed-Solomon codecs, for 16, 32, and 64 check bytes.
+ * Description:	Check the tables.  Version 1.8: The 3 Reed-Solomon codecs,
+ *		for 16, 32, and 64 check bytes, are no longer set up here.
+ *		fx25_get_rs does that the first time each one is needed.
+ *		Most stations never see some of them.
  *
  *--------------------------------------------------------------*/
 
 static int g_debug_level;
 
+static dw_mutex_t rs_init_mutex; // For creating the codecs on first use.
+
 void fx25_init(int debug_level)
 {
 	g_debug_level = debug_level;
 
-	for (int i = 0; i < NTAB; i++)
-	{
-		Tab[i].rs = INIT_RS(Tab[i].symsize, Tab[i].genpoly, Tab[i].fcs, Tab[i].prim, Tab[i].nroots);
-		if (Tab[i].rs == NULL)
-		{
-
-			printf("FX.25 internal error: init_rs_char failed!\n");
-			exit(EXIT_FAILURE);
-		}
-	}
+	dw_mutex_init(&rs_init_mutex);
 
 	// Verify integrity of tables and assumptions.
 	// This also does a quick check for the popcount function.
@@ -216,6 +253,8 @@ void fx25_init(int debug_level)
 		}
 	}
 
+	piece_tags_init();
+
 	for (int j = CTAG_MIN; j <= CTAG_MAX; j++)
 	{
 		assert(tags[j].n_block_radio - tags[j].k_data_radio == Tab[tags[j].itab].nroots);
@@ -267,8 +306,31 @@ struct rs *fx25_get_rs(int ctag_num)
 {
 	assert(ctag_num >= CTAG_MIN && ctag_num <= CTAG_MAX);
 	assert(tags[ctag_num].itab >= 0 && tags[ctag_num].itab < NTAB);
-	assert(Tab[tags[ctag_num].itab].rs != NULL);
-	return (Tab[tags[ctag_num].itab].rs);
+
+	int i = tags[ctag_num].itab;
+	struct rs *rs = __atomic_load_n(&Tab[i].rs, __ATOMIC_ACQUIRE);
+
+	if (rs == NULL)
+	{
+		// Could be wanted by more than one receive thread at once,
+		// and by transmit.  Only one creates it.
+
+		dw_mutex_lock(&rs_init_mutex);
+		rs = Tab[i].rs;
+		if (rs == NULL)
+		{
+			rs = INIT_RS(Tab[i].symsize, Tab[i].genpoly, Tab[i].fcs, Tab[i].prim, Tab[i].nroots);
+			if (rs == NULL)
+			{
+
+				printf("FX.25 internal error: init_rs_char failed!\n");
+				exit(EXIT_FAILURE);
+			}
+			__atomic_store_n(&Tab[i].rs, rs, __ATOMIC_RELEASE);
+		}
+		dw_mutex_unlock(&rs_init_mutex);
+	}
+	return (rs);
 }
 
 uint64_t fx25_get_ctag_value(int ctag_num)
@@ -398,6 +460,26 @@ int fx25_pick_mode(int fx_mode, int dlen)
 	// TODO: revisit error messages, produced by caller, when this returns -1.
 }
 
+/*
+ * Version 1.8: The Galois field tables only depend on the symbol size and
+ * field generator polynomial, the same for all of the codecs here, so they
+ * are made once and shared.  They are never freed.  Only called from
+ * fx25_get_rs, one at a time, so no lock is needed here.
+ */
+
+#define MAX_FIELDS 2
+
+static struct
+{
+	unsigned int symsize;
+	unsigned int gfpoly;
+	DTYPE *alpha_to;
+	DTYPE *index_of;
+	DTYPE *mul_tab;
+} fields[MAX_FIELDS];
+
+static int num_fields = 0;
+
 /* Initialize a Reed-Solomon codec
  *   symsize = symbol size, bits (1-8) - always 8 for this application.
  *   gfpoly = Field generator polynomial coefficients
@@ -432,41 +514,89 @@ struct rs *INIT_RS(unsigned int symsize, unsigned int gfpoly, unsigned fcr, unsi
 	rs->mm = symsize;
 	rs->nn = (1 << symsize) - 1;
 
-	rs->alpha_to = (DTYPE *)calloc((rs->nn + 1), sizeof(DTYPE));
-	if (rs->alpha_to == NULL)
+	for (i = 0; i < num_fields; i++)
 	{
-
-		printf("FATAL ERROR: Out of memory.\n");
-		exit(EXIT_FAILURE);
+		if (fields[i].symsize == symsize && fields[i].gfpoly == gfpoly)
+		{
+			rs->alpha_to = fields[i].alpha_to;
+			rs->index_of = fields[i].index_of;
+			rs->mul_tab = fields[i].mul_tab;
+			break;
+		}
 	}
-	rs->index_of = (DTYPE *)calloc((rs->nn + 1), sizeof(DTYPE));
-	if (rs->index_of == NULL)
+
+	if (i == num_fields)
 	{
+		if (num_fields >= MAX_FIELDS)
+		{
+			free(rs);
+			return NULL; /* Increase MAX_FIELDS. */
+		}
 
-		printf("FATAL ERROR: Out of memory.\n");
-		exit(EXIT_FAILURE);
-	}
+		rs->alpha_to = (DTYPE *)calloc((rs->nn + 1), sizeof(DTYPE));
+		if (rs->alpha_to == NULL)
+		{
 
-	/* Generate Galois field lookup tables */
-	rs->index_of[0] = A0; /* log(zero) = -inf */
-	rs->alpha_to[A0] = 0; /* alpha**-inf = 0 */
-	sr = 1;
-	for (i = 0; i < rs->nn; i++)
-	{
-		rs->index_of[sr] = i;
-		rs->alpha_to[i] = sr;
-		sr <<= 1;
-		if (sr & (1 << symsize))
-			sr ^= gfpoly;
-		sr &= rs->nn;
-	}
-	if (sr != 1)
-	{
-		/* field generator polynomial is not primitive! */
-		free(rs->alpha_to);
-		free(rs->index_of);
-		free(rs);
-		return NULL;
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		rs->index_of = (DTYPE *)calloc((rs->nn + 1), sizeof(DTYPE));
+		if (rs->index_of == NULL)
+		{
+
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		/* Generate Galois field lookup tables */
+		rs->index_of[0] = A0; /* log(zero) = -inf */
+		rs->alpha_to[A0] = 0; /* alpha**-inf = 0 */
+		sr = 1;
+		for (i = 0; i < rs->nn; i++)
+		{
+			rs->index_of[sr] = i;
+			rs->alpha_to[i] = sr;
+			sr <<= 1;
+			if (sr & (1 << symsize))
+				sr ^= gfpoly;
+			sr &= rs->nn;
+		}
+		if (sr != 1)
+		{
+			/* field generator polynomial is not primitive! */
+			free(rs->alpha_to);
+			free(rs->index_of);
+			free(rs);
+			return NULL;
+		}
+
+		/* Version 1.8: Tables for multiplying 16 symbols at once by a constant */
+		/* when decoding.  Look up low and high nibble separately and combine. */
+		if (symsize == 8 && rs_simd_supported())
+		{
+			rs->mul_tab = (DTYPE *)malloc(rs->nn * 32);
+			if (rs->mul_tab == NULL)
+			{
+
+				printf("FATAL ERROR: Out of memory.\n");
+				exit(EXIT_FAILURE);
+			}
+			for (i = 0; i < rs->nn; i++)
+			{
+				for (j = 0; j < 16; j++)
+				{
+					rs->mul_tab[i * 32 + j] = j == 0 ? 0 : rs->alpha_to[modnn(rs, rs->index_of[j] + i)];
+					rs->mul_tab[i * 32 + 16 + j] = j == 0 ? 0 : rs->alpha_to[modnn(rs, rs->index_of[j << 4] + i)];
+				}
+			}
+		}
+
+		fields[num_fields].symsize = symsize;
+		fields[num_fields].gfpoly = gfpoly;
+		fields[num_fields].alpha_to = rs->alpha_to;
+		fields[num_fields].index_of = rs->index_of;
+		fields[num_fields].mul_tab = rs->mul_tab;
+		num_fields++;
 	}
 
 	/* Form RS code generator polynomial from its roots */
@@ -508,6 +638,24 @@ struct rs *INIT_RS(unsigned int symsize, unsigned int gfpoly, unsigned fcr, unsi
 		rs->genpoly[i] = rs->index_of[rs->genpoly[i]];
 	}
 
+	/* Version 1.8: Precomputed products of the generator polynomial for */
+	/* each possible feedback value, so encoding is a table lookup and */
+	/* exclusive or of a whole row rather than one multiply per check byte. */
+	rs->enc_tab = (DTYPE *)calloc(rs->nn + 1, nroots);
+	if (rs->enc_tab == NULL)
+	{
+
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 1; i <= rs->nn; i++)
+	{
+		for (j = 0; j < nroots; j++)
+		{
+			rs->enc_tab[i * nroots + j] = rs->alpha_to[modnn(rs, rs->index_of[i] + rs->genpoly[nroots - 1 - j])];
+		}
+	}
+
 	return rs;
 }
 
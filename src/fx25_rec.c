@@ -35,12 +35,26 @@
 // #if __WIN32__
 // #include <fcntl.h>
 // #endif
+#if __WIN32__
+#include <process.h>
+#endif
 
 #include "fx25.h"
 
 #include "fcs_calc.h"
 #include "multi_modem.h"
 #include "demod.h"
+#include "dwthread.h"
+#include "audio.h"
+#include "rxlat.h"
+#include "metrics.h"
+
+/*
+ * Version 1.8:  Contexts are allocated at init time, one cache line
+ * aligned arena for all, in the same order as hdlc_state, rather than
+ * one at a time on the first bit.  Everything needed for the tag search
+ * comes first so it is all in the first line.
+ */
 
 struct fx_context_s
 {
@@ -59,56 +73,114 @@ struct fx_context_s
 	int dlen;			 // Accumulated length in "data" below.
 	int clen;			 // Accumulated length in "check" below.
 	unsigned char imask; // Mask for storing a bit.
+	unsigned int start;	 // multi_modem_get_sample_time when tag was found.
+	int chan;
+	int subchan;
+	int slice;
 	unsigned char block[FX25_BLOCK_SIZE + 1];
-};
+} __attribute__((aligned(64)));
 
 static struct fx_context_s *fx_context[MAX_CHANS][MAX_SUBCHANS][MAX_SLICERS];
 
-static void process_rs_block(int chan, int subchan, int slice, struct fx_context_s *F);
+/*
+ * Version 1.8:  A complete codeblock, ready for the Reed-Solomon decoder.
+ * With FIXTHREADS, these are decoded by a background thread rather than
+ * holding up the demodulator.  The result goes to
+ * multi_modem_process_rec_frame_later.
+ */
+
+struct fx_job_s
+{
+	int chan;
+	int subchan;
+	int slice;
+	int ctag_num;
+	int dlen;
+	unsigned int start;
+	int64_t end_time; // rxlat_now when the last check byte arrived.
+	alevel_t alevel;
+	unsigned char block[FX25_BLOCK_SIZE + 1];
+};
+
+#define FX_JOB_QUEUE_SIZE 16
+
+static struct fx_job_queue_s
+{
+	struct fx_job_s job[FX_JOB_QUEUE_SIZE];
+	int head; /* Next to take. */
+	int count;
+	struct fx_job_s current; /* Being decoded. */
+	int decoding;
+	int pending[MAX_CHANS]; /* Queued or being decoded, for a quick look. */
+	dw_mutex_t mutex;
+#if __WIN32__
+	HANDLE wake_sem; /* Count of jobs in queue. */
+#else
+	pthread_cond_t wake_cond;
+#endif
+} fx_job_queue;
+
+static int fx_decode_thread_running = 0;
+
+static void process_rs_block(struct fx_job_s *J, int later);
 
 static int my_unstuff(int chan, int slice, unsigned char *restrict pin, int ilen, unsigned char *restrict frame_buf);
 
 /***********************************************************************************
  *
- * Name:        fx25_rec_bit
+ * Name:        fx25_rec_bits
  *
  * Purpose:     Extract FX.25 codeblocks from a stream of bits.
  *		In a completely integrated AX.25 / FX.25 receive system,
  *		this would see the same bit stream as hdlc_rec_bit.
  *
- * Inputs:      chan    - Channel number.
- *
- *              subchan - This allows multiple demodulators per channel.
+ * Inputs:      F	- From fx25_rec_context for the channel,
+ *			  subchannel (demodulator) and slicer.
  *
- *              slice   - Allows multiple slicers per demodulator (subchannel).
+ *              data	- Data bits after NRZI and any descrambling,
+ *			  oldest in the LSB.
  *
- *              dbit	- Data bit after NRZI and any descrambling.
- *			  Any non-zero value is logic '1'.
+ *		n	- Number of bits in data.
  *
- * Description: This is called once for each received bit.
+ * Description: This is called for each group of received bits.
  *              For each valid frame, process_rec_frame() is called for further processing.
  *		It can gather multiple candidates from different parallel demodulators
  *		("subchannels") and slicers, then decide which one is the best.
  *
+ *		fx25_rec_bit is the original, one bit at a time, interface.
+ *
  ***********************************************************************************/
 
 #define FENCE 0x55 // to detect buffer overflow.
 
-void fx25_rec_bit(int chan, int subchan, int slice, int dbit)
+static void rec_bit(struct fx_context_s *F, int dbit);
+
+void fx25_rec_bits(fx25_rec_t F, unsigned int data, int n)
 {
+	for (int k = 0; k < n; k++)
+	{
+		rec_bit(F, (data >> k) & 1);
+	}
+}
 
-	// Allocate context blocks only as needed.
+void fx25_rec_bit(int chan, int subchan, int slice, int dbit)
+{
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+	assert(slice >= 0 && slice < MAX_SLICERS);
 
 	struct fx_context_s *F = fx_context[chan][subchan][slice];
-	if (F == NULL)
+	if (F != NULL)
 	{
-		assert(chan >= 0 && chan < MAX_CHANS);
-		assert(subchan >= 0 && subchan < MAX_SUBCHANS);
-		assert(slice >= 0 && slice < MAX_SLICERS);
-		F = fx_context[chan][subchan][slice] = (struct fx_context_s *)malloc(sizeof(struct fx_context_s));
-		assert(F != NULL);
-		memset(F, 0, sizeof(struct fx_context_s));
+		rec_bit(F, dbit);
 	}
+}
+
+static void rec_bit(struct fx_context_s *F, int dbit)
+{
+	int chan = F->chan;
+	int subchan = F->subchan;
+	int slice = F->slice;
 
 	// State machine to identify correlation tag then gather appropriate number of data and check bytes.
 
@@ -141,6 +213,9 @@ void fx25_rec_bit(int chan, int subchan, int slice, int dbit)
 			F->imask = 0x01;
 			F->dlen = 0;
 			F->clen = 0;
+#if !FXTEST
+			F->start = multi_modem_get_sample_time(chan);
+#endif
 			memset(F->block, 0, sizeof(F->block));
 			F->block[FX25_BLOCK_SIZE] = FENCE;
 			F->state = FX_DATA;
@@ -172,8 +247,53 @@ void fx25_rec_bit(int chan, int subchan, int slice, int dbit)
 			F->clen++;
 			if (F->clen >= F->nroots)
 			{
+				struct fx_job_queue_s *Q = &fx_job_queue;
+				struct fx_job_s *J = NULL;
+				struct fx_job_s here;
 
-				process_rs_block(chan, subchan, slice, F); // see below
+				if (fx_decode_thread_running)
+				{
+					dw_mutex_lock(&Q->mutex);
+					if (Q->count < FX_JOB_QUEUE_SIZE)
+					{
+						J = &Q->job[(Q->head + Q->count) % FX_JOB_QUEUE_SIZE];
+					}
+				}
+				if (J == NULL)
+				{
+					J = &here; // No thread, or it is falling behind.  Do it now.
+				}
+
+				J->chan = chan;
+				J->subchan = subchan;
+				J->slice = slice;
+				J->ctag_num = F->ctag_num;
+				J->dlen = F->dlen;
+				J->start = F->start;
+				J->end_time = rxlat_now();
+#if !FXTEST
+				J->alevel = demod_get_audio_level(chan, subchan);
+#endif
+				memcpy(J->block, F->block, sizeof(J->block));
+
+				if (J != &here)
+				{
+					Q->count++;
+					Q->pending[chan]++;
+#if __WIN32__
+					ReleaseSemaphore(Q->wake_sem, 1, NULL);
+#else
+					pthread_cond_signal(&Q->wake_cond);
+#endif
+				}
+				if (fx_decode_thread_running)
+				{
+					dw_mutex_unlock(&Q->mutex);
+				}
+				if (J == &here)
+				{
+					process_rs_block(J, 0); // see below
+				}
 
 				F->ctag_num = -1;
 				F->accum = 0;
@@ -192,6 +312,10 @@ void fx25_rec_bit(int chan, int subchan, int slice, int dbit)
  *
  * Inputs:      chan    - Channel number.
  *
+ * Outputs:	since	- If not NULL, earliest sample_time, from
+ *			  multi_modem_get_sample_time, when a correlation
+ *			  tag was found for a block still in progress.
+ *
  * Returns:	True if currently in progress for the specified channel.
  *
  * Description: This is required for duplicate removal.  One channel and can have
@@ -205,10 +329,19 @@ void fx25_rec_bit(int chan, int subchan, int slice, int dbit)
  *		We want to delay the duplicate removal while FX.25 block reception
  *		is going on.
  *
+ *		Version 1.8:  Blocks waiting for, or going thru, the decode
+ *		thread count as in progress too.  Only frames received after
+ *		the tag could be part of the block so since lets the caller
+ *		go ahead with anything older.
+ *
  ***********************************************************************************/
 
-int fx25_rec_busy(int chan)
+int fx25_rec_busy(int chan, unsigned int *since)
 {
+	struct fx_job_queue_s *Q = &fx_job_queue;
+	int busy = 0;
+	unsigned int earliest = 0;
+
 	assert(chan >= 0 && chan < MAX_CHANS);
 
 	// This could be a little faster if we knew number of
@@ -222,15 +355,204 @@ int fx25_rec_busy(int chan)
 			{
 				if (fx_context[chan][i][j]->state != FX_TAG)
 				{
-					return (1);
+					if (since == NULL)
+					{
+						return (1);
+					}
+					if (!busy || (int)(fx_context[chan][i][j]->start - earliest) < 0)
+					{
+						earliest = fx_context[chan][i][j]->start;
+					}
+					busy = 1;
 				}
 			}
 		}
 	}
-	return (0);
+
+	if (fx_decode_thread_running && __atomic_load_n(&Q->pending[chan], __ATOMIC_SEQ_CST) > 0)
+	{
+		dw_mutex_lock(&Q->mutex);
+		for (int k = 0; k < Q->count + Q->decoding; k++)
+		{
+			struct fx_job_s *J = k < Q->count ? &Q->job[(Q->head + k) % FX_JOB_QUEUE_SIZE] : &Q->current;
+
+			if (J->chan == chan && (!busy || (int)(J->start - earliest) < 0))
+			{
+				earliest = J->start;
+				busy = 1;
+			}
+		}
+		dw_mutex_unlock(&Q->mutex);
+	}
+
+	if (since != NULL)
+	{
+		*since = earliest;
+	}
+	return (busy);
 
 } // end fx25_rec_busy
 
+/***********************************************************************************
+ *
+ * Name:	fx_decode_thread
+ *
+ * Purpose:	Background thread for decoding FX.25 codeblocks.
+ *
+ * Description:	The block stays in Q->current until the result, if any,
+ *		has been handed to multi_modem_process_rec_frame_later,
+ *		so fx25_rec_busy never has a gap between the two.
+ *
+ ***********************************************************************************/
+
+#if __WIN32__
+static unsigned __stdcall fx_decode_thread(void *arg)
+#else
+static void *fx_decode_thread(void *arg)
+#endif
+{
+	struct fx_job_queue_s *Q = &fx_job_queue;
+
+	while (1)
+	{
+#if __WIN32__
+		WaitForSingleObject(Q->wake_sem, INFINITE);
+		dw_mutex_lock(&Q->mutex);
+#else
+		dw_mutex_lock(&Q->mutex);
+		while (Q->count == 0)
+		{
+			pthread_cond_wait(&Q->wake_cond, &Q->mutex);
+		}
+#endif
+		Q->current = Q->job[Q->head];
+		Q->head = (Q->head + 1) % FX_JOB_QUEUE_SIZE;
+		Q->count--;
+		Q->decoding = 1;
+		dw_mutex_unlock(&Q->mutex);
+
+		process_rs_block(&Q->current, 1);
+
+		dw_mutex_lock(&Q->mutex);
+		Q->decoding = 0;
+		__atomic_sub_fetch(&Q->pending[Q->current.chan], 1, __ATOMIC_SEQ_CST);
+		dw_mutex_unlock(&Q->mutex);
+	}
+#if __WIN32__
+	return (0);
+#else
+	return (NULL);
+#endif
+}
+
+/***********************************************************************************
+ *
+ * Name:	fx25_rec_init
+ *
+ * Purpose:	Allocate the receive contexts and start the thread for
+ *		decoding FX.25 codeblocks.
+ *
+ * Inputs:	pa	- Configuration.  For each radio channel with fx25_rec
+ *			  set, there is a context for each subchannel and slicer.
+ *
+ *			  fix_threads - Blocks are decoded in the background
+ *			  only when there are fix up threads.  Otherwise, the
+ *			  same as before, in the demodulator.
+ *
+ * Description:	Must be after demod_init, which settles the number of slicers.
+ *
+ ***********************************************************************************/
+
+void fx25_rec_init(struct audio_s *pa)
+{
+	struct fx_job_queue_s *Q = &fx_job_queue;
+	struct fx_context_s *arena;
+	int chan, sub, slice, n = 0;
+
+	memset(fx_context, 0, sizeof(fx_context));
+
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] == MEDIUM_RADIO && pa->achan[chan].fx25_rec)
+		{
+			n += pa->achan[chan].num_subchan * (pa->achan[chan].num_slicers > 1 ? pa->achan[chan].num_slicers : 1);
+		}
+	}
+
+	if (n > 0)
+	{
+		// Never freed.  Round up the start to a cache line.
+
+		char *p = malloc(n * sizeof(struct fx_context_s) + 63);
+		if (p == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		arena = (struct fx_context_s *)(((uintptr_t)p + 63) & ~(uintptr_t)63);
+		memset(arena, 0, n * sizeof(struct fx_context_s));
+
+		for (chan = 0; chan < MAX_CHANS; chan++)
+		{
+			if (pa->chan_medium[chan] == MEDIUM_RADIO && pa->achan[chan].fx25_rec)
+			{
+				for (sub = 0; sub < pa->achan[chan].num_subchan; sub++)
+				{
+					for (slice = 0; slice < (pa->achan[chan].num_slicers > 1 ? pa->achan[chan].num_slicers : 1); slice++)
+					{
+						arena->chan = chan;
+						arena->subchan = sub;
+						arena->slice = slice;
+						fx_context[chan][sub][slice] = arena++;
+					}
+				}
+			}
+		}
+	}
+
+	if (n == 0 || pa->fix_threads <= 0 || fx_decode_thread_running)
+		return;
+
+	memset(Q, 0, sizeof(struct fx_job_queue_s));
+	dw_mutex_init(&Q->mutex);
+#if __WIN32__
+	Q->wake_sem = CreateSemaphore(NULL, 0, FX_JOB_QUEUE_SIZE, NULL);
+	if (Q->wake_sem == NULL)
+	{
+		printf("FATAL: Could not create FX.25 decode semaphore.\n");
+		exit(1);
+	}
+	if (_beginthreadex(NULL, 0, fx_decode_thread, NULL, 0, NULL) == 0)
+	{
+		printf("FATAL: Could not create FX.25 decode thread.\n");
+		exit(1);
+	}
+#else
+	pthread_cond_init(&Q->wake_cond, NULL);
+
+	pthread_t tid;
+	int e = pthread_create(&tid, NULL, fx_decode_thread, NULL);
+	if (e != 0)
+	{
+		printf("FATAL: Could not create FX.25 decode thread.\n");
+		exit(1);
+	}
+	pthread_detach(tid);
+#endif
+	fx_decode_thread_running = 1;
+}
+
+/* Context for one slicer, for hdlc_rec to keep.  NULL if not listening. */
+
+fx25_rec_t fx25_rec_context(int chan, int subchan, int slice)
+{
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+	assert(slice >= 0 && slice < MAX_SLICERS);
+
+	return (fx_context[chan][subchan][slice]);
+}
+
 /***********************************************************************************
  *
  * Name:	process_rs_block
@@ -238,15 +560,13 @@ int fx25_rec_busy(int chan)
  * Purpose:     After the correlation tag was detected and the appropriate number
  *		of data and check bytes are accumulated, this performs the processing
  *
- * Inputs:	chan, subchan, slice
- *
- *		F->ctag_num	- Correlation tag number  (index into table)
+ * Inputs:	J->chan, J->subchan, J->slice
  *
- *		F->dlen		- Number of "data" bytes.
+ *		J->ctag_num	- Correlation tag number  (index into table)
  *
- *		F->clen		- Number of "check" bytes"
+ *		J->dlen		- Number of "data" bytes.
  *
- *		F->block	- Codeblock.  Always 255 total bytes.
+ *		J->block	- Codeblock.  Always 255 total bytes.
  *				  Anything left over after data and check
  *				  bytes is filled with zeros.
  *
@@ -255,25 +575,34 @@ int fx25_rec_busy(int chan)
  *		|  dlen bytes "data"    |  zero fill    |  check bytes  |
  *		+-----------------------+---------------+---------------+
  *
+ *		later		- From the decode thread.
+ *
  * Description:	Use Reed-Solomon decoder to fix up any errors.
  *		Extract the AX.25 frame from the corrected data.
  *
  ***********************************************************************************/
 
-static void process_rs_block(int chan, int subchan, int slice, struct fx_context_s *F)
+static void process_rs_block(struct fx_job_s *J, int later)
 {
+	int chan = J->chan;
+	int subchan = J->subchan;
+	int slice = J->slice;
+
 	if (fx25_get_debug() >= 3)
 	{
 
 		printf("FX.25[%d.%d]: Received RS codeblock.\n", chan, slice);
-		fx_hex_dump(F->block, FX25_BLOCK_SIZE);
+		fx_hex_dump(J->block, FX25_BLOCK_SIZE);
 	}
-	assert(F->block[FX25_BLOCK_SIZE] == FENCE);
+	assert(J->block[FX25_BLOCK_SIZE] == FENCE);
 
 	int derrlocs[FX25_MAX_CHECK]; // Half would probably be OK.
-	struct rs *rs = fx25_get_rs(F->ctag_num);
+	struct rs *rs = fx25_get_rs(J->ctag_num);
 
-	int derrors = DECODE_RS(rs, F->block, derrlocs, 0);
+	int derrors = DECODE_RS(rs, J->block, derrlocs, 0);
+#if !FXTEST
+	metrics_fx25(chan, derrors);
+#endif
 
 	if (derrors >= 0)
 	{ // -1 for failure.  >= 0 for success, number of bytes corrected.
@@ -297,7 +626,7 @@ static void process_rs_block(int chan, int subchan, int slice, struct fx_context
 		}
 
 		unsigned char frame_buf[FX25_MAX_DATA + 1]; // Out must be shorter than input.
-		int frame_len = my_unstuff(chan, slice, F->block, F->dlen, frame_buf);
+		int frame_len = my_unstuff(chan, slice, J->block, J->dlen, frame_buf);
 
 		if (frame_len >= 14 + 1 + 2)
 		{ // Minimum length: Two addresses & control & FCS.
@@ -317,10 +646,14 @@ static void process_rs_block(int chan, int subchan, int slice, struct fx_context
 #if FXTEST
 				fx25_test_count++;
 #else
-				alevel_t alevel = demod_get_audio_level(chan, subchan);
-
-				multi_modem_process_rec_frame(chan, subchan, slice, frame_buf, frame_len - 2, alevel, derrors, 1); /* len-2 to remove FCS. */
-
+				if (later)
+				{
+					multi_modem_process_rec_frame_later(chan, subchan, slice, frame_buf, frame_len - 2, J->alevel, derrors, fec_type_fx25, J->start, J->end_time);
+				}
+				else
+				{
+					multi_modem_process_rec_frame(chan, subchan, slice, frame_buf, frame_len - 2, J->alevel, derrors, 1, J->end_time); /* len-2 to remove FCS. */
+				}
 #endif
 			}
 			else
@@ -328,7 +661,7 @@ static void process_rs_block(int chan, int subchan, int slice, struct fx_context
 				// Most likely cause is defective sender software.
 
 				printf("FX.25[%d.%d]: Bad FCS for AX.25 frame.\n", chan, slice);
-				fx_hex_dump(F->block, F->dlen);
+				fx_hex_dump(J->block, J->dlen);
 				fx_hex_dump(frame_buf, frame_len);
 			}
 		}
@@ -337,7 +670,7 @@ static void process_rs_block(int chan, int subchan, int slice, struct fx_context
 			// Most likely cause is defective sender software.
 
 			printf("FX.25[%d.%d]: AX.25 frame is shorter than minimum length.\n", chan, slice);
-			fx_hex_dump(F->block, F->dlen);
+			fx_hex_dump(J->block, J->dlen);
 			fx_hex_dump(frame_buf, frame_len);
 		}
 	}
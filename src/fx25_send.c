@@ -27,18 +27,12 @@
 #include "fx25.h"
 #include "fcs_calc.h"
 #include "audio.h"
-#include "gen_tone.h"
+#include "hdlc_send.h"
 
 // #define FXTEST 1		// To build unit test application.
 
-#ifndef FXTEST
-static void send_bytes(int chan, unsigned char *b, int count);
-static void send_bit(int chan, int b);
-#endif
 static int stuff_it(unsigned char *in, int ilen, unsigned char *out, int osize);
 
-static int number_of_bits_sent[MAX_CHANS]; // Count number of bits sent by "fx25_send_frame" or "???"
-
 #if FXTEST
 static unsigned char preload[] = {
 	'T' << 1, 'E' << 1, 'S' << 1, 'T' << 1, ' ' << 1, ' ' << 1, 0x60,
@@ -56,6 +50,7 @@ int main()
 	printf("Run fxrec as second part of test.\n");
 
 	fx25_init(3);
+	layer2_send_init();
 	for (int i = 100 + CTAG_MIN; i <= 100 + CTAG_MAX; i++)
 	{
 		fx25_send_frame(0, preload, (int)sizeof(preload) - 3, i);
@@ -83,7 +78,7 @@ int main()
  *			  but this is expected to be mostly for testing, not normal
  *			  operation.
  *
- * Outputs:	Bits are shipped out by calling tone_gen_put_bit().
+ * Outputs:	Bits are shipped out by calling tone_gen_put_bytes().
  *
  * Returns:	Number of bits sent including "flags" and the
  *		stuffing bits.
@@ -96,7 +91,7 @@ int main()
  *
  * Assumptions:	It is assumed that the tone_gen module has been
  *		properly initialized so that bits sent with
- *		tone_gen_put_bit() are processed correctly.
+ *		tone_gen_put_bytes() are processed correctly.
  *
  * Errors:	If something goes wrong, return -1 and the caller should
  *		fallback to sending normal AX.25.
@@ -106,6 +101,69 @@ int main()
  *--------------------------------------------------------------*/
 
 int fx25_send_frame(int chan, unsigned char *fbuf, int flen, int fx_mode)
+{
+	unsigned char block[FX25_MAX_BLOCK];
+
+	int blen = fx25_encode_frame(chan, fbuf, flen, fx_mode, block);
+	if (blen < 0)
+	{
+		return (-1);
+	}
+
+#if FXTEST
+	// Standalone text application.
+
+	unsigned char flags[16] = {0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e};
+	char fname[32];
+	snprintf(fname, sizeof(fname), "fx%02x.dat", fx25_tag_find_match(*(uint64_t *)block));
+	FILE *fp = fopen(fname, "wb");
+	fwrite(flags, sizeof(flags), 1, fp);
+#if 1
+	for (int j = 8 + 8; j < 8 + 16; j++)
+	{ // Introduce errors.
+		block[j] = ~block[j];
+	}
+#endif
+	fwrite(block, blen, 1, fp);
+	fwrite(flags, sizeof(flags), 1, fp);
+	fflush(fp);
+	fclose(fp);
+#else
+	// Normal usage.  Send bits to modulator.
+
+	hdlc_send_nrzi(chan, block, blen * 8);
+#endif
+
+	return (blen * 8);
+}
+
+/*-------------------------------------------------------------
+ *
+ * Name:	fx25_encode_frame
+ *
+ * Purpose:	Build the FX.25 block for a frame without sending it.
+ *
+ * Inputs:	chan	- Audio channel number, only for messages.
+ *
+ *		fbuf	- Frame buffer address.  There must be room
+ *			  for 2 more bytes, where the FCS is put.
+ *
+ *		flen	- Frame length, not including the FCS.
+ *
+ *		fx_mode	- Same as for fx25_send_frame.
+ *
+ * Outputs:	out	- Correlation tag, data, and check bytes.
+ *			  Room for FX25_MAX_BLOCK bytes is needed.
+ *			  These still need NRZI encoding.
+ *
+ * Returns:	Number of bytes in out, or -1 for failure.
+ *
+ * Description:	Version 1.8: Separated from fx25_send_frame so the
+ *		result can be saved and sent again.
+ *
+ *--------------------------------------------------------------*/
+
+int fx25_encode_frame(int chan, unsigned char *fbuf, int flen, int fx_mode, unsigned char *out)
 {
 	if (fx25_get_debug() >= 3)
 	{
@@ -115,8 +173,6 @@ int fx25_send_frame(int chan, unsigned char *fbuf, int flen, int fx_mode)
 		fx_hex_dump(fbuf, flen);
 	}
 
-	number_of_bits_sent[chan] = 0;
-
 	// Append the FCS.
 
 	int fcs = fcs_calc(fbuf, flen);
@@ -186,34 +242,6 @@ int fx25_send_frame(int chan, unsigned char *fbuf, int flen, int fx_mode)
 		printf("------\n");
 	}
 
-#if FXTEST
-	// Standalone text application.
-
-	unsigned char flags[16] = {0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e, 0x7e};
-	char fname[32];
-	snprintf(fname, sizeof(fname), "fx%02x.dat", ctag_num);
-	FILE *fp = fopen(fname, "wb");
-	fwrite(flags, sizeof(flags), 1, fp);
-	// fwrite ((unsigned char *)(&ctag_value), sizeof(ctag_value), 1, fp);	// No - assumes little endian.
-	for (int k = 0; k < 8; k++)
-	{
-		unsigned char b = (ctag_value >> (k * 8)) & 0xff; // Should be portable to big endian too.
-		fwrite(&b, 1, 1, fp);
-	}
-#if 1
-	for (int j = 8; j < 16; j++)
-	{ // Introduce errors.
-		data[j] = ~data[j];
-	}
-#endif
-	fwrite(data, k_data_radio, 1, fp);
-	fwrite(check, NROOTS, 1, fp);
-	fwrite(flags, sizeof(flags), 1, fp);
-	fflush(fp);
-	fclose(fp);
-#else
-	// Normal usage.  Send bits to modulator.
-
 	// Temp hack for testing.  Corrupt first 8 bytes.
 	//	for (int j = 0; j < 16; j++) {
 	//	  data[j] = ~ data[j];
@@ -221,48 +249,13 @@ int fx25_send_frame(int chan, unsigned char *fbuf, int flen, int fx_mode)
 
 	for (int k = 0; k < 8; k++)
 	{
-		unsigned char b = (ctag_value >> (k * 8)) & 0xff;
-		send_bytes(chan, &b, 1);
-	}
-	send_bytes(chan, data, k_data_radio);
-	send_bytes(chan, check, NROOTS);
-#endif
-
-	return (number_of_bits_sent[chan]);
-}
-
-#ifndef FXTEST
-
-static void send_bytes(int chan, unsigned char *b, int count)
-{
-	for (int j = 0; j < count; j++)
-	{
-		unsigned char x = b[j];
-		for (int k = 0; k < 8; k++)
-		{
-			send_bit(chan, x & 0x01);
-			x >>= 1;
-		}
+		out[k] = (ctag_value >> (k * 8)) & 0xff; // Should be portable to big endian too.
 	}
-}
-
-/*
- * NRZI encoding.
- * data 1 bit -> no change.
- * data 0 bit -> invert signal.
- */
-static void send_bit(int chan, int b)
-{
-	static int output[MAX_CHANS];
+	memcpy(out + 8, data, k_data_radio);
+	memcpy(out + 8 + k_data_radio, check, NROOTS);
 
-	if (b == 0)
-	{
-		output[chan] = !output[chan];
-	}
-	tone_gen_put_bit(chan, output[chan]);
-	number_of_bits_sent[chan]++;
+	return (8 + k_data_radio + NROOTS);
 }
-#endif // FXTEST
 
 /*-------------------------------------------------------------
  *
@@ -290,57 +283,26 @@ static void send_bit(int chan, int b)
  *
  *--------------------------------------------------------------*/
 
-#define put_bit(value)                           \
-	{                                            \
-		if (olen >= osize)                       \
-			return (-1);                         \
-		if (value)                               \
-			out[olen >> 3] |= 1 << (olen & 0x7); \
-		olen++;                                  \
-	}
-
 static int stuff_it(unsigned char *in, int ilen, unsigned char *out, int osize)
 {
 	const unsigned char flag = 0x7e;
 	int ret = -1;
 	memset(out, 0, osize);
-	out[0] = flag;
-	int olen = 8; // Number of bits in output.
-	osize *= 8;	  // Now in bits rather than bytes.
+	int olen = hdlc_put_bits(out, 0, flag, 8); // Number of bits in output.
+	osize *= 8;									 // Now in bits rather than bytes.
 	int ones = 0;
 
-	for (int i = 0; i < ilen; i++)
+	olen = hdlc_stuff(in, ilen, out, olen, osize, &ones);
+	if (olen < 0 || olen + 8 > osize)
 	{
-		for (unsigned char imask = 1; imask != 0; imask <<= 1)
-		{
-			int v = in[i] & imask;
-			put_bit(v);
-			if (v)
-			{
-				ones++;
-				if (ones == 5)
-				{
-					put_bit(0);
-					ones = 0;
-				}
-			}
-			else
-			{
-				ones = 0;
-			}
-		}
-	}
-	for (unsigned char imask = 1; imask != 0; imask <<= 1)
-	{
-		put_bit(flag & imask);
+		return (-1);
 	}
+	olen = hdlc_put_bits(out, olen, flag, 8);
 	ret = (olen + 7) / 8; // Includes any partial byte.
 
-	unsigned char imask = 1;
 	while (olen < osize)
 	{
-		put_bit(flag & imask);
-		imask = (imask << 1) | (imask >> 7); // Rotate.
+		olen = hdlc_put_bits(out, olen, flag, osize - olen < 8 ? osize - olen : 8);
 	}
 
 	return (ret);
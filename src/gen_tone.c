@@ -35,9 +35,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
 
 #include "audio.h"
 #include "gen_tone.h"
+#include "dwthread.h"
 
 #include "fsk_demod_state.h" /* for MAX_FILTER_SIZE which might be overly generous for here. */
 /* but safe if we use same size as for receive. */
@@ -83,6 +85,44 @@ static int lfsr[MAX_CHANS]; // Shift register for scrambler.
 
 static int prev_dat[MAX_CHANS]; // Previous data bit.  Used for G3RUH style.
 
+/*
+ * Version 1.8: Precomputed audio for one bit.
+ *
+ * When there is a whole number of samples per bit, e.g. 40 for 1200 baud
+ * at 48000 samples per second, a bit is always the same waveform for a
+ * given tone and starting phase.  These are built once, already in the
+ * format for the audio device, so sending a bit is a copy.
+ *
+ * Indexed by data bit and the upper 8 bits of the starting phase, the
+ * same resolution as the sine table.  The remaining phase bits are taken
+ * as the middle of that range.  The phase accumulator still advances by
+ * the exact amount so the error doesn't build up.
+ *
+ * They are built the first time the channel transmits, rather than by
+ * gen_tone_init, so a station that only receives never waits for them.
+ */
+
+#define WAVE_MAX_BYTES (1024 * 1024) /* Don't bother if table would be larger. */
+
+static int16_t *bit_wave[MAX_CHANS]; /* NULL if not usable for channel. */
+static int wave_samples[MAX_CHANS];	 /* Samples per bit. */
+static int wave_len[MAX_CHANS];		 /* Array elements per bit. */
+static int wave_ready[MAX_CHANS];	 /* Set once make_bit_wave has been tried. */
+static dw_mutex_t wave_mutex;
+
+/*
+ * Version 1.8: Optionally render a whole transmission into memory.
+ *
+ * While rendering, audio for the device is collected here rather than
+ * going to audio_put_block.  The buffer is kept for next time and only grows.
+ * Sizes are in array elements, not bytes.
+ */
+
+static int16_t *render_buf[MAX_ADEVS];
+static int render_size[MAX_ADEVS];
+static int render_len[MAX_ADEVS];
+static int rendering[MAX_ADEVS];
+
 /*------------------------------------------------------------------
  *
  * Name:        gen_tone_init
@@ -117,6 +157,8 @@ static int prev_dat[MAX_CHANS]; // Previous data bit.  Used for G3RUH style.
 
 static int amp16bit; /* for 9600 baud */
 
+static void make_bit_wave(int chan);
+
 int gen_tone_init(struct audio_s *audio_config_p, int amp)
 {
 	int j;
@@ -189,10 +231,116 @@ int gen_tone_init(struct audio_s *audio_config_p, int amp)
 		sine_table[j] = s;
 	}
 
+	/* Waveforms for each bit are made when first needed. */
+
+	dw_mutex_init(&wave_mutex);
+
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		free(bit_wave[chan]);
+		bit_wave[chan] = NULL;
+		wave_ready[chan] = 0;
+	}
+
 	return (0);
 
 } /* end gen_tone_init */
 
+/* One frame for audio_put_block, other stereo channel silent. */
+/* Returns number of array elements. */
+
+static inline int format_sample(int chan, int a, int sam, int16_t *out)
+{
+	if (save_audio_config_p->adev[a].num_channels == 2)
+	{
+		out[0] = chan == ADEVFIRSTCHAN(a) ? sam : 0;
+		out[1] = chan == ADEVFIRSTCHAN(a) ? 0 : sam;
+		return (2);
+	}
+
+	out[0] = sam;
+	return (1);
+}
+
+/* Send audio frames to the device, or the render buffer. */
+
+static void tone_out(int a, const int16_t *buf, int len)
+{
+	if (!rendering[a])
+	{
+		audio_put_block(a, buf, len / save_audio_config_p->adev[a].num_channels);
+		return;
+	}
+
+	if (render_len[a] + len > render_size[a])
+	{
+		int size = render_size[a] > 0 ? render_size[a] : 64 * 1024;
+
+		while (render_len[a] + len > size)
+		{
+			size *= 2;
+		}
+		int16_t *more = realloc(render_buf[a], size * sizeof(int16_t));
+		if (more == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		render_buf[a] = more;
+		render_size[a] = size;
+	}
+
+	memcpy(render_buf[a] + render_len[a], buf, len * sizeof(int16_t));
+	render_len[a] += len;
+}
+
+/* Build the precomputed bit waveforms for one channel, if possible. */
+
+static void make_bit_wave(int chan)
+{
+	int a = ACHAN2ADEV(chan);
+	int sps = save_audio_config_p->adev[a].samples_per_sec;
+	int baud = save_audio_config_p->achan[chan].baud;
+
+	if (save_audio_config_p->achan[chan].modem_type != MODEM_AFSK || baud <= 0 || sps % baud != 0)
+	{
+		return;
+	}
+
+	wave_samples[chan] = sps / baud;
+	wave_len[chan] = wave_samples[chan] * save_audio_config_p->adev[a].num_channels;
+
+	if (2 * 256 * wave_len[chan] * sizeof(int16_t) > WAVE_MAX_BYTES)
+	{
+		return;
+	}
+
+	int16_t *w = malloc(2 * 256 * wave_len[chan] * sizeof(int16_t));
+	if (w == NULL)
+	{
+		return;
+	}
+
+	for (int dat = 0; dat < 2; dat++)
+	{
+		unsigned int change = dat ? f1_change_per_sample[chan] : f2_change_per_sample[chan];
+
+		for (int k = 0; k < 256; k++)
+		{
+			unsigned int phase = ((unsigned int)k << 24) | 0x800000;
+			int16_t *p = w + (dat * 256 + k) * wave_len[chan];
+
+			for (int j = 0; j < wave_samples[chan]; j++)
+			{
+				phase += change;
+				p += format_sample(chan, a, sine_table[(phase >> 24) & 0xff], p);
+			}
+		}
+	}
+
+	bit_wave[chan] = w;
+}
+
 /*-------------------------------------------------------------------
  *
  * Name:        tone_gen_put_bit
@@ -277,29 +425,49 @@ static const float ci[8] = {1, .7071, 0, -.7071, -1, -.7071, 0, .7071};
 static const float sq[8] = {0, .7071, 1, .7071, 0, -.7071, -1, -.7071};
 #endif
 
-void tone_gen_put_bit(int chan, int dat)
+/* Audio samples for one bit, after the checks. */
+
+__attribute__((always_inline)) static inline void put_bit_samples(int chan, int a, int dat)
 {
-	int a = ACHAN2ADEV(chan); /* device for channel. */
+#if PSKIQ
+	int blend = 1;
+#endif
 
-	assert(save_audio_config_p != NULL);
+	// Use the precomputed waveform when this bit gets exactly the usual number of
+	// samples.  Occasionally the rounding in the bit timing calls for one more,
+	// as does the PLL test hack, so go the long way for those.
 
-	if (save_audio_config_p->chan_medium[chan] != MEDIUM_RADIO)
+	if (__builtin_expect(!__atomic_load_n(&wave_ready[chan], __ATOMIC_ACQUIRE), 0))
 	{
-
-		printf("Invalid channel %d for tone generation.\n", chan);
-		return;
+		dw_mutex_lock(&wave_mutex);
+		if (!wave_ready[chan])
+		{
+			make_bit_wave(chan);
+			__atomic_store_n(&wave_ready[chan], 1, __ATOMIC_RELEASE);
+		}
+		dw_mutex_unlock(&wave_mutex);
 	}
 
-	if (dat < 0)
+	if (bit_wave[chan] != NULL)
 	{
-		/* Hack to test receive PLL recovery. */
-		bit_len_acc[chan] -= ticks_per_bit[chan];
-		dat = 0;
+		int acc = bit_len_acc[chan] + (wave_samples[chan] - 1) * ticks_per_sample[chan];
+
+		if (bit_len_acc[chan] >= 0 && acc < ticks_per_bit[chan] && acc + ticks_per_sample[chan] >= ticks_per_bit[chan])
+		{
+			tone_out(a, bit_wave[chan] + ((dat ? 256 : 0) + (tone_phase[chan] >> 24)) * wave_len[chan], wave_len[chan]);
+
+			tone_phase[chan] += (unsigned int)wave_samples[chan] * (unsigned int)(dat ? f1_change_per_sample[chan] : f2_change_per_sample[chan]);
+			bit_len_acc[chan] = acc + ticks_per_sample[chan] - ticks_per_bit[chan];
+			prev_dat[chan] = dat;
+			return;
+		}
 	}
 
-#if PSKIQ
-	int blend = 1;
-#endif
+	// Otherwise collect the samples for the bit and send them together.
+
+	int16_t out[512];
+	int n = 0;
+
 	do
 	{ /* until enough audio samples for this symbol. */
 
@@ -323,7 +491,12 @@ void tone_gen_put_bit(int chan, int dat)
 
 			tone_phase[chan] += dat ? f1_change_per_sample[chan] : f2_change_per_sample[chan];
 			sam = sine_table[(tone_phase[chan] >> 24) & 0xff];
-			gen_tone_put_sample(chan, a, sam);
+			n += format_sample(chan, a, sam, out + n);
+			if (n > (int)(sizeof(out) / sizeof(out[0])) - 2)
+			{
+				tone_out(a, out, n);
+				n = 0;
+			}
 			break;
 
 		default:
@@ -339,12 +512,83 @@ void tone_gen_put_bit(int chan, int dat)
 
 	} while (bit_len_acc[chan] < ticks_per_bit[chan]);
 
+	if (n > 0)
+	{
+		tone_out(a, out, n);
+	}
+
 	bit_len_acc[chan] -= ticks_per_bit[chan];
 
 	prev_dat[chan] = dat; // Only needed for G3RUH baseband/scrambled.
+}
+
+void tone_gen_put_bit(int chan, int dat)
+{
+	int a = ACHAN2ADEV(chan); /* device for channel. */
+
+	assert(save_audio_config_p != NULL);
+
+	if (save_audio_config_p->chan_medium[chan] != MEDIUM_RADIO)
+	{
+
+		printf("Invalid channel %d for tone generation.\n", chan);
+		return;
+	}
+
+	if (dat < 0)
+	{
+		/* Hack to test receive PLL recovery. */
+		bit_len_acc[chan] -= ticks_per_bit[chan];
+		dat = 0;
+	}
+
+	put_bit_samples(chan, a, dat);
 
 } /* end tone_gen_put_bit */
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        tone_gen_put_bytes
+ *
+ * Purpose:     Same as tone_gen_put_bit for a whole buffer of bits.
+ *
+ * Inputs:      chan	- Audio channel, 0 = first.
+ *
+ *		b	- Bits, LSB of each byte first.  Already NRZI
+ *			  encoded, if wanted, like tone_gen_put_bit.
+ *
+ *		count	- Number of bytes.
+ *
+ * Description:	Version 1.8: Checks are done once rather than for each bit.
+ *
+ *--------------------------------------------------------------------*/
+
+void tone_gen_put_bytes(int chan, const unsigned char *b, int count)
+{
+	int a = ACHAN2ADEV(chan); /* device for channel. */
+
+	assert(save_audio_config_p != NULL);
+
+	if (save_audio_config_p->chan_medium[chan] != MEDIUM_RADIO)
+	{
+
+		printf("Invalid channel %d for tone generation.\n", chan);
+		return;
+	}
+
+	for (int j = 0; j < count; j++)
+	{
+		unsigned char x = b[j];
+
+		for (int k = 0; k < 8; k++)
+		{
+			put_bit_samples(chan, a, x & 1);
+			x >>= 1;
+		}
+	}
+
+} /* end tone_gen_put_bytes */
+
 void gen_tone_put_sample(int chan, int a, int sam)
 {
 
@@ -376,63 +620,10 @@ void gen_tone_put_sample(int chan, int a, int sam)
 		sam = 32767;
 	}
 
-	if (save_audio_config_p->adev[a].num_channels == 1)
-	{
-
-		/* Mono */
-
-		if (save_audio_config_p->adev[a].bits_per_sample == 8)
-		{
-			audio_put(a, ((sam + 32768) >> 8) & 0xff);
-		}
-		else
-		{
-			audio_put(a, sam & 0xff);
-			audio_put(a, (sam >> 8) & 0xff);
-		}
-	}
-	else
-	{
-
-		if (chan == ADEVFIRSTCHAN(a))
-		{
-
-			/* Stereo, left channel. */
-
-			if (save_audio_config_p->adev[a].bits_per_sample == 8)
-			{
-				audio_put(a, ((sam + 32768) >> 8) & 0xff);
-				audio_put(a, 0);
-			}
-			else
-			{
-				audio_put(a, sam & 0xff);
-				audio_put(a, (sam >> 8) & 0xff);
-
-				audio_put(a, 0);
-				audio_put(a, 0);
-			}
-		}
-		else
-		{
-
-			/* Stereo, right channel. */
-
-			if (save_audio_config_p->adev[a].bits_per_sample == 8)
-			{
-				audio_put(a, 0);
-				audio_put(a, ((sam + 32768) >> 8) & 0xff);
-			}
-			else
-			{
-				audio_put(a, 0);
-				audio_put(a, 0);
+	int16_t b[2];
+	int n = format_sample(chan, a, sam, b);
 
-				audio_put(a, sam & 0xff);
-				audio_put(a, (sam >> 8) & 0xff);
-			}
-		}
-	}
+	tone_out(a, b, n);
 }
 
 void gen_tone_put_quiet_ms(int chan, int time_ms)
@@ -452,6 +643,100 @@ void gen_tone_put_quiet_ms(int chan, int time_ms)
 	tone_phase[chan] = 0;
 }
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        gen_tone_render_begin
+ *
+ * Purpose:     Collect audio for the channel's device in memory rather
+ *		than sending it to the device.
+ *
+ * Inputs:      chan	- Audio channel, 0 = first.
+ *
+ * Description:	The caller must hold the audio output device lock until
+ *		gen_tone_render_end because everything for the device
+ *		goes into the same buffer.
+ *
+ *--------------------------------------------------------------------*/
+
+void gen_tone_render_begin(int chan)
+{
+	int a = ACHAN2ADEV(chan);
+
+	render_len[a] = 0;
+	rendering[a] = 1;
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        gen_tone_render_take
+ *
+ * Purpose:     Take everything collected so far, leaving an empty
+ *		buffer for what comes next.
+ *
+ * Inputs:      chan	- Audio channel, 0 = first.
+ *
+ * Outputs:	buf	- Frames for audio_put_block.  The caller owns this
+ *			  and must free it.  NULL if nothing was collected.
+ *
+ * Returns:     Number of frames.
+ *
+ * Description:	For handing the audio off piece by piece to another
+ *		thread while rendering continues.
+ *
+ *--------------------------------------------------------------------*/
+
+int gen_tone_render_take(int chan, int16_t **buf)
+{
+	int a = ACHAN2ADEV(chan);
+	int nframes = render_len[a] / save_audio_config_p->adev[a].num_channels;
+
+	if (nframes == 0)
+	{
+		*buf = NULL;
+		return (0);
+	}
+
+	*buf = render_buf[a];
+	render_buf[a] = NULL;
+	render_size[a] = 0;
+	render_len[a] = 0;
+
+	return (nframes);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        gen_tone_render_end
+ *
+ * Purpose:     Send everything collected since gen_tone_render_begin
+ *		to the audio device.
+ *
+ * Inputs:      chan	- Audio channel, 0 = first.
+ *
+ * Returns:     Duration of the audio in milliseconds.
+ *
+ * Description:	The whole buffer is handed over at once, and flushed, so
+ *		the device gets large writes with nothing left to compute.
+ *		Call this after turning on the transmitter.
+ *
+ *--------------------------------------------------------------------*/
+
+int gen_tone_render_end(int chan)
+{
+	int a = ACHAN2ADEV(chan);
+	int nframes = render_len[a] / save_audio_config_p->adev[a].num_channels;
+
+	rendering[a] = 0;
+
+	if (nframes > 0)
+	{
+		audio_put_block(a, render_buf[a], nframes);
+		audio_flush(a);
+	}
+
+	return ((int)((nframes * 1000LL) / save_audio_config_p->adev[a].samples_per_sec));
+}
+
 /*-------------------------------------------------------------------
  *
  * Name:        main
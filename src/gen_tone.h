@@ -2,6 +2,8 @@
  * gen_tone.h
  */
 
+#include <stdint.h>
+
 int gen_tone_init(struct audio_s *pp, int amp);
 
 // int gen_tone_open (int nchan, int sample_rate, int bit_rate, int f1, int f2, int amp, char *fname);
@@ -12,6 +14,14 @@ int gen_tone_init(struct audio_s *pp, int amp);
 
 void tone_gen_put_bit(int chan, int dat);
 
+void tone_gen_put_bytes(int chan, const unsigned char *b, int count);
+
 void gen_tone_put_sample(int chan, int a, int sam);
 
-void gen_tone_put_quiet_ms(int chan, int time_ms);
\ No newline at end of file
+void gen_tone_put_quiet_ms(int chan, int time_ms);
+
+void gen_tone_render_begin(int chan);
+
+int gen_tone_render_take(int chan, int16_t **buf);
+
+int gen_tone_render_end(int chan);
\ No newline at end of file
@@ -28,11 +28,13 @@
 #include "direwolf.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <stdint.h> // uint64_t
 
 // #include "tune.h"
+#include "dwthread.h"
 #include "demod.h"
 #include "hdlc_rec.h"
 #include "hdlc_rec2.h"
@@ -42,6 +44,8 @@
 #include "multi_modem.h"
 #include "ptt.h"
 #include "fx25.h"
+#include "tq.h"
+#include "rxlat.h"
 
 // #define TEST 1				/* Define for unit testing. */
 
@@ -75,28 +79,27 @@ struct hdlc_state_s
 
 	int prev_descram; /* Previous descrambled for 9600 baud. */
 
-	unsigned char pat_det; /* 8 bit pattern detector shift register. */
-	/* See below for more details. */
+	unsigned char run; /* Number of consecutive 1 data bits, 7 meaning 7 or more. */
+	/* This is the state for the deframe table. */
+	/* Version 1.8: Replaces the 8 bit pattern detector */
+	/* and the octet accumulator nobody ever looked at. */
 
-	unsigned int flag4_det; /* Last 32 raw bits to look for 4 */
-	/* flag patterns in a row. */
+	unsigned int pend; /* Raw bits not processed yet, oldest in LSB. */
 
-	unsigned char oacc; /* Accumulator for building up an octet. */
+	int npend; /* Number of bits in pend, 0 thru 7. */
 
-	int olen; /* Number of bits in oacc. */
-	/* When this reaches 8, oacc is copied */
-	/* to the frame buffer and olen is zeroed. */
-	/* The value of -1 is a special case meaning */
-	/* bits should not be accumulated. */
+	int is_scrambled; /* As passed in with the pending bits. */
 
-	unsigned char frame_buf[MAX_FRAME_LEN];
-	/* One frame is kept here. */
+	unsigned char pend_q[8]; /* Confidence, 0 to 100, for each bit in pend. */
 
-	int frame_len; /* Number of octets in frame_buf. */
-	/* Should be in range of 0 .. MAX_FRAME_LEN. */
+	unsigned char prev_q; /* Confidence for prev_raw. */
+
+	int soft; /* Set when the demodulator provides the confidence. */
 
 	rrbb_t rrbb; /* Handle for bit array for raw received bits. */
 
+	fx25_rec_t fx; /* FX.25 receive context, NULL if not listening for it. */
+
 	uint64_t eas_acc; /* Accumulate most recent 64 bits received for EAS. */
 
 	int eas_gathering; /* Decoding in progress. */
@@ -106,12 +109,104 @@ struct hdlc_state_s
 	int eas_fields_after_plus; /* Number of "-" characters after the "+". */
 };
 
-static struct hdlc_state_s hdlc_state[MAX_CHANS][MAX_SUBCHANS][MAX_SLICERS];
+/* Version 1.8: [num_subchan][MAX_SLICERS] for each radio channel, */
+/* allocated in hdlc_rec_init.  NULL for others. */
+
+static struct hdlc_state_s (*hdlc_state[MAX_CHANS])[MAX_SLICERS];
 
 static int num_subchan[MAX_CHANS]; // TODO1.2 use ptr rather than copy.
 
 static int composite_dcd[MAX_CHANS][MAX_SUBCHANS + 1];
 
+/*
+ * Version 1.8: Slicers of the same demodulator usually end up with exactly
+ * the same bits for a frame.  Remember the most recent frame from each,
+ * so the others only need to check whether it decoded rather than going
+ * thru the decoding, and any fix up attempts, all over again.
+ *
+ * Two different frames can't end with less than half the minimum frame
+ * length between them so a repeat within that time is the same one.
+ */
+
+static struct recent_frame_s
+{
+	uint64_t fingerprint; /* From rrbb_fingerprint. */
+	unsigned int when;	  /* From multi_modem_get_sample_time. */
+	int ok;				  /* 1 if it was decoded. */
+	int valid;
+} (*recent_frame[MAX_CHANS])[MAX_SLICERS]; /* Same as hdlc_state. */
+
+static unsigned int recent_window[MAX_CHANS]; /* In audio samples. */
+
+/* Slicers with bits in pend, for hdlc_rec_flush. */
+
+static unsigned int pending_mask[MAX_CHANS][MAX_SUBCHANS];
+
+/*
+ * Version 1.8: Table driven deframer.
+ *
+ * Indexed by the state, number of consecutive 1 data bits so far, and the
+ * next 8 data bits, oldest in the LSB.  Each entry has:
+ *
+ *	bits 0-23	The state after each of the 8 bits, 3 bits for each.
+ *			This allows fewer than 8 to be processed.
+ *	bits 32-39	Which bits complete a flag pattern, 01111110.
+ *	bits 40-47	Which bits complete an abort, seven 1 bits in a row.
+ *
+ * Bit stuffing, a 0 after five 1 bits, doesn't need to be handled here.
+ * This only splits the raw bit stream into frames and try_decode,
+ * in hdlc_rec2.c, does the rest later.
+ */
+
+#define DT_FLAG_SHIFT 32
+#define DT_ABORT_SHIFT 40
+
+static uint64_t deframe_tab[8][256];
+
+static void deframe_tab_init(void)
+{
+	int state, byte, k;
+
+	for (state = 0; state < 8; state++)
+	{
+		for (byte = 0; byte < 256; byte++)
+		{
+			int run = state;
+			uint64_t e = 0;
+
+			for (k = 0; k < 8; k++)
+			{
+				if ((byte >> k) & 1)
+				{
+					if (run == 6)
+					{
+						e |= 1ULL << (DT_ABORT_SHIFT + k);
+					}
+					if (run < 7)
+					{
+						run++;
+					}
+				}
+				else
+				{
+					if (run == 6)
+					{
+						e |= 1ULL << (DT_FLAG_SHIFT + k);
+					}
+					run = 0;
+				}
+				e |= (uint64_t)run << (3 * k);
+			}
+			deframe_tab[state][byte] = e;
+		}
+	}
+}
+
+/* With DEMODTHREADS, subchannels of a channel can change their DCD from */
+/* different threads.  Keep the before and after look at the composite consistent. */
+
+static dw_mutex_t dcd_mutex[MAX_CHANS];
+
 /***********************************************************************************
  *
  * Name:	hdlc_rec_init
@@ -138,6 +233,44 @@ void hdlc_rec_init(struct audio_s *pa)
 	g_audio_p = pa;
 
 	memset(composite_dcd, 0, sizeof(composite_dcd));
+	memset(pending_mask, 0, sizeof(pending_mask));
+
+	deframe_tab_init();
+
+	for (ch = 0; ch < MAX_CHANS; ch++)
+	{
+		dw_mutex_init(&dcd_mutex[ch]);
+	}
+
+	/*
+	 * Each slicer keeps one bit buffer and may have another being
+	 * decoded.  A few extra for good measure.
+	 */
+	int num_rrbb = 16;
+
+	for (ch = 0; ch < MAX_CHANS; ch++)
+	{
+		if (pa->chan_medium[ch] == MEDIUM_RADIO)
+		{
+			num_rrbb += 2 * pa->achan[ch].num_subchan * MAX_SLICERS;
+		}
+	}
+	/*
+	 * Bit confidence is only worth keeping for fix up attempts, and
+	 * only available from demodulators with a single slicer.
+	 */
+	int soft = 0;
+
+	for (ch = 0; ch < MAX_CHANS; ch++)
+	{
+		if (pa->chan_medium[ch] == MEDIUM_RADIO && pa->achan[ch].fix_bits > RETRY_NONE && pa->achan[ch].num_slicers <= 1)
+		{
+			soft = 1;
+		}
+	}
+	rrbb_pool_init(num_rrbb, soft);
+
+	fx25_rec_init(pa);
 
 	for (ch = 0; ch < MAX_CHANS; ch++)
 	{
@@ -147,8 +280,21 @@ void hdlc_rec_init(struct audio_s *pa)
 
 			num_subchan[ch] = pa->achan[ch].num_subchan;
 
+			if (pa->achan[ch].baud > 0)
+			{
+				recent_window[ch] = (unsigned int)((int64_t)MIN_FRAME_LEN * 8 / 2 * pa->adev[ACHAN2ADEV(ch)].samples_per_sec / pa->achan[ch].baud);
+			}
+
 			assert(num_subchan[ch] >= 1 && num_subchan[ch] <= MAX_SUBCHANS);
 
+			hdlc_state[ch] = calloc(num_subchan[ch], sizeof(*hdlc_state[ch]));
+			recent_frame[ch] = calloc(num_subchan[ch], sizeof(*recent_frame[ch]));
+			if (hdlc_state[ch] == NULL || recent_frame[ch] == NULL)
+			{
+				printf("FATAL ERROR: Out of memory.\n");
+				exit(EXIT_FAILURE);
+			}
+
 			for (sub = 0; sub < num_subchan[ch]; sub++)
 			{
 				for (slice = 0; slice < MAX_SLICERS; slice++)
@@ -156,12 +302,11 @@ void hdlc_rec_init(struct audio_s *pa)
 
 					H = &hdlc_state[ch][sub][slice];
 
-					H->olen = -1;
-
 					// TODO: FIX13 wasteful if not needed.
 					// Should loop on number of slicers, not max.
 
 					H->rrbb = rrbb_new(ch, sub, slice, 0, H->lfsr, H->prev_descram);
+					H->fx = fx25_rec_context(ch, sub, slice);
 				}
 			}
 		}
@@ -296,6 +441,223 @@ a good modem here and providing a result when it is received.
 
 */
 
+/*
+ * The special pattern 01111110 indicates beginning and ending of a frame.
+ * If we have an adequate number of whole octets, it is a candidate for
+ * further processing.
+ */
+
+/*
+ * Another slicer of the same demodulator with the same frame just now.
+ * Returns the slicer number or -1.
+ */
+
+static int find_recent_frame(int chan, int subchan, int slice, uint64_t fingerprint, unsigned int now)
+{
+	int k;
+
+	for (k = 0; k < g_audio_p->achan[chan].num_slicers; k++)
+	{
+		struct recent_frame_s *r = &recent_frame[chan][subchan][k];
+
+		if (k != slice && r->valid && r->fingerprint == fingerprint && now - r->when <= recent_window[chan])
+		{
+			return (k);
+		}
+	}
+	return (-1);
+}
+
+static void end_of_frame(int chan, int subchan, int slice, struct hdlc_state_s *H)
+{
+	rrbb_chop8(H->rrbb);
+
+	if (rrbb_get_len(H->rrbb) >= MIN_FRAME_LEN * 8 && g_audio_p->achan[chan].num_slicers > 1)
+	{
+		struct recent_frame_s *r = &recent_frame[chan][subchan][slice];
+		unsigned int now = multi_modem_get_sample_time(chan);
+		uint64_t fingerprint = rrbb_fingerprint(H->rrbb);
+		int k = find_recent_frame(chan, subchan, slice, fingerprint, now);
+
+		r->fingerprint = fingerprint;
+		r->when = now;
+		r->valid = 1;
+
+		if (k >= 0)
+		{
+			/* Also decoded by this slicer.  Or not. */
+
+			r->ok = recent_frame[chan][subchan][k].ok && multi_modem_process_rec_dup(chan, subchan, slice, k);
+			rrbb_clear(H->rrbb, H->is_scrambled, H->lfsr, H->prev_descram);
+		}
+		else
+		{
+			rrbb_set_audio_level(H->rrbb, demod_get_audio_level(chan, subchan));
+			rrbb_set_end_time(H->rrbb, rxlat_now());
+			r->ok = hdlc_rec2_block(H->rrbb);
+			/* Now owned by someone else who will free it. */
+
+			H->rrbb = rrbb_new(chan, subchan, slice, H->is_scrambled, H->lfsr, H->prev_descram); /* Allocate a new one. */
+		}
+	}
+	else if (rrbb_get_len(H->rrbb) >= MIN_FRAME_LEN * 8)
+	{
+
+		alevel_t alevel = demod_get_audio_level(chan, subchan);
+
+		rrbb_set_audio_level(H->rrbb, alevel);
+		rrbb_set_end_time(H->rrbb, rxlat_now());
+		hdlc_rec2_block(H->rrbb);
+		/* Now owned by someone else who will free it. */
+
+		H->rrbb = rrbb_new(chan, subchan, slice, H->is_scrambled, H->lfsr, H->prev_descram); /* Allocate a new one. */
+	}
+	else
+	{
+		rrbb_clear(H->rrbb, H->is_scrambled, H->lfsr, H->prev_descram);
+	}
+
+	rrbb_append_bit(H->rrbb, H->prev_raw); /* Last bit of flag.  Needed to get first data bit. */
+	if (H->soft)
+	{
+		rrbb_append_conf(H->rrbb, &H->prev_q, 1);
+	}
+										   /* Now that we are saving other initial state information, */
+										   /* it would be sensible to do the same for this instead */
+										   /* of lumping it in with the frame data bits. */
+}
+
+/*
+ * Process the pending raw bits, 1 to 8 of them, for one slicer.
+ *
+ * Using NRZI encoding,
+ *   A '0' bit is represented by an inversion since previous bit.
+ *   A '1' bit is represented by no change.
+ *
+ * The raw bits go into the bit buffer, a whole group at once unless the
+ * table says there is a flag or abort among them.  Valid data will never
+ * have 7 one bits in a row.  That indicates loss of signal so we discard
+ * what has been gathered.
+ */
+
+__attribute__((hot)) static void rec_bits(int chan, int subchan, int slice, struct hdlc_state_s *H)
+{
+	unsigned int raw = H->pend;
+	int n = H->npend;
+	unsigned int mask = (1u << n) - 1;
+	unsigned int data = ~(raw ^ ((raw << 1) | H->prev_raw)) & mask;
+
+	H->pend = 0;
+	H->npend = 0;
+
+	// After BER insertion, NRZI, and any descrambling, feed into FX.25 decoder as well.
+	if (H->fx != NULL)
+	{
+		fx25_rec_bits(H->fx, data, n);
+	}
+
+	uint64_t e = deframe_tab[H->run][data];
+	unsigned int events = ((e >> DT_FLAG_SHIFT) | (e >> DT_ABORT_SHIFT)) & mask;
+
+	H->run = (e >> (3 * (n - 1))) & 7;
+
+	if (events == 0)
+	{
+		rrbb_append_bits(H->rrbb, raw, n);
+		if (H->soft)
+		{
+			rrbb_append_conf(H->rrbb, H->pend_q, n);
+			H->prev_q = H->pend_q[n - 1];
+		}
+		H->prev_raw = (raw >> (n - 1)) & 1;
+		return;
+	}
+
+	int start = 0;
+
+	for (; events != 0; events &= events - 1)
+	{
+		int p = __builtin_ctz(events);
+
+		rrbb_append_bits(H->rrbb, (raw >> start) & ((1u << (p + 1 - start)) - 1), p + 1 - start);
+		if (H->soft)
+		{
+			rrbb_append_conf(H->rrbb, H->pend_q + start, p + 1 - start);
+			H->prev_q = H->pend_q[p];
+		}
+		H->prev_raw = (raw >> p) & 1;
+		start = p + 1;
+
+		if ((e >> (DT_FLAG_SHIFT + p)) & 1)
+		{
+			end_of_frame(chan, subchan, slice, H);
+		}
+		else
+		{
+			rrbb_clear(H->rrbb, H->is_scrambled, H->lfsr, H->prev_descram);
+		}
+	}
+
+	if (start < n)
+	{
+		rrbb_append_bits(H->rrbb, raw >> start, n - start);
+		if (H->soft)
+		{
+			rrbb_append_conf(H->rrbb, H->pend_q + start, n - start);
+			H->prev_q = H->pend_q[n - 1];
+		}
+		H->prev_raw = (raw >> (n - 1)) & 1;
+	}
+}
+
+/* Part of hdlc_rec_bit after the checks. */
+/* Gather raw bits, 8 at a time, for the deframe table. */
+
+__attribute__((hot)) __attribute__((always_inline)) static inline void rec_bit(int chan, int subchan, int slice, int raw, int is_scrambled)
+{
+	struct hdlc_state_s *H;
+
+	/*
+	 * Different state information for each channel / subchannel / slice.
+	 */
+	H = &hdlc_state[chan][subchan][slice];
+
+	H->pend |= (unsigned int)raw << H->npend;
+	H->npend++;
+	H->is_scrambled = is_scrambled;
+
+	if (H->npend == 8)
+	{
+		rec_bits(chan, subchan, slice, H);
+		pending_mask[chan][subchan] &= ~(1u << slice);
+	}
+	else
+	{
+		pending_mask[chan][subchan] |= 1u << slice;
+	}
+}
+
+/* -e option can be used to artificially introduce the desired */
+/* Bit Error Rate (BER) for testing. */
+
+__attribute__((always_inline)) static inline int maybe_clobber(int raw)
+{
+	if (g_audio_p->recv_ber != 0)
+	{
+		double r = (double)my_rand() / (double)MY_RAND_MAX; // calculate as double to preserve all 31 bits.
+		if (g_audio_p->recv_ber > r)
+		{
+
+			// FIXME
+			//
+			// printf ("hdlc_rec_bit randomly clobber bit, ber = %.6f\n", g_audio_p->recv_ber);
+
+			raw = !raw;
+		}
+	}
+	return (raw);
+}
+
 /***********************************************************************************
  *
  * Name:	hdlc_rec_bit
@@ -313,6 +675,9 @@ a good modem here and providing a result when it is received.
  *
  *		is_scrambled - Is the data scrambled?
  *
+ *		quality	- Confidence in the bit, 0 to 100.  Kept with the
+ *			  bits so the fix up attempts can start with the
+ *			  least certain ones.
  *
  * Description:	This is called once for each received bit.
  *		For each valid frame, process_rec_frame()
@@ -320,13 +685,8 @@ a good modem here and providing a result when it is received.
  *
  ***********************************************************************************/
 
-void hdlc_rec_bit(int chan, int subchan, int slice, int raw, int is_scrambled)
+void hdlc_rec_bit(int chan, int subchan, int slice, int raw, int is_scrambled, int quality)
 {
-
-	int dbit; /* Data bit after undoing NRZI. */
-	/* Should be only 0 or 1. */
-	struct hdlc_state_s *H;
-
 	assert(was_init == 1);
 
 	assert(chan >= 0 && chan < MAX_CHANS);
@@ -334,183 +694,111 @@ void hdlc_rec_bit(int chan, int subchan, int slice, int raw, int is_scrambled)
 
 	assert(slice >= 0 && slice < MAX_SLICERS);
 
-	// -e option can be used to artificially introduce the desired
-	// Bit Error Rate (BER) for testing.
-
-	if (g_audio_p->recv_ber != 0)
-	{
-		double r = (double)my_rand() / (double)MY_RAND_MAX; // calculate as double to preserve all 31 bits.
-		if (g_audio_p->recv_ber > r)
-		{
+	struct hdlc_state_s *H = &hdlc_state[chan][subchan][slice];
 
-			// FIXME
-			//
-			// printf ("hdlc_rec_bit randomly clobber bit, ber = %.6f\n", g_audio_p->recv_ber);
+	H->pend_q[H->npend] = quality;
+	H->soft = 1;
 
-			raw = !raw;
-		}
-	}
+	rec_bit(chan, subchan, slice, maybe_clobber(raw), is_scrambled);
+}
 
-	/*
-	 * Different state information for each channel / subchannel / slice.
-	 */
-	H = &hdlc_state[chan][subchan][slice];
+/***********************************************************************************
+ *
+ * Name:	hdlc_rec_bits
+ *
+ * Purpose:	Same as hdlc_rec_bit for several bits of one slicer at once.
+ *
+ * Inputs:	chan	- Channel number.
+ *
+ *		subchan	- This allows multiple demodulators per channel.
+ *
+ *		slice	- Allows multiple slicers per demodulator (subchannel).
+ *
+ *		bits	- Bits from the demodulator, oldest in the LSB.
+ *
+ *		nbits	- Number of bits, 0 to 64.
+ *
+ *		is_scrambled - Is the data scrambled?
+ *
+ * Description:	The checks, the state lookup and the BER test are done
+ *		once for the whole group.  The bits go into the deframe
+ *		table up to 8 at a time rather than one at a time.
+ *
+ ***********************************************************************************/
 
-	/*
-	 * Using NRZI encoding,
-	 *   A '0' bit is represented by an inversion since previous bit.
-	 *   A '1' bit is represented by no change.
-	 */
+__attribute__((hot)) void hdlc_rec_bits(int chan, int subchan, int slice, uint64_t bits, int nbits, int is_scrambled)
+{
+	assert(was_init == 1);
 
-	dbit = (raw == H->prev_raw);
-	H->prev_raw = raw;
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
 
-	// After BER insertion, NRZI, and any descrambling, feed into FX.25 decoder as well.
-	fx25_rec_bit(chan, subchan, slice, dbit);
+	assert(slice >= 0 && slice < MAX_SLICERS);
+	assert(nbits >= 0 && nbits <= 64);
 
-	/*
-	 * Octets are sent LSB first.
-	 * Shift the most recent 8 bits thru the pattern detector.
-	 */
-	H->pat_det >>= 1;
-	if (dbit)
-	{
-		H->pat_det |= 0x80;
-	}
+	struct hdlc_state_s *H = &hdlc_state[chan][subchan][slice];
 
-	H->flag4_det >>= 1;
-	if (dbit)
+	if (g_audio_p->recv_ber != 0)
 	{
-		H->flag4_det |= 0x80000000;
+		for (int k = 0; k < nbits; k++)
+		{
+			bits ^= (uint64_t)(maybe_clobber(0)) << k;
+		}
 	}
 
-	rrbb_append_bit(H->rrbb, raw);
+	H->is_scrambled = is_scrambled;
 
-	if (H->pat_det == 0x7e)
+	while (nbits > 0)
 	{
+		int take = 8 - H->npend < nbits ? 8 - H->npend : nbits;
 
-		rrbb_chop8(H->rrbb);
-
-		/*
-		 * The special pattern 01111110 indicates beginning and ending of a frame.
-		 * If we have an adequate number of whole octets, it is a candidate for
-		 * further processing.
-		 *
-		 * It might look odd that olen is being tested for 7 instead of 0.
-		 * This is because oacc would already have 7 bits from the special
-		 * "flag" pattern before it is detected here.
-		 */
-
-		if (rrbb_get_len(H->rrbb) >= MIN_FRAME_LEN * 8)
-		{
-
-			alevel_t alevel = demod_get_audio_level(chan, subchan);
-
-			rrbb_set_audio_level(H->rrbb, alevel);
-			hdlc_rec2_block(H->rrbb);
-			/* Now owned by someone else who will free it. */
+		H->pend |= (unsigned int)(bits & ((1u << take) - 1)) << H->npend;
+		H->npend += take;
+		bits >>= take;
+		nbits -= take;
 
-			H->rrbb = rrbb_new(chan, subchan, slice, is_scrambled, H->lfsr, H->prev_descram); /* Allocate a new one. */
-		}
-		else
+		if (H->npend == 8)
 		{
-			rrbb_clear(H->rrbb, is_scrambled, H->lfsr, H->prev_descram);
+			rec_bits(chan, subchan, slice, H);
 		}
-
-		H->olen = 0; /* Allow accumulation of octets. */
-		H->frame_len = 0;
-
-		rrbb_append_bit(H->rrbb, H->prev_raw); /* Last bit of flag.  Needed to get first data bit. */
-											   /* Now that we are saving other initial state information, */
-											   /* it would be sensible to do the same for this instead */
-											   /* of lumping it in with the frame data bits. */
 	}
 
-	// #define EXPERIMENT12B 1
-
-#if EXPERIMENT12B
-
-	else if (H->pat_det == 0xff)
-	{
-
-		/*
-		 * Valid data will never have seven 1 bits in a row.
-		 *
-		 *	11111110
-		 *
-		 * This indicates loss of signal.
-		 * But we will let it slip thru because it might diminish
-		 * our single bit fixup effort.   Instead give up on frame
-		 * only when we see eight 1 bits in a row.
-		 *
-		 *	11111111
-		 *
-		 * What is the impact?  No difference.
-		 *
-		 *  Before:	atest -P E -F 1 ../02_Track_2.wav	= 1003
-		 *  After:	atest -P E -F 1 ../02_Track_2.wav	= 1003
-		 */
-
-#else
-	else if (H->pat_det == 0xfe)
+	if (H->npend > 0)
 	{
-
-		/*
-		 * Valid data will never have 7 one bits in a row.
-		 *
-		 *	11111110
-		 *
-		 * This indicates loss of signal.
-		 */
-
-#endif
-
-		H->olen = -1;	  /* Stop accumulating octets. */
-		H->frame_len = 0; /* Discard anything in progress. */
-
-		rrbb_clear(H->rrbb, is_scrambled, H->lfsr, H->prev_descram);
-	}
-	else if ((H->pat_det & 0xfc) == 0x7c)
-	{
-
-		/*
-		 * If we have five '1' bits in a row, followed by a '0' bit,
-		 *
-		 *	0111110xx
-		 *
-		 * the current '0' bit should be discarded because it was added for
-		 * "bit stuffing."
-		 */
-		;
+		pending_mask[chan][subchan] |= 1u << slice;
 	}
 	else
 	{
+		pending_mask[chan][subchan] &= ~(1u << slice);
+	}
+}
 
-		/*
-		 * In all other cases, accumulate bits into octets, and complete octets
-		 * into the frame buffer.
-		 */
-		if (H->olen >= 0)
-		{
+/***********************************************************************************
+ *
+ * Name:	hdlc_rec_flush
+ *
+ * Purpose:	Finish processing bits gathered for the deframe table.
+ *
+ * Inputs:	chan	- Channel number.
+ *
+ *		subchan	- Demodulator of the channel.
+ *
+ * Description:	Called at the end of each block of audio samples.
+ *		Candidates in multi_modem.c are aged a block at a time so
+ *		frames found here still go in with the same timing as
+ *		when every bit was processed as it arrived.
+ *
+ ***********************************************************************************/
 
-			H->oacc >>= 1;
-			if (dbit)
-			{
-				H->oacc |= 0x80;
-			}
-			H->olen++;
+void hdlc_rec_flush(int chan, int subchan)
+{
+	unsigned int m = pending_mask[chan][subchan];
 
-			if (H->olen == 8)
-			{
-				H->olen = 0;
+	pending_mask[chan][subchan] = 0;
 
-				if (H->frame_len < MAX_FRAME_LEN)
-				{
-					H->frame_buf[H->frame_len] = H->oacc;
-					H->frame_len++;
-				}
-			}
-		}
+	for (; m != 0; m &= m - 1)
+	{
+		rec_bits(chan, subchan, __builtin_ctz(m), &hdlc_state[chan][subchan][__builtin_ctz(m)]);
 	}
 }
 
@@ -559,6 +847,8 @@ void dcd_change(int chan, int subchan, int slice, int state)
 	printf("DCD %d.%d.%d = %d \n", chan, subchan, slice, state);
 #endif
 
+	dw_mutex_lock(&dcd_mutex[chan]);
+
 	old = hdlc_rec_data_detect_any(chan);
 
 	if (state)
@@ -576,6 +866,15 @@ void dcd_change(int chan, int subchan, int slice, int state)
 	{
 		ptt_set(OCTYPE_DCD, chan, new);
 	}
+
+	dw_mutex_unlock(&dcd_mutex[chan]);
+
+	// Version 1.8: Transmit thread might be waiting for the channel to clear.
+
+	if (new != old)
+	{
+		tq_channel_busy_change(chan);
+	}
 }
 
 /*-------------------------------------------------------------------
@@ -4,7 +4,11 @@
 
 void hdlc_rec_init(struct audio_s *pa);
 
-void hdlc_rec_bit(int chan, int subchan, int slice, int raw, int is_scrambled);
+void hdlc_rec_bit(int chan, int subchan, int slice, int raw, int is_scrambled, int quality);
+
+void hdlc_rec_bits(int chan, int subchan, int slice, uint64_t bits, int nbits, int is_scrambled);
+
+void hdlc_rec_flush(int chan, int subchan);
 
 /* Provided elsewhere to process a complete frame. */
 
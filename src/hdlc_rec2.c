@@ -81,6 +81,22 @@
  *		Took out the delayed processing and just do it realtime.
  *		Changed SWAP to INVERT because it is more descriptive.
  *
+ * Version 1.8:	Delayed processing is back, as an option.  With FIXTHREADS,
+ *		the fix up attempts run in background threads so a long
+ *		frame can't hold up the audio.  Results go back into the
+ *		candidate list in multi_modem.c before the best is picked.
+ *
+ *		The frame is no longer decoded again for every bit inversion
+ *		attempted.  The CRC says which ones could possibly work.
+ *		See syndrome_init below.
+ *
+ *		FIX_BUDGET limits the time spent on one frame, and for the
+ *		channel over time, so a noisy channel can't take all the CPU.
+ *		The more expensive attempts are given up first.
+ *
+ *		When the demodulator says how sure it was of each bit,
+ *		the least certain ones are tried first.  See try_chase.
+ *
  *******************************************************************************/
 
 #include "direwolf.h"
@@ -89,6 +105,13 @@
 #include <assert.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#if __WIN32__
+#include <process.h>
+#else
+#include <time.h>
+#endif
 
 // Optimize processing by accessing directly to decoded bits
 #define RRBB_C 1
@@ -98,6 +121,7 @@
 #include "rrbb.h"
 #include "multi_modem.h"
 #include "audio.h" /* for struct audio_s */
+#include "dwthread.h"
 
 // #define DEBUG 1
 // #define DEBUGx 1
@@ -142,7 +166,9 @@ struct hdlc_state2_s
 	unsigned char pat_det; /* 8 bit pattern detector shift register. */
 	/* See below for more details. */
 
-	unsigned char oacc; /* Accumulator for building up an octet. */
+	unsigned int oacc; /* Accumulator for building up an octet. */
+	/* Version 1.8: Oldest bit in the LSB so */
+	/* whole words can be merged in.  */
 
 	int olen; /* Number of bits in oacc. */
 	/* When this reaches 8, oacc is copied */
@@ -155,12 +181,119 @@ struct hdlc_state2_s
 				   /* Should be in range of 0 .. MAX_FRAME_LEN. */
 };
 
-static int try_decode(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel, retry_conf_t retry_conf, int passall);
+static int try_decode(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel, retry_conf_t retry_conf, int passall, int later);
+
+static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel, int later);
 
-static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel);
+static int try_to_fix_levels(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel, int later, retry_t fix_bits, int64_t deadline);
 
 static int sanity_check(unsigned char *buf, int blen, retry_t bits_flipped, enum sanity_e sanity_test);
 
+/*
+ * Version 1.8:  Use the CRC to find which bits to invert.
+ *
+ * The FCS is linear.  Inverting several bits of the frame changes it by
+ * the exclusive or of the changes for inverting each one alone.  So we
+ * decode the frame once, find how far off the FCS is (the syndrome), and
+ * how much inverting each data bit would change it.  Most attempts can
+ * then be rejected by comparing two 16 bit numbers rather than decoding
+ * the whole frame again.
+ *
+ * This only holds while the bit stuffing stays the same.  Inverting a bit
+ * next to a run of five 1 bits can add or remove a stuffed bit, or make
+ * a flag or abort, which moves everything after it.  Those attempts still
+ * get decoded the slow way.  For two separated bits, the frame is decoded
+ * once with the awkward one inverted and the same trick used to find its
+ * partner.
+ *
+ * Anything not ruled out still goes thru try_decode, in the same order as
+ * before, so the results are the same as trying everything.
+ */
+
+struct syndrome_s
+{
+	int blen;				 /* Number of raw bits. */
+	int valid;				 /* 0 if the frame was too long to keep it all. */
+	int clean;				 /* Whole number of octets, long enough, */
+							 /* no flag or abort pattern. */
+	unsigned short syndrome; /* Expected FCS xor actual.  0 is good. */
+
+	unsigned char d[MAX_NUM_BITS + 1];	   /* Data bit i from raw bits i-1 and i. */
+	unsigned char near5[MAX_NUM_BITS + 1]; /* Within one bit of a run of five or more 1 bits. */
+	unsigned short dl[MAX_NUM_BITS + 1];   /* How inverting data bit i changes the syndrome. */
+										   /* 0 for stuffed bits. */
+};
+
+/*
+ * Two separated bits closer than this might affect each other's bit stuffing.
+ */
+
+#define SEP_FAR 16
+
+/*
+ * Queue of blocks waiting for the fix up threads.
+ * When full, new ones are dropped rather than making the audio wait.
+ */
+
+#define FIX_QUEUE_SIZE 32
+
+static struct fix_queue_s
+{
+	rrbb_t block[FIX_QUEUE_SIZE];
+	unsigned int ticket[FIX_QUEUE_SIZE];
+	int head; /* Next to take. */
+	int count;
+	dw_mutex_t mutex;
+#if __WIN32__
+	HANDLE wake_sem; /* Count of blocks in queue. */
+#else
+	pthread_cond_t wake_cond;
+#endif
+} fix_queue;
+
+static int num_fix_threads = 0;
+
+/*
+ * Each block handed over gets the next ticket number for its channel.
+ * fix_done_upto is the first ticket not finished yet.  Those finished
+ * out of order, by another thread, are marked in fix_done_flag until
+ * the ones before them are finished too.  There can't be more than
+ * FIX_QUEUE_SIZE + MAX_FIX_THREADS outstanding.
+ */
+
+#define FIX_DONE_RING 64
+
+static unsigned int fix_next_ticket[MAX_CHANS];
+static unsigned int fix_done_upto[MAX_CHANS];
+static unsigned char fix_done_flag[MAX_CHANS][FIX_DONE_RING];
+
+static int fix_queued = 0;
+static int fix_dropped = 0;
+
+/*
+ * FIX_BUDGET state for each channel.
+ *
+ * The credit, in microseconds, grows by fix_max_percent of the audio
+ * time received and shrinks by the time spent fixing.  It can save up
+ * at most one second worth.
+ */
+
+static dw_mutex_t budget_mutex;
+static int64_t budget_credit[MAX_CHANS];
+static unsigned int budget_sample_time[MAX_CHANS];
+static int budget_exhausted[MAX_CHANS];
+
+/*
+ * How often, in outer loop iterations, to look at the clock
+ * while trying separated bits.
+ */
+
+#define BUDGET_CHECK_EVERY 32
+
+static void fix_later(rrbb_t block, int chan);
+
+static void fix_threads_init(int n);
+
 /***********************************************************************************
  *
  * Name:	hdlc_rec2_init
@@ -192,7 +325,246 @@ static int sanity_check(unsigned char *buf, int blen, retry_t bits_flipped, enum
 
 void hdlc_rec2_init(struct audio_s *p_audio_config)
 {
+	int chan;
+	int need = 0;
+
 	save_audio_config_p = p_audio_config;
+
+	dw_mutex_init(&budget_mutex);
+
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		budget_credit[chan] = (int64_t)p_audio_config->achan[chan].fix_max_percent * 10000;
+		budget_sample_time[chan] = 0;
+		budget_exhausted[chan] = 0;
+
+		if (p_audio_config->chan_medium[chan] == MEDIUM_RADIO &&
+			(p_audio_config->achan[chan].fix_bits > RETRY_NONE || p_audio_config->achan[chan].passall))
+		{
+			need = 1;
+		}
+	}
+
+	if (need && p_audio_config->fix_threads > 0)
+	{
+		fix_threads_init(p_audio_config->fix_threads);
+	}
+}
+
+/***********************************************************************************
+ *
+ * Name:	fix_thread
+ *
+ * Purpose:	Background thread for the fix up attempts.
+ *
+ * Description:	Takes blocks from the queue and does what hdlc_rec2_block
+ *		would have done after the first attempt failed.
+ *		A good frame goes to multi_modem_process_rec_frame_later.
+ *
+ ***********************************************************************************/
+
+#if __WIN32__
+static unsigned __stdcall fix_thread(void *arg)
+#else
+static void *fix_thread(void *arg)
+#endif
+{
+	struct fix_queue_s *Q = &fix_queue;
+
+	while (1)
+	{
+		rrbb_t block;
+
+#if __WIN32__
+		WaitForSingleObject(Q->wake_sem, INFINITE);
+		dw_mutex_lock(&Q->mutex);
+#else
+		dw_mutex_lock(&Q->mutex);
+		while (Q->count == 0)
+		{
+			pthread_cond_wait(&Q->wake_cond, &Q->mutex);
+		}
+#endif
+		block = Q->block[Q->head];
+		unsigned int ticket = Q->ticket[Q->head];
+		Q->head = (Q->head + 1) % FIX_QUEUE_SIZE;
+		Q->count--;
+		dw_mutex_unlock(&Q->mutex);
+
+		int chan = rrbb_get_chan(block);
+		int subchan = rrbb_get_subchan(block);
+		int slice = rrbb_get_slice(block);
+		alevel_t alevel = rrbb_get_audio_level(block);
+
+		if (!try_to_fix_quick_now(block, chan, subchan, slice, alevel, 1) &&
+			save_audio_config_p->achan[chan].passall)
+		{
+			retry_conf_t retry_cfg;
+
+			memset(&retry_cfg, 0, sizeof(retry_cfg));
+			retry_cfg.type = RETRY_TYPE_NONE;
+			retry_cfg.mode = RETRY_MODE_CONTIGUOUS;
+			retry_cfg.retry = RETRY_NONE;
+			try_decode(block, chan, subchan, slice, alevel, retry_cfg, 1, 1);
+		}
+		rrbb_delete(block);
+
+		/* Any result is already on its way so the candidates can be picked. */
+
+		dw_mutex_lock(&Q->mutex);
+		fix_done_flag[chan][ticket % FIX_DONE_RING] = 1;
+		while (fix_done_flag[chan][fix_done_upto[chan] % FIX_DONE_RING])
+		{
+			fix_done_flag[chan][fix_done_upto[chan] % FIX_DONE_RING] = 0;
+			__atomic_add_fetch(&fix_done_upto[chan], 1, __ATOMIC_SEQ_CST);
+		}
+		dw_mutex_unlock(&Q->mutex);
+	}
+#if __WIN32__
+	return (0);
+#else
+	return (NULL);
+#endif
+}
+
+static void fix_threads_init(int n)
+{
+	struct fix_queue_s *Q = &fix_queue;
+	int i;
+
+	memset(Q, 0, sizeof(struct fix_queue_s));
+	dw_mutex_init(&Q->mutex);
+#if __WIN32__
+	Q->wake_sem = CreateSemaphore(NULL, 0, FIX_QUEUE_SIZE, NULL);
+	if (Q->wake_sem == NULL)
+	{
+		printf("FATAL: Could not create fix up semaphore.\n");
+		exit(1);
+	}
+#else
+	pthread_cond_init(&Q->wake_cond, NULL);
+#endif
+
+	for (i = 0; i < n; i++)
+	{
+#if __WIN32__
+		if (_beginthreadex(NULL, 0, fix_thread, NULL, 0, NULL) == 0)
+		{
+			printf("FATAL: Could not create fix up thread.\n");
+			exit(1);
+		}
+#else
+		pthread_t tid;
+		int e = pthread_create(&tid, NULL, fix_thread, NULL);
+		if (e != 0)
+		{
+			printf("FATAL: Could not create fix up thread.\n");
+			exit(1);
+		}
+		pthread_detach(tid);
+#endif
+	}
+	num_fix_threads = n;
+}
+
+/*
+ * Hand over a block, which failed the first attempt, to the fix up threads.
+ * The queue now owns it.
+ */
+
+static void fix_later(rrbb_t block, int chan)
+{
+	struct fix_queue_s *Q = &fix_queue;
+
+	dw_mutex_lock(&Q->mutex);
+
+	if (Q->count >= FIX_QUEUE_SIZE)
+	{
+		dw_mutex_unlock(&Q->mutex);
+		if (__atomic_add_fetch(&fix_dropped, 1, __ATOMIC_SEQ_CST) == 1)
+		{
+			printf("Fix up queue is full.  Frames are being dropped.  Try more FIXTHREADS or less FIX_BITS.\n");
+		}
+		rrbb_delete(block);
+		return;
+	}
+
+	rrbb_set_sample_time(block, multi_modem_get_sample_time(chan));
+	Q->ticket[(Q->head + Q->count) % FIX_QUEUE_SIZE] = fix_next_ticket[chan];
+	__atomic_add_fetch(&fix_next_ticket[chan], 1, __ATOMIC_SEQ_CST);
+	Q->block[(Q->head + Q->count) % FIX_QUEUE_SIZE] = block;
+	Q->count++;
+	__atomic_add_fetch(&fix_queued, 1, __ATOMIC_SEQ_CST);
+
+#if __WIN32__
+	ReleaseSemaphore(Q->wake_sem, 1, NULL);
+#else
+	pthread_cond_signal(&Q->wake_cond);
+#endif
+	dw_mutex_unlock(&Q->mutex);
+}
+
+/***********************************************************************************
+ *
+ * Name:	hdlc_rec2_fix_ticket
+ *
+ * Purpose:	Get the ticket number for the next block of the channel
+ *		handed over to the fix up threads.
+ *
+ * Description:	multi_modem.c takes one when it is ready to pick the best
+ *		candidate, then waits until hdlc_rec2_fix_done says all those
+ *		before it are finished.  That way a fixed frame can be
+ *		considered along with the others, rather than showing up
+ *		later as a duplicate.
+ *
+ *		Without FIXTHREADS, nothing is ever outstanding.
+ *
+ ***********************************************************************************/
+
+unsigned int hdlc_rec2_fix_ticket(int chan)
+{
+	return (__atomic_load_n(&fix_next_ticket[chan], __ATOMIC_SEQ_CST));
+}
+
+/* True when all blocks for the channel before ticket have been processed. */
+
+int hdlc_rec2_fix_done(int chan, unsigned int ticket)
+{
+	return ((int)(__atomic_load_n(&fix_done_upto[chan], __ATOMIC_SEQ_CST) - ticket) >= 0);
+}
+
+/***********************************************************************************
+ *
+ * Name:	hdlc_rec2_fix_stats
+ *
+ * Purpose:	Find out whether the fix up threads are keeping up.
+ *
+ * Outputs:	queued	- Number of blocks handed over to the threads.
+ *		dropped	- Number discarded because the queue was full.
+ *
+ ***********************************************************************************/
+
+void hdlc_rec2_fix_stats(int *queued, int *dropped)
+{
+	*queued = __atomic_load_n(&fix_queued, __ATOMIC_SEQ_CST);
+	*dropped = __atomic_load_n(&fix_dropped, __ATOMIC_SEQ_CST);
+}
+
+/***********************************************************************************
+ *
+ * Name:	hdlc_rec2_budget_stats
+ *
+ * Purpose:	Find out how often FIX_BUDGET held back the fix up attempts.
+ *
+ * Inputs:	chan	- Radio channel.
+ *
+ * Returns:	Number of frames which did not get the full FIX_BITS effort.
+ *
+ ***********************************************************************************/
+
+int hdlc_rec2_budget_stats(int chan)
+{
+	return (__atomic_load_n(&budget_exhausted[chan], __ATOMIC_SEQ_CST));
 }
 
 /***********************************************************************************
@@ -212,11 +584,14 @@ void hdlc_rec2_init(struct audio_s *p_audio_config)
  *		This allows us to try decoding the same received data more
  *		than once.
  *
+ * Returns:	1 if a frame was passed along, 0 if not, or if it was handed
+ *		over to the fix up threads.
+ *
  * Version 1.2:	Now works properly for G3RUH type scrambling.
  *
  ***********************************************************************************/
 
-void hdlc_rec2_block(rrbb_t block)
+int hdlc_rec2_block(rrbb_t block)
 {
 	int chan = rrbb_get_chan(block);
 	int subchan = rrbb_get_subchan(block);
@@ -247,7 +622,7 @@ void hdlc_rec2_block(rrbb_t block)
 	retry_cfg.u_bits.contig.nr_bits = 0;
 	retry_cfg.u_bits.contig.bit_idx = 0;
 
-	ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, passall & (fix_bits == RETRY_NONE));
+	ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, passall & (fix_bits == RETRY_NONE), 0);
 	if (ok)
 	{
 #if DEBUG
@@ -255,33 +630,465 @@ void hdlc_rec2_block(rrbb_t block)
 		printf("Got it the first time.\n");
 #endif
 		rrbb_delete(block);
-		return;
+		return (1);
+	}
+
+	/*
+	 * The rest can take a while.  Let someone else do it if possible.
+	 */
+	if (num_fix_threads > 0 && (fix_bits > RETRY_NONE || passall))
+	{
+		fix_later(block, chan);
+		return (0);
 	}
 
 	/*
 	 * Not successful with frame in original form.
 	 * See if we can "fix" it.
 	 */
-	if (try_to_fix_quick_now(block, chan, subchan, slice, alevel))
+	if (try_to_fix_quick_now(block, chan, subchan, slice, alevel, 0))
 	{
 		rrbb_delete(block);
-		return;
+		return (1);
+	}
+
+	if (passall)
+	{
+		/* Exhausted all desired fix up attempts. */
+		/* Let thru even with bad CRC.  Of course, it still */
+		/* needs to be a minimum number of whole octets. */
+		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 1, 0);
+		rrbb_delete(block);
+	}
+	else
+	{
+		rrbb_delete(block);
+	}
+	return (ok);
+
+} /* end hdlc_rec2_block */
+
+/*
+ * Invert bit n of the raw bits.  Negative is ignored.
+ */
+
+static inline void flip_bit(uint64_t *raw, int n)
+{
+	if (n >= 0)
+	{
+		raw[n >> 6] ^= (uint64_t)1 << (n & 63);
 	}
+}
+
+/***********************************************************************************
+ *
+ * Name:	syndrome_init
+ *
+ * Purpose:	Decode the frame once for the quick fix up attempts.
+ *
+ * Inputs:	raw	- Raw bits, as in try_decode.
+ *		blen	- Number of raw bits.
+ *
+ * Outputs:	s	- See struct syndrome_s.
+ *
+ ***********************************************************************************/
+
+static inline int get_raw_bit(const uint64_t *raw, int n)
+{
+	return ((raw[n >> 6] >> (n & 63)) & 1);
+}
+
+static void syndrome_init(struct syndrome_s *s, const uint64_t *raw, int blen)
+{
+	unsigned char frame[MAX_FRAME_LEN];
+	short obit[MAX_NUM_BITS + 1]; /* Position in frame, -1 if none. */
+	unsigned char pat_det = 0;
+	unsigned short r = 0;
+	int nout = 0;
+	int nd;
+	int i, k;
+
+	s->blen = blen;
+	s->valid = 1;
+	s->clean = 1;
+	s->syndrome = 0;
+
+	s->d[0] = 0;
+	for (i = 1; i < blen; i++)
+	{
+		s->d[i] = get_raw_bit(raw, i) == get_raw_bit(raw, i - 1);
+	}
+	s->d[blen] = 0;
+
+	memset(s->near5, 0, blen + 1);
+	for (i = 1; i < blen; i = k + 1)
+	{
+		for (k = i; k < blen && s->d[k]; k++)
+			;
+		if (k - i >= 5)
+		{
+			memset(s->near5 + i - 1, 1, k - i + 2);
+		}
+	}
+
+	/* Same as one_data_bit. */
+
+	memset(frame, 0, sizeof(frame));
+	obit[0] = -1;
+	obit[blen] = -1;
+	for (i = 1; i < blen; i++)
+	{
+		int dbit = s->d[i];
+
+		obit[i] = -1;
+		if (!s->clean)
+			continue;
+
+		pat_det >>= 1;
+		if (dbit)
+		{
+			pat_det |= 0x80;
+			if (pat_det == 0xfe)
+			{
+				s->clean = 0;
+				continue;
+			}
+		}
+		else if (pat_det == 0x7e)
+		{
+			s->clean = 0;
+			continue;
+		}
+		else if ((pat_det >> 2) == 0x1f)
+		{
+			continue;
+		}
+
+		if (nout >= MAX_FRAME_LEN * 8)
+		{
+			s->valid = 0;
+			continue;
+		}
+		obit[i] = nout;
+		frame[nout >> 3] |= dbit << (nout & 7);
+		nout++;
+	}
+
+	if ((nout & 7) != 0 || nout < MIN_FRAME_LEN * 8)
+	{
+		s->clean = 0;
+	}
+
+	/*
+	 * Inverting data bit k, of nd, changes the FCS by the remainder
+	 * of x**(nd-1-k).  Work backwards from the last one.
+	 * The FCS bits change the actual FCS directly.
+	 */
+
+	nd = nout - 16;
+	if (s->clean)
+	{
+		s->syndrome = fcs_calc(frame, nout / 8 - 2) ^ (frame[nout / 8 - 2] | (frame[nout / 8 - 1] << 8));
+	}
+
+	for (i = blen; i >= 0; i--)
+	{
+		s->dl[i] = 0;
+		if (!s->clean || obit[i] < 0)
+			continue;
+
+		k = obit[i];
+		if (k >= nd)
+		{
+			s->dl[i] = 1 << (k - nd);
+		}
+		else
+		{
+			r = (k == nd - 1) ? 0x8408 : (r >> 1) ^ ((r & 1) ? 0x8408 : 0);
+			s->dl[i] = r;
+		}
+	}
+}
+
+/*
+ * Data bit y after inverting those in f.  Outside of the frame is 0.
+ */
+
+static inline int new_data_bit(const struct syndrome_s *s, const int *f, int nf, int y)
+{
+	int b, j;
+
+	if (y < 1 || y >= s->blen)
+		return (0);
+
+	b = s->d[y];
+	for (j = 0; j < nf; j++)
+	{
+		if (f[j] == y)
+			b ^= 1;
+	}
+	return (b);
+}
+
+/*
+ * Can the data bits in f be inverted without changing the bit stuffing?
+ *
+ * We need to stay clear of runs of five or more 1 bits, both before
+ * and after.  Only those decide whether the next 0 is stuffed, or
+ * make a flag or abort.
+ */
+
+static int syndrome_safe(const struct syndrome_s *s, const int *f, int nf)
+{
+	int j, y, z, n;
+
+	for (j = 0; j < nf; j++)
+	{
+		if (s->near5[f[j]])
+			return (0);
+	}
+
+	for (j = 0; j < nf; j++)
+	{
+		for (y = f[j] - 1; y <= f[j] + 1; y++)
+		{
+			if (!new_data_bit(s, f, nf, y))
+				continue;
+
+			n = 1;
+			for (z = y - 1; n < 5 && new_data_bit(s, f, nf, z); z--)
+				n++;
+			for (z = y + 1; n < 5 && new_data_bit(s, f, nf, z); z++)
+				n++;
+			if (n >= 5)
+				return (0);
+		}
+	}
+	return (1);
+}
+
+/*
+ * Could inverting the raw bits make a good frame?  Returns 1 when unsure.
+ *
+ * Raw bit i goes into data bits i and i+1, so inverting raw bits
+ * a thru a+n-1 only inverts data bits a and a+n.
+ */
+
+static inline int add_data_bit(int *f, int nf, int x, int blen)
+{
+	if (x >= 1 && x < blen)
+	{
+		f[nf++] = x;
+	}
+	return (nf);
+}
+
+static int might_fix(const struct syndrome_s *s, const int *f, int nf)
+{
+	unsigned short x = 0;
+	int j;
+
+	if (!s->valid || !syndrome_safe(s, f, nf))
+		return (1);
+
+	if (!s->clean)
+		return (0);
+
+	for (j = 0; j < nf; j++)
+	{
+		x ^= s->dl[f[j]];
+	}
+	return (x == s->syndrome);
+}
+
+static int might_fix_contig(const struct syndrome_s *s, int a, int n)
+{
+	int f[2];
+	int nf = 0;
+
+	nf = add_data_bit(f, nf, a, s->blen);
+	nf = add_data_bit(f, nf, a + n, s->blen);
+	return (might_fix(s, f, nf));
+}
+
+static int might_fix_sep(const struct syndrome_s *s, int a, int b)
+{
+	int f[4];
+	int nf = 0;
+
+	nf = add_data_bit(f, nf, a, s->blen);
+	nf = add_data_bit(f, nf, a + 1, s->blen);
+	nf = add_data_bit(f, nf, b, s->blen);
+	nf = add_data_bit(f, nf, b + 1, s->blen);
+	return (might_fix(s, f, nf));
+}
+
+static int compare_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a;
+	unsigned int y = *(const unsigned int *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+/***********************************************************************************
+ *
+ * Name:	try_chase
+ *
+ * Purpose:	Try inverting combinations of the least certain bits.
+ *
+ * Inputs:	fix_bits - Up to 1, 2, or 3 bits at once for RETRY_INVERT_SINGLE,
+ *			   RETRY_INVERT_DOUBLE, or anything beyond.
+ *		s	 - From syndrome_init.
+ *
+ *		Others as for try_to_fix_quick_now.
+ *
+ * Returns:	1 for success.
+ *
+ * Description:	This is the idea behind a Chase decoder.  Errors are most
+ *		likely where the demodulator output was close to the
+ *		threshold.  Take the CHASE_BITS least certain and try them
+ *		alone, then in pairs and threes, anywhere in the frame.
+ *		That is far fewer than trying every position and finds
+ *		separated errors the contiguous attempts can't.
+ *
+ *		Nothing to do unless the demodulator provided a confidence
+ *		for each bit.  Those at 100 are not considered.
+ *
+ ***********************************************************************************/
+
+#define CHASE_BITS 8
+
+static int try_chase(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel, int later, retry_t fix_bits, const struct syndrome_s *s)
+{
+	const unsigned char *conf = rrbb_get_conf(block);
+	int len = rrbb_get_len(block);
+	int pos[CHASE_BITS];
+	int npos = 0;
+	int i, k, w;
+	int a, b, c;
+
+	if (conf == NULL)
+	{
+		return (0);
+	}
+
+	/* Least certain first. */
+
+	for (i = 0; i < len; i++)
+	{
+		if (conf[i] >= 100 || (npos == CHASE_BITS && conf[i] >= conf[pos[npos - 1]]))
+			continue;
+
+		if (npos < CHASE_BITS)
+			npos++;
+		for (k = npos - 1; k > 0 && conf[pos[k - 1]] > conf[i]; k--)
+		{
+			pos[k] = pos[k - 1];
+		}
+		pos[k] = i;
+	}
+
+	int max_w = fix_bits >= RETRY_INVERT_TRIPLE ? 3 : fix_bits >= RETRY_INVERT_DOUBLE ? 2 : 1;
+
+	retry_conf_t retry_cfg;
+
+	memset(&retry_cfg, 0, sizeof(retry_cfg));
+	retry_cfg.mode = RETRY_MODE_SEPARATED;
+	retry_cfg.type = RETRY_TYPE_SWAP;
+
+	/*
+	 * Fewest bits first.  b or c of npos means not used, which
+	 * becomes -1 for try_decode.
+	 */
+
+	for (w = 1; w <= max_w; w++)
+	{
+		retry_cfg.retry = w == 1 ? RETRY_INVERT_SINGLE : w == 2 ? RETRY_INVERT_DOUBLE : RETRY_INVERT_TRIPLE;
+
+		for (a = 0; a < npos; a++)
+		{
+			int b_last = w >= 2 ? npos - 1 : npos;
+
+			for (b = w >= 2 ? a + 1 : npos; b <= b_last; b++)
+			{
+				int c_last = w >= 3 ? npos - 1 : npos;
+
+				for (c = w >= 3 ? b + 1 : npos; c <= c_last; c++)
+				{
+					int f[6];
+					int nf = 0;
+					int x[3];
+
+					x[0] = pos[a];
+					x[1] = b < npos ? pos[b] : -1;
+					x[2] = c < npos ? pos[c] : -1;
+
+					/* Raw bit i goes into data bits i and i+1. */
+
+					for (k = 0; k < 3; k++)
+					{
+						if (x[k] >= 0)
+						{
+							nf = add_data_bit(f, nf, x[k], len);
+							nf = add_data_bit(f, nf, x[k] + 1, len);
+						}
+					}
+					if (!might_fix(s, f, nf))
+						continue;
+
+					retry_cfg.u_bits.sep.bit_idx_a = x[0];
+					retry_cfg.u_bits.sep.bit_idx_b = x[1];
+					retry_cfg.u_bits.sep.bit_idx_c = x[2];
+					if (try_decode(block, chan, subchan, slice, alevel, retry_cfg, 0, later))
+					{
+#if DEBUG
+						printf("*** Success by flipping %d least certain bits\n", w);
+#endif
+						return (1);
+					}
+				}
+			}
+		}
+	}
+	return (0);
+}
+
+/*
+ * Monotonic clock in microseconds, for FIX_BUDGET.
+ */
+
+static int64_t budget_clock(void)
+{
+#if __WIN32__
+	LARGE_INTEGER freq, now;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return ((int64_t)(now.QuadPart / freq.QuadPart) * 1000000 +
+			(int64_t)(now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+}
 
-	if (passall)
-	{
-		/* Exhausted all desired fix up attempts. */
-		/* Let thru even with bad CRC.  Of course, it still */
-		/* needs to be a minimum number of whole octets. */
-		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 1);
-		rrbb_delete(block);
-	}
-	else
+/* True when the time for this frame is up.  0 is no limit. */
+
+static inline int budget_over(int64_t deadline)
+{
+	return (deadline != 0 && budget_clock() >= deadline);
+}
+
+static void budget_note_exhausted(int chan)
+{
+	if (__atomic_add_fetch(&budget_exhausted[chan], 1, __ATOMIC_SEQ_CST) == 1)
 	{
-		rrbb_delete(block);
+		printf("Channel %d: FIX_BUDGET reached.  Fewer FIX_BITS attempts are being made.\n", chan);
 	}
-
-} /* end hdlc_rec2_block */
+}
 
 /***********************************************************************************
  *
@@ -320,12 +1127,99 @@ void hdlc_rec2_block(rrbb_t block)
  *
  ***********************************************************************************/
 
-static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel)
+static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel, int later)
+{
+	retry_t fix_bits = save_audio_config_p->achan[chan].fix_bits;
+	int max_us = save_audio_config_p->achan[chan].fix_max_us;
+	int max_percent = save_audio_config_p->achan[chan].fix_max_percent;
+	int adev = ACHAN2ADEV(chan);
+	int64_t start, deadline = 0;
+	int ok;
+
+	if (fix_bits < RETRY_INVERT_SINGLE || (max_us == 0 && max_percent == 0))
+	{
+		return (try_to_fix_levels(block, chan, subchan, slice, alevel, later, fix_bits, 0));
+	}
+
+	start = budget_clock();
+	if (max_us > 0)
+	{
+		deadline = start + max_us;
+	}
+
+	/*
+	 * Top up the channel's credit for the audio received since last time.
+	 * When it has run out, single bits are all we can afford.
+	 */
+
+	if (max_percent > 0)
+	{
+		int64_t credit;
+		unsigned int now = multi_modem_get_sample_time(chan);
+		int64_t cap = (int64_t)max_percent * 10000;
+		int sps = save_audio_config_p->adev[adev].samples_per_sec;
+
+		dw_mutex_lock(&budget_mutex);
+		budget_credit[chan] += (int64_t)(now - budget_sample_time[chan]) * max_percent * 10000 / (sps > 0 ? sps : 44100);
+		if (budget_credit[chan] > cap)
+		{
+			budget_credit[chan] = cap;
+		}
+		budget_sample_time[chan] = now;
+		credit = budget_credit[chan];
+		dw_mutex_unlock(&budget_mutex);
+
+		if (credit <= 0)
+		{
+			if (fix_bits > RETRY_INVERT_SINGLE)
+			{
+				fix_bits = RETRY_INVERT_SINGLE;
+				budget_note_exhausted(chan);
+			}
+		}
+		else if (deadline == 0 || start + credit < deadline)
+		{
+			deadline = start + credit;
+		}
+	}
+
+	ok = try_to_fix_levels(block, chan, subchan, slice, alevel, later, fix_bits, deadline);
+
+	if (max_percent > 0)
+	{
+		int64_t spent = budget_clock() - start;
+
+		dw_mutex_lock(&budget_mutex);
+		budget_credit[chan] -= spent;
+		dw_mutex_unlock(&budget_mutex);
+	}
+
+	return (ok);
+}
+
+/***********************************************************************************
+ *
+ * Name:	try_to_fix_levels
+ *
+ * Purpose:	The fix up attempts themselves, up to a given level.
+ *
+ * Inputs:	fix_bits - Maximum level of fix up to attempt.
+ *		deadline - From budget_clock.  Give up on anything beyond
+ *			   single bits once it passes.  0 for no limit.
+ *
+ *		Others as for try_to_fix_quick_now.
+ *
+ * Returns:	1 for success.
+ *
+ ***********************************************************************************/
+
+static int try_to_fix_levels(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel, int later, retry_t fix_bits, int64_t deadline)
 {
 	int ok;
 	int len, i;
-	retry_t fix_bits = save_audio_config_p->achan[chan].fix_bits;
 	// int passall = save_audio_config_p->achan[chan].passall;
+	uint64_t raw[RRBB_NUM_WORDS + 1];
+	struct syndrome_s s0;
 
 	len = rrbb_get_len(block);
 	/* Prepare the retry configuration */
@@ -345,6 +1239,21 @@ static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice,
 
 		return 0; /* failure. */
 	}
+
+	int nwords = (len + 63) / 64;
+
+	for (i = 0; i < nwords; i++)
+	{
+		raw[i] = rrbb_get_bits(block, i);
+	}
+	raw[nwords] = 0;
+	syndrome_init(&s0, raw, len);
+
+	if (try_chase(block, chan, subchan, slice, alevel, later, fix_bits, &s0))
+	{
+		return 1;
+	}
+
 	/* Try to swap one bit */
 	retry_cfg.type = RETRY_TYPE_SWAP;
 	retry_cfg.retry = RETRY_INVERT_SINGLE;
@@ -352,9 +1261,12 @@ static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice,
 
 	for (i = 0; i < len; i++)
 	{
+		if (!might_fix_contig(&s0, i, 1))
+			continue;
+
 		/* Set the index of the bit to swap */
 		retry_cfg.u_bits.contig.bit_idx = i;
-		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 0);
+		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 0, later);
 		if (ok)
 		{
 #if DEBUG
@@ -372,14 +1284,22 @@ static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice,
 	{
 		return 0;
 	}
+	if (budget_over(deadline))
+	{
+		budget_note_exhausted(chan);
+		return 0;
+	}
 	/* Try to swap two contiguous bits */
 	retry_cfg.retry = RETRY_INVERT_DOUBLE;
 	retry_cfg.u_bits.contig.nr_bits = 2;
 
 	for (i = 0; i < len - 1; i++)
 	{
+		if (!might_fix_contig(&s0, i, 2))
+			continue;
+
 		retry_cfg.u_bits.contig.bit_idx = i;
-		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 0);
+		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 0, later);
 		if (ok)
 		{
 #if DEBUG
@@ -397,14 +1317,22 @@ static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice,
 	{
 		return 0;
 	}
+	if (budget_over(deadline))
+	{
+		budget_note_exhausted(chan);
+		return 0;
+	}
 	/* Try to swap three contiguous bits */
 	retry_cfg.retry = RETRY_INVERT_TRIPLE;
 	retry_cfg.u_bits.contig.nr_bits = 3;
 
 	for (i = 0; i < len - 2; i++)
 	{
+		if (!might_fix_contig(&s0, i, 3))
+			continue;
+
 		retry_cfg.u_bits.contig.bit_idx = i;
-		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 0);
+		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 0, later);
 		if (ok)
 		{
 #if DEBUG
@@ -425,6 +1353,11 @@ static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice,
 	{
 		return 0;
 	}
+	if (budget_over(deadline))
+	{
+		budget_note_exhausted(chan);
+		return 0;
+	}
 
 	retry_cfg.mode = RETRY_MODE_SEPARATED;
 	retry_cfg.type = RETRY_TYPE_SWAP;
@@ -435,33 +1368,158 @@ static int try_to_fix_quick_now(rrbb_t block, int chan, int subchan, int slice,
 	tstart = dtime_now();
 	printf("*** Try flipping TWO SEPARATED BITS %d bits\n", len);
 #endif
-	len = rrbb_get_len(block);
-	for (i = 0; i < len - 2; i++)
+
+	/*
+	 * For each raw bit: how inverting it changes the syndrome,
+	 * and whether that can be trusted.
+	 */
+
+	unsigned short delta[MAX_NUM_BITS];
+	unsigned char safe[MAX_NUM_BITS];
+	unsigned char partner[MAX_NUM_BITS];
+
+	for (i = 0; i < len; i++)
+	{
+		int f[2];
+		int nf = 0;
+
+		nf = add_data_bit(f, nf, i, len);
+		nf = add_data_bit(f, nf, i + 1, len);
+		delta[i] = s0.dl[i] ^ s0.dl[i + 1];
+		safe[i] = s0.valid && syndrome_safe(&s0, f, nf);
+		partner[i] = 0;
+	}
+
+	/*
+	 * When only one of a far apart pair is unsafe, decode the frame with
+	 * that one inverted and look for the other.  Keep the pairs found,
+	 * lowest first, as (i << 16) | j.
+	 */
+
+	unsigned int *pairs = NULL;
+	int npairs = 0;
+	int maxpairs = 0;
+	struct syndrome_s *su = NULL;
+	int u, j, k;
+	int over = 0;
+
+	for (u = 0; u < len && s0.valid; u++)
+	{
+		if (safe[u])
+			continue;
+
+		if (budget_over(deadline))
+		{
+			over = 1;
+			break;
+		}
+
+		if (su == NULL)
+		{
+			su = malloc(sizeof(struct syndrome_s));
+			if (su == NULL)
+			{
+				printf("FATAL ERROR: Out of memory.\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		flip_bit(raw, u);
+		syndrome_init(su, raw, len);
+		flip_bit(raw, u);
+
+		if (su->valid && !su->clean)
+			continue;
+
+		for (j = 0; j < len; j++)
+		{
+			if (abs(j - u) < SEP_FAR || !safe[j])
+				continue;
+
+			if (su->valid && (su->dl[j] ^ su->dl[j + 1]) != su->syndrome)
+				continue;
+
+			if (npairs == maxpairs)
+			{
+				maxpairs = maxpairs ? maxpairs * 2 : 64;
+				unsigned int *more = realloc(pairs, maxpairs * sizeof(unsigned int));
+				if (more == NULL)
+				{
+					printf("FATAL ERROR: Out of memory.\n");
+					exit(EXIT_FAILURE);
+				}
+				pairs = more;
+			}
+			pairs[npairs++] = u < j ? (u << 16) | j : (j << 16) | u;
+		}
+	}
+	if (su != NULL)
+	{
+		free(su);
+	}
+	if (npairs > 1)
+	{
+		qsort(pairs, npairs, sizeof(unsigned int), compare_uint);
+	}
+
+	ok = 0;
+	k = 0;
+	for (i = 0; i < len - 2 && !ok; i++)
 	{
+		if (i % BUDGET_CHECK_EVERY == 0 && budget_over(deadline))
+		{
+			over = 1;
+			break;
+		}
+
 		retry_cfg.u_bits.sep.bit_idx_a = i;
-		int j;
 
-		ok = 0;
+		for (; k < npairs && (int)(pairs[k] >> 16) == i; k++)
+		{
+			partner[pairs[k] & 0xffff] = 1;
+		}
+
 		for (j = i + 2; j < len; j++)
 		{
+			int try;
+
+			if (!s0.valid)
+				try = 1;
+			else if (j - i < SEP_FAR)
+				try = might_fix_sep(&s0, i, j);
+			else if (safe[i] && safe[j])
+				try = s0.clean && (delta[i] ^ delta[j]) == s0.syndrome;
+			else if (safe[i] || safe[j])
+				try = partner[j];
+			else
+				try = 1;
+
+			if (!try)
+				continue;
+
 			retry_cfg.u_bits.sep.bit_idx_b = j;
-			ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 0);
+			ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, 0, later);
 			if (ok)
 			{
-				break;
-			}
-		}
-		if (ok)
-		{
 #if DEBUG
 
-			printf("*** Success by flipping TWO SEPARATED bits %d and %d of %d \n", i, j, len);
+				printf("*** Success by flipping TWO SEPARATED bits %d and %d of %d \n", i, j, len);
 #endif
-			return (1);
+				break;
+			}
 		}
+
+		memset(partner, 0, len);
 	}
 
-	return 0;
+	if (pairs != NULL)
+	{
+		free(pairs);
+	}
+	if (over)
+	{
+		budget_note_exhausted(chan);
+	}
+	return (ok);
 }
 
 // TODO:  Remove this.  but first figure out what to do in atest.c
@@ -494,7 +1552,7 @@ int hdlc_rec2_try_to_fix_later(rrbb_t block, int chan, int subchan, int slice, a
 		retry_cfg.retry = RETRY_NONE;
 		retry_cfg.u_bits.contig.nr_bits = 0;
 		retry_cfg.u_bits.contig.bit_idx = 0;
-		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, passall);
+		ok = try_decode(block, chan, subchan, slice, alevel, retry_cfg, passall, 0);
 		return (ok);
 	}
 
@@ -503,34 +1561,78 @@ int hdlc_rec2_try_to_fix_later(rrbb_t block, int chan, int subchan, int slice, a
 } /* end hdlc_rec2_try_to_fix_later */
 
 /*
- * Check if the specified index of bit has been modified with the current type of configuration
- * Provide a specific implementation for contiguous mode to optimize number of tests done in the loop
+ * Process one data bit, after NRZI decoding, the slow way.
+ * Returns 0 normally or -1 for a flag or abort pattern, which means the end of trying.
  */
 
-inline static char is_contig_bit_modified(int bit_idx, retry_conf_t retry_conf)
+__attribute__((always_inline)) static inline int one_data_bit(struct hdlc_state2_s *H2, int dbit)
 {
-	int cont_bit_idx = retry_conf.u_bits.contig.bit_idx;
-	int cont_nr_bits = retry_conf.u_bits.contig.nr_bits;
+	/*
+	 * Octets are sent LSB first.
+	 * Shift the most recent 8 bits thru the pattern detector.
+	 */
+	H2->pat_det >>= 1;
 
-	if (bit_idx >= cont_bit_idx && (bit_idx < cont_bit_idx + cont_nr_bits))
-		return 1;
-	else
-		return 0;
-}
+	if (dbit)
+	{
 
-/*
- * Check  if the specified index of bit has been modified with the current type of configuration in separated bit index mode
- * Provide a specific implementation for separated mode to optimize number of tests done in the loop
- */
+		H2->pat_det |= 0x80;
+		/* Valid data will never have 7 one bits in a row: exit. */
+		if (H2->pat_det == 0xfe)
+		{
+#if DEBUG
 
-inline static char is_sep_bit_modified(int bit_idx, retry_conf_t retry_conf)
-{
-	if (bit_idx == retry_conf.u_bits.sep.bit_idx_a ||
-		bit_idx == retry_conf.u_bits.sep.bit_idx_b ||
-		bit_idx == retry_conf.u_bits.sep.bit_idx_c)
-		return 1;
+			printf("try_decode: found abort\n");
+#endif
+			return -1;
+		}
+	}
 	else
-		return 0;
+	{
+
+		/* The special pattern 01111110 indicates beginning and ending of a frame: exit. */
+		if (H2->pat_det == 0x7e)
+		{
+#if DEBUG
+
+			printf("try_decode: found flag\n");
+#endif
+			return -1;
+			/*
+			 * If we have five '1' bits in a row, followed by a '0' bit,
+			 *
+			 *	011111xx
+			 *
+			 * the current '0' bit should be discarded because it was added for
+			 * "bit stuffing."
+			 */
+		}
+		else if ((H2->pat_det >> 2) == 0x1f)
+		{
+			return 0;
+		}
+	}
+
+	/*
+	 * Now accumulate bits into octets, and complete octets
+	 * into the frame buffer.
+	 */
+
+	H2->oacc |= dbit << H2->olen;
+	H2->olen++;
+
+	if (H2->olen & 8)
+	{
+		H2->olen = 0;
+
+		if (H2->frame_len < MAX_FRAME_LEN)
+		{
+			H2->frame_buf[H2->frame_len] = H2->oacc;
+			H2->frame_len++;
+		}
+		H2->oacc = 0;
+	}
+	return 0;
 }
 
 /***********************************************************************************
@@ -576,12 +1678,12 @@ inline static char is_sep_bit_modified(int bit_idx, retry_conf_t retry_conf)
  *
  ***********************************************************************************/
 
-static int try_decode(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel, retry_conf_t retry_conf, int passall)
+static int try_decode(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel, retry_conf_t retry_conf, int passall, int later)
 {
 	struct hdlc_state2_s H2;
 	int blen; /* Block length in bits. */
 	int i;
-	int raw; /* From demodulator.  Should be 0 or 1. */
+	int raw_bit; /* From demodulator.  Should be 0 or 1. */
 #if DEBUG
 	int crc_failed = 1;
 #endif
@@ -592,25 +1694,6 @@ static int try_decode(rrbb_t block, int chan, int subchan, int slice, alevel_t a
 	H2.is_scrambled = rrbb_get_is_scrambled(block);
 	H2.prev_descram = rrbb_get_prev_descram(block);
 	H2.lfsr = rrbb_get_descram_state(block);
-	H2.prev_raw = rrbb_get_bit(block, 0); /* Actually last bit of the */
-	/* opening flag so we can derive the */
-	/* first data bit.  */
-
-	/* Does this make sense? */
-	/* This is the last bit of the "flag" pattern. */
-	/* If it was corrupted we wouldn't have detected */
-	/* the start of frame. */
-
-	if ((retry_conf.mode == RETRY_MODE_CONTIGUOUS && is_contig_bit_modified(0, retry_conf)) ||
-		(retry_conf.mode == RETRY_MODE_SEPARATED && is_sep_bit_modified(0, retry_conf)))
-	{
-		H2.prev_raw = !H2.prev_raw;
-	}
-
-	H2.pat_det = 0;
-	H2.oacc = 0;
-	H2.olen = 0;
-	H2.frame_len = 0;
 
 	blen = rrbb_get_len(block);
 
@@ -619,108 +1702,117 @@ static int try_decode(rrbb_t block, int chan, int subchan, int slice, alevel_t a
 	if (retry_conf.type == RETRY_TYPE_NONE)
 		printf("try_decode: blen=%d\n", blen);
 #endif
-	for (i = 1; i < blen; i++)
+
+	/*
+	 * Version 1.8:  Work on a copy of the raw bits, 64 at a time.
+	 * Rather than checking whether each bit is one to be inverted,
+	 * invert them in the copy first.  The extra word of zeros lets
+	 * us look one bit past the end of any word.
+	 */
+
+	int nwords = (blen + 63) / 64;
+	uint64_t raw[RRBB_NUM_WORDS + 1];
+
+	for (i = 0; i < nwords; i++)
 	{
-		/* Get the value for the current bit */
-		raw = rrbb_get_bit(block, i);
-		/* If swap two sep mode , swap the bit if needed */
-		if (retry_conf_retry == RETRY_INVERT_TWO_SEP)
+		raw[i] = rrbb_get_bits(block, i);
+	}
+	raw[nwords] = 0;
+
+	if (retry_conf_type == RETRY_TYPE_SWAP)
+	{
+		if (retry_conf_retry == RETRY_INVERT_TWO_SEP || retry_conf_mode == RETRY_MODE_SEPARATED)
 		{
-			if (is_sep_bit_modified(i, retry_conf))
-				raw = !raw;
+			flip_bit(raw, retry_conf.u_bits.sep.bit_idx_a);
+			flip_bit(raw, retry_conf.u_bits.sep.bit_idx_b);
+			flip_bit(raw, retry_conf.u_bits.sep.bit_idx_c);
 		}
-		/* Else handle all the others contiguous modes */
-		else if (retry_conf_mode == RETRY_MODE_CONTIGUOUS)
+		else
 		{
-
-			if (retry_conf_type == RETRY_TYPE_SWAP)
+			for (i = 0; i < retry_conf.u_bits.contig.nr_bits; i++)
 			{
-				/* If this is the bit to swap */
-				if (is_contig_bit_modified(i, retry_conf))
-					raw = !raw;
+				flip_bit(raw, retry_conf.u_bits.contig.bit_idx + i);
 			}
 		}
-		else
-		{
-		}
-		/*
-		 * Octets are sent LSB first.
-		 * Shift the most recent 8 bits thru the pattern detector.
-		 */
-		H2.pat_det >>= 1;
+	}
 
-		/*
-		 * Using NRZI encoding,
-		 *   A '0' bit is represented by an inversion since previous bit.
-		 *   A '1' bit is represented by no change.
-		 *   Note: this code can be factorized with the raw != H2.prev_raw code at the cost of processing time
-		 */
+	/* Bit 0 is actually last bit of the */
+	/* opening flag so we can derive the */
+	/* first data bit.  */
 
-		int dbit;
+	/* Does this make sense? */
+	/* This is the last bit of the "flag" pattern. */
+	/* If it was corrupted we wouldn't have detected */
+	/* the start of frame. */
 
-		dbit = (raw == H2.prev_raw);
-		H2.prev_raw = raw;
+	H2.prev_raw = raw[0] & 1;
 
-		if (dbit)
+	H2.pat_det = 0;
+	H2.oacc = 0;
+	H2.olen = 0;
+	H2.frame_len = 0;
+
+	/*
+	 * Using NRZI encoding,
+	 *   A '0' bit is represented by an inversion since previous bit.
+	 *   A '1' bit is represented by no change.
+	 *
+	 * Data bit i comes from raw bits i-1 and i so 64 of them, starting
+	 * with bit 1, can be had from two adjacent words.
+	 *
+	 * Flags, aborts, and bit stuffing all need at least five 1 bits
+	 * in a row.  When there are none, which is most of the time, all 64
+	 * go straight into the frame buffer.  Otherwise, one at a time.
+	 */
+
+	int nchunks = (blen - 1) / 64;
+	int c;
+
+	for (c = 0; c < nchunks; c++)
+	{
+		uint64_t prev = raw[c];
+		uint64_t cur = (raw[c] >> 1) | (raw[c + 1] << 63);
+		uint64_t data = ~(cur ^ prev);
+
+		uint64_t runs = data & (data >> 1) & (data >> 2) & (data >> 3) & (data >> 4);
+		int ones_before = __builtin_clz(~((unsigned int)H2.pat_det << 24));
+		int ones_after = ~data == 0 ? 64 : __builtin_ctzll(~data);
+
+		if (runs == 0 && ones_before + ones_after < 5 && H2.frame_len + 8 <= MAX_FRAME_LEN)
 		{
+			uint64_t out = H2.oacc | (data << H2.olen);
+			int k;
 
-			H2.pat_det |= 0x80;
-			/* Valid data will never have 7 one bits in a row: exit. */
-			if (H2.pat_det == 0xfe)
+			for (k = 0; k < 8; k++)
 			{
-#if DEBUG
-
-				printf("try_decode: found abort, i=%d\n", i);
-#endif
-				return 0;
+				H2.frame_buf[H2.frame_len++] = out >> (8 * k);
 			}
-			H2.oacc >>= 1;
-			H2.oacc |= 0x80;
+			H2.oacc = H2.olen ? (unsigned int)(data >> (64 - H2.olen)) : 0;
+
+			H2.pat_det = data >> 56;
 		}
 		else
 		{
+			int k;
 
-			/* The special pattern 01111110 indicates beginning and ending of a frame: exit. */
-			if (H2.pat_det == 0x7e)
-			{
-#if DEBUG
-
-				printf("try_decode: found flag, i=%d\n", i);
-#endif
-				return 0;
-				/*
-				 * If we have five '1' bits in a row, followed by a '0' bit,
-				 *
-				 *	011111xx
-				 *
-				 * the current '0' bit should be discarded because it was added for
-				 * "bit stuffing."
-				 */
-			}
-			else if ((H2.pat_det >> 2) == 0x1f)
+			for (k = 0; k < 64; k++)
 			{
-				continue;
+				if (one_data_bit(&H2, (data >> k) & 1) < 0)
+					return 0;
 			}
-			H2.oacc >>= 1;
 		}
+	}
 
-		/*
-		 * Now accumulate bits into octets, and complete octets
-		 * into the frame buffer.
-		 */
+	H2.prev_raw = (raw[(nchunks * 64) >> 6] >> ((nchunks * 64) & 63)) & 1;
 
-		H2.olen++;
+	for (i = nchunks * 64 + 1; i < blen; i++)
+	{
+		raw_bit = (raw[i >> 6] >> (i & 63)) & 1;
 
-		if (H2.olen & 8)
-		{
-			H2.olen = 0;
+		if (one_data_bit(&H2, raw_bit == H2.prev_raw) < 0)
+			return 0;
 
-			if (H2.frame_len < MAX_FRAME_LEN)
-			{
-				H2.frame_buf[H2.frame_len] = H2.oacc;
-				H2.frame_len++;
-			}
-		}
+		H2.prev_raw = raw_bit;
 	} /* end of loop on all bits in block */
 	/*
 	 * Do we have a minimum number of complete bytes?
@@ -772,8 +1864,15 @@ static int try_decode(rrbb_t block, int chan, int subchan, int slice, alevel_t a
 
 			assert(rrbb_get_chan(block) == chan);
 			assert(rrbb_get_subchan(block) == subchan);
-			multi_modem_process_rec_frame(chan, subchan, slice, H2.frame_buf, H2.frame_len - 2, alevel, retry_conf.retry, 0); /* len-2 to remove FCS. */
-			return 1;																										  /* success */
+			if (later)
+			{
+				multi_modem_process_rec_frame_later(chan, subchan, slice, H2.frame_buf, H2.frame_len - 2, alevel, retry_conf.retry, fec_type_none, rrbb_get_sample_time(block), rrbb_get_end_time(block));
+			}
+			else
+			{
+				multi_modem_process_rec_frame(chan, subchan, slice, H2.frame_buf, H2.frame_len - 2, alevel, retry_conf.retry, 0, rrbb_get_end_time(block)); /* len-2 to remove FCS. */
+			}
+			return 1; /* success */
 		}
 		else if (passall)
 		{
@@ -783,8 +1882,15 @@ static int try_decode(rrbb_t block, int chan, int subchan, int slice, alevel_t a
 				//
 				// printf ("ATTEMPTING PASSALL PROCESSING\n");
 
-				multi_modem_process_rec_frame(chan, subchan, slice, H2.frame_buf, H2.frame_len - 2, alevel, RETRY_MAX, 0); /* len-2 to remove FCS. */
-				return 1;																								   /* success */
+				if (later)
+				{
+					multi_modem_process_rec_frame_later(chan, subchan, slice, H2.frame_buf, H2.frame_len - 2, alevel, RETRY_MAX, fec_type_none, rrbb_get_sample_time(block), rrbb_get_end_time(block));
+				}
+				else
+				{
+					multi_modem_process_rec_frame(chan, subchan, slice, H2.frame_buf, H2.frame_len - 2, alevel, RETRY_MAX, 0, rrbb_get_end_time(block)); /* len-2 to remove FCS. */
+				}
+				return 1; /* success */
 			}
 			else
 			{
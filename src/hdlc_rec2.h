@@ -44,7 +44,7 @@ typedef struct retry_conf_s
 
 } retry_conf_t;
 
-#if defined(DIREWOLF_C) || defined(ATEST_C) || defined(UDPTEST_C)
+#if defined(DIREWOLF_C) || defined(ATEST_C) || defined(UDPTEST_C) || defined(METRICS_SERVER_C)
 
 static const char *retry_text[] = {
 	"NONE",
@@ -57,10 +57,18 @@ static const char *retry_text[] = {
 
 void hdlc_rec2_init(struct audio_s *audio_config_p);
 
-void hdlc_rec2_block(rrbb_t block);
+int hdlc_rec2_block(rrbb_t block);
 
 int hdlc_rec2_try_to_fix_later(rrbb_t block, int chan, int subchan, int slice, alevel_t alevel);
 
+unsigned int hdlc_rec2_fix_ticket(int chan);
+
+int hdlc_rec2_fix_done(int chan, unsigned int ticket);
+
+void hdlc_rec2_fix_stats(int *queued, int *dropped);
+
+int hdlc_rec2_budget_stats(int chan);
+
 /* Provided by the top level application to process a complete frame. */
 
 void app_process_rec_packet(int chan, int subchan, int slice, packet_t pp, alevel_t level, fec_type_t fec_type, retry_t retries, char *spectrum);
@@ -21,6 +21,9 @@
 #include "direwolf.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
 
 #include "hdlc_send.h"
 #include "audio.h"
@@ -28,13 +31,298 @@
 #include "fcs_calc.h"
 #include "ax25_pad.h"
 #include "fx25.h"
+#include "dwthread.h"
 
-static void send_control_nrzi(int, int);
-static void send_data_nrzi(int, int);
 static void send_bit_nrzi(int, int);
 
 static int number_of_bits_sent[MAX_CHANS]; // Count number of bits sent by "hdlc_send_frame" or "hdlc_send_flags"
 
+static int output[MAX_CHANS]; // NRZI output level.  Shared by AX.25 and FX.25.
+
+/*
+ * Version 1.8: Cache of encoded frames.
+ *
+ * The same frames are often sent again and again, e.g. beacons, or
+ * the same digipeated frame on more than one channel.  Rather than
+ * going through HDLC bit stuffing and FX.25 encoding each time, keep
+ * the resulting bits for the most recently used frames.
+ *
+ * It's the bits before NRZI encoding that are saved.  The audio depends
+ * on the NRZI level and tone phase left from whatever was sent before
+ * so it can't be reused.  That part is cheap anyhow with the precomputed
+ * bit waveforms in gen_tone.c.
+ *
+ * Large frames aren't saved.  They are not likely to be repeated.
+ */
+
+#define TX_CACHE_ENTRIES 32
+#define TX_CACHE_MAX_FRAME 512
+
+/* HDLC_MAX_BITS is much more than the largest FX.25 block. */
+
+struct tx_cache_s
+{
+	unsigned int used;		/* When last used.  0 for empty entry. */
+	unsigned int hash;
+	int chan;
+	int fx_mode;  /* FX.25 mode or 0 for plain AX.25. */
+	int fallback; /* FX.25 wasn't possible so it's AX.25. */
+	int flen;
+	unsigned char frame[TX_CACHE_MAX_FRAME];
+	int nbits;
+	unsigned char bits[(HDLC_MAX_BITS(TX_CACHE_MAX_FRAME) + 7) / 8];
+};
+
+static struct tx_cache_s tx_cache[TX_CACHE_ENTRIES];
+static unsigned int tx_cache_clock;
+static dw_mutex_t tx_cache_mutex; /* One transmit thread for each channel. */
+
+/*
+ * Version 1.8: Table driven bit stuffing and NRZI.
+ *
+ * Bit stuffing depends only on the number of 1 bits just sent, 0 to 4,
+ * and the next data byte.  For each combination, the table has the
+ * resulting bits, LSB first, how many there are (8 to 10), and the new
+ * count of 1 bits.
+ *
+ * For NRZI, the table has the output byte for each data byte when the
+ * previous output was 0.  If it was 1, invert all of them.
+ */
+
+struct stuff_s
+{
+	unsigned short bits;
+	unsigned char len;
+	unsigned char ones;
+};
+
+static struct stuff_s stuff_table[5][256];
+
+static unsigned char nrzi_table[256];
+
+void layer2_send_init(void)
+{
+	dw_mutex_init(&tx_cache_mutex);
+
+	for (int ones = 0; ones < 5; ones++)
+	{
+		for (int x = 0; x < 256; x++)
+		{
+			struct stuff_s *e = &stuff_table[ones][x];
+			int n = ones;
+
+			e->bits = 0;
+			e->len = 0;
+			for (int k = 0; k < 8; k++)
+			{
+				if ((x >> k) & 1)
+				{
+					e->bits |= 1 << e->len;
+					e->len++;
+					n++;
+					if (n == 5)
+					{
+						e->len++; // Stuffed 0 bit.
+						n = 0;
+					}
+				}
+				else
+				{
+					e->len++;
+					n = 0;
+				}
+			}
+			e->ones = n;
+		}
+	}
+
+	for (int x = 0; x < 256; x++)
+	{
+		int level = 0;
+
+		nrzi_table[x] = 0;
+		for (int k = 0; k < 8; k++)
+		{
+			if (((x >> k) & 1) == 0)
+			{
+				level = !level;
+			}
+			nrzi_table[x] |= level << k;
+		}
+	}
+}
+
+/*-------------------------------------------------------------
+ *
+ * Name:	hdlc_stuff
+ *
+ * Purpose:	Append bit stuffed data to a buffer of bits.
+ *
+ * Inputs:	in	- Data bytes.
+ *
+ *		ilen	- Number of bytes.
+ *
+ *		out	- Buffer of bits, LSB of each byte first.
+ *
+ *		obits	- Number of bits already in out.
+ *
+ *		osize	- Size of out, in bits.
+ *
+ *		ones	- Number of 1 bits just before.  Updated.
+ *			  Should be 0 after a flag.
+ *
+ * Returns:	New number of bits in out, or -1 if it won't fit.
+ *
+ * Description:	Shared by AX.25 and FX.25.  A byte at a time using
+ *		stuff_table.  Bits beyond obits are overwritten.
+ *
+ *--------------------------------------------------------------*/
+
+int hdlc_stuff(const unsigned char *in, int ilen, unsigned char *out, int obits, int osize, int *ones)
+{
+	unsigned char *p = out + (obits >> 3);
+	unsigned int acc = *p & ((1 << (obits & 7)) - 1);
+	int nacc = obits & 7;
+	int n = *ones;
+
+	for (int j = 0; j < ilen; j++)
+	{
+		const struct stuff_s *e = &stuff_table[n][in[j]];
+
+		if (obits + e->len > osize)
+		{
+			return (-1);
+		}
+		obits += e->len;
+		acc |= (unsigned int)e->bits << nacc;
+		nacc += e->len;
+		n = e->ones;
+
+		while (nacc >= 8)
+		{
+			*p++ = acc & 0xff;
+			acc >>= 8;
+			nacc -= 8;
+		}
+	}
+
+	if (nacc > 0)
+	{
+		*p = acc;
+	}
+
+	*ones = n;
+	return (obits);
+}
+
+/*-------------------------------------------------------------
+ *
+ * Name:	hdlc_put_bits
+ *
+ * Purpose:	Append bits, without stuffing, to a buffer of bits.
+ *
+ * Inputs:	out	- Buffer of bits, LSB of each byte first.
+ *
+ *		obits	- Number of bits already in out.
+ *
+ *		value	- Bits to add, LSB first.  e.g. 0x7e for a flag.
+ *
+ *		n	- Number of bits, 1 to 8.
+ *
+ * Returns:	New number of bits in out.
+ *
+ *--------------------------------------------------------------*/
+
+int hdlc_put_bits(unsigned char *out, int obits, unsigned int value, int n)
+{
+	unsigned char *p = out + (obits >> 3);
+	unsigned int acc = (*p & ((1 << (obits & 7)) - 1)) | ((value & ((1 << n) - 1)) << (obits & 7));
+
+	p[0] = acc & 0xff;
+	if ((obits & 7) + n > 8)
+	{
+		p[1] = acc >> 8;
+	}
+
+	return (obits + n);
+}
+
+static unsigned int tx_cache_hash(int chan, int fx_mode, unsigned char *fbuf, int flen)
+{
+	unsigned int h = 2166136261u; // FNV-1a
+
+	h = (h ^ chan) * 16777619u;
+	h = (h ^ fx_mode) * 16777619u;
+	for (int j = 0; j < flen; j++)
+	{
+		h = (h ^ fbuf[j]) * 16777619u;
+	}
+	return (h);
+}
+
+/* Copy saved bits to b and return the number, or -1 if not found. */
+
+static int tx_cache_get(int chan, int fx_mode, unsigned char *fbuf, int flen, unsigned int hash, unsigned char *b, int *fallback)
+{
+	int nbits = -1;
+
+	dw_mutex_lock(&tx_cache_mutex);
+
+	for (int j = 0; j < TX_CACHE_ENTRIES; j++)
+	{
+		struct tx_cache_s *e = &tx_cache[j];
+
+		if (e->used != 0 && e->hash == hash && e->chan == chan && e->fx_mode == fx_mode &&
+			e->flen == flen && memcmp(e->frame, fbuf, flen) == 0)
+		{
+			e->used = ++tx_cache_clock;
+			nbits = e->nbits;
+			memcpy(b, e->bits, (nbits + 7) / 8);
+			*fallback = e->fallback;
+			break;
+		}
+	}
+
+	dw_mutex_unlock(&tx_cache_mutex);
+
+	return (nbits);
+}
+
+/* Save bits for a frame, replacing the least recently used. */
+
+static void tx_cache_put(int chan, int fx_mode, unsigned char *fbuf, int flen, unsigned int hash, unsigned char *b, int nbits, int fallback)
+{
+	if (flen > TX_CACHE_MAX_FRAME)
+	{
+		return;
+	}
+
+	assert(nbits <= HDLC_MAX_BITS(TX_CACHE_MAX_FRAME));
+
+	dw_mutex_lock(&tx_cache_mutex);
+
+	struct tx_cache_s *e = &tx_cache[0];
+	for (int j = 1; j < TX_CACHE_ENTRIES; j++)
+	{
+		if (tx_cache[j].used < e->used)
+		{
+			e = &tx_cache[j];
+		}
+	}
+
+	e->used = ++tx_cache_clock;
+	e->hash = hash;
+	e->chan = chan;
+	e->fx_mode = fx_mode;
+	e->fallback = fallback;
+	e->flen = flen;
+	memcpy(e->frame, fbuf, flen);
+	e->nbits = nbits;
+	memcpy(e->bits, b, (nbits + 7) / 8);
+
+	dw_mutex_unlock(&tx_cache_mutex);
+}
+
 /*-------------------------------------------------------------
  *
  * Name:	layer2_send_frame
@@ -53,7 +341,7 @@ static int number_of_bits_sent[MAX_CHANS]; // Count number of bits sent by "hdlc
  * Outputs:	Bits are shipped out by calling tone_gen_put_bit().
  *
  * Returns:	Number of bits sent including "flags" and the
- *		stuffing bits.
+ *		stuffing bits.  0 if the frame could not be encoded.
  *		The required time can be calculated by dividing this
  *		number by the transmit rate of bits/sec.
  *
@@ -64,6 +352,9 @@ static int number_of_bits_sent[MAX_CHANS]; // Count number of bits sent by "hdlc
  *			end flag
  *		NRZI encoding for all but the "flags."
  *
+ *		Version 1.8: Encoding is done into a buffer first and
+ *		the result is remembered for frames sent again.
+ *
  *
  * Assumptions:	It is assumed that the tone_gen module has been
  *		properly initialized so that bits sent with
@@ -71,47 +362,102 @@ static int number_of_bits_sent[MAX_CHANS]; // Count number of bits sent by "hdlc
  *
  *--------------------------------------------------------------*/
 
-static int ax25_only_hdlc_send_frame(int chan, unsigned char *fbuf, int flen, int bad_fcs);
+static int hdlc_encode(unsigned char *fbuf, int flen, int bad_fcs, unsigned char *out);
 
 int layer2_send_frame(int chan, packet_t pp, int bad_fcs, struct audio_s *audio_config_p)
 {
+	unsigned char fbuf[AX25_MAX_PACKET_LEN + 2];
+	unsigned char bits[(HDLC_MAX_BITS(AX25_MAX_PACKET_LEN) + 7) / 8];
+	int flen = ax25_pack(pp, fbuf);
+	int fx_mode = 0;
+	int nbits = -1;
+	unsigned int hash = 0;
+	int fallback = 0;
+
 	if (audio_config_p->achan[chan].layer2_xmit == LAYER2_FX25)
 	{
-		unsigned char fbuf[AX25_MAX_PACKET_LEN + 2];
-		int flen = ax25_pack(pp, fbuf);
-		int n = fx25_send_frame(chan, fbuf, flen, audio_config_p->achan[chan].fx25_strength);
-		if (n > 0)
+		fx_mode = audio_config_p->achan[chan].fx25_strength;
+	}
+
+	// Frames with intentionally bad FCS are for testing.  Don't keep those.
+
+	if (!bad_fcs)
+	{
+		hash = tx_cache_hash(chan, fx_mode, fbuf, flen);
+		nbits = tx_cache_get(chan, fx_mode, fbuf, flen, hash, bits, &fallback);
+	}
+
+	if (nbits < 0)
+	{
+		if (fx_mode != 0)
 		{
-			return (n);
+			int n = fx25_encode_frame(chan, fbuf, flen, fx_mode, bits);
+			if (n > 0)
+			{
+				nbits = n * 8;
+			}
+			else
+			{
+				fallback = 1;
+			}
+		}
+
+		if (nbits < 0)
+		{
+			nbits = hdlc_encode(fbuf, flen, bad_fcs, bits);
+			if (nbits < 0)
+			{
+				printf("Frame length of %d is too large to encode.\n", flen);
+				return (0);
+			}
 		}
 
+		if (!bad_fcs)
+		{
+			tx_cache_put(chan, fx_mode, fbuf, flen, hash, bits, nbits, fallback);
+		}
+	}
+
+	if (fallback)
+	{
 		printf("Unable to send FX.25.  Falling back to regular AX.25.\n");
 		// Definitely need to fall back to AX.25 here because
 		// the FX.25 frame length is so limited.
 	}
 
-	unsigned char fbuf[AX25_MAX_PACKET_LEN + 2];
-	int flen = ax25_pack(pp, fbuf);
-	return (ax25_only_hdlc_send_frame(chan, fbuf, flen, bad_fcs));
-}
+#if DEBUG
 
-static int ax25_only_hdlc_send_frame(int chan, unsigned char *fbuf, int flen, int bad_fcs)
-{
-	int j, fcs;
+	printf("layer2_send_frame ( chan = %d, flen = %d, bad_fcs = %d) nbits = %d\n", chan, flen, bad_fcs, nbits);
+	fflush(stdout);
+#endif
 
 	number_of_bits_sent[chan] = 0;
 
-#if DEBUG
+	hdlc_send_nrzi(chan, bits, nbits);
 
-	printf("hdlc_send_frame ( chan = %d, fbuf = %p, flen = %d, bad_fcs = %d)\n", chan, fbuf, flen, bad_fcs);
-	fflush(stdout);
-#endif
+	return (number_of_bits_sent[chan]);
+}
 
-	send_control_nrzi(chan, 0x7e); /* Start frame */
+/*
+ * Start flag, bit stuffed data and FCS, end flag.
+ * Bits are LSB of each byte first, not yet NRZI encoded.
+ * Returns number of bits, or -1 if it won't fit.
+ */
 
-	for (j = 0; j < flen; j++)
+static int hdlc_encode(unsigned char *fbuf, int flen, int bad_fcs, unsigned char *out)
+{
+	int olen = 0; // Number of bits in output.
+	int osize = HDLC_MAX_BITS(flen);
+	int ones = 0;
+	int fcs;
+	unsigned char fcs_bytes[2];
+
+	olen = hdlc_put_bits(out, olen, 0x7e, 8); /* Start frame */
+
+	olen = hdlc_stuff(fbuf, flen, out, olen, osize, &ones);
+	if (olen < 0)
 	{
-		send_data_nrzi(chan, fbuf[j]);
+		return (-1);
 	}
 
 	fcs = fcs_calc(fbuf, flen);
@@ -119,18 +465,21 @@ static int ax25_only_hdlc_send_frame(int chan, unsigned char *fbuf, int flen, in
 	if (bad_fcs)
 	{
 		/* For testing only - Simulate a frame getting corrupted along the way. */
-		send_data_nrzi(chan, (~fcs) & 0xff);
-		send_data_nrzi(chan, ((~fcs) >> 8) & 0xff);
+		fcs = ~fcs;
 	}
-	else
+	fcs_bytes[0] = fcs & 0xff;
+	fcs_bytes[1] = (fcs >> 8) & 0xff;
+
+	olen = hdlc_stuff(fcs_bytes, 2, out, olen, osize, &ones);
+	if (olen < 0 || olen + 8 > osize)
 	{
-		send_data_nrzi(chan, fcs & 0xff);
-		send_data_nrzi(chan, (fcs >> 8) & 0xff);
+		return (-1);
 	}
 
-	send_control_nrzi(chan, 0x7e); /* End frame */
+	olen = hdlc_put_bits(out, olen, 0x7e, 8); /* End frame */
 
-	return (number_of_bits_sent[chan]);
+	assert(olen > 0 && olen <= osize);
+	return (olen);
 }
 
 /*-------------------------------------------------------------
@@ -179,9 +528,15 @@ int layer2_preamble_postamble(int chan, int nbytes, int finish)
 	// a stream of a filler pattern.
 	// For AX.25, it is the 01111110 "flag" pattern with NRZI and no bit stuffing.
 
-	for (j = 0; j < nbytes; j++)
+	unsigned char flags[64];
+
+	memset(flags, 0x7e, sizeof(flags));
+
+	for (j = 0; j < nbytes; j += sizeof(flags))
 	{
-		send_control_nrzi(chan, 0x7e);
+		int n = nbytes - j < (int)sizeof(flags) ? nbytes - j : (int)sizeof(flags);
+
+		hdlc_send_nrzi(chan, flags, n * 8);
 	}
 
 	/* Push out the final partial buffer! */
@@ -194,70 +549,73 @@ int layer2_preamble_postamble(int chan, int nbytes, int finish)
 	return (number_of_bits_sent[chan]);
 }
 
-// The following are only for HDLC.
-// All bits are sent NRZI.
-// Data (non flags) use bit stuffing.
-
-static int stuff[MAX_CHANS]; // Count number of "1" bits to keep track of when we
-							 // need to break up a long run by "bit stuffing."
-							 // Needs to be array because we could be transmitting
-							 // on multiple channels at the same time.
+/*
+ * NRZI encoding.
+ * data 1 bit -> no change.
+ * data 0 bit -> invert signal.
+ */
 
-static void send_control_nrzi(int chan, int x)
+static void send_bit_nrzi(int chan, int b)
 {
-	int i;
-
-	for (i = 0; i < 8; i++)
+	if (b == 0)
 	{
-		send_bit_nrzi(chan, x & 1);
-		x >>= 1;
+		output[chan] = !output[chan];
 	}
 
-	stuff[chan] = 0;
+	tone_gen_put_bit(chan, output[chan]);
+
+	number_of_bits_sent[chan]++;
 }
 
-static void send_data_nrzi(int chan, int x)
+/*-------------------------------------------------------------
+ *
+ * Name:	hdlc_send_nrzi
+ *
+ * Purpose:	NRZI encode a buffer of bits and send them to the
+ *		tone generator.
+ *
+ * Inputs:	chan	- Audio channel number, 0 = first.
+ *
+ *		b	- Bits, LSB of each byte first.
+ *
+ *		nbits	- Number of bits.
+ *
+ * Description:	Whole bytes are done together with nrzi_table.
+ *		The NRZI level carries over from one call to the next
+ *		so AX.25, FX.25, and flags can be mixed.
+ *
+ *--------------------------------------------------------------*/
+
+void hdlc_send_nrzi(int chan, const unsigned char *b, int nbits)
 {
-	int i;
+	unsigned char nrzi[64];
+	int count = nbits / 8;
 
-	for (i = 0; i < 8; i++)
+	while (count > 0)
 	{
-		send_bit_nrzi(chan, x & 1);
-		if (x & 1)
+		int n = count < (int)sizeof(nrzi) ? count : (int)sizeof(nrzi);
+
+		for (int j = 0; j < n; j++)
 		{
-			stuff[chan]++;
-			if (stuff[chan] == 5)
+			unsigned int x = nrzi_table[b[j]];
+
+			if (output[chan])
 			{
-				send_bit_nrzi(chan, 0);
-				stuff[chan] = 0;
+				x ^= 0xff;
 			}
+			nrzi[j] = x;
+			output[chan] = (x >> 7) & 1;
 		}
-		else
-		{
-			stuff[chan] = 0;
-		}
-		x >>= 1;
+		tone_gen_put_bytes(chan, nrzi, n);
+		number_of_bits_sent[chan] += n * 8;
+		b += n;
+		count -= n;
 	}
-}
-
-/*
- * NRZI encoding.
- * data 1 bit -> no change.
- * data 0 bit -> invert signal.
- */
-
-static void send_bit_nrzi(int chan, int b)
-{
-	static int output[MAX_CHANS];
 
-	if (b == 0)
+	for (int k = 0; k < nbits % 8; k++)
 	{
-		output[chan] = !output[chan];
+		send_bit_nrzi(chan, (*b >> k) & 1);
 	}
-
-	tone_gen_put_bit(chan, output[chan]);
-
-	number_of_bits_sent[chan]++;
 }
 
 /* end hdlc_send.c */
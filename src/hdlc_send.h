@@ -8,8 +8,20 @@
 #include "ax25_pad.h"
 #include "audio.h"
 
+/* Worst case for HDLC is every 5th bit stuffed, plus a flag at each end. */
+
+#define HDLC_MAX_BITS(flen) (((flen) + 2) * 8 * 6 / 5 + 16)
+
+void layer2_send_init(void);
+
 int layer2_send_frame(int chan, packet_t pp, int bad_fcs, struct audio_s *audio_config_p);
 
 int layer2_preamble_postamble(int chan, int flags, int finish);
 
+int hdlc_stuff(const unsigned char *in, int ilen, unsigned char *out, int obits, int osize, int *ones);
+
+int hdlc_put_bits(unsigned char *out, int obits, unsigned int value, int n);
+
+void hdlc_send_nrzi(int chan, const unsigned char *b, int nbits);
+
 /* end hdlc_send.h */
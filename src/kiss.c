@@ -74,6 +74,11 @@
  *
  * Version 1.5:	Split serial port version off into its own file.
  *
+ * Version 1.8:	Frames for the client wait in a buffer, rather than
+ *		being lost, when the pseudo terminal is full.  The listen
+ *		thread sends them as the client reads.  When the buffer
+ *		is full too, the oldest frames are dropped.
+ *
  *---------------------------------------------------------------*/
 
 #if __WIN32__ // Stub for Windows.
@@ -96,6 +101,11 @@ void kisspt_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fle
 	return;
 }
 
+int kisspt_stats(int *out_len, int *max_lag, int *dropped)
+{
+	return (0);
+}
+
 #else // Rest of file is for Linux only.
 
 #include "direwolf.h"
@@ -117,6 +127,7 @@ void kisspt_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fle
 #include "kiss.h"
 #include "kiss_frame.h"
 #include "xmit.h"
+#include "dwthread.h"
 
 /*
  * Accumulated KISS frame and state of decoder.
@@ -133,6 +144,43 @@ static int pt_master_fd = -1; /* File descriptor for my end. */
 static char pt_slave_name[32]; /* Pseudo terminal slave name  */
 							   /* like /dev/pts/999 */
 
+/*
+ * Version 1.8: Bytes waiting for the client to read, and the length of
+ * each frame in there so whole frames can be dropped.  The data is
+ * buf[head] thru buf[head+len-1], moved back to the start when there
+ * isn't room after it.
+ *
+ * The oldest frame could be partly written already, first_sent bytes
+ * of it.  The rest of it must still go, or the client would see two
+ * frames run together, so it is never dropped.
+ *
+ * Added to by the thread processing received frames, sent by the
+ * listen thread when the pseudo terminal is writable, so wake_fd is
+ * written to get its attention.
+ */
+
+#define PT_OUT_MAX_FRAMES 256
+
+static struct
+{
+	dw_mutex_t mutex;
+	unsigned char *buf;
+	int size; /* KISSOUTPUT bytes. */
+	int head;
+	int len;
+
+	int frame_len[PT_OUT_MAX_FRAMES]; /* Circular, oldest first. */
+	int first_frame;
+	int num_frames;
+	int first_sent;
+
+	int max_lag; /* Most bytes ever waiting. */
+	int dropped; /* Frames dropped because the client fell behind. */
+	int behind;	 /* Dropping now.  To print a message once. */
+} out;
+
+static int wake_fd[2] = {-1, -1};
+
 /*
  * Symlink to pseudo terminal name which changes.
  */
@@ -140,6 +188,8 @@ static char pt_slave_name[32]; /* Pseudo terminal slave name  */
 #define TMP_KISSTNC_SYMLINK "/tmp/kisstnc"
 
 static void *kisspt_listen_thread(void *arg);
+static void out_add(unsigned char *buf, int len);
+static void out_drop_oldest(void);
 
 static int kisspt_debug = 0; /* Print information flowing from and to client. */
 
@@ -183,6 +233,16 @@ void kisspt_init(struct misc_config_s *mc)
 
 	if (mc->enable_kiss_pt)
 	{
+		dw_mutex_init(&out.mutex);
+		out.size = mc->kiss_out_max;
+		out.buf = malloc(out.size);
+		if (out.buf == NULL || pipe(wake_fd) != 0)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		fcntl(wake_fd[0], F_SETFL, fcntl(wake_fd[0], F_GETFL, 0) | O_NONBLOCK);
+		fcntl(wake_fd[1], F_SETFL, fcntl(wake_fd[1], F_GETFL, 0) | O_NONBLOCK);
 
 		pt_master_fd = kisspt_open_pt();
 
@@ -357,15 +417,16 @@ static int kisspt_open_pt(void)
  *		We really don't care if anyone is listening or not.
  *		I don't even know if we can find out.
  *
+ *		Version 1.8: This never waits.  See out_add.
+ *
  *--------------------------------------------------------------------*/
 
 void kisspt_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int flen, struct kissport_status_s *kps, int client)
 {
 	unsigned char kiss_buff[2 * AX25_MAX_PACKET_LEN + 2];
 	int kiss_len;
-	int err;
 
-	if (pt_master_fd == -1)
+	if (pt_master_fd == -1 || chan >= MAX_KISS_CHANS)
 	{
 		return;
 	}
@@ -383,19 +444,14 @@ void kisspt_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fle
 	else
 	{
 
-		unsigned char stemp[AX25_MAX_PACKET_LEN + 1];
-
-		if (flen > (int)(sizeof(stemp)) - 1)
+		if (flen > AX25_MAX_PACKET_LEN)
 		{
 
 			printf("\nPseudo Terminal KISS buffer too small.  Truncated.\n\n");
-			flen = (int)(sizeof(stemp)) - 1;
+			flen = AX25_MAX_PACKET_LEN;
 		}
 
-		stemp[0] = (chan << 4) | kiss_cmd;
-		memcpy(stemp + 1, fbuf, flen);
-
-		kiss_len = kiss_encapsulate(stemp, flen + 1, kiss_buff);
+		kiss_len = kiss_encapsulate_frame((chan << 4) | kiss_cmd, fbuf, flen, kiss_buff);
 
 		/* This has KISS framing and escapes for sending to client app. */
 
@@ -405,50 +461,241 @@ void kisspt_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fle
 		}
 	}
 
-	err = write(pt_master_fd, kiss_buff, (size_t)kiss_len);
+	dw_mutex_lock(&out.mutex);
+	out_add(kiss_buff, kiss_len);
+	dw_mutex_unlock(&out.mutex);
+
+} /* kisspt_send_rec_packet */
 
-	if (err == -1 && errno == EWOULDBLOCK)
+/*-------------------------------------------------------------------
+ *
+ * Name:        out_add
+ *
+ * Purpose:     Send to the client, or keep it for later, without waiting.
+ *
+ * Inputs:	buf, len	- One frame, or the fake command prompt.
+ *
+ * Description:	Caller holds out.mutex.
+ *
+ *		When nothing is waiting, it is written right away.
+ *		Whatever doesn't fit in the pseudo terminal is kept and the
+ *		listen thread is woken up to send it when it can.
+ *
+ *		Without room to keep it, the oldest frames are dropped.
+ *		The newest are more interesting to an APRS client.
+ *
+ *--------------------------------------------------------------------*/
+
+static void out_add(unsigned char *buf, int len)
+{
+	int sent = 0;
+
+	if (pt_master_fd == -1)
 	{
+		return;
+	}
 
-		printf("KISS SEND - Discarding message because no one is listening.\n");
-		printf("This happens when you use the -p option and don't read from the pseudo terminal.\n");
+	if (out.len == 0)
+	{
+		sent = write(pt_master_fd, buf, (size_t)len);
+		if (sent < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				printf("\nError sending KISS message to client application on pseudo terminal.  fd=%d, len=%d, errno = %d\n\n",
+					   pt_master_fd, len, errno);
+				perror("pt write");
+				return;
+			}
+			sent = 0;
+		}
+		if (sent == len)
+		{
+			return;
+		}
 	}
-	else if (err != kiss_len)
+
+	// Make room, keeping the rest of a frame partly sent.
+
+	while (out.num_frames > (out.first_sent > 0) &&
+		   (out.len + len - sent > out.size || out.num_frames >= PT_OUT_MAX_FRAMES))
+	{
+		out_drop_oldest();
+	}
+
+	if (out.len + len - sent > out.size || out.num_frames >= PT_OUT_MAX_FRAMES)
 	{
+		out.dropped++; /* Only the one partly sent is ahead of it. */
+		return;
+	}
 
-		printf("\nError sending KISS message to client application on pseudo terminal.  fd=%d, len=%d, write returned %d, errno = %d\n\n",
-			   pt_master_fd, kiss_len, err, errno);
-		perror("pt write");
+	if (out.head + out.len + len - sent > out.size)
+	{
+		memmove(out.buf, out.buf + out.head, out.len);
+		out.head = 0;
 	}
 
-} /* kisspt_send_rec_packet */
+	int was_empty = out.len == 0;
+
+	memcpy(out.buf + out.head + out.len, buf + sent, len - sent);
+	out.len += len - sent;
+	out.frame_len[(out.first_frame + out.num_frames) % PT_OUT_MAX_FRAMES] = len;
+	out.num_frames++;
+	if (was_empty)
+	{
+		out.first_sent = sent;
+	}
+	if (out.len > out.max_lag)
+	{
+		out.max_lag = out.len;
+	}
+
+	if (was_empty)
+	{
+		char c = 0;
+		if (write(wake_fd[1], &c, 1) < 0)
+		{
+			// Already has a wake up waiting.
+		}
+	}
+}
+
+/* Caller holds out.mutex.  Drop the oldest frame that hasn't been started. */
+
+static void out_drop_oldest(void)
+{
+	int k = out.first_frame;
+
+	if (!out.behind)
+	{
+		printf("\nKISS client application on %s is not keeping up.  Dropping oldest frames for it.\n\n", pt_slave_name);
+		out.behind = 1;
+	}
+	out.dropped++;
+
+	if (out.first_sent == 0)
+	{
+		out.head += out.frame_len[k];
+		out.len -= out.frame_len[k];
+	}
+	else
+	{
+		// Take out the second one.  The rest of the first moves up into its place.
+
+		int rest = out.frame_len[k] - out.first_sent;
+		int k2 = (k + 1) % PT_OUT_MAX_FRAMES;
+
+		memmove(out.buf + out.head + out.frame_len[k2], out.buf + out.head, rest);
+		out.head += out.frame_len[k2];
+		out.len -= out.frame_len[k2];
+		out.frame_len[k2] = out.frame_len[k];
+	}
+	out.first_frame = (k + 1) % PT_OUT_MAX_FRAMES;
+	out.num_frames--;
+}
+
+/* Pseudo terminal is writable.  Send what has been waiting. */
+
+static void out_write(void)
+{
+	dw_mutex_lock(&out.mutex);
+
+	if (out.len > 0 && pt_master_fd != -1)
+	{
+		int n = write(pt_master_fd, out.buf + out.head, (size_t)out.len);
+
+		if (n > 0)
+		{
+			out.head += n;
+			out.len -= n;
+			out.first_sent += n;
+			while (out.num_frames > 0 && out.first_sent >= out.frame_len[out.first_frame])
+			{
+				out.first_sent -= out.frame_len[out.first_frame];
+				out.first_frame = (out.first_frame + 1) % PT_OUT_MAX_FRAMES;
+				out.num_frames--;
+			}
+		}
+		else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			printf("\nError sending KISS message to client application on pseudo terminal.  errno = %d\n\n", errno);
+			perror("pt write");
+		}
+	}
+
+	if (out.len == 0)
+	{
+		out.head = 0;
+		if (out.behind)
+		{
+			printf("\nKISS client application on %s has caught up.  %d frames dropped so far.\n\n", pt_slave_name, out.dropped);
+			out.behind = 0;
+		}
+	}
+
+	dw_mutex_unlock(&out.mutex);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kisspt_stats
+ *
+ * Purpose:     Statistics for output to the client, for metrics_server.c.
+ *
+ * Outputs:	out_len	- Bytes waiting to be sent now.
+ *		max_lag	- Most bytes ever waiting.
+ *		dropped	- Frames dropped because it fell behind.
+ *
+ * Returns:	1 if the pseudo terminal is in use, 0 if not.
+ *
+ *--------------------------------------------------------------------*/
+
+int kisspt_stats(int *out_len, int *max_lag, int *dropped)
+{
+	if (out.buf == NULL)
+	{
+		return (0);
+	}
+	dw_mutex_lock(&out.mutex);
+	*out_len = out.len;
+	*max_lag = out.max_lag;
+	*dropped = out.dropped;
+	dw_mutex_unlock(&out.mutex);
+	return (1);
+}
 
 /*-------------------------------------------------------------------
  *
  * Name:        kisspt_get
  *
- * Purpose:     Read one byte from the KISS client app.
+ * Purpose:     Read from the KISS client app.
+ *
+ * Inputs:	buf	- Where to put it.
+ *		size	- Size of buf.
  *
  * Global In:	pt_master_fd
  *
- * Returns:	one byte (value 0 - 255) or terminate thread on error.
+ * Returns:	Number of bytes read, at least 1, or terminate thread on error.
  *
- * Description:	There is room for improvement here.  Reading one byte
- *		at a time is inefficient.  We could read a large block
- *		into a local buffer and return a byte from that most of the time.
- *		Is it worth the effort?  I don't know.  With GHz processors and
- *		the low data rate here it might not make a noticeable difference.
+ * Description:	Version 1.8:  Read as much as is available, rather than
+ *		one byte at a time.
+ *
+ *		While waiting, send anything for the client that didn't
+ *		fit in the pseudo terminal before.
  *
  *--------------------------------------------------------------------*/
 
-static int kisspt_get(void)
+static int kisspt_get(unsigned char *buf, int size)
 {
-	unsigned char ch;
-
 	int n = 0;
-	fd_set fd_in, fd_ex;
+	fd_set fd_in, fd_out, fd_ex;
 	int rc;
 
+	// Everything from the last read has been processed.
+	// Queue up any frames it contained before waiting for more.
+
+	kiss_flush_xmit();
+
 	while (n == 0)
 	{
 
@@ -491,27 +738,71 @@ static int kisspt_get(void)
 		 * We don't get the error from kissattach anymore.
 		 */
 
+		/*
+		 * Version 1.8: Also wait for room to send what is waiting for
+		 * the client, or for a wake up when there is something new.
+		 */
+
+		int waiting;
+
+		dw_mutex_lock(&out.mutex);
+		waiting = out.len > 0;
+		dw_mutex_unlock(&out.mutex);
+
 		FD_ZERO(&fd_in);
 		FD_SET(pt_master_fd, &fd_in);
+		FD_SET(wake_fd[0], &fd_in);
+
+		FD_ZERO(&fd_out);
+		if (waiting)
+		{
+			FD_SET(pt_master_fd, &fd_out);
+		}
 
 		FD_ZERO(&fd_ex);
 		FD_SET(pt_master_fd, &fd_ex);
 
-		rc = select(pt_master_fd + 1, &fd_in, NULL, &fd_ex, NULL);
-		if (rc == 0)
+		rc = select((pt_master_fd > wake_fd[0] ? pt_master_fd : wake_fd[0]) + 1, &fd_in, &fd_out, &fd_ex, NULL);
+		if (rc == 0 || (rc == -1 && errno == EINTR))
 		{
 			continue; // When could we get a 0?
 		}
 
-		if (rc == -1 || (n = read(pt_master_fd, &ch, (size_t)1)) != 1)
+		if (rc > 0 && FD_ISSET(wake_fd[0], &fd_in))
 		{
+			char junk[16];
+			while (read(wake_fd[0], junk, sizeof(junk)) > 0)
+				;
+		}
+
+		if (rc > 0 && FD_ISSET(pt_master_fd, &fd_out))
+		{
+			out_write();
+		}
+
+		if (rc > 0 && !FD_ISSET(pt_master_fd, &fd_in) && !FD_ISSET(pt_master_fd, &fd_ex))
+		{
+			continue;
+		}
+
+		if (rc == -1 || (n = read(pt_master_fd, buf, (size_t)size)) <= 0)
+		{
+			if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+			{
+				n = 0;
+				continue;
+			}
 
 			printf("\nError receiving KISS message from client application.  Closing %s.\n\n", pt_slave_name);
 			perror("");
 
+			dw_mutex_lock(&out.mutex);
 			close(pt_master_fd);
-
 			pt_master_fd = -1;
+			out.len = 0;
+			out.num_frames = 0;
+			dw_mutex_unlock(&out.mutex);
+
 			unlink(TMP_KISSTNC_SYMLINK);
 			pthread_exit(NULL);
 		}
@@ -519,10 +810,10 @@ static int kisspt_get(void)
 
 #if DEBUG
 
-	printf("kisspt_get(%d) returns 0x%02x\n", fd, ch);
+	printf("kisspt_get(%d) returns %d bytes\n", fd, n);
 #endif
 
-	return (ch);
+	return (n);
 }
 
 /*-------------------------------------------------------------------
@@ -534,13 +825,14 @@ static int kisspt_get(void)
  * Global In:
  *
  * Description:	Reads bytes from the KISS client app and
- *		sends them to kiss_rec_byte for processing.
+ *		sends them to kiss_rec_bytes for processing.
  *
  *--------------------------------------------------------------------*/
 
 static void *kisspt_listen_thread(void *arg)
 {
-	unsigned char ch;
+	unsigned char buf[1024];
+	int n;
 
 #if DEBUG
 
@@ -549,8 +841,8 @@ static void *kisspt_listen_thread(void *arg)
 
 	while (1)
 	{
-		ch = kisspt_get();
-		kiss_rec_byte(&kf, ch, kisspt_debug, NULL, -1, kisspt_send_rec_packet);
+		n = kisspt_get(buf, sizeof(buf));
+		kiss_rec_bytes(&kf, buf, n, kisspt_debug, NULL, -1, kisspt_send_rec_packet);
 	}
 
 	return (void *)0; /* Unreachable but avoids compiler warning. */
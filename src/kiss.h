@@ -18,4 +18,6 @@ void kisspt_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fle
 
 void kisspt_set_debug(int n);
 
+int kisspt_stats(int *out_len, int *max_lag, int *dropped);
+
 /* end kiss.h */
@@ -93,6 +93,14 @@
 #include "version.h"
 #include "kissnet.h"
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#define KISS_SCAN_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__GNUC__)
+#define KISS_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
 #if KISSTEST
 
 #define printf printf
@@ -135,6 +143,95 @@ void kiss_frame_init(struct audio_s *pa)
 	save_audio_config_p = pa;
 }
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        kiss_clean_run
+ *
+ * Purpose:     Find how many bytes can be copied as is.
+ *
+ * Inputs:	p	- Start of data.
+ *		n	- Number of bytes.
+ *
+ * Returns:	Number of bytes, from the start, before the first FEND or FESC.
+ *		n if there are none.
+ *
+ * Description:	Version 1.8:  Most frames have few, if any, bytes that need
+ *		escaping.  Look at 16 at a time, where possible, so the
+ *		callers can copy the clean runs between them in bulk.
+ *
+ *-----------------------------------------------------------------*/
+
+static inline int kiss_clean_run(const unsigned char *p, int n)
+{
+	int i = 0;
+
+#if KISS_SCAN_SSE2
+	const __m128i fend = _mm_set1_epi8((char)FEND);
+	const __m128i fesc = _mm_set1_epi8((char)FESC);
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, fend), _mm_cmpeq_epi8(v, fesc)));
+		if (mask != 0)
+		{
+			return (i + __builtin_ctz(mask));
+		}
+	}
+#elif KISS_SCAN_NEON
+	const uint8x16_t fend = vdupq_n_u8(FEND);
+	const uint8x16_t fesc = vdupq_n_u8(FESC);
+
+	for (; i + 16 <= n; i += 16)
+	{
+		uint8x16_t v = vld1q_u8(p + i);
+		uint8x16_t hit = vorrq_u8(vceqq_u8(v, fend), vceqq_u8(v, fesc));
+
+		// Narrow to 4 bits per byte to get something like movemask.
+
+		uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+		if (mask != 0)
+		{
+			return (i + (__builtin_ctzll(mask) >> 2));
+		}
+	}
+#endif
+
+	for (; i < n; i++)
+	{
+		if (p[i] == FEND || p[i] == FESC)
+		{
+			return (i);
+		}
+	}
+	return (n);
+}
+
+/* Append in to out with escapes.  Returns number of bytes put in out. */
+
+static int kiss_escape(const unsigned char *in, int ilen, unsigned char *out)
+{
+	int olen = 0;
+	int j = 0;
+
+	while (j < ilen)
+	{
+		int run = kiss_clean_run(in + j, ilen - j);
+
+		memcpy(out + olen, in + j, run);
+		olen += run;
+		j += run;
+
+		if (j < ilen)
+		{
+			out[olen++] = FESC;
+			out[olen++] = in[j] == FEND ? TFEND : TFESC;
+			j++;
+		}
+	}
+	return (olen);
+}
+
 /*-------------------------------------------------------------------
  *
  * Name:        kiss_encapsulate
@@ -171,34 +268,52 @@ void kiss_frame_init(struct audio_s *pa)
 int kiss_encapsulate(unsigned char *in, int ilen, unsigned char *out)
 {
 	int olen;
-	int j;
 
 	olen = 0;
 	out[olen++] = FEND;
-	for (j = 0; j < ilen; j++)
-	{
-
-		if (in[j] == FEND)
-		{
-			out[olen++] = FESC;
-			out[olen++] = TFEND;
-		}
-		else if (in[j] == FESC)
-		{
-			out[olen++] = FESC;
-			out[olen++] = TFESC;
-		}
-		else
-		{
-			out[olen++] = in[j];
-		}
-	}
+	olen += kiss_escape(in, ilen, out + olen);
 	out[olen++] = FEND;
 
 	return (olen);
 
 } /* end kiss_encapsulate */
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        kiss_encapsulate_frame
+ *
+ * Purpose:     Same as kiss_encapsulate but with the "type indicator"
+ *		passed separately so the caller doesn't need to copy
+ *		the frame after it.
+ *
+ * Inputs:	type	- Type indicator with channel and command.
+ *
+ *		frame	- AX.25 frame without the FCS.
+ *
+ *		flen	- Number of bytes in frame.
+ *
+ * Outputs:	out	- Address where to place the KISS encoded representation.
+ *			  Room is needed for twice flen plus 4.
+ *
+ * Returns:	Number of bytes in the output.
+ *
+ *-----------------------------------------------------------------*/
+
+int kiss_encapsulate_frame(int type, unsigned char *frame, int flen, unsigned char *out)
+{
+	int olen;
+	unsigned char ch = type;
+
+	olen = 0;
+	out[olen++] = FEND;
+	olen += kiss_escape(&ch, 1, out + olen);
+	olen += kiss_escape(frame, flen, out + olen);
+	out[olen++] = FEND;
+
+	return (olen);
+
+} /* end kiss_encapsulate_frame */
+
 #ifndef WALK96
 
 /*-------------------------------------------------------------------
@@ -268,6 +383,21 @@ int kiss_unwrap(unsigned char *in, int ilen, unsigned char *out)
 	for (; j < ilen; j++)
 	{
 
+		// Copy everything up to the next FEND or FESC at once.
+
+		if (!escaped_mode)
+		{
+			int run = kiss_clean_run(in + j, ilen - j);
+
+			memcpy(out + olen, in + j, run);
+			olen += run;
+			j += run;
+			if (j >= ilen)
+			{
+				break;
+			}
+		}
+
 		if (in[j] == FEND)
 		{
 
@@ -474,6 +604,63 @@ void kiss_rec_byte(kiss_frame_t *kf, unsigned char ch, int debug,
 
 } /* end kiss_rec_byte */
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        kiss_rec_bytes
+ *
+ * Purpose:     Process a block of bytes from a KISS client app.
+ *
+ * Inputs:	kf	- Current state of building a frame.
+ *		buf	- Bytes from the input stream.
+ *		len	- Number of bytes.
+ *		debug, kps, client, sendfun - Same as kiss_rec_byte.
+ *
+ * Outputs:	kf	- Current state is updated.
+ *
+ * Description:	Same result as kiss_rec_byte for each byte, but while
+ *		collecting a frame, everything up to the next FEND is
+ *		copied at once.  The FEND itself, and anything between
+ *		frames, still goes through kiss_rec_byte.
+ *
+ *-----------------------------------------------------------------*/
+
+void kiss_rec_bytes(kiss_frame_t *kf, unsigned char *buf, int len, int debug,
+					struct kissport_status_s *kps, int client,
+					void (*sendfun)(int chan, int kiss_cmd, unsigned char *fbuf, int flen, struct kissport_status_s *onlykps, int onlyclient))
+{
+	unsigned char *p = buf;
+	unsigned char *end = buf + len;
+
+	while (p < end)
+	{
+		if (kf->state == KS_COLLECTING)
+		{
+			unsigned char *fend = memchr(p, FEND, end - p);
+			int n = (fend != NULL ? fend : end) - p;
+
+			if (n > 0)
+			{
+				int room = MAX_KISS_LEN - kf->kiss_len;
+
+				if (n > room)
+				{
+					printf("KISS message exceeded maximum length.\n");
+				}
+				memcpy(kf->kiss_msg + kf->kiss_len, p, n < room ? n : room);
+				kf->kiss_len += n < room ? n : room;
+				p += n;
+			}
+			if (fend == NULL)
+			{
+				break;
+			}
+		}
+
+		kiss_rec_byte(kf, *p++, debug, kps, client, sendfun);
+	}
+
+} /* end kiss_rec_bytes */
+
 /*-------------------------------------------------------------------
  *
  * Name:        kiss_process_msg
@@ -503,6 +690,84 @@ void kiss_rec_byte(kiss_frame_t *kf, unsigned char ch, int debug,
 				 // Some functions are only for the TNC end.
 				 // Other functions are suitble for both TNC and client app.
 
+/*
+ * Version 1.8: Data frames from the client are held here until the
+ * reader has nothing more to process right now, then go to the
+ * transmit queue together with tq_append_batch.  This is per thread.
+ * One event thread reads all the TCP clients, so frames from different
+ * clients never get mixed only because client_read calls
+ * kiss_flush_xmit after each read.  The other readers do the same.
+ */
+
+static __thread packet_t xmit_head = NULL;
+static __thread packet_t xmit_tail = NULL;
+static __thread int xmit_chan;
+static __thread int xmit_prio;
+
+/* Where to send the TXFULL notice if the transmit queue refuses them. */
+
+static __thread struct kissport_status_s *xmit_kps;
+static __thread int xmit_client;
+static __thread void (*xmit_sendfun)(int chan, int kiss_cmd, unsigned char *fbuf, int flen, struct kissport_status_s *onlykps, int onlyclient);
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kiss_flush_xmit
+ *
+ * Purpose:     Send data frames held by kiss_process_msg to the transmit queue.
+ *
+ * Description:	Readers call this when there is no more input available
+ *		immediately, before waiting for more.
+ *
+ *		If the queue is full and TXQUEUE has the REJECT option,
+ *		the client is sent "TXFULL:n" as a Set Hardware response,
+ *		where n is the number of frames refused.
+ *
+ *-----------------------------------------------------------------*/
+
+void kiss_flush_xmit(void)
+{
+	if (xmit_head != NULL)
+	{
+		int rejected = tq_append_batch(xmit_chan, xmit_prio, xmit_head);
+		xmit_head = NULL;
+		xmit_tail = NULL;
+
+		if (rejected > 0 && xmit_sendfun != NULL)
+		{
+			char response[40];
+
+			snprintf(response, sizeof(response), "TXFULL:%d", rejected);
+			(*xmit_sendfun)(xmit_chan, KISS_CMD_SET_HARDWARE, (unsigned char *)response, strlen(response), xmit_kps, xmit_client);
+		}
+	}
+}
+
+static void hold_xmit(int chan, int prio, packet_t pp, struct kissport_status_s *kps, int client,
+					  void (*sendfun)(int chan, int kiss_cmd, unsigned char *fbuf, int flen, struct kissport_status_s *onlykps, int onlyclient))
+{
+	if (xmit_head != NULL && (chan != xmit_chan || prio != xmit_prio))
+	{
+		kiss_flush_xmit();
+	}
+
+	ax25_set_nextp(pp, NULL);
+	if (xmit_head == NULL)
+	{
+		xmit_head = pp;
+		xmit_chan = chan;
+		xmit_prio = prio;
+		xmit_kps = kps;
+		xmit_client = client;
+		xmit_sendfun = sendfun;
+	}
+	else
+	{
+		ax25_set_nextp(xmit_tail, pp);
+	}
+	xmit_tail = pp;
+}
+
 // This is used only by the TNC side.
 
 void kiss_process_msg(unsigned char *kiss_msg, int kiss_len, struct kissport_status_s *kps, int client,
@@ -528,6 +793,13 @@ void kiss_process_msg(unsigned char *kiss_msg, int kiss_len, struct kissport_sta
 	}
 	cmd = kiss_msg[0] & 0xf;
 
+	// Anything other than a data frame takes effect after the frames before it.
+
+	if (cmd != KISS_CMD_DATA_FRAME)
+	{
+		kiss_flush_xmit();
+	}
+
 	switch (cmd)
 	{
 	case KISS_CMD_DATA_FRAME: /* 0 = Data Frame */
@@ -623,11 +895,11 @@ void kiss_process_msg(unsigned char *kiss_msg, int kiss_len, struct kissport_sta
 			if (ax25_get_num_repeaters(pp) >= 1 &&
 				ax25_get_h(pp, AX25_REPEATER_1))
 			{
-				tq_append(chan, TQ_PRIO_0_HI, pp);
+				hold_xmit(chan, TQ_PRIO_0_HI, pp, kps, client, sendfun);
 			}
 			else
 			{
-				tq_append(chan, TQ_PRIO_1_LO, pp);
+				hold_xmit(chan, TQ_PRIO_1_LO, pp, kps, client, sendfun);
 			}
 		}
 		break;
@@ -850,6 +1122,11 @@ void kiss_process_msg(unsigned char *kiss_msg, int kiss_len, struct kissport_sta
  *
  *			TXBUF:		TXBUF:999		Number of bytes (not frames) in transmit queue.
  *
+ * Notices:	(TNC to client, not asked for.)
+ *
+ *			TXFULL:99		Number of frames refused because the transmit
+ *						queue is full.  Only with TXQUEUE ... REJECT.
+ *
  *--------------------------------------------------------------------*/
 
 #ifndef KISSUTIL
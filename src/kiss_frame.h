@@ -60,6 +60,44 @@ typedef struct kiss_frame_s
 
 } kiss_frame_t;
 
+// One connection to a KISS TCP client application.
+
+struct kissnet_client_s
+{
+	int sock;
+	/* File descriptor for socket for */
+	/* communication with client application. */
+	/* Set to -1 if not connected. */
+	/* (Don't use SOCKET type because it is unsigned.) */
+
+	unsigned int gen;
+	/* Incremented for each new connection in this slot */
+	/* so a reply meant for an earlier one is not sent. */
+
+	kiss_frame_t kf;
+	/* Accumulated KISS frame and state of decoder. */
+
+#if !__WIN32__
+	int dead;
+	/* Shut down after an error, waiting for the */
+	/* event thread to close it. */
+
+	unsigned char *out_buf;
+	int out_head;
+	int out_len;
+	/* Ring of bytes not yet sent because client */
+	/* is slow to read. */
+
+	int out_max_lag; // Most bytes ever waiting.
+	int out_dropped; // Frames dropped because client fell behind.
+	int out_behind;	 // Dropping now.  Report when caught up.
+
+	int out_pending; // Version 1.8: Held to be sent with others
+					 // in one system call.  See kissnet_batch_end.
+	int want_write;	 // Waiting for the socket to be writable.
+#endif
+};
+
 // This is used only for TCPKISS but it put in kissnet.h,
 // there would be a circular dependency between the two header files.
 // Each KISS TCP port has its own status block.
@@ -78,34 +116,49 @@ struct kissport_status_s
 			  // -1 for all.
 
 	// The default is a limit of 3 client applications at the same time.
-	// You can increase the limit by changing the line below.
-	// A larger number consumes more resources so don't go crazy by making it larger than needed.
-	// TODO:  Should this be moved to direwolf.h so max number of audio devices
-	// client apps are in the same place?
+	// Version 1.8: KISSCLIENTS in the configuration file changes it.
+	// State for a connection is allocated only when a slot is first used.
 
-#define MAX_NET_CLIENTS 3
+	int max_clients;
 
-	int client_sock[MAX_NET_CLIENTS];
-	/* File descriptor for socket for */
-	/* communication with client application. */
-	/* Set to -1 if not connected. */
-	/* (Don't use SOCKET type because it is unsigned.) */
+	struct kissnet_client_s **client;
+	/* Table of max_clients.  NULL for a slot never used. */
+	/* Slots are used lowest first so the first num_slots */
+	/* are the only ones that can be non-NULL. */
 
-	kiss_frame_t kf[MAX_NET_CLIENTS];
-	/* Accumulated KISS frame and state of decoder. */
+	int num_slots;
+
+#if !__WIN32__
+	// Used by the kissnet event thread.
+
+	int index;		 // Position in table of ports.
+	int listen_sock; // Listening socket or -1.
+
+	char unix_path[108]; // Version 1.8: Unix domain socket path
+						 // rather than TCP port.  Empty if TCP.
+
+	char port_desc[120]; // "port 8001" or "socket /path" for messages.
+#endif
 };
 
 #ifndef KISSUTIL
 void kiss_frame_init(struct audio_s *pa);
+
+void kiss_flush_xmit(void);
 #endif
 
 int kiss_encapsulate(unsigned char *in, int ilen, unsigned char *out);
 
+int kiss_encapsulate_frame(int type, unsigned char *frame, int flen, unsigned char *out);
+
 int kiss_unwrap(unsigned char *in, int ilen, unsigned char *out);
 
 void kiss_rec_byte(kiss_frame_t *kf, unsigned char ch, int debug, struct kissport_status_s *kps, int client,
 				   void (*sendfun)(int chan, int kiss_cmd, unsigned char *fbuf, int flen, struct kissport_status_s *onlykps, int onlyclient));
 
+void kiss_rec_bytes(kiss_frame_t *kf, unsigned char *buf, int len, int debug, struct kissport_status_s *kps, int client,
+					void (*sendfun)(int chan, int kiss_cmd, unsigned char *fbuf, int flen, struct kissport_status_s *onlykps, int onlyclient));
+
 typedef enum fromto_e
 {
 	FROM_CLIENT = 0,
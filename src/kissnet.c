@@ -176,8 +176,19 @@ same direwolf instance.
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#if __linux__
+#include <sys/epoll.h>
+#else
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
 #endif
 
 #include <unistd.h>
@@ -185,6 +196,7 @@ same direwolf instance.
 #include <assert.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "tq.h"
 #include "ax25_pad.h"
@@ -192,6 +204,7 @@ same direwolf instance.
 #include "kissnet.h"
 #include "kiss_frame.h"
 #include "xmit.h"
+#include "dwthread.h"
 
 // TODO:  define in one place, use everywhere.
 #if __WIN32__
@@ -200,8 +213,30 @@ same direwolf instance.
 #define THREAD_F void *
 #endif
 
+#if __WIN32__
 static THREAD_F connect_listen_thread(void *arg);
 static THREAD_F kissnet_listen_thread(void *arg);
+#else
+static THREAD_F kissnet_event_thread(void *arg);
+static int client_send(struct kissport_status_s *kps, int client, unsigned char *buf, int len);
+static void fwd_send(int chan, int kiss_cmd, unsigned char *fbuf, int flen, struct kissport_status_s *from_kps, int from_client);
+
+static int ev_fd = -1; /* epoll or kqueue instance. */
+static struct kissport_status_s *ev_ports[MAX_KISS_TCP_PORTS + 1]; /* Including Unix socket. */
+static int ev_num_ports = 0;
+
+/* Serializes sending to clients from different threads. */
+/* Also protects sock, dead, and the out_ fields of each client. */
+
+static dw_mutex_t send_mutex;
+
+/* Version 1.8: Received frames are held, and sent together, between */
+/* kissnet_batch_begin and kissnet_batch_end in the same thread. */
+
+static __thread int batching = 0;
+static int some_pending = 0; /* Some client has out_pending.  Protected by send_mutex. */
+static double pending_since; /* When that started. */
+#endif
 
 static struct misc_config_s *s_misc_config_p;
 
@@ -212,6 +247,47 @@ static struct kissport_status_s *all_ports = NULL;
 
 static int kiss_debug = 0; /* Print information flowing from and to client. */
 
+/*
+ * The client number given to kiss_frame.c, and passed back to us with a
+ * reply, has the generation of the connection as well as the slot.
+ * A reply is dropped if the slot has been reused since.
+ */
+
+#define CLIENT_HANDLE(slot, gen) ((int)((((gen) & 0x7fff) << 16) | (slot)))
+#define HANDLE_SLOT(h) ((h) & 0xffff)
+#define HANDLE_GEN(h) (((unsigned int)(h) >> 16) & 0x7fff)
+
+/*
+ * Client state is allocated in blocks and never freed.  A slot keeps its
+ * state after disconnecting, for the next connection in that slot, so
+ * other threads can look at it without a lock.
+ */
+
+#define CLIENT_SLAB 16
+
+static struct kissnet_client_s *client_new(void)
+{
+	static struct kissnet_client_s *slab = NULL;
+	static int slab_left = 0;
+
+	if (slab_left == 0)
+	{
+		slab = calloc(CLIENT_SLAB, sizeof(struct kissnet_client_s));
+		if (slab == NULL)
+		{
+
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		slab_left = CLIENT_SLAB;
+	}
+
+	struct kissnet_client_s *cl = slab++;
+	slab_left--;
+	cl->sock = -1;
+	return (cl);
+}
+
 void kiss_net_set_debug(int n)
 {
 	kiss_debug = n;
@@ -228,35 +304,77 @@ void kiss_net_set_debug(int n)
  * Inputs:	mc->kiss_port	- TCP port for server.
  *				0 means disable.  New in version 1.2.
  *
+ *		mc->kiss_unix_path - Version 1.8: Unix domain socket, not Windows.
+ *				Empty means disable.
+ *
  * Outputs:
  *
- * Description:	This starts two threads:
+ * Description:	Windows starts two threads:
  *		  *  to listen for a connection from client app.
  *		  *  to listen for commands from client app.
  *		so the main application doesn't block while we wait for these.
  *
+ *		Version 1.8:  Elsewhere, there is a single thread for all
+ *		ports and clients.  It uses epoll (Linux) or kqueue (BSD,
+ *		Mac OSX) with non-blocking sockets to accept connections,
+ *		read from clients, and finish sending to slow clients.
+ *		The number of threads no longer depends on the number of
+ *		ports and clients.
+ *
  *--------------------------------------------------------------------*/
 
 static void kissnet_init_one(struct kissport_status_s *kps);
 
+static struct kissport_status_s *port_new(struct misc_config_s *mc, int chan)
+{
+	struct kissport_status_s *kps = calloc(sizeof(struct kissport_status_s), 1);
+	if (kps == NULL)
+	{
+
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	kps->chan = chan;
+	kps->max_clients = mc->kiss_max_clients;
+	kps->client = calloc(kps->max_clients, sizeof(struct kissnet_client_s *));
+	if (kps->client == NULL)
+	{
+
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	return (kps);
+}
+
 void kissnet_init(struct misc_config_s *mc)
 {
 	s_misc_config_p = mc;
 
+#if !__WIN32__
+	dw_mutex_init(&send_mutex);
+#if __linux__
+	ev_fd = epoll_create1(0);
+#else
+	ev_fd = kqueue();
+#endif
+	if (ev_fd < 0)
+	{
+		perror("kissnet_init: Could not create event queue");
+		return;
+	}
+#endif
+
 	for (int i = 0; i < MAX_KISS_TCP_PORTS; i++)
 	{
 		if (mc->kiss_port[i] != 0)
 		{
-			struct kissport_status_s *kps = calloc(sizeof(struct kissport_status_s), 1);
-			if (kps == NULL)
-			{
-
-				printf("FATAL ERROR: Out of memory.\n");
-				exit(EXIT_FAILURE);
-			}
+			struct kissport_status_s *kps = port_new(mc, mc->kiss_chan[i]);
 
 			kps->tcp_port = mc->kiss_port[i];
-			kps->chan = mc->kiss_chan[i];
+#if !__WIN32__
+			snprintf(kps->port_desc, sizeof(kps->port_desc), "port %d", kps->tcp_port);
+#endif
 			kissnet_init_one(kps);
 
 			// Add to list.
@@ -264,31 +382,61 @@ void kissnet_init(struct misc_config_s *mc)
 			all_ports = kps;
 		}
 	}
+
+#if !__WIN32__
+
+	// Version 1.8: Same thing on a Unix domain socket for applications
+	// on the same host.  This avoids the TCP/IP stack of loopback.
+
+	if (strlen(mc->kiss_unix_path) > 0)
+	{
+		struct kissport_status_s *kps = port_new(mc, mc->kiss_unix_chan);
+
+		snprintf(kps->unix_path, sizeof(kps->unix_path), "%s", mc->kiss_unix_path);
+		snprintf(kps->port_desc, sizeof(kps->port_desc), "socket %s", kps->unix_path);
+		kissnet_init_one(kps);
+
+		kps->pnext = all_ports;
+		all_ports = kps;
+	}
+#endif
+
+#if !__WIN32__
+	if (ev_num_ports > 0)
+	{
+		pthread_t tid;
+		int e = pthread_create(&tid, NULL, kissnet_event_thread, NULL);
+		if (e != 0)
+		{
+			perror("Could not create KISS TCP event thread");
+			return;
+		}
+		pthread_detach(tid);
+	}
+#endif
 }
 
+#if __WIN32__
+
 static void kissnet_init_one(struct kissport_status_s *kps)
 {
 	int client;
 
-#if __WIN32__
 	HANDLE connect_listen_th;
-	HANDLE cmd_listen_th[MAX_NET_CLIENTS];
-#else
-	pthread_t connect_listen_tid;
-	pthread_t cmd_listen_tid[MAX_NET_CLIENTS];
-	int e;
-#endif
+	HANDLE cmd_listen_th;
 
 #if DEBUG
 
 	printf("kissnet_init ( tcp port %d, radio chan = %d )\n", kps->tcp_port, kps->chan);
 #endif
 
-	for (client = 0; client < MAX_NET_CLIENTS; client++)
+	// There is a thread for each slot so they are all used.
+
+	for (client = 0; client < kps->max_clients; client++)
 	{
-		kps->client_sock[client] = -1;
-		memset(&(kps->kf[client]), 0, sizeof(kps->kf[client]));
+		kps->client[client] = client_new();
 	}
+	kps->num_slots = kps->max_clients;
 
 	if (kps->tcp_port == 0)
 	{
@@ -300,7 +448,6 @@ static void kissnet_init_one(struct kissport_status_s *kps)
 /*
  * This waits for a client to connect and sets client_sock[n].
  */
-#if __WIN32__
 	connect_listen_th = (HANDLE)_beginthreadex(NULL, 0, connect_listen_thread, (void *)kps, 0, NULL);
 	if (connect_listen_th == NULL)
 	{
@@ -308,46 +455,24 @@ static void kissnet_init_one(struct kissport_status_s *kps)
 		printf("Could not create KISS socket connect listening thread for tcp port %d, radio chan %d\n", kps->tcp_port, kps->chan);
 		return;
 	}
-#else
-	e = pthread_create(&connect_listen_tid, NULL, connect_listen_thread, (void *)kps);
-	if (e != 0)
-	{
-
-		perror("Could not create KISS socket connect listening thread");
-		printf("for tcp port %d, radio chan %d\n", kps->tcp_port, kps->chan);
-		return;
-	}
-#endif
 
 	/*
 	 * These read messages from client when client_sock[n] is valid.
 	 * Currently we start up a separate thread for each potential connection.
 	 * Possible later refinement.  Start one now, others only as needed.
 	 */
-	for (client = 0; client < MAX_NET_CLIENTS; client++)
+	for (client = 0; client < kps->max_clients; client++)
 	{
 
 		kps->arg2 = client;
 
-#if __WIN32__
-		cmd_listen_th[client] = (HANDLE)_beginthreadex(NULL, 0, kissnet_listen_thread, (void *)kps, 0, NULL);
-		if (cmd_listen_th[client] == NULL)
-		{
-
-			printf("Could not create KISS command listening thread for client %d\n", client);
-			return;
-		}
-#else
-		e = pthread_create(&(cmd_listen_tid[client]), NULL, kissnet_listen_thread, (void *)kps);
-		if (e != 0)
+		cmd_listen_th = (HANDLE)_beginthreadex(NULL, 0, kissnet_listen_thread, (void *)kps, 0, NULL);
+		if (cmd_listen_th == NULL)
 		{
 
 			printf("Could not create KISS command listening thread for client %d\n", client);
-			// Replace add perror with better message handling.
-			perror("");
 			return;
 		}
-#endif
 		// Wait for new thread to get content of arg2 before reusing it for the next thread create.
 
 		int timer = 0;
@@ -386,8 +511,6 @@ static THREAD_F connect_listen_thread(void *arg)
 {
 	struct kissport_status_s *kps = arg;
 
-#if __WIN32__
-
 	struct addrinfo hints;
 	struct addrinfo *ai = NULL;
 	int err;
@@ -474,9 +597,9 @@ static THREAD_F connect_listen_thread(void *arg)
 		int c;
 
 		client = -1;
-		for (c = 0; c < MAX_NET_CLIENTS && client < 0; c++)
+		for (c = 0; c < kps->max_clients && client < 0; c++)
 		{
-			if (kps->client_sock[c] <= 0)
+			if (kps->client[c]->sock <= 0)
 			{
 				client = c;
 			}
@@ -488,7 +611,7 @@ static THREAD_F connect_listen_thread(void *arg)
 		if (client >= 0)
 		{
 
-			if (listen(listen_sock, MAX_NET_CLIENTS) == SOCKET_ERROR)
+			if (listen(listen_sock, kps->max_clients) == SOCKET_ERROR)
 			{
 
 				printf("Listen failed with error: %d\n", WSAGetLastError());
@@ -504,9 +627,9 @@ static THREAD_F connect_listen_thread(void *arg)
 				printf("Ready to accept KISS TCP client application %d on port %s (radio channel %d) ...\n", client, tcp_port_str, kps->chan);
 			}
 
-			kps->client_sock[client] = accept(listen_sock, NULL, NULL);
+			kps->client[client]->sock = accept(listen_sock, NULL, NULL);
 
-			if (kps->client_sock[client] == -1)
+			if (kps->client[client]->sock == -1)
 			{
 
 				printf("Accept failed with error: %d\n", WSAGetLastError());
@@ -525,119 +648,229 @@ static THREAD_F connect_listen_thread(void *arg)
 			}
 
 			// Reset the state and buffer.
-			memset(&(kps->kf[client]), 0, sizeof(kps->kf[client]));
+			memset(&(kps->client[client]->kf), 0, sizeof(kps->client[client]->kf));
+			kps->client[client]->gen++;
 		}
 		else
 		{
 			SLEEP_SEC(1); /* wait then check again if more clients allowed. */
 		}
 	}
+}
 
 #else /* End of Windows case, now Linux / Unix / Mac OSX. */
 
-	struct sockaddr_in sockaddr; /* Internet socket address struct */
-	socklen_t sockaddr_size = sizeof(struct sockaddr_in);
-	int listen_sock;
-	int bcopt = 1;
+/*
+ * Each socket is registered with a tag, rather than a pointer, to find
+ * the port and client.  Client -1 is the listening socket.
+ */
 
-	listen_sock = socket(AF_INET, SOCK_STREAM, 0);
-	if (listen_sock == -1)
-	{
+#define EV_TAG(index, client) ((index) * 0x10000 + (client) + 1)
+#define EV_TAG_INDEX(tag) ((tag) / 0x10000)
+#define EV_TAG_CLIENT(tag) ((tag) % 0x10000 - 1)
 
-		perror("connect_listen_thread: Socket creation failed");
-		return (NULL);
-	}
+/* Add a socket to the event queue (add = 1) or change what we are waiting for. */
+
+static int ev_ctl(int add, int fd, int tag, int want_read, int want_write)
+{
+#if __linux__
+	struct epoll_event ev;
 
-	/* Version 1.3 - as suggested by G8BPQ. */
-	/* Without this, if you kill the application then try to run it */
-	/* again quickly the port number is unavailable for a while. */
-	/* Don't try doing the same thing On Windows; It has a different meaning. */
-	/* http://stackoverflow.com/questions/14388706/socket-options-so-reuseaddr-and-so-reuseport-how-do-they-differ-do-they-mean-t */
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (want_read ? EPOLLIN : 0) | (want_write ? EPOLLOUT : 0);
+	ev.data.u32 = tag;
+	return (epoll_ctl(ev_fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev));
+#else
+	struct kevent ev[2];
+
+	EV_SET(&ev[0], fd, EVFILT_READ, EV_ADD | (want_read ? EV_ENABLE : EV_DISABLE), 0, 0, (void *)(intptr_t)tag);
+	EV_SET(&ev[1], fd, EVFILT_WRITE, EV_ADD | (want_write ? EV_ENABLE : EV_DISABLE), 0, 0, (void *)(intptr_t)tag);
+	return (kevent(ev_fd, ev, 2, NULL, 0, NULL));
+#endif
+}
 
-	setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&bcopt, 4);
+static int set_nonblock(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
 
-	sockaddr.sin_addr.s_addr = INADDR_ANY;
-	sockaddr.sin_port = htons(kps->tcp_port);
-	sockaddr.sin_family = AF_INET;
+	return (fcntl(fd, F_SETFL, flags | O_NONBLOCK));
+}
 
-#if DEBUG
+/* Seconds, for timing how long frames have been held. */
 
-	printf("Binding to port %d ... \n", kps->tcp_port);
-#endif
+static double pending_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec * 1.0e-9);
+}
+
+/* Find a free client slot, lowest first, or -1 if all are in use. */
+/* It might be one past those used so far, not allocated yet. */
 
-	if (bind(listen_sock, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+static int free_client(struct kissport_status_s *kps)
+{
+	for (int c = 0; c < kps->num_slots; c++)
 	{
+		if (kps->client[c]->sock == -1)
+		{
+			return (c);
+		}
+	}
+	return (kps->num_slots < kps->max_clients ? kps->num_slots : -1);
+}
 
-		printf("Bind failed with error: %d\n", errno);
-		printf("%s\n", strerror(errno));
-		printf("Some other application is probably already using port %d.\n", kps->tcp_port);
-		printf("Try using a different port number with KISSPORT in the configuration file.\n");
-		return (NULL);
+static void ready_to_accept(struct kissport_status_s *kps, int client)
+{
+	if (kps->chan == -1)
+	{
+		printf("Ready to accept KISS client application %d on %s ...\n", client, kps->port_desc);
 	}
+	else
+	{
+		printf("Ready to accept KISS client application %d on %s (radio channel %d) ...\n", client, kps->port_desc, kps->chan);
+	}
+}
+
+/*
+ * Open the listening socket for one KISS TCP port and add it to the
+ * event queue.  Connections are accepted by kissnet_event_thread.
+ */
 
-	getsockname(listen_sock, (struct sockaddr *)(&sockaddr), &sockaddr_size);
+static void kissnet_init_one(struct kissport_status_s *kps)
+{
+	struct sockaddr_in sockaddr; /* Internet socket address struct */
+	socklen_t sockaddr_size = sizeof(struct sockaddr_in);
+	int listen_sock;
+	int bcopt = 1;
 
 #if DEBUG
 
-	printf("opened KISS TCP socket as fd (%d) on port (%d) for stream i/o\n", listen_sock, ntohs(sockaddr.sin_port));
+	printf("kissnet_init ( tcp port %d, radio chan = %d )\n", kps->tcp_port, kps->chan);
 #endif
 
-	while (1)
+	kps->listen_sock = -1;
+
+	if (kps->tcp_port == 0 && strlen(kps->unix_path) == 0)
 	{
 
-		int client;
-		int c;
+		printf("Disabled KISS network client port.\n");
+		return;
+	}
 
-		client = -1;
-		for (c = 0; c < MAX_NET_CLIENTS && client < 0; c++)
+	if (ev_fd < 0 || ev_num_ports >= MAX_KISS_TCP_PORTS + 1)
+	{
+		return;
+	}
+
+	if (strlen(kps->unix_path) > 0)
+	{
+		struct sockaddr_un sun;
+
+		listen_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listen_sock == -1)
 		{
-			if (kps->client_sock[c] <= 0)
-			{
-				client = c;
-			}
+
+			perror("kissnet_init: Unix socket creation failed");
+			return;
 		}
 
-		if (client >= 0)
+		// Remove one left over from an earlier run.  Don't remove anything
+		// else that might happen to have the same name.
+
+		struct stat st;
+		if (stat(kps->unix_path, &st) == 0 && S_ISSOCK(st.st_mode))
 		{
+			unlink(kps->unix_path);
+		}
 
-			if (listen(listen_sock, MAX_NET_CLIENTS) == -1)
-			{
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		snprintf(sun.sun_path, sizeof(sun.sun_path), "%s", kps->unix_path);
 
-				perror("connect_listen_thread: Listen failed");
-				return (NULL);
-			}
+		if (bind(listen_sock, (struct sockaddr *)&sun, sizeof(sun)) == -1)
+		{
 
-			if (kps->chan == -1)
-			{
-				printf("Ready to accept KISS TCP client application %d on port %d ...\n", client, kps->tcp_port);
-			}
-			else
-			{
-				printf("Ready to accept KISS TCP client application %d on port %d (radio channel %d) ...\n", client, kps->tcp_port, kps->chan);
-			}
+			printf("Bind failed with error: %d\n", errno);
+			printf("%s\n", strerror(errno));
+			printf("Could not create KISS socket %s.\n", kps->unix_path);
+			close(listen_sock);
+			return;
+		}
+	}
+	else
+	{
+		listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+		if (listen_sock == -1)
+		{
 
-			kps->client_sock[client] = accept(listen_sock, (struct sockaddr *)(&sockaddr), &sockaddr_size);
+			perror("kissnet_init: Socket creation failed");
+			return;
+		}
 
-			if (kps->chan == -1)
-			{
-				printf("\nAttached to KISS TCP client application %d on port %d ...\n\n", client, kps->tcp_port);
-			}
-			else
-			{
-				printf("\nAttached to KISS TCP client application %d on port %d (radio channel %d) ...\n\n", client, kps->tcp_port, kps->chan);
-			}
+		/* Version 1.3 - as suggested by G8BPQ. */
+		/* Without this, if you kill the application then try to run it */
+		/* again quickly the port number is unavailable for a while. */
+		/* Don't try doing the same thing On Windows; It has a different meaning. */
+		/* http://stackoverflow.com/questions/14388706/socket-options-so-reuseaddr-and-so-reuseport-how-do-they-differ-do-they-mean-t */
 
-			// Reset the state and buffer.
-			memset(&(kps->kf[client]), 0, sizeof(kps->kf[client]));
-		}
-		else
+		setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&bcopt, 4);
+
+		sockaddr.sin_addr.s_addr = INADDR_ANY;
+		sockaddr.sin_port = htons(kps->tcp_port);
+		sockaddr.sin_family = AF_INET;
+
+#if DEBUG
+
+		printf("Binding to port %d ... \n", kps->tcp_port);
+#endif
+
+		if (bind(listen_sock, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
 		{
-			SLEEP_SEC(1); /* wait then check again if more clients allowed. */
+
+			printf("Bind failed with error: %d\n", errno);
+			printf("%s\n", strerror(errno));
+			printf("Some other application is probably already using port %d.\n", kps->tcp_port);
+			printf("Try using a different port number with KISSPORT in the configuration file.\n");
+			close(listen_sock);
+			return;
 		}
-	}
+
+		getsockname(listen_sock, (struct sockaddr *)(&sockaddr), &sockaddr_size);
+
+#if DEBUG
+
+		printf("opened KISS TCP socket as fd (%d) on port (%d) for stream i/o\n", listen_sock, ntohs(sockaddr.sin_port));
 #endif
+	}
+
+	if (listen(listen_sock, kps->max_clients) == -1 || set_nonblock(listen_sock) == -1)
+	{
+
+		perror("kissnet_init: Listen failed");
+		close(listen_sock);
+		return;
+	}
+
+	kps->index = ev_num_ports;
+	kps->listen_sock = listen_sock;
+
+	if (ev_ctl(1, listen_sock, EV_TAG(kps->index, -1), 1, 0) == -1)
+	{
+
+		perror("kissnet_init: Could not add listening socket to event queue");
+		close(listen_sock);
+		kps->listen_sock = -1;
+		return;
+	}
+
+	ev_ports[ev_num_ports++] = kps;
+	ready_to_accept(kps, 0);
 }
 
+#endif
+
 /*-------------------------------------------------------------------
  *
  * Name:        kissnet_send_rec_packet
@@ -682,10 +915,32 @@ static THREAD_F connect_listen_thread(void *arg)
 void kissnet_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int flen,
 							 struct kissport_status_s *onlykps, int onlyclient)
 {
-	unsigned char kiss_buff[2 * AX25_MAX_PACKET_LEN];
 	int kiss_len;
 	int err;
 
+	// The encoded frame is the same for every client except for the channel
+	// in the first byte.  Ports carrying all channels see the radio channel
+	// and single channel ports see 0.  Encode each at most once and send
+	// the same bytes to every client with that mapping.
+
+	unsigned char frame_buff[2][2 * AX25_MAX_PACKET_LEN + 4];
+	int frame_len[2] = {0, 0};
+
+	// Likewise for the text response to a client in command mode.
+
+	int text_len = -1;
+
+#if !__WIN32__
+	// Version 1.8: Usual case of a frame for everyone.  Use the table of
+	// clients for each channel rather than looking at every slot.
+
+	if (onlykps == NULL && onlyclient == -1 && flen >= 0)
+	{
+		fwd_send(chan, kiss_cmd, fbuf, flen, NULL, -1);
+		return;
+	}
+#endif
+
 	// Something received over the radio would normally be sent to all attached clients.
 	// However, there are times we want to send a response only to a particular client.
 	// In the case of a serial port or pseudo terminal, there is only one potential client.
@@ -697,14 +952,21 @@ void kissnet_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fl
 		if (onlykps == NULL || kps == onlykps)
 		{
 
-			for (int client = 0; client < MAX_NET_CLIENTS; client++)
+			int num_slots = __atomic_load_n(&kps->num_slots, __ATOMIC_ACQUIRE);
+
+			for (int client = 0; client < num_slots; client++)
 			{
 
-				if (onlyclient == -1 || client == onlyclient)
+				// onlyclient also has the generation so a reply doesn't go
+				// to a newer connection that took over the same slot.
+
+				if (onlyclient == -1 ||
+					(client == HANDLE_SLOT(onlyclient) && (kps->client[client]->gen & 0x7fff) == HANDLE_GEN(onlyclient)))
 				{
 
-					if (kps->client_sock[client] != -1)
+					if (kps->client[client]->sock != -1)
 					{
+						unsigned char *kiss_buff_p;
 
 						if (flen < 0)
 						{
@@ -713,26 +975,29 @@ void kissnet_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fl
 							// It might try sending commands over and over again trying to get the TNC into KISS mode.
 							// We recognize this attempt and send it something to keep it happy.
 
-							printf("KISS TCP: Something unexpected from client application.\n");
-							printf("Is client app treating this like an old TNC with command mode?\n");
-							printf("This can be caused by the application sending commands to put a\n");
-							printf("traditional TNC into KISS mode.  It is usually a harmless warning.\n");
-							printf("For best results, configure for a KISS-only TNC to avoid this.\n");
-							printf("In the case of APRSISCE/32, use \"Simply(KISS)\" rather than \"KISS.\"\n");
-
-							flen = strlen((char *)fbuf);
-							if (kiss_debug)
+							if (text_len < 0)
 							{
-								kiss_debug_print(TO_CLIENT, "Fake command prompt", fbuf, flen);
+								printf("KISS TCP: Something unexpected from client application.\n");
+								printf("Is client app treating this like an old TNC with command mode?\n");
+								printf("This can be caused by the application sending commands to put a\n");
+								printf("traditional TNC into KISS mode.  It is usually a harmless warning.\n");
+								printf("For best results, configure for a KISS-only TNC to avoid this.\n");
+								printf("In the case of APRSISCE/32, use \"Simply(KISS)\" rather than \"KISS.\"\n");
+
+								text_len = strlen((char *)fbuf);
+								if (kiss_debug)
+								{
+									kiss_debug_print(TO_CLIENT, "Fake command prompt", fbuf, text_len);
+								}
 							}
-							strncpy((char *)kiss_buff, (char *)fbuf, sizeof(kiss_buff));
-							kiss_len = strlen((char *)kiss_buff);
+							kiss_len = text_len;
+							kiss_buff_p = fbuf;
 						}
 						else
 						{
-							unsigned char stemp[AX25_MAX_PACKET_LEN + 1];
+							int which;
 
-							assert(flen < (int)(sizeof(stemp)));
+							assert(flen <= AX25_MAX_PACKET_LEN);
 
 							// New in 1.7.
 							// Previously all channels were sent to everyone.
@@ -742,12 +1007,17 @@ void kissnet_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fl
 							if (kps->chan == -1)
 							{
 								// Normal case, all channels.
-								stemp[0] = (chan << 4) | kiss_cmd;
+								// Version 1.8: Unless it doesn't fit in the KISS channel field.
+								if (chan >= MAX_KISS_CHANS)
+								{
+									continue;
+								}
+								which = 0;
 							}
 							else if (kps->chan == chan)
 							{
 								// Single radio channel for this port.  Application sees 0.
-								stemp[0] = (0 << 4) | kiss_cmd;
+								which = 1;
 							}
 							else
 							{
@@ -755,36 +1025,38 @@ void kissnet_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fl
 								continue;
 							}
 
-							memcpy(stemp + 1, fbuf, flen);
-
-							kiss_len = kiss_encapsulate(stemp, flen + 1, kiss_buff);
+							if (frame_len[which] == 0)
+							{
+								frame_len[which] = kiss_encapsulate_frame(((which ? 0 : chan) << 4) | kiss_cmd, fbuf, flen, frame_buff[which]);
 
-							/* This has the escapes and the surrounding FENDs. */
+								/* This has the escapes and the surrounding FENDs. */
 
-							if (kiss_debug)
-							{
-								kiss_debug_print(TO_CLIENT, NULL, kiss_buff, kiss_len);
+								if (kiss_debug)
+								{
+									kiss_debug_print(TO_CLIENT, NULL, frame_buff[which], frame_len[which]);
+								}
 							}
+
+							kiss_buff_p = frame_buff[which];
+							kiss_len = frame_len[which];
 						}
 
 #if __WIN32__
-						err = SOCK_SEND(kps->client_sock[client], (char *)kiss_buff, kiss_len);
+						err = SOCK_SEND(kps->client[client]->sock, (char *)kiss_buff_p, kiss_len);
 						if (err == SOCKET_ERROR)
 						{
 
 							printf("\nError %d sending message to KISS client application %d on port %d.  Closing connection.\n\n", WSAGetLastError(), client, kps->tcp_port);
-							closesocket(kps->client_sock[client]);
-							kps->client_sock[client] = -1;
+							closesocket(kps->client[client]->sock);
+							kps->client[client]->sock = -1;
 							WSACleanup();
 						}
 #else
-						err = SOCK_SEND(kps->client_sock[client], kiss_buff, kiss_len);
-						if (err <= 0)
+						err = client_send(kps, client, kiss_buff_p, kiss_len);
+						if (err < 0)
 						{
 
-							printf("\nError %d sending message to KISS client application %d on port %d.  Closing connection.\n\n", err, client, kps->tcp_port);
-							close(kps->client_sock[client]);
-							kps->client_sock[client] = -1;
+							printf("\nError %d sending message to KISS client application %d on %s.  Closing connection.\n\n", errno, client, kps->port_desc);
 						}
 #endif
 					} // frame length >= 0
@@ -829,69 +1101,70 @@ void kissnet_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fl
 
 void kissnet_copy(unsigned char *in_msg, int in_len, int chan, int cmd, struct kissport_status_s *from_kps, int from_client)
 {
-	unsigned char kiss_buff[2 * AX25_MAX_PACKET_LEN];
+#if __WIN32__
 	int err;
 
+	// Same as kissnet_send_rec_packet.  Encode each channel mapping at most once.
+
+	unsigned char kiss_buff[2][2 * AX25_MAX_PACKET_LEN];
+	int kiss_len[2] = {0, 0};
+
 	if (s_misc_config_p->kiss_copy)
 	{
 
 		for (struct kissport_status_s *kps = all_ports; kps != NULL; kps = kps->pnext)
 		{
 
-			for (int client = 0; client < MAX_NET_CLIENTS; client++)
+			int num_slots = __atomic_load_n(&kps->num_slots, __ATOMIC_ACQUIRE);
+
+			for (int client = 0; client < num_slots; client++)
 			{
 
-				if (!(kps == from_kps && client == from_client))
+				if (!(kps == from_kps && client == HANDLE_SLOT(from_client)))
 				{ // To all but origin.
 
-					if (kps->client_sock[client] != -1)
+					if (kps->client[client]->sock != -1)
 					{
 
-						if (kps->chan == -1 || kps->chan == chan)
+						if ((kps->chan == -1 && chan < MAX_KISS_CHANS) || kps->chan == chan)
 						{
 
 							// Two different cases here:
 							//  - The TCP port allows all channels, or
 							//  - The TCP port allows only one channel.  In this case set KISS channel to 0.
 
-							if (kps->chan == -1)
-							{
-								in_msg[0] = (chan << 4) | cmd;
-							}
-							else
-							{
-								in_msg[0] = 0 | cmd; // set channel to zero.
-							}
-
-							int kiss_len = kiss_encapsulate(in_msg, in_len, kiss_buff);
-
-							/* This has the escapes and the surrounding FENDs. */
+							int which = kps->chan == -1 ? 0 : 1;
 
-							if (kiss_debug)
+							if (kiss_len[which] == 0)
 							{
-								kiss_debug_print(TO_CLIENT, NULL, kiss_buff, kiss_len);
+								if (which == 0)
+								{
+									in_msg[0] = (chan << 4) | cmd;
+								}
+								else
+								{
+									in_msg[0] = 0 | cmd; // set channel to zero.
+								}
+
+								kiss_len[which] = kiss_encapsulate(in_msg, in_len, kiss_buff[which]);
+
+								/* This has the escapes and the surrounding FENDs. */
+
+								if (kiss_debug)
+								{
+									kiss_debug_print(TO_CLIENT, NULL, kiss_buff[which], kiss_len[which]);
+								}
 							}
 
-#if __WIN32__
-							err = SOCK_SEND(kps->client_sock[client], (char *)kiss_buff, kiss_len);
+							err = SOCK_SEND(kps->client[client]->sock, (char *)kiss_buff[which], kiss_len[which]);
 							if (err == SOCKET_ERROR)
 							{
 
 								printf("\nError %d copying message to KISS TCP port %d client %d application.  Closing connection.\n\n", WSAGetLastError(), kps->tcp_port, client);
-								closesocket(kps->client_sock[client]);
-								kps->client_sock[client] = -1;
+								closesocket(kps->client[client]->sock);
+								kps->client[client]->sock = -1;
 								WSACleanup();
 							}
-#else
-							err = SOCK_SEND(kps->client_sock[client], kiss_buff, kiss_len);
-							if (err <= 0)
-							{
-
-								printf("\nError copying message to KISS TCP port %d client %d application.  Closing connection.\n\n", kps->tcp_port, client);
-								close(kps->client_sock[client]);
-								kps->client_sock[client] = -1;
-							}
-#endif
 						} // Channel is allowed on this port.
 					}	  // socket is open
 				}		  // if origin and destination different.
@@ -899,15 +1172,26 @@ void kissnet_copy(unsigned char *in_msg, int in_len, int chan, int cmd, struct k
 		}				  // loop over all KISS TCP ports
 	}					  // Feature enabled.
 
+#else
+	// Version 1.8: Only the clients that take this channel, from the table.
+
+	if (s_misc_config_p->kiss_copy)
+	{
+		fwd_send(chan, cmd, in_msg + 1, in_len - 1, from_kps, from_client);
+	}
+#endif
+
 } /* end kissnet_copy */
 
-/*-------------------------------------------------------------------
+#if __WIN32__
+
+/*-------------------------------------------------------------------
  *
  * Name:        kissnet_listen_thread
  *
  * Purpose:     Wait for KISS messages from an application.
  *
- * Inputs:	arg		- client number, 0 .. MAX_NET_CLIENTS-1
+ * Inputs:	arg		- KISS port status block, with client slot number in arg2.
  *
  * Outputs:	client_sock[n]	- File descriptor for communicating with client app.
  *
@@ -919,21 +1203,49 @@ void kissnet_copy(unsigned char *in_msg, int in_len, int chan, int cmd, struct k
 
 /* Return one byte (value 0 - 255) */
 
+/* Each client has its own thread reading from it. */
+
+static __thread unsigned char rbuf[1024];
+static __thread int rlen = 0;
+static __thread int rpos = 0;
+
 static int kiss_get(struct kissport_status_s *kps, int client)
 {
 
 	while (1)
 	{
 
-		while (kps->client_sock[client] <= 0)
+		while (kps->client[client]->sock <= 0)
 		{
 			SLEEP_SEC(1); /* Not connected.  Try again later. */
 		}
 
-		/* Just get one byte at a time. */
+		/* Read as much as is available and hand it out one byte at a time. */
+
+		unsigned char ch = 0;
+		int n;
+
+		if (rpos < rlen)
+		{
+			ch = rbuf[rpos++];
+			n = 1;
+		}
+		else
+		{
+			// Everything from the last read has been processed.
+			// Queue up any frames it contained before waiting for more.
+
+			kiss_flush_xmit();
 
-		unsigned char ch;
-		int n = SOCK_RECV(kps->client_sock[client], (char *)(&ch), 1);
+			n = SOCK_RECV(kps->client[client]->sock, (char *)rbuf, sizeof(rbuf));
+			rpos = 0;
+			rlen = n > 0 ? n : 0;
+			if (n > 0)
+			{
+				ch = rbuf[rpos++];
+				n = 1;
+			}
+		}
 
 		if (n == 1)
 		{
@@ -962,11 +1274,11 @@ static int kiss_get(struct kissport_status_s *kps, int client)
 
 		printf("\nKISS client application %d on TCP port %d has gone away.\n\n", client, kps->tcp_port);
 #if __WIN32__
-		closesocket(kps->client_sock[client]);
+		closesocket(kps->client[client]->sock);
 #else
-		close(kps->client_sock[client]);
+		close(kps->client[client]->sock);
 #endif
-		kps->client_sock[client] = -1;
+		kps->client[client]->sock = -1;
 	}
 }
 
@@ -975,14 +1287,14 @@ static THREAD_F kissnet_listen_thread(void *arg)
 	struct kissport_status_s *kps = arg;
 
 	int client = kps->arg2;
-	assert(client >= 0 && client < MAX_NET_CLIENTS);
+	assert(client >= 0 && client < kps->max_clients);
 
 	kps->arg2 = -1; // Indicates thread is running so
 					// arg2 can be reused for the next one.
 
 #if DEBUG
 
-	printf("kissnet_listen_thread ( tcp_port = %d, client = %d, socket fd = %d )\n", kps->tcp_port, client, kps->client_sock[client]);
+	printf("kissnet_listen_thread ( tcp_port = %d, client = %d, socket fd = %d )\n", kps->tcp_port, client, kps->client[client]->sock);
 #endif
 
 	// So why is kissnet_send_rec_packet mentioned here for incoming from the client app?
@@ -999,7 +1311,7 @@ static THREAD_F kissnet_listen_thread(void *arg)
 	while (1)
 	{
 		unsigned char ch = kiss_get(kps, client);
-		kiss_rec_byte(&(kps->kf[client]), ch, kiss_debug, kps, client, kissnet_send_rec_packet);
+		kiss_rec_byte(&(kps->client[client]->kf), ch, kiss_debug, kps, CLIENT_HANDLE(client, kps->client[client]->gen), kissnet_send_rec_packet);
 	}
 
 #if __WIN32__
@@ -1010,4 +1322,748 @@ static THREAD_F kissnet_listen_thread(void *arg)
 
 } /* end kissnet_listen_thread */
 
+#else /* Linux / Unix / Mac OSX */
+
+/* Caller holds send_mutex.  The event thread will see the end of file and close it. */
+
+static void drop_client(struct kissport_status_s *kps, int client)
+{
+	if (!kps->client[client]->dead)
+	{
+		shutdown(kps->client[client]->sock, SHUT_RDWR);
+		kps->client[client]->dead = 1;
+	}
+	kps->client[client]->out_len = 0;
+}
+
+static void out_write(struct kissport_status_s *kps, int client);
+
+/* Caller holds send_mutex.  Add to the ring of bytes waiting to be sent. */
+
+static void out_append(struct kissport_status_s *kps, int client, unsigned char *buf, int len)
+{
+	int size = s_misc_config_p->kiss_out_max;
+	int tail = (kps->client[client]->out_head + kps->client[client]->out_len) % size;
+	int first = len < size - tail ? len : size - tail;
+
+	memcpy(kps->client[client]->out_buf + tail, buf, first);
+	memcpy(kps->client[client]->out_buf, buf + first, len - first);
+	kps->client[client]->out_len += len;
+
+	if (kps->client[client]->out_len > kps->client[client]->out_max_lag)
+	{
+		kps->client[client]->out_max_lag = kps->client[client]->out_len;
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        client_send, client_send_locked
+ *
+ * Purpose:     Send to one client without waiting.
+ *		client_send_locked is for a caller already holding send_mutex.
+ *
+ * Inputs:	kps, client	- Which one.
+ *		buf, len	- What to send.
+ *
+ * Returns:	0 for success.  -1 for error, with errno set.
+ *		The connection will be closed after an error.
+ *
+ * Description:	The sockets are non-blocking so a client that doesn't
+ *		keep up can't hold up the caller or the other clients.
+ *		Anything that can't be sent now is put in a ring for
+ *		that client and sent by the event thread when the socket
+ *		is writable.
+ *
+ *		While batching, the ring is written out early if the
+ *		next frame wouldn't fit.  If the ring still doesn't have
+ *		room for the whole thing, the KISSOUTPUT configuration
+ *		decides whether to drop it or disconnect the client.  A frame is never partly dropped.
+ *
+ *--------------------------------------------------------------------*/
+
+static int client_send_locked(struct kissport_status_s *kps, int client, unsigned char *buf, int len)
+{
+	int sent = 0;
+
+	int fd = kps->client[client]->sock;
+	if (fd == -1 || kps->client[client]->dead)
+	{
+		return (0);
+	}
+
+	// Keep the order.  Nothing new goes out ahead of what is waiting.
+
+	if (kps->client[client]->out_len == 0 && !batching)
+	{
+		sent = SOCK_SEND(fd, buf, len);
+		if (sent < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				int e = errno;
+				drop_client(kps, client);
+				errno = e;
+				return (-1);
+			}
+			sent = 0;
+		}
+	}
+
+	if (sent < len)
+	{
+		if (kps->client[client]->out_buf == NULL)
+		{
+			kps->client[client]->out_buf = malloc(s_misc_config_p->kiss_out_max);
+		}
+
+		// A large batch can fill the ring even when the client is keeping up.
+		// Send what is held so far, unless the socket is already known to be full.
+
+		if (batching && kps->client[client]->out_buf != NULL && !kps->client[client]->want_write &&
+			kps->client[client]->out_len + (len - sent) > s_misc_config_p->kiss_out_max)
+		{
+			out_write(kps, client);
+			if (kps->client[client]->dead)
+			{
+				return (0);
+			}
+		}
+
+		if (kps->client[client]->out_buf != NULL && kps->client[client]->out_len + (len - sent) <= s_misc_config_p->kiss_out_max)
+		{
+			out_append(kps, client, buf + sent, len - sent);
+
+			if (!kps->client[client]->want_write && !kps->client[client]->out_pending)
+			{
+				if (batching)
+				{
+					kps->client[client]->out_pending = 1;
+					if (!some_pending)
+					{
+						some_pending = 1;
+						pending_since = pending_clock();
+					}
+				}
+				else
+				{
+					ev_ctl(0, fd, EV_TAG(kps->index, client), 1, 1);
+					kps->client[client]->want_write = 1;
+				}
+			}
+		}
+		else if (sent == 0 && kps->client[client]->out_buf != NULL && s_misc_config_p->kiss_out_drop == KISSOUT_DROP)
+		{
+			if (!kps->client[client]->out_behind)
+			{
+				printf("\nKISS client application %d on %s is not keeping up.  Dropping frames for it.\n\n", client, kps->port_desc);
+				kps->client[client]->out_behind = 1;
+			}
+			kps->client[client]->out_dropped++;
+		}
+		else
+		{
+			printf("\nKISS client application %d on %s is not keeping up.  Closing connection.\n\n", client, kps->port_desc);
+			drop_client(kps, client);
+		}
+	}
+
+	return (0);
+}
+
+static int client_send(struct kissport_status_s *kps, int client, unsigned char *buf, int len)
+{
+	dw_mutex_lock(&send_mutex);
+	int err = client_send_locked(kps, client, buf, len);
+	int e = errno;
+	dw_mutex_unlock(&send_mutex);
+	errno = e;
+	return (err);
+}
+
+/*
+ * Caller holds send_mutex.  Send what has been waiting, both parts of
+ * the ring in one system call.  Ask to be told when the socket is
+ * writable if it doesn't all go.
+ */
+
+static void out_write(struct kissport_status_s *kps, int client)
+{
+	int fd = kps->client[client]->sock;
+
+	kps->client[client]->out_pending = 0;
+
+	if (fd != -1 && !kps->client[client]->dead && kps->client[client]->out_len > 0)
+	{
+		int size = s_misc_config_p->kiss_out_max;
+		int head = kps->client[client]->out_head;
+		int first = kps->client[client]->out_len < size - head ? kps->client[client]->out_len : size - head;
+		struct iovec iov[2];
+
+		iov[0].iov_base = kps->client[client]->out_buf + head;
+		iov[0].iov_len = first;
+		iov[1].iov_base = kps->client[client]->out_buf;
+		iov[1].iov_len = kps->client[client]->out_len - first;
+
+		int n = writev(fd, iov, iov[1].iov_len > 0 ? 2 : 1);
+		if (n > 0)
+		{
+			kps->client[client]->out_head = (head + n) % size;
+			kps->client[client]->out_len -= n;
+		}
+		else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			printf("\nError %d sending message to KISS client application %d on %s.  Closing connection.\n\n", errno, client, kps->port_desc);
+			drop_client(kps, client);
+		}
+	}
+	if (fd == -1)
+	{
+		return;
+	}
+
+	if (kps->client[client]->out_len == 0)
+	{
+		kps->client[client]->out_head = 0;
+		if (kps->client[client]->want_write)
+		{
+			ev_ctl(0, fd, EV_TAG(kps->index, client), 1, 0);
+			kps->client[client]->want_write = 0;
+		}
+
+		if (kps->client[client]->out_behind && !kps->client[client]->dead)
+		{
+			printf("\nKISS client application %d on %s has caught up.  %d frames dropped so far.\n\n", client, kps->port_desc, kps->client[client]->out_dropped);
+			kps->client[client]->out_behind = 0;
+		}
+	}
+	else if (!kps->client[client]->want_write && !kps->client[client]->dead)
+	{
+		ev_ctl(0, fd, EV_TAG(kps->index, client), 1, 1);
+		kps->client[client]->want_write = 1;
+	}
+}
+
+/* Socket is writable.  Send what has been waiting. */
+
+static void client_flush(struct kissport_status_s *kps, int client)
+{
+	dw_mutex_lock(&send_mutex);
+	out_write(kps, client);
+	dw_mutex_unlock(&send_mutex);
+}
+
+/* Send everything held by kissnet_batch_end. */
+
+static void flush_pending(void)
+{
+	dw_mutex_lock(&send_mutex);
+
+	if (some_pending)
+	{
+		for (struct kissport_status_s *kps = all_ports; kps != NULL; kps = kps->pnext)
+		{
+			for (int client = 0; client < kps->num_slots; client++)
+			{
+				if (kps->client[client]->out_pending)
+				{
+					out_write(kps, client);
+				}
+			}
+		}
+		some_pending = 0;
+	}
+
+	dw_mutex_unlock(&send_mutex);
+}
+
+/*
+ * Version 1.8: For each channel, the clients that get its frames.  That is
+ * clients of ports for all channels and those of ports for only that one.
+ * Rebuilt only when a client connects or goes away, so sending a frame
+ * doesn't have to look at every slot of every port.  Protected by send_mutex.
+ */
+
+struct fwd_s
+{
+	struct kissport_status_s *kps;
+	int client;
+};
+
+static struct fwd_s *fwd_list[MAX_TOTAL_CHANS];
+static int fwd_len[MAX_TOTAL_CHANS];
+static int fwd_size = 0; /* Entries allocated for each list. */
+
+/* Caller holds send_mutex. */
+
+static void fwd_rebuild(void)
+{
+	int total = 0;
+
+	for (struct kissport_status_s *kps = all_ports; kps != NULL; kps = kps->pnext)
+	{
+		total += kps->num_slots;
+	}
+
+	if (total > fwd_size)
+	{
+		for (int chan = 0; chan < MAX_TOTAL_CHANS; chan++)
+		{
+			fwd_list[chan] = realloc(fwd_list[chan], total * sizeof(struct fwd_s));
+			if (fwd_list[chan] == NULL)
+			{
+
+				printf("FATAL ERROR: Out of memory.\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		fwd_size = total;
+	}
+
+	for (int chan = 0; chan < MAX_TOTAL_CHANS; chan++)
+	{
+		fwd_len[chan] = 0;
+		for (struct kissport_status_s *kps = all_ports; kps != NULL; kps = kps->pnext)
+		{
+			if (kps->chan == -1 || kps->chan == chan)
+			{
+				for (int client = 0; client < kps->num_slots; client++)
+				{
+					if (kps->client[client]->sock != -1)
+					{
+						fwd_list[chan][fwd_len[chan]].kps = kps;
+						fwd_list[chan][fwd_len[chan]].client = client;
+						fwd_len[chan]++;
+					}
+				}
+			}
+		}
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        fwd_send
+ *
+ * Purpose:     Send a frame to every client taking this channel.
+ *
+ * Inputs:	chan, kiss_cmd	- For first byte of KISS frame.
+ *		fbuf, flen	- AX.25 frame.
+ *		from_kps, from_client - Don't send back to this one, for
+ *				  kissnet_copy.  NULL and -1 for none.
+ *
+ * Description:	As before, the frame is encoded at most once for ports with
+ *		all channels and once for single channel ports, which see 0.
+ *
+ *--------------------------------------------------------------------*/
+
+static void fwd_send(int chan, int kiss_cmd, unsigned char *fbuf, int flen, struct kissport_status_s *from_kps, int from_client)
+{
+	unsigned char kiss_buff[2][2 * AX25_MAX_PACKET_LEN + 4];
+	int kiss_len[2] = {0, 0};
+
+	if (chan < 0 || chan >= MAX_TOTAL_CHANS)
+	{
+		return;
+	}
+
+	assert(flen <= AX25_MAX_PACKET_LEN);
+
+	dw_mutex_lock(&send_mutex);
+
+	for (int i = 0; i < fwd_len[chan]; i++)
+	{
+		struct kissport_status_s *kps = fwd_list[chan][i].kps;
+		int client = fwd_list[chan][i].client;
+		int which = kps->chan == -1 ? 0 : 1;
+
+		if (kps == from_kps && client == HANDLE_SLOT(from_client))
+		{
+			continue;
+		}
+
+		if (which == 0 && chan >= MAX_KISS_CHANS)
+		{
+			continue; // Doesn't fit in the KISS channel field.
+		}
+
+		if (kiss_len[which] == 0)
+		{
+			kiss_len[which] = kiss_encapsulate_frame(((which ? 0 : chan) << 4) | kiss_cmd, fbuf, flen, kiss_buff[which]);
+
+			/* This has the escapes and the surrounding FENDs. */
+
+			if (kiss_debug)
+			{
+				kiss_debug_print(TO_CLIENT, NULL, kiss_buff[which], kiss_len[which]);
+			}
+		}
+
+		if (client_send_locked(kps, client, kiss_buff[which], kiss_len[which]) < 0)
+		{
+			printf("\nError %d sending message to KISS client application %d on %s.  Closing connection.\n\n", errno, client, kps->port_desc);
+		}
+	}
+
+	dw_mutex_unlock(&send_mutex);
+}
+
+static void client_close(struct kissport_status_s *kps, int client)
+{
+	int was_full = free_client(kps) < 0;
+
+	dw_mutex_lock(&send_mutex);
+	int fd = kps->client[client]->sock;
+	kps->client[client]->sock = -1;
+	kps->client[client]->dead = 0;
+	kps->client[client]->out_head = 0;
+	kps->client[client]->out_len = 0;
+	kps->client[client]->out_pending = 0;
+	kps->client[client]->want_write = 0;
+	fwd_rebuild();
+	dw_mutex_unlock(&send_mutex);
+
+	close(fd); // Also removes it from the event queue.
+
+	if (kps->client[client]->out_max_lag > 0)
+	{
+		printf("KISS client application %d on %s was up to %d bytes behind and had %d frames dropped.\n", client, kps->port_desc, kps->client[client]->out_max_lag, kps->client[client]->out_dropped);
+	}
+
+	if (was_full)
+	{
+		ev_ctl(0, kps->listen_sock, EV_TAG(kps->index, -1), 1, 0);
+	}
+	ready_to_accept(kps, client);
+}
+
+static void client_accept(struct kissport_status_s *kps)
+{
+	int client = free_client(kps);
+
+	if (client < 0)
+	{
+		// Leave it waiting in the backlog until someone goes away.
+		ev_ctl(0, kps->listen_sock, EV_TAG(kps->index, -1), 0, 0);
+		return;
+	}
+
+	int fd = accept(kps->listen_sock, NULL, NULL);
+	if (fd == -1)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			perror("KISS TCP accept failed");
+		}
+		return;
+	}
+
+	set_nonblock(fd);
+
+	if (client == kps->num_slots)
+	{
+		// First use of this slot.  Others look only at the first num_slots
+		// so make it complete before counting it.
+
+		kps->client[client] = client_new();
+		__atomic_store_n(&kps->num_slots, client + 1, __ATOMIC_RELEASE);
+	}
+
+	// Reset the state and buffer.
+	memset(&(kps->client[client]->kf), 0, sizeof(kps->client[client]->kf));
+	kps->client[client]->gen++;
+
+	dw_mutex_lock(&send_mutex);
+	kps->client[client]->sock = fd;
+	kps->client[client]->dead = 0;
+	kps->client[client]->out_head = 0;
+	kps->client[client]->out_len = 0;
+	kps->client[client]->out_max_lag = 0;
+	kps->client[client]->out_dropped = 0;
+	kps->client[client]->out_behind = 0;
+	kps->client[client]->out_pending = 0;
+	kps->client[client]->want_write = 0;
+	fwd_rebuild();
+	dw_mutex_unlock(&send_mutex);
+
+	if (ev_ctl(1, fd, EV_TAG(kps->index, client), 1, 0) == -1)
+	{
+		perror("KISS TCP: Could not add client to event queue");
+		client_close(kps, client);
+		return;
+	}
+
+	if (kps->chan == -1)
+	{
+		printf("\nAttached to KISS client application %d on %s ...\n\n", client, kps->port_desc);
+	}
+	else
+	{
+		printf("\nAttached to KISS client application %d on %s (radio channel %d) ...\n\n", client, kps->port_desc, kps->chan);
+	}
+
+	client = free_client(kps);
+	if (client >= 0)
+	{
+		ready_to_accept(kps, client);
+	}
+	else
+	{
+		ev_ctl(0, kps->listen_sock, EV_TAG(kps->index, -1), 0, 0);
+	}
+}
+
+static void client_read(struct kissport_status_s *kps, int client)
+{
+	unsigned char rbuf[1024];
+
+	int n = SOCK_RECV(kps->client[client]->sock, (char *)rbuf, sizeof(rbuf));
+
+	if (n > 0)
+	{
+		// So why is kissnet_send_rec_packet mentioned here for incoming from the client app?
+		// It is how kiss_rec_bytes responds to a client which thinks it is attached
+		// to a traditional TNC and tries to put it into KISS mode.
+
+		kiss_rec_bytes(&(kps->client[client]->kf), rbuf, n, kiss_debug, kps, CLIENT_HANDLE(client, kps->client[client]->gen), kissnet_send_rec_packet);
+
+		// Queue up any frames it contained.
+
+		kiss_flush_xmit();
+		return;
+	}
+
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+	{
+		return;
+	}
+
+	printf("\nKISS client application %d on %s has gone away.\n\n", client, kps->port_desc);
+	client_close(kps, client);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kissnet_event_thread
+ *
+ * Purpose:     Accept connections, read from clients, and finish
+ *		sending to slow clients, for all KISS TCP ports.
+ *
+ *--------------------------------------------------------------------*/
+
+#define EV_BATCH 16
+
+static THREAD_F kissnet_event_thread(void *arg)
+{
+	int flush_ms = s_misc_config_p->kiss_flush_ms;
+
+	while (1)
+	{
+		int tags[EV_BATCH], readable[EV_BATCH], writable[EV_BATCH];
+		int n;
+
+		// With KISSFLUSH, wake up to send frames that have been held long enough.
+
+		int timeout_ms = -1;
+		if (flush_ms > 0)
+		{
+			timeout_ms = flush_ms;
+
+			dw_mutex_lock(&send_mutex);
+			if (some_pending)
+			{
+				double held_ms = (pending_clock() - pending_since) * 1000.;
+				timeout_ms = held_ms >= flush_ms ? 0 : (int)(flush_ms - held_ms) + 1;
+			}
+			dw_mutex_unlock(&send_mutex);
+
+			if (timeout_ms == 0)
+			{
+				flush_pending();
+				timeout_ms = flush_ms;
+			}
+		}
+
+#if __linux__
+		struct epoll_event evs[EV_BATCH];
+
+		n = epoll_wait(ev_fd, evs, EV_BATCH, timeout_ms);
+		for (int i = 0; i < n; i++)
+		{
+			tags[i] = evs[i].data.u32;
+			readable[i] = (evs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0;
+			writable[i] = (evs[i].events & EPOLLOUT) != 0;
+		}
+#else
+		struct kevent evs[EV_BATCH];
+
+		struct timespec ts = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+
+		n = kevent(ev_fd, NULL, 0, evs, EV_BATCH, timeout_ms < 0 ? NULL : &ts);
+		for (int i = 0; i < n; i++)
+		{
+			tags[i] = (int)(intptr_t)evs[i].udata;
+			readable[i] = evs[i].filter == EVFILT_READ;
+			writable[i] = evs[i].filter == EVFILT_WRITE;
+		}
+#endif
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("kissnet_event_thread");
+			return (NULL);
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			struct kissport_status_s *kps = ev_ports[EV_TAG_INDEX(tags[i])];
+			int client = EV_TAG_CLIENT(tags[i]);
+
+			if (client < 0)
+			{
+				client_accept(kps);
+				continue;
+			}
+
+			// Might have been closed by an earlier event in this batch.
+
+			if (writable[i] && kps->client[client]->sock != -1)
+			{
+				client_flush(kps, client);
+			}
+			if (readable[i] && kps->client[client]->sock != -1)
+			{
+				client_read(kps, client);
+			}
+		}
+	}
+
+	return (NULL); /* Unreachable but avoids compiler warning. */
+
+} /* end kissnet_event_thread */
+
+#endif
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kissnet_batch_begin, kissnet_batch_end
+ *
+ * Purpose:     Send a burst of received frames to each client with
+ *		one system call rather than one for each frame.
+ *
+ * Description:	Version 1.8.  recv_process takes everything waiting in the
+ *		received frame queue at once.  Between these two calls,
+ *		in the same thread, frames for a client are put in its
+ *		output ring rather than sent right away.
+ *
+ *		At the end, they are sent with a single writev, unless
+ *		KISSFLUSH is set.  Then they are held until that many
+ *		milliseconds after the first was held, in case more come.
+ *		This trades latency for fewer, larger, writes.
+ *
+ *		Frames sent at other times, or by other threads, are
+ *		not held.  Not used for Windows.
+ *
+ *--------------------------------------------------------------------*/
+
+void kissnet_batch_begin(void)
+{
+#if !__WIN32__
+	batching = ev_num_ports > 0;
+#endif
+}
+
+void kissnet_batch_end(void)
+{
+#if !__WIN32__
+	if (batching)
+	{
+		batching = 0;
+		if (s_misc_config_p->kiss_flush_ms == 0)
+		{
+			flush_pending();
+		}
+	}
+#endif
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kissnet_client_stats
+ *
+ * Purpose:     Find out how well each connected client application
+ *		is keeping up.
+ *
+ * Inputs:	n	- Count of connected clients, starting with 0, over
+ *			  all ports.
+ *
+ *		port_size - Size of port.
+ *
+ * Outputs:	port	- TCP port number, or Unix socket path, as text.
+ *		client	- Client slot on that port.
+ *		out_len	- Bytes waiting to be sent now.
+ *		max_lag	- Most bytes ever waiting.
+ *		dropped	- Frames dropped because it fell behind.
+ *
+ * Returns:	1 for the nth client.  0 if there are not that many.
+ *
+ * Description:	Not for Windows, where sending just waits for a slow client.
+ *
+ *--------------------------------------------------------------------*/
+
+int kissnet_client_stats(int n, char *port, int port_size, int *client, int *out_len, int *max_lag, int *dropped)
+{
+#if __WIN32__
+	(void)n;
+	(void)port;
+	(void)port_size;
+	(void)client;
+	(void)out_len;
+	(void)max_lag;
+	(void)dropped;
+	return (0);
+#else
+	int found = 0;
+
+	dw_mutex_lock(&send_mutex);
+
+	for (int p = 0; p < ev_num_ports && !found; p++)
+	{
+		struct kissport_status_s *kps = ev_ports[p];
+		int num_slots = __atomic_load_n(&kps->num_slots, __ATOMIC_ACQUIRE);
+
+		for (int c = 0; c < num_slots && !found; c++)
+		{
+			if (kps->client[c] == NULL || kps->client[c]->sock == -1)
+			{
+				continue;
+			}
+			if (n-- > 0)
+			{
+				continue;
+			}
+
+			if (strlen(kps->unix_path) > 0)
+			{
+				snprintf(port, port_size, "%s", kps->unix_path);
+			}
+			else
+			{
+				snprintf(port, port_size, "%d", kps->tcp_port);
+			}
+			*client = c;
+			*out_len = kps->client[c]->out_len;
+			*max_lag = kps->client[c]->out_max_lag;
+			*dropped = kps->client[c]->out_dropped;
+			found = 1;
+		}
+	}
+
+	dw_mutex_unlock(&send_mutex);
+
+	return (found);
+#endif
+}
+
 /* end kissnet.c */
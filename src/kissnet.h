@@ -19,8 +19,14 @@ void kissnet_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int fl
 
 void kiss_net_set_debug(int n);
 
+void kissnet_batch_begin(void);
+
+void kissnet_batch_end(void);
+
 void kissnet_copy(unsigned char *kiss_msg, int kiss_len, int chan, int cmd, struct kissport_status_s *from_kps, int from_client);
 
+int kissnet_client_stats(int n, char *port, int port_size, int *client, int *out_len, int *max_lag, int *dropped);
+
 #endif // KISSNET_H
 
 /* end kissnet.h */
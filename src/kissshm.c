@@ -0,0 +1,248 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      kissshm.c
+ *
+ * Purpose:   	Make received frames available to applications on the
+ *		same host through a ring buffer in shared memory.
+ *
+ * Description:	Version 1.8.
+ *
+ *		Even a Unix domain socket costs a couple system calls, and
+ *		a wakeup, for each frame.  Here we write frames into a file
+ *		mapped into memory, typically under /dev/shm.  Readers map
+ *		the same file and poll for new frames at their own pace.
+ *
+ *		The layout and the rules for readers are in kissshm.h.
+ *
+ *		This is for received frames only.  Applications can use
+ *		one of the other KISS interfaces to transmit.
+ *
+ *		Configuration:
+ *
+ *			KISSSHM  path  [ bytes ]
+ *
+ *---------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if !__WIN32__
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "ax25_pad.h"
+#include "kissshm.h"
+#include "dwthread.h"
+
+static struct kissshm_header_s *shm = NULL; /* NULL if not configured. */
+static unsigned char *shm_data;
+
+/* Frames can come from more than one receive thread. */
+
+static dw_mutex_t shm_mutex;
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kissshm_init
+ *
+ * Purpose:     Create and map the shared memory file.
+ *
+ * Inputs:	mc->kiss_shm_path	- File name.  Empty if not used.
+ *		mc->kiss_shm_size	- Size of data area.  Rounded up to
+ *					  a power of 2.
+ *
+ * Description:	Any earlier file is removed rather than reused so a
+ *		reader still attached to it doesn't see positions go
+ *		backwards.  Readers should open the file again if direwolf
+ *		is restarted.
+ *
+ *		Only a regular file with our magic number is removed,
+ *		the same way KISSUNIX only removes a socket.  Anything
+ *		else with that name is left alone and this is not used.
+ *
+ *--------------------------------------------------------------------*/
+
+static int is_old_shm_file(char *path)
+{
+	struct stat st;
+	uint32_t magic = 0;
+	int fd;
+	int ok = 0;
+
+	if (lstat(path, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < KISSSHM_HEADER_SIZE)
+	{
+		return (0);
+	}
+
+	fd = open(path, O_RDONLY | O_NOFOLLOW);
+	if (fd >= 0)
+	{
+		ok = read(fd, &magic, sizeof(magic)) == sizeof(magic) && magic == KISSSHM_MAGIC;
+		close(fd);
+	}
+	return (ok);
+}
+
+void kissshm_init(struct misc_config_s *mc)
+{
+	if (strlen(mc->kiss_shm_path) == 0)
+	{
+		return;
+	}
+
+#if __WIN32__
+	printf("KISS shared memory is not available for Windows.\n");
+#else
+	uint32_t size = MIN_KISS_SHM_SIZE;
+	int fd;
+	void *p;
+
+	while (size < (uint32_t)mc->kiss_shm_size)
+	{
+		size *= 2;
+	}
+
+	if (access(mc->kiss_shm_path, F_OK) == 0 || errno != ENOENT)
+	{
+		if (!is_old_shm_file(mc->kiss_shm_path))
+		{
+			printf("Could not create KISS shared memory file %s.\n", mc->kiss_shm_path);
+			printf("Something else is already there.  It is only replaced if it came from KISSSHM.\n");
+			return;
+		}
+		unlink(mc->kiss_shm_path);
+	}
+
+	fd = open(mc->kiss_shm_path, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+	{
+		printf("Could not create KISS shared memory file %s.\n", mc->kiss_shm_path);
+		printf("%s\n", strerror(errno));
+		return;
+	}
+
+	if (ftruncate(fd, KISSSHM_HEADER_SIZE + size) != 0)
+	{
+		printf("Could not set size of KISS shared memory file %s.\n", mc->kiss_shm_path);
+		printf("%s\n", strerror(errno));
+		close(fd);
+		return;
+	}
+
+	p = mmap(NULL, KISSSHM_HEADER_SIZE + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+	{
+		printf("Could not map KISS shared memory file %s.\n", mc->kiss_shm_path);
+		printf("%s\n", strerror(errno));
+		return;
+	}
+
+	dw_mutex_init(&shm_mutex);
+
+	// A new file is all zero.  Magic goes last so a reader
+	// doesn't see a data size of 0.
+
+	shm_data = (unsigned char *)p + KISSSHM_HEADER_SIZE;
+	shm = p;
+	shm->version = KISSSHM_VERSION;
+	shm->header_size = KISSSHM_HEADER_SIZE;
+	shm->data_size = size;
+	__atomic_store_n(&shm->magic, KISSSHM_MAGIC, __ATOMIC_RELEASE);
+
+	printf("Received frames are available in KISS shared memory file %s, %u bytes.\n", mc->kiss_shm_path, size);
+#endif
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kissshm_send_rec_packet
+ *
+ * Purpose:     Put a received frame into the shared memory ring.
+ *
+ * Inputs:	chan		- Radio channel from which it was received.
+ *		kiss_cmd	- Usually KISS_CMD_DATA_FRAME.
+ *		fbuf		- Address of raw received frame buffer.
+ *		flen		- Number of bytes for AX.25 frame.
+ *				  -1 for a text string, which doesn't apply here.
+ *		notused1, notused2 - Same as other KISS transports.
+ *
+ *--------------------------------------------------------------------*/
+
+void kissshm_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int flen,
+							 struct kissport_status_s *notused1, int notused2)
+{
+	(void)notused1;
+	(void)notused2;
+
+	if (shm == NULL || flen < 0 || chan >= MAX_KISS_CHANS)
+	{
+		return;
+	}
+
+	assert(flen <= AX25_MAX_PACKET_LEN);
+
+	uint32_t len = 1 + flen;
+	uint32_t need = (4 + len + 3) & ~3;
+	uint32_t mask = shm->data_size - 1;
+
+	dw_mutex_lock(&shm_mutex);
+
+	uint64_t pos = shm->head;
+	uint32_t off = pos & mask;
+	uint64_t end;
+
+	// Don't wrap around the end.  There is always room for a length.
+
+	if (off + need > shm->data_size)
+	{
+		end = pos + (shm->data_size - off) + need;
+	}
+	else
+	{
+		end = pos + need;
+	}
+
+	__atomic_store_n(&shm->reserve, end, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	if (off + need > shm->data_size)
+	{
+		memset(shm_data + off, 0, 4);
+		off = 0;
+	}
+
+	memcpy(shm_data + off, &len, 4);
+	shm_data[off + 4] = (chan << 4) | kiss_cmd;
+	memcpy(shm_data + off + 5, fbuf, flen);
+
+	shm->frames++;
+	__atomic_store_n(&shm->head, end, __ATOMIC_RELEASE);
+
+	dw_mutex_unlock(&shm_mutex);
+}
+
+/* end kissshm.c */
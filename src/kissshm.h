@@ -0,0 +1,82 @@
+
+/*
+ * Name:	kissshm.h
+ *
+ * This is for the shared memory ring of received KISS frames.
+ *
+ * The layout is a fixed format so applications on the same host can
+ * map the file and read frames without a system call for each one.
+ * All numbers are in the byte order of the host.
+ *
+ *	Offset 0	struct kissshm_header_s, KISSSHM_HEADER_SIZE bytes.
+ *
+ *	Offset KISSSHM_HEADER_SIZE
+ *			Data area of data_size bytes, a power of 2.
+ *
+ * Positions are counts of bytes ever written so they only increase.
+ * The byte for position p is at offset (p & (data_size - 1)) in the
+ * data area.
+ *
+ * Each record starts on a multiple of 4 with a 32 bit length.
+ * That many bytes follow:
+ *
+ *	* KISS type byte.  Radio channel in upper nybble, command in lower.
+ *	* The AX.25 frame, without FCS.  No FEND or escapes are needed here.
+ *
+ * The next record is at the following multiple of 4.  A record never
+ * wraps around the end of the data area.  A length of 0 means skip to
+ * the beginning.
+ *
+ * There is one writer, direwolf.  Each reader keeps its own position
+ * and never writes to the shared memory so there can be any number of
+ * them.  The writer doesn't wait for anyone.  A reader that falls more
+ * than data_size behind loses frames.
+ *
+ * Writer:	(1) Store the end of the new record in reserve.
+ *		(2) Write the record.
+ *		(3) Store the end of the new record in head (release).
+ *
+ * Reader:	(1) Start with pos = head to see only new frames.
+ *		(2) Load head (acquire).  If pos == head, nothing new.
+ *		    Poll again later.
+ *		(3) Copy the record at pos.
+ *		(4) Load reserve (after an acquire fence).  If
+ *		    reserve - pos > data_size, the copy might have been
+ *		    overwritten.  Discard it and set pos = head.
+ *		(5) Advance pos past the record and repeat from (2).
+ */
+
+#ifndef KISSSHM_H
+#define KISSSHM_H 1
+
+#include <stdint.h>
+
+#include "config.h"
+
+#include "kiss_frame.h" // for struct kissport_status_s
+
+#define KISSSHM_MAGIC 0x4b535744 /* "DWSK" in memory on little endian. */
+#define KISSSHM_VERSION 1
+
+#define KISSSHM_HEADER_SIZE 64
+
+struct kissshm_header_s
+{
+	uint32_t magic;		/* KISSSHM_MAGIC once ready for use. */
+	uint32_t version;	/* KISSSHM_VERSION */
+	uint32_t header_size; /* KISSSHM_HEADER_SIZE */
+	uint32_t data_size; /* Size of data area.  Power of 2. */
+
+	uint64_t head;	  /* Position after last complete record. */
+	uint64_t reserve; /* Position after record being written. */
+	uint64_t frames;  /* Number of records written. */
+};
+
+void kissshm_init(struct misc_config_s *misc_config);
+
+void kissshm_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int flen,
+							 struct kissport_status_s *notused1, int notused2);
+
+#endif
+
+/* end kissshm.h */
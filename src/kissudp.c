@@ -0,0 +1,391 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      kissudp.c
+ *
+ * Purpose:   	Send received frames to other applications as KISS over UDP.
+ *
+ * Description:	Version 1.8.
+ *
+ *		KISS over TCP needs a connection, and an output buffer, for
+ *		each client application.  When there are many consumers of the
+ *		same received frames, e.g. several monitoring or logging
+ *		programs, it is much cheaper to send each frame once as a
+ *		UDP datagram to a multicast group (or broadcast or unicast
+ *		address) and let anyone interested listen.
+ *
+ *		Each datagram holds exactly one KISS frame, complete with the
+ *		FEND at each end, so it can be fed to the usual KISS parser.
+ *
+ *		Optionally, we also listen on a UDP port for KISS frames
+ *		to transmit.  Each datagram is taken as one frame.  The
+ *		trailing FEND may be omitted.
+ *
+ *		There is no flow control or delivery guarantee, which is
+ *		the point.  A slow consumer can't hold up anyone else.
+ *
+ *		Configuration:
+ *
+ *			KISSUDP  address  port  [ chan ]
+ *			KISSUDPRX  port
+ *
+ *		The optional channel works like it does for KISSPORT.
+ *		Only that radio channel is sent and it appears as KISS
+ *		channel 0.  Frames received on the KISSUDPRX port are
+ *		then transmitted on that radio channel.
+ *
+ *---------------------------------------------------------------*/
+
+#if __WIN32__
+#include <winsock2.h>
+#include <windows.h>
+#include <ws2tcpip.h> // _WIN32_WINNT must be set to 0x0501 before including this
+#else
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <errno.h>
+#endif
+
+#include <unistd.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "ax25_pad.h"
+#include "kissudp.h"
+#include "kiss_frame.h"
+#include "dwsock.h"
+#include "dwthread.h"
+
+#if __WIN32__
+#define THREAD_F unsigned __stdcall
+#else
+#define THREAD_F void *
+#endif
+
+static THREAD_F kissudp_listen_thread(void *arg);
+
+static int kissudp_debug = 0; /* Print information flowing from and to client. */
+
+static int send_sock = -1; /* For sending received frames.  -1 if not configured. */
+
+static struct sockaddr_storage dest_addr; /* Where they go. */
+static int dest_addr_len;
+
+static int send_chan = -1; /* Radio channel sent, or -1 for all. */
+
+/*
+ * Only the channel is used.  This makes kiss_process_msg transmit
+ * on the configured radio channel regardless of the KISS channel.
+ * It is not one of the TCP ports so kissnet_copy sends to all of those.
+ */
+
+static struct kissport_status_s rx_kps;
+
+void kissudp_set_debug(int n)
+{
+	kissudp_debug = n;
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kissudp_init
+ *
+ * Purpose:     Set up the UDP KISS output and optional input.
+ *
+ * Inputs:	mc->kiss_udp_addr	- Destination host name, IPv4 or IPv6 address.
+ *					  May be multicast or broadcast.
+ *		mc->kiss_udp_port	- Destination UDP port.  0 if not used.
+ *		mc->kiss_udp_chan	- Radio channel or -1 for all.
+ *		mc->kiss_udp_rx_port	- UDP port to listen for frames to transmit.
+ *					  0 if not used.
+ *
+ * Description:	For multicast, the TTL is set to 1 so the frames don't leave
+ *		the local network segment unless someone goes out of their
+ *		way to route them.
+ *
+ *--------------------------------------------------------------------*/
+
+void kissudp_init(struct misc_config_s *mc)
+{
+	send_chan = mc->kiss_udp_chan;
+
+	memset(&rx_kps, 0, sizeof(rx_kps));
+	rx_kps.chan = mc->kiss_udp_chan;
+
+	if (mc->kiss_udp_port == 0 && mc->kiss_udp_rx_port == 0)
+	{
+		return;
+	}
+
+	if (dwsock_init() < 0)
+	{
+		printf("KISS UDP: Could not initialize sockets.\n");
+		return;
+	}
+
+	if (mc->kiss_udp_port != 0)
+	{
+		struct addrinfo hints;
+		struct addrinfo *ai_head = NULL;
+		char sport[12];
+		int one = 1;
+		int err;
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+		hints.ai_protocol = IPPROTO_UDP;
+		snprintf(sport, sizeof(sport), "%d", mc->kiss_udp_port);
+
+		err = getaddrinfo(mc->kiss_udp_addr, sport, &hints, &ai_head);
+		if (err != 0 || ai_head == NULL)
+		{
+			printf("KISS UDP: Can't get address for %s, err=%d.\n", mc->kiss_udp_addr, err);
+		}
+		else
+		{
+			send_sock = socket(ai_head->ai_family, SOCK_DGRAM, IPPROTO_UDP);
+			if (send_sock < 0)
+			{
+				printf("KISS UDP: Can't create socket for %s.\n", mc->kiss_udp_addr);
+				send_sock = -1;
+			}
+			else
+			{
+				memcpy(&dest_addr, ai_head->ai_addr, ai_head->ai_addrlen);
+				dest_addr_len = ai_head->ai_addrlen;
+
+				// Harmless if not a broadcast address.
+
+				setsockopt(send_sock, SOL_SOCKET, SO_BROADCAST, (char *)&one, sizeof(one));
+
+				if (ai_head->ai_family == AF_INET &&
+					IN_MULTICAST(ntohl(((struct sockaddr_in *)ai_head->ai_addr)->sin_addr.s_addr)))
+				{
+					unsigned char ttl = 1;
+					setsockopt(send_sock, IPPROTO_IP, IP_MULTICAST_TTL, (char *)&ttl, sizeof(ttl));
+				}
+				else if (ai_head->ai_family == AF_INET6 &&
+						 IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *)ai_head->ai_addr)->sin6_addr))
+				{
+					int hops = 1;
+					setsockopt(send_sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, (char *)&hops, sizeof(hops));
+				}
+
+				printf("Sending received frames as KISS over UDP to %s port %d.\n", mc->kiss_udp_addr, mc->kiss_udp_port);
+			}
+			freeaddrinfo(ai_head);
+		}
+	}
+
+	if (mc->kiss_udp_rx_port != 0)
+	{
+		struct sockaddr_in6 sin6;
+		int rx_sock;
+		int zero = 0;
+
+		// Dual stack so IPv4 senders work too.
+
+		rx_sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+		if (rx_sock < 0)
+		{
+			printf("KISS UDP: Can't create socket for port %d.\n", mc->kiss_udp_rx_port);
+			return;
+		}
+		setsockopt(rx_sock, IPPROTO_IPV6, IPV6_V6ONLY, (char *)&zero, sizeof(zero));
+
+		memset(&sin6, 0, sizeof(sin6));
+		sin6.sin6_family = AF_INET6;
+		sin6.sin6_addr = in6addr_any;
+		sin6.sin6_port = htons(mc->kiss_udp_rx_port);
+
+		if (bind(rx_sock, (struct sockaddr *)&sin6, sizeof(sin6)) != 0)
+		{
+			printf("KISS UDP: Can't bind to port %d.\n", mc->kiss_udp_rx_port);
+			printf("Some other application is probably already using port %d.\n", mc->kiss_udp_rx_port);
+#if __WIN32__
+			closesocket(rx_sock);
+#else
+			close(rx_sock);
+#endif
+			return;
+		}
+
+#if __WIN32__
+		HANDLE listen_th = (HANDLE)_beginthreadex(NULL, 0, kissudp_listen_thread, (void *)(ptrdiff_t)rx_sock, 0, NULL);
+		if (listen_th == NULL)
+		{
+			printf("KISS UDP: Could not create listening thread.\n");
+			return;
+		}
+#else
+		pthread_t listen_tid;
+		int e = pthread_create(&listen_tid, NULL, kissudp_listen_thread, (void *)(ptrdiff_t)rx_sock);
+		if (e != 0)
+		{
+			perror("Could not create KISS UDP listening thread");
+			return;
+		}
+#endif
+		printf("Ready to accept KISS frames to transmit on UDP port %d.\n", mc->kiss_udp_rx_port);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kissudp_send_rec_packet
+ *
+ * Purpose:     Send a received packet or text string as one UDP datagram.
+ *
+ * Inputs:	chan		- Radio channel from which it was received.
+ *		kiss_cmd	- Usually KISS_CMD_DATA_FRAME but we can also have
+ *				  KISS_CMD_SET_HARDWARE when responding to a query.
+ *		fbuf		- Address of raw received frame buffer or a text string.
+ *		flen		- Number of bytes for AX.25 frame.
+ *				  -1 for a text string, which is ignored here.
+ *				  Nothing is going to put us into command mode over UDP.
+ *		notused1, notused2 - Same as other KISS transports.
+ *
+ *--------------------------------------------------------------------*/
+
+void kissudp_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int flen,
+							 struct kissport_status_s *notused1, int notused2)
+{
+	unsigned char kiss_buff[2 * AX25_MAX_PACKET_LEN + 4];
+	int kiss_len;
+
+	(void)notused1;
+	(void)notused2;
+
+	if (send_sock == -1 || flen < 0)
+	{
+		return;
+	}
+
+	if (send_chan != -1)
+	{
+		if (chan != send_chan)
+		{
+			return;
+		}
+		chan = 0; // Single radio channel.  Application sees 0.
+	}
+	else if (chan >= MAX_KISS_CHANS)
+	{
+		return; // Doesn't fit in the KISS channel field.
+	}
+
+	assert(flen <= AX25_MAX_PACKET_LEN);
+
+	kiss_len = kiss_encapsulate_frame((chan << 4) | kiss_cmd, fbuf, flen, kiss_buff);
+
+	if (kissudp_debug)
+	{
+		kiss_debug_print(TO_CLIENT, NULL, kiss_buff, kiss_len);
+	}
+
+	if (sendto(send_sock, (char *)kiss_buff, kiss_len, 0, (struct sockaddr *)&dest_addr, dest_addr_len) != kiss_len)
+	{
+		// Don't flood the screen if the network is down.
+		static int errors = 0;
+		if (errors++ % 100 == 0)
+		{
+			printf("KISS UDP: Error sending datagram.\n");
+		}
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        kissudp_listen_thread
+ *
+ * Purpose:     Wait for KISS frames to transmit.
+ *
+ * Inputs:	arg		- Bound UDP socket.
+ *
+ * Description:	Each datagram is one frame.  Start with a clean parser
+ *		state so a damaged datagram can't corrupt the next one.
+ *
+ *		An error other than an interruption is reported once,
+ *		until a datagram gets thru, and we wait a second before
+ *		trying again rather than spinning.
+ *
+ *--------------------------------------------------------------------*/
+
+static THREAD_F kissudp_listen_thread(void *arg)
+{
+	int rx_sock = (int)(ptrdiff_t)arg;
+	unsigned char buf[2 * AX25_MAX_PACKET_LEN + 8];
+	kiss_frame_t kf;
+	int n;
+	int reported = 0;
+
+	while (1)
+	{
+		n = recvfrom(rx_sock, (char *)buf, sizeof(buf) - 1, 0, NULL, NULL);
+		if (n < 0)
+		{
+#if __WIN32__
+			int err = WSAGetLastError();
+			if (err == WSAEINTR || err == WSAEWOULDBLOCK)
+#else
+			int err = errno;
+			if (err == EINTR || err == EAGAIN || err == EWOULDBLOCK)
+#endif
+			{
+				continue;
+			}
+			if (!reported)
+			{
+				printf("KISS UDP: Error %d receiving.  Trying again every second.\n", err);
+				reported = 1;
+			}
+			SLEEP_SEC(1);
+			continue;
+		}
+		reported = 0;
+		if (n == 0)
+		{
+			continue; // Empty datagram.
+		}
+
+		if (buf[n - 1] != FEND)
+		{
+			buf[n++] = FEND;
+		}
+
+		memset(&kf, 0, sizeof(kf));
+		kiss_rec_bytes(&kf, buf, n, kissudp_debug, &rx_kps, -1, kissudp_send_rec_packet);
+		kiss_flush_xmit();
+	}
+
+#if __WIN32__
+	return (0);
+#else
+	return (NULL);
+#endif
+}
+
+/* end kissudp.c */
@@ -0,0 +1,21 @@
+
+/*
+ * Name:	kissudp.h
+ *
+ * This is for sending KISS frames as UDP datagrams.
+ */
+
+#include "ax25_pad.h" /* for packet_t */
+
+#include "config.h"
+
+#include "kiss_frame.h" // for struct kissport_status_s
+
+void kissudp_init(struct misc_config_s *misc_config);
+
+void kissudp_send_rec_packet(int chan, int kiss_cmd, unsigned char *fbuf, int flen,
+							 struct kissport_status_s *notused1, int notused2);
+
+void kissudp_set_debug(int n);
+
+/* end kissudp.h */
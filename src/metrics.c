@@ -0,0 +1,346 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      metrics.c
+ *
+ * Purpose:   	Count what the decoders are doing so it can be watched
+ *		from a monitoring system.
+ *
+ * Description:	Version 1.8.
+ *
+ *		The audio statistics only print sample rates and levels.
+ *		Here we count, for each radio channel:
+ *
+ *			- Good frames from each demodulator and slicer.
+ *			- Which of those was picked when there were duplicates.
+ *			- How much fixing (FIX_BITS) the picked frames needed.
+ *			- FX.25 blocks decoded, bytes corrected, and failures.
+ *			- Time spent in each demodulator, including its
+ *			  HDLC decoding, and how many frames were picked
+ *			  that no other demodulator or slicer got.
+ *
+ *		Those last two are the cost and benefit of each one so
+ *		the less useful ones can be dropped from the configuration.
+ *		metrics_print_demod shows them as a table.  atest -C too.
+ *
+ *		These are updated for every frame by the demodulator, fix up,
+ *		and FX.25 threads.  Rather than a lock, each channel has its
+ *		own cache line aligned block of counters, which are updated
+ *		with relaxed atomic operations.  Nearly all updates for a
+ *		channel come from the thread for its audio device, so the
+ *		cache lines don't bounce between processors.
+ *
+ *		The counters only go up.  They are read, along with the
+ *		queue, KISS client, and audio device statistics kept by
+ *		other modules, by metrics_server.c.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if __WIN32__
+#include <windows.h>
+#endif
+
+#include "metrics.h"
+
+/* Aligned, so the size is also rounded up, to keep each channel in its own cache lines. */
+
+static struct chan_slot_s
+{
+	struct metrics_chan_s m;
+} __attribute__((aligned(64))) slots[MAX_CHANS];
+
+#define M(chan) (&slots[chan].m)
+
+static inline void bump(uint64_t *p, uint64_t n)
+{
+	__atomic_fetch_add(p, n, __ATOMIC_RELAXED);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_decoded
+ *
+ * Purpose:     Count a good frame from a demodulator and slicer.
+ *
+ * Description:	Called for every frame with a good FCS, or fixed up,
+ *		before duplicates are removed.
+ *
+ *--------------------------------------------------------------------*/
+
+void metrics_decoded(int chan, int subchan, int slice)
+{
+	if (chan < 0 || chan >= MAX_CHANS || subchan < 0 || subchan >= MAX_SUBCHANS || slice < 0 || slice >= MAX_SLICERS)
+	{
+		return;
+	}
+	bump(&M(chan)->decoded[subchan][slice], 1);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_picked
+ *
+ * Purpose:     Count a frame passed along to the received frame queue.
+ *
+ * Inputs:	chan, subchan, slice - Where the winning copy came from.
+ *
+ *		retries	- Level of fixing for plain AX.25.
+ *			  For FX.25 and IL2P this is something else and
+ *			  is not counted.
+ *
+ *		fec	- Nonzero for FX.25 or IL2P.
+ *
+ *--------------------------------------------------------------------*/
+
+void metrics_picked(int chan, int subchan, int slice, retry_t retries, int fec)
+{
+	if (chan < 0 || chan >= MAX_CHANS || subchan < 0 || subchan >= MAX_SUBCHANS || slice < 0 || slice >= MAX_SLICERS)
+	{
+		return;
+	}
+	bump(&M(chan)->picked[subchan][slice], 1);
+
+	if (!fec && (int)retries >= 0 && retries < RETRY_MAX)
+	{
+		bump(&M(chan)->retries[retries], 1);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_fx25
+ *
+ * Purpose:     Count an FX.25 block.
+ *
+ * Inputs:	corrected - Number of bytes fixed by Reed-Solomon decoding,
+ *			    or -1 if there were too many errors.
+ *
+ *--------------------------------------------------------------------*/
+
+void metrics_fx25(int chan, int corrected)
+{
+	if (chan < 0 || chan >= MAX_CHANS)
+	{
+		return;
+	}
+	if (corrected >= 0)
+	{
+		bump(&M(chan)->fx25_frames, 1);
+		bump(&M(chan)->fx25_corrected, corrected);
+	}
+	else
+	{
+		bump(&M(chan)->fx25_failed, 1);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_unique
+ *
+ * Purpose:     Count a picked frame which only some candidates had.
+ *
+ * Inputs:	chan, subchan, slice - The one picked.
+ *
+ *		only_slice	- No other demodulator or slicer had it.
+ *
+ *		only_subchan	- Only slicers of this demodulator had it.
+ *
+ * Description:	Without these, the frame would have been lost.  So this is
+ *		what each one adds beyond the others.
+ *
+ *--------------------------------------------------------------------*/
+
+void metrics_unique(int chan, int subchan, int slice, int only_slice, int only_subchan)
+{
+	if (chan < 0 || chan >= MAX_CHANS || subchan < 0 || subchan >= MAX_SUBCHANS || slice < 0 || slice >= MAX_SLICERS)
+	{
+		return;
+	}
+	if (only_slice)
+	{
+		bump(&M(chan)->unique_slice[subchan][slice], 1);
+	}
+	if (only_subchan)
+	{
+		bump(&M(chan)->unique_subchan[subchan], 1);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_clock_ns
+ *
+ * Purpose:     Monotonic clock in nanoseconds, for timing the demodulators.
+ *
+ * Description:	This is elapsed time, not CPU time for the thread, which
+ *		would need a system call each time.  It's the same unless
+ *		the thread is preempted, which is rare for the demodulators.
+ *
+ *--------------------------------------------------------------------*/
+
+int64_t metrics_clock_ns(void)
+{
+#if __WIN32__
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if (freq.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&now);
+	return ((int64_t)(now.QuadPart / freq.QuadPart) * 1000000000 +
+			(int64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_demod_time
+ *
+ * Purpose:     Add time spent in a demodulator.
+ *
+ *--------------------------------------------------------------------*/
+
+void metrics_demod_time(int chan, int subchan, int64_t ns)
+{
+	if (chan < 0 || chan >= MAX_CHANS || subchan < 0 || subchan >= MAX_SUBCHANS || ns < 0)
+	{
+		return;
+	}
+	bump(&M(chan)->demod_ns[subchan], (uint64_t)ns);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_get
+ *
+ * Purpose:     Copy the counters for a channel.
+ *
+ * Description:	Each counter is read atomically but not the set as a whole.
+ *		That is fine for monitoring.
+ *
+ *--------------------------------------------------------------------*/
+
+void metrics_get(int chan, struct metrics_chan_s *out)
+{
+	const uint64_t *src;
+	uint64_t *dst = (uint64_t *)out;
+
+	memset(out, 0, sizeof(*out));
+	if (chan < 0 || chan >= MAX_CHANS)
+	{
+		return;
+	}
+
+	src = (const uint64_t *)M(chan);
+	for (size_t n = 0; n < sizeof(*out) / sizeof(uint64_t); n++)
+	{
+		dst[n] = __atomic_load_n(&src[n], __ATOMIC_RELAXED);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_print_demod
+ *
+ * Purpose:     Print the cost and benefit of each demodulator and slicer.
+ *
+ * Inputs:	pa	- For number of demodulators and slicers.
+ *		chan	- Radio channel.
+ *
+ * Description:	For each demodulator:
+ *
+ *			- Seconds of time and percent of the channel total.
+ *			- Frames decoded, including duplicates.
+ *			- Frames picked as the best copy.
+ *			- Frames no other demodulator got.
+ *
+ *		Then the same counts for each slicer if there are several.
+ *		The unique counts there are for frames no other slicer,
+ *		of any demodulator, got.
+ *
+ *		A demodulator costing a lot of time for few unique frames
+ *		is a good one to drop.
+ *
+ *--------------------------------------------------------------------*/
+
+void metrics_print_demod(struct audio_s *pa, int chan)
+{
+	static struct metrics_chan_s m; /* Too big for the stack of some threads. */
+	uint64_t total_ns = 0;
+	int num_subchan = pa->achan[chan].num_subchan;
+	int num_slicers = pa->achan[chan].num_slicers;
+	int j, k;
+
+	if (num_subchan > MAX_SUBCHANS)
+		num_subchan = MAX_SUBCHANS;
+	if (num_slicers > MAX_SLICERS)
+		num_slicers = MAX_SLICERS;
+
+	metrics_get(chan, &m);
+	for (j = 0; j < num_subchan; j++)
+	{
+		total_ns += m.demod_ns[j];
+	}
+
+	printf("\nChannel %d demodulator cost and benefit:\n\n", chan);
+	printf("subchan  seconds   time%%   decoded    picked    unique\n");
+	for (j = 0; j < num_subchan; j++)
+	{
+		uint64_t decoded = 0, picked = 0;
+
+		for (k = 0; k < num_slicers; k++)
+		{
+			decoded += m.decoded[j][k];
+			picked += m.picked[j][k];
+		}
+		printf("%5d  %9.3f  %6.1f  %8llu  %8llu  %8llu\n", j, m.demod_ns[j] / 1e9,
+			   total_ns > 0 ? 100. * m.demod_ns[j] / total_ns : 0.,
+			   (unsigned long long)decoded, (unsigned long long)picked, (unsigned long long)m.unique_subchan[j]);
+	}
+
+	if (num_slicers > 1)
+	{
+		printf("\nsubchan.slice      decoded    picked    unique\n");
+		for (j = 0; j < num_subchan; j++)
+		{
+			for (k = 0; k < num_slicers; k++)
+			{
+				printf("%5d.%-5d     %8llu  %8llu  %8llu\n", j, k,
+					   (unsigned long long)m.decoded[j][k], (unsigned long long)m.picked[j][k],
+					   (unsigned long long)m.unique_slice[j][k]);
+			}
+		}
+	}
+}
+
+/* end metrics.c */
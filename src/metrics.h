@@ -0,0 +1,55 @@
+
+/*------------------------------------------------------------------
+ *
+ * Module:      metrics.h
+ *
+ * Purpose:   	Counters for monitoring, and an HTTP endpoint to read
+ *		them along with other statistics.  See metrics.c and
+ *		metrics_server.c.
+ *
+ *---------------------------------------------------------------*/
+
+#ifndef METRICS_H
+#define METRICS_H 1
+
+#include <stdint.h>
+
+#include "audio.h"	/* for retry_t */
+#include "config.h" /* for struct misc_config_s */
+
+/* Counters for one radio channel. */
+
+struct metrics_chan_s
+{
+	uint64_t decoded[MAX_SUBCHANS][MAX_SLICERS];	  /* Good frames from each demodulator and slicer. */
+	uint64_t picked[MAX_SUBCHANS][MAX_SLICERS];		  /* Those chosen as the best of the duplicates. */
+	uint64_t retries[RETRY_MAX];					  /* Frames picked, by level of fixing needed. */
+	uint64_t fx25_frames;							  /* FX.25 blocks decoded. */
+	uint64_t fx25_corrected;						  /* Bytes fixed by Reed-Solomon. */
+	uint64_t fx25_failed;							  /* Blocks with too many errors. */
+	uint64_t demod_ns[MAX_SUBCHANS];				  /* Version 1.8: Time in each demodulator, with HDLC decoding. */
+	uint64_t unique_slice[MAX_SUBCHANS][MAX_SLICERS]; /* Picked frames no other slicer had. */
+	uint64_t unique_subchan[MAX_SUBCHANS];			  /* Picked frames no other demodulator had. */
+};
+
+void metrics_decoded(int chan, int subchan, int slice);
+
+void metrics_picked(int chan, int subchan, int slice, retry_t retries, int fec);
+
+void metrics_fx25(int chan, int corrected);
+
+void metrics_unique(int chan, int subchan, int slice, int only_slice, int only_subchan);
+
+int64_t metrics_clock_ns(void);
+
+void metrics_demod_time(int chan, int subchan, int64_t ns);
+
+void metrics_get(int chan, struct metrics_chan_s *out);
+
+void metrics_print_demod(struct audio_s *pa, int chan);
+
+void metrics_server_init(struct audio_s *pa, struct misc_config_s *mc);
+
+#endif
+
+/* end metrics.h */
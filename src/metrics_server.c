@@ -0,0 +1,736 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      metrics_server.c
+ *
+ * Purpose:   	Make the counters available to a monitoring system,
+ *		such as Prometheus, over HTTP.
+ *
+ * Description:	Version 1.8.
+ *
+ *		A request for /metrics gets a plain text page in the
+ *		Prometheus exposition format with:
+ *
+ *			- Frames decoded by each demodulator and slicer,
+ *			  and which ones were picked.  (metrics.c)
+ *			- Frames only one demodulator or slicer got, and
+ *			  time spent in each demodulator.
+ *			- Frames picked by level of FIX_BITS needed.
+ *			- FX.25 blocks, bytes corrected, and failures.
+ *			- Received frame queue depth and drops.
+ *			- Transmit queue depth, drops, and rejects.
+ *			- Fix up thread queue and receive buffer pool.
+ *			- Bytes waiting for each KISS TCP client and drops.
+ *			- Audio device overruns and underruns.
+ *			- Receive latency, if RXLATENCY is on.
+ *			- Transmit latency, for each stage of sending.
+ *			- Waiting for each lock, if LOCKSTATS is on.
+ *
+ *		Everything is read from counters the other modules keep
+ *		anyhow so nothing here slows down receiving.  Requests are
+ *		answered one at a time by one thread.  A scrape every few
+ *		seconds is nothing.
+ *
+ *		Configuration:
+ *
+ *			METRICSPORT  port
+ *
+ *		Not available for Windows.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#if !__WIN32__
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stddef.h>
+
+#define METRICS_SERVER_C 1
+
+#include "metrics.h"
+#include "audio.h"
+#include "hdlc_rec2.h" /* for retry_text */
+#include "multi_modem.h"
+#include "dlq.h"
+#include "tq.h"
+#include "rrbb.h"
+#include "kissnet.h"
+#include "kiss.h"
+#include "rxlat.h"
+#include "rxdedupe.h"
+#include "dwthread.h"
+#include "ptt.h"
+#include "xmit.h"
+
+static struct audio_s *save_audio_config_p;
+
+#if !__WIN32__
+
+static void *metrics_server_thread(void *arg);
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_server_init
+ *
+ * Purpose:     Start listening for HTTP requests.
+ *
+ * Inputs:	pa		- Audio and channel configuration.
+ *		mc->metrics_port - TCP port.  0 if not used.
+ *
+ *--------------------------------------------------------------------*/
+
+void metrics_server_init(struct audio_s *pa, struct misc_config_s *mc)
+{
+	save_audio_config_p = pa;
+
+	if (mc->metrics_port == 0)
+	{
+		return;
+	}
+
+	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock == -1)
+	{
+		perror("metrics_server_init: Socket creation failed");
+		return;
+	}
+
+	int bcopt = 1;
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&bcopt, 4);
+
+	struct sockaddr_in sockaddr;
+	memset(&sockaddr, 0, sizeof(sockaddr));
+	sockaddr.sin_addr.s_addr = INADDR_ANY;
+	sockaddr.sin_port = htons(mc->metrics_port);
+	sockaddr.sin_family = AF_INET;
+
+	if (bind(sock, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1 || listen(sock, 4) == -1)
+	{
+		printf("Could not listen for metrics requests on port %d.\n", mc->metrics_port);
+		printf("%s\n", strerror(errno));
+		close(sock);
+		return;
+	}
+
+	pthread_t tid;
+	int e = pthread_create(&tid, NULL, metrics_server_thread, (void *)(ptrdiff_t)sock);
+	if (e != 0)
+	{
+		perror("Could not create metrics server thread");
+		close(sock);
+		return;
+	}
+
+	printf("Metrics are available at http://localhost:%d/metrics\n", mc->metrics_port);
+}
+
+/*
+ * Page being built.  It grows as needed.
+ */
+
+struct page_s
+{
+	char *text;
+	int len;
+	int size;
+};
+
+static void add(struct page_s *pg, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void add(struct page_s *pg, const char *fmt, ...)
+{
+	va_list args;
+	int n;
+
+	while (1)
+	{
+		va_start(args, fmt);
+		n = vsnprintf(pg->text + pg->len, pg->size - pg->len, fmt, args);
+		va_end(args);
+
+		if (n < pg->size - pg->len)
+		{
+			pg->len += n;
+			return;
+		}
+
+		pg->size = pg->size * 2 + n;
+		pg->text = realloc(pg->text, pg->size);
+		if (pg->text == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/* HELP and TYPE lines before each metric. */
+
+static void family(struct page_s *pg, const char *name, const char *type, const char *help)
+{
+	add(pg, "# HELP direwolf_%s %s\n# TYPE direwolf_%s %s\n", name, help, name, type);
+}
+
+/* Stage names for rxlat, as labels. */
+
+static const char *stage_label[RXLAT_NUM] = {"decode", "hold", "accept", "queue", "kiss", "total"};
+
+/* Stage names for xmit_latency_stats. */
+
+static const char *tx_stage_label[XMIT_LAT_NUM] = {"start_to_ptt", "ptt_to_audio", "audio", "drain", "audio_to_unkey"};
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        build_page
+ *
+ * Purpose:     Gather all the statistics into text for Prometheus.
+ *
+ *--------------------------------------------------------------------*/
+
+static void build_page(struct page_s *pg)
+{
+	struct audio_s *pa = save_audio_config_p;
+	static struct metrics_chan_s m[MAX_CHANS]; /* Only this thread. */
+	int chan, j, k;
+
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] == MEDIUM_RADIO)
+		{
+			metrics_get(chan, &m[chan]);
+		}
+	}
+
+	family(pg, "frames_decoded_total", "counter", "Good frames from each demodulator and slicer, including duplicates.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		for (j = 0; j < pa->achan[chan].num_subchan && j < MAX_SUBCHANS; j++)
+		{
+			for (k = 0; k < pa->achan[chan].num_slicers && k < MAX_SLICERS; k++)
+			{
+				add(pg, "direwolf_frames_decoded_total{chan=\"%d\",subchan=\"%d\",slice=\"%d\"} %llu\n",
+					chan, j, k, (unsigned long long)m[chan].decoded[j][k]);
+			}
+		}
+	}
+
+	family(pg, "frames_picked_total", "counter", "Frames passed along, by the demodulator and slicer with the best copy.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		for (j = 0; j < pa->achan[chan].num_subchan && j < MAX_SUBCHANS; j++)
+		{
+			for (k = 0; k < pa->achan[chan].num_slicers && k < MAX_SLICERS; k++)
+			{
+				add(pg, "direwolf_frames_picked_total{chan=\"%d\",subchan=\"%d\",slice=\"%d\"} %llu\n",
+					chan, j, k, (unsigned long long)m[chan].picked[j][k]);
+			}
+		}
+	}
+
+	family(pg, "frames_unique_total", "counter", "Frames passed along which no other demodulator or slicer got.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		for (j = 0; j < pa->achan[chan].num_subchan && j < MAX_SUBCHANS; j++)
+		{
+			for (k = 0; k < pa->achan[chan].num_slicers && k < MAX_SLICERS; k++)
+			{
+				add(pg, "direwolf_frames_unique_total{chan=\"%d\",subchan=\"%d\",slice=\"%d\"} %llu\n",
+					chan, j, k, (unsigned long long)m[chan].unique_slice[j][k]);
+			}
+		}
+	}
+
+	family(pg, "frames_unique_subchan_total", "counter", "Frames passed along which no other demodulator got.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		for (j = 0; j < pa->achan[chan].num_subchan && j < MAX_SUBCHANS; j++)
+		{
+			add(pg, "direwolf_frames_unique_subchan_total{chan=\"%d\",subchan=\"%d\"} %llu\n",
+				chan, j, (unsigned long long)m[chan].unique_subchan[j]);
+		}
+	}
+
+	family(pg, "demod_active", "gauge", "1 for each demodulator and slicer running, 0 when turned off by RXPRUNE.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		for (j = 0; j < pa->achan[chan].num_subchan && j < MAX_SUBCHANS; j++)
+		{
+			unsigned int active = multi_modem_active_slicers(chan, j);
+
+			for (k = 0; k < pa->achan[chan].num_slicers && k < MAX_SLICERS; k++)
+			{
+				add(pg, "direwolf_demod_active{chan=\"%d\",subchan=\"%d\",slice=\"%d\"} %d\n",
+					chan, j, k, (active >> k) & 1);
+			}
+		}
+	}
+
+	family(pg, "demod_seconds_total", "counter", "Time spent in each demodulator, including its HDLC decoding.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		for (j = 0; j < pa->achan[chan].num_subchan && j < MAX_SUBCHANS; j++)
+		{
+			add(pg, "direwolf_demod_seconds_total{chan=\"%d\",subchan=\"%d\"} %.6f\n",
+				chan, j, m[chan].demod_ns[j] / 1e9);
+		}
+	}
+
+	family(pg, "frames_retry_total", "counter", "Plain AX.25 frames passed along, by FIX_BITS level needed.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		for (k = 0; k < RETRY_MAX; k++)
+		{
+			add(pg, "direwolf_frames_retry_total{chan=\"%d\",retry=\"%s\"} %llu\n",
+				chan, retry_text[k], (unsigned long long)m[chan].retries[k]);
+		}
+	}
+
+	family(pg, "fx25_frames_total", "counter", "FX.25 blocks decoded.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] == MEDIUM_RADIO)
+			add(pg, "direwolf_fx25_frames_total{chan=\"%d\"} %llu\n", chan, (unsigned long long)m[chan].fx25_frames);
+	}
+	family(pg, "fx25_bytes_corrected_total", "counter", "Bytes fixed by FX.25 Reed-Solomon decoding.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] == MEDIUM_RADIO)
+			add(pg, "direwolf_fx25_bytes_corrected_total{chan=\"%d\"} %llu\n", chan, (unsigned long long)m[chan].fx25_corrected);
+	}
+	family(pg, "fx25_failed_total", "counter", "FX.25 blocks with too many errors to fix.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] == MEDIUM_RADIO)
+			add(pg, "direwolf_fx25_failed_total{chan=\"%d\"} %llu\n", chan, (unsigned long long)m[chan].fx25_failed);
+	}
+
+	/* Received frame queue. */
+
+	int frames, bytes, dropped, rejected;
+
+	dlq_queue_stats(&frames, &bytes);
+	dlq_drop_stats(&dropped);
+	family(pg, "rx_queue_frames", "gauge", "Items waiting in the received frame queue.");
+	add(pg, "direwolf_rx_queue_frames %d\n", frames);
+	family(pg, "rx_queue_bytes", "gauge", "Frame bytes waiting in the received frame queue.");
+	add(pg, "direwolf_rx_queue_bytes %d\n", bytes);
+	family(pg, "rx_queue_dropped_total", "counter", "Received frames discarded because the queue was full.");
+	add(pg, "direwolf_rx_queue_dropped_total %d\n", dropped);
+
+	/* Version 1.8: Copies already heard on another channel. */
+
+	family(pg, "rx_dedupe_dropped_total", "counter", "Received frames dropped because another channel heard them first.  See RXDEDUPE.");
+	for (chan = 0; chan < MAX_TOTAL_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] == MEDIUM_NONE)
+			continue;
+		rxdedupe_stats(chan, &dropped);
+		add(pg, "direwolf_rx_dedupe_dropped_total{chan=\"%d\"} %d\n", chan, dropped);
+	}
+	rxdedupe_evicted_stats(&dropped);
+	family(pg, "rx_dedupe_evicted_total", "counter", "Frames forgotten early because RXDEDUPE had no more room.");
+	add(pg, "direwolf_rx_dedupe_evicted_total %d\n", dropped);
+
+	/* Transmit queues. */
+
+	family(pg, "tx_queue_frames", "gauge", "Frames waiting to be transmitted.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		add(pg, "direwolf_tx_queue_frames{chan=\"%d\",prio=\"hi\"} %d\n", chan, tq_count(chan, TQ_PRIO_0_HI, "", "", 0));
+		add(pg, "direwolf_tx_queue_frames{chan=\"%d\",prio=\"lo\"} %d\n", chan, tq_count(chan, TQ_PRIO_1_LO, "", "", 0));
+	}
+	family(pg, "tx_queue_dropped_total", "counter", "Frames dropped from a full transmit queue.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		tq_drop_stats(chan, &dropped, &rejected);
+		add(pg, "direwolf_tx_queue_dropped_total{chan=\"%d\"} %d\n", chan, dropped);
+	}
+	family(pg, "tx_queue_rejected_total", "counter", "Frames refused because the transmit queue was full.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		tq_drop_stats(chan, &dropped, &rejected);
+		add(pg, "direwolf_tx_queue_rejected_total{chan=\"%d\"} %d\n", chan, rejected);
+	}
+
+	/* Keeping up with decoding. */
+
+	int queued, late, size, in_use, high_water, exhausted;
+
+	hdlc_rec2_fix_stats(&queued, &dropped);
+	family(pg, "fix_queued_total", "counter", "Frames with bad FCS handed over to the fix up threads.");
+	add(pg, "direwolf_fix_queued_total %d\n", queued);
+	family(pg, "fix_dropped_total", "counter", "Frames not fixed up because the fix up queue was full.");
+	add(pg, "direwolf_fix_dropped_total %d\n", dropped);
+
+	multi_modem_fix_stats(&dropped, &late);
+	family(pg, "fix_late_total", "counter", "Fixed frames which came back after the best candidate was picked.");
+	add(pg, "direwolf_fix_late_total %d\n", late);
+
+	rrbb_pool_stats(&size, &in_use, &high_water, &exhausted);
+	family(pg, "rrbb_pool_in_use", "gauge", "Receive bit buffers in use.");
+	add(pg, "direwolf_rrbb_pool_in_use %d\n", in_use);
+	family(pg, "rrbb_pool_size", "gauge", "Receive bit buffers in the pool.");
+	add(pg, "direwolf_rrbb_pool_size %d\n", size);
+	family(pg, "rrbb_pool_exhausted_total", "counter", "Times the receive bit buffer pool was empty.");
+	add(pg, "direwolf_rrbb_pool_exhausted_total %d\n", exhausted);
+
+	/* KISS clients, TCP and the pseudo terminal. */
+
+	char port[120];
+	int client, out_len, max_lag;
+
+	family(pg, "kiss_client_lag_bytes", "gauge", "Bytes waiting to be sent to a slow KISS client.");
+	for (k = 0; kissnet_client_stats(k, port, sizeof(port), &client, &out_len, &max_lag, &dropped); k++)
+	{
+		add(pg, "direwolf_kiss_client_lag_bytes{port=\"%s\",client=\"%d\"} %d\n", port, client, out_len);
+	}
+	if (kisspt_stats(&out_len, &max_lag, &dropped))
+	{
+		add(pg, "direwolf_kiss_client_lag_bytes{port=\"pty\",client=\"0\"} %d\n", out_len);
+	}
+	family(pg, "kiss_client_max_lag_bytes", "gauge", "Most bytes ever waiting for a KISS client.");
+	for (k = 0; kissnet_client_stats(k, port, sizeof(port), &client, &out_len, &max_lag, &dropped); k++)
+	{
+		add(pg, "direwolf_kiss_client_max_lag_bytes{port=\"%s\",client=\"%d\"} %d\n", port, client, max_lag);
+	}
+	if (kisspt_stats(&out_len, &max_lag, &dropped))
+	{
+		add(pg, "direwolf_kiss_client_max_lag_bytes{port=\"pty\",client=\"0\"} %d\n", max_lag);
+	}
+	family(pg, "kiss_client_dropped_total", "counter", "Frames dropped because a KISS client fell behind.");
+	for (k = 0; kissnet_client_stats(k, port, sizeof(port), &client, &out_len, &max_lag, &dropped); k++)
+	{
+		add(pg, "direwolf_kiss_client_dropped_total{port=\"%s\",client=\"%d\"} %d\n", port, client, dropped);
+	}
+	if (kisspt_stats(&out_len, &max_lag, &dropped))
+	{
+		add(pg, "direwolf_kiss_client_dropped_total{port=\"pty\",client=\"0\"} %d\n", dropped);
+	}
+
+	/* Audio devices. */
+
+	int a, in, out;
+
+	family(pg, "audio_overruns_total", "counter", "Audio input overruns.  We didn't keep up.");
+	for (a = 0; a < MAX_ADEVS; a++)
+	{
+		if (pa->adev[a].defined)
+		{
+			audio_xrun_stats(a, &in, &out);
+			add(pg, "direwolf_audio_overruns_total{adev=\"%d\"} %d\n", a, in);
+		}
+	}
+	family(pg, "audio_underruns_total", "counter", "Audio output underruns.");
+	for (a = 0; a < MAX_ADEVS; a++)
+	{
+		if (pa->adev[a].defined)
+		{
+			audio_xrun_stats(a, &in, &out);
+			add(pg, "direwolf_audio_underruns_total{adev=\"%d\"} %d\n", a, out);
+		}
+	}
+
+	/* Time to change PTT, DCD, etc. */
+
+	static const char *octype_name[NUM_OCTYPES] = {"ptt", "dcd", "con"};
+	int ot, count;
+	int64_t total_us, max_us;
+
+	family(pg, "ptt_set_total", "counter", "Changes of each output control line.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		for (ot = 0; ot < NUM_OCTYPES; ot++)
+		{
+			if (pa->chan_medium[chan] == MEDIUM_RADIO && pa->achan[chan].octrl[ot].ptt_method != PTT_METHOD_NONE)
+			{
+				ptt_set_stats(ot, chan, &count, &total_us, &max_us);
+				add(pg, "direwolf_ptt_set_total{chan=\"%d\",line=\"%s\"} %d\n", chan, octype_name[ot], count);
+			}
+		}
+	}
+	family(pg, "ptt_set_seconds_total", "counter", "Time spent changing each output control line.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		for (ot = 0; ot < NUM_OCTYPES; ot++)
+		{
+			if (pa->chan_medium[chan] == MEDIUM_RADIO && pa->achan[chan].octrl[ot].ptt_method != PTT_METHOD_NONE)
+			{
+				ptt_set_stats(ot, chan, &count, &total_us, &max_us);
+				add(pg, "direwolf_ptt_set_seconds_total{chan=\"%d\",line=\"%s\"} %.6f\n", chan, octype_name[ot], total_us / 1e6);
+			}
+		}
+	}
+	family(pg, "ptt_set_max_seconds", "gauge", "Longest time to change each output control line.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		for (ot = 0; ot < NUM_OCTYPES; ot++)
+		{
+			if (pa->chan_medium[chan] == MEDIUM_RADIO && pa->achan[chan].octrl[ot].ptt_method != PTT_METHOD_NONE)
+			{
+				ptt_set_stats(ot, chan, &count, &total_us, &max_us);
+				add(pg, "direwolf_ptt_set_max_seconds{chan=\"%d\",line=\"%s\"} %.6f\n", chan, octype_name[ot], max_us / 1e6);
+			}
+		}
+	}
+
+	/* Receive latency.  Buckets for every factor of 4 from 128 microseconds. */
+
+	if (pa->rx_latency)
+	{
+		static uint64_t hist[RXLAT_BUCKETS];
+		uint64_t count, sum, max;
+
+		family(pg, "rx_latency_seconds", "histogram", "Time for each stage of receiving a frame.  See RXLATENCY.");
+		for (int s = 0; s < RXLAT_NUM; s++)
+		{
+			uint64_t below = 0;
+			int64_t le = 128;
+
+			rxlat_stats(s, hist, &count, &sum, &max);
+			for (int n = 0; n < RXLAT_BUCKETS; n++)
+			{
+				if (rxlat_bucket_low(n) == le)
+				{
+					add(pg, "direwolf_rx_latency_seconds_bucket{stage=\"%s\",le=\"%.9g\"} %llu\n",
+						stage_label[s], le / 1e6, (unsigned long long)below);
+					le *= 4;
+				}
+				below += hist[n];
+			}
+			add(pg, "direwolf_rx_latency_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", stage_label[s], (unsigned long long)count);
+			add(pg, "direwolf_rx_latency_seconds_sum{stage=\"%s\"} %.6f\n", stage_label[s], sum / 1e6);
+			add(pg, "direwolf_rx_latency_seconds_count{stage=\"%s\"} %llu\n", stage_label[s], (unsigned long long)count);
+		}
+	}
+
+	/* Transmit latency.  Buckets for every power of 2 milliseconds. */
+
+	family(pg, "tx_latency_seconds", "histogram", "Time for each stage of sending a transmission.");
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (pa->chan_medium[chan] != MEDIUM_RADIO)
+			continue;
+		for (int s = 0; s < XMIT_LAT_NUM; s++)
+		{
+			int hist[XMIT_LAT_BUCKETS];
+			int count, max_ms;
+			int64_t sum_us;
+			long below = 0;
+
+			xmit_latency_stats(chan, s, hist, &count, &sum_us, &max_ms);
+			for (int n = 0; n < XMIT_LAT_BUCKETS - 1; n++)
+			{
+				below += hist[n];
+				add(pg, "direwolf_tx_latency_seconds_bucket{chan=\"%d\",stage=\"%s\",le=\"%.9g\"} %ld\n",
+					chan, tx_stage_label[s], (1 << n) / 1e3, below);
+			}
+			add(pg, "direwolf_tx_latency_seconds_bucket{chan=\"%d\",stage=\"%s\",le=\"+Inf\"} %d\n", chan, tx_stage_label[s], count);
+			add(pg, "direwolf_tx_latency_seconds_sum{chan=\"%d\",stage=\"%s\"} %.6f\n", chan, tx_stage_label[s], sum_us / 1e6);
+			add(pg, "direwolf_tx_latency_seconds_count{chan=\"%d\",stage=\"%s\"} %d\n", chan, tx_stage_label[s], count);
+		}
+	}
+
+	/* Locks.  Named by source file and variable.  See dwthread.c. */
+
+	if (pa->lock_stats)
+	{
+		struct dw_lock_stats_s ls;
+
+		family(pg, "lock_acquired_total", "counter", "Times each lock was taken.  See LOCKSTATS.");
+		for (k = 0; dw_lock_stats_get(k, &ls); k++)
+		{
+			add(pg, "direwolf_lock_acquired_total{lock=\"%s\"} %llu\n", ls.name, (unsigned long long)ls.count);
+		}
+		family(pg, "lock_contended_total", "counter", "Times another thread had the lock so we waited.");
+		for (k = 0; dw_lock_stats_get(k, &ls); k++)
+		{
+			add(pg, "direwolf_lock_contended_total{lock=\"%s\"} %llu\n", ls.name, (unsigned long long)ls.contended);
+		}
+		family(pg, "lock_wait_seconds_total", "counter", "Time spent waiting for each lock.");
+		for (k = 0; dw_lock_stats_get(k, &ls); k++)
+		{
+			add(pg, "direwolf_lock_wait_seconds_total{lock=\"%s\"} %.9f\n", ls.name, ls.wait_ns / 1e9);
+		}
+		family(pg, "lock_max_wait_seconds", "gauge", "Longest wait for each lock.");
+		for (k = 0; dw_lock_stats_get(k, &ls); k++)
+		{
+			add(pg, "direwolf_lock_max_wait_seconds{lock=\"%s\"} %.9f\n", ls.name, ls.max_wait_ns / 1e9);
+		}
+	}
+}
+
+/* Send all of it or give up. */
+
+static void send_all(int sock, const char *buf, int len)
+{
+	while (len > 0)
+	{
+		int n = send(sock, buf, len, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			if (n < 0 && errno == EINTR)
+				continue;
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        metrics_server_thread
+ *
+ * Purpose:     Answer HTTP requests, one at a time.
+ *
+ * Description:	Only the request line matters.  Anything but GET of
+ *		/metrics gets "404 Not Found".  The connection is closed
+ *		after each response.
+ *
+ *		A client which connects and then doesn't say anything
+ *		is given up on after a couple seconds.
+ *
+ *--------------------------------------------------------------------*/
+
+static void *metrics_server_thread(void *arg)
+{
+	int listen_sock = (int)(ptrdiff_t)arg;
+	struct page_s pg = {NULL, 0, 0};
+	char req[1024];
+
+	pg.size = 16384;
+	pg.text = malloc(pg.size);
+	if (pg.text == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	while (1)
+	{
+		int sock = accept(listen_sock, NULL, NULL);
+		if (sock == -1)
+		{
+			if (errno != EINTR)
+			{
+				perror("Metrics accept failed");
+				SLEEP_SEC(1);
+			}
+			continue;
+		}
+
+		struct timeval tv = {2, 0};
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+		/* Read until the end of the headers, or at least the request line. */
+
+		int len = 0;
+		while (len < (int)sizeof(req) - 1)
+		{
+			int n = recv(sock, req + len, sizeof(req) - 1 - len, 0);
+			if (n <= 0)
+				break;
+			len += n;
+			req[len] = '\0';
+			if (strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL)
+				break;
+		}
+		req[len] = '\0';
+
+		char head[200];
+		if (strncmp(req, "GET /metrics ", 13) == 0 || strncmp(req, "GET /metrics\r", 13) == 0)
+		{
+			pg.len = 0;
+			pg.text[0] = '\0';
+			build_page(&pg);
+
+			int hlen = snprintf(head, sizeof(head),
+								"HTTP/1.0 200 OK\r\n"
+								"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+								"Content-Length: %d\r\n"
+								"Connection: close\r\n\r\n",
+								pg.len);
+			send_all(sock, head, hlen);
+			send_all(sock, pg.text, pg.len);
+		}
+		else if (len > 0)
+		{
+			static const char not_found[] = "Try /metrics\n";
+			int hlen = snprintf(head, sizeof(head),
+								"HTTP/1.0 404 Not Found\r\n"
+								"Content-Type: text/plain\r\n"
+								"Content-Length: %d\r\n"
+								"Connection: close\r\n\r\n",
+								(int)strlen(not_found));
+			send_all(sock, head, hlen);
+			send_all(sock, not_found, strlen(not_found));
+		}
+
+		close(sock);
+	}
+
+	return (0);
+}
+
+#else /* __WIN32__ */
+
+void metrics_server_init(struct audio_s *pa, struct misc_config_s *mc)
+{
+	save_audio_config_p = pa;
+
+	if (mc->metrics_port != 0)
+	{
+		printf("METRICSPORT is not available for Windows.\n");
+	}
+}
+
+#endif
+
+/* end metrics_server.c */
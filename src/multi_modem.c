@@ -91,7 +91,9 @@
 #include <assert.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <stddef.h>
 
+#include "dwthread.h"
 #include "ax25_pad.h"
 #include "multi_modem.h"
 #include "demod.h"
@@ -100,14 +102,19 @@
 #include "dlq.h"
 #include "fx25.h"
 #include "version.h"
+#include "rxlat.h"
+#include "metrics.h"
+#include "rxgate.h"
 
 // Properties of the radio channels.
 
 static struct audio_s *save_audio_config_p;
 
 // Candidates for further processing.
+// Version 1.8: [num_subchan][MAX_SLICERS] for each radio channel,
+// allocated in multi_modem_init.
 
-static struct
+static struct candidate_s
 {
 	packet_t packet_p;
 	alevel_t alevel;
@@ -118,10 +125,10 @@ static struct
 						 // It would be 0 to something around 4.
 						 // For FX.25, it is the number of corrected.
 						 // This could be from 0 thru 32.
-	int age;
+	unsigned int when; // sample_time when it arrived.
 	unsigned int crc;
 	int score;
-} candidate[MAX_CHANS][MAX_SUBCHANS][MAX_SLICERS];
+} (*candidate[MAX_CHANS])[MAX_SLICERS];
 
 // #define PROCESS_AFTER_BITS 2		// version 1.4.  Was a little short for skew of PSK with different modem types, optional pre-filter
 
@@ -129,8 +136,173 @@ static struct
 
 static int process_age[MAX_CHANS];
 
+/*
+ * Version 1.8: Rather than aging every candidate on every sample, keep
+ * the sample_time when the oldest becomes due, process_age samples after
+ * it arrived.  Bit 32 is set when there is one.  Candidates can be added
+ * from more than one DEMODTHREADS group at once so it is only ever
+ * moved earlier with compare & swap there.
+ */
+
+static uint64_t pick_due[MAX_CHANS];
+
+static int pick_due_stale[MAX_CHANS]; // Picked from elsewhere, deadline could be too early.
+
+/*
+ * Candidates held back because they could be part of an FX.25 block still
+ * being received or decoded.  fx_hold_since is the earliest tag time.
+ */
+
+static int fx_hold[MAX_CHANS];
+static unsigned int fx_hold_since[MAX_CHANS];
+
+#define PICK_DUE_SET ((uint64_t)1 << 32)
+
+static void set_pick_due(int chan, unsigned int due);
+
+static void update_pick_due(int chan);
+
+static void check_pick_due(int chan);
+
 static void pick_best_candidate(int chan);
 
+static void pick_oldest_candidates(int chan);
+
+/*
+ * Frames from the fix up threads in hdlc_rec2.c.  See FIXTHREADS.
+ *
+ * They wait here until the thread processing the channel's audio takes
+ * them, so only that thread ever touches the candidates.  Picking the
+ * best candidate waits for blocks handed over before then, up to
+ * fix_wait_age samples.
+ *
+ * A result can still be late, and be put in with the next frame's
+ * candidates.  sample_time, the number of samples processed, keeps them
+ * apart.  Candidates more than group_span apart are not the same frame.
+ */
+
+#define FIXED_QUEUE_SIZE 32
+
+static struct fixed_queue_s
+{
+	dw_mutex_t mutex;
+	int count;
+	struct
+	{
+		packet_t pp;
+		int subchan;
+		int slice;
+		alevel_t alevel;
+		retry_t retries;
+		fec_type_t fec_type;
+		unsigned int sample_time;
+	} item[FIXED_QUEUE_SIZE];
+} fixed_queue[MAX_CHANS];
+
+static int fixed_dropped = 0;
+static int fixed_late[MAX_CHANS];
+
+static unsigned int sample_time[MAX_CHANS];
+
+static int fix_wait_age[MAX_CHANS];
+
+static int group_span[MAX_CHANS];
+
+static int fix_waiting[MAX_CHANS];
+static unsigned int fix_wait_ticket[MAX_CHANS];
+static unsigned int fix_decided_time[MAX_CHANS]; /* Fixed frames from before this are too late. */
+
+static int ready_to_pick(int chan, int age);
+
+static int taking_fixed[MAX_CHANS]; /* Set while take_fixed_frames adds them. */
+
+static void take_fixed_frames(int chan);
+
+/*
+ * A new frame for a slicer whose previous one is still waiting for the
+ * fix up threads.  The demodulator, maybe in a DEMODTHREADS group,
+ * puts it here and sets pick_now.  The thread processing the channel's
+ * audio picks what is waiting, then moves it to the candidates, after
+ * all the groups are done with the piece.  See take_held_frames.
+ */
+
+static struct candidate_s (*held[MAX_CHANS])[MAX_SLICERS];
+
+static int pick_now[MAX_CHANS];
+
+static void take_held_frames(int chan);
+
+/*
+ * Optional helper threads so the demodulators of one channel run in parallel.
+ * See DEMODTHREADS in the configuration file.
+ *
+ * The thread calling multi_modem_process_block runs group 0 itself and waits
+ * for the other groups to finish each piece before looking at the candidates.
+ * Each group only fills in candidates for its own subchannels, and the
+ * aging and picking happen while the helpers are idle, so the candidate
+ * table is never used by two threads at once.
+ */
+
+static struct mm_group_s
+{
+	int num_groups;					 // 1 means no helpers.
+	int first_subchan[MAX_SUBCHANS + 1]; // Group g is first_subchan[g] thru first_subchan[g+1]-1.
+
+	const int16_t *samples; // Current piece for the helpers.
+	int len;
+
+#if __WIN32__
+	HANDLE start_event[MAX_SUBCHANS];
+	HANDLE done_event[MAX_SUBCHANS];
+#else
+	unsigned int seq;		  // Bumped for each new piece.
+	int pending;			  // Helpers not finished with it yet.
+	int helpers_sleeping;	  // The mutex and conditions are only used
+	int coordinator_sleeping; // when one side has to wait a while.
+	dw_mutex_t mutex;
+	pthread_cond_t start_cond;
+	pthread_cond_t done_cond;
+#endif
+} group[MAX_CHANS];
+
+/*
+ * A piece is only a millisecond or so of audio.  Going to sleep and waking up
+ * for each would cost about as much as the demodulating so spin briefly first.
+ */
+
+#define GROUP_SPIN 2000
+
+#if !__WIN32__
+static int group_spin; // GROUP_SPIN, or 0 with a single CPU where it would only get in the way.
+#endif
+
+static void group_init(int chan);
+
+/*
+ * Version 1.8: RXPRUNE.  Demodulators and slicers which don't get frames
+ * the others miss are turned off to save time.  See prune_count.
+ * Only the thread processing the channel's audio changes this.
+ */
+
+static struct mm_prune_s
+{
+	int frames;	 // Picked so far this round.
+	int rounds;	 // Since everything was last turned on.
+	int probing; // Everything is on for this round.
+
+	unsigned int active[MAX_SUBCHANS]; // Bit mask of slicers running.  0 for demodulator off.
+	unsigned int keep[MAX_SUBCHANS];   // What was running before the probe.
+	unsigned int shown[MAX_SUBCHANS];  // Copy of active for multi_modem_active_slicers.
+
+	int decoded[MAX_SUBCHANS][MAX_SLICERS];		 // Got the picked frame, this round.
+	int unique_slice[MAX_SUBCHANS][MAX_SLICERS]; // Nothing else got it.
+	int unique_subchan[MAX_SUBCHANS];			 // No other demodulator got it.
+} *prune[MAX_CHANS];
+
+static void prune_init(int chan);
+
+static void prune_count(int chan, int best_n, int only_slice, int only_subchan);
+
 /*------------------------------------------------------------------------------
  *
  * Name:	multi_modem_init
@@ -156,10 +328,9 @@ void multi_modem_init(struct audio_s *pa)
 
 	save_audio_config_p = pa;
 
-	memset(candidate, 0, sizeof(candidate));
-
 	demod_init(save_audio_config_p);
 	hdlc_rec_init(save_audio_config_p);
+	rxgate_init(save_audio_config_p);
 
 	for (chan = 0; chan < MAX_CHANS; chan++)
 	{
@@ -174,11 +345,230 @@ void multi_modem_init(struct audio_s *pa)
 			int real_baud = save_audio_config_p->achan[chan].baud;
 
 			process_age[chan] = PROCESS_AFTER_BITS * save_audio_config_p->adev[ACHAN2ADEV(chan)].samples_per_sec / real_baud;
+			fix_wait_age[chan] = save_audio_config_p->adev[ACHAN2ADEV(chan)].samples_per_sec;
+			group_span[chan] = 2 * process_age[chan] + DEMOD_BLOCK_MAX;
+
+			candidate[chan] = calloc(save_audio_config_p->achan[chan].num_subchan, sizeof(*candidate[chan]));
+			held[chan] = calloc(save_audio_config_p->achan[chan].num_subchan, sizeof(*held[chan]));
+			if (candidate[chan] == NULL || held[chan] == NULL)
+			{
+				printf("FATAL ERROR: Out of memory.\n");
+				exit(EXIT_FAILURE);
+			}
+			dw_mutex_init(&fixed_queue[chan].mutex);
 			// crc_queue_of_last_to_app[chan] = NULL;
+
+			group_init(chan);
+			prune_init(chan);
 		}
 	}
 }
 
+/*------------------------------------------------------------------------------
+ *
+ * Name:	group_init
+ *
+ * Purpose:	Start helper threads for the subchannel groups of a channel.
+ *
+ * Inputs:	chan	- Radio channel number
+ *
+ * Description:	The grouping comes from demod_subchan_group so it agrees
+ *		with the prefilter sharing in demod.c.
+ *
+ *------------------------------------------------------------------------------*/
+
+/* Version 1.8: Time each demodulator, with its HDLC decoding, for metrics_print_demod. */
+
+static inline void demod_block_timed(int chan, int d, const int16_t *samples, int len)
+{
+	int64_t start = metrics_clock_ns();
+
+	demod_process_block(chan, d, samples, len);
+	metrics_demod_time(chan, d, metrics_clock_ns() - start);
+}
+
+static void run_group(int chan, int g, const int16_t *samples, int len)
+{
+	struct mm_group_s *G = &group[chan];
+	int d;
+
+	for (d = G->first_subchan[g]; d < G->first_subchan[g + 1]; d++)
+	{
+		demod_block_timed(chan, d, samples, len);
+	}
+}
+
+#if __WIN32__
+static unsigned __stdcall group_thread(void *arg)
+#else
+static void *group_thread(void *arg)
+#endif
+{
+	int chan = (int)(ptrdiff_t)arg / MAX_SUBCHANS;
+	int g = (int)(ptrdiff_t)arg % MAX_SUBCHANS;
+	struct mm_group_s *G = &group[chan];
+
+	dw_thread_sched(THREAD_DEMOD, chan);
+
+#if __WIN32__
+	while (1)
+	{
+		WaitForSingleObject(G->start_event[g], INFINITE);
+		run_group(chan, g, G->samples, G->len);
+		SetEvent(G->done_event[g]);
+	}
+	return (0);
+#else
+	unsigned int seq = 0;
+
+	while (1)
+	{
+		int spin;
+
+		for (spin = 0; spin < group_spin && __atomic_load_n(&G->seq, __ATOMIC_SEQ_CST) == seq; spin++)
+			;
+
+		if (__atomic_load_n(&G->seq, __ATOMIC_SEQ_CST) == seq)
+		{
+			dw_mutex_lock(&G->mutex);
+			__atomic_add_fetch(&G->helpers_sleeping, 1, __ATOMIC_SEQ_CST);
+			while (__atomic_load_n(&G->seq, __ATOMIC_SEQ_CST) == seq)
+			{
+				pthread_cond_wait(&G->start_cond, &G->mutex);
+			}
+			__atomic_sub_fetch(&G->helpers_sleeping, 1, __ATOMIC_SEQ_CST);
+			dw_mutex_unlock(&G->mutex);
+		}
+		seq = __atomic_load_n(&G->seq, __ATOMIC_SEQ_CST);
+
+		run_group(chan, g, G->samples, G->len);
+
+		if (__atomic_sub_fetch(&G->pending, 1, __ATOMIC_SEQ_CST) == 0 &&
+			__atomic_load_n(&G->coordinator_sleeping, __ATOMIC_SEQ_CST))
+		{
+			dw_mutex_lock(&G->mutex);
+			pthread_cond_signal(&G->done_cond);
+			dw_mutex_unlock(&G->mutex);
+		}
+	}
+	return (NULL);
+#endif
+}
+
+static void group_init(int chan)
+{
+	struct mm_group_s *G = &group[chan];
+	int num_subchan = save_audio_config_p->achan[chan].num_subchan;
+	int d, g;
+
+	memset(G, 0, sizeof(struct mm_group_s));
+	G->num_groups = demod_subchan_num_groups(chan);
+
+	for (g = 0; g <= G->num_groups; g++)
+	{
+		G->first_subchan[g] = num_subchan;
+	}
+	for (d = num_subchan - 1; d >= 0; d--)
+	{
+		G->first_subchan[demod_subchan_group(chan, d)] = d;
+	}
+
+	if (G->num_groups <= 1)
+		return;
+
+#if !__WIN32__
+	group_spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? GROUP_SPIN : 0;
+#endif
+
+	printf("Channel %d: %d subchannels split among %d demodulator threads.\n", chan, num_subchan, G->num_groups);
+
+#if !__WIN32__
+	dw_mutex_init(&G->mutex);
+	pthread_cond_init(&G->start_cond, NULL);
+	pthread_cond_init(&G->done_cond, NULL);
+#endif
+
+	for (g = 1; g < G->num_groups; g++)
+	{
+#if __WIN32__
+		G->start_event[g] = CreateEvent(NULL, 0, 0, NULL);
+		G->done_event[g] = CreateEvent(NULL, 0, 0, NULL);
+		if (G->start_event[g] == NULL || G->done_event[g] == NULL ||
+			_beginthreadex(NULL, 0, group_thread, (void *)(ptrdiff_t)(chan * MAX_SUBCHANS + g), 0, NULL) == 0)
+		{
+
+			printf("FATAL: Could not create demodulator thread for channel %d.\n", chan);
+			exit(1);
+		}
+#else
+		pthread_t tid;
+		int e = pthread_create(&tid, NULL, group_thread, (void *)(ptrdiff_t)(chan * MAX_SUBCHANS + g));
+		if (e != 0)
+		{
+
+			printf("FATAL: Could not create demodulator thread for channel %d.\n", chan);
+			exit(1);
+		}
+		pthread_detach(tid);
+#endif
+	}
+}
+
+/*
+ * Run all the groups over the same piece and wait for them to finish.
+ */
+
+static void run_all_groups(int chan, const int16_t *samples, int len)
+{
+	struct mm_group_s *G = &group[chan];
+
+#if __WIN32__
+	int g;
+
+	G->samples = samples;
+	G->len = len;
+	for (g = 1; g < G->num_groups; g++)
+	{
+		SetEvent(G->start_event[g]);
+	}
+
+	run_group(chan, 0, samples, len);
+
+	WaitForMultipleObjects(G->num_groups - 1, &G->done_event[1], TRUE, INFINITE);
+#else
+	int spin;
+
+	G->samples = samples;
+	G->len = len;
+	__atomic_store_n(&G->pending, G->num_groups - 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&G->seq, 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&G->helpers_sleeping, __ATOMIC_SEQ_CST))
+	{
+		dw_mutex_lock(&G->mutex);
+		pthread_cond_broadcast(&G->start_cond);
+		dw_mutex_unlock(&G->mutex);
+	}
+
+	run_group(chan, 0, samples, len);
+
+	for (spin = 0; spin < group_spin && __atomic_load_n(&G->pending, __ATOMIC_SEQ_CST) > 0; spin++)
+		;
+
+	if (__atomic_load_n(&G->pending, __ATOMIC_SEQ_CST) > 0)
+	{
+		dw_mutex_lock(&G->mutex);
+		__atomic_store_n(&G->coordinator_sleeping, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&G->pending, __ATOMIC_SEQ_CST) > 0)
+		{
+			pthread_cond_wait(&G->done_cond, &G->mutex);
+		}
+		__atomic_store_n(&G->coordinator_sleeping, 0, __ATOMIC_SEQ_CST);
+		dw_mutex_unlock(&G->mutex);
+	}
+#endif
+}
+
 /*------------------------------------------------------------------------------
  *
  * Name:	multi_modem_process_sample
@@ -222,7 +612,6 @@ int multi_modem_get_dc_average(int chan)
 __attribute__((hot)) void multi_modem_process_sample(int chan, int audio_sample)
 {
 	int d;
-	int subchan;
 
 	// Accumulate an average DC bias level.
 	// Shouldn't happen with a soundcard but could with mistuned SDR.
@@ -249,72 +638,520 @@ __attribute__((hot)) void multi_modem_process_sample(int chan, int audio_sample)
 	/* Formerly one loop. */
 	/* 1.2: We can feed one demodulator but end up with multiple outputs. */
 
-	/* Send same thing to all. */
-	for (d = 0; d < save_audio_config_p->achan[chan].num_subchan; d++)
+	/* Send same thing to all. */
+	for (d = 0; d < save_audio_config_p->achan[chan].num_subchan; d++)
+	{
+		demod_process_sample(chan, d, audio_sample);
+	}
+
+	take_held_frames(chan);
+	take_fixed_frames(chan);
+
+	sample_time[chan]++;
+
+	if (pick_due[chan] != 0 && (int)(sample_time[chan] - (unsigned int)pick_due[chan]) >= 0)
+	{
+		check_pick_due(chan);
+	}
+}
+
+/*
+ * All subchannels must get the same piece before moving along
+ * because they can share a prefilter.  See demod.c.
+ */
+
+static void demod_all(int chan, const int16_t *samples, int len)
+{
+	int d;
+
+	demod_decimate_block(chan, samples, len);
+
+	if (group[chan].num_groups > 1)
+	{
+		run_all_groups(chan, samples, len);
+	}
+	else
+	{
+		for (d = 0; d < save_audio_config_p->achan[chan].num_subchan; d++)
+		{
+			demod_block_timed(chan, d, samples, len);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------
+ *
+ * Name:	multi_modem_process_block
+ *
+ * Purpose:	Same as multi_modem_process_sample for a block of samples.
+ *
+ * Inputs:	chan	- Radio channel number
+ *
+ *		samples	- Audio samples for this channel, oldest first.
+ *
+ *		n	- Number of samples.
+ *
+ * Description:	The configuration is checked once, then each demodulator
+ *		runs over the whole block in one call.
+ *
+ *		Candidates are checked after each piece so one might be picked
+ *		up to DEMOD_BLOCK_MAX samples later than with the single sample
+ *		version.  Keep that well below process_age, which is a few bit times.
+ *
+ *------------------------------------------------------------------------------*/
+
+__attribute__((hot)) void multi_modem_process_block(int chan, const int16_t *samples, int n)
+{
+	int i;
+
+	if (n <= 0)
+		return;
+
+	if (save_audio_config_p->achan[chan].num_subchan <= 0 || save_audio_config_p->achan[chan].num_subchan > MAX_SUBCHANS ||
+		save_audio_config_p->achan[chan].num_slicers <= 0 || save_audio_config_p->achan[chan].num_slicers > MAX_SLICERS)
+	{
+
+		printf("ERROR!  Something is seriously wrong in %s %s.\n", __FILE__, __func__);
+		printf("chan = %d, num_subchan = %d [max %d], num_slicers = %d [max %d]\n", chan,
+			   save_audio_config_p->achan[chan].num_subchan, MAX_SUBCHANS,
+			   save_audio_config_p->achan[chan].num_slicers, MAX_SLICERS);
+		printf("Please report this message and include a copy of your configuration file.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	float dc = dc_average[chan];
+	for (i = 0; i < n; i++)
+	{
+		dc = dc * 0.999f + (float)samples[i] * 0.001f;
+	}
+	dc_average[chan] = dc;
+
+	while (n > 0)
+	{
+		int len = n < DEMOD_BLOCK_MAX ? n : DEMOD_BLOCK_MAX;
+		const int16_t *replay;
+		int replay_len;
+
+		// Version 1.8: Skip the demodulators while the channel is quiet.
+		// When it wakes up, the audio just before goes thru first.  See rxgate.c.
+
+		if (rxgate_check(chan, samples, len, pick_due[chan] != 0 || hdlc_rec_data_detect_any(chan), &replay, &replay_len))
+		{
+			for (i = 0; i < replay_len; i += DEMOD_BLOCK_MAX)
+			{
+				demod_all(chan, replay + i, replay_len - i < DEMOD_BLOCK_MAX ? replay_len - i : DEMOD_BLOCK_MAX);
+			}
+			demod_all(chan, samples, len);
+		}
+
+		take_held_frames(chan);
+		take_fixed_frames(chan);
+
+		sample_time[chan] += len;
+
+		if (pick_due[chan] != 0 && (int)(sample_time[chan] - (unsigned int)pick_due[chan]) >= 0)
+		{
+			check_pick_due(chan);
+		}
+
+		samples += len;
+		n -= len;
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        multi_modem_process_rec_frame
+ *
+ * Purpose:     This is called when we receive a frame with a valid
+ *		FCS and acceptable size.
+ *
+ * Inputs:	chan	- Audio channel number, 0 or 1.
+ *		subchan	- Which modem found it.
+ *		slice	- Which slice found it.
+ *		fbuf	- Pointer to first byte in HDLC frame.
+ *		flen	- Number of bytes excluding the FCS.
+ *		alevel	- Audio level, range of 0 - 100.
+ *				(Special case, use negative to skip
+ *				 display of audio level line.
+ *				 Use -2 to indicate DTMF message.)
+ *		retries	- Level of correction used.
+ *		fec_type	- none(0), fx25
+ *		end_time	- From rxlat_now at the closing flag.
+ *
+ * Description:	Add to list of candidates.  Best one will be picked later.
+ *
+ *--------------------------------------------------------------------*/
+
+void multi_modem_process_rec_frame(int chan, int subchan, int slice, unsigned char *fbuf, int flen, alevel_t alevel, retry_t retries, fec_type_t fec_type, int64_t end_time)
+{
+	packet_t pp;
+
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+	assert(slice >= 0 && slice < MAX_SUBCHANS);
+
+	pp = ax25_from_frame(fbuf, flen);
+	rxlat_begin(pp, end_time);
+	rxlat_stage(pp, RXLAT_DECODE);
+
+	multi_modem_process_rec_packet(chan, subchan, slice, pp, alevel, retries, fec_type);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        multi_modem_process_rec_frame_later
+ *
+ * Purpose:     Same as multi_modem_process_rec_frame but from one of
+ *		the fix up threads or the FX.25 decode thread.
+ *
+ * Inputs:	sample_time - From multi_modem_get_sample_time when the
+ *			  block was handed over.  For FX.25, when the
+ *			  correlation tag was found.
+ *
+ *		end_time    - From rxlat_now at the end of the frame.
+ *
+ * Description:	The frame is held until the thread processing the audio
+ *		for the channel gets around to it.
+ *
+ *--------------------------------------------------------------------*/
+
+void multi_modem_process_rec_frame_later(int chan, int subchan, int slice, unsigned char *fbuf, int flen, alevel_t alevel, retry_t retries, fec_type_t fec_type, unsigned int when, int64_t end_time)
+{
+	struct fixed_queue_s *Q = &fixed_queue[chan];
+	packet_t pp;
+
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+	assert(slice >= 0 && slice < MAX_SLICERS);
+
+	pp = ax25_from_frame(fbuf, flen);
+	if (pp == NULL)
+	{
+
+		printf("Unexpected internal problem, %s %d\n", __FILE__, __LINE__);
+		return;
+	}
+	rxlat_begin(pp, end_time);
+
+	dw_mutex_lock(&Q->mutex);
+	if (Q->count < FIXED_QUEUE_SIZE)
+	{
+		Q->item[Q->count].pp = pp;
+		Q->item[Q->count].subchan = subchan;
+		Q->item[Q->count].slice = slice;
+		Q->item[Q->count].alevel = alevel;
+		Q->item[Q->count].retries = retries;
+		Q->item[Q->count].fec_type = fec_type;
+		Q->item[Q->count].sample_time = when;
+		__atomic_store_n(&Q->count, Q->count + 1, __ATOMIC_SEQ_CST);
+		pp = NULL;
+	}
+	dw_mutex_unlock(&Q->mutex);
+
+	if (pp != NULL)
+	{
+		__atomic_add_fetch(&fixed_dropped, 1, __ATOMIC_SEQ_CST);
+		ax25_delete(pp);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        multi_modem_process_rec_dup
+ *
+ * Purpose:     Another slicer ended up with exactly the same bits
+ *		as one which already has a candidate.
+ *
+ * Inputs:	chan, subchan	- As for multi_modem_process_rec_frame.
+ *		slice		- The slicer with the repeat.
+ *		from_slice	- The one already decoded.
+ *
+ * Returns:	1 if a copy of the candidate was added.  0 if there is
+ *		none, normally because it has already been picked.
+ *
+ * Description:	The copy counts the same as decoding it again would have,
+ *		both for the display and when picking the best.
+ *
+ *--------------------------------------------------------------------*/
+
+int multi_modem_process_rec_dup(int chan, int subchan, int slice, int from_slice)
+{
+	struct candidate_s *c = &candidate[chan][subchan][from_slice];
+
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
+	assert(slice >= 0 && slice < MAX_SLICERS);
+	assert(from_slice >= 0 && from_slice < MAX_SLICERS);
+
+	if (c->packet_p == NULL)
+	{
+		return (0);
+	}
+
+	multi_modem_process_rec_packet(chan, subchan, slice, ax25_dup(c->packet_p), c->alevel, c->retries, c->fec_type);
+	return (1);
+}
+
+/*
+ * Move the deadline earlier if due is before it, or set it if none.
+ */
+
+static void set_pick_due(int chan, unsigned int due)
+{
+	uint64_t cur = __atomic_load_n(&pick_due[chan], __ATOMIC_SEQ_CST);
+
+	do
+	{
+		if (cur != 0 && (int)(due - (unsigned int)cur) >= 0)
+		{
+			return;
+		}
+	} while (!__atomic_compare_exchange_n(&pick_due[chan], &cur, PICK_DUE_SET | due, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+}
+
+/*
+ * Find the deadline again after some have been picked or moved.
+ * Only from the thread processing the channel's audio, while any
+ * DEMODTHREADS helpers are idle.
+ */
+
+static void update_pick_due(int chan)
+{
+	int j, k;
+
+	pick_due_stale[chan] = 0;
+	__atomic_store_n(&pick_due[chan], 0, __ATOMIC_SEQ_CST);
+
+	for (j = 0; j < save_audio_config_p->achan[chan].num_subchan; j++)
+	{
+		for (k = 0; k < MAX_SLICERS; k++)
+		{
+			if (candidate[chan][j][k].packet_p != NULL)
+			{
+				set_pick_due(chan, candidate[chan][j][k].when + process_age[chan] + 1);
+			}
+		}
+	}
+}
+
+/*
+ * The deadline has passed.  Pick the best of the oldest candidates,
+ * unless we are waiting for FX.25 or the fix up threads.
+ * Candidates can also be picked from elsewhere, leaving the deadline
+ * too early, so find it again first in that case.
+ *
+ * Only a frame received after an FX.25 correlation tag can be a copy of
+ * what is in the block so anything older goes ahead without waiting.
+ * Those held are then treated as if they arrived when the FX.25 block
+ * was done, along with the FX.25 result, so all are picked together.
+ */
+
+static void check_pick_due(int chan)
+{
+	if (pick_due_stale[chan])
+	{
+		update_pick_due(chan);
+	}
+
+	while (pick_due[chan] != 0 && (int)(sample_time[chan] - (unsigned int)pick_due[chan]) >= 0)
+	{
+		unsigned int oldest = (unsigned int)pick_due[chan] - process_age[chan] - 1;
+		unsigned int since;
+
+		if (fx25_rec_busy(chan, &since) && (int)(oldest + group_span[chan] - since) >= 0)
+		{
+			if (!fx_hold[chan] || (int)(since - fx_hold_since[chan]) < 0)
+			{
+				fx_hold_since[chan] = since;
+			}
+			fx_hold[chan] = 1;
+			return;
+		}
+
+		if (fx_hold[chan])
+		{
+			int j, k;
+
+			take_fixed_frames(chan);
+			for (j = 0; j < save_audio_config_p->achan[chan].num_subchan; j++)
+			{
+				for (k = 0; k < MAX_SLICERS; k++)
+				{
+					if (candidate[chan][j][k].packet_p != NULL &&
+						(int)(candidate[chan][j][k].when + group_span[chan] - fx_hold_since[chan]) >= 0)
+					{
+						candidate[chan][j][k].when = sample_time[chan];
+					}
+				}
+			}
+			fx_hold[chan] = 0;
+			update_pick_due(chan);
+			continue;
+		}
+
+		if (!ready_to_pick(chan, sample_time[chan] - oldest))
+		{
+			return;
+		}
+		pick_oldest_candidates(chan);
+		update_pick_due(chan);
+	}
+}
+
+/*
+ * The candidate has been around long enough.  Have the fix up threads
+ * finished everything handed over until now?  If so, their frames are
+ * added to the candidates.
+ */
+
+static int ready_to_pick(int chan, int age)
+{
+	if (!fix_waiting[chan])
+	{
+		fix_wait_ticket[chan] = hdlc_rec2_fix_ticket(chan);
+		fix_waiting[chan] = 1;
+	}
+
+	// Look before taking so nothing can slip in between.
+
+	if (hdlc_rec2_fix_done(chan, fix_wait_ticket[chan]) || age >= fix_wait_age[chan])
 	{
-		demod_process_sample(chan, d, audio_sample);
+		take_fixed_frames(chan);
+		fix_waiting[chan] = 0;
+		return (1);
 	}
+	return (0);
+}
+
+/* Add any frames from the fix up threads to the candidates. */
+
+static void take_fixed_frames(int chan)
+{
+	struct fixed_queue_s *Q = &fixed_queue[chan];
+	int n, k;
+
+	if (__atomic_load_n(&Q->count, __ATOMIC_SEQ_CST) == 0)
+		return;
 
-	for (subchan = 0; subchan < save_audio_config_p->achan[chan].num_subchan; subchan++)
+	dw_mutex_lock(&Q->mutex);
+	n = Q->count;
+	taking_fixed[chan] = 1;
+	for (k = 0; k < n; k++)
 	{
-		int slice;
+		struct candidate_s *c = &candidate[chan][Q->item[k].subchan][Q->item[k].slice];
+		struct candidate_s newer;
+		int age = sample_time[chan] - Q->item[k].sample_time;
+
+		rxlat_stage(Q->item[k].pp, RXLAT_DECODE);
+
+		if (Q->item[k].fec_type != fec_type_none)
+		{
+			/* FX.25 from the decode thread.  Same as when it was decoded */
+			/* in the demodulator.  It replaces anything from the same */
+			/* slicer, arriving now, and has priority when picking. */
+			multi_modem_process_rec_packet(chan, Q->item[k].subchan, Q->item[k].slice, Q->item[k].pp,
+										   Q->item[k].alevel, Q->item[k].retries, Q->item[k].fec_type);
+			continue;
+		}
 
-		for (slice = 0; slice < save_audio_config_p->achan[chan].num_slicers; slice++)
+		if ((int)(Q->item[k].sample_time - fix_decided_time[chan]) <= 0 ||
+			(c->packet_p != NULL && abs((int)(sample_time[chan] - c->when) - age) <= group_span[chan]))
 		{
+			/* The others from that time have already been picked, or */
+			/* the same slicer already has this frame. */
+			__atomic_add_fetch(&fixed_late[chan], 1, __ATOMIC_RELAXED);
+			ax25_delete(Q->item[k].pp);
+			continue;
+		}
+
+		/* The same slicer might still have the previous frame, waiting */
+		/* for us, or already have the next one.  The previous must be */
+		/* decided first and the next set aside until this one has been. */
 
-			if (candidate[chan][subchan][slice].packet_p != NULL)
+		while (c->packet_p != NULL && (int)(sample_time[chan] - c->when) > age)
+		{
+			pick_oldest_candidates(chan);
+		}
+		newer = *c;
+		c->packet_p = NULL;
+		multi_modem_process_rec_packet(chan, Q->item[k].subchan, Q->item[k].slice, Q->item[k].pp,
+									   Q->item[k].alevel, Q->item[k].retries, fec_type_none);
+		c->when = Q->item[k].sample_time;
+		set_pick_due(chan, c->when + process_age[chan] + 1);
+		if (newer.packet_p != NULL)
+		{
+			while (c->packet_p != NULL)
 			{
-				candidate[chan][subchan][slice].age++;
-				if (candidate[chan][subchan][slice].age > process_age[chan])
-				{
-					if (fx25_rec_busy(chan))
-					{
-						candidate[chan][subchan][slice].age = 0;
-					}
-					else
-					{
-						pick_best_candidate(chan);
-					}
-				}
+				pick_oldest_candidates(chan);
 			}
+			*c = newer;
 		}
 	}
+	taking_fixed[chan] = 0;
+	__atomic_store_n(&Q->count, 0, __ATOMIC_SEQ_CST);
+	dw_mutex_unlock(&Q->mutex);
 }
 
-/*-------------------------------------------------------------------
- *
- * Name:        multi_modem_process_rec_frame
- *
- * Purpose:     This is called when we receive a frame with a valid
- *		FCS and acceptable size.
- *
- * Inputs:	chan	- Audio channel number, 0 or 1.
- *		subchan	- Which modem found it.
- *		slice	- Which slice found it.
- *		fbuf	- Pointer to first byte in HDLC frame.
- *		flen	- Number of bytes excluding the FCS.
- *		alevel	- Audio level, range of 0 - 100.
- *				(Special case, use negative to skip
- *				 display of audio level line.
- *				 Use -2 to indicate DTMF message.)
- *		retries	- Level of correction used.
- *		fec_type	- none(0), fx25
- *
- * Description:	Add to list of candidates.  Best one will be picked later.
- *
- *--------------------------------------------------------------------*/
+/* For the fix up threads.  Number of samples processed for the channel. */
 
-void multi_modem_process_rec_frame(int chan, int subchan, int slice, unsigned char *fbuf, int flen, alevel_t alevel, retry_t retries, fec_type_t fec_type)
+unsigned int multi_modem_get_sample_time(int chan)
 {
-	packet_t pp;
+	return (sample_time[chan]);
+}
 
-	assert(chan >= 0 && chan < MAX_CHANS);
-	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
-	assert(slice >= 0 && slice < MAX_SUBCHANS);
+/*
+ * Fix up results discarded because the candidates were not taking them
+ * fast enough, or arrived after the others from that frame were picked.
+ * The late ones are normally duplicates.
+ */
 
-	pp = ax25_from_frame(fbuf, flen);
+void multi_modem_fix_stats(int *dropped, int *late)
+{
+	int chan;
 
-	multi_modem_process_rec_packet(chan, subchan, slice, pp, alevel, retries, fec_type);
+	*dropped = __atomic_load_n(&fixed_dropped, __ATOMIC_SEQ_CST);
+	*late = 0;
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		*late += __atomic_load_n(&fixed_late[chan], __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * Frames set aside by multi_modem_process_rec_packet.  Only from the
+ * thread processing the channel's audio, while any DEMODTHREADS helpers
+ * are idle.  Go with what we have rather than clobbering it, as before,
+ * but from here where nothing else is using the candidates.
+ */
+
+static void take_held_frames(int chan)
+{
+	int j, k;
+
+	if (!__atomic_load_n(&pick_now[chan], __ATOMIC_ACQUIRE))
+		return;
+	__atomic_store_n(&pick_now[chan], 0, __ATOMIC_RELAXED);
+
+	fix_waiting[chan] = 0;
+	pick_oldest_candidates(chan);
+
+	for (j = 0; j < save_audio_config_p->achan[chan].num_subchan; j++)
+	{
+		for (k = 0; k < MAX_SLICERS; k++)
+		{
+			if (held[chan][j][k].packet_p != NULL)
+			{
+				while (candidate[chan][j][k].packet_p != NULL)
+				{
+					pick_oldest_candidates(chan);
+				}
+				candidate[chan][j][k] = held[chan][j][k];
+				held[chan][j][k].packet_p = NULL;
+			}
+		}
+	}
+	update_pick_due(chan);
 }
 
 // TODO: Eliminate function above and move code elsewhere?
@@ -328,13 +1165,15 @@ void multi_modem_process_rec_packet(int chan, int subchan, int slice, packet_t p
 		return; /* oops!  why would it fail? */
 	}
 
+	metrics_decoded(chan, subchan, slice);
+
 	/*
 	 * If only one demodulator/slicer, and no FX.25 in progress,
 	 * push it thru and forget about all this foolishness.
 	 */
 	if (save_audio_config_p->achan[chan].num_subchan == 1 &&
 		save_audio_config_p->achan[chan].num_slicers == 1 &&
-		!fx25_rec_busy(chan))
+		!fx25_rec_busy(chan, NULL))
 	{
 
 		int drop_it = 0;
@@ -359,6 +1198,8 @@ void multi_modem_process_rec_packet(int chan, int subchan, int slice, packet_t p
 		}
 		else
 		{
+			metrics_picked(chan, subchan, slice, retries, fec_type != fec_type_none);
+			metrics_unique(chan, subchan, slice, 1, 1);
 			dlq_rec_frame(chan, subchan, slice, pp, alevel, fec_type, retries, "");
 		}
 		return;
@@ -367,6 +1208,28 @@ void multi_modem_process_rec_packet(int chan, int subchan, int slice, packet_t p
 	/*
 	 * Otherwise, save them up for a few bit times so we can pick the best.
 	 */
+	if (fix_waiting[chan] && !taking_fixed[chan] && candidate[chan][subchan][slice].packet_p != NULL)
+	{
+		/* Still waiting for the fix up threads but this is another frame. */
+		/* This could be a DEMODTHREADS group, so don't pick from here. */
+		/* Set it aside for take_held_frames. */
+
+		struct candidate_s *h = &held[chan][subchan][slice];
+
+		if (h->packet_p != NULL)
+		{
+			ax25_delete(h->packet_p);
+		}
+		h->packet_p = pp;
+		h->alevel = alevel;
+		h->fec_type = fec_type;
+		h->retries = retries;
+		h->when = sample_time[chan];
+		h->crc = ax25_m_m_crc(pp);
+		__atomic_store_n(&pick_now[chan], 1, __ATOMIC_RELEASE);
+		return;
+	}
+
 	if (candidate[chan][subchan][slice].packet_p != NULL)
 	{
 		/* Plain old AX.25: Oops!  Didn't expect it to be there. */
@@ -381,8 +1244,10 @@ void multi_modem_process_rec_packet(int chan, int subchan, int slice, packet_t p
 	candidate[chan][subchan][slice].alevel = alevel;
 	candidate[chan][subchan][slice].fec_type = fec_type;
 	candidate[chan][subchan][slice].retries = retries;
-	candidate[chan][subchan][slice].age = 0;
+	candidate[chan][subchan][slice].when = sample_time[chan];
 	candidate[chan][subchan][slice].crc = ax25_m_m_crc(pp);
+
+	set_pick_due(chan, sample_time[chan] + process_age[chan] + 1);
 }
 
 /*-------------------------------------------------------------------
@@ -404,6 +1269,75 @@ void multi_modem_process_rec_packet(int chan, int subchan, int slice, packet_t p
 /* Opposite order would be suitable for multi-frequency although */
 /* multiple slicers are of questionable value for HF SSB. */
 
+/*
+ * Normally all candidates are from the same frame, but not if we end up
+ * waiting for the fix up threads.  Set aside those which arrived too long
+ * after the oldest while picking the best of the others.
+ */
+
+static void pick_oldest_candidates(int chan)
+{
+	struct candidate_s newer[MAX_SUBCHANS][MAX_SLICERS];
+	int oldest = -1;
+	int youngest = 0x7fffffff;
+	int num_subchan = save_audio_config_p->achan[chan].num_subchan;
+	int j, k;
+
+	for (j = 0; j < num_subchan; j++)
+	{
+		for (k = 0; k < MAX_SLICERS; k++)
+		{
+			if (candidate[chan][j][k].packet_p != NULL && (int)(sample_time[chan] - candidate[chan][j][k].when) > oldest)
+			{
+				oldest = sample_time[chan] - candidate[chan][j][k].when;
+			}
+		}
+	}
+
+	for (j = 0; j < num_subchan; j++)
+	{
+		for (k = 0; k < MAX_SLICERS; k++)
+		{
+			newer[j][k].packet_p = NULL;
+			if (candidate[chan][j][k].packet_p != NULL)
+			{
+				int age = sample_time[chan] - candidate[chan][j][k].when;
+
+				if (age < oldest - group_span[chan])
+				{
+					newer[j][k] = candidate[chan][j][k];
+					candidate[chan][j][k].packet_p = NULL;
+				}
+				else if (age < youngest)
+				{
+					youngest = age;
+				}
+			}
+		}
+	}
+
+	if (oldest >= 0)
+	{
+		pick_best_candidate(chan);
+
+		/* Fix up results for this frame, coming later, would be duplicates. */
+		fix_decided_time[chan] = sample_time[chan] - youngest + process_age[chan];
+	}
+
+	for (j = 0; j < num_subchan; j++)
+	{
+		for (k = 0; k < MAX_SLICERS; k++)
+		{
+			if (newer[j][k].packet_p != NULL)
+			{
+				candidate[chan][j][k] = newer[j][k];
+			}
+		}
+	}
+
+	pick_due_stale[chan] = 1;
+}
+
 #define subchan_from_n(x) ((x) % save_audio_config_p->achan[chan].num_subchan)
 #define slice_from_n(x) ((x) / save_audio_config_p->achan[chan].num_subchan)
 
@@ -549,7 +1483,7 @@ static void pick_best_candidate(int chan)
 				   candidate[chan][j][k].packet_p,
 				   (int)(candidate[chan][j][k].fec_type),
 				   (int)(candidate[chan][j][k].retries),
-				   candidate[chan][j][k].age,
+				   (int)(sample_time[chan] - candidate[chan][j][k].when),
 				   candidate[chan][j][k].crc,
 				   candidate[chan][j][k].score,
 				   (n == best_n) ? "***" : "");
@@ -567,6 +1501,29 @@ static void pick_best_candidate(int chan)
 	 * send the best one along.
 	 */
 
+	/* Version 1.8: Would it have been lost without this demodulator or slicer? */
+
+	int only_slice = 1, only_subchan = 1;
+	j = subchan_from_n(best_n);
+	k = slice_from_n(best_n);
+	for (n = 0; n < num_bars; n++)
+	{
+		int mj = subchan_from_n(n);
+		int mk = slice_from_n(n);
+
+		if (n != best_n && candidate[chan][mj][mk].packet_p != NULL &&
+			candidate[chan][mj][mk].crc == candidate[chan][j][k].crc)
+		{
+			only_slice = 0;
+			if (mj != j)
+			{
+				only_subchan = 0;
+			}
+		}
+	}
+	metrics_unique(chan, j, k, only_slice, only_subchan);
+	prune_count(chan, best_n, only_slice, only_subchan);
+
 	/* Delete those not chosen. */
 
 	for (n = 0; n < num_bars; n++)
@@ -609,6 +1566,8 @@ static void pick_best_candidate(int chan)
 	else
 	{
 		assert(candidate[chan][j][k].packet_p != NULL);
+		rxlat_stage(candidate[chan][j][k].packet_p, RXLAT_HOLD);
+		metrics_picked(chan, j, k, candidate[chan][j][k].retries, candidate[chan][j][k].fec_type != fec_type_none);
 		dlq_rec_frame(chan, j, k,
 					  candidate[chan][j][k].packet_p,
 					  candidate[chan][j][k].alevel,
@@ -622,8 +1581,248 @@ static void pick_best_candidate(int chan)
 
 	/* Clear in preparation for next time. */
 
-	memset(candidate[chan], 0, sizeof(candidate[chan]));
+	memset(candidate[chan], 0, save_audio_config_p->achan[chan].num_subchan * sizeof(*candidate[chan]));
 
 } /* end pick_best_candidate */
 
+/*------------------------------------------------------------------------------
+ *
+ * Name:	prune_init
+ *
+ * Purpose:	Set up RXPRUNE for a channel with everything running.
+ *
+ *		Nothing to do with a single demodulator and slicer.
+ *
+ *------------------------------------------------------------------------------*/
+
+static unsigned int all_slicers(int chan)
+{
+	int num_slicers = save_audio_config_p->achan[chan].num_slicers;
+
+	return ((1u << (num_slicers > 1 ? num_slicers : 1)) - 1);
+}
+
+static void prune_init(int chan)
+{
+	int j;
+
+	if (save_audio_config_p->achan[chan].rx_prune_frames <= 0 ||
+		save_audio_config_p->achan[chan].num_subchan * save_audio_config_p->achan[chan].num_slicers <= 1)
+	{
+		return;
+	}
+
+	prune[chan] = calloc(1, sizeof(struct mm_prune_s));
+	if (prune[chan] == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (j = 0; j < save_audio_config_p->achan[chan].num_subchan; j++)
+	{
+		prune[chan]->active[j] = all_slicers(chan);
+		prune[chan]->shown[j] = all_slicers(chan);
+	}
+}
+
+/*------------------------------------------------------------------------------
+ *
+ * Name:	prune_count
+ *
+ * Purpose:	Keep track of which demodulators and slicers are pulling
+ *		their weight and turn off those which aren't.
+ *
+ * Inputs:	chan		- Radio channel.
+ *		best_n		- The candidate picked, before the others are deleted.
+ *		only_slice	- No other slicer, of any demodulator, got it.
+ *		only_subchan	- No other demodulator got it.
+ *
+ * Description:	The counts, for a round of rx_prune_frames picked frames,
+ *		are the same as metrics_unique but here only for the
+ *		decision at the end of the round.
+ *
+ *		At the end of a round, one demodulator, or else one slicer,
+ *		which got no frames of its own is turned off.  One at a time
+ *		because two which always get the same frames both look
+ *		useless.  With one gone, the next round shows the other is
+ *		needed.  The one which got the fewest frames goes first.
+ *
+ *		Conditions change, e.g. a different station with more
+ *		twist, so after rx_prune_probe rounds everything is turned
+ *		back on for one round.  Anything that got frames of its own
+ *		then stays on, along with what was running before.
+ *
+ *		A frame only the turned off ones could have decoded is lost
+ *		of course.  The probe rounds put a limit on how long that
+ *		goes on.
+ *
+ *------------------------------------------------------------------------------*/
+
+static void prune_round(int chan);
+
+static void prune_count(int chan, int best_n, int only_slice, int only_subchan)
+{
+	struct mm_prune_s *P = prune[chan];
+	int num_bars = save_audio_config_p->achan[chan].num_slicers * save_audio_config_p->achan[chan].num_subchan;
+	int j = subchan_from_n(best_n);
+	int k = slice_from_n(best_n);
+	int n;
+
+	if (P == NULL)
+	{
+		return;
+	}
+
+	for (n = 0; n < num_bars; n++)
+	{
+		int mj = subchan_from_n(n);
+		int mk = slice_from_n(n);
+
+		if (candidate[chan][mj][mk].packet_p != NULL && candidate[chan][mj][mk].crc == candidate[chan][j][k].crc)
+		{
+			P->decoded[mj][mk]++;
+		}
+	}
+	if (only_slice)
+	{
+		P->unique_slice[j][k]++;
+	}
+	if (only_subchan)
+	{
+		P->unique_subchan[j]++;
+	}
+
+	if (++P->frames >= save_audio_config_p->achan[chan].rx_prune_frames)
+	{
+		prune_round(chan);
+	}
+}
+
+static void prune_round(int chan)
+{
+	struct mm_prune_s *P = prune[chan];
+	int num_subchan = save_audio_config_p->achan[chan].num_subchan;
+	int num_slicers = save_audio_config_p->achan[chan].num_slicers > 1 ? save_audio_config_p->achan[chan].num_slicers : 1;
+	unsigned int all = all_slicers(chan);
+	int j, k;
+
+	if (P->probing)
+	{
+		/* Back to before, plus whatever turned out to be needed. */
+
+		for (j = 0; j < num_subchan; j++)
+		{
+			for (k = 0; k < num_slicers; k++)
+			{
+				if (P->unique_slice[j][k] > 0)
+				{
+					P->keep[j] |= 1u << k;
+				}
+			}
+			if (P->unique_subchan[j] > 0 && P->keep[j] == 0)
+			{
+				P->keep[j] = all;
+			}
+			P->active[j] = P->keep[j];
+		}
+		P->probing = 0;
+		P->rounds = 0;
+	}
+	else if (++P->rounds >= save_audio_config_p->achan[chan].rx_prune_probe)
+	{
+		for (j = 0; j < num_subchan; j++)
+		{
+			P->keep[j] = P->active[j];
+			P->active[j] = all;
+		}
+		P->probing = 1;
+	}
+	else
+	{
+		int running = 0;
+		int best_j = -1, best_k = -1, fewest = 0x7fffffff;
+
+		for (j = 0; j < num_subchan; j++)
+		{
+			running += P->active[j] != 0;
+		}
+
+		/* A whole demodulator saves the most. */
+
+		for (j = 0; j < num_subchan && running > 1; j++)
+		{
+			int decoded = 0;
+
+			for (k = 0; k < num_slicers; k++)
+			{
+				decoded += P->decoded[j][k];
+			}
+			if (P->active[j] != 0 && P->unique_subchan[j] == 0 && decoded < fewest)
+			{
+				best_j = j;
+				fewest = decoded;
+			}
+		}
+
+		if (best_j >= 0)
+		{
+			P->active[best_j] = 0;
+		}
+		else
+		{
+			for (j = 0; j < num_subchan; j++)
+			{
+				if ((P->active[j] & (P->active[j] - 1)) == 0)
+				{
+					continue; /* Leave at least one. */
+				}
+				for (k = 0; k < num_slicers; k++)
+				{
+					if ((P->active[j] & (1u << k)) && P->unique_slice[j][k] == 0 && P->decoded[j][k] < fewest)
+					{
+						best_j = j;
+						best_k = k;
+						fewest = P->decoded[j][k];
+					}
+				}
+			}
+			if (best_j >= 0)
+			{
+				P->active[best_j] &= ~(1u << best_k);
+			}
+		}
+	}
+
+	for (j = 0; j < num_subchan; j++)
+	{
+		demod_set_active(chan, j, P->active[j]);
+		__atomic_store_n(&P->shown[j], P->active[j], __ATOMIC_RELAXED);
+	}
+
+	P->frames = 0;
+	memset(P->decoded, 0, sizeof(P->decoded));
+	memset(P->unique_slice, 0, sizeof(P->unique_slice));
+	memset(P->unique_subchan, 0, sizeof(P->unique_subchan));
+}
+
+/*------------------------------------------------------------------------------
+ *
+ * Name:	multi_modem_active_slicers
+ *
+ * Purpose:	Which slicers of a demodulator are running, for metrics_server.c.
+ *
+ * Returns:	Bit mask, slicer 0 in bit 0.  0 when RXPRUNE has turned off
+ *		the demodulator.
+ *
+ *------------------------------------------------------------------------------*/
+
+unsigned int multi_modem_active_slicers(int chan, int subchan)
+{
+	if (prune[chan] == NULL)
+	{
+		return (all_slicers(chan));
+	}
+	return (__atomic_load_n(&prune[chan]->shown[subchan], __ATOMIC_RELAXED));
+}
+
 /* end multi_modem.c */
@@ -3,6 +3,8 @@
 #ifndef MULTI_MODEM_H
 #define MULTI_MODEM 1
 
+#include <stdint.h>
+
 /* Needed for typedef retry_t. */
 #include "hdlc_rec2.h"
 
@@ -13,10 +15,22 @@ void multi_modem_init(struct audio_s *pmodem);
 
 void multi_modem_process_sample(int c, int audio_sample);
 
+void multi_modem_process_block(int c, const int16_t *samples, int n);
+
 int multi_modem_get_dc_average(int chan);
 
 // Deprecated.  Replace with ...packet
-void multi_modem_process_rec_frame(int chan, int subchan, int slice, unsigned char *fbuf, int flen, alevel_t alevel, retry_t retries, fec_type_t fec_type);
+void multi_modem_process_rec_frame(int chan, int subchan, int slice, unsigned char *fbuf, int flen, alevel_t alevel, retry_t retries, fec_type_t fec_type, int64_t end_time);
+
+void multi_modem_process_rec_frame_later(int chan, int subchan, int slice, unsigned char *fbuf, int flen, alevel_t alevel, retry_t retries, fec_type_t fec_type, unsigned int sample_time, int64_t end_time);
+
+int multi_modem_process_rec_dup(int chan, int subchan, int slice, int from_slice);
+
+unsigned int multi_modem_get_sample_time(int chan);
+
+void multi_modem_fix_stats(int *dropped, int *late);
+
+unsigned int multi_modem_active_slicers(int chan, int subchan);
 
 void multi_modem_process_rec_packet(int chan, int subchan, int slice, packet_t pp, alevel_t alevel, retry_t retries, fec_type_t fec_type);
 
@@ -159,6 +159,10 @@
 #include <hamlib/rig.h>
 #endif
 
+#ifdef USE_GPIOD
+#include <linux/gpio.h>
+#endif
+
 /* So we can have more common code for fd. */
 typedef int HANDLE;
 #define INVALID_HANDLE_VALUE (-1)
@@ -169,10 +173,12 @@ typedef int HANDLE;
 #include "cm108.h"
 #endif /* USE_CM108 */
 
+#include "dwthread.h"
 #include "audio.h"
 #include "ptt.h"
 #include "dlq.h"
 #include "demod.h" // to mute recv audio during xmit if half duplex.
+#include "audio_stats.h"
 
 #if __WIN32__
 
@@ -682,6 +688,92 @@ void export_gpio(int ch, int ot, int invert, int direction)
 
 #endif /* not __WIN32__ */
 
+/*-------------------------------------------------------------------
+ *
+ * Name:	gpiod_request_output
+ *
+ * Purpose:	Get a GPIO line, thru the character device, for output.
+ *
+ * Inputs:	chip	- Like gpiochip0 or /dev/gpiochip0.
+ *		line	- Line number on that chip.
+ *		value	- Initial value, i.e. off, already inverted if need be.
+ *
+ * Returns:	fd for the line, to use with GPIO_V2_LINE_SET_VALUES_IOCTL,
+ *		or INVALID_HANDLE_VALUE if it could not be had.
+ *
+ * Description:	Version 1.8.  The /sys/class/gpio interface is deprecated,
+ *		and opening and writing a file for every change takes a
+ *		while.  Here the line is requested once and the kernel
+ *		holds it for us until the fd is closed.
+ *
+ *		This uses version 2 of the interface, Linux 5.10 and later,
+ *		directly rather than thru libgpiod.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifdef USE_GPIOD
+
+static int gpiod_request_output(const char *chip, int line, int value)
+{
+	char path[160];
+	struct gpio_v2_line_request req;
+	int fd;
+
+	if (strchr(chip, '/') != NULL)
+	{
+		snprintf(path, sizeof(path), "%s", chip);
+	}
+	else
+	{
+		snprintf(path, sizeof(path), "/dev/%s", chip);
+	}
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+	{
+		int e = errno;
+
+		printf("Can't open %s for GPIO line %d.\n", path, line);
+		printf("%s\n", strerror(e));
+		if (e == EACCES)
+		{
+			printf("If operating system has 'gpio' group, add your user id to it.\n");
+		}
+		return (INVALID_HANDLE_VALUE);
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.offsets[0] = line;
+	req.num_lines = 1;
+	snprintf(req.consumer, sizeof(req.consumer), "direwolf");
+	req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+	req.config.num_attrs = 1;
+	req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+	req.config.attrs[0].attr.values = value ? 1 : 0;
+	req.config.attrs[0].mask = 1;
+
+	if (ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+	{
+		int e = errno;
+
+		printf("Can't get GPIO line %d of %s for output.\n", line, path);
+		printf("%s\n", strerror(e));
+		if (e == EBUSY)
+		{
+			printf("Something else, possibly the /sys/class/gpio interface, is using it.\n");
+		}
+		close(fd);
+		return (INVALID_HANDLE_VALUE);
+	}
+
+	/* The chip isn't needed any more, only the line. */
+
+	close(fd);
+	return (req.fd);
+}
+
+#endif /* USE_GPIOD */
+
 /*-------------------------------------------------------------------
  *
  * Name:        ptt_init
@@ -699,16 +791,19 @@ void export_gpio(int ch, int ot, int invert, int direction)
  *					PTT_METHOD_LPT - Parallel printer port.
  *                  			PTT_METHOD_HAMLIB - HAMLib rig control.
  *					PTT_METHOD_CM108 - GPIO pins of CM108 etc. USB Audio.
+ *					PTT_METHOD_GPIOD - GPIO character device.
  *
  *			ptt_device	Name of serial port device.
  *					 e.g. COM1 or /dev/ttyS0.
  *					 HAMLIB can also use hostaddr:port.
  *					 Like /dev/hidraw1 for CM108.
+ *					 Like gpiochip0 for GPIOD.
  *
  *			ptt_line	RTS or DTR when using serial port.
  *
  *			out_gpio_num	GPIO number.  Only used for Linux.
  *					 Valid only when ptt_method is PTT_METHOD_GPIO.
+ *					 Line on the chip for PTT_METHOD_GPIOD.
  *
  *			ptt_lpt_bit	Bit number for parallel printer port.
  *					 Bit 0 = pin 2, ..., bit 7 = pin 9.
@@ -738,6 +833,17 @@ static RIG *rig[MAX_CHANS][NUM_OCTYPES];
 
 static char otnames[NUM_OCTYPES][8];
 
+/*
+ * Version 1.8: How long ptt_set takes, for each output.  See ptt_set_stats.
+ */
+
+static struct
+{
+	int count;
+	int64_t total_us;
+	int64_t max_us;
+} set_time[MAX_CHANS][NUM_OCTYPES];
+
 void ptt_init(struct audio_s *audio_config_p)
 {
 	int ch;
@@ -976,6 +1082,40 @@ void ptt_init(struct audio_s *audio_config_p)
 	}
 #endif
 
+	/*
+	 * Version 1.8: GPIO character device.
+	 * Each line is requested once, here, and held.  The fd goes in
+	 * ptt_fd so ptt_set needs only one ioctl and ptt_term closes it.
+	 */
+
+#ifdef USE_GPIOD
+
+	for (ch = 0; ch < MAX_CHANS; ch++)
+	{
+		if (save_audio_config_p->chan_medium[ch] == MEDIUM_RADIO)
+		{
+			int ot;
+			for (ot = 0; ot < NUM_OCTYPES; ot++)
+			{
+				if (audio_config_p->achan[ch].octrl[ot].ptt_method == PTT_METHOD_GPIOD)
+				{
+					ptt_fd[ch][ot] = gpiod_request_output(audio_config_p->achan[ch].octrl[ot].ptt_device,
+														  audio_config_p->achan[ch].octrl[ot].out_gpio_num,
+														  audio_config_p->achan[ch].octrl[ot].ptt_invert);
+					if (ptt_fd[ch][ot] != INVALID_HANDLE_VALUE)
+					{
+						printf("Using %s line %d for channel %d %s control.\n",
+							   audio_config_p->achan[ch].octrl[ot].ptt_device,
+							   audio_config_p->achan[ch].octrl[ot].out_gpio_num,
+							   ch,
+							   otnames[ot]);
+					}
+				}
+			}
+		}
+	}
+#endif
+
 	/*
 	 * Set up parallel printer port.
 	 *
@@ -1183,6 +1323,8 @@ void ptt_init(struct audio_s *audio_config_p)
 	/*
 	 * Confirm what is going on with CM108 GPIO output.
 	 * Could use some error checking for overlap.
+	 *
+	 * Version 1.8: Open it now and keep it open.  See cm108_write.
 	 */
 
 #if USE_CM108
@@ -1203,6 +1345,7 @@ void ptt_init(struct audio_s *audio_config_p)
 						   audio_config_p->achan[ch].octrl[ot].out_gpio_num,
 						   ch,
 						   otnames[ot]);
+					cm108_open_device(audio_config_p->achan[ch].octrl[ot].ptt_device);
 				}
 			}
 		}
@@ -1226,6 +1369,82 @@ void ptt_init(struct audio_s *audio_config_p)
 
 } /* end ptt_init */
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        ptt_init_begin
+ *		ptt_init_finish
+ *
+ * Purpose:     Version 1.8: Do ptt_init in the background while the
+ *		demodulators and the tone generator are set up.
+ *
+ * Inputs:	audio_config_p	- Same as ptt_init.  The channel
+ *				  media and the input and output control
+ *				  settings must not change, and nothing
+ *				  else may use them, until ptt_init_finish.
+ *
+ * Description:	Exporting GPIO lines waits for the permissions to be
+ *		changed, and opening a radio with hamlib can take a while.
+ *		None of that depends on the audio.
+ *
+ *		Start it after anything that forks, e.g. autotune,
+ *		so the child doesn't start with this thread part way
+ *		thru a library call.
+ *
+ *		ptt_init_finish waits for the background ptt_init to
+ *		complete.  If ptt_init_begin was not called, it does
+ *		ptt_init right there.  Nothing else here may be used
+ *		before ptt_init_finish returns.
+ *
+ *--------------------------------------------------------------------*/
+
+static int init_started = 0;
+
+#if __WIN32__
+static HANDLE init_thread;
+
+static unsigned __stdcall ptt_init_thread(void *arg)
+{
+	ptt_init((struct audio_s *)arg);
+	return (0);
+}
+#else
+static pthread_t init_thread;
+
+static void *ptt_init_thread(void *arg)
+{
+	ptt_init((struct audio_s *)arg);
+	return (NULL);
+}
+#endif
+
+void ptt_init_begin(struct audio_s *audio_config_p)
+{
+#if __WIN32__
+	init_thread = (HANDLE)_beginthreadex(NULL, 0, ptt_init_thread, audio_config_p, 0, NULL);
+	init_started = init_thread != NULL;
+#else
+	init_started = pthread_create(&init_thread, NULL, ptt_init_thread, audio_config_p) == 0;
+#endif
+	// Otherwise ptt_init_finish will do it the usual way.
+}
+
+void ptt_init_finish(struct audio_s *audio_config_p)
+{
+	if (init_started)
+	{
+#if __WIN32__
+		WaitForSingleObject(init_thread, INFINITE);
+		CloseHandle(init_thread);
+#else
+		pthread_join(init_thread, NULL);
+#endif
+		init_started = 0;
+		return;
+	}
+
+	ptt_init(audio_config_p);
+}
+
 /*-------------------------------------------------------------------
  *
  * Name:        ptt_set
@@ -1252,7 +1471,25 @@ void ptt_init(struct audio_s *audio_config_p)
 
 // JWL - save status and new get_ptt function.
 
+static void ptt_set_now(int ot, int chan, int ptt_signal);
+
 void ptt_set(int ot, int chan, int ptt_signal)
+{
+	int64_t start = audio_stats_clock();
+	int64_t us;
+
+	ptt_set_now(ot, chan, ptt_signal);
+
+	us = audio_stats_clock() - start;
+	__atomic_add_fetch(&set_time[chan][ot].count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&set_time[chan][ot].total_us, us, __ATOMIC_RELAXED);
+	if (us > __atomic_load_n(&set_time[chan][ot].max_us, __ATOMIC_RELAXED))
+	{
+		__atomic_store_n(&set_time[chan][ot].max_us, us, __ATOMIC_RELAXED);
+	}
+}
+
+static void ptt_set_now(int ot, int chan, int ptt_signal)
 {
 
 	int ptt = ptt_signal;
@@ -1404,6 +1641,32 @@ void ptt_set(int ot, int chan, int ptt_signal)
 	}
 #endif
 
+	/*
+	 * Version 1.8: Using GPIO character device?
+	 */
+
+#ifdef USE_GPIOD
+
+	if (save_audio_config_p->achan[chan].octrl[ot].ptt_method == PTT_METHOD_GPIOD &&
+		ptt_fd[chan][ot] != INVALID_HANDLE_VALUE)
+	{
+		struct gpio_v2_line_values values;
+
+		memset(&values, 0, sizeof(values));
+		values.bits = ptt;
+		values.mask = 1;
+
+		if (ioctl(ptt_fd[chan][ot], GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0)
+		{
+			int e = errno;
+
+			printf("Error setting %s line %d for %s\n", save_audio_config_p->achan[chan].octrl[ot].ptt_device,
+				   save_audio_config_p->achan[chan].octrl[ot].out_gpio_num, otnames[ot]);
+			printf("%s\n", strerror(e));
+		}
+	}
+#endif
+
 	/*
 	 * Using parallel printer port?
 	 */
@@ -1493,7 +1756,36 @@ void ptt_set(int ot, int chan, int ptt_signal)
 	}
 #endif
 
-} /* end ptt_set */
+} /* end ptt_set_now */
+
+/*-------------------------------------------------------------------
+ *
+ * Name:	ptt_set_stats
+ *
+ * Purpose:	How long it takes to change an output, e.g. key the transmitter.
+ *
+ * Inputs:	ot	- Output control type, OCTYPE_PTT, etc.
+ *		chan	- Radio channel.
+ *
+ * Outputs:	count	- Number of changes.
+ *		total_us - Total time in ptt_set, microseconds.
+ *		max_us	- Longest.
+ *
+ * Description:	Version 1.8.  This is the time for the serial port,
+ *		GPIO, CM108, or hamlib call to return.  The radio might
+ *		take longer after that.
+ *
+ * ------------------------------------------------------------------*/
+
+void ptt_set_stats(int ot, int chan, int *count, int64_t *total_us, int64_t *max_us)
+{
+	assert(ot >= 0 && ot < NUM_OCTYPES);
+	assert(chan >= 0 && chan < MAX_CHANS);
+
+	*count = __atomic_load_n(&set_time[chan][ot].count, __ATOMIC_RELAXED);
+	*total_us = __atomic_load_n(&set_time[chan][ot].total_us, __ATOMIC_RELAXED);
+	*max_us = __atomic_load_n(&set_time[chan][ot].max_us, __ATOMIC_RELAXED);
+}
 
 /*-------------------------------------------------------------------
  *
@@ -1614,6 +1906,10 @@ void ptt_term(void)
 		}
 	}
 
+#ifdef USE_CM108
+	cm108_close_all();
+#endif
+
 #ifdef USE_HAMLIB
 
 	for (n = 0; n < MAX_CHANS; n++)
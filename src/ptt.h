@@ -3,14 +3,22 @@
 #ifndef PTT_H
 #define PTT_H 1
 
+#include <stdint.h>
+
 #include "audio.h" /* for struct audio_s and definitions for octype values */
 
 void ptt_set_debug(int debug);
 
 void ptt_init(struct audio_s *p_modem);
 
+void ptt_init_begin(struct audio_s *p_modem);
+
+void ptt_init_finish(struct audio_s *p_modem);
+
 void ptt_set(int octype, int chan, int ptt);
 
+void ptt_set_stats(int octype, int chan, int *count, int64_t *total_us, int64_t *max_us);
+
 void ptt_term(void);
 
 int get_input(int it, int chan);
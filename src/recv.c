@@ -63,7 +63,7 @@
  *		recv_init()		This starts up a separate thread
  *					for each audio device.
  *					Each thread reads audio samples and
- *					passes them to multi_modem_process_sample.
+ *					passes them to multi_modem_process_block.
  *
  *					The difference is that app_process_rec_frame
  *					is no longer called directly.  Instead
@@ -77,6 +77,36 @@
  *					in the dlq queue and calls app_process_rec_frame
  *					for each.
  *
+ *		file:			Version 1.8: For a recorded file, the
+ *					audio device thread feeds some silence at
+ *					the end, to push out the last frame, and
+ *					lets the channel threads finish.  When all
+ *					inputs are files, recv_process reports how
+ *					long it took and exits after everything
+ *					has been processed.
+ *
+ *		DEMODTHREADS		Optionally, the audio device thread only
+ *					collects samples and each radio channel
+ *					has its own thread running multi_modem.
+ *					The two are connected by a single producer,
+ *					single consumer ring of sample blocks so
+ *					the audio side never waits on a lock.
+ *
+ *		SDR			Version 1.8: One more thread reads the
+ *					wideband I/Q input and feeds all of the
+ *					channels split out of it by sdr.c, in
+ *					place of their audio device threads.
+ *
+ *		RECVTHREADS		Version 1.8: Optionally, the frames from
+ *					each audio device (and the SDR) go into
+ *					a queue of their own.  The first is
+ *					still taken by recv_process and each
+ *					of the others by a recv_shard_thread.
+ *					All of them send to the same KISS
+ *					clients, which have their own locks.
+ *					A channel always uses the same queue
+ *					so its frames stay in order.
+ *
  *---------------------------------------------------------------*/
 
 
@@ -87,20 +117,23 @@
 #include <stddef.h>
 #include <sys/types.h>
 #include <assert.h>
+#include <errno.h>
 
 #if __WIN32__
 #include <windows.h>
 #endif
 
-#ifdef __FreeBSD__
-#include <errno.h>
-#endif
-
+#include "dwthread.h"
 #include "audio.h"
 #include "demod.h"
 #include "multi_modem.h"
 #include "dlq.h"
 #include "recv.h"
+#include "kissnet.h"
+#include "resample.h"
+#include "audio_stats.h"
+#include "sdr.h"
+#include "rxlat.h"
 
 #if __WIN32__
 static unsigned __stdcall recv_adev_thread(void *arg);
@@ -108,9 +141,127 @@ static unsigned __stdcall recv_adev_thread(void *arg);
 static void *recv_adev_thread(void *arg);
 #endif
 
+#if __WIN32__
+static unsigned __stdcall recv_sdr_thread(void *arg);
+#else
+static void *recv_sdr_thread(void *arg);
+#endif
+
+#define RECV_BLOCK_SIZE 64 /* Audio samples per channel, per call to multi_modem_process_block. */
+
 static struct audio_s *save_pa; /* Keep pointer to audio configuration */
 								/* for later use. */
 
+/*
+ * For DEMODTHREADS, blocks of samples for each channel go from the audio
+ * device thread to the channel thread through this ring.
+ *
+ * head is only written by the audio thread and tail only by the channel thread.
+ * The mutex and conditions are used only to sleep when the ring is empty
+ * (channel thread) or full (audio thread).  Normally the audio thread never
+ * touches the mutex.
+ */
+
+#define RECV_RING_SIZE 128 /* Blocks.  Must be power of 2.  About 170 mS at 48000. */
+
+struct recv_wait_s
+{
+#if __WIN32__
+	HANDLE wake_up_event;
+#else
+	int sleeping;
+	pthread_cond_t wake_up_cond;
+#endif
+};
+
+static struct recv_ring_s
+{
+	int16_t samples[RECV_RING_SIZE][RECV_BLOCK_SIZE];
+	int n[RECV_RING_SIZE]; /* Number of samples in block.  -1 for end of audio. */
+
+	unsigned int head; /* Next to be filled.  Free running. */
+	unsigned int tail; /* Next to be processed. */
+
+	struct recv_wait_s reader; /* Channel thread waiting for data. */
+	struct recv_wait_s writer; /* Audio thread waiting for space. */
+
+#if __WIN32__
+	HANDLE thread;
+#else
+	dw_mutex_t wake_up_mutex;
+	pthread_t thread;
+#endif
+} ring[MAX_CHANS];
+
+#if __WIN32__
+static unsigned __stdcall recv_chan_thread(void *arg);
+#else
+static void *recv_chan_thread(void *arg);
+#endif
+
+/*
+ * Version 1.8: Input at a different rate, AINRATE, is resampled for each
+ * channel before the demodulators.  NULL when not needed.
+ */
+
+static struct resample_s *resampler[MAX_CHANS];
+
+/*
+ * Version 1.8: Decoding recorded files.  See recv_offline_report.
+ */
+
+static int all_files;  /* Every audio device is a recorded file. */
+static int files_left; /* Number still being read. */
+static int64_t start_time;
+static int64_t file_frames[MAX_ADEVS]; /* Audio frames read from each. */
+static int rec_frames[MAX_TOTAL_CHANS];
+
+static int is_file_input(int a)
+{
+	return (strncasecmp(save_pa->adev[a].adevice_in, "file:", 5) == 0);
+}
+
+/* Version 1.8: Channels of this device come from the SDR.  See sdr.c. */
+
+static int is_sdr_input(int a)
+{
+	return (strcasecmp(save_pa->adev[a].adevice_in, "sdr") == 0);
+}
+
+#define SDR_INPUT (-1) /* In place of an audio device number. */
+
+/* Does the audio for this radio channel come from audio device a, or SDR_INPUT? */
+
+static int fed_by(int chan, int a)
+{
+	if (a == SDR_INPUT)
+	{
+		return (save_pa->sdr.chan_hz[chan] != 0);
+	}
+	return (ACHAN2ADEV(chan) == a && save_pa->adev[a].defined && !is_sdr_input(a) &&
+			chan - ADEVFIRSTCHAN(a) < save_pa->adev[a].num_channels);
+}
+
+static void recv_input_end(int a, int file);
+
+static void recv_dispatch(int chan, const int16_t *samples, int n);
+
+static void recv_offline_report(void);
+
+/*
+ * Version 1.8: Received frame queues for RECVTHREADS.  1 if not used.
+ */
+
+static int num_shards = 1;
+
+#if __WIN32__
+static unsigned __stdcall recv_shard_thread(void *arg);
+#else
+static void *recv_shard_thread(void *arg);
+#endif
+
+static void recv_take_frames(int s);
+
 /*------------------------------------------------------------------
  *
  * Name:        recv_init
@@ -136,14 +287,155 @@ void recv_init(struct audio_s *pa)
 	pthread_t xmit_tid[MAX_ADEVS];
 #endif
 	int a;
+	int chan;
 
 	save_pa = pa;
 
+	start_time = audio_stats_clock();
+	all_files = recv_offline(pa);
+	for (a = 0; a < MAX_ADEVS; a++)
+	{
+		if (pa->adev[a].defined && is_file_input(a))
+			files_left++;
+	}
+	if (strncasecmp(pa->sdr.input, "file:", 5) == 0)
+		files_left++;
+
+	// Version 1.8: This sets the input rate for the channels from the SDR
+	// so they get resampled like any other audio below.
+
+	if (sdr_init(pa) < 0)
+	{
+
+		printf("FATAL: Could not set up the SDR input.\n");
+		exit(1);
+	}
+
+	/*
+	 * Version 1.8: A received frame queue and thread for each input.
+	 * Not for recorded files, where recv_process must see everything
+	 * has been processed before it exits.
+	 */
+
+	if (pa->recv_threads && !all_files)
+	{
+		int shard_of[MAX_CHANS];
+
+		memset(shard_of, 0, sizeof(shard_of));
+		num_shards = 0;
+		for (a = 0; a < MAX_ADEVS; a++)
+		{
+			if (pa->adev[a].defined && !is_sdr_input(a))
+			{
+				for (chan = 0; chan < MAX_CHANS; chan++)
+				{
+					if (fed_by(chan, a))
+						shard_of[chan] = num_shards;
+				}
+				num_shards++;
+			}
+		}
+		if (strlen(pa->sdr.input) > 0)
+		{
+			for (chan = 0; chan < MAX_CHANS; chan++)
+			{
+				if (fed_by(chan, SDR_INPUT))
+					shard_of[chan] = num_shards;
+			}
+			num_shards++;
+		}
+		if (num_shards < 1)
+			num_shards = 1;
+
+		dlq_set_shards(num_shards, shard_of);
+
+		for (int n = 1; n < num_shards; n++)
+		{
+#if __WIN32__
+			if (_beginthreadex(NULL, 0, recv_shard_thread, (void *)(ptrdiff_t)n, 0, NULL) == 0)
+			{
+
+				printf("FATAL: Could not create received frame thread %d.\n", n);
+				exit(1);
+			}
+#else
+			pthread_t tid;
+			int e = pthread_create(&tid, NULL, recv_shard_thread, (void *)(ptrdiff_t)n);
+			if (e != 0)
+			{
+
+				printf("FATAL: Could not create received frame thread %d.\n", n);
+				exit(1);
+			}
+			pthread_detach(tid);
+#endif
+		}
+		if (num_shards > 1)
+		{
+			printf("Received frames are processed by %d threads, one for each audio input.\n", num_shards);
+		}
+	}
+
+	if (pa->demod_threads > 0)
+	{
+		for (chan = 0; chan < MAX_CHANS; chan++)
+		{
+			// Same channels the audio device or SDR thread will feed.
+
+			if (!fed_by(chan, ACHAN2ADEV(chan)) && !fed_by(chan, SDR_INPUT))
+				continue;
+
+			struct recv_ring_s *r = &ring[chan];
+#if __WIN32__
+			r->reader.wake_up_event = CreateEvent(NULL, 0, 0, NULL);
+			r->writer.wake_up_event = CreateEvent(NULL, 0, 0, NULL);
+			r->thread = (HANDLE)_beginthreadex(NULL, 0, recv_chan_thread, (void *)(ptrdiff_t)chan, 0, NULL);
+			if (r->reader.wake_up_event == NULL || r->writer.wake_up_event == NULL || r->thread == NULL)
+			{
+
+				printf("FATAL: Could not create demodulator thread for channel %d.\n", chan);
+				exit(1);
+			}
+#else
+			dw_mutex_init(&r->wake_up_mutex);
+			pthread_cond_init(&r->reader.wake_up_cond, NULL);
+			pthread_cond_init(&r->writer.wake_up_cond, NULL);
+			int e = pthread_create(&r->thread, NULL, recv_chan_thread, (void *)(ptrdiff_t)chan);
+			if (e != 0)
+			{
+
+				printf("FATAL: Could not create demodulator thread for channel %d.\n", chan);
+				exit(1);
+			}
+#endif
+		}
+	}
+
 	for (a = 0; a < MAX_ADEVS; a++)
 	{
 
 		if (pa->adev[a].defined)
 		{
+			if (pa->adev[a].in_samples_per_sec != 0)
+			{
+				int c;
+
+				for (c = 0; c < pa->adev[a].num_channels; c++)
+				{
+					resampler[ADEVFIRSTCHAN(a) + c] = resample_create(pa->adev[a].in_samples_per_sec, pa->adev[a].samples_per_sec);
+					if (resampler[ADEVFIRSTCHAN(a) + c] == NULL)
+					{
+
+						printf("FATAL: Could not set up resampling for audio device %d.\n", a);
+						exit(1);
+					}
+				}
+				printf("Audio input at %d samples per second is resampled to %d for device %d.\n",
+					   pa->adev[a].in_samples_per_sec, pa->adev[a].samples_per_sec, a);
+			}
+
+			if (is_sdr_input(a))
+				continue;
 
 #if DEBUG
 
@@ -177,8 +469,197 @@ void recv_init(struct audio_s *pa)
 #endif
 	}
 
+	if (strlen(pa->sdr.input) > 0)
+	{
+#if __WIN32__
+		HANDLE sdr_th = (HANDLE)_beginthreadex(NULL, 0, recv_sdr_thread, NULL, 0, NULL);
+		if (sdr_th == NULL)
+		{
+
+			printf("FATAL: Could not create SDR receive thread.\n");
+			exit(1);
+		}
+#else
+		pthread_t sdr_tid;
+		int e = pthread_create(&sdr_tid, NULL, recv_sdr_thread, NULL);
+		if (e != 0)
+		{
+
+			printf("FATAL: Could not create SDR receive thread.\n");
+			exit(1);
+		}
+#endif
+	}
+
 } /* end recv_init */
 
+/*------------------------------------------------------------------
+ *
+ * Name:        ring_empty, ring_full
+ *
+ * Purpose:     Check the state of a channel's sample ring.
+ *
+ *		The audio thread publishes a filled block with a release
+ *		store of head and the channel thread gives it back the
+ *		same way with tail.
+ *
+ *----------------------------------------------------------------*/
+
+static int ring_empty(struct recv_ring_s *r)
+{
+	return (__atomic_load_n(&r->head, __ATOMIC_SEQ_CST) == __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST));
+}
+
+static int ring_full(struct recv_ring_s *r)
+{
+	return (__atomic_load_n(&r->head, __ATOMIC_SEQ_CST) - __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) >= RECV_RING_SIZE);
+}
+
+/* Sleep while busy(r) is true.  The other side calls ring_wake after changing head or tail. */
+
+static void ring_sleep_while(struct recv_ring_s *r, struct recv_wait_s *w, int (*busy)(struct recv_ring_s *))
+{
+	if (!busy(r))
+		return;
+
+#if __WIN32__
+	while (busy(r))
+	{
+		WaitForSingleObject(w->wake_up_event, 100);
+	}
+#else
+	dw_mutex_lock(&r->wake_up_mutex);
+	__atomic_store_n(&w->sleeping, 1, __ATOMIC_SEQ_CST);
+	while (busy(r))
+	{
+		pthread_cond_wait(&w->wake_up_cond, &r->wake_up_mutex);
+	}
+	__atomic_store_n(&w->sleeping, 0, __ATOMIC_SEQ_CST);
+	dw_mutex_unlock(&r->wake_up_mutex);
+#endif
+}
+
+static void ring_wake(struct recv_ring_s *r, struct recv_wait_s *w)
+{
+#if __WIN32__
+	SetEvent(w->wake_up_event);
+#else
+	if (__atomic_load_n(&w->sleeping, __ATOMIC_SEQ_CST))
+	{
+		dw_mutex_lock(&r->wake_up_mutex);
+		pthread_cond_signal(&w->wake_up_cond);
+		dw_mutex_unlock(&r->wake_up_mutex);
+	}
+#endif
+}
+
+/* Audio device thread side.  n = -1 marks end of audio. */
+
+static void ring_put(int chan, const int16_t *samples, int n)
+{
+	struct recv_ring_s *r = &ring[chan];
+
+	ring_sleep_while(r, &r->writer, ring_full);
+
+	unsigned int h = r->head;
+	if (n > 0)
+	{
+		memcpy(r->samples[h & (RECV_RING_SIZE - 1)], samples, n * sizeof(int16_t));
+	}
+	r->n[h & (RECV_RING_SIZE - 1)] = n;
+	__atomic_store_n(&r->head, h + 1, __ATOMIC_SEQ_CST);
+
+	ring_wake(r, &r->reader);
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        recv_dispatch
+ *
+ * Purpose:     Pass audio for one channel to the demodulators, either
+ *		directly or through the ring for DEMODTHREADS.
+ *
+ * Inputs:	chan	- Radio channel.
+ *		samples	- Audio samples.
+ *		n	- Number of samples.  Can be more than a block after
+ *			  resampling to a higher rate.
+ *
+ *----------------------------------------------------------------*/
+
+static void recv_dispatch(int chan, const int16_t *samples, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k += RECV_BLOCK_SIZE)
+	{
+		int len = n - k < RECV_BLOCK_SIZE ? n - k : RECV_BLOCK_SIZE;
+
+		if (save_pa->demod_threads > 0)
+		{
+			ring_put(chan, samples + k, len);
+		}
+		else
+		{
+			multi_modem_process_block(chan, samples + k, len);
+		}
+	}
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        recv_chan_thread
+ *
+ * Purpose:     Run the demodulators for one channel with DEMODTHREADS.
+ *
+ * Inputs:	arg	- Radio channel number.
+ *
+ * Description:	Blocks are processed one at a time, straight out of the ring,
+ *		rather than combined into something larger.  Candidate
+ *		frames are aged by the block size so a bigger one would
+ *		mean picking before the other decoders have had a chance.
+ *
+ *----------------------------------------------------------------*/
+
+__attribute__((hot))
+#if __WIN32__
+static unsigned __stdcall recv_chan_thread(void *arg)
+#else
+static void *
+recv_chan_thread(void *arg)
+#endif
+{
+	int chan = (int)(ptrdiff_t)arg;
+	struct recv_ring_s *r = &ring[chan];
+
+	dw_thread_sched(THREAD_DEMOD, chan);
+
+	while (1)
+	{
+		ring_sleep_while(r, &r->reader, ring_empty);
+
+		unsigned int t = r->tail;
+		int n = r->n[t & (RECV_RING_SIZE - 1)];
+
+		if (n < 0)
+			break;
+
+		multi_modem_process_block(chan, r->samples[t & (RECV_RING_SIZE - 1)], n);
+
+		__atomic_store_n(&r->tail, t + 1, __ATOMIC_SEQ_CST);
+
+		// When reading from a file, the audio thread is always waiting for
+		// space.  Let it refill half the ring at a time rather than waking
+		// it for every block.
+
+		if (__atomic_load_n(&r->head, __ATOMIC_SEQ_CST) - (t + 1) <= RECV_RING_SIZE / 2)
+		{
+			ring_wake(r, &r->writer);
+		}
+	}
+
+	return (0);
+}
+
 /* Try using "hot" attribute for all functions */
 /* which are used for each audio sample. */
 /* Compiler & linker might gather */
@@ -206,27 +687,71 @@ recv_adev_thread(void *arg)
 
 	printf("recv_adev_thread is now running for a=%d\n", a);
 #endif
+
+	dw_thread_sched(THREAD_AUDIO, a);
 	/*
 	 * Get sound samples and decode them.
+	 *
+	 * Samples are collected into a small block for each channel and the
+	 * whole block is passed along at once.  This cuts down on the per
+	 * sample overhead through the demodulators.  The block is only a
+	 * millisecond or two so it adds negligible delay.
 	 */
+	int16_t block[2][RECV_BLOCK_SIZE];
+
+	/*
+	 * Version 1.8: Optionally resampled.  Both channels of the device
+	 * have the same ratio and are done one after the other so one
+	 * buffer is enough.  It can be more than a block when the rate goes up.
+	 */
+	int16_t *rblock = NULL;
+
+	if (resampler[first_chan] != NULL)
+	{
+		rblock = malloc(resample_max_out(resampler[first_chan], RECV_BLOCK_SIZE) * sizeof(int16_t));
+		if (rblock == NULL)
+		{
+
+			printf("FATAL: Out of memory for audio resampling.\n");
+			exit(1);
+		}
+	}
+
 	eof = 0;
 	while (!eof)
 	{
-
-		int audio_sample;
+		int n;
 		int c;
 
+		/*
+		 * Version 1.8: Take a block for each channel at once rather than
+		 * assembling samples a byte at a time.  With ALSA mmap, this is
+		 * straight from the buffer shared with the sound card.
+		 */
+
+		n = audio_get_block(a, block[0], RECV_BLOCK_SIZE);
+		if (n <= 0)
+		{
+			eof = 1;
+			break;
+		}
+		file_frames[a] += n;
+
 		for (c = 0; c < num_chan; c++)
 		{
-			audio_sample = demod_get_sample(a);
+			const int16_t *samples = block[c];
+			int m = n;
 
-			if (audio_sample >= 256 * 256)
-				eof = 1;
+			if (resampler[first_chan + c] != NULL)
+			{
+				m = resample_block(resampler[first_chan + c], block[c], n, rblock);
+				samples = rblock;
+			}
 
 			// Future?  provide more flexible mapping.
 			// i.e. for each valid channel where audio_source[] is first_chan+c.
-			multi_modem_process_sample(first_chan + c, audio_sample);
-		} // for c is just 0 or 0 then 1
+			recv_dispatch(first_chan + c, samples, m);
+		}
 
 		/* When a complete frame is accumulated, */
 		/* dlq_rec_frame, is called. */
@@ -235,6 +760,168 @@ recv_adev_thread(void *arg)
 
 	} // while !eof on audio stream
 
+	free(rblock);
+	recv_input_end(a, is_file_input(a));
+
+#if __WIN32__
+	return (0);
+#else
+	return (NULL);
+#endif
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        recv_sdr_thread
+ *
+ * Purpose:     Same as recv_adev_thread for all of the channels
+ *		split out of the SDR input.  See sdr.c.
+ *
+ *----------------------------------------------------------------*/
+
+__attribute__((hot))
+#if __WIN32__
+static unsigned __stdcall recv_sdr_thread(void *arg)
+#else
+static void *
+recv_sdr_thread(void *arg)
+#endif
+{
+	static int16_t block[MAX_CHANS][RECV_BLOCK_SIZE];
+	int16_t *rblock = NULL;
+	int max_out = 0;
+	int first_adev = -1;
+	int chan;
+
+	(void)arg;
+
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		if (fed_by(chan, SDR_INPUT) && first_adev < 0)
+		{
+			first_adev = ACHAN2ADEV(chan);
+		}
+		if (fed_by(chan, SDR_INPUT) && resampler[chan] != NULL && resample_max_out(resampler[chan], RECV_BLOCK_SIZE) > max_out)
+		{
+			max_out = resample_max_out(resampler[chan], RECV_BLOCK_SIZE);
+		}
+	}
+	if (max_out > 0)
+	{
+		rblock = malloc(max_out * sizeof(int16_t));
+		if (rblock == NULL)
+		{
+
+			printf("FATAL: Out of memory for audio resampling.\n");
+			exit(1);
+		}
+	}
+
+	dw_thread_sched(THREAD_AUDIO, first_adev);
+
+	while (sdr_get_block(block[0], RECV_BLOCK_SIZE) > 0)
+	{
+		for (chan = 0; chan < MAX_CHANS; chan++)
+		{
+			const int16_t *samples = block[chan];
+			int m = RECV_BLOCK_SIZE;
+
+			if (!fed_by(chan, SDR_INPUT))
+				continue;
+
+			// Count once for each device.
+
+			if (chan == ADEVFIRSTCHAN(ACHAN2ADEV(chan)) || !fed_by(chan - 1, SDR_INPUT))
+			{
+				file_frames[ACHAN2ADEV(chan)] += RECV_BLOCK_SIZE;
+			}
+
+			if (resampler[chan] != NULL)
+			{
+				m = resample_block(resampler[chan], block[chan], RECV_BLOCK_SIZE, rblock);
+				samples = rblock;
+			}
+			recv_dispatch(chan, samples, m);
+		}
+	}
+
+	free(rblock);
+	recv_input_end(SDR_INPUT, strncasecmp(save_pa->sdr.input, "file:", 5) == 0);
+
+#if __WIN32__
+	return (0);
+#else
+	return (NULL);
+#endif
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        recv_input_end
+ *
+ * Purpose:     Finish up after the end of the input for an audio
+ *		device or the SDR.
+ *
+ * Inputs:	a	- Audio device number or SDR_INPUT.
+ *		file	- True for a recording.
+ *
+ * Description:	For a recording, push out the last frames and let
+ *		recv_process finish.  Otherwise, the input failed.
+ *
+ *----------------------------------------------------------------*/
+
+static void recv_input_end(int a, int file)
+{
+	static const int16_t silence[RECV_BLOCK_SIZE];
+	int chan, k;
+
+	// A frame right at the end of a recording is only picked from the
+	// candidates a few bit times later.  Give it a moment of silence.
+
+	if (file)
+	{
+		for (chan = 0; chan < MAX_CHANS; chan++)
+		{
+			if (!fed_by(chan, a))
+				continue;
+			for (k = 0; k < save_pa->adev[ACHAN2ADEV(chan)].samples_per_sec / 2; k += RECV_BLOCK_SIZE)
+			{
+				recv_dispatch(chan, silence, RECV_BLOCK_SIZE);
+			}
+		}
+	}
+
+	// Let the channel threads finish what was already captured.
+	// Matters for reading from a file or stdin.
+
+	if (save_pa->demod_threads > 0)
+	{
+		for (chan = 0; chan < MAX_CHANS; chan++)
+		{
+			if (fed_by(chan, a))
+				ring_put(chan, NULL, -1);
+		}
+		for (chan = 0; chan < MAX_CHANS; chan++)
+		{
+			if (!fed_by(chan, a))
+				continue;
+#if __WIN32__
+			WaitForSingleObject(ring[chan].thread, INFINITE);
+#else
+			pthread_join(ring[chan].thread, NULL);
+#endif
+		}
+	}
+
+	// Version 1.8: End of a recording is not a failure.
+	// recv_process finishes up after the last one.
+
+	if (file)
+	{
+		__atomic_sub_fetch(&files_left, 1, __ATOMIC_SEQ_CST);
+		return;
+	}
+
 	// What should we do now?
 	// Seimply terminate the application?
 	// Try to re-init the audio device a couple times before giving up?
@@ -243,44 +930,212 @@ recv_adev_thread(void *arg)
 	exit(1);
 }
 
-void recv_process(void)
+/*------------------------------------------------------------------
+ *
+ * Name:        recv_offline
+ *
+ * Purpose:     Find out whether we are only decoding recorded files.
+ *
+ * Inputs:      pa		- Audio configuration.
+ *
+ * Returns:     1 if every audio device input is "file:", or the SDR
+ *		is reading a recording.
+ *
+ * Description:	Version 1.8.  There is nobody waiting for the frames
+ *		in real time so they should all be printed, no matter
+ *		how long it takes, and we exit at the end.
+ *
+ *----------------------------------------------------------------*/
+
+int recv_offline(struct audio_s *pa)
 {
+	int a;
+	int n = 0;
+
+	for (a = 0; a < MAX_ADEVS; a++)
+	{
+		if (pa->adev[a].defined)
+		{
+			if (strcasecmp(pa->adev[a].adevice_in, "sdr") == 0)
+			{
+				if (strncasecmp(pa->sdr.input, "file:", 5) != 0)
+					return (0);
+			}
+			else if (strncasecmp(pa->adev[a].adevice_in, "file:", 5) != 0)
+				return (0);
+			n++;
+		}
+	}
+	return (n > 0);
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        recv_offline_report
+ *
+ * Purpose:     Say how decoding the recorded files went.
+ *
+ * Description:	Samples per second are for the audio as recorded,
+ *		before any resampling.  Time is from recv_init so it
+ *		includes waiting for the last frames to be processed.
+ *
+ *----------------------------------------------------------------*/
+
+static void recv_offline_report(void)
+{
+	double elapsed = (audio_stats_clock() - start_time) / 1000000.;
+	double audio_sec = 0;
+	int64_t samples = 0;
+	int total = 0;
+	int a, chan;
+
+	if (elapsed <= 0)
+		elapsed = 1e-6;
+
+	for (chan = 0; chan < MAX_TOTAL_CHANS; chan++)
+	{
+		total += rec_frames[chan];
+	}
+
+	for (a = 0; a < MAX_ADEVS; a++)
+	{
+		if (save_pa->adev[a].defined)
+		{
+			int rate = save_pa->adev[a].in_samples_per_sec ? save_pa->adev[a].in_samples_per_sec : save_pa->adev[a].samples_per_sec;
+			int64_t n = file_frames[a] * save_pa->adev[a].num_channels;
+
+			samples += n;
+			audio_sec += (double)file_frames[a] / rate;
+			printf("Audio device %d: %s, %.1f seconds, %.0f samples per second.\n",
+				   a, is_file_input(a) ? save_pa->adev[a].adevice_in + 5 : save_pa->sdr.input + 5,
+				   (double)file_frames[a] / rate, n / elapsed);
+		}
+	}
+
+	for (chan = 0; chan < MAX_TOTAL_CHANS; chan++)
+	{
+		if (rec_frames[chan] > 0)
+		{
+			printf("Channel %d: %d frames decoded.\n", chan, rec_frames[chan]);
+		}
+	}
+
+	printf("%d frames decoded from %.1f seconds of audio in %.2f seconds.\n", total, audio_sec, elapsed);
+	printf("%.0f samples per second, %.1f times real time.\n", samples / elapsed, audio_sec / elapsed);
+}
 
-	struct dlq_item_s *pitem;
+/*-------------------------------------------------------------------
+ *
+ * Name:        recv_process
+ *
+ * Purpose:     Process received frames from the queue.  Does not return.
+ *
+ * Description:	With RECVTHREADS, this takes only the first queue.
+ *		It also does the things that must happen once, such as
+ *		latency reports and the end of recorded files.
+ *
+ *--------------------------------------------------------------------*/
 
+void recv_process(void)
+{
 	while (1)
 	{
 
 		/* Wait for something to show up in the queue. */
-		int timed_out = dlq_wait_while_empty(0.1);
+		int timed_out = dlq_wait_while_empty(0, 0.1);
+
+		if (rxlat_report_due())
+		{
+			rxlat_print();
+		}
+
 		if (timed_out)
 		{
+			if (all_files && __atomic_load_n(&files_left, __ATOMIC_SEQ_CST) == 0)
+			{
+				recv_offline_report();
+				exit(EXIT_SUCCESS);
+			}
 			continue;
 		}
 
-		pitem = dlq_remove();
+		recv_take_frames(0);
+	}
+} /* end recv_process */
 
-#if DEBUG
+/* Version 1.8: Take the other queues for RECVTHREADS. */
 
-		printf("recv_process: dlq_remove() returned pitem=%p\n", pitem);
+#if __WIN32__
+static unsigned __stdcall recv_shard_thread(void *arg)
+#else
+static void *recv_shard_thread(void *arg)
 #endif
+{
+	int s = (int)(ptrdiff_t)arg;
 
-		if (pitem != NULL)
+	while (1)
+	{
+		if (!dlq_wait_while_empty(s, 0.0))
 		{
-			/*
-			 * This is the traditional processing.
-			 * For all frames:
-			 *	- Print in standard monitoring format.
-			 *	- Send to KISS client applications.
-			 *	- Send to AGw client applications in raw mode.
-			 * For APRS frames:
-			 *	- Explain what it means.
-			 *	- Send to Igate.
-			 *	- Digipeater.
-			 */
-			app_process_rec_packet(pitem->chan, pitem->subchan, pitem->slice, pitem->pp, pitem->alevel, pitem->fec_type, pitem->retries, pitem->spectrum);
+			recv_take_frames(s);
 		}
 	}
-} /* end recv_process */
+#if __WIN32__
+	return (0);
+#else
+	return (NULL);
+#endif
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        recv_take_frames
+ *
+ * Purpose:     Process everything waiting in one received frame queue.
+ *
+ * Inputs:	s	- Which queue.
+ *
+ * Description:	Take everything that has arrived, rather than one per
+ *		wake up.  KISS network clients get the whole batch in one
+ *		write.  The batch is kept by each thread, not shared.
+ *
+ *--------------------------------------------------------------------*/
+
+static void recv_take_frames(int s)
+{
+	struct dlq_item_s *pitem, *next;
+
+	kissnet_batch_begin();
+
+	for (pitem = dlq_remove_all(s); pitem != NULL; pitem = next)
+	{
+		next = pitem->nextp;
+
+#if DEBUG
+
+		printf("recv_process: dlq_remove_all() returned pitem=%p\n", pitem);
+#endif
+
+		/*
+		 * This is the traditional processing.
+		 * For all frames:
+		 *	- Print in standard monitoring format.
+		 *	- Send to KISS client applications.
+		 *	- Send to AGw client applications in raw mode.
+		 * For APRS frames:
+		 *	- Explain what it means.
+		 *	- Send to Igate.
+		 *	- Digipeater.
+		 */
+		rxlat_stage(pitem->pp, RXLAT_QUEUE);
+		rxlat_batch_add(pitem->pp);
+
+		app_process_rec_packet(pitem->chan, pitem->subchan, pitem->slice, pitem->pp, pitem->alevel, pitem->fec_type, pitem->retries, pitem->spectrum);
+		rec_frames[pitem->chan]++;
+	}
+
+	kissnet_batch_end();
+	rxlat_batch_end();
+}
 
 /* end recv.c */
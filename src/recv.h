@@ -3,4 +3,6 @@
 
 void recv_init(struct audio_s *pa);
 
-void recv_process(void);
\ No newline at end of file
+void recv_process(void);
+
+int recv_offline(struct audio_s *pa);
\ No newline at end of file
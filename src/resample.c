@@ -0,0 +1,260 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      resample.c
+ *
+ * Purpose:   	Change the audio sample rate between the source and
+ *		the demodulators.
+ *
+ * Description:	Version 1.8.
+ *
+ *		SDR programs produce rates like 96k, 192k, or 240k which
+ *		are far more than we need and not always something the
+ *		demodulators are tuned for.  Previously these had to go
+ *		through a separate resampling program in a pipe.
+ *
+ *		This is a polyphase rational resampler.  The rate is
+ *		changed by L/M, the ratio of output to input rates in
+ *		lowest terms.  Conceptually, L-1 zeros are inserted after
+ *		each input sample, the result is low pass filtered, and
+ *		every M'th sample is kept.  In practice, only the filter
+ *		taps that line up with real input samples, for the outputs
+ *		we keep, are ever used.  Those fall into L sets, or phases,
+ *		of consecutive taps, each used as an ordinary FIR filter
+ *		over the most recent input samples.  That is the same
+ *		dot product the demodulators use, with the same vectorized
+ *		kernel from dsp_kernel.c.
+ *
+ *		Configuration:
+ *
+ *			AINRATE  samples-per-second
+ *
+ *		The input comes in at that rate and the demodulators,
+ *		and everything else, see the ARATE rate.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "audio.h"
+#include "fsk_demod_state.h"
+#include "dsp.h"
+#include "dsp_kernel.h"
+#include "resample.h"
+
+/*
+ * Length of the prototype filter is this times the larger of L and M.
+ * Each phase ends up with this many taps times M/L, rounded up, or this
+ * many when increasing the rate.  The Blackman window transition band
+ * is then over by about 0.6 of the lower rate, leaving a clean band well
+ * above anything the demodulators care about.
+ */
+
+#define RESAMPLE_TAPS_PER_PHASE 16
+
+/* An awkward ratio, e.g. 44100 to 48000 with L=160, needs a lot of phases. */
+
+#define RESAMPLE_MAX_PHASES 1024
+
+struct resample_s
+{
+	int L;		  /* Interpolation factor. */
+	int M;		  /* Decimation factor. */
+	int taps;	  /* Taps for each phase. */
+	float *phase; /* L sets of taps, each newest sample first. */
+	int pos;	  /* Position of next output, in units of 1/L input sample, */
+				  /* relative to the most recent input sample. */
+	delay_line_t in;
+};
+
+static int gcd(int a, int b)
+{
+	while (b != 0)
+	{
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return (a);
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        resample_create
+ *
+ * Purpose:     Set up for changing the sample rate.
+ *
+ * Inputs:	in_rate		- Input samples per second.
+ *		out_rate	- Output samples per second.
+ *
+ * Returns:	Resampler state or NULL if the ratio can't be handled.
+ *		A message has already been printed.
+ *
+ * Description:	The prototype low pass filter runs at L times the input
+ *		rate.  Cutoff is a little below half of the lower of the
+ *		two rates so nothing folds back into the output when
+ *		decreasing the rate, and the images are removed when
+ *		increasing it.  The taps are multiplied by L to make up
+ *		for the inserted zeros.
+ *
+ *		Tap j of phase p is tap p + j*L of the prototype.  It gets
+ *		multiplied by the input sample j back from the most recent,
+ *		which is the order delay_line_window provides.
+ *
+ *----------------------------------------------------------------*/
+
+struct resample_s *resample_create(int in_rate, int out_rate)
+{
+	struct resample_s *r;
+	float *proto;
+	int g, mx, proto_taps, p, j;
+
+	assert(in_rate > 0 && out_rate > 0);
+
+	g = gcd(in_rate, out_rate);
+	r = calloc(1, sizeof(struct resample_s));
+	if (r == NULL)
+	{
+		return (NULL);
+	}
+	r->L = out_rate / g;
+	r->M = in_rate / g;
+
+	mx = r->L > r->M ? r->L : r->M;
+	r->taps = (RESAMPLE_TAPS_PER_PHASE * mx + r->L - 1) / r->L;
+
+	if (r->L > RESAMPLE_MAX_PHASES || r->taps > MAX_FILTER_SIZE)
+	{
+		printf("Can't resample audio from %d to %d samples per second.\n", in_rate, out_rate);
+		printf("Ratio %d/%d is too awkward.  Pick rates with more in common.\n", r->L, r->M);
+		free(r);
+		return (NULL);
+	}
+
+	proto_taps = r->taps * r->L;
+	proto = malloc(proto_taps * sizeof(float));
+	r->phase = malloc(proto_taps * sizeof(float));
+	if (proto == NULL || r->phase == NULL)
+	{
+		free(proto);
+		resample_delete(r);
+		return (NULL);
+	}
+
+	gen_lowpass(0.45f / mx, proto, proto_taps, BP_WINDOW_BLACKMAN);
+
+	for (p = 0; p < r->L; p++)
+	{
+		for (j = 0; j < r->taps; j++)
+		{
+			r->phase[p * r->taps + j] = proto[p + j * r->L] * r->L;
+		}
+	}
+	free(proto);
+
+	delay_line_init(&r->in, r->taps);
+	r->pos = 0;
+
+	return (r);
+
+} /* end resample_create */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        resample_max_out
+ *
+ * Purpose:     Find output buffer size needed for resample_block.
+ *
+ * Inputs:	r	- From resample_create.
+ *		n_in	- Number of input samples.
+ *
+ * Returns:	Most output samples that can result.
+ *
+ *----------------------------------------------------------------*/
+
+int resample_max_out(const struct resample_s *r, int n_in)
+{
+	return ((int)(((int64_t)n_in * r->L + r->M - 1) / r->M) + 1);
+}
+
+/*------------------------------------------------------------------
+ *
+ * Name:        resample_block
+ *
+ * Purpose:     Change the sample rate of a block of audio samples.
+ *
+ * Inputs:	r	- From resample_create.
+ *		in	- Input samples, one channel.
+ *		n_in	- Number of input samples.
+ *
+ * Outputs:	out	- Resampled audio.  See resample_max_out for size.
+ *
+ * Returns:	Number of output samples.
+ *
+ * Description:	State is kept between calls so the blocks can be any size.
+ *		Outputs are due when pos, which steps by M for each one, is
+ *		within the interval after the most recent input sample.
+ *		The remainder is the phase.
+ *
+ *----------------------------------------------------------------*/
+
+__attribute__((hot)) int resample_block(struct resample_s *r, const int16_t *in, int n_in, int16_t *out)
+{
+	int n_out = 0;
+	int k;
+
+	for (k = 0; k < n_in; k++)
+	{
+		delay_line_push(&r->in, in[k]);
+
+		while (r->pos < r->L)
+		{
+			float y = dsp_convolve(delay_line_window(&r->in), r->phase + r->pos * r->taps, r->taps);
+			int s = (int)(y >= 0 ? y + 0.5f : y - 0.5f);
+
+			if (s > 32767)
+				s = 32767;
+			else if (s < -32768)
+				s = -32768;
+			out[n_out++] = s;
+			r->pos += r->M;
+		}
+		r->pos -= r->L;
+	}
+
+	return (n_out);
+
+} /* end resample_block */
+
+void resample_delete(struct resample_s *r)
+{
+	if (r != NULL)
+	{
+		free(r->phase);
+		delay_line_free(&r->in);
+		free(r);
+	}
+}
+
+/* end resample.c */
@@ -0,0 +1,21 @@
+
+/* resample.h */
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H 1
+
+#include <stdint.h>
+
+struct resample_s;
+
+struct resample_s *resample_create(int in_rate, int out_rate);
+
+int resample_max_out(const struct resample_s *r, int n_in);
+
+int resample_block(struct resample_s *r, const int16_t *in, int n_in, int16_t *out);
+
+void resample_delete(struct resample_s *r);
+
+#endif
+
+/* end resample.h */
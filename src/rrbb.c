@@ -30,6 +30,12 @@
  *
  * Version 1.3:	Store as bytes rather than packing 8 bits per byte.
  *
+ * Version 1.8:	Pack them again, 64 per word, so the fix up attempts
+ *		can work on a word at a time.
+ *
+ *		Take them from a preallocated pool rather than using
+ *		malloc & free for every frame candidate.
+ *
  *******************************************************************************/
 
 #define RRBB_C
@@ -47,8 +53,169 @@
 #define MAGIC1 0x12344321
 #define MAGIC2 0x56788765
 
-volatile static int new_count = 0;
-volatile static int delete_count = 0;
+/* Version 1.8: Several demodulator and fix up threads use these at once. */
+
+static int new_count = 0;
+static int delete_count = 0;
+
+/*
+ * Pool of preallocated bit buffers.
+ *
+ * Every slicer of every demodulator keeps one buffer and hands it over
+ * to hdlc_rec2_block when a frame ends.  A noise burst means many short
+ * lived candidates, possibly from several demodulator threads at once.
+ *
+ * The free list is a stack of indexes into the slab.  The head holds the
+ * index + 1 of the top entry (0 for empty) in the low 32 bits and a count
+ * of changes in the upper 32 bits so a compare & swap can't be fooled
+ * by an entry being popped and pushed again in between (the ABA problem).
+ *
+ * If the pool runs out we fall back to malloc.
+ */
+
+static struct rrbb_s *pool = NULL;
+static int *pool_next = NULL;
+static int pool_size = 0;
+
+/*
+ * Version 1.8: Optionally, a confidence for each bit, so the fix up
+ * attempts can start with the least certain ones.  Only allocated
+ * when something will use it.
+ */
+
+static int soft_bits = 0;
+
+static uint64_t pool_head = 0;
+
+static int pool_in_use = 0;
+static int pool_high_water = 0;
+static int pool_exhausted = 0;
+
+/***********************************************************************************
+ *
+ * Name:	rrbb_pool_init
+ *
+ * Purpose:	Allocate the pool of bit buffers.
+ *
+ * Inputs:	num	- Number of buffers.  hdlc_rec_init figures this out
+ *			  from the number of channels, subchannels, and slicers.
+ *
+ *		soft	- Also keep a confidence for each bit.
+ *
+ * Description:	Must be called before any demodulator thread is started.
+ *		Calling more than once, or never, is harmless.  It just
+ *		means the extra, or all, buffers come from malloc.
+ *
+ ***********************************************************************************/
+
+void rrbb_pool_init(int num, int soft)
+{
+	int n;
+
+	if (pool != NULL || num <= 0)
+	{
+		return;
+	}
+	soft_bits = soft;
+
+	pool = calloc(num, sizeof(struct rrbb_s));
+	pool_next = calloc(num, sizeof(int));
+	if (pool == NULL || pool_next == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	pool_size = num;
+
+	if (soft_bits)
+	{
+		unsigned char *conf = malloc((size_t)num * MAX_NUM_BITS);
+
+		if (conf == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		for (n = 0; n < num; n++)
+		{
+			pool[n].conf = conf + (size_t)n * MAX_NUM_BITS;
+		}
+	}
+
+	for (n = 0; n < num; n++)
+	{
+		pool_next[n] = n + 2 <= num ? n + 2 : 0; /* index + 1 of next free.  0 for end. */
+	}
+	__atomic_store_n(&pool_head, (uint64_t)1, __ATOMIC_SEQ_CST);
+}
+
+static struct rrbb_s *pool_get(void)
+{
+	uint64_t head = __atomic_load_n(&pool_head, __ATOMIC_SEQ_CST);
+	uint64_t next;
+	int top;
+
+	do
+	{
+		top = (int)(head & 0xffffffff);
+		if (top == 0)
+		{
+			return (NULL);
+		}
+		next = ((head >> 32) + 1) << 32 | (uint32_t)__atomic_load_n(&pool_next[top - 1], __ATOMIC_SEQ_CST);
+	} while (!__atomic_compare_exchange_n(&pool_head, &head, next, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+	int used = __atomic_add_fetch(&pool_in_use, 1, __ATOMIC_SEQ_CST);
+	int high = __atomic_load_n(&pool_high_water, __ATOMIC_SEQ_CST);
+	while (used > high && !__atomic_compare_exchange_n(&pool_high_water, &high, used, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		;
+
+	return (pool + top - 1);
+}
+
+static int pool_put(struct rrbb_s *b)
+{
+	uint64_t head;
+	uint64_t next;
+	int n;
+
+	if (pool == NULL || b < pool || b >= pool + pool_size)
+	{
+		return (0); /* Not ours.  Came from malloc. */
+	}
+	n = b - pool;
+
+	head = __atomic_load_n(&pool_head, __ATOMIC_SEQ_CST);
+	do
+	{
+		__atomic_store_n(&pool_next[n], (int)(head & 0xffffffff), __ATOMIC_SEQ_CST);
+		next = ((head >> 32) + 1) << 32 | (uint32_t)(n + 1);
+	} while (!__atomic_compare_exchange_n(&pool_head, &head, next, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+	__atomic_sub_fetch(&pool_in_use, 1, __ATOMIC_SEQ_CST);
+	return (1);
+}
+
+/***********************************************************************************
+ *
+ * Name:	rrbb_pool_stats
+ *
+ * Purpose:	Find out how well the pool size fits actual usage.
+ *
+ * Outputs:	size		- Number of buffers in the pool.
+ *		in_use		- Number currently taken from the pool.
+ *		high_water	- Most ever taken at the same time.
+ *		exhausted	- Number of times we had to use malloc instead.
+ *
+ ***********************************************************************************/
+
+void rrbb_pool_stats(int *size, int *in_use, int *high_water, int *exhausted)
+{
+	*size = pool_size;
+	*in_use = __atomic_load_n(&pool_in_use, __ATOMIC_SEQ_CST);
+	*high_water = __atomic_load_n(&pool_high_water, __ATOMIC_SEQ_CST);
+	*exhausted = __atomic_load_n(&pool_exhausted, __ATOMIC_SEQ_CST);
+}
 
 /***********************************************************************************
  *
@@ -82,7 +249,19 @@ rrbb_t rrbb_new(int chan, int subchan, int slice, int is_scrambled, int descram_
 	assert(subchan >= 0 && subchan < MAX_SUBCHANS);
 	assert(slice >= 0 && slice < MAX_SLICERS);
 
-	result = malloc(sizeof(struct rrbb_s));
+	result = pool_get();
+	if (result == NULL)
+	{
+		if (__atomic_add_fetch(&pool_exhausted, 1, __ATOMIC_SEQ_CST) == 1 && pool_size > 0)
+		{
+			printf("Raw bit buffer pool of %d is exhausted.  Using malloc.\n", pool_size);
+		}
+		result = malloc(sizeof(struct rrbb_s));
+		if (result != NULL)
+		{
+			result->conf = soft_bits ? malloc(MAX_NUM_BITS) : NULL;
+		}
+	}
 	if (result == NULL)
 	{
 
@@ -95,12 +274,13 @@ rrbb_t rrbb_new(int chan, int subchan, int slice, int is_scrambled, int descram_
 	result->slice = slice;
 	result->magic2 = MAGIC2;
 
-	new_count++;
+	int nc = __atomic_add_fetch(&new_count, 1, __ATOMIC_RELAXED);
+	int dc = __atomic_load_n(&delete_count, __ATOMIC_RELAXED);
 
-	if (new_count > delete_count + 100)
+	if (nc > dc + 100)
 	{
 
-		printf("MEMORY LEAK, rrbb_new, new_count=%d, delete_count=%d\n", new_count, delete_count);
+		printf("MEMORY LEAK, rrbb_new, new_count=%d, delete_count=%d\n", nc, dc);
 	}
 
 	rrbb_clear(result, is_scrambled, descram_state, prev_descram);
@@ -140,6 +320,7 @@ void rrbb_clear(rrbb_t b, int is_scrambled, int descram_state, int prev_descram)
 	b->alevel.space = 9999;
 
 	b->len = 0;
+	b->has_conf = 0;
 
 	b->is_scrambled = is_scrambled;
 	b->descram_state = descram_state;
@@ -181,6 +362,13 @@ void rrbb_chop8(rrbb_t b)
 	if (b->len >= 8)
 	{
 		b->len -= 8;
+
+		// Appending only sets bits so clear what was chopped off.
+
+		if (b->len & 63)
+		{
+			b->fdata[b->len >> 6] &= ((uint64_t)1 << (b->len & 63)) - 1;
+		}
 	}
 }
 
@@ -203,6 +391,41 @@ int rrbb_get_len(rrbb_t b)
 	return (b->len);
 }
 
+/***********************************************************************************
+ *
+ * Name:	rrbb_fingerprint
+ *
+ * Purpose:	Hash of the bits and length.
+ *
+ * Inputs:	Handle for bit array.
+ *
+ * Description:	Used by hdlc_rec.c to spot other slicers ending up with
+ *		exactly the same bits, so they don't all need to be decoded.
+ *		Unused bits of the last word are always 0 so whole words
+ *		can be used.
+ *
+ ***********************************************************************************/
+
+uint64_t rrbb_fingerprint(rrbb_t b)
+{
+	uint64_t h;
+	int w;
+
+	assert(b != NULL);
+	assert(b->magic1 == MAGIC1);
+	assert(b->magic2 == MAGIC2);
+
+	int nwords = (b->len + 63) / 64;
+
+	h = 0xcbf29ce484222325ULL ^ b->len;
+	for (w = 0; w < nwords; w++)
+	{
+		h = (h ^ b->fdata[w]) * 0x100000001b3ULL;
+		h ^= h >> 32;
+	}
+	return (h);
+}
+
 /***********************************************************************************
  *
  * Name:	rrbb_get_bit
@@ -262,9 +485,16 @@ void rrbb_delete(rrbb_t b)
 	b->magic1 = 0;
 	b->magic2 = 0;
 
-	free(b);
+	if (!pool_put(b))
+	{
+		if (b->conf != NULL)
+		{
+			free(b->conf);
+		}
+		free(b);
+	}
 
-	delete_count++;
+	__atomic_add_fetch(&delete_count, 1, __ATOMIC_RELAXED);
 }
 
 /***********************************************************************************
@@ -449,6 +679,86 @@ float rrbb_get_speed_error(rrbb_t b)
 	return (b->speed_error);
 }
 
+/***********************************************************************************
+ *
+ * Name:	rrbb_set_sample_time
+ *
+ * Purpose:	Remember when it was handed over to the fix up threads
+ *		so a result can be put in with the others from that time.
+ *
+ * Inputs:	b		Handle for bit array.
+ *		sample_time	From multi_modem_get_sample_time.
+ *
+ ***********************************************************************************/
+
+void rrbb_set_sample_time(rrbb_t b, unsigned int sample_time)
+{
+	assert(b != NULL);
+	assert(b->magic1 == MAGIC1);
+	assert(b->magic2 == MAGIC2);
+
+	b->sample_time = sample_time;
+}
+
+/***********************************************************************************
+ *
+ * Name:	rrbb_get_sample_time
+ *
+ * Purpose:	Get the time it was handed over to the fix up threads.
+ *
+ * Inputs:	b	Handle for bit array.
+ *
+ ***********************************************************************************/
+
+unsigned int rrbb_get_sample_time(rrbb_t b)
+{
+	assert(b != NULL);
+	assert(b->magic1 == MAGIC1);
+	assert(b->magic2 == MAGIC2);
+
+	return (b->sample_time);
+}
+
+/***********************************************************************************
+ *
+ * Name:	rrbb_set_end_time
+ *
+ * Purpose:	Remember when the closing flag was found, for receive
+ *		latency measurement.
+ *
+ * Inputs:	b		Handle for bit array.
+ *		end_time	From rxlat_now.  0 when not measuring.
+ *
+ ***********************************************************************************/
+
+void rrbb_set_end_time(rrbb_t b, int64_t end_time)
+{
+	assert(b != NULL);
+	assert(b->magic1 == MAGIC1);
+	assert(b->magic2 == MAGIC2);
+
+	b->end_time = end_time;
+}
+
+/***********************************************************************************
+ *
+ * Name:	rrbb_get_end_time
+ *
+ * Purpose:	Get the time the closing flag was found.
+ *
+ * Inputs:	b	Handle for bit array.
+ *
+ ***********************************************************************************/
+
+int64_t rrbb_get_end_time(rrbb_t b)
+{
+	assert(b != NULL);
+	assert(b->magic1 == MAGIC1);
+	assert(b->magic2 == MAGIC2);
+
+	return (b->end_time);
+}
+
 /***********************************************************************************
  *
  * Name:	rrbb_get_is_scrambled
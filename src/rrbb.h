@@ -3,7 +3,7 @@
 
 #define RRBB_H
 
-#define FASTER13 1 // Don't pack 8 samples per byte.
+#include <stdint.h>
 
 // typedef short slice_t;
 
@@ -21,6 +21,15 @@
 
 #define MAX_NUM_BITS (MAX_FRAME_LEN * 8 * 6 / 5)
 
+/*
+ * Version 1.8: Bits are packed 64 to a word again, oldest in the least
+ * significant bit.  Storing one bit per byte made each buffer several
+ * kilobytes and there is one for every channel, subchannel and slicer.
+ * The fix up attempts in hdlc_rec2.c now work on whole words.
+ */
+
+#define RRBB_NUM_WORDS ((MAX_NUM_BITS + 63) / 64)
+
 typedef struct rrbb_s
 {
 	int magic1;
@@ -32,17 +41,25 @@ typedef struct rrbb_s
 
 	alevel_t alevel;   /* Received audio level at time of frame capture. */
 	float speed_error; /* Received data speed error as percentage. */
+	unsigned int sample_time; /* See multi_modem_get_sample_time.  For fix up threads. */
+	int64_t end_time;		  /* From rxlat_now at the closing flag.  See rxlat.c. */
 	unsigned int len;  /* Current number of samples in array. */
 
 	int is_scrambled;  /* Is data scrambled G3RUH / K9NG style? */
 	int descram_state; /* Descrambler state before first data bit of frame. */
 	int prev_descram;  /* Previous descrambled bit. */
 
-	unsigned char fdata[MAX_NUM_BITS];
+	uint64_t fdata[RRBB_NUM_WORDS]; /* Bit n is (fdata[n/64] >> (n%64)) & 1.  Unused bits of the last word are 0. */
+
+	unsigned char *conf; /* Optional confidence, 0 to 100, for each bit.  NULL when not kept. */
+	int has_conf;		 /* Set when conf was filled in for these bits. */
 
 	int magic2;
 } *rrbb_t;
 
+void rrbb_pool_init(int num, int soft);
+void rrbb_pool_stats(int *size, int *in_use, int *high_water, int *exhausted);
+
 rrbb_t rrbb_new(int chan, int subchan, int slice, int is_scrambled, int descram_state, int prev_descram);
 
 void rrbb_clear(rrbb_t b, int is_scrambled, int descram_state, int prev_descram);
@@ -53,19 +70,86 @@ static inline /*__attribute__((always_inline))*/ void rrbb_append_bit(rrbb_t b,
 	{
 		return; /* Silently discard if full. */
 	}
-	b->fdata[b->len] = val;
+	if ((b->len & 63) == 0)
+	{
+		b->fdata[b->len >> 6] = 0;
+	}
+	b->fdata[b->len >> 6] |= (uint64_t)(val & 1) << (b->len & 63);
 	b->len++;
 }
 
+/* Append n bits, 1 to 32, oldest in the LSB.  Higher bits of val must be 0. */
+
+static inline void rrbb_append_bits(rrbb_t b, const uint64_t val, const int n)
+{
+	if (b->len + n > MAX_NUM_BITS)
+	{
+		int k;
+		for (k = 0; k < n; k++)
+		{
+			rrbb_append_bit(b, (val >> k) & 1);
+		}
+		return;
+	}
+	int w = b->len >> 6;
+	int o = b->len & 63;
+	if (o == 0)
+	{
+		b->fdata[w] = val;
+	}
+	else
+	{
+		b->fdata[w] |= val << o;
+		if (o + n > 64)
+		{
+			b->fdata[w + 1] = val >> (64 - o);
+		}
+	}
+	b->len += n;
+}
+
 static inline /*__attribute__((always_inline))*/ unsigned char rrbb_get_bit(const rrbb_t b, const int ind)
 {
-	return (b->fdata[ind]);
+	return ((b->fdata[ind >> 6] >> (ind & 63)) & 1);
+}
+
+/* 64 bits at a time.  Word w holds bits 64*w thru 64*w+63. */
+
+static inline uint64_t rrbb_get_bits(const rrbb_t b, const int w)
+{
+	return (b->fdata[w]);
+}
+
+/* Confidence for the n bits just appended, oldest first. */
+
+static inline void rrbb_append_conf(rrbb_t b, const unsigned char *q, int n)
+{
+	int first = (int)b->len - n;
+
+	if (b->conf == NULL || first < 0)
+	{
+		return;
+	}
+	for (int k = 0; k < n; k++)
+	{
+		b->conf[first + k] = q[k];
+	}
+	b->has_conf = 1;
+}
+
+/* NULL unless there is a confidence for each bit. */
+
+static inline const unsigned char *rrbb_get_conf(const rrbb_t b)
+{
+	return (b->has_conf ? b->conf : NULL);
 }
 
 void rrbb_chop8(rrbb_t b);
 
 int rrbb_get_len(rrbb_t b);
 
+uint64_t rrbb_fingerprint(rrbb_t b);
+
 // void rrbb_flip_bit (rrbb_t b, unsigned int ind);
 
 void rrbb_delete(rrbb_t b);
@@ -83,6 +167,12 @@ alevel_t rrbb_get_audio_level(rrbb_t b);
 void rrbb_set_speed_error(rrbb_t b, float speed_error);
 float rrbb_get_speed_error(rrbb_t b);
 
+void rrbb_set_sample_time(rrbb_t b, unsigned int sample_time);
+unsigned int rrbb_get_sample_time(rrbb_t b);
+
+void rrbb_set_end_time(rrbb_t b, int64_t end_time);
+int64_t rrbb_get_end_time(rrbb_t b);
+
 int rrbb_get_is_scrambled(rrbb_t b);
 int rrbb_get_descram_state(rrbb_t b);
 int rrbb_get_prev_descram(rrbb_t b);
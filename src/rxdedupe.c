@@ -0,0 +1,251 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      rxdedupe.c
+ *
+ * Purpose:   	Drop copies of a received frame which were already heard
+ *		on another channel a moment ago.
+ *
+ * Description:	Version 1.8.
+ *
+ *		A site with several receivers, or several channels split
+ *		out of one SDR stream, often hears the same transmission
+ *		more than once.  Without this, every copy is displayed and
+ *		sent to all of the KISS client applications which then
+ *		need to sort it out themselves.
+ *
+ *		Frames are matched with ax25_dedupe_crc, which covers the
+ *		source, destination, and information part but not the
+ *		digipeaters, along with the source address to make false
+ *		matches even less likely.  A copy is dropped only when the
+ *		first one was heard on a different channel within the last
+ *		few seconds.  Repeats on the same channel, such as the
+ *		original and a digipeated copy, are passed along as before.
+ *
+ *		The most recent frames are kept in a ring, oldest replaced
+ *		first, with a hash table of chains thru it for looking them
+ *		up.  Rather than unlinking an entry when it is replaced, each
+ *		link has the sequence number of the entry it points to.  A
+ *		mismatch means the rest of the chain is gone.  Everything
+ *		in a chain is newer than what follows so the walk also stops
+ *		at the first one too old to matter.
+ *
+ *		This is off unless the configuration has RXDEDUPE.
+ *		The threads taking frames from the received frame queues
+ *		check them, more than one with RECVTHREADS, so the table
+ *		has a lock.  The counters are also read by the metrics
+ *		server.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "ax25_pad.h"
+#include "audio_stats.h"
+#include "dwthread.h"
+#include "rxdedupe.h"
+
+struct entry_s
+{
+	uint32_t seq;	/* Sequence number when added.  0 for never used. */
+	uint32_t next;	/* Sequence number of next older entry in the same chain. */
+	int64_t time;	/* From audio_stats_clock, microseconds. */
+	unsigned short crc;
+	short chan;
+	char source[AX25_MAX_ADDR_LEN];
+};
+
+static int64_t window = 0; /* Microseconds.  0 when not enabled. */
+
+static struct entry_s *ring = NULL; /* Power of 2 size. */
+static uint32_t ring_mask;
+static uint32_t *chain = NULL; /* Newest entry for each hash, twice ring size. */
+static uint32_t chain_mask;
+static uint32_t next_seq = 1;
+
+static dw_mutex_t table_mutex;
+
+static int dropped[MAX_TOTAL_CHANS];
+static int evicted;
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxdedupe_init
+ *
+ * Purpose:     Turn on received duplicate suppression.
+ *
+ * Inputs:	seconds	- How long to remember each frame.  0 for off.
+ *		size	- Most frames to remember.  Rounded up to a power of 2.
+ *			  From the RXDEDUPE configuration command.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxdedupe_init(int seconds, int size)
+{
+	uint32_t n;
+
+	if (seconds <= 0)
+	{
+		return;
+	}
+
+	for (n = 16; n < (uint32_t)size; n <<= 1)
+		;
+
+	ring = calloc(n, sizeof(struct entry_s));
+	chain = calloc(2 * n, sizeof(uint32_t));
+	if (ring == NULL || chain == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	ring_mask = n - 1;
+	chain_mask = 2 * n - 1;
+	dw_mutex_init(&table_mutex);
+	window = (int64_t)seconds * 1000000;
+
+	printf("Frames heard again on another channel within %d seconds will be dropped.\n", seconds);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxdedupe_check
+ *
+ * Purpose:     See if a received frame is a copy of one already heard
+ *		on another channel.
+ *
+ * Inputs:	chan	- Channel where this one was heard.
+ *		pp	- Received frame.
+ *
+ * Returns:	1 if it should be dropped.  Otherwise it is remembered and 0.
+ *
+ *--------------------------------------------------------------------*/
+
+int rxdedupe_check(int chan, packet_t pp)
+{
+	char source[AX25_MAX_ADDR_LEN];
+	unsigned short crc;
+	uint32_t h, s;
+	int64_t now;
+	struct entry_s *e;
+	char *p;
+
+	assert(chan >= 0 && chan < MAX_TOTAL_CHANS);
+
+	if (window == 0 || ax25_get_num_addr(pp) < 2)
+	{
+		return (0);
+	}
+
+	ax25_get_addr_with_ssid(pp, AX25_SOURCE, source);
+	crc = ax25_dedupe_crc(pp);
+	now = audio_stats_clock();
+
+	h = crc;
+	for (p = source; *p != '\0'; p++)
+	{
+		h = h * 31 + (unsigned char)*p;
+	}
+	h = (h ^ (h >> 16)) & chain_mask;
+
+	dw_mutex_lock(&table_mutex);
+
+	for (s = chain[h]; s != 0; s = e->next)
+	{
+		e = &ring[s & ring_mask];
+		if (e->seq != s || now - e->time > window)
+		{
+			break;
+		}
+		if (e->crc == crc && strcmp(e->source, source) == 0)
+		{
+			dw_mutex_unlock(&table_mutex);
+			if (e->chan == chan)
+			{
+				return (0);
+			}
+			__atomic_add_fetch(&dropped[chan], 1, __ATOMIC_RELAXED);
+			return (1);
+		}
+	}
+
+	/* Not seen recently.  Replace the oldest. */
+
+	s = next_seq++;
+	if (s == 0)
+	{
+		s = next_seq++;
+	}
+	e = &ring[s & ring_mask];
+	if (e->seq != 0 && now - e->time <= window)
+	{
+		__atomic_add_fetch(&evicted, 1, __ATOMIC_RELAXED);
+	}
+	e->seq = s;
+	e->next = chain[h];
+	e->time = now;
+	e->crc = crc;
+	e->chan = chan;
+	snprintf(e->source, sizeof(e->source), "%s", source);
+	chain[h] = s;
+
+	dw_mutex_unlock(&table_mutex);
+	return (0);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxdedupe_stats
+ *
+ * Purpose:     Number of frames dropped because they were already
+ *		heard on another channel.
+ *
+ * Inputs:	chan	- Channel where the dropped copies were heard.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxdedupe_stats(int chan, int *count)
+{
+	assert(chan >= 0 && chan < MAX_TOTAL_CHANS);
+
+	*count = __atomic_load_n(&dropped[chan], __ATOMIC_RELAXED);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxdedupe_evicted_stats
+ *
+ * Purpose:     Number of frames forgotten before their time was up
+ *		because more were heard than RXDEDUPE has room for.
+ *		Copies of those would not be caught.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxdedupe_evicted_stats(int *count)
+{
+	*count = __atomic_load_n(&evicted, __ATOMIC_RELAXED);
+}
+
+/* end rxdedupe.c */
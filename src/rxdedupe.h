@@ -0,0 +1,26 @@
+
+/*------------------------------------------------------------------
+ *
+ * Module:      rxdedupe.h
+ *
+ * Purpose:   	Drop copies of a received frame which were already heard
+ *		on another channel.  See rxdedupe.c.
+ *
+ *---------------------------------------------------------------*/
+
+#ifndef RXDEDUPE_H
+#define RXDEDUPE_H 1
+
+#include "ax25_pad.h"
+
+void rxdedupe_init(int seconds, int size);
+
+int rxdedupe_check(int chan, packet_t pp);
+
+void rxdedupe_stats(int chan, int *count);
+
+void rxdedupe_evicted_stats(int *count);
+
+#endif
+
+/* end rxdedupe.h */
@@ -0,0 +1,305 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      rxgate.c
+ *
+ * Purpose:   	Skip the demodulators while a channel is quiet.
+ *
+ * Description:	Version 1.8.
+ *
+ *		Most of the time a channel has only noise or silence, yet
+ *		every sample goes thru the prefilter, mixers, low pass
+ *		filters, slicers, and HDLC decoders.  A much cheaper test
+ *		comes first when the channel has RXGATE.
+ *
+ *		Over each window of about two symbol times, the Goertzel
+ *		algorithm measures the energy at the mark and space
+ *		frequencies of each demodulator.  That is compared to the
+ *		total energy in the window.  A steady tone gives a ratio
+ *		of 1.  White noise gives 2 / window size for each frequency.
+ *		AFSK, switching between the two tones, is somewhere in
+ *		between.  The ratio is averaged over a few windows and the
+ *		channel is "active" when it is well above the noise level.
+ *		Being a ratio, the audio level doesn't matter, and the noise
+ *		from an FM receiver with the squelch open doesn't look like
+ *		a signal no matter how loud it is.
+ *
+ *		The demodulators run while the channel is active, for the
+ *		RXGATE hold time after, and as long as any HDLC decoder has
+ *		DCD or multi_modem is waiting to pick the best candidate.
+ *
+ *		While the channel is quiet, the most recent audio is kept.
+ *		When it becomes active, that goes thru the demodulators
+ *		first, then the block which woke it.  That way nothing is
+ *		lost from the beginning of the preamble while the detector
+ *		was making up its mind.  This lookback is long enough for
+ *		the filters, AGC and PLL to settle on the noise as they
+ *		would have if they had been running all along.
+ *
+ *		Only the thread calling multi_modem_process_block for the
+ *		channel uses this.  The counters are also read by the
+ *		metrics server.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "audio.h"
+#include "rxgate.h"
+
+#define MAX_BINS (2 * MAX_SUBCHANS) /* Mark and space for each frequency pair. */
+
+#define WINDOW_SYMBOLS 2	 /* Length of each measurement window. */
+#define LOOKBACK_SEC 0.5	 /* Audio kept while quiet. */
+#define RATIO_SMOOTH 0.25f	 /* Weight of newest window in average. */
+#define NOISE_MULT 3.0f		 /* Active when ratio is this many times the noise level. */
+#define MIN_ENERGY 4.0f		 /* Mean square for a window.  Below, about 2 LSB, is silence. */
+
+struct gate_s
+{
+	int window; /* Samples for each measurement. */
+	int count;	/* Samples so far in this window. */
+
+	int nbins;
+	float coeff[MAX_BINS]; /* 2 * cos (2 * pi * f / sample rate) */
+	float s1[MAX_BINS], s2[MAX_BINS];
+	float energy;
+
+	float ratio;	 /* Fraction of energy at the tones, averaged. */
+	float threshold; /* Active when above. */
+
+	int hold;	   /* Samples to keep going after activity. */
+	int hold_left; /* Count down to quiet. */
+	int is_open;
+
+	int16_t *lookback; /* Twice len.  Each sample stored twice, len apart, */
+	int len;		   /* so the most recent are contiguous, oldest first, */
+	int pos;		   /* starting at lookback + pos. */
+	int fill;		   /* How many since the channel became quiet. */
+
+	uint64_t samples_open; /* For rxgate_stats. */
+	uint64_t samples_quiet;
+};
+
+static struct gate_s *gate[MAX_CHANS];
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxgate_init
+ *
+ * Purpose:     Set up the activity detector for channels with RXGATE.
+ *
+ * Inputs:	pa	- Audio configuration.  Must be after demod_init.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxgate_init(struct audio_s *pa)
+{
+	int chan, d;
+
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		struct achan_param_s *ach = &pa->achan[chan];
+
+		if (pa->chan_medium[chan] != MEDIUM_RADIO || ach->modem_type != MODEM_AFSK || ach->rx_gate_ms <= 0)
+		{
+			continue;
+		}
+
+		int rate = pa->adev[ACHAN2ADEV(chan)].samples_per_sec;
+		struct gate_s *g = calloc(1, sizeof(struct gate_s));
+		if (g == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		g->window = WINDOW_SYMBOLS * rate / ach->baud;
+
+		// Same frequencies as demod_init for multiple frequency pairs.
+
+		for (d = 0; d < ach->num_freq && g->nbins < MAX_BINS; d++)
+		{
+			int k = d * ach->offset - ((ach->num_freq - 1) * ach->offset) / 2;
+
+			g->coeff[g->nbins++] = 2.0f * cosf(2.0f * (float)M_PI * (ach->mark_freq + k) / rate);
+			g->coeff[g->nbins++] = 2.0f * cosf(2.0f * (float)M_PI * (ach->space_freq + k) / rate);
+		}
+
+		g->threshold = NOISE_MULT * 2.0f * g->nbins / g->window;
+		g->hold = (int)((int64_t)ach->rx_gate_ms * rate / 1000);
+
+		g->len = (int)(LOOKBACK_SEC * rate);
+		g->lookback = calloc(2 * g->len, sizeof(int16_t));
+		if (g->lookback == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		gate[chan] = g;
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxgate_check
+ *
+ * Purpose:     Decide whether a block of audio needs demodulating.
+ *
+ * Inputs:	chan	- Radio channel.
+ *		samples	- Audio samples, oldest first.
+ *		n	- Number of samples.
+ *		busy	- True to keep going regardless, e.g. DCD.
+ *
+ * Outputs:	replay	- Audio from before this block which must be
+ *			  demodulated first.
+ *		replay_len - Number of samples there.  0 unless the
+ *			  channel just became active.
+ *
+ * Returns:	1 to demodulate the block, 0 to skip it.
+ *		Always 1 for a channel without RXGATE.
+ *
+ *--------------------------------------------------------------------*/
+
+__attribute__((hot)) int rxgate_check(int chan, const int16_t *samples, int n, int busy, const int16_t **replay, int *replay_len)
+{
+	struct gate_s *g;
+	int i, b;
+
+	assert(chan >= 0 && chan < MAX_CHANS);
+
+	*replay_len = 0;
+	g = gate[chan];
+	if (g == NULL)
+	{
+		return (1);
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		float x = samples[i];
+
+		g->energy += x * x;
+		for (b = 0; b < g->nbins; b++)
+		{
+			float s = x + g->coeff[b] * g->s1[b] - g->s2[b];
+			g->s2[b] = g->s1[b];
+			g->s1[b] = s;
+		}
+
+		if (++g->count >= g->window)
+		{
+			float r = 0;
+
+			if (g->energy >= MIN_ENERGY * g->window)
+			{
+				float tones = 0;
+				for (b = 0; b < g->nbins; b++)
+				{
+					tones += g->s1[b] * g->s1[b] + g->s2[b] * g->s2[b] - g->coeff[b] * g->s1[b] * g->s2[b];
+				}
+				r = 2.0f * tones / (g->window * g->energy);
+			}
+			g->ratio += RATIO_SMOOTH * (r - g->ratio);
+			if (g->ratio > g->threshold)
+			{
+				g->hold_left = g->hold + n;
+			}
+
+			memset(g->s1, 0, sizeof(g->s1));
+			memset(g->s2, 0, sizeof(g->s2));
+			g->energy = 0;
+			g->count = 0;
+		}
+	}
+
+	g->hold_left = g->hold_left > n ? g->hold_left - n : 0;
+
+	if (g->hold_left > 0 || busy)
+	{
+		if (!g->is_open)
+		{
+			g->is_open = 1;
+			*replay = g->lookback + g->pos + (g->len - g->fill);
+			*replay_len = g->fill;
+		}
+		__atomic_add_fetch(&g->samples_open, n, __ATOMIC_RELAXED);
+		return (1);
+	}
+
+	/* Quiet.  Keep the audio in case it becomes active soon. */
+
+	if (g->is_open)
+	{
+		g->is_open = 0;
+		g->fill = 0;
+	}
+	for (i = 0; i < n; i++)
+	{
+		g->lookback[g->pos] = samples[i];
+		g->lookback[g->pos + g->len] = samples[i];
+		if (++g->pos >= g->len)
+		{
+			g->pos = 0;
+		}
+	}
+	g->fill = g->fill + n < g->len ? g->fill + n : g->len;
+
+	__atomic_add_fetch(&g->samples_quiet, n, __ATOMIC_RELAXED);
+	return (0);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxgate_stats
+ *
+ * Purpose:     How much audio was demodulated and how much skipped.
+ *
+ * Inputs:	chan	- Radio channel.
+ *
+ * Outputs:	open	- Samples which went to the demodulators,
+ *			  not counting the lookback.
+ *		quiet	- Samples skipped.
+ *
+ * Returns:	0 for a channel without RXGATE.
+ *
+ *--------------------------------------------------------------------*/
+
+int rxgate_stats(int chan, uint64_t *open, uint64_t *quiet)
+{
+	assert(chan >= 0 && chan < MAX_CHANS);
+
+	if (gate[chan] == NULL)
+	{
+		return (0);
+	}
+	*open = __atomic_load_n(&gate[chan]->samples_open, __ATOMIC_RELAXED);
+	*quiet = __atomic_load_n(&gate[chan]->samples_quiet, __ATOMIC_RELAXED);
+	return (1);
+}
+
+/* end rxgate.c */
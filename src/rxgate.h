@@ -0,0 +1,26 @@
+
+/*------------------------------------------------------------------
+ *
+ * Module:      rxgate.h
+ *
+ * Purpose:   	Skip the demodulators while a channel is quiet.
+ *		See rxgate.c.
+ *
+ *---------------------------------------------------------------*/
+
+#ifndef RXGATE_H
+#define RXGATE_H 1
+
+#include <stdint.h>
+
+#include "audio.h"
+
+void rxgate_init(struct audio_s *pa);
+
+int rxgate_check(int chan, const int16_t *samples, int n, int busy, const int16_t **replay, int *replay_len);
+
+int rxgate_stats(int chan, uint64_t *open, uint64_t *quiet);
+
+#endif
+
+/* end rxgate.h */
@@ -0,0 +1,446 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      rxlat.c
+ *
+ * Purpose:   	Find out where the time goes between a frame ending on
+ *		the air and KISS client applications getting it.
+ *
+ * Description:	Version 1.8.
+ *
+ *		Each received frame carries two times in its packet object:
+ *		when it ended, and when it passed the last stage.  Passing
+ *		a stage adds the time since the previous one to that stage's
+ *		histogram.  The stages are listed in rxlat.h.
+ *
+ *		Frames are timed at:
+ *
+ *			hdlc_rec.c	Closing flag found.  fx25_rec.c for
+ *					the end of an FX.25 block.
+ *			multi_modem.c	Frame becomes a candidate, and when
+ *					the best candidate is picked.
+ *			dlq.c		Put in the received frame queue.
+ *			recv.c		Taken from the queue, then after the
+ *					whole batch was written to KISS
+ *					network clients.
+ *
+ *		Any number of demodulator, fix up, and FX.25 threads can
+ *		be adding to the histograms at once so the counters are
+ *		updated with atomic operations rather than a lock.
+ *
+ *		This is off unless the configuration has RXLATENCY.  Then
+ *		the histograms are printed for "kill -USR1" and when
+ *		direwolf is stopped.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <assert.h>
+
+#if !__WIN32__
+#include <unistd.h>
+#endif
+
+#include "rxlat.h"
+#include "audio_stats.h"
+
+static int enabled = 0;
+
+static volatile sig_atomic_t report_wanted = 0;
+
+static struct
+{
+	uint64_t hist[RXLAT_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+} lat[RXLAT_NUM];
+
+static const char *stage_name[RXLAT_NUM] = {
+	"Decode", "Candidate hold", "Accept to queue", "Receive queue", "KISS write", "Total"};
+
+/*
+ * Frames taken from the queue by recv_process but not yet written to
+ * KISS clients.  The packet objects might be gone by then so only the
+ * times are kept.  Each thread taking frames from a queue, more than
+ * one with RECVTHREADS, has its own.
+ */
+
+static __thread struct batch_s
+{
+	int64_t end_time;
+	int64_t stage_time;
+} *batch = NULL;
+static __thread int batch_len = 0;
+static __thread int batch_size = 0;
+
+static void lat_add(int stage, int64_t from, int64_t to);
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxlat_init
+ *
+ * Purpose:     Turn on receive latency measurement.
+ *
+ * Inputs:	enable	- From the RXLATENCY configuration command.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxlat_init(int enable)
+{
+	enabled = enable;
+
+	if (enabled)
+	{
+#if __WIN32__
+		printf("Receive latency will be reported when direwolf is stopped.\n");
+#else
+		signal(SIGUSR1, rxlat_report_request);
+		printf("Receive latency will be reported for \"kill -USR1 %d\" and when direwolf is stopped.\n", (int)getpid());
+#endif
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxlat_now
+ *
+ * Purpose:     Time for the end of a frame.
+ *
+ * Returns:	audio_stats_clock, in microseconds, or 0 if we are
+ *		not measuring, so the clock isn't read for nothing.
+ *
+ *--------------------------------------------------------------------*/
+
+int64_t rxlat_now(void)
+{
+	return (enabled ? audio_stats_clock() : 0);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxlat_begin
+ *
+ * Purpose:     Start timing a new packet object.
+ *
+ * Inputs:	pp		- Packet made from the received frame.
+ *
+ *		end_time	- From rxlat_now when the frame ended.
+ *				  Nothing is timed for a packet with 0.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxlat_begin(packet_t pp, int64_t end_time)
+{
+	if (pp != NULL && end_time != 0)
+	{
+		ax25_set_rx_times(pp, end_time, end_time);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxlat_stage
+ *
+ * Purpose:     A packet has passed one of the stages.
+ *
+ * Inputs:	pp	- Packet object.  Those without times, such as
+ *			  from other sources than the demodulators, are
+ *			  ignored.
+ *
+ *		stage	- One of RXLAT_... in rxlat.h.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxlat_stage(packet_t pp, int stage)
+{
+	int64_t end_time, stage_time, now;
+
+	assert(stage >= 0 && stage < RXLAT_NUM);
+
+	if (!enabled || pp == NULL)
+	{
+		return;
+	}
+
+	ax25_get_rx_times(pp, &end_time, &stage_time);
+	if (end_time == 0)
+	{
+		return;
+	}
+
+	now = audio_stats_clock();
+	lat_add(stage, stage_time, now);
+	ax25_set_rx_times(pp, end_time, now);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxlat_batch_add
+ *
+ * Purpose:     Remember the times for a packet taken from the received
+ *		frame queue, until the KISS writes are done.
+ *
+ * Description:	recv_process calls this for each frame it takes, then
+ *		rxlat_batch_end after kissnet_batch_end has written them
+ *		all to the clients.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxlat_batch_add(packet_t pp)
+{
+	int64_t end_time, stage_time;
+
+	if (!enabled || pp == NULL)
+	{
+		return;
+	}
+
+	ax25_get_rx_times(pp, &end_time, &stage_time);
+	if (end_time == 0)
+	{
+		return;
+	}
+
+	if (batch_len >= batch_size)
+	{
+		int size = batch_size == 0 ? 32 : batch_size * 2;
+		struct batch_s *b = realloc(batch, size * sizeof(struct batch_s));
+
+		if (b == NULL)
+		{
+			return; /* Just miss this one. */
+		}
+		batch = b;
+		batch_size = size;
+	}
+
+	batch[batch_len].end_time = end_time;
+	batch[batch_len].stage_time = stage_time;
+	batch_len++;
+}
+
+void rxlat_batch_end(void)
+{
+	int64_t now;
+	int k;
+
+	if (batch_len == 0)
+	{
+		return;
+	}
+
+	now = audio_stats_clock();
+	for (k = 0; k < batch_len; k++)
+	{
+		lat_add(RXLAT_KISS, batch[k].stage_time, now);
+		lat_add(RXLAT_TOTAL, batch[k].end_time, now);
+	}
+	batch_len = 0;
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        lat_add
+ *
+ * Purpose:     Add one time interval to a stage's histogram.
+ *
+ * Inputs:	stage	 - One of RXLAT_...
+ *
+ *		from, to - Times from audio_stats_clock, in microseconds.
+ *
+ *--------------------------------------------------------------------*/
+
+static void lat_add(int stage, int64_t from, int64_t to)
+{
+	uint64_t us = to > from ? (uint64_t)(to - from) : 0;
+	uint64_t max;
+	int n;
+
+	if (us < (1 << RXLAT_SUB_BITS))
+	{
+		n = (int)us;
+	}
+	else
+	{
+		int e = 63 - __builtin_clzll(us); /* Highest bit set, at least RXLAT_SUB_BITS. */
+
+		n = ((e - RXLAT_SUB_BITS + 1) << RXLAT_SUB_BITS) + (int)((us >> (e - RXLAT_SUB_BITS)) & ((1 << RXLAT_SUB_BITS) - 1));
+		if (n >= RXLAT_BUCKETS)
+		{
+			n = RXLAT_BUCKETS - 1;
+		}
+	}
+
+	__atomic_fetch_add(&lat[stage].hist[n], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&lat[stage].count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&lat[stage].sum, us, __ATOMIC_RELAXED);
+
+	max = __atomic_load_n(&lat[stage].max, __ATOMIC_RELAXED);
+	while (us > max && !__atomic_compare_exchange_n(&lat[stage].max, &max, us, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+		;
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxlat_bucket_low
+ *
+ * Purpose:     Smallest time, in microseconds, for histogram bucket n.
+ *
+ *--------------------------------------------------------------------*/
+
+int64_t rxlat_bucket_low(int n)
+{
+	assert(n >= 0 && n < RXLAT_BUCKETS);
+
+	if (n < (1 << RXLAT_SUB_BITS))
+	{
+		return (n);
+	}
+	return ((int64_t)((1 << RXLAT_SUB_BITS) + (n & ((1 << RXLAT_SUB_BITS) - 1))) << ((n >> RXLAT_SUB_BITS) - 1));
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxlat_stats
+ *
+ * Purpose:     Get a receive latency histogram.
+ *
+ * Inputs:	stage	- One of RXLAT_... in rxlat.h.
+ *
+ * Outputs:	hist	- RXLAT_BUCKETS counts.  See rxlat_bucket_low
+ *			  for the times.
+ *
+ *		count	- Number of frames measured.
+ *
+ *		sum_us	- Total of the times, in microseconds.
+ *
+ *		max_us	- Longest time seen.
+ *
+ * Description:	This is a snapshot while other threads may still be
+ *		adding so count might not quite match the histogram.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxlat_stats(int stage, uint64_t *hist, uint64_t *count, uint64_t *sum_us, uint64_t *max_us)
+{
+	int n;
+
+	assert(stage >= 0 && stage < RXLAT_NUM);
+
+	for (n = 0; n < RXLAT_BUCKETS; n++)
+	{
+		hist[n] = __atomic_load_n(&lat[stage].hist[n], __ATOMIC_RELAXED);
+	}
+	*count = __atomic_load_n(&lat[stage].count, __ATOMIC_RELAXED);
+	*sum_us = __atomic_load_n(&lat[stage].sum, __ATOMIC_RELAXED);
+	*max_us = __atomic_load_n(&lat[stage].max, __ATOMIC_RELAXED);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxlat_report_request
+ *
+ * Purpose:     Signal handler asking for a report.
+ *
+ * Description:	Printing isn't safe in a signal handler so this only
+ *		sets a flag.  recv_process checks rxlat_report_due
+ *		at least every 0.1 second.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxlat_report_request(int sig)
+{
+	(void)sig;
+	report_wanted = 1;
+}
+
+int rxlat_report_due(void)
+{
+	if (report_wanted)
+	{
+		report_wanted = 0;
+		return (enabled);
+	}
+	return (0);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        rxlat_print
+ *
+ * Purpose:     Print count, mean, percentiles and maximum for each stage,
+ *		in milliseconds.
+ *
+ *--------------------------------------------------------------------*/
+
+void rxlat_print(void)
+{
+	static const double pct[] = {50, 90, 99, 99.9};
+	uint64_t hist[RXLAT_BUCKETS];
+	uint64_t count, sum, max;
+	int stage, p, n;
+
+	if (!enabled)
+	{
+		return;
+	}
+
+	printf("\nReceive latency, milliseconds:\n");
+	printf("%-16s %8s %9s %9s %9s %9s %9s %9s\n", "", "frames", "mean", "50%", "90%", "99%", "99.9%", "max");
+
+	for (stage = 0; stage < RXLAT_NUM; stage++)
+	{
+		rxlat_stats(stage, hist, &count, &sum, &max);
+
+		printf("%-16s %8llu", stage_name[stage], (unsigned long long)count);
+		if (count == 0)
+		{
+			printf("\n");
+			continue;
+		}
+		printf(" %9.3f", sum / (double)count / 1000.);
+
+		for (p = 0; p < (int)(sizeof(pct) / sizeof(pct[0])); p++)
+		{
+			uint64_t want = (uint64_t)(count * pct[p] / 100. + 0.5);
+			uint64_t seen = 0;
+
+			if (want < 1)
+				want = 1;
+			for (n = 0; n < RXLAT_BUCKETS - 1; n++)
+			{
+				seen += hist[n];
+				if (seen >= want)
+					break;
+			}
+			printf(" %9.3f", rxlat_bucket_low(n) / 1000.);
+		}
+		printf(" %9.3f\n", max / 1000.);
+	}
+}
+
+/* end rxlat.c */
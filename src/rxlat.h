@@ -0,0 +1,65 @@
+
+/*------------------------------------------------------------------
+ *
+ * Module:      rxlat.h
+ *
+ * Purpose:   	Receive latency, from the end of a frame on the air to
+ *		its delivery to KISS network clients.  See rxlat.c.
+ *
+ *---------------------------------------------------------------*/
+
+#ifndef RXLAT_H
+#define RXLAT_H 1
+
+#include <stdint.h>
+
+#include "ax25_pad.h"
+
+/* Stages for rxlat_stats.  Each is the time from the previous one. */
+
+#define RXLAT_DECODE 0	/* Closing flag, or end of FX.25 block, to a candidate in multi_modem. */
+						/* HDLC decoding, FIX_BITS, and Reed-Solomon decoding. */
+#define RXLAT_HOLD 1	/* Candidate to picked.  Mostly PROCESS_AFTER_BITS, or waiting for */
+						/* fix up threads.  Missing with one demodulator and slicer. */
+#define RXLAT_ACCEPT 2	/* Picked, or decoded if not held, to the received frame queue. */
+#define RXLAT_QUEUE 3	/* In the received frame queue, until recv_process takes it. */
+#define RXLAT_KISS 4	/* Taken from the queue until written to KISS network clients. */
+#define RXLAT_TOTAL 5	/* Closing flag to written to KISS network clients. */
+
+#define RXLAT_NUM 6
+
+/*
+ * Log-linear buckets of microseconds, like HdrHistogram.  Below 8 there
+ * is one for each value.  After that each power of 2 is split into 8 so
+ * a value is never more than 12.5% from the bottom of its bucket.  The
+ * last bucket also gets anything over 2**27 microseconds, about 2 minutes.
+ */
+
+#define RXLAT_SUB_BITS 3
+#define RXLAT_BUCKETS ((27 - RXLAT_SUB_BITS + 1) << RXLAT_SUB_BITS)
+
+void rxlat_init(int enable);
+
+int64_t rxlat_now(void);
+
+void rxlat_begin(packet_t pp, int64_t end_time);
+
+void rxlat_stage(packet_t pp, int stage);
+
+void rxlat_batch_add(packet_t pp);
+
+void rxlat_batch_end(void);
+
+void rxlat_stats(int stage, uint64_t *hist, uint64_t *count, uint64_t *sum_us, uint64_t *max_us);
+
+int64_t rxlat_bucket_low(int n);
+
+void rxlat_report_request(int sig);
+
+int rxlat_report_due(void);
+
+void rxlat_print(void);
+
+#endif
+
+/* end rxlat.h */
@@ -0,0 +1,540 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      sdr.c
+ *
+ * Purpose:   	Split one wideband I/Q stream from an SDR into narrow
+ *		FM channels, each feeding its own radio channel.
+ *
+ * Description:	Version 1.8.
+ *
+ *		Monitoring several frequencies used to take a separate
+ *		SDR program for each one, with its own FM demodulator,
+ *		piping audio into its own channel.  Here one stream covering
+ *		all of them is taken apart with a polyphase filter bank.
+ *
+ *		The stream is divided into M bins, rate/M apart, with one
+ *		low pass prototype filter and an FFT.  Each bin comes out
+ *		at 2*rate/M, twice the spacing, so the prototype can pass a
+ *		whole FM channel even when it is half way between two bin
+ *		centers.  The filter and FFT cost the same for one channel
+ *		or for M of them.
+ *
+ *		For each channel, the nearest bin is shifted the rest of the
+ *		way, filtered down to the width of one FM channel, decimated,
+ *		and demodulated.  The audio then goes through the usual
+ *		resampler to the ARATE rate.
+ *
+ *		Configuration:
+ *
+ *			SDR  input  rate  center-MHz  [ CU8 | CS16 | CF32 ]
+ *			SDRCHAN  chan  MHz
+ *
+ *		Input is "stdin", a file or pipe name, or "file:" followed
+ *		by a recording to be decoded as fast as possible.  e.g.
+ *
+ *			rtl_sdr -f 144.6M -s 1200000 - | direwolf -c sdr.conf
+ *
+ *		with
+ *
+ *			SDR  stdin  1200000  144.6  CU8
+ *			SDRCHAN  0  144.39
+ *			SDRCHAN  1  144.80
+ *
+ *		This is for receiving only.  Anything transmitted on these
+ *		channels is discarded.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <assert.h>
+
+#if __WIN32__
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "audio.h"
+#include "fsk_demod_state.h"
+#include "dsp.h"
+#include "dsp_kernel.h"
+#include "sdr.h"
+
+#define SDR_MIN_SPACING 25000	/* Bins are at least this far apart, in Hz. */
+#define SDR_MAX_BINS 4096		/* Enough for 100 MHz. */
+#define SDR_HALF_BW 8000		/* Half of an FM channel.  5 kHz deviation, tones, */
+								/* and a little tuning error. */
+#define SDR_MIN_CHAN_RATE 24000 /* Complex samples per second into the FM discriminator. */
+#define SDR_FULL_SCALE_HZ 10000 /* Deviation for full scale audio. */
+
+static FILE *in_fp = NULL; /* NULL if not configured. */
+static enum sdr_format_e in_format;
+static unsigned char *raw; /* Input as read. */
+static int raw_size;	   /* In I/Q pairs. */
+
+/* Filter bank. */
+
+static int M;		  /* Number of bins, power of 2. */
+static int D;		  /* Input samples for each bin output, M/2. */
+static int L;		  /* Prototype filter length, a multiple of M. */
+static float *proto;  /* Prototype low pass filter. */
+static float *hist_i; /* Most recent L input samples, stored twice, */
+static float *hist_q; /* like delay_line_t.  See fsk_demod_state.h. */
+static int hist_head;
+static int hist_count; /* Input samples since last bin output. */
+
+static float *fft_cos, *fft_sin; /* Twiddle factors, M/2 of each. */
+static int *fft_rev;			 /* Bit reversed indexes. */
+static float *bin_re, *bin_im;	 /* Folded input, then output of each bin. */
+
+/* Channels. */
+
+static int K;		  /* Bin outputs for each channel output. */
+static int phase;	  /* Bin outputs until the next channel output. */
+static int lp_taps;	  /* Channel filter. */
+static float lp_filter[MAX_FILTER_SIZE];
+static float fm_scale; /* Radians per sample to audio. */
+
+static struct sdr_chan_s
+{
+	int chan;			  /* Radio channel. */
+	int bin;			  /* Nearest bin. */
+	float rot_re, rot_im; /* Step for nco, each bin output. */
+	float nco_re, nco_im; /* Shift from bin center to channel. */
+	delay_line_t lp_i, lp_q;
+	float prev_re, prev_im; /* Previous filter output for FM discriminator. */
+} *sc;
+static int num_sc;
+
+static void bin_output(int16_t *out, int n, int k);
+
+/*------------------------------------------------------------------
+ *
+ * Name:        sdr_init
+ *
+ * Purpose:     Set up the filter bank and open the I/Q input.
+ *
+ * Inputs:	pa->sdr		- Input, rate, center frequency, format,
+ *				  and frequency of each channel.
+ *
+ * Outputs:	pa->adev[].in_samples_per_sec
+ *				- Rate of the channel audio, for each device
+ *				  fed by the SDR, so recv.c resamples it.
+ *
+ * Returns:	0 for success or if not configured.
+ *		-1 for failure.  A message has already been printed.
+ *
+ * Description:	M is the largest power of 2 with bins at least
+ *		SDR_MIN_SPACING apart and a whole number rate out of
+ *		each bin.  The channel is never more than half the spacing
+ *		from a bin center, so the prototype needs to pass half the
+ *		spacing plus half a channel.  The bin rate is twice the spacing
+ *		so anything above 2 * spacing minus that would fold back.
+ *		Cutoff half way between is exactly the spacing.
+ *
+ *----------------------------------------------------------------*/
+
+int sdr_init(struct audio_s *pa)
+{
+	double spacing;
+	int rate1, rate2;
+	int taps_per_bin;
+	int chan, j;
+
+	if (strlen(pa->sdr.input) == 0)
+	{
+		return (0);
+	}
+
+	M = 0;
+	for (j = 4; j <= SDR_MAX_BINS && (double)pa->sdr.rate / j >= SDR_MIN_SPACING; j *= 2)
+	{
+		if (pa->sdr.rate % (j / 2) == 0)
+		{
+			M = j;
+		}
+	}
+	if (M == 0)
+	{
+		printf("SDR: Can't split %d samples per second into channels.\n", pa->sdr.rate);
+		printf("Use at least %d, a multiple of a power of 2.\n", 4 * SDR_MIN_SPACING);
+		return (-1);
+	}
+	D = M / 2;
+	spacing = (double)pa->sdr.rate / M;
+	rate1 = pa->sdr.rate / D;
+
+	for (K = rate1 / SDR_MIN_CHAN_RATE; K > 1 && rate1 % K != 0; K--)
+		;
+	rate2 = rate1 / K;
+
+	/* Filter bank. */
+
+	taps_per_bin = (int)ceil(6 * spacing / (spacing - 2 * SDR_HALF_BW));
+	L = M * taps_per_bin;
+
+	proto = malloc(L * sizeof(float));
+	hist_i = calloc(2 * L, sizeof(float));
+	hist_q = calloc(2 * L, sizeof(float));
+	fft_cos = malloc(D * sizeof(float));
+	fft_sin = malloc(D * sizeof(float));
+	fft_rev = malloc(M * sizeof(int));
+	bin_re = malloc(M * sizeof(float));
+	bin_im = malloc(M * sizeof(float));
+	sc = calloc(MAX_CHANS, sizeof(struct sdr_chan_s));
+	if (proto == NULL || hist_i == NULL || hist_q == NULL || fft_cos == NULL || fft_sin == NULL ||
+		fft_rev == NULL || bin_re == NULL || bin_im == NULL || sc == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	gen_lowpass(1.0f / M, proto, L, BP_WINDOW_BLACKMAN);
+
+	for (j = 0; j < D; j++)
+	{
+		fft_cos[j] = cos(2 * M_PI * j / M);
+		fft_sin[j] = sin(2 * M_PI * j / M);
+	}
+	for (j = 0; j < M; j++)
+	{
+		int b, r = 0;
+		for (b = 1; b < M; b <<= 1)
+		{
+			r = (r << 1) | ((j & b) != 0);
+		}
+		fft_rev[j] = r;
+	}
+
+	/* Channel filter.  Cutoff half way between the FM channel */
+	/* and half the decimated rate. */
+
+	lp_taps = (int)(6.0 * rate1 / (rate2 / 2 - SDR_HALF_BW)) | 1;
+	if (lp_taps > MAX_FILTER_SIZE)
+	{
+		lp_taps = MAX_FILTER_SIZE - 1;
+	}
+	gen_lowpass((SDR_HALF_BW + rate2 / 2.0f) / 2 / rate1, lp_filter, lp_taps, BP_WINDOW_BLACKMAN);
+
+	fm_scale = rate2 / (2 * M_PI) * 32767 / SDR_FULL_SCALE_HZ;
+
+	printf("SDR: %s, %d samples per second at %.4f MHz.\n", pa->sdr.input, pa->sdr.rate, pa->sdr.center_hz / 1e6);
+	printf("SDR: %d bins %.1f kHz apart, %d filter taps.  %d samples per second for each channel.\n",
+		   M, spacing / 1000, L, rate2);
+
+	num_sc = 0;
+	for (chan = 0; chan < MAX_CHANS; chan++)
+	{
+		struct sdr_chan_s *c = &sc[num_sc];
+		double offset, resid;
+		int k;
+
+		if (pa->sdr.chan_hz[chan] == 0)
+		{
+			continue;
+		}
+
+		offset = (double)(pa->sdr.chan_hz[chan] - pa->sdr.center_hz);
+		if (fabs(offset) > pa->sdr.rate / 2 - spacing)
+		{
+			printf("SDR: Channel %d, %.4f MHz, is too close to the edge or outside of the %.4f - %.4f MHz input.\n",
+				   chan, pa->sdr.chan_hz[chan] / 1e6,
+				   (pa->sdr.center_hz - pa->sdr.rate / 2) / 1e6, (pa->sdr.center_hz + pa->sdr.rate / 2) / 1e6);
+			return (-1);
+		}
+
+		k = (int)lround(offset / spacing);
+		resid = offset - k * spacing;
+
+		c->chan = chan;
+		c->bin = (k + M) % M;
+
+		// Every other output of an odd bin is inverted because the
+		// bin rate is twice the spacing.  Take care of that here too.
+
+		c->rot_re = cos(-2 * M_PI * resid / rate1) * ((c->bin & 1) ? -1 : 1);
+		c->rot_im = sin(-2 * M_PI * resid / rate1) * ((c->bin & 1) ? -1 : 1);
+		c->nco_re = 1;
+		c->nco_im = 0;
+		delay_line_init(&c->lp_i, lp_taps);
+		delay_line_init(&c->lp_q, lp_taps);
+		c->prev_re = 1;
+		c->prev_im = 0;
+		num_sc++;
+
+		int a = ACHAN2ADEV(chan);
+		pa->adev[a].in_samples_per_sec = rate2 == pa->adev[a].samples_per_sec ? 0 : rate2;
+
+		printf("SDR: Channel %d, %.4f MHz, bin %d %+.1f kHz.\n", chan, pa->sdr.chan_hz[chan] / 1e6, c->bin, resid / 1000);
+	}
+
+	if (num_sc == 0)
+	{
+		printf("SDR: No channels.  Use SDRCHAN to pick the frequencies.\n");
+		return (-1);
+	}
+
+	/* Open the input. */
+
+	in_format = pa->sdr.format;
+
+	if (strcasecmp(pa->sdr.input, "stdin") == 0 || strcmp(pa->sdr.input, "-") == 0)
+	{
+		in_fp = stdin;
+#if __WIN32__
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+	}
+	else
+	{
+		const char *name = pa->sdr.input;
+
+		if (strncasecmp(name, "file:", 5) == 0)
+		{
+			name += 5;
+		}
+		in_fp = fopen(name, "rb");
+		if (in_fp == NULL)
+		{
+			printf("SDR: Could not open %s.\n", name);
+			printf("%s\n", strerror(errno));
+			return (-1);
+		}
+	}
+
+	return (0);
+
+} /* end sdr_init */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        sdr_get_block
+ *
+ * Purpose:     Read I/Q input and produce audio for every channel.
+ *
+ * Inputs:	n	- Number of audio samples wanted for each channel.
+ *
+ * Outputs:	out	- Audio for radio channel c at out + c * n.
+ *			  Room for MAX_CHANS channels.  Only those
+ *			  from the SDR are filled in.
+ *
+ * Returns:	n, or -1 at end of input or for an error.
+ *
+ * Description:	Exactly enough input is read for n outputs so channel
+ *		audio lines up with the blocks.
+ *
+ *----------------------------------------------------------------*/
+
+__attribute__((hot)) int sdr_get_block(int16_t *out, int n)
+{
+	static const int pair_bytes[] = {2, 4, 8};
+	int need = n * K * D;
+	int produced = 0;
+	int j;
+
+	if (in_fp == NULL)
+	{
+		return (-1);
+	}
+
+	if (need > raw_size)
+	{
+		free(raw);
+		raw = malloc(need * pair_bytes[in_format]);
+		if (raw == NULL)
+		{
+			printf("FATAL ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		raw_size = need;
+	}
+
+	if ((int)fread(raw, pair_bytes[in_format], need, in_fp) < need)
+	{
+		return (-1);
+	}
+
+	for (j = 0; j < need; j++)
+	{
+		float i, q;
+
+		switch (in_format)
+		{
+		case SDR_FORMAT_CU8:
+		default:
+			i = raw[j * 2] - 127.5f;
+			q = raw[j * 2 + 1] - 127.5f;
+			break;
+		case SDR_FORMAT_CS16:
+			i = (int16_t)(raw[j * 4] | (raw[j * 4 + 1] << 8));
+			q = (int16_t)(raw[j * 4 + 2] | (raw[j * 4 + 3] << 8));
+			break;
+		case SDR_FORMAT_CF32:
+			memcpy(&i, raw + j * 8, 4);
+			memcpy(&q, raw + j * 8 + 4, 4);
+			break;
+		}
+
+		hist_head = (hist_head == 0) ? L - 1 : hist_head - 1;
+		hist_i[hist_head] = hist_i[hist_head + L] = i;
+		hist_q[hist_head] = hist_q[hist_head + L] = q;
+
+		if (++hist_count == D)
+		{
+			hist_count = 0;
+			bin_output(out, n, produced);
+			if (phase == 0)
+			{
+				produced++;
+				phase = K;
+			}
+			phase--;
+		}
+	}
+
+	assert(produced == n);
+	return (n);
+
+} /* end sdr_get_block */
+
+/*------------------------------------------------------------------
+ *
+ * Name:        bin_output
+ *
+ * Purpose:     Run the filter bank once and take the channels along.
+ *
+ * Inputs:	out, n	- As for sdr_get_block.
+ *		k	- Position in out for a channel output, when due.
+ *
+ * Description:	Bin b is the sum over all taps of the prototype times
+ *		the input times exp(j*2*pi*b*tap/M).  Taps M apart see
+ *		the same exponential so they are added up first, leaving
+ *		an M point FFT.
+ *
+ *----------------------------------------------------------------*/
+
+__attribute__((hot)) static void bin_output(int16_t *out, int n, int k)
+{
+	const float *wi = hist_i + hist_head;
+	const float *wq = hist_q + hist_head;
+	int j, t, size;
+
+	for (j = 0; j < M; j++)
+	{
+		bin_re[j] = 0;
+		bin_im[j] = 0;
+	}
+	for (t = 0; t < L; t += M)
+	{
+		for (j = 0; j < M; j++)
+		{
+			bin_re[j] += proto[t + j] * wi[t + j];
+			bin_im[j] += proto[t + j] * wq[t + j];
+		}
+	}
+
+	/* FFT with positive exponent, in place. */
+
+	for (j = 0; j < M; j++)
+	{
+		int r = fft_rev[j];
+		if (r > j)
+		{
+			float x = bin_re[j];
+			bin_re[j] = bin_re[r];
+			bin_re[r] = x;
+			x = bin_im[j];
+			bin_im[j] = bin_im[r];
+			bin_im[r] = x;
+		}
+	}
+	for (size = 2; size <= M; size *= 2)
+	{
+		int half = size / 2;
+		int step = M / size;
+
+		for (t = 0; t < M; t += size)
+		{
+			for (j = 0; j < half; j++)
+			{
+				int a = t + j;
+				int b = a + half;
+				float c = fft_cos[j * step];
+				float s = fft_sin[j * step];
+				float tr = bin_re[b] * c - bin_im[b] * s;
+				float ti = bin_re[b] * s + bin_im[b] * c;
+
+				bin_re[b] = bin_re[a] - tr;
+				bin_im[b] = bin_im[a] - ti;
+				bin_re[a] += tr;
+				bin_im[a] += ti;
+			}
+		}
+	}
+
+	for (j = 0; j < num_sc; j++)
+	{
+		struct sdr_chan_s *c = &sc[j];
+		float yr = bin_re[c->bin];
+		float yi = bin_im[c->bin];
+		float x;
+
+		delay_line_push(&c->lp_i, yr * c->nco_re - yi * c->nco_im);
+		delay_line_push(&c->lp_q, yr * c->nco_im + yi * c->nco_re);
+
+		x = c->nco_re * c->rot_re - c->nco_im * c->rot_im;
+		c->nco_im = c->nco_re * c->rot_im + c->nco_im * c->rot_re;
+		c->nco_re = x;
+
+		if (phase == 0)
+		{
+			// Keep the nco from drifting in amplitude.
+
+			x = 1.0f / sqrtf(c->nco_re * c->nco_re + c->nco_im * c->nco_im);
+			c->nco_re *= x;
+			c->nco_im *= x;
+
+			// FM discriminator.  Angle between this and the previous sample.
+
+			float fr = dsp_convolve(delay_line_window(&c->lp_i), lp_filter, lp_taps);
+			float fi = dsp_convolve(delay_line_window(&c->lp_q), lp_filter, lp_taps);
+			float d = atan2f(fi * c->prev_re - fr * c->prev_im, fr * c->prev_re + fi * c->prev_im);
+			int s;
+
+			c->prev_re = fr;
+			c->prev_im = fi;
+
+			s = (int)(d * fm_scale);
+			if (s > 32767)
+				s = 32767;
+			else if (s < -32767)
+				s = -32767;
+			out[c->chan * n + k] = s;
+		}
+	}
+
+} /* end bin_output */
+
+/* end sdr.c */
@@ -0,0 +1,22 @@
+
+/*
+ * Name:	sdr.h
+ *
+ * This is for splitting a wideband I/Q stream from an SDR into
+ * narrow FM channels.  See sdr.c.
+ */
+
+#ifndef SDR_H
+#define SDR_H 1
+
+#include <stdint.h>
+
+#include "audio.h"
+
+int sdr_init(struct audio_s *pa);
+
+int sdr_get_block(int16_t *out, int n);
+
+#endif
+
+/* end sdr.h */
@@ -0,0 +1,385 @@
+//
+//    This file is part of Dire Wolf, an amateur radio packet TNC.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*------------------------------------------------------------------
+ *
+ * Module:      siggen.c
+ *
+ * Purpose:   	Make test signals in memory.
+ *
+ * Description:	Version 1.8.
+ *
+ *		Frames are made by the real transmit side, hdlc_send.c and
+ *		gen_tone.c, with gen_tone rendering into memory rather
+ *		than sending to a device.  Then the radio path is imitated:
+ *
+ *			twist		One pole filter, so one tone is weaker,
+ *					as from de-emphasis or pre-emphasis
+ *					that doesn't match.
+ *			drift		Sender's sound card clock is off.
+ *			noise		Gaussian noise for the signal to
+ *					noise ratio.  The signal power is
+ *					for while transmitting.
+ *
+ *		A frequency offset just moves both tones.  Traffic density
+ *		sets the silence between transmissions, which varies at
+ *		random around the average.
+ *
+ *		Everything is from the seed so the same settings always
+ *		make the same audio.  That is what atest -S and autotune.c
+ *		need, and is good for comparing soak tests too.
+ *
+ *		This takes over gen_tone.c and hdlc_send.c, so it is only
+ *		for programs that don't transmit, or a child process.
+ *
+ *---------------------------------------------------------------*/
+
+#include "direwolf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "audio.h"
+#include "ax25_pad.h"
+#include "gen_tone.h"
+#include "hdlc_send.h"
+#include "siggen.h"
+
+#define SIGGEN_AMP 50 /* Percent of full scale, before twist. */
+
+static unsigned int rand_state;
+
+/* Uniform, 0 to 1. */
+
+static float siggen_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return ((float)((rand_state >> 8) & 0xffff) / 65536.f);
+}
+
+/* Roughly Gaussian, from the sum of uniform values. */
+
+static float gauss(void)
+{
+	float sum = 0;
+
+	for (int k = 0; k < 4; k++)
+	{
+		sum += siggen_rand() - 0.5f;
+	}
+	return (sum * 1.732f); /* 4 uniform have variance 4/12. */
+}
+
+static void add_twist(const struct siggen_s *g, int16_t *buf, int n);
+
+static int add_drift(const struct siggen_s *g, int16_t **buf, int n);
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        siggen_default
+ *
+ * Purpose:     Settings for a clean 1200 baud APRS signal.
+ *
+ * Outputs:	g
+ *
+ * Description:	Change what is wanted after this.
+ *
+ *--------------------------------------------------------------------*/
+
+void siggen_default(struct siggen_s *g)
+{
+	memset(g, 0, sizeof(*g));
+	g->samples_per_sec = 48000;
+	g->modem_type = MODEM_AFSK;
+	g->baud = DEFAULT_BAUD;
+	g->mark_freq = DEFAULT_MARK_FREQ;
+	g->space_freq = DEFAULT_SPACE_FREQ;
+	g->layer2_xmit = LAYER2_AX25;
+	g->num_frames = 100;
+	g->info_min = 10;
+	g->info_max = 200;
+	g->txdelay_ms = 300;
+	g->density = 50;
+	g->snr_db = SIGGEN_NO_NOISE;
+	g->seed = 1;
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        siggen_make
+ *
+ * Purpose:     Make a test signal.
+ *
+ * Inputs:	g	- Settings.
+ *
+ * Outputs:	out	- Mono audio, allocated here.  Caller should free.
+ *
+ * Returns:	Number of samples.
+ *
+ * Description:	There is half a second of silence at each end.
+ *		Frames are APRS status with the frame number at the
+ *		start of the info part, padded to a random length.
+ *
+ *--------------------------------------------------------------------*/
+
+int siggen_make(const struct siggen_s *g, int16_t **out)
+{
+	static struct audio_s config;
+	int16_t *buf;
+	int n, k;
+
+	memset(&config, 0, sizeof(config));
+	config.adev[0].defined = 1;
+	config.adev[0].num_channels = 1;
+	config.adev[0].samples_per_sec = g->samples_per_sec;
+	config.adev[0].bits_per_sample = 16;
+	config.chan_medium[0] = MEDIUM_RADIO;
+	config.achan[0].modem_type = g->modem_type;
+	config.achan[0].baud = g->baud;
+	config.achan[0].mark_freq = g->mark_freq + g->freq_offset;
+	config.achan[0].space_freq = g->space_freq + g->freq_offset;
+	config.achan[0].layer2_xmit = g->layer2_xmit;
+	config.achan[0].fx25_strength = g->fx25_strength;
+
+	gen_tone_init(&config, SIGGEN_AMP);
+	layer2_send_init();
+	rand_state = g->seed;
+
+	int bytes_per_sec = g->baud / 8 > 0 ? g->baud / 8 : 1;
+	int density = g->density < 1 ? 1 : g->density > 100 ? 100 : g->density;
+
+	gen_tone_render_begin(0);
+	gen_tone_put_quiet_ms(0, 500);
+
+	for (n = 0; n < g->num_frames; n++)
+	{
+		char text[AX25_MAX_INFO_LEN + 100];
+		int len = g->info_min;
+		int bits;
+		packet_t pp;
+
+		if (g->info_max > g->info_min)
+		{
+			len += (int)(siggen_rand() * (g->info_max - g->info_min + 1));
+		}
+		if (len > AX25_MAX_INFO_LEN)
+		{
+			len = AX25_MAX_INFO_LEN;
+		}
+		snprintf(text, sizeof(text), "W1AW-%d>APDW18,WIDE1-1,WIDE2-1:>%-*d", n % 16, len > 1 ? len - 1 : 1, n);
+		pp = ax25_from_text(text, 1);
+		assert(pp != NULL);
+
+		bits = 0;
+		if (density < 100 || n == 0)
+		{
+			bits += layer2_preamble_postamble(0, g->txdelay_ms * bytes_per_sec / 1000 + 1, 0);
+		}
+		bits += layer2_send_frame(0, pp, 0, &config);
+		bits += layer2_preamble_postamble(0, density < 100 ? bytes_per_sec / 100 + 2 : 2, 0);
+		ax25_delete(pp);
+
+		// Average silence for the density, varying from none to twice that.
+
+		if (density < 100)
+		{
+			double gap = (double)bits / g->baud * (100 - density) / density;
+			gen_tone_put_quiet_ms(0, (int)(gap * 2000 * siggen_rand()));
+		}
+	}
+	gen_tone_put_quiet_ms(0, 500);
+
+	n = gen_tone_render_take(0, &buf);
+	assert(buf != NULL);
+
+	add_twist(g, buf, n);
+	n = add_drift(g, &buf, n);
+
+	// Noise for the signal to noise ratio.  Signal power is measured
+	// while transmitting, which is where gen_tone doesn't give zero.
+
+	if (g->snr_db < SIGGEN_NO_NOISE)
+	{
+		double power = 0;
+		int active = 0;
+
+		for (k = 0; k < n; k++)
+		{
+			if (buf[k] != 0)
+			{
+				power += (double)buf[k] * buf[k];
+				active++;
+			}
+		}
+		float sigma = active > 0 ? (float)sqrt(power / active / pow(10., g->snr_db / 10.)) : 0;
+
+		for (k = 0; k < n; k++)
+		{
+			float x = buf[k] + sigma * gauss();
+			buf[k] = x > 32767 ? 32767 : x < -32768 ? -32768 : (int16_t)lrintf(x);
+		}
+	}
+
+	*out = buf;
+	return (n);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        add_twist
+ *
+ * Purpose:     Make the higher tone weaker, or the lower one.
+ *
+ * Inputs:	g	- twist_db, and the tones.
+ *		buf, n	- Audio, changed in place.
+ *
+ * Description:	A one pole filter, y = x + c * y', has a gain of
+ *		1 / sqrt (1 + c*c - 2 * c * cos(w)).  Positive c is low
+ *		pass and negative is high pass.  The ratio of gains at
+ *		the two tones goes up steadily with c so a binary search
+ *		finds the c for the twist wanted.  Then the stronger tone
+ *		is scaled back to where it was.
+ *
+ *		One pole gives at most about 5 dB between 1200 and 2200 Hz
+ *		so more twist than that is split over several in a row.
+ *
+ *--------------------------------------------------------------------*/
+
+static double pole_gain(double c, double f, int rate)
+{
+	return (1. / sqrt(1. + c * c - 2. * c * cos(2. * M_PI * f / rate)));
+}
+
+static void add_twist(const struct siggen_s *g, int16_t *buf, int n)
+{
+	double lo = -0.99, hi = 0.99, c = 0;
+	double want;
+	int f1 = g->mark_freq + g->freq_offset;
+	int f2 = g->space_freq + g->freq_offset;
+	int rate = g->samples_per_sec;
+
+	if (g->twist_db == 0 || f1 == f2)
+	{
+		return;
+	}
+	if (f1 > f2) /* f1 is the lower tone. */
+	{
+		int t = f1;
+		f1 = f2;
+		f2 = t;
+	}
+
+	// Enough passes that each needs no more than one pole can do.
+
+	int passes = 1;
+	double most = pole_gain(0.99, f1, rate) / pole_gain(0.99, f2, rate);
+
+	while (passes < 4 && fabs(g->twist_db) / passes > 20. * log10(most))
+	{
+		passes++;
+	}
+	want = pow(10., g->twist_db / 20. / passes);
+
+	for (int k = 0; k < 50; k++)
+	{
+		c = (lo + hi) / 2;
+		if (pole_gain(c, f1, rate) / pole_gain(c, f2, rate) < want)
+		{
+			lo = c;
+		}
+		else
+		{
+			hi = c;
+		}
+	}
+
+	double g1 = pole_gain(c, f1, rate);
+	double g2 = pole_gain(c, f2, rate);
+	float scale = (float)(1. / (g1 > g2 ? g1 : g2));
+	float y[4] = {0, 0, 0, 0};
+
+	for (int k = 0; k < n; k++)
+	{
+		float x = buf[k];
+
+		for (int p = 0; p < passes; p++)
+		{
+			y[p] = x + (float)c * y[p];
+			x = y[p] * scale;
+		}
+		buf[k] = x > 32767 ? 32767 : x < -32768 ? -32768 : (int16_t)lrintf(x);
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        add_drift
+ *
+ * Purpose:     Imitate the sender's clock being off.
+ *
+ * Inputs:	g	- drift_ppm.
+ *		buf, n	- Audio.
+ *
+ * Outputs:	buf	- Replaced with new audio.
+ *
+ * Returns:	New number of samples.
+ *
+ * Description:	A fast clock means everything takes a little less
+ *		time, so the audio is resampled to that many fewer
+ *		samples.  Linear interpolation is plenty for a change
+ *		of a few hundred parts per million.
+ *
+ *--------------------------------------------------------------------*/
+
+static int add_drift(const struct siggen_s *g, int16_t **buf, int n)
+{
+	double step = 1. + g->drift_ppm * 1e-6;
+	int16_t *in = *buf;
+	int16_t *out;
+	int m, k;
+
+	if (g->drift_ppm == 0 || n < 2)
+	{
+		return (n);
+	}
+
+	m = (int)((n - 1) / step);
+	out = malloc((m + 1) * sizeof(int16_t));
+	if (out == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (k = 0; k < m; k++)
+	{
+		double t = k * step;
+		int i = (int)t;
+		double frac = t - i;
+
+		out[k] = (int16_t)lrint(in[i] + frac * (in[i + 1] - in[i]));
+	}
+
+	free(in);
+	*buf = out;
+	return (m);
+}
+
+/* end siggen.c */
@@ -0,0 +1,51 @@
+
+/*
+ * Name:	siggen.h
+ *
+ * This is for making test signals in memory.  See siggen.c.
+ */
+
+#ifndef SIGGEN_H
+#define SIGGEN_H 1
+
+#include <stdint.h>
+
+#include "audio.h"
+
+struct siggen_s
+{
+	int samples_per_sec;	/* Audio sample rate. */
+	enum modem_t modem_type; /* MODEM_AFSK etc, as for the receiver. */
+	int baud;
+	int mark_freq;			/* Only for AFSK. */
+	int space_freq;
+
+	int layer2_xmit;	/* LAYER2_AX25 or LAYER2_FX25. */
+	int fx25_strength;	/* FX.25 check bytes, 16, 32, or 64.  1 for automatic. */
+
+	int num_frames;		/* How many frames. */
+	int info_min;		/* Info part is between these lengths. */
+	int info_max;
+	int txdelay_ms;		/* Flags before each transmission. */
+	int density;		/* Percent of the time transmitting, 1-100. */
+						/* 100 is back to back with a couple flags between. */
+
+	float snr_db;		/* Signal to noise ratio, over the whole audio band. */
+						/* SIGGEN_NO_NOISE for none. */
+	int freq_offset;	/* Hz added to both tones, as from a mistuned radio. */
+	float twist_db;		/* Higher tone weaker by this much, as from de-emphasis. */
+						/* Negative for the lower tone weaker. */
+	float drift_ppm;	/* Sender's clock fast by this much, negative for slow. */
+
+	unsigned int seed;	/* Same seed, same audio. */
+};
+
+#define SIGGEN_NO_NOISE 999.f
+
+void siggen_default(struct siggen_s *g);
+
+int siggen_make(const struct siggen_s *g, int16_t **out);
+
+#endif
+
+/* end siggen.h */
@@ -41,6 +41,10 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#if !__WIN32__
+#include <errno.h>
+#include <time.h>
+#endif
 
 #include "dwthread.h"
 #include "ax25_pad.h"
@@ -49,6 +53,28 @@
 
 static packet_t queue_head[MAX_CHANS][TQ_NUM_PRIO]; /* Head of linked list for each queue. */
 
+static packet_t queue_tail[MAX_CHANS][TQ_NUM_PRIO]; /* Last in each list, for appending. */
+
+/*
+ * Version 1.8: Running totals for tq_count so the common query,
+ * with no address filter, doesn't need to walk the list.
+ * Only real packets are counted, not the place holders from
+ * lm_seize_request.  Updated only while holding tq_mutex.
+ */
+
+static volatile int queue_frames[MAX_CHANS][TQ_NUM_PRIO];
+
+static volatile int queue_bytes[MAX_CHANS][TQ_NUM_PRIO];
+
+/*
+ * Frames discarded because of the TXQUEUE limits.
+ * The limits apply to tq_append and tq_append_batch, not
+ * to the connected mode link which has its own window.
+ */
+
+static volatile int queue_dropped[MAX_CHANS];
+static volatile int queue_rejected[MAX_CHANS];
+
 static dw_mutex_t tq_mutex; /* Critical section for updating queues. */
 							/* Just one for all queues. */
 
@@ -62,12 +88,52 @@ static pthread_cond_t wake_up_cond[MAX_CHANS]; /* Notify transmit thread when qu
 
 static pthread_mutex_t wake_up_mutex[MAX_CHANS]; /* Required by cond_wait. */
 
-static int xmit_thread_is_waiting[MAX_CHANS];
+static volatile int xmit_thread_is_waiting[MAX_CHANS];
 
 #endif
 
+/*
+ * Version 1.8: Counts anything the transmit thread might be waiting
+ * for: something added to the queue or the channel busy state changing.
+ * The waiter notes the count before looking, then sleeps only while it
+ * is unchanged, so nothing is missed between looking and sleeping.
+ */
+
+static volatile unsigned int event_seq[MAX_CHANS];
+
 static int tq_is_empty(int chan);
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        append_to_queue
+ *
+ * Purpose:     Add packet to end of linked list and update the totals.
+ *
+ * Description:	Caller must hold tq_mutex.
+ *
+ *--------------------------------------------------------------------*/
+
+static void append_to_queue(int chan, int prio, packet_t pp)
+{
+	ax25_set_nextp(pp, NULL);
+
+	if (queue_head[chan][prio] == NULL)
+	{
+		queue_head[chan][prio] = pp;
+	}
+	else
+	{
+		ax25_set_nextp(queue_tail[chan][prio], pp);
+	}
+	queue_tail[chan][prio] = pp;
+
+	if (ax25_get_num_addr(pp) >= AX25_MIN_ADDRS)
+	{
+		queue_frames[chan][prio]++;
+		queue_bytes[chan][prio] += ax25_get_frame_len(pp);
+	}
+}
+
 /*-------------------------------------------------------------------
  *
  * Name:        tq_init
@@ -104,6 +170,86 @@ static int tq_is_empty(int chan);
 
 static struct audio_s *save_audio_config_p;
 
+static packet_t remove_from_queue(int chan, int prio);
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        remove_from_queue
+ *
+ * Purpose:     Take packet from head of linked list and update the totals.
+ *
+ * Description:	Caller must hold tq_mutex.
+ *
+ *--------------------------------------------------------------------*/
+
+static packet_t remove_from_queue(int chan, int prio)
+{
+	packet_t result_p = queue_head[chan][prio];
+
+	if (result_p != NULL)
+	{
+		queue_head[chan][prio] = ax25_get_nextp(result_p);
+		ax25_set_nextp(result_p, NULL);
+		if (queue_head[chan][prio] == NULL)
+		{
+			queue_tail[chan][prio] = NULL;
+		}
+
+		if (ax25_get_num_addr(result_p) >= AX25_MIN_ADDRS)
+		{
+			queue_frames[chan][prio]--;
+			queue_bytes[chan][prio] -= ax25_get_frame_len(result_p);
+		}
+	}
+	return (result_p);
+}
+
+/* True if adding a frame of flen bytes would go over the TXQUEUE limits. */
+
+static int txq_full(int chan, int prio, int flen)
+{
+	struct audio_s *pa = save_audio_config_p;
+
+	return ((pa->txq_max_frames > 0 && queue_frames[chan][prio] + 1 > pa->txq_max_frames) ||
+			(pa->txq_max_bytes > 0 && queue_bytes[chan][prio] + flen > pa->txq_max_bytes));
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        wake_up_xmit
+ *
+ * Purpose:     Let the transmit thread know there is something in its queue,
+ *		or something else it may be waiting for has happened.
+ *
+ *--------------------------------------------------------------------*/
+
+static void wake_up_xmit(int chan)
+{
+	__atomic_add_fetch(&event_seq[chan], 1, __ATOMIC_SEQ_CST);
+
+#if __WIN32__
+	SetEvent(wake_up_event[chan]);
+#else
+	if (__atomic_load_n(&xmit_thread_is_waiting[chan], __ATOMIC_SEQ_CST))
+	{
+		int err;
+
+		dw_mutex_lock(&(wake_up_mutex[chan]));
+
+		err = pthread_cond_signal(&(wake_up_cond[chan]));
+		if (err != 0)
+		{
+
+			printf("tq_append: pthread_cond_signal err=%d", err);
+			perror("");
+			exit(1);
+		}
+
+		dw_mutex_unlock(&(wake_up_mutex[chan]));
+	}
+#endif
+}
+
 void tq_init(struct audio_s *audio_config_p)
 {
 	int c, p;
@@ -120,6 +266,9 @@ void tq_init(struct audio_s *audio_config_p)
 		for (p = 0; p < TQ_NUM_PRIO; p++)
 		{
 			queue_head[c][p] = NULL;
+			queue_tail[c][p] = NULL;
+			queue_frames[c][p] = 0;
+			queue_bytes[c][p] = 0;
 		}
 	}
 
@@ -216,16 +365,49 @@ void tq_init(struct audio_s *audio_config_p)
 
 void tq_append(int chan, int prio, packet_t pp)
 {
-	packet_t plast;
+	if (pp == NULL)
+	{
+
+		printf("INTERNAL ERROR:  tq_append NULL packet pointer. Please report this!\n");
+		return;
+	}
+
+	ax25_set_nextp(pp, NULL);
+	tq_append_batch(chan, prio, pp);
+
+} /* end tq_append */
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        tq_append_batch
+ *
+ * Purpose:     Add a chain of packets to the end of the specified transmit queue.
+ *
+ * Inputs:	chan	- Channel, 0 is first.
+ *
+ *		prio	- Priority, use TQ_PRIO_0_HI or TQ_PRIO_1_LO.
+ *
+ *		pp	- First packet object, linked to the rest with ax25_set_nextp.
+ *				Same rules as tq_append about not touching them afterward.
+ *
+ * Returns:	Number of packets refused because the queue is full and
+ *		TXQUEUE specified REJECT.  They have been deleted.
+ *
+ * Description:	Same as tq_append for each packet, but the queue is locked
+ *		and the transmit thread woken up only once.  That way it
+ *		can see the whole burst when deciding how many to bundle
+ *		into one transmission.
+ *
+ *--------------------------------------------------------------------*/
+
+int tq_append_batch(int chan, int prio, packet_t pp)
+{
 	packet_t pnext;
+	int n = 0;
+	int rejected = 0;
 
 #if DEBUG
-	unsigned char *pinfo;
-	int info_len = ax25_get_info(pp, &pinfo);
-	if (info_len > 10)
-		info_len = 10;
-
-	printf("tq_append (chan=%d, prio=%d, pp=%p) \"%*s\"\n", chan, prio, pp, info_len, (char *)pinfo);
+	printf("tq_append_batch (chan=%d, prio=%d, pp=%p)\n", chan, prio, pp);
 #endif
 
 	assert(prio >= 0 && prio < TQ_NUM_PRIO);
@@ -233,8 +415,8 @@ void tq_append(int chan, int prio, packet_t pp)
 	if (pp == NULL)
 	{
 
-		printf("INTERNAL ERROR:  tq_append NULL packet pointer. Please report this!\n");
-		return;
+		printf("INTERNAL ERROR:  tq_append_batch NULL packet pointer. Please report this!\n");
+		return (0);
 	}
 
 	// Normal case - put in queue for radio transmission.
@@ -250,94 +432,130 @@ void tq_append(int chan, int prio, packet_t pp)
 		printf("original KISS protocol specification.  The solution might be to use\n");
 		printf("a command like \"kissparms -c 1 -p radio\" to set CRC none mode.\n");
 		printf("\n");
-		ax25_delete(pp);
-		return;
-	}
-
-	/*
-	 * Is transmit queue out of control?
-	 *
-	 * There is no technical reason to limit the transmit packet queue length, it just seemed like a good
-	 * warning that something wasn't right.
-	 * When this was written, I was mostly concerned about APRS where packets would only be sent
-	 * occasionally and they can be discarded if they can't be sent out in a reasonable amount of time.
-	 *
-	 * If a large file is being sent, with TCP/IP, it is perfectly reasonable to have a large number
-	 * of packets waiting for transmission.
-	 *
-	 * Ideally, the application should be able to throttle the transmissions so the queue doesn't get too long.
-	 * If using the KISS interface, there is no way to get this information from the TNC back to the client app.
-	 * The AGW network interface does have a command 'y' to query about the number of frames waiting for transmission.
-	 * This was implemented in version 1.2.
-	 *
-	 * I'd rather not take out the queue length check because it is a useful sanity check for something going wrong.
-	 * Maybe the check should be performed only for APRS packets.
-	 * The check would allow an unlimited number of other types.
-	 *
-	 * Limit was 20.  Changed to 100 in version 1.2 as a workaround.
-	 */
-
-	if (ax25_is_aprs(pp) && tq_count(chan, prio, "", "", 0) > 100)
-	{
-
-		printf("Transmit packet queue for channel %d is too long.  Discarding packet.\n", chan);
-		printf("Perhaps the channel is so busy there is no opportunity to send.\n");
-		ax25_delete(pp);
-		return;
+		for (; pp != NULL; pp = pnext)
+		{
+			pnext = ax25_get_nextp(pp);
+			ax25_delete(pp);
+		}
+		return (0);
 	}
 
 #if DEBUG
 
-	printf("tq_append: enter critical section\n");
+	printf("tq_append_batch: enter critical section\n");
 #endif
 
 	dw_mutex_lock(&tq_mutex);
 
-	if (queue_head[chan][prio] == NULL)
+	for (; pp != NULL; pp = pnext)
 	{
-		queue_head[chan][prio] = pp;
-	}
-	else
-	{
-		plast = queue_head[chan][prio];
-		while ((pnext = ax25_get_nextp(plast)) != NULL)
+		pnext = ax25_get_nextp(pp);
+
+		/*
+		 * Is transmit queue out of control?
+		 *
+		 * There is no technical reason to limit the transmit packet queue length, it just seemed like a good
+		 * warning that something wasn't right.
+		 * When this was written, I was mostly concerned about APRS where packets would only be sent
+		 * occasionally and they can be discarded if they can't be sent out in a reasonable amount of time.
+		 *
+		 * If a large file is being sent, with TCP/IP, it is perfectly reasonable to have a large number
+		 * of packets waiting for transmission.
+		 *
+		 * Ideally, the application should be able to throttle the transmissions so the queue doesn't get too long.
+		 * If using the KISS interface, there is no way to get this information from the TNC back to the client app.
+		 * The AGW network interface does have a command 'y' to query about the number of frames waiting for transmission.
+		 * This was implemented in version 1.2.
+		 *
+		 * I'd rather not take out the queue length check because it is a useful sanity check for something going wrong.
+		 * Maybe the check should be performed only for APRS packets.
+		 * The check would allow an unlimited number of other types.
+		 *
+		 * Limit was 20.  Changed to 100 in version 1.2 as a workaround.
+		 */
+
+		if (ax25_is_aprs(pp) && queue_frames[chan][prio] > 100)
+		{
+
+			printf("Transmit packet queue for channel %d is too long.  Discarding packet.\n", chan);
+			printf("Perhaps the channel is so busy there is no opportunity to send.\n");
+			ax25_delete(pp);
+			continue;
+		}
+
+		// Version 1.8: Configurable limits with TXQUEUE.
+
+		if (txq_full(chan, prio, ax25_get_frame_len(pp)))
 		{
-			plast = pnext;
+			if (save_audio_config_p->txq_drop == QDROP_OLDEST)
+			{
+				packet_t old;
+
+				while (queue_head[chan][prio] != NULL && txq_full(chan, prio, ax25_get_frame_len(pp)))
+				{
+					old = remove_from_queue(chan, prio);
+					ax25_delete(old);
+					queue_dropped[chan]++;
+				}
+			}
+			else
+			{
+				if (save_audio_config_p->txq_drop == QDROP_REJECT)
+				{
+					queue_rejected[chan]++;
+					rejected++;
+				}
+				else
+				{
+					queue_dropped[chan]++;
+				}
+				ax25_delete(pp);
+				continue;
+			}
 		}
-		ax25_set_nextp(plast, pp);
+
+		append_to_queue(chan, prio, pp);
+		n++;
 	}
 
 	dw_mutex_unlock(&tq_mutex);
 
 #if DEBUG
 
-	printf("tq_append: left critical section\n");
-	printf("tq_append (): about to wake up xmit thread.\n");
+	printf("tq_append_batch: left critical section\n");
+	printf("tq_append_batch (): about to wake up xmit thread.\n");
 #endif
 
-#if __WIN32__
-	SetEvent(wake_up_event[chan]);
-#else
-	if (xmit_thread_is_waiting[chan])
+	if (n > 0)
 	{
-		int err;
+		wake_up_xmit(chan);
+	}
 
-		dw_mutex_lock(&(wake_up_mutex[chan]));
+	return (rejected);
 
-		err = pthread_cond_signal(&(wake_up_cond[chan]));
-		if (err != 0)
-		{
+} /* end tq_append_batch */
 
-			printf("tq_append: pthread_cond_signal err=%d", err);
-			perror("");
-			exit(1);
-		}
+/*-------------------------------------------------------------------
+ *
+ * Name:        tq_drop_stats
+ *
+ * Purpose:     Number of frames discarded because of the TXQUEUE limits.
+ *
+ * Inputs:	chan	- Channel, 0 is first.
+ *
+ * Outputs:	dropped	- Discarded, newest or oldest.
+ *
+ *		rejected - Refused with QDROP_REJECT.
+ *
+ *--------------------------------------------------------------------*/
 
-		dw_mutex_unlock(&(wake_up_mutex[chan]));
-	}
-#endif
+void tq_drop_stats(int chan, int *dropped, int *rejected)
+{
+	assert(chan >= 0 && chan < MAX_CHANS);
 
-} /* end tq_append */
+	*dropped = queue_dropped[chan];
+	*rejected = queue_rejected[chan];
+}
 
 /*-------------------------------------------------------------------
  *
@@ -415,8 +633,6 @@ void tq_append(int chan, int prio, packet_t pp)
 
 void lm_data_request(int chan, int prio, packet_t pp)
 {
-	packet_t plast;
-	packet_t pnext;
 
 #if DEBUG
 	unsigned char *pinfo;
@@ -466,19 +682,7 @@ void lm_data_request(int chan, int prio, packet_t pp)
 
 	dw_mutex_lock(&tq_mutex);
 
-	if (queue_head[chan][prio] == NULL)
-	{
-		queue_head[chan][prio] = pp;
-	}
-	else
-	{
-		plast = queue_head[chan][prio];
-		while ((pnext = ax25_get_nextp(plast)) != NULL)
-		{
-			plast = pnext;
-		}
-		ax25_set_nextp(plast, pp);
-	}
+	append_to_queue(chan, prio, pp);
 
 	dw_mutex_unlock(&tq_mutex);
 
@@ -499,27 +703,7 @@ void lm_data_request(int chan, int prio, packet_t pp)
 #if DEBUG
 	printf("lm_data_request (): about to wake up xmit thread.\n");
 #endif
-#if __WIN32__
-	SetEvent(wake_up_event[chan]);
-#else
-	if (xmit_thread_is_waiting[chan])
-	{
-		int err;
-
-		dw_mutex_lock(&(wake_up_mutex[chan]));
-
-		err = pthread_cond_signal(&(wake_up_cond[chan]));
-		if (err != 0)
-		{
-
-			printf("lm_data_request: pthread_cond_signal err=%d", err);
-			perror("");
-			exit(1);
-		}
-
-		dw_mutex_unlock(&(wake_up_mutex[chan]));
-	}
-#endif
+	wake_up_xmit(chan);
 	// NO!	}
 
 } /* end lm_data_request */
@@ -582,8 +766,6 @@ void lm_seize_request(int chan)
 	packet_t pp;
 	int prio = TQ_PRIO_1_LO;
 
-	packet_t plast;
-	packet_t pnext;
 
 #if DEBUG
 	unsigned char *pinfo;
@@ -611,19 +793,7 @@ void lm_seize_request(int chan)
 
 	dw_mutex_lock(&tq_mutex);
 
-	if (queue_head[chan][prio] == NULL)
-	{
-		queue_head[chan][prio] = pp;
-	}
-	else
-	{
-		plast = queue_head[chan][prio];
-		while ((pnext = ax25_get_nextp(plast)) != NULL)
-		{
-			plast = pnext;
-		}
-		ax25_set_nextp(plast, pp);
-	}
+	append_to_queue(chan, prio, pp);
 
 	dw_mutex_unlock(&tq_mutex);
 
@@ -635,27 +805,7 @@ void lm_seize_request(int chan)
 #if DEBUG
 	printf("lm_seize_request (): about to wake up xmit thread.\n");
 #endif
-#if __WIN32__
-	SetEvent(wake_up_event[chan]);
-#else
-	if (xmit_thread_is_waiting[chan])
-	{
-		int err;
-
-		dw_mutex_lock(&(wake_up_mutex[chan]));
-
-		err = pthread_cond_signal(&(wake_up_cond[chan]));
-		if (err != 0)
-		{
-
-			printf("lm_seize_request: pthread_cond_signal err=%d", err);
-			perror("");
-			exit(1);
-		}
-
-		dw_mutex_unlock(&(wake_up_mutex[chan]));
-	}
-#endif
+	wake_up_xmit(chan);
 
 } /* end lm_seize_request */
 
@@ -675,6 +825,7 @@ void lm_seize_request(int chan)
 
 void tq_wait_while_empty(int chan)
 {
+	unsigned int seen;
 	int is_empty;
 
 #if DEBUG
@@ -683,21 +834,14 @@ void tq_wait_while_empty(int chan)
 #endif
 	assert(chan >= 0 && chan < MAX_CHANS);
 
+	seen = tq_event_seq(chan);
+
 	dw_mutex_lock(&tq_mutex);
 
-#if DEBUG
-	//
-	// printf ("tq_wait_while_empty (%d): after pthread_mutex_lock\n", chan);
-#endif
 	is_empty = tq_is_empty(chan);
 
 	dw_mutex_unlock(&tq_mutex);
 
-#if DEBUG
-
-	printf("tq_wait_while_empty (%d) : left critical section\n", chan);
-#endif
-
 #if DEBUG
 
 	printf("tq_wait_while_empty (%d): is_empty = %d\n", chan, is_empty);
@@ -705,48 +849,138 @@ void tq_wait_while_empty(int chan)
 
 	if (is_empty)
 	{
-#if DEBUG
+		tq_wait_event(chan, seen, -1);
+	}
 
-		printf("tq_wait_while_empty (%d): SLEEP - about to call cond wait\n", chan);
+#if DEBUG
+	printf("tq_wait_while_empty (%d) returns\n", chan);
 #endif
+}
 
-#if __WIN32__
-		WaitForSingleObject(wake_up_event[chan], INFINITE);
+/*-------------------------------------------------------------------
+ *
+ * Name:        tq_event_seq
+ *
+ * Purpose:     Get the current event count for a channel.
+ *
+ * Description:	Take this before checking whatever the caller is
+ *		waiting for, then pass it to tq_wait_event.
+ *
+ *--------------------------------------------------------------------*/
 
-#if DEBUG
+unsigned int tq_event_seq(int chan)
+{
+	return (__atomic_load_n(&event_seq[chan], __ATOMIC_SEQ_CST));
+}
 
-		printf("tq_wait_while_empty (): returned from wait\n");
-#endif
+/*-------------------------------------------------------------------
+ *
+ * Name:        tq_wait_event
+ *
+ * Purpose:     Sleep until something is added to the transmit queue
+ *		or the channel busy state changes.
+ *
+ * Inputs:	chan		- Channel, 0 is first.
+ *
+ *		seen		- Value from tq_event_seq before looking.
+ *
+ *		timeout_ms	- Most milliseconds to wait.  -1 for no limit.
+ *
+ * Returns:	1 if something happened since seen, 0 for timeout.
+ *
+ *--------------------------------------------------------------------*/
+
+int tq_wait_event(int chan, unsigned int seen, int timeout_ms)
+{
+	int happened;
+
+	assert(chan >= 0 && chan < MAX_CHANS);
 
+#if __WIN32__
+	DWORD wait_until = GetTickCount() + timeout_ms;
+
+	while ((happened = (tq_event_seq(chan) != seen)) == 0)
+	{
+		DWORD ms = INFINITE;
+
+		if (timeout_ms >= 0)
+		{
+			ms = wait_until - GetTickCount();
+			if ((int)ms <= 0)
+				break;
+		}
+		if (WaitForSingleObject(wake_up_event[chan], ms) == WAIT_TIMEOUT)
+		{
+			happened = tq_event_seq(chan) != seen;
+			break;
+		}
+	}
 #else
-		dw_mutex_lock(&(wake_up_mutex[chan]));
+	struct timespec abstime;
+	int err = 0;
 
-		xmit_thread_is_waiting[chan] = 1;
-		int err;
-		err = pthread_cond_wait(&(wake_up_cond[chan]), &(wake_up_mutex[chan]));
-		xmit_thread_is_waiting[chan] = 0;
+	if (timeout_ms >= 0)
+	{
+		clock_gettime(CLOCK_REALTIME, &abstime);
+		abstime.tv_sec += timeout_ms / 1000;
+		abstime.tv_nsec += (timeout_ms % 1000) * 1000000L;
+		if (abstime.tv_nsec >= 1000000000L)
+		{
+			abstime.tv_sec++;
+			abstime.tv_nsec -= 1000000000L;
+		}
+	}
 
-#if DEBUG
+	dw_mutex_lock(&(wake_up_mutex[chan]));
 
-		printf("tq_wait_while_empty (%d): WOKE UP - returned from cond wait, err = %d\n", chan, err);
-#endif
+	__atomic_store_n(&xmit_thread_is_waiting[chan], 1, __ATOMIC_SEQ_CST);
 
-		if (err != 0)
+	while ((happened = (tq_event_seq(chan) != seen)) == 0 && err != ETIMEDOUT)
+	{
+		if (timeout_ms >= 0)
+		{
+			err = pthread_cond_timedwait(&(wake_up_cond[chan]), &(wake_up_mutex[chan]), &abstime);
+		}
+		else
+		{
+			err = pthread_cond_wait(&(wake_up_cond[chan]), &(wake_up_mutex[chan]));
+		}
+
+		if (err != 0 && err != ETIMEDOUT)
 		{
 
-			printf("tq_wait_while_empty (%d): pthread_cond_wait err=%d", chan, err);
+			printf("tq_wait_event (%d): pthread_cond_wait err=%d", chan, err);
 			perror("");
 			exit(1);
 		}
-
-		dw_mutex_unlock(&(wake_up_mutex[chan]));
-#endif
 	}
 
-#if DEBUG
+	__atomic_store_n(&xmit_thread_is_waiting[chan], 0, __ATOMIC_SEQ_CST);
 
-	printf("tq_wait_while_empty (%d) returns\n", chan);
+	dw_mutex_unlock(&(wake_up_mutex[chan]));
 #endif
+
+	return (happened);
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        tq_channel_busy_change
+ *
+ * Purpose:     Called when the channel busy (DCD) state changes so a
+ *		transmit thread waiting for a clear channel reacts at once.
+ *
+ *--------------------------------------------------------------------*/
+
+void tq_channel_busy_change(int chan)
+{
+	if (save_audio_config_p == NULL || chan < 0 || chan >= MAX_CHANS ||
+		save_audio_config_p->chan_medium[chan] != MEDIUM_RADIO)
+	{
+		return;
+	}
+
+	wake_up_xmit(chan);
 }
 
 /*-------------------------------------------------------------------
@@ -776,18 +1010,7 @@ packet_t tq_remove(int chan, int prio)
 
 	dw_mutex_lock(&tq_mutex);
 
-	if (queue_head[chan][prio] == NULL)
-	{
-
-		result_p = NULL;
-	}
-	else
-	{
-
-		result_p = queue_head[chan][prio];
-		queue_head[chan][prio] = ax25_get_nextp(result_p);
-		ax25_set_nextp(result_p, NULL);
-	}
+	result_p = remove_from_queue(chan, prio);
 
 	dw_mutex_unlock(&tq_mutex);
 
@@ -926,13 +1149,19 @@ int tq_count(int chan, int prio, char *source, char *dest, int bytes)
 		return (0);
 	}
 
+	// Without an address to match, the running totals have the answer.
+
+	if ((source == NULL || *source == '\0') && (dest == NULL || *dest == '\0'))
+	{
+		return (bytes ? queue_bytes[chan][prio] : queue_frames[chan][prio]);
+	}
+
 	// Don't want lists being rearranged while we are traversing them.
 
 	dw_mutex_lock(&tq_mutex);
 
 	int n = 0; // Result.  Number of bytes or packets.
 	packet_t pp = queue_head[chan][prio];
-	;
 
 	while (pp != NULL)
 	{
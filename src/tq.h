@@ -22,12 +22,22 @@ void tq_init(struct audio_s *audio_config_p);
 
 void tq_append(int chan, int prio, packet_t pp);
 
+int tq_append_batch(int chan, int prio, packet_t pp);
+
+void tq_drop_stats(int chan, int *dropped, int *rejected);
+
 void lm_data_request(int chan, int prio, packet_t pp);
 
 void lm_seize_request(int chan);
 
 void tq_wait_while_empty(int chan);
 
+unsigned int tq_event_seq(int chan);
+
+int tq_wait_event(int chan, unsigned int seen, int timeout_ms);
+
+void tq_channel_busy_change(int chan);
+
 packet_t tq_remove(int chan, int prio);
 
 packet_t tq_peek(int chan, int prio);
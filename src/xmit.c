@@ -58,6 +58,7 @@
 #include <math.h>
 #include <errno.h>
 #include <stddef.h>
+#include <time.h>
 
 #include "ax25_pad.h"
 #include "audio.h"
@@ -65,9 +66,11 @@
 #include "tq.h"
 #include "xmit.h"
 #include "hdlc_send.h"
+#include "gen_tone.h"
 #include "hdlc_rec.h"
 #include "ptt.h"
 #include "dlq.h"
+#include "audio_stats.h"
 
 /*
  * Parameters for transmission.
@@ -125,6 +128,69 @@ static int wait_for_clear_channel(int channel, int slotttime, int persist, int f
 static void xmit_ax25_frames(int c, int p, packet_t pp, int max_bundle);
 static int send_one_frame(int c, int p, packet_t pp);
 
+/*
+ * Version 1.8: Transmit pipeline.
+ *
+ * With TXPIPELINE, audio is generated into memory and handed, a frame at a
+ * time, to a separate thread which writes it to the audio device.  While
+ * that thread is blocked waiting for the device, the transmit thread is
+ * already working on the next frame.
+ *
+ * Audio still has to be generated in order because each frame starts with
+ * the tone phase and NRZI level left by the one before.
+ *
+ * This needs the pthread condition variables so Windows just writes each
+ * piece as soon as it is ready, on the transmit thread.
+ */
+
+struct pipe_chunk_s
+{
+	struct pipe_chunk_s *next;
+	int16_t *buf;
+	int nframes;
+};
+
+#if !__WIN32__
+static struct pipe_s
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond; /* Chunk added or writer done with one. */
+	struct pipe_chunk_s *head;
+	struct pipe_chunk_s *tail;
+	int busy; /* Writer is working on a chunk. */
+} xmit_pipe[MAX_CHANS];
+
+static void *pipe_thread(void *arg);
+#endif
+
+static void pipe_send(int chan);
+static void pipe_drain(int chan);
+
+/*
+ * Version 1.8: Transmit latency.
+ *
+ * Each transmission is timed at these points:
+ *
+ *	start		Frame taken from the queue, clear channel.
+ *	ptt_on		PTT turned on.
+ *	first, last	First and last audio handed to the device.
+ *			This comes from audio_flush, in audio_stats.c, so
+ *			it is the same for all the ways of generating audio.
+ *	drained		audio_wait returned.
+ *	ptt_off		PTT turned off.
+ *
+ * The differences go into histograms, for each channel, where bucket
+ * n counts times less than 2**n milliseconds.  The last one is for
+ * anything longer.
+ */
+
+static int lat_hist[MAX_CHANS][XMIT_LAT_NUM][XMIT_LAT_BUCKETS];
+static int lat_count[MAX_CHANS][XMIT_LAT_NUM];
+static int lat_max[MAX_CHANS][XMIT_LAT_NUM];
+static int64_t lat_sum[MAX_CHANS][XMIT_LAT_NUM]; /* Microseconds. */
+
+static void lat_add(int chan, int stage, int64_t from, int64_t to);
+
 /*-------------------------------------------------------------------
  *
  * Name:        xmit_init
@@ -174,12 +240,15 @@ void xmit_init(struct audio_s *p_modem, int debug_xmit_packet)
 
 /*
  * Push to Talk (PTT) control.
+ * Version 1.8: Might have been started already by ptt_init_begin.
  */
 #if DEBUG
 
 	printf("xmit_init: about to call ptt_init \n");
 #endif
-	ptt_init(p_modem);
+	ptt_init_finish(p_modem);
+
+	layer2_send_init();
 
 #if DEBUG
 
@@ -212,6 +281,26 @@ void xmit_init(struct audio_s *p_modem, int debug_xmit_packet)
 		dw_mutex_init(&(audio_out_dev_mutex[ad]));
 	}
 
+#if !__WIN32__
+	for (j = 0; j < MAX_CHANS; j++)
+	{
+		if (p_modem->chan_medium[j] == MEDIUM_RADIO && p_modem->achan[j].pipeline && !p_modem->achan[j].prerender)
+		{
+			pthread_t pipe_tid;
+			int e;
+
+			dw_mutex_init(&(xmit_pipe[j].mutex));
+			pthread_cond_init(&(xmit_pipe[j].cond), NULL);
+			e = pthread_create(&pipe_tid, NULL, pipe_thread, (void *)(ptrdiff_t)j);
+			if (e != 0)
+			{
+				perror("Could not create transmit pipeline thread");
+				return;
+			}
+		}
+	}
+#endif
+
 #if DEBUG
 
 	printf("xmit_init: about to create threads \n");
@@ -428,6 +517,8 @@ static void *xmit_thread(void *arg)
 	int prio;
 	int ok;
 
+	dw_thread_sched(THREAD_XMIT, chan);
+
 	while (1)
 	{
 
@@ -597,6 +688,13 @@ static void *xmit_thread(void *arg)
  *
  * Version 1.5:	Add full duplex option.
  *
+ * Version 1.8:	Optionally generate all of the audio before turning on the
+ *		transmitter.  Then it goes to the device in large pieces
+ *		and we know exactly how long it will take.
+ *
+ *		Or, generate audio for each frame while another thread
+ *		sends the one before to the device.
+ *
  *--------------------------------------------------------------------*/
 
 static void xmit_ax25_frames(int chan, int prio, packet_t pp, int max_bundle)
@@ -612,19 +710,47 @@ static void xmit_ax25_frames(int chan, int prio, packet_t pp, int max_bundle)
 
 	int nb;
 
+	int prerender = save_audio_config_p->achan[chan].prerender;
+	int pipeline = !prerender && save_audio_config_p->achan[chan].pipeline;
+
+	int64_t t_start = audio_stats_clock();
+	int64_t t_ptt_on = t_start, t_first = 0, t_last = 0, t_drained = 0, t_ptt_off = 0;
+
+	audio_stats_write_reset(ACHAN2ADEV(chan));
+
 	/*
 	 * Turn on transmitter.
 	 * Start sending leading flag bytes.
+	 *
+	 * When rendering ahead, the transmitter stays off until all
+	 * the audio is ready.
 	 */
 
+	if (prerender)
+	{
+		gen_tone_render_begin(chan);
+	}
+	else
+	{
 #if DEBUG
 
-	printf("xmit_thread: t=%.3f, Turn on PTT now for channel %d. speed = %d\n", dtime_now() - time_ptt, chan, xmit_bits_per_sec[chan]);
+		printf("xmit_thread: t=%.3f, Turn on PTT now for channel %d. speed = %d\n", dtime_now() - time_ptt, chan, xmit_bits_per_sec[chan]);
 #endif
-	ptt_set(OCTYPE_PTT, chan, 1);
+		ptt_set(OCTYPE_PTT, chan, 1);
+		t_ptt_on = audio_stats_clock();
+
+		if (pipeline)
+		{
+			gen_tone_render_begin(chan);
+		}
+	}
 
 	pre_flags = MS_TO_BITS(xmit_txdelay[chan] * 10, chan) / 8;
 	num_bits = layer2_preamble_postamble(chan, pre_flags, 0);
+	if (pipeline)
+	{
+		pipe_send(chan);
+	}
 #if DEBUG
 
 	printf("xmit_thread: t=%.3f, txdelay=%d [*10], pre_flags=%d, num_bits=%d\n", dtime_now() - time_ptt, xmit_txdelay[chan], pre_flags, num_bits);
@@ -648,6 +774,10 @@ static void xmit_ax25_frames(int chan, int prio, packet_t pp, int max_bundle)
 	 */
 
 	nb = send_one_frame(chan, prio, pp);
+	if (pipeline)
+	{
+		pipe_send(chan);
+	}
 
 	num_bits += nb;
 	if (nb > 0)
@@ -702,6 +832,10 @@ static void xmit_ax25_frames(int chan, int prio, packet_t pp, int max_bundle)
 #endif
 
 				nb = send_one_frame(chan, prio, pp);
+				if (pipeline)
+				{
+					pipe_send(chan);
+				}
 
 				num_bits += nb;
 				if (nb > 0)
@@ -726,24 +860,43 @@ static void xmit_ax25_frames(int chan, int prio, packet_t pp, int max_bundle)
 	 */
 
 	post_flags = MS_TO_BITS(xmit_txtail[chan] * 10, chan) / 8;
-	nb = layer2_preamble_postamble(chan, post_flags, 1);
+	nb = layer2_preamble_postamble(chan, post_flags, !(prerender || pipeline));
 	num_bits += nb;
 #if DEBUG
 
 	printf("xmit_thread: t=%.3f, txtail=%d [*10], post_flags=%d, nb=%d, num_bits=%d\n", dtime_now() - time_ptt, xmit_txtail[chan], post_flags, nb, num_bits);
 #endif
 
+	/*
+	 * Calculate how long the frame(s) should take in milliseconds.
+	 * With the audio already rendered, we know exactly.
+	 */
+
+	if (prerender)
+	{
+		ptt_set(OCTYPE_PTT, chan, 1);
+		t_ptt_on = audio_stats_clock();
+		duration = gen_tone_render_end(chan);
+	}
+	else
+	{
+		if (pipeline)
+		{
+			pipe_send(chan);
+			gen_tone_render_end(chan); // Nothing left in it.
+			pipe_drain(chan);
+		}
+		duration = BITS_TO_MS(num_bits, chan);
+	}
+
 	audio_wait(ACHAN2ADEV(chan));
+	t_drained = audio_stats_clock();
 
 	/*
 	 * Ideally we should be here just about the time when the audio is ending.
 	 * However, the innards of "audio_wait" are not satisfactory in all cases.
-	 *
-	 * Calculate how long the frame(s) should take in milliseconds.
 	 */
 
-	duration = BITS_TO_MS(num_bits, chan);
-
 	/*
 	 * See how long it has been since PTT was turned on.
 	 * Wait additional time if necessary.
@@ -771,9 +924,220 @@ static void xmit_ax25_frames(int chan, int prio, packet_t pp, int max_bundle)
 #endif
 
 	ptt_set(OCTYPE_PTT, chan, 0);
+	t_ptt_off = audio_stats_clock();
+
+	lat_add(chan, XMIT_LAT_START_TO_PTT, t_start, t_ptt_on);
+
+	audio_stats_write_times(ACHAN2ADEV(chan), &t_first, &t_last);
+	if (t_first != 0)
+	{
+		lat_add(chan, XMIT_LAT_PTT_TO_AUDIO, t_ptt_on, t_first);
+		lat_add(chan, XMIT_LAT_AUDIO, t_first, t_last);
+		lat_add(chan, XMIT_LAT_DRAIN, t_last, t_drained);
+		lat_add(chan, XMIT_LAT_AUDIO_TO_UNKEY, t_last, t_ptt_off);
+	}
 
 } /* end xmit_ax25_frames */
 
+/*-------------------------------------------------------------------
+ *
+ * Name:        lat_add
+ *
+ * Purpose:     Add one time interval to a latency histogram.
+ *
+ * Inputs:	chan	- Channel number.
+ *
+ *		stage	- One of XMIT_LAT_...
+ *
+ *		from, to - Times from audio_stats_clock, in microseconds.
+ *
+ *--------------------------------------------------------------------*/
+
+static void lat_add(int chan, int stage, int64_t from, int64_t to)
+{
+	int ms = to > from ? (int)((to - from) / 1000) : 0;
+	int n = 0;
+
+	while (n < XMIT_LAT_BUCKETS - 1 && ms >= (1 << n))
+	{
+		n++;
+	}
+
+	lat_hist[chan][stage][n]++;
+	lat_count[chan][stage]++;
+	lat_sum[chan][stage] += to > from ? to - from : 0;
+	if (ms > lat_max[chan][stage])
+	{
+		lat_max[chan][stage] = ms;
+	}
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        xmit_latency_stats
+ *
+ * Purpose:     Get a transmit latency histogram.
+ *
+ * Inputs:	chan	- Channel, 0 is first.
+ *
+ *		stage	- One of XMIT_LAT_... in xmit.h.
+ *
+ * Outputs:	hist	- XMIT_LAT_BUCKETS counts.  hist[n] is the number
+ *			  of times less than 2**n milliseconds, and not
+ *			  in an earlier bucket.  The last is for the rest.
+ *
+ *		count	- Number of transmissions measured.
+ *
+ *		sum_us	- Total of all the times, in microseconds.
+ *
+ *		max_ms	- Longest time seen, in milliseconds.
+ *
+ * Description:	The write times are missing, and the transmission not
+ *		counted, for the stages after PTT on if the audio device
+ *		didn't report any writes.
+ *
+ *--------------------------------------------------------------------*/
+
+void xmit_latency_stats(int chan, int stage, int *hist, int *count, int64_t *sum_us, int *max_ms)
+{
+	assert(chan >= 0 && chan < MAX_CHANS);
+	assert(stage >= 0 && stage < XMIT_LAT_NUM);
+
+	memcpy(hist, lat_hist[chan][stage], sizeof(lat_hist[chan][stage]));
+	*count = lat_count[chan][stage];
+	*sum_us = lat_sum[chan][stage];
+	*max_ms = lat_max[chan][stage];
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        pipe_send
+ *
+ * Purpose:     Pass the audio generated so far to the pipeline thread.
+ *
+ * Inputs:	chan	- Channel number.
+ *
+ *--------------------------------------------------------------------*/
+
+static void pipe_send(int chan)
+{
+	struct pipe_chunk_s *c;
+	int16_t *buf;
+	int nframes;
+
+	nframes = gen_tone_render_take(chan, &buf);
+	if (nframes == 0)
+	{
+		return;
+	}
+
+#if __WIN32__
+	(void)c;
+	audio_put_block(ACHAN2ADEV(chan), buf, nframes);
+	free(buf);
+#else
+	c = malloc(sizeof(struct pipe_chunk_s));
+	if (c == NULL)
+	{
+		printf("FATAL ERROR: Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	c->next = NULL;
+	c->buf = buf;
+	c->nframes = nframes;
+
+	dw_mutex_lock(&(xmit_pipe[chan].mutex));
+	if (xmit_pipe[chan].tail == NULL)
+	{
+		xmit_pipe[chan].head = c;
+	}
+	else
+	{
+		xmit_pipe[chan].tail->next = c;
+	}
+	xmit_pipe[chan].tail = c;
+	pthread_cond_broadcast(&(xmit_pipe[chan].cond));
+	dw_mutex_unlock(&(xmit_pipe[chan].mutex));
+#endif
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        pipe_drain
+ *
+ * Purpose:     Wait until the pipeline thread has written everything,
+ *		then push out the final partial buffer.
+ *
+ * Inputs:	chan	- Channel number.
+ *
+ *--------------------------------------------------------------------*/
+
+static void pipe_drain(int chan)
+{
+#if !__WIN32__
+	dw_mutex_lock(&(xmit_pipe[chan].mutex));
+	while (xmit_pipe[chan].head != NULL || xmit_pipe[chan].busy)
+	{
+		pthread_cond_wait(&(xmit_pipe[chan].cond), &(xmit_pipe[chan].mutex));
+	}
+	dw_mutex_unlock(&(xmit_pipe[chan].mutex));
+#endif
+
+	audio_flush(ACHAN2ADEV(chan));
+}
+
+/*-------------------------------------------------------------------
+ *
+ * Name:        pipe_thread
+ *
+ * Purpose:     Write audio for one channel to its device.
+ *
+ * Inputs:	arg	- Channel number.
+ *
+ * Description:	Only one channel of a device transmits at a time, and
+ *		its transmit thread doesn't touch the device while the
+ *		pipeline is in use, so no other locking is needed.
+ *
+ *--------------------------------------------------------------------*/
+
+#if !__WIN32__
+static void *pipe_thread(void *arg)
+{
+	int chan = (int)(ptrdiff_t)arg;
+	struct pipe_s *P = &xmit_pipe[chan];
+
+	while (1)
+	{
+		struct pipe_chunk_s *c;
+
+		dw_mutex_lock(&(P->mutex));
+		while (P->head == NULL)
+		{
+			pthread_cond_wait(&(P->cond), &(P->mutex));
+		}
+		c = P->head;
+		P->head = c->next;
+		if (P->head == NULL)
+		{
+			P->tail = NULL;
+		}
+		P->busy = 1;
+		dw_mutex_unlock(&(P->mutex));
+
+		audio_put_block(ACHAN2ADEV(chan), c->buf, c->nframes);
+		free(c->buf);
+		free(c);
+
+		dw_mutex_lock(&(P->mutex));
+		P->busy = 0;
+		pthread_cond_broadcast(&(P->cond));
+		dw_mutex_unlock(&(P->mutex));
+	}
+
+	return (NULL); /* unreachable but quiet the warning. */
+}
+#endif
+
 /*-------------------------------------------------------------------
  *
  * Name:        send_one_frame
@@ -966,25 +1330,67 @@ int xmit_speak_it(char *script, int c, char *orig_msg)
 #define WAIT_TIMEOUT_MS (60 * 1000)
 #define WAIT_CHECK_EVERY_MS 10
 
+/* Monotonic clock in seconds, for the deadlines below. */
+
+static double wait_clock(void)
+{
+#if __WIN32__
+	LARGE_INTEGER freq, now;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return ((double)now.QuadPart / (double)freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec * 1e-9);
+#endif
+}
+
 static int wait_for_clear_channel(int chan, int slottime, int persist, int fulldup)
 {
 	int n = 0;
+	unsigned int seen;
+	double give_up = wait_clock() + WAIT_TIMEOUT_MS / 1000.0;
 
 	/*
 	 * For dull duplex we skip the channel busy check and random wait.
 	 * We still need to wait if operating in stereo and the other audio
 	 * half is busy.
+	 *
+	 * Version 1.8: Rather than checking every 10 mS, sleep until the
+	 * channel busy state changes or something is added to the queue.
+	 * A transmit inhibit input is only found by looking so keep
+	 * checking every 10 mS when there is one.
 	 */
+	int txinh = save_audio_config_p->achan[chan].ictrl[ICTYPE_TXINH].method != PTT_METHOD_NONE;
+
 	if (!fulldup)
 	{
 
 	start_over_again:
 
-		while (hdlc_rec_data_detect_any(chan))
+		while (1)
 		{
-			SLEEP_MS(WAIT_CHECK_EVERY_MS);
-			n++;
-			if (n > (WAIT_TIMEOUT_MS / WAIT_CHECK_EVERY_MS))
+			int ms;
+
+			seen = tq_event_seq(chan);
+			if (!hdlc_rec_data_detect_any(chan))
+			{
+				break;
+			}
+
+			ms = (int)((give_up - wait_clock()) * 1000.0);
+			if (ms <= 0)
+			{
+				return 0;
+			}
+			if (txinh)
+			{
+				(void)tq_wait_event(chan, seen, ms < WAIT_CHECK_EVERY_MS ? ms : WAIT_CHECK_EVERY_MS);
+			}
+			else if (!tq_wait_event(chan, seen, ms))
 			{
 				return 0;
 			}
@@ -1014,13 +1420,37 @@ static int wait_for_clear_channel(int chan, int slottime, int persist, int fulld
 		while (tq_peek(chan, TQ_PRIO_0_HI) == NULL)
 		{
 			int r;
+			double slot_end = wait_clock() + slottime * 0.01;
 
-			SLEEP_MS(slottime * 10);
+			while (1)
+			{
+				int ms;
+
+				seen = tq_event_seq(chan);
+				if (hdlc_rec_data_detect_any(chan))
+				{
+					goto start_over_again;
+				}
+				if (tq_peek(chan, TQ_PRIO_0_HI) != NULL)
+				{
+					break;
+				}
+
+				ms = (int)((slot_end - wait_clock()) * 1000.0 + 0.5);
+				if (ms <= 0 || !tq_wait_event(chan, seen, ms))
+				{
+					break;
+				}
+			}
 
 			if (hdlc_rec_data_detect_any(chan))
 			{
 				goto start_over_again;
 			}
+			if (tq_peek(chan, TQ_PRIO_0_HI) != NULL)
+			{
+				break;
+			}
 
 			r = rand() & 0xff;
 			if (r <= persist)
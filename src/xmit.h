@@ -19,6 +19,21 @@ extern void xmit_set_fulldup(int channel, int value);
 
 extern int xmit_speak_it(char *script, int c, char *msg);
 
+/* Stages for xmit_latency_stats. */
+
+#define XMIT_LAT_START_TO_PTT 0	  /* Clear channel, frame from queue, to PTT on.  Includes */
+								  /* generating all the audio for TXPRERENDER. */
+#define XMIT_LAT_PTT_TO_AUDIO 1	  /* PTT on to first audio written to the device. */
+#define XMIT_LAT_AUDIO 2		  /* First to last audio written. */
+#define XMIT_LAT_DRAIN 3		  /* Last audio written until audio_wait returns. */
+#define XMIT_LAT_AUDIO_TO_UNKEY 4 /* Last audio written to PTT off. */
+
+#define XMIT_LAT_NUM 5
+
+#define XMIT_LAT_BUCKETS 16 /* Powers of 2 milliseconds. */
+
+extern void xmit_latency_stats(int chan, int stage, int *hist, int *count, int64_t *sum_us, int *max_ms);
+
 #endif
 
 /* end xmit.h */